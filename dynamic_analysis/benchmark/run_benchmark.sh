@@ -0,0 +1,128 @@
+#!/bin/bash
+#
+# Measures the overhead of the pintool in profiling.cpp on the synthetic
+# workloads of workload.cpp.
+#
+# Usage:
+#     run_benchmark.sh PINTOOL [OUTPUT_DIR]
+#
+# PINTOOL is the built tool (for example obj-intel64/profiling.so). For each
+# number of call sites a workload is built, its vtables (the address points
+# of all _ZTV symbols) and candidates (all indirect calls found by objdump)
+# are written in the formats of the static analysis. Each combination of
+# threads and work is then run natively, under Pin without a tool and under
+# the pintool. One line is printed per combination:
+#
+#     sites threads work native_ms pin_ms tool_ms pin_x tool_x
+#         icalls_per_s decided
+#
+# pin_x and tool_x are the slowdowns relative to the native run (wall time
+# including startup), icalls_per_s is the number of indirect calls the
+# workload executed per second under the tool and decided the number of
+# candidates the tool classified (positive or negative).
+#
+# Environment (lists are separated by spaces):
+#     PIN         Pin launcher (default: pin)
+#     SITES       numbers of call sites (default: "16 256")
+#     THREADS     numbers of threads (default: "1 4")
+#     WORK        arithmetic rounds between two calls (default: "0 16 256")
+#     ITERATIONS  iterations over all sites per thread (default: 20000)
+#     CXX         compiler (default: g++)
+
+set -e
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 PINTOOL [OUTPUT_DIR]" >&2
+    exit 1
+fi
+
+TOOL="$1"
+OUT="${2:-benchmark_output}"
+PIN="${PIN:-pin}"
+SITES="${SITES:-16 256}"
+THREADS="${THREADS:-1 4}"
+WORK="${WORK:-0 16 256}"
+ITERATIONS="${ITERATIONS:-20000}"
+CXX="${CXX:-g++}"
+
+SOURCE_DIR="$(cd "$(dirname "$0")" && pwd)"
+mkdir -p "$OUT"
+
+now_ms() {
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# Runs the given command and prints its wall time in milliseconds (the
+# output of the command goes to the file given first).
+time_ms() {
+    local output="$1"
+    shift
+    local start
+    start=$(now_ms)
+    "$@" > "$output"
+    echo $(( $(now_ms) - start ))
+}
+
+ratio() {
+    awk -v a="$1" -v b="$2" 'BEGIN { printf "%.2f", (b > 0 ? a / b : 0) }'
+}
+
+echo "sites threads work native_ms pin_ms tool_ms pin_x tool_x" \
+     "icalls_per_s decided"
+
+for sites in $SITES; do
+    workload="$OUT/workload_$sites"
+    module=$(basename "$workload")
+    "$CXX" -O2 -pthread -fno-devirtualize-speculatively \
+        -DWORKLOAD_SITES="$sites" -o "$workload" "$SOURCE_DIR/workload.cpp"
+
+    # Files of the module as the static analysis would write them.
+    vtables="$OUT/${module}_vtables.txt"
+    candidates="$OUT/${module}.vcalls_candidates"
+    echo "$module" > "$vtables"
+    nm "$workload" | while read -r addr type name; do
+        case "$type:$name" in
+            [VvDdRr]:_ZTV*)
+                # The address point follows offset-to-top and RTTI.
+                printf '%x\n' $(( 0x$addr + 16 )) >> "$vtables"
+                ;;
+        esac
+    done
+    echo "$module" > "$candidates"
+    objdump -d --no-show-raw-insn "$workload" \
+        | awk '$2 ~ /^callq?$/ && $3 ~ /^\*/ { sub(":", "", $1); print $1 }' \
+        >> "$candidates"
+
+    for threads in $THREADS; do
+        for work in $WORK; do
+            args="-threads $threads -iterations $ITERATIONS -work $work"
+            run_dir="$OUT/run_${sites}_${threads}_${work}"
+            rm -rf "$run_dir"
+            mkdir -p "$run_dir"
+            echo "$module" > "$run_dir/positive.txt"
+            echo "$module" > "$run_dir/negative.txt"
+
+            native_ms=$(time_ms "$run_dir/native.out" "$workload" $args)
+            pin_ms=$(time_ms "$run_dir/pin.out" "$PIN" -- "$workload" $args)
+            tool_ms=$(time_ms "$run_dir/tool.out" "$PIN" -t "$TOOL" \
+                          -in_vtables "$vtables" \
+                          -in_candidate_vcalls "$candidates" \
+                          -inout_positive_vcalls "$run_dir/positive.txt" \
+                          -inout_negative_vcalls "$run_dir/negative.txt" \
+                          -out_log "$run_dir/log.txt" \
+                          -- "$workload" $args)
+
+            # The tool appends the pid to the files it writes back (the
+            # first line holds the module name).
+            decided=$(cat "$run_dir"/positive.txt_* "$run_dir"/negative.txt_* \
+                          2>/dev/null | grep -vc "^$module" || true)
+            icalls=$(awk '$1 == "icalls" { print $2 }' "$run_dir/tool.out")
+
+            echo "$sites $threads $work $native_ms $pin_ms $tool_ms" \
+                 "$(ratio "$pin_ms" "$native_ms")" \
+                 "$(ratio "$tool_ms" "$native_ms")" \
+                 "$(ratio "$(( icalls * 1000 ))" "$tool_ms" | cut -d. -f1)" \
+                 "$decided"
+        done
+    done
+done
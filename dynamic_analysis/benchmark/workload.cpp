@@ -0,0 +1,197 @@
+/*
+
+Synthetic workload used to measure the overhead of the pintool in
+profiling.cpp (see run_benchmark.sh which builds and runs it natively,
+under Pin and under the pintool).
+
+Build (the number of distinct indirect call sites is fixed at compile time):
+    g++ -O2 -pthread -fno-devirtualize-speculatively -DWORKLOAD_SITES=64 \
+        -o workload workload.cpp
+
+Run:
+    ./workload -threads 4 -iterations 100000 -work 16
+
+Each thread executes all call sites in turn for the given number of
+iterations. A site makes one indirect call on an object of one of
+num_classes classes (chosen by the running value, so the call cannot be
+devirtualized) followed by -work rounds of plain arithmetic, hence -work
+controls the density of the calls. One in every WORKLOAD_FPTR_EVERY sites
+calls through a plain function pointer instead, i.e., it is an indirect
+call that is not a vcall (a negative for the pintool).
+
+Prints the parameters, the number of executed indirect calls and the time
+taken by the threads (without the startup of the process).
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+#ifndef WORKLOAD_SITES
+#define WORKLOAD_SITES 64
+#endif
+
+#ifndef WORKLOAD_FPTR_EVERY
+#define WORKLOAD_FPTR_EVERY 4
+#endif
+
+const uint32_t num_classes = 8;
+
+class Base {
+public:
+    virtual ~Base() { }
+    virtual uint64_t step(uint64_t value) const = 0;
+};
+
+template<int K>
+class Derived : public Base {
+public:
+    virtual uint64_t step(uint64_t value) const {
+        return value * (2 * K + 1) + K;
+    }
+};
+
+typedef uint64_t (*StepFunction)(uint64_t);
+
+template<int K>
+uint64_t plain_step(uint64_t value) {
+    return value * (2 * K + 1) + K;
+}
+
+// Objects and functions the sites choose from.
+struct Targets {
+    const Base *objects[num_classes];
+    StepFunction functions[num_classes];
+};
+
+inline uint64_t do_work(uint64_t value, uint32_t work) {
+    for(uint32_t i = 0; i < work; i++) {
+        value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    return value;
+}
+
+// One call site (the added constant keeps the compiler from folding the
+// sites into one function).
+template<int I>
+__attribute__((noinline))
+uint64_t call_site(const Targets &targets, uint64_t value) {
+    const uint32_t target = (value >> 17) % num_classes;
+    if(I % WORKLOAD_FPTR_EVERY == WORKLOAD_FPTR_EVERY - 1) {
+        return targets.functions[target](value) + I;
+    }
+    return targets.objects[target]->step(value) + I;
+}
+
+// Calls the sites 0 to N - 1 directly (dispatching through a table would
+// add an indirect call of its own).
+template<int N>
+struct Sites {
+    static uint64_t run(const Targets &targets, uint64_t value,
+                        uint32_t work) {
+        value = Sites<N - 1>::run(targets, value, work);
+        return do_work(call_site<N - 1>(targets, value), work);
+    }
+};
+
+template<>
+struct Sites<0> {
+    static uint64_t run(const Targets&, uint64_t value, uint32_t) {
+        return value;
+    }
+};
+
+void worker(const Targets *targets, uint64_t iterations, uint32_t work,
+            uint64_t seed, uint64_t *result) {
+    uint64_t value = seed;
+    for(uint64_t i = 0; i < iterations; i++) {
+        value = Sites<WORKLOAD_SITES>::run(*targets, value, work);
+    }
+    *result = value;
+}
+
+int usage() {
+    cerr << "Usage: workload [-threads N] [-iterations N] [-work N]" << endl;
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t num_threads = 1;
+    uint64_t iterations = 100000;
+    uint64_t work = 16;
+    for(int i = 1; i < argc; i++) {
+        if(i + 1 == argc) {
+            return usage();
+        }
+        uint64_t *option;
+        if(strcmp(argv[i], "-threads") == 0) {
+            option = &num_threads;
+        }
+        else if(strcmp(argv[i], "-iterations") == 0) {
+            option = &iterations;
+        }
+        else if(strcmp(argv[i], "-work") == 0) {
+            option = &work;
+        }
+        else {
+            return usage();
+        }
+        istringstream parser(argv[++i]);
+        parser >> dec >> *option;
+        if(parser.fail()) {
+            return usage();
+        }
+    }
+    if(num_threads == 0) {
+        return usage();
+    }
+
+    Derived<0> object0;
+    Derived<1> object1;
+    Derived<2> object2;
+    Derived<3> object3;
+    Derived<4> object4;
+    Derived<5> object5;
+    Derived<6> object6;
+    Derived<7> object7;
+    const Targets targets = {
+        {&object0, &object1, &object2, &object3,
+         &object4, &object5, &object6, &object7},
+        {&plain_step<0>, &plain_step<1>, &plain_step<2>, &plain_step<3>,
+         &plain_step<4>, &plain_step<5>, &plain_step<6>, &plain_step<7>}
+    };
+
+    vector<uint64_t> results(num_threads);
+    vector<thread> threads;
+    const auto start = chrono::steady_clock::now();
+    for(uint64_t i = 0; i < num_threads; i++) {
+        threads.push_back(thread(worker, &targets, iterations,
+                                 static_cast<uint32_t>(work), i + 1,
+                                 &results[i]));
+    }
+    uint64_t checksum = 0;
+    for(uint64_t i = 0; i < num_threads; i++) {
+        threads[i].join();
+        checksum ^= results[i];
+    }
+    const auto time_ms = chrono::duration_cast<chrono::milliseconds>(
+                                 chrono::steady_clock::now() - start).count();
+
+    cout << "sites " << dec << WORKLOAD_SITES << "\n"
+         << "threads " << dec << num_threads << "\n"
+         << "iterations " << dec << iterations << "\n"
+         << "work " << dec << work << "\n"
+         << "icalls " << dec << num_threads * iterations * WORKLOAD_SITES
+         << "\n"
+         << "time_ms " << dec << time_ms << "\n"
+         << "checksum " << hex << checksum << endl;
+    return 0;
+}
@@ -0,0 +1,741 @@
+/*
+
+Collects vcall targets at near-native speed (an alternative to the pintool
+in profiling.cpp) using the last branch records of the CPU sampled through
+perf_event_open. Only indirect calls in user space are recorded.
+
+Build the collector:
+    g++ -O2 -o lbr_profiling lbr_profiling.cpp
+
+Run the target under the collector:
+    ./lbr_profiling -in_vtables app_vtables.txt \
+        -in_candidate_vcalls app.vcalls_candidates \
+        -inout_positive_vcalls positive.txt \
+        -inout_negative_vcalls negative.txt -- ./app args
+
+As with the pintool, -in_vtables may be given once for each module and the
+three candidate options once for each module with candidates (in the same
+order), modules are identified by the name in the first line of their files.
+
+The collector cannot read the this pointer of a call like the pintool does.
+Instead, the target is stopped right before it exits (using ptrace) and the
+entries of all known vtables are read from its memory. A sampled candidate
+is added if any of its sampled targets is an entry of a known vtable and
+removed otherwise. Candidates that were never sampled stay undecided, the
+sample period (-period) trades accuracy against overhead. Needs a CPU with
+LBR support (and perf_event_paranoid allowing user space branch sampling).
+
+The sampling is inherited by all threads and child processes of the target.
+The kernel does not allow mapping the ring buffer of an inherited event that
+follows a task on all CPUs, hence one event (and ring buffer) is opened for
+each CPU that is online when the target starts.
+
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
+
+using namespace std;
+
+/* Number of data pages of each perf ring buffer (has to be a power of two).
+The buffers are drained every poll_interval_ms. */
+const size_t ring_buffer_pages = 64;
+const int poll_interval_ms = 100;
+
+// Largest number of entries read for a single vtable.
+const size_t max_vtable_entries = 1024;
+
+typedef set<uint64_t> AddressSet;
+
+// Module given by the files of the static analysis (static addresses).
+struct Module {
+    string name;
+    AddressSet vtables;
+    AddressSet candidate_vcalls;
+    AddressSet positive_vcalls;
+    AddressSet negative_vcalls;
+    string positive_vcalls_file;
+    string negative_vcalls_file;
+
+    // Set if the module is mapped when the target exits.
+    bool loaded;
+    uint64_t lo;
+    uint64_t hi;
+    uint64_t load_offset;
+};
+
+vector<Module*> global_modules;
+
+// Sampled targets of each indirect call site (runtime addresses).
+map<uint64_t, AddressSet> global_call_targets;
+
+// Executable mapping of the target.
+struct Mapping {
+    uint64_t lo;
+    uint64_t hi;
+    uint64_t offset;
+    bool executable;
+    string path;
+};
+
+Module *get_module(const string &name) {
+    for(size_t i = 0; i < global_modules.size(); i++) {
+        if(global_modules[i]->name == name) {
+            return global_modules[i];
+        }
+    }
+
+    Module *module = new Module;
+    module->name = name;
+    module->loaded = false;
+    module->lo = 0;
+    module->hi = 0;
+    module->load_offset = 0;
+    global_modules.push_back(module);
+    return module;
+}
+
+bool parse_vtables_file(const char *input_file) {
+    ifstream file(input_file);
+    if(!file) {
+        return false;
+    }
+    string line;
+
+    Module *module = 0;
+    while(getline(file, line)) {
+        istringstream parser(line);
+        if(module == 0) {
+            string module_name;
+            parser >> module_name;
+            module = get_module(module_name);
+            continue;
+        }
+
+        uint64_t vtable_addr = 0;
+        parser >> hex >> vtable_addr;
+        if(parser.fail()) {
+            return false;
+        }
+
+        module->vtables.insert(vtable_addr);
+    }
+
+    return true;
+}
+
+/* Parses the addresses of the given file into candidates. The module name
+in the first line has to match module_name (it is set if empty). */
+bool parse_candidates_file(const char *input_file, AddressSet &candidates,
+    string &module_name) {
+    candidates.clear();
+
+    ifstream file(input_file);
+    string line;
+
+    bool first = true;
+    while(getline(file, line)) {
+        istringstream parser(line);
+        if(first) {
+            string temp_name;
+            parser >> temp_name;
+            if(module_name == "") {
+                module_name = temp_name;
+            }
+            else if(temp_name != module_name) {
+                return false;
+            }
+
+            first = false;
+            continue;
+        }
+
+        uint64_t icall_addr = 0;
+        parser >> hex >> icall_addr;
+        if(parser.fail()) {
+            return false;
+        }
+
+        candidates.insert(icall_addr);
+    }
+
+    return true;
+}
+
+bool parse_module_candidates(const string &candidates_file,
+    const string &positive_file, const string &negative_file) {
+
+    AddressSet candidates;
+    string module_name;
+    if(!parse_candidates_file(candidates_file.c_str(), candidates,
+                              module_name)
+       || module_name == "") {
+        return false;
+    }
+
+    Module &module = *get_module(module_name);
+    module.candidate_vcalls.swap(candidates);
+    module.positive_vcalls_file = positive_file;
+    module.negative_vcalls_file = negative_file;
+    return parse_candidates_file(positive_file.c_str(),
+                                 module.positive_vcalls,
+                                 module_name)
+           && parse_candidates_file(negative_file.c_str(),
+                                    module.negative_vcalls,
+                                    module_name);
+}
+
+void write_candidates_file(const string &output_file,
+                           const string &module_name,
+                           const AddressSet &candidates) {
+
+    ofstream candidates_file(output_file.c_str());
+    candidates_file << module_name
+                    << "\n";
+    for(AddressSet::const_iterator it = candidates.begin();
+        it != candidates.end();
+        ++it) {
+
+        candidates_file << hex << *it
+                        << "\n";
+    }
+}
+
+void write_back_files() {
+    for(size_t i = 0; i < global_modules.size(); i++) {
+        const Module &module = *global_modules[i];
+        if(module.positive_vcalls_file == "") {
+            continue;
+        }
+
+        write_candidates_file(module.positive_vcalls_file,
+                              module.name,
+                              module.positive_vcalls);
+        write_candidates_file(module.negative_vcalls_file,
+                              module.name,
+                              module.negative_vcalls);
+    }
+}
+
+/* Opens the user space indirect call branch sampling of the given process
+(and the threads and processes it creates) on the given CPU. */
+int open_branch_sampling(pid_t pid, int cpu, uint64_t period) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+    attr.sample_period = period;
+    attr.sample_type = PERF_SAMPLE_BRANCH_STACK;
+    attr.branch_sample_type = PERF_SAMPLE_BRANCH_USER
+                              | PERF_SAMPLE_BRANCH_IND_CALL;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+
+    return syscall(__NR_perf_event_open, &attr, pid, cpu, -1, 0);
+}
+
+/* Opens the branch sampling on all online CPUs (offline CPUs are skipped).
+Returns false if it could not be opened on any CPU. */
+bool open_branch_sampling_all_cpus(pid_t pid, uint64_t period,
+                                   vector<int> &perf_fds) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    int error = ENODEV;
+    for(long cpu = 0; cpu < num_cpus; cpu++) {
+        int perf_fd = open_branch_sampling(pid, cpu, period);
+        if(perf_fd != -1) {
+            perf_fds.push_back(perf_fd);
+        }
+        else if(errno != ENODEV) {
+            error = errno;
+        }
+    }
+    errno = error;
+    return !perf_fds.empty();
+}
+
+/* Ring buffer of a perf event (one metadata page followed by the data
+pages). */
+class RingBuffer {
+private:
+    int _fd;
+    void *_base;
+    size_t _size;
+    vector<char> _record;
+
+public:
+    RingBuffer() : _fd(-1), _base(MAP_FAILED), _size(0) { }
+
+    RingBuffer(const RingBuffer&) = delete;
+    void operator=(const RingBuffer&) = delete;
+
+    ~RingBuffer() {
+        if(_base != MAP_FAILED) {
+            munmap(_base, (ring_buffer_pages + 1) * sysconf(_SC_PAGESIZE));
+        }
+    }
+
+    bool map_buffer(int fd) {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        _fd = fd;
+        _size = ring_buffer_pages * page_size;
+        _base = mmap(0, _size + page_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+        return _base != MAP_FAILED;
+    }
+
+    // Handles all samples that are available.
+    void drain() {
+        perf_event_mmap_page *meta =
+            static_cast<perf_event_mmap_page*>(_base);
+        const char *data = static_cast<const char*>(_base)
+                           + sysconf(_SC_PAGESIZE);
+
+        uint64_t head = meta->data_head;
+        __sync_synchronize();
+        uint64_t tail = meta->data_tail;
+
+        while(tail < head) {
+
+            // Records may wrap around the end of the buffer.
+            perf_event_header header;
+            copy_out(data, tail, &header, sizeof(header));
+            if(header.size < sizeof(header)) {
+                break;
+            }
+            _record.resize(header.size);
+            copy_out(data, tail, &_record[0], header.size);
+            tail += header.size;
+
+            if(header.type == PERF_RECORD_SAMPLE) {
+                handle_sample(&_record[sizeof(header)],
+                              header.size - sizeof(header));
+            }
+        }
+
+        __sync_synchronize();
+        meta->data_tail = tail;
+    }
+
+private:
+    void copy_out(const char *data, uint64_t position, void *target,
+                  size_t size) const {
+        size_t offset = position & (_size - 1);
+        size_t first = size < _size - offset ? size : _size - offset;
+        memcpy(target, data + offset, first);
+        memcpy(static_cast<char*>(target) + first, data, size - first);
+    }
+
+    // Layout for PERF_SAMPLE_BRANCH_STACK: u64 nr; perf_branch_entry[nr].
+    void handle_sample(const char *sample, size_t size) const {
+        if(size < sizeof(uint64_t)) {
+            return;
+        }
+        uint64_t num_entries;
+        memcpy(&num_entries, sample, sizeof(num_entries));
+        if(num_entries > (size - sizeof(uint64_t))
+                         / sizeof(perf_branch_entry)) {
+            return;
+        }
+
+        const char *entries = sample + sizeof(uint64_t);
+        for(uint64_t i = 0; i < num_entries; i++) {
+            perf_branch_entry entry;
+            memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+            global_call_targets[entry.from].insert(entry.to);
+        }
+    }
+};
+
+bool read_memory(int mem_fd, uint64_t address, void *target, size_t size) {
+    return pread(mem_fd, target, size, address) == static_cast<ssize_t>(size);
+}
+
+bool parse_mappings(pid_t pid, vector<Mapping> &mappings) {
+    ostringstream maps_file;
+    maps_file << "/proc/" << pid << "/maps";
+    ifstream file(maps_file.str().c_str());
+    if(!file) {
+        return false;
+    }
+
+    string line;
+    while(getline(file, line)) {
+        istringstream parser(line);
+        Mapping mapping;
+        string range, permissions, device;
+        uint64_t inode;
+        parser >> range >> permissions >> hex >> mapping.offset
+               >> device >> dec >> inode;
+        if(parser.fail()) {
+            continue;
+        }
+        parser >> mapping.path;
+
+        size_t separator = range.find('-');
+        if(separator == string::npos) {
+            continue;
+        }
+        mapping.lo = strtoull(range.substr(0, separator).c_str(), 0, 16);
+        mapping.hi = strtoull(range.substr(separator + 1).c_str(), 0, 16);
+        mapping.executable = permissions.size() > 2 && permissions[2] == 'x';
+        mappings.push_back(mapping);
+    }
+    return true;
+}
+
+/* Computes the load offset of the image mapped at base (the ELF header is
+mapped at the lowest address of the image). */
+bool get_load_offset(int mem_fd, uint64_t base, uint64_t &load_offset) {
+    Elf64_Ehdr header;
+    if(!read_memory(mem_fd, base, &header, sizeof(header))
+       || memcmp(header.e_ident, ELFMAG, SELFMAG) != 0) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < header.e_phnum; i++) {
+        Elf64_Phdr segment;
+        if(!read_memory(mem_fd, base + header.e_phoff + i * sizeof(segment),
+                        &segment, sizeof(segment))) {
+            return false;
+        }
+
+        // The first loaded segment holds the ELF header.
+        if(segment.p_type == PT_LOAD) {
+            uint64_t alignment = segment.p_align ? segment.p_align : 1;
+            load_offset = base - (segment.p_vaddr & ~(alignment - 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+// Records where the modules are mapped in the target.
+void find_modules(int mem_fd, const vector<Mapping> &mappings) {
+    for(size_t i = 0; i < global_modules.size(); i++) {
+        Module &module = *global_modules[i];
+        for(size_t j = 0; j < mappings.size(); j++) {
+            const Mapping &mapping = mappings[j];
+            size_t separator = mapping.path.rfind('/');
+            string name = separator == string::npos
+                          ? mapping.path
+                          : mapping.path.substr(separator + 1);
+            if(name != module.name) {
+                continue;
+            }
+
+            if(!module.loaded && mapping.offset == 0) {
+                module.loaded = get_load_offset(mem_fd, mapping.lo,
+                                                module.load_offset);
+                module.lo = mapping.lo;
+                module.hi = mapping.hi;
+            }
+            else if(module.loaded) {
+                module.lo = mapping.lo < module.lo ? mapping.lo : module.lo;
+                module.hi = mapping.hi > module.hi ? mapping.hi : module.hi;
+            }
+        }
+    }
+}
+
+bool is_executable(const vector<Mapping> &mappings, uint64_t address) {
+    for(size_t i = 0; i < mappings.size(); i++) {
+        if(mappings[i].executable
+           && address >= mappings[i].lo
+           && address < mappings[i].hi) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Reads all entries of the known vtables of the loaded modules (runtime
+addresses). Entries are read up to the first one not pointing to code. */
+void read_vtable_entries(int mem_fd, const vector<Mapping> &mappings,
+                         AddressSet &entries) {
+    for(size_t i = 0; i < global_modules.size(); i++) {
+        const Module &module = *global_modules[i];
+        if(!module.loaded) {
+            continue;
+        }
+
+        for(AddressSet::const_iterator it = module.vtables.begin();
+            it != module.vtables.end();
+            ++it) {
+
+            uint64_t address = *it + module.load_offset;
+            for(size_t j = 0; j < max_vtable_entries; j++) {
+                uint64_t entry;
+                if(!read_memory(mem_fd, address + j * sizeof(entry),
+                                &entry, sizeof(entry))
+                   || !is_executable(mappings, entry)) {
+                    break;
+                }
+                entries.insert(entry);
+            }
+        }
+    }
+}
+
+// Decides all sampled candidates that are not decided yet.
+void classify_candidates(const AddressSet &vtable_entries) {
+    size_t num_positive = 0;
+    size_t num_negative = 0;
+    for(map<uint64_t, AddressSet>::const_iterator it =
+            global_call_targets.begin();
+        it != global_call_targets.end();
+        ++it) {
+
+        Module *module = 0;
+        for(size_t i = 0; i < global_modules.size(); i++) {
+            if(global_modules[i]->loaded
+               && it->first >= global_modules[i]->lo
+               && it->first < global_modules[i]->hi) {
+                module = global_modules[i];
+                break;
+            }
+        }
+        if(module == 0) {
+            continue;
+        }
+
+        uint64_t instr_addr = it->first - module->load_offset;
+        if(module->candidate_vcalls.find(instr_addr)
+               == module->candidate_vcalls.end()
+           || module->positive_vcalls.count(instr_addr)
+           || module->negative_vcalls.count(instr_addr)) {
+            continue;
+        }
+
+        bool positive = false;
+        for(AddressSet::const_iterator target = it->second.begin();
+            target != it->second.end();
+            ++target) {
+
+            if(vtable_entries.count(*target)) {
+                positive = true;
+                break;
+            }
+        }
+
+        if(positive) {
+            module->positive_vcalls.insert(instr_addr);
+            num_positive++;
+        }
+        else {
+            module->negative_vcalls.insert(instr_addr);
+            num_negative++;
+        }
+    }
+
+    cout << "Sampled " << dec << global_call_targets.size()
+         << " indirect call sites, added "
+         << num_positive
+         << " and removed "
+         << num_negative
+         << " candidates."
+         << endl;
+}
+
+int usage() {
+    cerr << "Usage: lbr_profiling -in_vtables <file> [-in_vtables <file>...]"
+         << " -in_candidate_vcalls <file> -inout_positive_vcalls <file>"
+         << " -inout_negative_vcalls <file> [...] [-period <n>]"
+         << " -- <command> [args...]"
+         << endl;
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    vector<string> vtable_files;
+    vector<string> candidate_files;
+    vector<string> positive_files;
+    vector<string> negative_files;
+    uint64_t period = 10007;
+
+    int command_index = -1;
+    for(int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if(option == "--") {
+            command_index = i + 1;
+            break;
+        }
+        if(i + 1 >= argc) {
+            return usage();
+        }
+
+        string value = argv[++i];
+        if(option == "-in_vtables") {
+            vtable_files.push_back(value);
+        }
+        else if(option == "-in_candidate_vcalls") {
+            candidate_files.push_back(value);
+        }
+        else if(option == "-inout_positive_vcalls") {
+            positive_files.push_back(value);
+        }
+        else if(option == "-inout_negative_vcalls") {
+            negative_files.push_back(value);
+        }
+        else if(option == "-period") {
+            period = strtoull(value.c_str(), 0, 10);
+        }
+        else {
+            return usage();
+        }
+    }
+
+    if(command_index == -1 || command_index >= argc
+       || vtable_files.empty() || candidate_files.empty()
+       || positive_files.size() != candidate_files.size()
+       || negative_files.size() != candidate_files.size()
+       || period == 0) {
+        return usage();
+    }
+
+    for(size_t i = 0; i < vtable_files.size(); i++) {
+        if(!parse_vtables_file(vtable_files[i].c_str())) {
+            cerr << "Could not parse the vtables file." << endl;
+            return -1;
+        }
+    }
+    for(size_t i = 0; i < candidate_files.size(); i++) {
+        if(!parse_module_candidates(candidate_files[i],
+                                    positive_files[i],
+                                    negative_files[i])) {
+            cerr << "Could not parse the candidates files of "
+                 << candidate_files[i]
+                 << "."
+                 << endl;
+            return -1;
+        }
+    }
+
+    // The child stops itself before exec so that the sampling can be
+    // attached (it is enabled by the exec).
+    pid_t child = fork();
+    if(child == -1) {
+        cerr << "Could not fork." << endl;
+        return -1;
+    }
+    if(child == 0) {
+        ptrace(PTRACE_TRACEME, 0, 0, 0);
+        raise(SIGSTOP);
+        execvp(argv[command_index], &argv[command_index]);
+        _exit(127);
+    }
+
+    int status;
+    if(waitpid(child, &status, 0) != child || !WIFSTOPPED(status)) {
+        cerr << "Could not start the target." << endl;
+        return -1;
+    }
+
+    // Stop the target once more right before it exits (while its memory
+    // is still mapped).
+    ptrace(PTRACE_SETOPTIONS, child, 0,
+           PTRACE_O_TRACEEXIT | PTRACE_O_EXITKILL);
+
+    vector<int> perf_fds;
+    bool is_open = open_branch_sampling_all_cpus(child, period, perf_fds);
+    vector<RingBuffer> ring_buffers(perf_fds.size());
+    for(size_t i = 0; is_open && i < perf_fds.size(); i++) {
+        is_open = ring_buffers[i].map_buffer(perf_fds[i]);
+    }
+    if(!is_open) {
+        cerr << "Could not open the branch sampling: "
+             << strerror(errno)
+             << endl;
+        kill(child, SIGKILL);
+        return -1;
+    }
+    ptrace(PTRACE_CONT, child, 0, 0);
+
+    vector<pollfd> poll_fds(perf_fds.size());
+    for(size_t i = 0; i < perf_fds.size(); i++) {
+        poll_fds[i].fd = perf_fds[i];
+        poll_fds[i].events = POLLIN;
+    }
+
+    bool exiting = false;
+    while(!exiting) {
+        poll(&poll_fds[0], poll_fds.size(), poll_interval_ms);
+        for(size_t i = 0; i < ring_buffers.size(); i++) {
+            ring_buffers[i].drain();
+        }
+
+        pid_t result = waitpid(child, &status, WNOHANG);
+        if(result != child) {
+            continue;
+        }
+        if(WIFEXITED(status) || WIFSIGNALED(status)) {
+            cerr << "Target terminated before it could be inspected." << endl;
+            return -1;
+        }
+
+        // Forward all signals except the stops caused by ptrace.
+        int signal_number = WSTOPSIG(status);
+        if(status >> 8 == (SIGTRAP | (PTRACE_EVENT_EXIT << 8))) {
+            exiting = true;
+        }
+        else {
+            if(signal_number == SIGTRAP) {
+                signal_number = 0;
+            }
+            ptrace(PTRACE_CONT, child, 0, signal_number);
+        }
+    }
+    for(size_t i = 0; i < ring_buffers.size(); i++) {
+        ring_buffers[i].drain();
+    }
+
+    // Resolve the samples against the vtables of the stopped target.
+    ostringstream mem_file;
+    mem_file << "/proc/" << child << "/mem";
+    int mem_fd = open(mem_file.str().c_str(), O_RDONLY);
+    vector<Mapping> mappings;
+    if(mem_fd == -1 || !parse_mappings(child, mappings)) {
+        cerr << "Could not inspect the target." << endl;
+        ptrace(PTRACE_CONT, child, 0, 0);
+        return -1;
+    }
+
+    find_modules(mem_fd, mappings);
+    AddressSet vtable_entries;
+    read_vtable_entries(mem_fd, mappings, vtable_entries);
+    close(mem_fd);
+    for(size_t i = 0; i < perf_fds.size(); i++) {
+        close(perf_fds[i]);
+    }
+
+    ptrace(PTRACE_CONT, child, 0, 0);
+    waitpid(child, &status, 0);
+
+    classify_candidates(vtable_entries);
+    write_back_files();
+    cout << "Done." << endl;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
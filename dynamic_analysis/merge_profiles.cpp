@@ -0,0 +1,499 @@
+/*
+
+Merges the positive and negative candidate files of many profiled processes
+(the pintool in profiling.cpp and lbr_profiling.cpp append the pid of the
+process to every file they write back) into one result per module that is
+read by the static analysis.
+
+Build the merger:
+    g++ -O2 -pthread -o merge_profiles merge_profiles.cpp
+
+Merge the files of all processes:
+    ./merge_profiles -positive farm/positive.txt -negative farm/negative.txt \
+        -out_dir feedback [-threads 16] [-conflicts negative] [-text]
+
+-positive and -negative may be given multiple times. A value is either a
+file, a directory (all files in it) or the name the processes were given
+(all files <value>_<pid>). Text and binary files (see address_list_file.h)
+may be mixed, files of different modules as well. The files are read in
+parallel (-threads, all cores by default).
+
+A candidate is confirmed if a process found a known vtable for it. If
+another process found it without one, -conflicts decides:
+    negative  the candidate is negative (default, the pintool drops a
+              candidate on the first execution without a known vtable too)
+    positive  the candidate is confirmed
+    drop      the candidate is neither confirmed nor negative
+
+For each module the files
+    <out_dir>/<module>_dynamic_vcalls.marx_addr
+    <out_dir>/<module>_dynamic_non_vcalls.marx_addr
+are written with the confirmed and the negative candidates (.txt files in
+the text format with -text). marx queues the confirmed vcalls of a module
+directly for the icall analysis if the config option DYNAMICVCALLS
+<out_dir> is given.
+
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../static_analysis/include/address_list_file.h"
+
+using namespace std;
+
+enum Conflicts {
+    CONFLICTS_NEGATIVE,
+    CONFLICTS_POSITIVE,
+    CONFLICTS_DROP
+};
+
+// Input file together with the verdict of all addresses in it.
+struct InputFile {
+    string name;
+    bool positive;
+};
+
+// Verdicts found for one module (unsorted, with duplicates until merged).
+struct ModuleVerdicts {
+    vector<uint64_t> positive;
+    vector<uint64_t> negative;
+};
+
+typedef map<string, ModuleVerdicts> ModuleVerdictsMap;
+
+// Read-only mapping of a whole file.
+class MappedInput {
+private:
+    void *_data;
+    size_t _size;
+
+public:
+    MappedInput(const char *file_name) : _data(MAP_FAILED), _size(0) {
+        int fd = open(file_name, O_RDONLY);
+        if(fd == -1) {
+            return;
+        }
+
+        struct stat file_stat;
+        if(fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+            _size = file_stat.st_size;
+            _data = mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+    }
+
+    ~MappedInput() {
+        if(_data != MAP_FAILED) {
+            munmap(_data, _size);
+        }
+    }
+
+    // Returns the content (0 if the file could not be mapped).
+    const uint8_t *data() const {
+        return _data == MAP_FAILED ? 0 : static_cast<const uint8_t*>(_data);
+    }
+
+    size_t size() const {
+        return _data == MAP_FAILED ? 0 : _size;
+    }
+};
+
+bool is_directory(const string &path) {
+    struct stat path_stat;
+    return stat(path.c_str(), &path_stat) == 0 && S_ISDIR(path_stat.st_mode);
+}
+
+bool is_regular_file(const string &path) {
+    struct stat path_stat;
+    return stat(path.c_str(), &path_stat) == 0 && S_ISREG(path_stat.st_mode);
+}
+
+bool ends_with(const string &value, const string &suffix) {
+    return value.size() >= suffix.size()
+           && value.compare(value.size() - suffix.size(), suffix.size(),
+                            suffix) == 0;
+}
+
+/* Adds the files given by the value of -positive or -negative. Temporary
+files of an unfinished write and journals are skipped. */
+bool collect_files(const string &value, bool positive,
+                   vector<InputFile> &files) {
+
+    if(is_regular_file(value)) {
+        InputFile file = {value, positive};
+        files.push_back(file);
+        return true;
+    }
+
+    // A directory or the prefix of the per-pid files in a directory.
+    bool is_prefix = !is_directory(value);
+    string dir_name = value;
+    string prefix;
+    if(is_prefix) {
+        size_t separator = value.rfind('/');
+        dir_name = separator == string::npos ? "." : value.substr(0, separator);
+        prefix = value.substr(separator == string::npos ? 0 : separator + 1)
+                 + "_";
+    }
+
+    DIR *dir = opendir(dir_name.c_str());
+    if(dir == 0) {
+        return false;
+    }
+    size_t num_files = files.size();
+    struct dirent *entry;
+    while((entry = readdir(dir)) != 0) {
+        string name = entry->d_name;
+        if(ends_with(name, ".tmp") || name.find(".journal") != string::npos) {
+            continue;
+        }
+        if(is_prefix) {
+            if(name.compare(0, prefix.size(), prefix) != 0
+               || name.size() == prefix.size()
+               || name.find_first_not_of("0123456789", prefix.size())
+                  != string::npos) {
+                continue;
+            }
+        }
+
+        string path = dir_name + "/" + name;
+        if(!is_regular_file(path)) {
+            continue;
+        }
+        InputFile file = {path, positive};
+        files.push_back(file);
+    }
+    closedir(dir);
+
+    // The order of a directory listing is arbitrary.
+    sort(files.begin() + num_files, files.end(),
+         [](const InputFile &a, const InputFile &b) {
+             return a.name < b.name;
+         });
+    return files.size() > num_files;
+}
+
+int hex_digit(uint8_t c) {
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Parses a text file in place: the module name in the first line followed
+by one hex address per line (empty lines are ignored). */
+bool parse_text(const uint8_t *data, size_t size, string &module_name,
+                vector<uint64_t> &addresses) {
+
+    const uint8_t *end = data + size;
+    const uint8_t *pos = data;
+    while(pos != end && *pos != '\n' && *pos != ' ' && *pos != '\t'
+          && *pos != '\r') {
+        pos++;
+    }
+    module_name.assign(reinterpret_cast<const char*>(data), pos - data);
+    while(pos != end && *pos != '\n') {
+        pos++;
+    }
+    if(module_name.empty()) {
+        return false;
+    }
+
+    while(pos != end) {
+        while(pos != end && (*pos == '\n' || *pos == ' ' || *pos == '\t'
+                             || *pos == '\r')) {
+            pos++;
+        }
+        if(pos == end) {
+            break;
+        }
+        if(end - pos > 2 && pos[0] == '0' && (pos[1] == 'x' || pos[1] == 'X')) {
+            pos += 2;
+        }
+
+        uint64_t address = 0;
+        int digit;
+        size_t num_digits = 0;
+        while(pos != end && (digit = hex_digit(*pos)) != -1) {
+            address = (address << 4) | digit;
+            num_digits++;
+            pos++;
+        }
+        if(num_digits == 0 || num_digits > 16
+           || (pos != end && *pos != '\n' && *pos != '\r' && *pos != ' '
+               && *pos != '\t')) {
+            return false;
+        }
+        addresses.push_back(address);
+    }
+    return true;
+}
+
+/* Reads the given file into the verdicts of its module. */
+bool read_file(const InputFile &file, ModuleVerdictsMap &verdicts) {
+    MappedInput input(file.name.c_str());
+    if(input.data() == 0) {
+        return false;
+    }
+
+    string module_name;
+    if(is_address_list(input.data(), input.size())) {
+        const uint64_t *addresses;
+        uint64_t count;
+        if(!parse_address_list(input.data(), input.size(), module_name,
+                               addresses, count)) {
+            return false;
+        }
+        ModuleVerdicts &module = verdicts[module_name];
+        vector<uint64_t> &target = file.positive ? module.positive
+                                                 : module.negative;
+        target.insert(target.end(), addresses, addresses + count);
+        return true;
+    }
+
+    vector<uint64_t> addresses;
+    if(!parse_text(input.data(), input.size(), module_name, addresses)) {
+        return false;
+    }
+    ModuleVerdicts &module = verdicts[module_name];
+    vector<uint64_t> &target = file.positive ? module.positive
+                                             : module.negative;
+    target.insert(target.end(), addresses.begin(), addresses.end());
+    return true;
+}
+
+// Shared state of the reading threads.
+struct ReadState {
+    const vector<InputFile> *files;
+    atomic<size_t> next_file;
+    atomic<size_t> num_failed;
+    mutex error_mtx;
+};
+
+void read_thread(ReadState *state, ModuleVerdictsMap *verdicts) {
+    const vector<InputFile> &files = *state->files;
+    while(true) {
+        size_t index = state->next_file.fetch_add(1);
+        if(index >= files.size()) {
+            break;
+        }
+        if(!read_file(files[index], *verdicts)) {
+            state->num_failed++;
+            lock_guard<mutex> lock(state->error_mtx);
+            cerr << "Could not parse " << files[index].name << "." << endl;
+        }
+    }
+}
+
+void sort_unique(vector<uint64_t> &addresses) {
+    sort(addresses.begin(), addresses.end());
+    addresses.erase(unique(addresses.begin(), addresses.end()),
+                    addresses.end());
+}
+
+bool write_result(const string &file_name, const string &module_name,
+                  const vector<uint64_t> &addresses, bool text) {
+    if(!text) {
+        return write_address_list(file_name, module_name,
+                                  addresses.empty() ? 0 : &addresses[0],
+                                  addresses.size());
+    }
+
+    ofstream file(file_name.c_str());
+    file << module_name << "\n";
+    for(size_t i = 0; i < addresses.size(); i++) {
+        file << hex << addresses[i] << "\n";
+    }
+    file.close();
+    return !file.fail();
+}
+
+int usage() {
+    cerr << "Usage: merge_profiles -positive <file|dir|prefix> "
+         << "-negative <file|dir|prefix> -out_dir <dir> "
+         << "[-threads <num>] [-conflicts negative|positive|drop] [-text]"
+         << endl;
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    vector<string> positive_values;
+    vector<string> negative_values;
+    string out_dir;
+    size_t num_threads = thread::hardware_concurrency();
+    Conflicts conflicts = CONFLICTS_NEGATIVE;
+    bool text = false;
+
+    for(int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if(option == "-text") {
+            text = true;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            return usage();
+        }
+
+        string value = argv[++i];
+        if(option == "-positive") {
+            positive_values.push_back(value);
+        }
+        else if(option == "-negative") {
+            negative_values.push_back(value);
+        }
+        else if(option == "-out_dir") {
+            out_dir = value;
+        }
+        else if(option == "-threads") {
+            num_threads = strtoull(value.c_str(), 0, 10);
+        }
+        else if(option == "-conflicts") {
+            if(value == "negative") {
+                conflicts = CONFLICTS_NEGATIVE;
+            }
+            else if(value == "positive") {
+                conflicts = CONFLICTS_POSITIVE;
+            }
+            else if(value == "drop") {
+                conflicts = CONFLICTS_DROP;
+            }
+            else {
+                return usage();
+            }
+        }
+        else {
+            return usage();
+        }
+    }
+    if(out_dir == "" || (positive_values.empty() && negative_values.empty())) {
+        return usage();
+    }
+    if(num_threads == 0) {
+        num_threads = 1;
+    }
+
+    vector<InputFile> files;
+    for(size_t i = 0; i < positive_values.size(); i++) {
+        if(!collect_files(positive_values[i], true, files)) {
+            cerr << "No files found for " << positive_values[i] << "." << endl;
+            return 1;
+        }
+    }
+    for(size_t i = 0; i < negative_values.size(); i++) {
+        if(!collect_files(negative_values[i], false, files)) {
+            cerr << "No files found for " << negative_values[i] << "." << endl;
+            return 1;
+        }
+    }
+    num_threads = min(num_threads, files.size());
+
+    // Each thread collects the verdicts of its files separately.
+    ReadState state;
+    state.files = &files;
+    state.next_file = 0;
+    state.num_failed = 0;
+    vector<ModuleVerdictsMap> thread_verdicts(num_threads);
+    vector<thread> threads;
+    for(size_t i = 0; i < num_threads; i++) {
+        threads.push_back(thread(read_thread, &state, &thread_verdicts[i]));
+    }
+    for(size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    ModuleVerdictsMap verdicts;
+    for(size_t i = 0; i < thread_verdicts.size(); i++) {
+        for(ModuleVerdictsMap::iterator it = thread_verdicts[i].begin();
+            it != thread_verdicts[i].end();
+            ++it) {
+            ModuleVerdicts &module = verdicts[it->first];
+            module.positive.insert(module.positive.end(),
+                                   it->second.positive.begin(),
+                                   it->second.positive.end());
+            module.negative.insert(module.negative.end(),
+                                   it->second.negative.begin(),
+                                   it->second.negative.end());
+        }
+        thread_verdicts[i].clear();
+    }
+
+    cout << "Read " << dec << files.size() - state.num_failed
+         << " of " << dec << files.size() << " files." << endl;
+
+    bool success = state.num_failed == 0;
+    for(ModuleVerdictsMap::iterator it = verdicts.begin();
+        it != verdicts.end();
+        ++it) {
+        const string &module_name = it->first;
+        vector<uint64_t> &positive = it->second.positive;
+        vector<uint64_t> &negative = it->second.negative;
+        sort_unique(positive);
+        sort_unique(negative);
+
+        vector<uint64_t> conflicting;
+        set_intersection(positive.begin(), positive.end(),
+                         negative.begin(), negative.end(),
+                         back_inserter(conflicting));
+
+        vector<uint64_t> confirmed;
+        vector<uint64_t> rejected;
+        if(conflicts == CONFLICTS_POSITIVE) {
+            confirmed.swap(positive);
+        }
+        else {
+            set_difference(positive.begin(), positive.end(),
+                           conflicting.begin(), conflicting.end(),
+                           back_inserter(confirmed));
+        }
+        if(conflicts == CONFLICTS_NEGATIVE) {
+            rejected.swap(negative);
+        }
+        else {
+            set_difference(negative.begin(), negative.end(),
+                           conflicting.begin(), conflicting.end(),
+                           back_inserter(rejected));
+        }
+
+        string extension = text ? ".txt" : ADDRESS_LIST_FILE_EXTENSION;
+        string base = out_dir + "/" + module_name;
+        if(!write_result(base + "_dynamic_vcalls" + extension, module_name,
+                         confirmed, text)
+           || !write_result(base + "_dynamic_non_vcalls" + extension,
+                            module_name, rejected, text)) {
+            cerr << "Could not write the results of " << module_name << "."
+                 << endl;
+            success = false;
+            continue;
+        }
+
+        cout << module_name << ": "
+             << dec << confirmed.size() << " confirmed, "
+             << dec << rejected.size() << " negative, "
+             << dec << conflicting.size() << " conflicting." << endl;
+    }
+    return success ? 0 : 1;
+}
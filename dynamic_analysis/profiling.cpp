@@ -13,9 +13,19 @@ Compile the sample and update the policy three.txt accordingly:
 Finally, instrument the sample using the pintool:
     pin -t obj-ia32/instrument.so -callsite_info three.txt -- ./three 1>/dev/null
 
+Shared libraries are profiled in the same run by giving the files of each
+module: -in_vtables may be given once for each module, -in_candidate_vcalls,
+-inout_positive_vcalls and -inout_negative_vcalls once for each module with
+candidates (in the same order). Modules are identified by the name in the
+first line of their files, which is the file name of the image.
+
 Policy three.txt allows all vtables found by the static analysis, whereas
 bad_three.txt misses a valid vtable for testing purposes.
 
+The overhead of the tool is measured on synthetic workloads with a given
+number of call sites, threads and vcall density, see
+benchmark/run_benchmark.sh.
+
 */
 
 #include <iostream>
@@ -24,12 +34,19 @@ bad_three.txt misses a valid vtable for testing purposes.
 #include <sstream>
 #include <iomanip>
 #include <string>
+#include <algorithm>
 #include <map>
 #include <set>
+#include <vector>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <pin.H>
 
+#include "../static_analysis/include/address_list_file.h"
+
 using namespace std;
 
 /* Future work, both architecture and compiler setting may influence how we
@@ -52,23 +69,176 @@ const COMPILERS     compiler     = COMPILER_GCC;
  for analysis). */
 const bool append_pid = true;
 
-/* Set if we should write back our data everytime it changes.
-This will consume a lot of performance, however it avoids
-data loss on crashing. */
+/* Set if we should journal our data everytime it changes (see
+journal_thread()). This avoids data loss on crashing, the candidate files
+themselves are only written back at the end. */
 const bool always_write_back = true;
 
-ADDRINT module_lo = 0, module_hi = 0;
+/* Interval in which the journal thread appends new decisions to the
+journal and syncs it to disk. */
+const UINT32 journal_interval_ms = 200;
+
+/* Sampling mode (-sample_interval and -samples): each thread verifies one
+in every sample_interval executions of the candidates, a candidate is only
+added after samples_per_site verified executions with a known vtable (it is
+removed by the first one without). */
+ADDRINT sample_interval = 1;
+ADDRINT samples_per_site = 1;
+
+/* Tool register holding the number of executions of candidates left until
+the calling thread takes its next sample. */
+REG sample_counter_register;
+
 ofstream out_file;
 
 typedef set<ADDRINT> AddressSet;
 
-AddressSet global_vtables;
-AddressSet global_vcall_candidates;
-AddressSet global_positive_vcalls;
-AddressSet global_negative_vcalls;
-AddressSet global_candidate_vcalls;
+/* Largest number of bits the vtable bitmap may use (16 MiB), sets of vtables
+spanning a larger range are searched in a sorted array instead. */
+const ADDRINT max_vtable_bitmap_bits = ADDRINT(1) << 27;
+
+/* Flat lookup table for the vtables built once at startup (the lookup is
+done for every verified call). Vtables are covered by a bitmap over the
+range from the lowest to the highest vtable, one bit for each pointer-sized
+slot (or each byte if a vtable is not pointer-aligned). */
+class VtableTable {
+private:
+    ADDRINT _lo;
+    ADDRINT _hi;
+    UINT32 _shift;
+    vector<UINT64> _bitmap;
+    vector<ADDRINT> _sorted;
+
+public:
+    VtableTable() : _lo(1), _hi(0), _shift(0) { }
+
+    // Builds the table from the given addresses (sorted in ascending order).
+    template<typename Iterator>
+    void build(Iterator begin, Iterator end) {
+        _bitmap.clear();
+        _sorted.clear();
+        if(begin == end) {
+            _lo = 1;
+            _hi = 0;
+            return;
+        }
+        _lo = *begin;
+
+        _shift = 3;
+        for(Iterator it = begin; it != end; ++it) {
+            _hi = *it;
+            if(*it & (sizeof(ADDRINT) - 1)) {
+                _shift = 0;
+            }
+        }
+
+        ADDRINT num_bits = ((_hi - _lo) >> _shift) + 1;
+        if(num_bits > max_vtable_bitmap_bits) {
+            _sorted.assign(begin, end);
+            return;
+        }
+        _bitmap.assign((num_bits + 63) / 64, 0);
+        for(Iterator it = begin; it != end; ++it) {
+            ADDRINT bit = (*it - _lo) >> _shift;
+            _bitmap[bit / 64] |= UINT64(1) << (bit % 64);
+        }
+    }
+
+    bool contains(ADDRINT address) const {
+        if(address < _lo || address > _hi) {
+            return false;
+        }
+        if(_bitmap.empty()) {
+            return binary_search(_sorted.begin(), _sorted.end(), address);
+        }
 
-string module_name = "";
+        ADDRINT offset = address - _lo;
+        if(offset & ((ADDRINT(1) << _shift) - 1)) {
+            return false;
+        }
+        ADDRINT bit = offset >> _shift;
+        return (_bitmap[bit / 64] >> (bit % 64)) & 1;
+    }
+};
+
+// Entry of the decision table of a module.
+struct Site {
+    ADDRINT decided;
+    ADDRINT samples;
+};
+
+/* Module (main executable or shared library) given by the files of the
+static analysis. All addresses it holds are the ones of the static
+analysis, i.e., the addresses at the module's link address. */
+struct Module {
+    UINT32 index;
+    string name;
+    VtableTable vtables;
+    AddressSet candidate_vcalls;
+    AddressSet positive_vcalls;
+    AddressSet negative_vcalls;
+    string positive_vcalls_file;
+    string negative_vcalls_file;
+
+    /* Shared decision table: one entry for each candidate with a flag that
+    is set as soon as it is decided and the number of samples found a known
+    vtable. The table is built before the program starts and never changes
+    its layout afterwards (nodes of a map never move), so the entries are
+    passed to the analysis routines by pointer. A flag is claimed by a
+    compare-and-swap, hence each candidate is decided by exactly one
+    thread. */
+    map<ADDRINT, Site> sites;
+
+    /* Address range and load offset of the image while it is loaded (set
+    by the image callbacks before loaded is set). */
+    ADDRINT lo;
+    ADDRINT hi;
+    ADDRINT load_offset;
+    volatile bool loaded;
+};
+
+/* All modules, the vector is not modified after startup (the analysis
+routines search it for the module holding a vtable). */
+vector<Module*> global_modules;
+
+Module *get_module(const string &name) {
+    for(size_t i = 0; i < global_modules.size(); i++) {
+        if(global_modules[i]->name == name) {
+            return global_modules[i];
+        }
+    }
+
+    Module *module = new Module;
+    module->index = global_modules.size();
+    module->name = name;
+    module->lo = 0;
+    module->hi = 0;
+    module->load_offset = 0;
+    module->loaded = false;
+    global_modules.push_back(module);
+    return module;
+}
+
+bool is_inside_module(const Module &module, ADDRINT address) {
+    return module.loaded && address >= module.lo && address <= module.hi;
+}
+
+// Returns the loaded module holding the given address (if any).
+Module *find_loaded_module(ADDRINT address) {
+    for(size_t i = 0; i < global_modules.size(); i++) {
+        if(is_inside_module(*global_modules[i], address)) {
+            return global_modules[i];
+        }
+    }
+    return 0;
+}
+
+// Checks if the given vtable pointer is a vtable of any loaded module.
+bool is_known_vtable(ADDRINT vtbl_pointer) {
+    Module *module = find_loaded_module(vtbl_pointer);
+    return module != 0
+           && module->vtables.contains(vtbl_pointer - module->load_offset);
+}
 
 void write_back_files();
 
@@ -88,14 +258,10 @@ inline SaneHex hex(ADDRINT value) {
     return SaneHex(value);
 }
 
-// get this pointer for x86 cdecl
-inline ADDRINT get_this_pointer_x86(CONTEXT * context) {
-
-    // get content of esp
-    ADDRINT stack_pointer, this_pointer;
-    PIN_GetContextRegval(context, REG_ESP,
-        reinterpret_cast<UINT8*>(&stack_pointer));
+// get this pointer for x86 cdecl (the value is the content of esp)
+inline ADDRINT get_this_pointer_x86(ADDRINT stack_pointer) {
 
+    ADDRINT this_pointer;
     if(PIN_SafeCopy(&this_pointer, reinterpret_cast<void*>(stack_pointer),
         sizeof(this_pointer)) != sizeof(this_pointer)) {
         return 0;
@@ -106,69 +272,178 @@ inline ADDRINT get_this_pointer_x86(CONTEXT * context) {
 }
 
 // GCC x86_64 => this in RDI
-inline ADDRINT get_this_pointer_x64(CONTEXT * context) {
-    // get content of rdi
-    ADDRINT this_pointer;
-    PIN_GetContextRegval(context, REG_RDI,
-        reinterpret_cast<UINT8*>(&this_pointer));
-
-    return this_pointer;
+inline ADDRINT get_this_pointer_x64(ADDRINT rdi) {
+    return rdi;
 }
 
-// wrapper function for all architectures
-inline ADDRINT get_this_pointer(CONTEXT * context) {
+// wrapper function for all architectures, the value is the content
+// of the register returned by this_pointer_register()
+inline ADDRINT get_this_pointer(ADDRINT register_value) {
     switch(architecture) {
         case ARCH_X86:
-            return get_this_pointer_x86(context);
+            return get_this_pointer_x86(register_value);
         case ARCH_X64:
-            return get_this_pointer_x64(context);
+            return get_this_pointer_x64(register_value);
         default:
             PIN_ExitApplication(-1);
     }
     
 }
 
-void verify_call(ADDRINT instr_addr, ADDRINT target_addr,
-    CONTEXT *context) {
+// register holding the this pointer (or the stack it is stored on)
+inline REG this_pointer_register() {
+    switch(architecture) {
+        case ARCH_X86:
+            return REG_ESP;
+        case ARCH_X64:
+            return REG_RDI;
+        default:
+            PIN_ExitApplication(-1);
+    }
+
+}
+
+/* Number of decisions a thread buffers before they are merged into the
+sets of the modules (decisions are merged at once if always_write_back is set, so
+the journal thread picks them up within journal_interval_ms). */
+const size_t merge_threshold = 64;
+
+// Decision about a candidate buffered by the thread that made it.
+struct Decision {
+    Module *module;
+    ADDRINT instr_addr;
+    bool positive;
+    string message;
+};
 
-    // Only process vcall candidates.
-    if(global_candidate_vcalls.find(instr_addr)
-       == global_candidate_vcalls.end()) {
-        return;
+// Per-thread state (Pin TLS).
+struct ThreadData {
+    vector<Decision> decisions;
+};
+
+TLS_KEY thread_data_key;
+
+/* Record of the journal, i.e., the file "<inout_positive_vcalls>.journal"
+(with the pid appended if enabled). Records are only ever appended, a
+record cut off by a crash shows as trailing bytes after the last
+complete record. Modules are numbered in the order their files were given
+(vtable files first). */
+struct JournalRecord {
+    UINT64 instr_addr;
+    UINT32 module;
+    UINT32 positive;
+};
+
+/* Guards the sets of the modules, out_file, pending_journal and
+all_thread_data. Only taken when decisions are merged and by the journal
+thread. */
+PIN_LOCK merge_lock;
+vector<ThreadData*> all_thread_data;
+vector<JournalRecord> pending_journal;
+
+int journal_fd = -1;
+volatile bool journal_stop = false;
+PIN_THREAD_UID journal_thread_uid;
+
+/* Fast path checked before every execution of a candidate. It is simple
+enough to be inlined by Pin, verify_call only runs if it returns non-zero,
+i.e., if the candidate is not decided and the thread takes its sample
+(verify_call resets the counter of the thread). Decided candidates must not
+touch the counter since nothing would reset it once it reaches 0. */
+ADDRINT should_verify(ADDRINT *decided, ADDRINT *counter) {
+    if(*decided) {
+        return 0;
     }
+    return --*counter == 0;
+}
 
-    // Ignore call instruction if we already consider it as _NOT_ a vcall.
-    if(global_negative_vcalls.find(instr_addr)
-       != global_negative_vcalls.end()) {
+// Moves the buffered decisions of the given thread into the modules' sets.
+void merge_decisions(ThreadData &data, THREADID thread_id) {
+    if(data.decisions.empty()) {
         return;
     }
 
-    // Ignore call instruction if we already consider it as vcall.
-    if(global_positive_vcalls.find(instr_addr)
-       != global_positive_vcalls.end()) {
+    PIN_GetLock(&merge_lock, thread_id + 1);
+    for(size_t i = 0; i < data.decisions.size(); i++) {
+        const Decision &decision = data.decisions[i];
+        out_file << decision.message << "\n";
+        if(decision.positive) {
+            decision.module->positive_vcalls.insert(decision.instr_addr);
+        }
+        else {
+            decision.module->negative_vcalls.insert(decision.instr_addr);
+        }
+
+        // The journal thread writes the record out.
+        if(always_write_back) {
+            JournalRecord record;
+            record.instr_addr = decision.instr_addr;
+            record.module = decision.module->index;
+            record.positive = decision.positive ? 1 : 0;
+            pending_journal.push_back(record);
+        }
+    }
+    PIN_ReleaseLock(&merge_lock);
+
+    data.decisions.clear();
+}
+
+/* Stores the decision for a candidate and drops the instrumentation of its
+call site. The trace holding the call site is instrumented again without
+verify_call once it is left (see on_trace()). */
+void classify_candidate(Module &module, ADDRINT instr_addr,
+    ADDRINT runtime_addr, ADDRINT *decided, bool positive,
+    const string &message, THREADID thread_id) {
+
+    // Another thread decided the candidate in the meantime.
+    if(!__sync_bool_compare_and_swap(decided, 0, 1)) {
         return;
     }
 
+    ThreadData &data = *static_cast<ThreadData*>(
+        PIN_GetThreadData(thread_data_key, thread_id));
+    Decision decision;
+    decision.module = &module;
+    decision.instr_addr = instr_addr;
+    decision.positive = positive;
+    decision.message = message;
+    data.decisions.push_back(decision);
+    if(always_write_back || data.decisions.size() >= merge_threshold) {
+        merge_decisions(data, thread_id);
+    }
+
+    PIN_RemoveInstrumentationInRange(runtime_addr, runtime_addr);
+}
+
+void verify_call(ADDRINT runtime_addr, ADDRINT register_value,
+    Site *site, Module *module, ADDRINT *counter, THREADID thread_id) {
+
+    // Only undecided vcall candidates get here: they are the only ones
+    // instrumented (see on_trace()) and should_verify() filters those
+    // decided until their trace is left.
+    ADDRINT *decided = &site->decided;
+    *counter = sample_interval;
+
+    // Addresses are reported as given by the static analysis.
+    ADDRINT instr_addr = runtime_addr - module->load_offset;
+
     // get this pointer candidate for the current context
-    ADDRINT this_pointer = get_this_pointer(context);
+    ADDRINT this_pointer = get_this_pointer(register_value);
     ADDRINT vtbl_pointer;
+    ostringstream message;
 
     /* If we are unable to retrieve the vtable for a valid virtual callsite
     (as all callsites given at the command line are considered valid),
     abort the program. */
     if(this_pointer == 0) {
 
-        out_file << "Cannot get this pointer for candidate 0x"
-                 << hex << instr_addr
-                 << ". Removing candidate."
-                 << endl;
+        message << "Cannot get this pointer for candidate 0x"
+                << hex << instr_addr
+                << " in " << module->name
+                << ". Removing candidate.";
 
-        global_negative_vcalls.insert(instr_addr);
-
-        // Check if we should write back our files directly.
-        if(always_write_back) {
-            write_back_files();
-        }
+        classify_candidate(*module, instr_addr, runtime_addr, decided, false,
+            message.str(), thread_id);
 
         return;
     }
@@ -176,103 +451,176 @@ void verify_call(ADDRINT instr_addr, ADDRINT target_addr,
     if(PIN_SafeCopy(&vtbl_pointer, reinterpret_cast<void*>(this_pointer),
         sizeof(vtbl_pointer)) != sizeof(vtbl_pointer)) {
 
-        out_file << "Cannot read vtable pointer at 0x"
+        message << "Cannot read vtable pointer at 0x"
             << hex << this_pointer
             << " for candidate 0x"
             << hex << instr_addr
-            << ". Removing candidate."
-            << endl;
-
-        global_negative_vcalls.insert(instr_addr);
+            << " in " << module->name
+            << ". Removing candidate.";
 
-        // Check if we should write back our files directly.
-        if(always_write_back) {
-            write_back_files();
-        }
+        classify_candidate(*module, instr_addr, runtime_addr, decided, false,
+            message.str(), thread_id);
 
         return;
     }
 
-    // Check if vtable is known.
-    if(global_vtables.find(vtbl_pointer) != global_vtables.end()) {
+    // Check if vtable is known (the tables are not modified after startup,
+    // the vtable may belong to any loaded module).
+    if(is_known_vtable(vtbl_pointer)) {
+
+        // Wait for the remaining samples.
+        if(__sync_add_and_fetch(&site->samples, 1) < samples_per_site) {
+            return;
+        }
 
-        out_file << "Vtable pointer at 0x"
+        message << "Vtable pointer at 0x"
             << hex << vtbl_pointer
             << " for candidate 0x"
             << hex << instr_addr
-            << " known. Adding candidate."
-            << endl;
-
-        global_positive_vcalls.insert(instr_addr);
+            << " in " << module->name
+            << " known. Adding candidate.";
 
-        // Check if we should write back our files directly.
-        if(always_write_back) {
-            write_back_files();
-        }
+        classify_candidate(*module, instr_addr, runtime_addr, decided, true,
+            message.str(), thread_id);
     }
 
     // Otherwise we do not consider it a vcall.
     else {
-        out_file << "Vtable pointer at 0x"
+        message << "Vtable pointer at 0x"
             << hex << vtbl_pointer
             << " for candidate 0x"
             << hex << instr_addr
-            << " not known. Removing candidate."
-            << endl;
+            << " in " << module->name
+            << " not known. Removing candidate.";
 
-        global_negative_vcalls.insert(instr_addr);
-
-        // Check if we should write back our files directly.
-        if(always_write_back) {
-            write_back_files();
-        }
+        classify_candidate(*module, instr_addr, runtime_addr, decided, false,
+            message.str(), thread_id);
     }
 }
 
-bool is_inside_module(ADDRINT address) {
-    return address >= module_lo && address <= module_hi;
+/* Builds the decision table of the given module, candidates already known
+as (not) being a vcall are decided from the start. */
+void create_sites(Module &module) {
+    module.sites.clear();
+    for(AddressSet::iterator it = module.candidate_vcalls.begin();
+        it != module.candidate_vcalls.end();
+        ++it) {
+
+        bool decided = module.negative_vcalls.count(*it)
+                       || module.positive_vcalls.count(*it);
+        Site &site = module.sites[*it];
+        site.decided = decided ? 1 : 0;
+        site.samples = 0;
+    }
 }
 
-void on_instruction(INS instruction, void*) {
+void on_trace(TRACE trace, void*) {
 
-    // Only instrument if we know which module we have to look at.
-    if(!module_lo || !module_lo) {
+    // Only instrument modules we have the files of.
+    Module *module = find_loaded_module(TRACE_Address(trace));
+    if(module == 0) {
         return;
     }
 
-    if(INS_IsCall(instruction) &&
-        INS_IsIndirectBranchOrCall(instruction)) {
+    // Skip traces without any candidate so that all other indirect calls
+    // run without an analysis call (candidates are sorted by address).
+    ADDRINT trace_lo = TRACE_Address(trace) - module->load_offset;
+    ADDRINT trace_hi = trace_lo + TRACE_Size(trace);
+    AddressSet::iterator candidate =
+                             module->candidate_vcalls.lower_bound(trace_lo);
+    if(candidate == module->candidate_vcalls.end()
+       || *candidate >= trace_hi) {
+        return;
+    }
 
-        ADDRINT address = INS_Address(instruction);
+    for(BBL block = TRACE_BblHead(trace);
+        BBL_Valid(block);
+        block = BBL_Next(block)) {
 
-        if(is_inside_module(address)) {
+        for(INS instruction = BBL_InsHead(block);
+            INS_Valid(instruction);
+            instruction = INS_Next(instruction)) {
 
-            INS_InsertCall(instruction, IPOINT_BEFORE,
+            if(!INS_IsCall(instruction) ||
+                !INS_IsIndirectBranchOrCall(instruction)) {
+                continue;
+            }
+
+            ADDRINT address = INS_Address(instruction);
+            if(!is_inside_module(*module, address)) {
+                continue;
+            }
+
+            // Only the layout of the decision table is read here, the
+            // sets are modified concurrently by merge_decisions().
+            map<ADDRINT, Site>::iterator site =
+                module->sites.find(address - module->load_offset);
+            if(site == module->sites.end() || site->second.decided) {
+                continue;
+            }
+
+            INS_InsertIfCall(instruction, IPOINT_BEFORE,
+                reinterpret_cast<AFUNPTR>(&should_verify),
+                IARG_PTR, &site->second.decided,
+                IARG_REG_REFERENCE, sample_counter_register, IARG_END);
+            INS_InsertThenCall(instruction, IPOINT_BEFORE,
                 reinterpret_cast<AFUNPTR>(&verify_call),
-                IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR,
-                IARG_CONST_CONTEXT, IARG_END);
+                IARG_INST_PTR, IARG_REG_VALUE, this_pointer_register(),
+                IARG_PTR, &site->second, IARG_PTR, module,
+                IARG_REG_REFERENCE, sample_counter_register, IARG_THREAD_ID,
+                IARG_END);
+        }
+    }
+}
+
+// Returns the file name of the given image (the name of its module).
+string get_image_module_name(IMG image) {
+    const string &path = IMG_Name(image);
+    size_t separator = path.rfind('/');
+    if(separator == string::npos) {
+        return path;
+    }
+    return path.substr(separator + 1);
+}
+
+Module *find_image_module(IMG image) {
+    string name = get_image_module_name(image);
+    for(size_t i = 0; i < global_modules.size(); i++) {
+        if(global_modules[i]->name == name) {
+            return global_modules[i];
         }
     }
+    return 0;
 }
 
-void on_start(void*) {
-    // We assume the first image PIN returns to be the
-    // main module of our application.
-    IMG image = APP_ImgHead();
-    if(!IMG_Valid(image)) {
+void on_image_load(IMG image, void*) {
+    Module *module = find_image_module(image);
+    if(module == 0) {
         return;
     }
 
-    module_lo = IMG_LowAddress(image);
-    module_hi = IMG_HighAddress(image);
+    module->lo = IMG_LowAddress(image);
+    module->hi = IMG_HighAddress(image);
+    module->load_offset = IMG_LoadOffset(image);
+
+    // Publish the range only after it is complete.
+    __sync_synchronize();
+    module->loaded = true;
+}
+
+void on_image_unload(IMG image, void*) {
+    Module *module = find_image_module(image);
+    if(module != 0) {
+        module->loaded = false;
+    }
 }
 
 KNOB<string> knob_vtable_file(
-    KNOB_MODE_WRITEONCE,
+    KNOB_MODE_APPEND,
     "pintool",
     "in_vtables",
     "",
-    "*_vtables.txt file generated by engels.");
+    "*_vtables.txt file generated by engels (once for each module).");
 
 KNOB<string> knob_output_file(
     KNOB_MODE_WRITEONCE,
@@ -282,25 +630,41 @@ KNOB<string> knob_output_file(
     "Specify log output file name.");
 
 KNOB<string> knob_positive_vcalls_file(
-    KNOB_MODE_WRITEONCE,
+    KNOB_MODE_APPEND,
     "pintool",
     "inout_positive_vcalls",
     "",
-    "Specify file with confirmed vcalls.");
+    "Specify file with confirmed vcalls (once for each candidates file).");
 
 KNOB<string> knob_negative_vcalls_file(
-    KNOB_MODE_WRITEONCE,
+    KNOB_MODE_APPEND,
     "pintool",
     "inout_negative_vcalls",
     "",
-    "Specify file with confirmed NOT vcalls.");
+    "Specify file with confirmed NOT vcalls (once for each candidates"
+    " file).");
 
 KNOB<string> knob_candidate_vcalls_file(
-    KNOB_MODE_WRITEONCE,
+    KNOB_MODE_APPEND,
     "pintool",
     "in_candidate_vcalls",
     "",
-    "Specify file with candidate vcalls.");
+    "Specify file with candidate vcalls (once for each module).");
+
+KNOB<UINT32> knob_sample_interval(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "sample_interval",
+    "1",
+    "Verify one in every n executions of candidates (per thread).");
+
+KNOB<UINT32> knob_samples(
+    KNOB_MODE_WRITEONCE,
+    "pintool",
+    "samples",
+    "1",
+    "Number of verified executions with a known vtable needed to add a"
+    " candidate.");
 
 int usage() {
     cerr << "This tool instruments the callsites and checks the associated"\
@@ -310,18 +674,72 @@ int usage() {
     return -1;
 }
 
+/* Input file mapped into memory while it is parsed (binary address list
+files are read in place). */
+class MappedInput {
+private:
+    void *_data;
+    size_t _size;
+
+public:
+    MappedInput(const char *file_name) : _data(MAP_FAILED), _size(0) {
+        int fd = open(file_name, O_RDONLY);
+        if(fd == -1) {
+            return;
+        }
+
+        struct stat file_stat;
+        if(fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+            _size = file_stat.st_size;
+            _data = mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+    }
+
+    ~MappedInput() {
+        if(_data != MAP_FAILED) {
+            munmap(_data, _size);
+        }
+    }
+
+    // Returns the content (0 if the file could not be mapped).
+    const uint8_t *data() const {
+        return _data == MAP_FAILED ? 0 : static_cast<const uint8_t*>(_data);
+    }
+
+    size_t size() const {
+        return _data == MAP_FAILED ? 0 : _size;
+    }
+};
+
 bool parse_vtables_file(const char *input_file) {
-    global_vtables.clear();
+
+    // Binary address list files (see address_list_file.h).
+    MappedInput input(input_file);
+    if(is_address_list(input.data(), input.size())) {
+        string module_name;
+        const uint64_t *addresses;
+        uint64_t count;
+        if(!parse_address_list(input.data(), input.size(), module_name,
+                               addresses, count)) {
+            return false;
+        }
+
+        get_module(module_name)->vtables.build(addresses, addresses + count);
+        return true;
+    }
 
     ifstream file(input_file);
     string line;
 
-    bool first = true;
+    Module *module = 0;
+    AddressSet vtables;
     while(std::getline(file, line)) {
         istringstream parser(line);
-        if(first) {
+        if(module == 0) {
+            string module_name;
             parser >> module_name;
-            first = false;
+            module = get_module(module_name);
             continue;
         }
         
@@ -332,15 +750,38 @@ bool parse_vtables_file(const char *input_file) {
             return false;
         }
 
-        global_vtables.insert(vtable_addr);
+        vtables.insert(vtable_addr);
     }
 
+    if(module != 0) {
+        module->vtables.build(vtables.begin(), vtables.end());
+    }
     return true;
 }
 
-bool parse_candidates_file(const char *input_file, AddressSet &candidates) {
+/* Parses the addresses of the given file into candidates. The module name
+in the first line has to match module_name (it is set if empty). */
+bool parse_candidates_file(const char *input_file, AddressSet &candidates,
+    string &module_name) {
     candidates.clear();
 
+    // Binary address list files (see address_list_file.h).
+    MappedInput input(input_file);
+    if(is_address_list(input.data(), input.size())) {
+        string temp_name;
+        const uint64_t *addresses;
+        uint64_t count;
+        if(!parse_address_list(input.data(), input.size(), temp_name,
+                               addresses, count)
+           || (module_name != "" && temp_name != module_name)) {
+            return false;
+        }
+
+        module_name = temp_name;
+        candidates.insert(addresses, addresses + count);
+        return true;
+    }
+
     ifstream file(input_file);
     string line;
 
@@ -350,7 +791,10 @@ bool parse_candidates_file(const char *input_file, AddressSet &candidates) {
         if(first) {
             string temp_name;
             parser >> temp_name;
-            if(temp_name != module_name) {
+            if(module_name == "") {
+                module_name = temp_name;
+            }
+            else if(temp_name != module_name) {
                 return false;
             }
 
@@ -371,28 +815,63 @@ bool parse_candidates_file(const char *input_file, AddressSet &candidates) {
     return true;
 }
 
-void write_candidates_file(const char *input_file,
-                           AddressSet &candidates) {
+/* Parses the candidates of one module together with the vcalls already
+decided for it. */
+bool parse_module_candidates(const string &candidates_file,
+    const string &positive_file, const string &negative_file) {
+
+    AddressSet candidates;
+    string module_name;
+    if(!parse_candidates_file(candidates_file.c_str(), candidates,
+                              module_name)
+       || module_name == "") {
+        return false;
+    }
 
-    ofstream candidates_file;
+    Module &module = *get_module(module_name);
+    module.candidate_vcalls.swap(candidates);
+    module.positive_vcalls_file = positive_file;
+    module.negative_vcalls_file = negative_file;
+    return parse_candidates_file(positive_file.c_str(),
+                                 module.positive_vcalls,
+                                 module_name)
+           && parse_candidates_file(negative_file.c_str(),
+                                    module.negative_vcalls,
+                                    module_name);
+}
+
+// Returns the name of the file written for the given file name.
+string get_target_file(const string &file_name) {
 
     // Only append process's pid if activated.
-    char target_file[1024];
-    if(append_pid) {
-        snprintf(target_file,
-                1023,
-                "%s_%d",
-                input_file,
-                getpid());
+    if(!append_pid) {
+        return file_name;
     }
-    else {
-        snprintf(target_file,
-                1023,
-                "%s",
-                input_file);
+
+    ostringstream target_file;
+    target_file << file_name << "_" << dec << getpid();
+    return target_file.str();
+}
+
+void write_candidates_file(const char *input_file,
+                           const string &module_name,
+                           AddressSet &candidates) {
+
+    // Files with the extension of address list files are written in the
+    // binary format (see address_list_file.h).
+    if(is_address_list_file_name(input_file)) {
+        vector<uint64_t> addresses(candidates.begin(), candidates.end());
+        if(!write_address_list(get_target_file(input_file), module_name,
+                               addresses.empty() ? 0 : &addresses[0],
+                               addresses.size())) {
+            cerr << "Could not write " << input_file << "." << endl;
+        }
+        return;
     }
-    target_file[1023] = '\0';
-    candidates_file.open(target_file);
+
+    ofstream candidates_file;
+
+    candidates_file.open(get_target_file(input_file).c_str());
 
     candidates_file << module_name
                     << "\n";
@@ -410,13 +889,112 @@ void write_candidates_file(const char *input_file,
 }
 
 void write_back_files() {
-    write_candidates_file(knob_positive_vcalls_file.Value().c_str(),
-                          global_positive_vcalls);
-    write_candidates_file(knob_negative_vcalls_file.Value().c_str(),
-                          global_negative_vcalls);
+    for(size_t i = 0; i < global_modules.size(); i++) {
+        Module &module = *global_modules[i];
+        if(module.positive_vcalls_file == "") {
+            continue;
+        }
+
+        write_candidates_file(module.positive_vcalls_file.c_str(),
+                              module.name,
+                              module.positive_vcalls);
+        write_candidates_file(module.negative_vcalls_file.c_str(),
+                              module.name,
+                              module.negative_vcalls);
+    }
+}
+
+void on_thread_start(THREADID thread_id, CONTEXT *context, int32_t, void*) {
+    PIN_SetContextReg(context, sample_counter_register, sample_interval);
+
+    ThreadData *data = new ThreadData;
+    PIN_SetThreadData(thread_data_key, data, thread_id);
+
+    PIN_GetLock(&merge_lock, thread_id + 1);
+    all_thread_data.push_back(data);
+    PIN_ReleaseLock(&merge_lock);
+}
+
+void on_thread_fini(THREADID thread_id, const CONTEXT*, int32_t, void*) {
+    ThreadData *data = static_cast<ThreadData*>(
+        PIN_GetThreadData(thread_data_key, thread_id));
+    merge_decisions(*data, thread_id);
+}
+
+/* Appends the pending decisions to the journal and syncs it (the log
+file is flushed as well). */
+void flush_journal(THREADID thread_id) {
+    vector<JournalRecord> records;
+
+    PIN_GetLock(&merge_lock, thread_id + 1);
+    records.swap(pending_journal);
+    out_file.flush();
+    PIN_ReleaseLock(&merge_lock);
+
+    if(records.empty() || journal_fd == -1) {
+        return;
+    }
+
+    const char *data = reinterpret_cast<const char*>(&records[0]);
+    size_t size = records.size() * sizeof(JournalRecord);
+    while(size > 0) {
+        ssize_t written = write(journal_fd, data, size);
+        if(written <= 0) {
+            cerr << "Could not write the journal." << endl;
+            break;
+        }
+        data += written;
+        size -= written;
+    }
+    fsync(journal_fd);
+}
+
+/* Pin internal thread that periodically journals all decisions merged in
+the meantime. Since the application threads only append to a buffer, no
+file is written by them. */
+void journal_thread(void*) {
+    THREADID thread_id = PIN_ThreadId();
+    while(!journal_stop && !PIN_IsProcessExiting()) {
+        PIN_Sleep(journal_interval_ms);
+        flush_journal(thread_id);
+    }
+}
+
+bool start_journal() {
+    string journal_file = get_target_file(
+        knob_positive_vcalls_file.Value(0) + ".journal");
+    journal_fd = open(journal_file.c_str(),
+                      O_WRONLY | O_CREAT | O_APPEND,
+                      0644);
+    if(journal_fd == -1) {
+        return false;
+    }
+
+    return PIN_SpawnInternalThread(journal_thread, 0, 0, &journal_thread_uid)
+           != INVALID_THREADID;
+}
+
+void on_prepare_fini(void*) {
+    journal_stop = true;
+    PIN_WaitForThreadTermination(journal_thread_uid, PIN_INFINITE_TIMEOUT, 0);
 }
 
 void on_fini(int32_t code, void*) {
+
+    // Merge decisions of threads that did not terminate on their own (no
+    // thread runs anymore, hence the buffers can be accessed directly).
+    for(size_t i = 0; i < all_thread_data.size(); i++) {
+        merge_decisions(*all_thread_data[i], 0);
+        delete all_thread_data[i];
+    }
+    all_thread_data.clear();
+
+    if(journal_fd != -1) {
+        flush_journal(0);
+        close(journal_fd);
+        journal_fd = -1;
+    }
+
     out_file.close();
     write_back_files();
     cout << "Done." << endl;
@@ -430,51 +1008,58 @@ int main(int argc, char *argv[]) {
         return usage();
     }
 
-    if(knob_vtable_file.Value() == "") {
+    if(knob_vtable_file.NumberOfValues() == 0
+       || knob_vtable_file.Value() == "") {
         cerr << "-in_vtables parameter is required." << endl;
         return usage();
     }
 
-    if(!parse_vtables_file(knob_vtable_file.Value().c_str())) {
-        cerr << "Could not parse the vtables file."
-             << endl;
-        return -1;
+    for(UINT32 i = 0; i < knob_vtable_file.NumberOfValues(); i++) {
+        if(!parse_vtables_file(knob_vtable_file.Value(i).c_str())) {
+            cerr << "Could not parse the vtables file."
+                 << endl;
+            return -1;
+        }
     }
     
-    if(knob_positive_vcalls_file.Value() == "") {
+    if(knob_positive_vcalls_file.NumberOfValues() == 0
+       || knob_positive_vcalls_file.Value() == "") {
         cerr << "-inout_positive_vcalls parameter is required." << endl;
         return usage();
     }
 
-    if(!parse_candidates_file(knob_positive_vcalls_file.Value().c_str(),
-                              global_positive_vcalls)) {
-        cerr << "Could not parse the vtables file."
-             << endl;
-        return -1;
-    }
-
-    if(knob_negative_vcalls_file.Value() == "") {
+    if(knob_negative_vcalls_file.NumberOfValues() == 0
+       || knob_negative_vcalls_file.Value() == "") {
         cerr << "-inout_negative_vcalls parameter is required." << endl;
         return usage();
     }
 
-    if(!parse_candidates_file(knob_negative_vcalls_file.Value().c_str(),
-                              global_negative_vcalls)) {
-        cerr << "Could not parse the vtables file."
-             << endl;
-        return -1;
+    if(knob_candidate_vcalls_file.NumberOfValues() == 0
+       || knob_candidate_vcalls_file.Value() == "") {
+        cerr << "-in_candidate_vcalls parameter is required." << endl;
+        return usage();
     }
 
-    if(knob_candidate_vcalls_file.Value() == "") {
-        cerr << "-in_candidate_vcalls parameter is required." << endl;
+    // Each candidates file comes with its own positive and negative file.
+    if(knob_positive_vcalls_file.NumberOfValues()
+           != knob_candidate_vcalls_file.NumberOfValues()
+       || knob_negative_vcalls_file.NumberOfValues()
+           != knob_candidate_vcalls_file.NumberOfValues()) {
+        cerr << "-inout_positive_vcalls and -inout_negative_vcalls are"
+             << " required for each -in_candidate_vcalls parameter." << endl;
         return usage();
     }
 
-    if(!parse_candidates_file(knob_candidate_vcalls_file.Value().c_str(),
-                              global_candidate_vcalls)) {
-        cerr << "Could not parse the vtables file."
-             << endl;
-        return -1;
+    for(UINT32 i = 0; i < knob_candidate_vcalls_file.NumberOfValues(); i++) {
+        if(!parse_module_candidates(knob_candidate_vcalls_file.Value(i),
+                                    knob_positive_vcalls_file.Value(i),
+                                    knob_negative_vcalls_file.Value(i))) {
+            cerr << "Could not parse the candidates files of "
+                 << knob_candidate_vcalls_file.Value(i)
+                 << "."
+                 << endl;
+            return -1;
+        }
     }
 
     if(knob_output_file.Value() == "") {
@@ -482,28 +1067,42 @@ int main(int argc, char *argv[]) {
         return usage();
     }
 
-    // Only append process's pid if activated.
-    char target_file[1024];
-    if(append_pid) {
-        snprintf(target_file,
-                1023,
-                "%s_%d",
-                knob_output_file.Value().c_str(),
-                getpid());
+    out_file.open(get_target_file(knob_output_file.Value()).c_str());
+
+    for(size_t i = 0; i < global_modules.size(); i++) {
+        create_sites(*global_modules[i]);
     }
-    else {
-        snprintf(target_file,
-                1023,
-                "%s",
-                knob_output_file.Value().c_str());
+
+    if(knob_sample_interval.Value() == 0 || knob_samples.Value() == 0) {
+        cerr << "-sample_interval and -samples have to be positive." << endl;
+        return usage();
     }
-    target_file[1023] = '\0';
-    out_file.open(target_file);
+    sample_interval = knob_sample_interval.Value();
+    samples_per_site = knob_samples.Value();
 
-    PIN_AddApplicationStartFunction(on_start, 0);
+    sample_counter_register = PIN_ClaimToolRegister();
+    if(!REG_valid(sample_counter_register)) {
+        cerr << "Could not claim a tool register." << endl;
+        return -1;
+    }
+    PIN_InitLock(&merge_lock);
+    thread_data_key = PIN_CreateThreadDataKey(0);
+
+    IMG_AddInstrumentFunction(on_image_load, 0);
+    IMG_AddUnloadFunction(on_image_unload, 0);
+    PIN_AddThreadStartFunction(on_thread_start, 0);
+    PIN_AddThreadFiniFunction(on_thread_fini, 0);
+
+    if(always_write_back) {
+        if(!start_journal()) {
+            cerr << "Could not start the journal." << endl;
+            return -1;
+        }
+        PIN_AddPrepareForFiniFunction(on_prepare_fini, 0);
+    }
     PIN_AddFiniFunction(on_fini, 0);
 
-    INS_AddInstrumentFunction(on_instruction, 0);
+    TRACE_AddInstrumentFunction(on_trace, 0);
     PIN_StartProgram();
     return 0;
 }
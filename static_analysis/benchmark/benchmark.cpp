@@ -0,0 +1,635 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+
+#include "vex.h"
+#include "translator.h"
+#include "ssa.h"
+#include "analysis_cache.h"
+#include "function_xrefs.h"
+#include "vtable_file.h"
+#include "vtable_hierarchy.h"
+#include "external_functions.h"
+#include "module_plt.h"
+#include "blacklist_functions.h"
+#include "vcall.h"
+#include "icalls.h"
+#include "icall_analysis.h"
+#include "engels.h"
+#include "block_semantics.h"
+#include "state.h"
+#include "expression.h"
+#include "serialization.h"
+
+#define BENCHMARK_SAMPLE_FUNCTIONS 200
+#define BENCHMARK_SAMPLE_ICALLS 50
+#define BENCHMARK_SYNTHETIC_EXPRESSIONS 4096
+
+using namespace std;
+
+typedef chrono::steady_clock BenchmarkClock;
+
+// Keeps the compiler from optimizing the benchmarked calls away.
+static volatile size_t benchmark_sink = 0;
+
+/*!
+ * \brief States captured from the blocks of a run. They are stored in the
+ * corpus (and not re-created on replay) so that changes in the block
+ * semantics do not change the inputs of the `State` benchmarks.
+ */
+typedef vector<vector<pair<ExpressionPtr, ExpressionPtr>>> CapturedStates;
+
+/*!
+ * \brief Work items of a run. VEX blocks are no relocatable data, hence only
+ * the addresses are stored and the blocks are lifted from the module again.
+ */
+struct BenchmarkCorpus {
+    vector<uint64_t> function_addrs;
+    vector<uint64_t> icall_addrs;
+    CapturedStates states;
+};
+
+/*!
+ * \brief Runs the callback `iterations` times and prints the time per
+ * operation (each call of the callback performs `num_ops` operations).
+ */
+template<typename Callback>
+static void run_benchmark(const string &name,
+                          uint32_t iterations,
+                          uint64_t num_ops,
+                          const Callback &callback) {
+
+    if(num_ops == 0) {
+        cout << name << ": no input. Skipping." << "\n";
+        return;
+    }
+
+    // Warm up caches (and the interned leaf expressions).
+    callback();
+
+    const auto start = BenchmarkClock::now();
+    for(uint32_t i = 0; i < iterations; i++) {
+        callback();
+    }
+    const auto end = BenchmarkClock::now();
+
+    double total_ns = chrono::duration_cast<chrono::nanoseconds>(
+                                                         end - start).count();
+    double ns_per_op = total_ns / (static_cast<double>(iterations) * num_ops);
+    cout << name << ": "
+         << fixed << ns_per_op << " ns/op ("
+         << dec << num_ops << " ops x "
+         << dec << iterations << " iterations)"
+         << "\n";
+}
+
+// Deterministic pseudo random numbers (xorshift64) in order to get the
+// same synthetic expressions on each run.
+static uint64_t next_random(uint64_t &seed) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static ExpressionPtr create_random_expression(uint64_t &seed,
+                                              uint32_t depth) {
+    uint64_t choice = next_random(seed) % (depth ? 6 : 3);
+    switch(choice) {
+        case 0:
+            return make_constant(next_random(seed) % 0x1000);
+        case 1:
+            return make_register((next_random(seed) % 16) * 8);
+        case 2:
+            return make_symbolic(SymbolicInitialValue,
+                                 next_random(seed) % 16);
+        case 3:
+            return make_shared<Indirection>(
+                                   create_random_expression(seed, depth - 1));
+        default:
+            return make_shared<Operation>(
+                      create_random_expression(seed, depth - 1),
+                      static_cast<OperationType>(next_random(seed)
+                                                 % OperationCount),
+                      create_random_expression(seed, depth - 1));
+    }
+}
+
+static vector<ExpressionPtr> create_random_expressions(uint32_t number) {
+    uint64_t seed = 0x2545f4914f6cdd1d;
+    vector<ExpressionPtr> expressions;
+    for(uint32_t i = 0; i < number; i++) {
+        expressions.push_back(create_random_expression(seed, 5));
+    }
+    return expressions;
+}
+
+static void benchmark_expressions(uint32_t iterations) {
+
+    vector<ExpressionPtr> expressions = create_random_expressions(
+                                             BENCHMARK_SYNTHETIC_EXPRESSIONS);
+
+    run_benchmark("Expression construction",
+                  iterations,
+                  BENCHMARK_SYNTHETIC_EXPRESSIONS,
+                  [&]() {
+        vector<ExpressionPtr> temp = create_random_expressions(
+                                             BENCHMARK_SYNTHETIC_EXPRESSIONS);
+        benchmark_sink += temp.size();
+    });
+
+    // Compare each expression with a structurally equal copy and with
+    // its neighbour.
+    vector<ExpressionPtr> copies = create_random_expressions(
+                                             BENCHMARK_SYNTHETIC_EXPRESSIONS);
+    run_benchmark("Expression compare",
+                  iterations,
+                  2 * expressions.size(),
+                  [&]() {
+        for(size_t i = 0; i < expressions.size(); i++) {
+            benchmark_sink += *expressions[i] == *copies[i];
+            benchmark_sink += *expressions[i]
+                              == *copies[(i + 1) % copies.size()];
+        }
+    });
+
+    run_benchmark("Expression hash",
+                  iterations,
+                  expressions.size(),
+                  [&]() {
+        for(const ExpressionPtr &expression : expressions) {
+            benchmark_sink += hash<ExpressionPtr>()(expression);
+        }
+    });
+
+    stringstream serialized;
+    for(const ExpressionPtr &expression : expressions) {
+        serialize(expression, serialized);
+    }
+    const string serialized_data = serialized.str();
+
+    run_benchmark("serialize",
+                  iterations,
+                  expressions.size(),
+                  [&]() {
+        stringstream output;
+        for(const ExpressionPtr &expression : expressions) {
+            serialize(expression, output);
+        }
+        benchmark_sink += output.tellp();
+    });
+
+    run_benchmark("unserialize",
+                  iterations,
+                  expressions.size(),
+                  [&]() {
+        stringstream input(serialized_data);
+        for(size_t i = 0; i < expressions.size(); i++) {
+            benchmark_sink += unserialize(input)->type();
+        }
+    });
+}
+
+static State create_state(const vector<pair<ExpressionPtr,
+                                            ExpressionPtr>> &bindings) {
+    State state(false);
+    for(const auto &kv : bindings) {
+        state.update(kv.first, kv.second);
+    }
+    return state;
+}
+
+static void benchmark_states(uint32_t iterations,
+                             const CapturedStates &captured_states) {
+
+    vector<State> states;
+    for(const auto &bindings : captured_states) {
+        states.push_back(create_state(bindings));
+    }
+
+    // `optimize` propagates the bindings and kills self-referencing ones.
+    run_benchmark("State::optimize",
+                  iterations,
+                  states.size(),
+                  [&]() {
+        for(const State &state : states) {
+            State temp = state;
+            temp.optimize();
+            benchmark_sink += temp.get_memory_accesses().size();
+        }
+    });
+
+    // Merging two states creates the most work for the propagation.
+    run_benchmark("State::merge + State::optimize",
+                  iterations,
+                  states.size() > 1 ? states.size() - 1 : 0,
+                  [&]() {
+        for(size_t i = 1; i < states.size(); i++) {
+            State temp = states[i - 1];
+            temp.merge(states[i]);
+            temp.optimize();
+            benchmark_sink += temp.get_memory_accesses().size();
+        }
+    });
+}
+
+static CapturedStates create_synthetic_states() {
+    CapturedStates states;
+    uint64_t seed = 0x9e3779b97f4a7c15;
+    for(uint32_t i = 0; i < 256; i++) {
+        states.emplace_back();
+        for(uint32_t j = 0; j < 32; j++) {
+            ExpressionPtr key = (j % 2)
+                 ? static_cast<ExpressionPtr>(make_register(j * 8))
+                 : make_shared<Indirection>(create_random_expression(seed, 3));
+            states.back().push_back(make_pair(
+                                          key,
+                                          create_random_expression(seed, 4)));
+        }
+    }
+    return states;
+}
+
+static void capture_states(const Function &function,
+                           CapturedStates &states) {
+    for(const auto &kv : function.get_blocks()) {
+        State state;
+        try {
+            BlockSemantics semantics(*kv.second, state);
+            state = semantics.get_state();
+        }
+        catch(...) {
+            continue;
+        }
+        states.emplace_back();
+        for(const auto &kv_state : state) {
+            states.back().push_back(kv_state);
+        }
+    }
+}
+
+static bool import_corpus(const string &corpus_file, BenchmarkCorpus &corpus) {
+    ifstream file(corpus_file, ios::binary);
+    if(!file) {
+        return false;
+    }
+
+    string type;
+    while(file >> type) {
+        if(type == "FUNCTION") {
+            uint64_t addr;
+            file >> hex >> addr;
+            corpus.function_addrs.push_back(addr);
+        }
+        else if(type == "ICALL") {
+            uint64_t addr;
+            file >> hex >> addr;
+            corpus.icall_addrs.push_back(addr);
+        }
+        else if(type == "STATE") {
+            uint32_t num_bindings;
+            file >> dec >> num_bindings;
+            file.get();
+            corpus.states.emplace_back();
+            for(uint32_t i = 0; i < num_bindings; i++) {
+                ExpressionPtr key = unserialize(file);
+                ExpressionPtr value = unserialize(file);
+                corpus.states.back().push_back(make_pair(key, value));
+            }
+        }
+        else {
+            throw runtime_error("Parsing corpus file failed.");
+        }
+        if(file.fail()) {
+            throw runtime_error("Parsing corpus file failed.");
+        }
+    }
+    return true;
+}
+
+static void export_corpus(const string &corpus_file,
+                          const BenchmarkCorpus &corpus) {
+    ofstream file(corpus_file, ios::binary | ios::trunc);
+    for(uint64_t addr : corpus.function_addrs) {
+        file << "FUNCTION " << hex << addr << "\n";
+    }
+    for(uint64_t addr : corpus.icall_addrs) {
+        file << "ICALL " << hex << addr << "\n";
+    }
+    for(const auto &bindings : corpus.states) {
+        file << "STATE " << dec << bindings.size() << "\n";
+        for(const auto &kv : bindings) {
+            serialize(kv.first, file);
+            serialize(kv.second, file);
+        }
+        file << "\n";
+    }
+}
+
+template<typename T>
+static vector<T> sample(const vector<T> &values, uint32_t number) {
+    if(values.size() <= number) {
+        return values;
+    }
+    vector<T> result;
+    size_t stride = values.size() / number;
+    for(size_t i = 0; i < values.size() && result.size() < number;
+        i += stride) {
+        result.push_back(values[i]);
+    }
+    return result;
+}
+
+static void benchmark_module(uint32_t iterations,
+                             const string &config_file,
+                             const string &corpus_file) {
+
+    // Only the options needed to load the module are considered.
+    ifstream file(config_file);
+    if(!file) {
+        throw runtime_error("Opening config file failed.");
+    }
+    string module_name;
+    string target_dir;
+    FileFormatType file_format = FileFormatELF64;
+    unordered_set<uint64_t> new_operators;
+    unordered_set<uint64_t> vtv_verify_addrs;
+    string line;
+    while(getline(file, line)) {
+        istringstream parser(line);
+        string option;
+        parser >> option;
+        transform(option.begin(), option.end(), option.begin(), ::toupper);
+        if(option == "MODULENAME") {
+            parser >> module_name;
+        }
+        else if(option == "TARGETDIR") {
+            parser >> target_dir;
+        }
+        else if(option == "FORMAT") {
+            string file_format_str;
+            parser >> file_format_str;
+            transform(file_format_str.begin(),
+                      file_format_str.end(),
+                      file_format_str.begin(),
+                      ::toupper);
+            if(file_format_str == "PE64") {
+                file_format = FileFormatPE64;
+            }
+        }
+        else if(option == "NEWOPERATORS") {
+            uint32_t number;
+            parser >> dec >> number;
+            for(uint32_t i = 0; i < number; i++) {
+                uint64_t new_op_addr;
+                parser >> hex >> new_op_addr;
+                new_operators.insert(new_op_addr);
+            }
+        }
+        if(parser.fail()) {
+            throw runtime_error("Parsing config file failed.");
+        }
+    }
+    const string target_file = target_dir + "/" + module_name;
+
+    Vex &vex = Vex::get_instance();
+    vex.set_iropt_register_updates_default(VexRegUpdAllregsAtEachInsn);
+    Translator translator(vex, target_file, file_format, false);
+
+    AnalysisCache analysis_cache(target_file);
+    if(!analysis_cache.is_valid()
+       || !analysis_cache.import_cache(translator)) {
+        ModuleSSA ssa;
+        if(!ssa.parse(target_file, translator)) {
+            throw runtime_error("Cannot parse ssa files " + target_file + ".");
+        }
+        ModuleFunctionXrefs func_xrefs;
+        if(!func_xrefs.parse(target_file, translator)) {
+            throw runtime_error("Cannot parse function xref files "
+                                + target_file + ".");
+        }
+    }
+    translator.finalize();
+
+    VTableFile vtable_file(module_name, file_format);
+    if(!vtable_file.parse(target_file)) {
+        throw runtime_error("Cannot parse vtables file " + target_file + ".");
+    }
+    vtable_file.finalize();
+    ExternalFunctions external_funcs;
+    external_funcs.finalize();
+    ModulePlt module_plt(module_name);
+    if(file_format == FileFormatELF64 && !module_plt.parse(target_file)) {
+        throw runtime_error("Cannot parse module plt file "
+                            + target_file + ".");
+    }
+    const BlacklistFuncsSet funcs_blacklist = import_blacklist_funcs(
+                                                                   target_file);
+    VTableHierarchies vtable_hierarchies(file_format,
+                                         vtable_file,
+                                         module_name,
+                                         external_funcs,
+                                         module_plt,
+                                         funcs_blacklist,
+                                         -1);
+    vtable_hierarchies.import_hierarchy(target_file);
+    VCallFile vcall_file(module_name, vtable_hierarchies, vtable_file);
+
+    // Record a new corpus if none exists yet.
+    BenchmarkCorpus corpus;
+    if(!import_corpus(corpus_file, corpus)) {
+        vector<uint64_t> function_addrs;
+        for(const auto &kv : translator.get_functions()) {
+            function_addrs.push_back(kv.first);
+        }
+        corpus.function_addrs = sample(function_addrs,
+                                       BENCHMARK_SAMPLE_FUNCTIONS);
+
+        const ICallSet icall_set = import_icalls(target_file);
+        corpus.icall_addrs = sample(vector<uint64_t>(icall_set.cbegin(),
+                                                     icall_set.cend()),
+                                    BENCHMARK_SAMPLE_ICALLS);
+
+        for(uint64_t func_addr : corpus.function_addrs) {
+            capture_states(translator.cget_function(func_addr),
+                           corpus.states);
+        }
+        export_corpus(corpus_file, corpus);
+        cout << "Recorded corpus '" << corpus_file << "'." << "\n";
+    }
+
+    vector<const Function*> functions;
+    vector<BlockPtr> blocks;
+    vector<uint64_t> instr_addrs;
+    for(uint64_t func_addr : corpus.function_addrs) {
+        try {
+            const Function &function = translator.cget_function(func_addr);
+            functions.push_back(&function);
+            for(const auto &kv : function.get_blocks()) {
+                blocks.push_back(kv.second);
+                for(uint64_t addr : kv.second->get_addresses()) {
+                    instr_addrs.push_back(addr);
+                }
+            }
+        }
+        catch(...) {
+            cerr << "Function "
+                 << hex << func_addr
+                 << " of corpus does not exist. Skipping."
+                 << "\n";
+        }
+    }
+
+    run_benchmark("BlockSemantics::extract_semantics",
+                  iterations,
+                  blocks.size(),
+                  [&]() {
+        for(const BlockPtr &block : blocks) {
+            State state;
+            try {
+                BlockSemantics semantics(*block, state);
+                benchmark_sink += semantics.get_state()
+                                           .get_memory_accesses().size();
+            }
+            catch(...) {
+            }
+        }
+    });
+
+    run_benchmark("Function::get_containing_block",
+                  iterations,
+                  instr_addrs.size(),
+                  [&]() {
+        for(const Function *function : functions) {
+            for(const auto &kv : function->get_blocks()) {
+                for(uint64_t addr : kv.second->get_addresses()) {
+                    benchmark_sink +=
+                         function->get_containing_block(addr).get_address();
+                }
+            }
+        }
+    });
+
+    run_benchmark("Function::get_containing_block_ptr",
+                  iterations,
+                  instr_addrs.size(),
+                  [&]() {
+        for(const Function *function : functions) {
+            for(const auto &kv : function->get_blocks()) {
+                for(uint64_t addr : kv.second->get_addresses()) {
+                    benchmark_sink +=
+                      function->get_containing_block_ptr(addr)->get_address();
+                }
+            }
+        }
+    });
+
+    benchmark_states(iterations, corpus.states);
+
+    // Build (and freeze) the data flow graphs of all icalls once, only the
+    // path creation on them is measured.
+    EngelsAnalysisObjects analysis_obj(file_format,
+                                       vtable_file,
+                                       vtable_hierarchies,
+                                       new_operators,
+                                       vtv_verify_addrs,
+                                       translator,
+                                       vex,
+                                       vcall_file);
+    vector<unique_ptr<ICallAnalysis>> analyses;
+    vector<pair<ICallAnalysis*,
+                vector<GraphDataFlow::vertex_descriptor>>> path_queries;
+    uint64_t num_paths_queries = 0;
+    for(uint64_t icall_addr : corpus.icall_addrs) {
+        try {
+            analyses.emplace_back(new ICallAnalysis(module_name,
+                                                    target_dir,
+                                                    translator,
+                                                    vcall_file,
+                                                    vtable_file,
+                                                    new_operators,
+                                                    vtv_verify_addrs,
+                                                    icall_addr));
+            analyses.back()->obtain(200);
+        }
+        catch(...) {
+            analyses.pop_back();
+            continue;
+        }
+
+        // First entry is the icall node, the others are the root nodes.
+        const GraphDataFlow &graph = analyses.back()->get_graph();
+        vector<GraphDataFlow::vertex_descriptor> nodes(1);
+        bool has_icall_node = false;
+        const auto vertices = boost::vertices(graph);
+        for(auto it = vertices.first; it != vertices.second; ++it) {
+            const auto in_edges = boost::in_edges(*it, graph);
+            if(graph[*it].type == DataFlowNodeTypeStart) {
+                nodes[0] = *it;
+                has_icall_node = true;
+            }
+            else if(in_edges.first == in_edges.second) {
+                nodes.push_back(*it);
+            }
+        }
+        if(!has_icall_node || nodes.size() == 1) {
+            continue;
+        }
+        analyses.back()->get_graph_csr();
+        num_paths_queries += nodes.size() - 1;
+        path_queries.push_back(make_pair(analyses.back().get(), nodes));
+    }
+
+    run_benchmark("create_dataflow_paths",
+                  iterations,
+                  num_paths_queries,
+                  [&]() {
+        for(const auto &query : path_queries) {
+            ICallAnalysis &analysis = *query.first;
+            const vector<GraphDataFlow::vertex_descriptor> &nodes =
+                                                                  query.second;
+            for(size_t i = 1; i < nodes.size(); i++) {
+                benchmark_sink += create_dataflow_paths(
+                                          analysis_obj,
+                                          analysis.get_graph_csr(),
+                                          nodes[i], // src
+                                          nodes[0]).size(); // dst
+            }
+        }
+    });
+}
+
+int main(int argc, char* argv[]) {
+
+    if(argc != 2 && argc != 4) {
+        cerr << "Usage: "
+             << argv[0]
+             << " <iterations> [<path_to_config> <path_to_corpus>]"
+             << "\n"
+             << "The corpus is recorded from the module if it does not exist."
+             << "\n";
+        return 0;
+    }
+
+    uint32_t iterations = stoul(argv[1]);
+
+    try {
+        benchmark_expressions(iterations);
+        if(argc == 4) {
+            benchmark_module(iterations, argv[2], argv[3]);
+        }
+        else {
+            benchmark_states(iterations, create_synthetic_states());
+        }
+    } catch(const exception &e) {
+        cerr << "Exception occurred: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
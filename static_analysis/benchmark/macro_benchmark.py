@@ -0,0 +1,333 @@
+#!/usr/bin/env python3
+"""
+End-to-end benchmark of the marx pipeline.
+
+Runs `marx` on each module of a pinned corpus with several NUMTHREADS values
+and records the wall time, the time of each phase (as reported by the
+INSTRUMENTATION option), the peak RSS and the result counts. The results
+are compared against a stored baseline in order to flag slowdowns and
+result drift.
+
+The corpus is a JSON file of the following format (see
+corpus.example.json):
+
+    {
+        "num_threads": [1, 4, 8],
+        "modules": [
+            {"name": "small", "config": "/path/to/small.cfg", "pinned": {}}
+        ]
+    }
+
+`pinned` maps each exported file of the module (all files in TARGETDIR
+starting with MODULENAME) to its SHA-256 and is filled by `--pin`. A run
+is aborted if the exported files do not match the pinned ones.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+# Config options that are set by the benchmark itself.
+# Results are counted from the classic outputs, hence the result stream
+# is not used.
+OVERRIDDEN_OPTIONS = ("NUMTHREADS", "INSTRUMENTATION", "INCREMENTAL",
+                      "RESULTSTREAM")
+
+
+def parse_config(config_file):
+    module_name = None
+    target_dir = None
+    lines = []
+    with open(config_file, "r") as fp:
+        for line in fp:
+            parts = line.split()
+            if not parts:
+                continue
+            option = parts[0].upper()
+            if option == "MODULENAME":
+                module_name = parts[1]
+            elif option == "TARGETDIR":
+                target_dir = parts[1]
+            if option not in OVERRIDDEN_OPTIONS:
+                lines.append(line.rstrip("\n"))
+    if module_name is None or target_dir is None:
+        raise ValueError("Config '%s' lacks MODULENAME or TARGETDIR."
+                         % config_file)
+    return module_name, target_dir, lines
+
+
+def module_files(module_name, target_dir):
+    """
+    Returns the exported input files of the module (outputs of marx
+    itself are not pinned).
+    """
+    outputs = (".vcalls", ".vcalls_extended", "_obj_allocs.txt",
+               "_instrumentation.json", "_instrumentation.csv",
+               ".marx_bin", ".marx_incremental", ".marx_cache",
+               ".marx_results", ".marx_results.txt", ".tmp")
+    files = []
+    for name in sorted(os.listdir(target_dir)):
+        if not name.startswith(module_name):
+            continue
+        if any(name.endswith(output) for output in outputs):
+            continue
+        path = os.path.join(target_dir, name)
+        if os.path.isfile(path):
+            files.append(name)
+    return files
+
+
+def sha256_file(path):
+    h = hashlib.sha256()
+    with open(path, "rb") as fp:
+        for chunk in iter(lambda: fp.read(1 << 20), b""):
+            h.update(chunk)
+    return h.hexdigest()
+
+
+def pin_module(module):
+    module_name, target_dir, _ = parse_config(module["config"])
+    module["pinned"] = {
+        name: sha256_file(os.path.join(target_dir, name))
+        for name in module_files(module_name, target_dir)}
+
+
+def verify_pinned(module):
+    module_name, target_dir, _ = parse_config(module["config"])
+    pinned = module.get("pinned", {})
+    if not pinned:
+        raise ValueError("Module '%s' is not pinned (use --pin)."
+                         % module["name"])
+    current = set(module_files(module_name, target_dir))
+    if current != set(pinned.keys()):
+        raise ValueError("Exported files of module '%s' changed."
+                         % module["name"])
+    for name, digest in pinned.items():
+        if sha256_file(os.path.join(target_dir, name)) != digest:
+            raise ValueError("File '%s' of module '%s' does not match the "
+                             "pinned one." % (name, module["name"]))
+
+
+def count_result_lines(path):
+    """
+    Returns the number of results and a digest over the sorted results
+    of a marx output file (the first line holds the module name).
+    """
+    if not os.path.isfile(path):
+        return 0, None
+    with open(path, "r") as fp:
+        lines = sorted(line.strip() for line in fp.readlines()[1:]
+                       if line.strip())
+    digest = hashlib.sha256("\n".join(lines).encode()).hexdigest()
+    return len(lines), digest
+
+
+def count_possible_vcalls(stdout):
+    count = 0
+    in_section = False
+    for line in stdout.splitlines():
+        if line.startswith("Possible vcalls:"):
+            in_section = True
+            continue
+        if in_section:
+            if not line.strip():
+                break
+            count += 1
+    return count
+
+
+def run_marx(marx, module, num_threads):
+    module_name, target_dir, lines = parse_config(module["config"])
+    lines.append("NUMTHREADS %d" % num_threads)
+    lines.append("INSTRUMENTATION 1")
+    lines.append("INCREMENTAL 0")
+
+    with tempfile.NamedTemporaryFile("w", suffix=".cfg",
+                                     delete=False) as fp:
+        fp.write("\n".join(lines) + "\n")
+        config_file = fp.name
+
+    try:
+        start = time.monotonic()
+        process = subprocess.Popen([marx, config_file],
+                                   stdout=subprocess.PIPE,
+                                   stderr=subprocess.STDOUT,
+                                   universal_newlines=True)
+        stdout = process.stdout.read()
+        _, status, rusage = os.wait4(process.pid, 0)
+        wall_time = time.monotonic() - start
+        if os.WIFEXITED(status):
+            process.returncode = os.WEXITSTATUS(status)
+        else:
+            process.returncode = -os.WTERMSIG(status)
+    finally:
+        os.unlink(config_file)
+
+    if process.returncode != 0 or "Exception occurred" in stdout:
+        raise RuntimeError("marx failed on module '%s':\n%s"
+                           % (module["name"], stdout[-2000:]))
+
+    phases = {}
+    report_file = os.path.join(target_dir,
+                               module_name + "_instrumentation.json")
+    if os.path.isfile(report_file):
+        with open(report_file, "r") as fp:
+            for phase in json.load(fp)["phases"]:
+                phases[phase["name"]] = phase["duration_us"] / 1e6
+
+    num_vcalls, vcalls_digest = count_result_lines(
+        os.path.join(target_dir, module_name + ".vcalls"))
+    num_obj_allocs, obj_allocs_digest = count_result_lines(
+        os.path.join(target_dir, module_name + "_obj_allocs.txt"))
+
+    return {
+        "wall_time": wall_time,
+        "phases": phases,
+        # ru_maxrss is given in kilobytes on Linux.
+        "peak_rss_kb": rusage.ru_maxrss,
+        "results": {
+            "vcalls": num_vcalls,
+            "vcalls_digest": vcalls_digest,
+            "possible_vcalls": count_possible_vcalls(stdout),
+            "object_allocations": num_obj_allocs,
+            "object_allocations_digest": obj_allocs_digest,
+        },
+    }
+
+
+def run_benchmark(marx, corpus, repeat):
+    measurements = {}
+    for module in corpus["modules"]:
+        verify_pinned(module)
+        for num_threads in corpus.get("num_threads", [1]):
+            key = "%s/%d" % (module["name"], num_threads)
+            runs = [run_marx(marx, module, num_threads)
+                    for _ in range(repeat)]
+
+            # Median of all runs, the results have to be equal in each run.
+            phase_names = set()
+            for run in runs:
+                phase_names.update(run["phases"].keys())
+            measurement = {
+                "wall_time": statistics.median(
+                    run["wall_time"] for run in runs),
+                "phases": {
+                    name: statistics.median(
+                        run["phases"].get(name, 0.0) for run in runs)
+                    for name in sorted(phase_names)},
+                "peak_rss_kb": max(run["peak_rss_kb"] for run in runs),
+                "results": runs[0]["results"],
+                "nondeterministic": any(run["results"] != runs[0]["results"]
+                                        for run in runs),
+            }
+            measurements[key] = measurement
+            print("%-24s wall %8.2fs  rss %8d KB  vcalls %6d  "
+                  "possible %6d  obj_allocs %6d"
+                  % (key,
+                     measurement["wall_time"],
+                     measurement["peak_rss_kb"],
+                     measurement["results"]["vcalls"],
+                     measurement["results"]["possible_vcalls"],
+                     measurement["results"]["object_allocations"]))
+    return measurements
+
+
+def compare(baseline, measurements, time_tolerance, rss_tolerance):
+    """
+    Returns the list of regressions against the baseline.
+    """
+    regressions = []
+    for key, measurement in sorted(measurements.items()):
+        if measurement["nondeterministic"]:
+            regressions.append("%s: results differ between runs" % key)
+        if key not in baseline:
+            print("%s: no baseline" % key)
+            continue
+        base = baseline[key]
+
+        if measurement["results"] != base["results"]:
+            for name, value in sorted(measurement["results"].items()):
+                if base["results"].get(name) != value:
+                    regressions.append("%s: result drift in %s (%s -> %s)"
+                                       % (key, name,
+                                          base["results"].get(name), value))
+
+        def check(name, old, new, tolerance, unit):
+            if old > 0 and new > old * (1.0 + tolerance):
+                regressions.append("%s: %s slowed down %.2f%s -> %.2f%s "
+                                   "(+%.1f%%)"
+                                   % (key, name, old, unit, new, unit,
+                                      (new / old - 1.0) * 100.0))
+
+        check("wall time", base["wall_time"], measurement["wall_time"],
+              time_tolerance, "s")
+        for name, duration in measurement["phases"].items():
+            check("phase " + name, base["phases"].get(name, 0.0), duration,
+                  time_tolerance, "s")
+        if base["peak_rss_kb"] > 0 and measurement["peak_rss_kb"] \
+                > base["peak_rss_kb"] * (1.0 + rss_tolerance):
+            regressions.append("%s: peak RSS grew %d KB -> %d KB"
+                               % (key, base["peak_rss_kb"],
+                                  measurement["peak_rss_kb"]))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="End-to-end benchmark of marx on a pinned corpus.")
+    parser.add_argument("corpus", help="corpus JSON file")
+    parser.add_argument("--marx", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "build", "marx"),
+        help="path to the marx binary")
+    parser.add_argument("--baseline", help="baseline JSON file")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="store the measurements as new baseline")
+    parser.add_argument("--pin", action="store_true",
+                        help="pin the current exported files of the corpus")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="runs per module and thread count")
+    parser.add_argument("--time-tolerance", type=float, default=0.10,
+                        help="allowed relative slowdown")
+    parser.add_argument("--rss-tolerance", type=float, default=0.10,
+                        help="allowed relative peak RSS growth")
+    args = parser.parse_args()
+
+    with open(args.corpus, "r") as fp:
+        corpus = json.load(fp)
+
+    if args.pin:
+        for module in corpus["modules"]:
+            pin_module(module)
+        with open(args.corpus, "w") as fp:
+            json.dump(corpus, fp, indent=4, sort_keys=True)
+        print("Pinned %d modules." % len(corpus["modules"]))
+        return 0
+
+    measurements = run_benchmark(args.marx, corpus, args.repeat)
+
+    if args.baseline and args.update_baseline:
+        with open(args.baseline, "w") as fp:
+            json.dump(measurements, fp, indent=4, sort_keys=True)
+        print("Baseline '%s' updated." % args.baseline)
+        return 0
+
+    if not args.baseline or not os.path.isfile(args.baseline):
+        return 0
+
+    with open(args.baseline, "r") as fp:
+        baseline = json.load(fp)
+    regressions = compare(baseline, measurements, args.time_tolerance,
+                          args.rss_tolerance)
+    for regression in regressions:
+        print("REGRESSION " + regression)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,70 @@
+#ifndef ABI_H
+#define ABI_H
+
+#include "amd64.h"
+#include "memory.h"
+
+#include <memory>
+#include <cstddef>
+
+#define ABI_MAX_ARGUMENTS 6
+
+/*!
+ * \brief Calling convention of ELF64 modules (System V AMD64 ABI).
+ */
+struct AbiTraitsSystemV {
+    static const FileFormatType file_format = FileFormatELF64;
+    static const size_t num_arguments = 6;
+    static const size_t num_scratch = 8;
+
+    static const std::shared_ptr<Register> *arguments();
+    static const std::shared_ptr<Register> *scratch();
+};
+
+/*!
+ * \brief Calling convention of PE64 modules (Microsoft x64).
+ */
+struct AbiTraitsMsvc {
+    static const FileFormatType file_format = FileFormatPE64;
+    static const size_t num_arguments = 4;
+    static const size_t num_scratch = 6;
+
+    static const std::shared_ptr<Register> *arguments();
+    static const std::shared_ptr<Register> *scratch();
+};
+
+/*!
+ * \brief Registers of the calling convention of a module.
+ *
+ * The descriptor is built once per ABI from its traits (see `get_abi`). The
+ * analyses resolve it when they are created and use the tables in their
+ * inner loops instead of switching on the file format each time.
+ */
+struct Abi {
+    FileFormatType file_format;
+
+    const std::shared_ptr<Register> *arguments;
+    size_t num_arguments;
+
+    // Registers not preserved by a call.
+    const std::shared_ptr<Register> *scratch;
+    size_t num_scratch;
+
+    std::shared_ptr<Register> return_value;
+
+    // Initial values of the argument registers ("init_rdi", ...), see
+    // `State::initial_values`.
+    ExpressionPtr arguments_init[ABI_MAX_ARGUMENTS];
+
+    const std::shared_ptr<Register> &this_argument() const {
+        return arguments[0];
+    }
+};
+
+/*!
+ * \brief Returns the calling convention of modules of the given file
+ * format (throws runtime_error exception if the format is not supported).
+ */
+const Abi &get_abi(FileFormatType file_format);
+
+#endif // ABI_H
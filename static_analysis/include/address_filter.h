@@ -0,0 +1,67 @@
+#ifndef ADDRESS_FILTER_H
+#define ADDRESS_FILTER_H
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+
+#define ADDRESS_FILTER_BLOCK_WORDS 8
+#define ADDRESS_FILTER_NUM_BITS 4
+
+/*!
+ * \brief Read-only membership test for a set of addresses.
+ *
+ * A blocked Bloom filter (each address sets `ADDRESS_FILTER_NUM_BITS` bits
+ * in one block of 64 bytes) rejects most addresses that are not contained
+ * by reading a single block. Addresses passing the filter are looked up by
+ * a binary search in the sorted addresses.
+ */
+class AddressFilter {
+private:
+    std::vector<uint64_t> _blocks;
+    uint64_t _block_mask = 0;
+    std::vector<uint64_t> _addrs;
+
+    static uint64_t mix(uint64_t addr) {
+        addr ^= addr >> 33;
+        addr *= 0xff51afd7ed558ccdULL;
+        addr ^= addr >> 33;
+        addr *= 0xc4ceb9fe1a85ec53ULL;
+        addr ^= addr >> 33;
+        return addr;
+    }
+
+public:
+    void build(std::vector<uint64_t> addrs);
+
+    bool contains(uint64_t addr) const {
+        if(_addrs.empty()) {
+            return false;
+        }
+
+        // The block is selected by the lower bits of the hash, the bits in
+        // the block by the upper bits (9 bits each).
+        uint64_t hash = mix(addr);
+        const uint64_t *block =
+                &_blocks[(hash & _block_mask) * ADDRESS_FILTER_BLOCK_WORDS];
+        hash >>= 28;
+        for(uint32_t i = 0; i < ADDRESS_FILTER_NUM_BITS; i++) {
+            uint32_t bit = hash & 0x1ff;
+            if(!(block[bit >> 6] & (1ULL << (bit & 63)))) {
+                return false;
+            }
+            hash >>= 9;
+        }
+
+        return std::binary_search(_addrs.cbegin(), _addrs.cend(), addr);
+    }
+
+    /*!
+     * \brief Returns the contained addresses in ascending order.
+     */
+    const std::vector<uint64_t> &get_addrs() const {
+        return _addrs;
+    }
+};
+
+#endif // ADDRESS_FILTER_H
@@ -0,0 +1,141 @@
+#ifndef ADDRESS_LIST_FILE_H
+#define ADDRESS_LIST_FILE_H
+
+// NOTE: This header is shared with the pintool of the dynamic analysis
+// (which does not link against marx), hence everything is inline and it
+// only depends on the standard library.
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#define ADDRESS_LIST_FILE_MAGIC "MARXADDR"
+#define ADDRESS_LIST_FILE_VERSION 1
+
+// File extension selecting the binary format (text files otherwise).
+#define ADDRESS_LIST_FILE_EXTENSION ".marx_addr"
+
+/*!
+ * \brief Header at the beginning of an address list file.
+ *
+ * An address list file holds the same data as the text files exchanged
+ * between the static and the dynamic analysis (the module name followed by
+ * one address per line): the header, the module name (padded with zeros
+ * to 8 bytes) and `count` little-endian 64 bit addresses sorted in
+ * ascending order. Since the addresses are aligned to 8 bytes, they can be
+ * used directly from a mapping of the file.
+ */
+struct AddressListHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t name_length;
+    uint64_t count;
+};
+
+inline size_t address_list_name_size(uint32_t name_length) {
+    return (static_cast<size_t>(name_length) + 7) & ~static_cast<size_t>(7);
+}
+
+/*!
+ * \brief Checks if the given data starts with the magic of an address list
+ * file.
+ */
+inline bool is_address_list(const uint8_t *data, size_t size) {
+    return size >= sizeof(AddressListHeader)
+           && memcmp(data, ADDRESS_LIST_FILE_MAGIC, 8) == 0;
+}
+
+/*!
+ * \brief Checks if the given file name selects the binary format.
+ */
+inline bool is_address_list_file_name(const std::string &file_name) {
+    const std::string extension = ADDRESS_LIST_FILE_EXTENSION;
+    return file_name.size() >= extension.size()
+           && file_name.compare(file_name.size() - extension.size(),
+                                extension.size(),
+                                extension) == 0;
+}
+
+/*!
+ * \brief Parses the address list file given by its (mapped) content in
+ * place.
+ *
+ * \param addresses Set to the addresses inside of `data`.
+ * \return `false` if the data is no valid address list file.
+ */
+inline bool parse_address_list(const uint8_t *data,
+                               size_t size,
+                               std::string &module_name,
+                               const uint64_t *&addresses,
+                               uint64_t &count) {
+
+    if(!is_address_list(data, size)) {
+        return false;
+    }
+
+    AddressListHeader header;
+    memcpy(&header, data, sizeof(header));
+    if(header.version != ADDRESS_LIST_FILE_VERSION) {
+        return false;
+    }
+
+    const size_t name_offset = sizeof(AddressListHeader);
+    const size_t name_size = address_list_name_size(header.name_length);
+    if(size < name_offset + name_size
+       || (size - name_offset - name_size) / sizeof(uint64_t) < header.count) {
+        return false;
+    }
+
+    module_name.assign(reinterpret_cast<const char*>(data + name_offset),
+                       header.name_length);
+    addresses = reinterpret_cast<const uint64_t*>(data
+                                                  + name_offset
+                                                  + name_size);
+    count = header.count;
+    return true;
+}
+
+/*!
+ * \brief Writes an address list file (the addresses have to be sorted).
+ *
+ * The data is written into a temporary file which replaces the given file
+ * at the end.
+ *
+ * \return `false` if the file could not be written.
+ */
+inline bool write_address_list(const std::string &file_name,
+                               const std::string &module_name,
+                               const uint64_t *addresses,
+                               uint64_t count) {
+
+    const std::string temp_file = file_name + ".tmp";
+    FILE *file = fopen(temp_file.c_str(), "wb");
+    if(file == NULL) {
+        return false;
+    }
+
+    AddressListHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ADDRESS_LIST_FILE_MAGIC, 8);
+    header.version = ADDRESS_LIST_FILE_VERSION;
+    header.name_length = static_cast<uint32_t>(module_name.size());
+    header.count = count;
+
+    const char padding[8] = {0};
+    const size_t name_size = address_list_name_size(header.name_length);
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1
+                   && fwrite(module_name.data(), 1, module_name.size(), file)
+                      == module_name.size()
+                   && fwrite(padding, 1, name_size - module_name.size(), file)
+                      == name_size - module_name.size()
+                   && (count == 0
+                       || fwrite(addresses, sizeof(uint64_t), count, file)
+                          == count);
+    success = fclose(file) == 0 && success;
+
+    return success && rename(temp_file.c_str(), file_name.c_str()) == 0;
+}
+
+#endif // ADDRESS_LIST_FILE_H
@@ -6,26 +6,26 @@
 
 #include <memory>
 
-static const auto register_rip = std::make_shared<Register>(OFFB_RIP);
-static const auto register_rsp = std::make_shared<Register>(OFFB_RSP);
+static const auto register_rip = make_register(OFFB_RIP);
+static const auto register_rsp = make_register(OFFB_RSP);
 
-static const auto register_rax = std::make_shared<Register>(OFFB_RAX);
-static const auto register_rbx = std::make_shared<Register>(OFFB_RBX);
-static const auto register_rcx = std::make_shared<Register>(OFFB_RCX);
-static const auto register_rdx = std::make_shared<Register>(OFFB_RDX);
+static const auto register_rax = make_register(OFFB_RAX);
+static const auto register_rbx = make_register(OFFB_RBX);
+static const auto register_rcx = make_register(OFFB_RCX);
+static const auto register_rdx = make_register(OFFB_RDX);
 
-static const auto register_rbp = std::make_shared<Register>(OFFB_RBP);
-static const auto register_rsi = std::make_shared<Register>(OFFB_RSI);
-static const auto register_rdi = std::make_shared<Register>(OFFB_RDI);
+static const auto register_rbp = make_register(OFFB_RBP);
+static const auto register_rsi = make_register(OFFB_RSI);
+static const auto register_rdi = make_register(OFFB_RDI);
 
-static const auto register_r8 = std::make_shared<Register>(OFFB_R8);
-static const auto register_r9 = std::make_shared<Register>(OFFB_R9);
-static const auto register_r10 = std::make_shared<Register>(OFFB_R10);
-static const auto register_r11 = std::make_shared<Register>(OFFB_R11);
-static const auto register_r12 = std::make_shared<Register>(OFFB_R12);
-static const auto register_r13 = std::make_shared<Register>(OFFB_R13);
-static const auto register_r14 = std::make_shared<Register>(OFFB_R14);
-static const auto register_r15 = std::make_shared<Register>(OFFB_R15);
+static const auto register_r8 = make_register(OFFB_R8);
+static const auto register_r9 = make_register(OFFB_R9);
+static const auto register_r10 = make_register(OFFB_R10);
+static const auto register_r11 = make_register(OFFB_R11);
+static const auto register_r12 = make_register(OFFB_R12);
+static const auto register_r13 = make_register(OFFB_R13);
+static const auto register_r14 = make_register(OFFB_R14);
+static const auto register_r15 = make_register(OFFB_R15);
 
 static const std::shared_ptr<Register> system_v_arguments[] = {
     register_rdi,
@@ -0,0 +1,136 @@
+#ifndef ANALYSIS_CACHE_H
+#define ANALYSIS_CACHE_H
+
+#include "ssa_export.pb.h"
+#include "translator.h"
+#include "mapped_file.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+#define ANALYSIS_CACHE_MAGIC "MARXCACH"
+#define ANALYSIS_CACHE_VERSION 1
+
+/*!
+ * \brief Hashes of all input files the cached data was created from.
+ */
+struct AnalysisCacheKey {
+    uint64_t binary;
+    uint64_t dump;
+    uint64_t dump_no_return;
+    uint64_t ssa;
+    uint64_t funcs_xrefs;
+
+    bool operator==(const AnalysisCacheKey &other) const {
+        return binary == other.binary
+               && dump == other.dump
+               && dump_no_return == other.dump_no_return
+               && ssa == other.ssa
+               && funcs_xrefs == other.funcs_xrefs;
+    }
+};
+
+/*!
+ * \brief Header at the beginning of the cache file.
+ */
+struct AnalysisCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    AnalysisCacheKey key;
+    uint64_t num_functions;
+    uint64_t index_offset;
+};
+
+/*!
+ * \brief Index entry describing the cached data of one function. All offsets
+ * are relative to the beginning of the cache file.
+ */
+struct AnalysisCacheEntry {
+    uint64_t address;
+    uint64_t ssa_offset;
+    uint64_t ssa_size;
+    uint64_t xrefs_offset;
+    uint64_t xrefs_count;
+};
+
+/*!
+ * \brief Class handling the on-disk cache of the ingested exporter data.
+ *
+ * The cache file `{BINARY_NAME}.marx_cache` holds the SSA data and the
+ * function xrefs of all functions in a flat binary layout that is
+ * memory-mapped and used in place on a warm start. It is keyed on the hashes
+ * of the binary and of all files produced by the exporter, so a cache file
+ * is only used as long as none of them changed.
+ *
+ * The cache file starts with an `AnalysisCacheHeader`, followed by the
+ * serialized `ssa::Function` messages and the xref arrays. The index of
+ * `AnalysisCacheEntry`s sorted by function address resides at the end.
+ *
+ * \todo The VEX blocks are still lifted on each run as `IRSB` objects are
+ * no relocatable data.
+ */
+class AnalysisCache {
+private:
+    const std::string _target_file;
+    const std::string _cache_file;
+
+    mutable AnalysisCacheKey _key;
+    mutable bool _key_computed = false;
+
+    std::ofstream _output;
+    uint64_t _output_offset = 0;
+    std::map<uint64_t, AnalysisCacheEntry> _entries;
+    std::mutex _mtx;
+
+public:
+    AnalysisCache(const std::string &target_file);
+
+    AnalysisCache(const AnalysisCache&) = delete;
+    void operator=(const AnalysisCache&) = delete;
+
+    /*!
+     * \brief Returns if a cache file exists that was created from the
+     * current input files.
+     */
+    bool is_valid() const;
+
+    /*!
+     * \brief Imports the SSA data and function xrefs of all functions from
+     * the cache file into the given (not yet finalized) `Translator`.
+     *
+     * \return `false` if the cache does not match the `Translator` (no data
+     * is imported in this case).
+     */
+    bool import_cache(Translator &translator) const;
+
+    /*!
+     * \brief Starts writing a new cache file.
+     *
+     * \return `false` if the cache file can not be created.
+     */
+    bool begin_export();
+
+    /*!
+     * \brief Adds the SSA data of a function to the cache file that is
+     * currently written (thread-safe).
+     */
+    void add_ssa_function(const ssa::Function &ssa_function);
+
+    /*!
+     * \brief Adds the function xrefs of all functions and finishes the cache
+     * file that is currently written.
+     */
+    bool finish_export(const Translator &translator);
+
+private:
+    const AnalysisCacheKey &get_key() const;
+
+    void write_data(const void *data, uint64_t size);
+    void align_output();
+};
+
+#endif // ANALYSIS_CACHE_H
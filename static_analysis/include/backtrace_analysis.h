@@ -6,15 +6,16 @@
 #include "translator.h"
 #include "vcall.h"
 #include "vtable_file.h"
+#include "scratch_arena.h"
+#include "ring_queue.h"
+#include "graph_capture.h"
 #include <vector>
-#include <queue>
 #include <string>
 #include <iomanip>
 #include <boost/graph/graphviz.hpp>
 #include <boost/graph/directed_graph.hpp>
 #include <boost/filesystem.hpp>
 
-#define DEBUG_DUMP_GRAPHS 0
 #define DEBUG_PRINT 0
 
 enum DataFlowNodeType {
@@ -69,8 +70,99 @@ typedef std::unordered_map<BaseInstructionSSAPtr,
                            GraphDataFlow::vertex_descriptor,
                            SSAPtrDeref::Hash,
                            SSAPtrDeref::Compare> InstrGraphNodeMap;
-typedef std::map<GraphDataFlow::vertex_descriptor,
-                 GraphDataFlow::vertex_descriptor> NodeToNodeMap;
+typedef std::unordered_map<GraphDataFlow::vertex_descriptor,
+                           GraphDataFlow::vertex_descriptor> NodeToNodeMap;
+
+/*!
+ * \brief Frozen copy of a `GraphDataFlow` in compressed sparse row layout.
+ *
+ * Nodes are identified by dense ids (`0..num_nodes()-1`). The out edges of
+ * a node are stored consecutively in the order of the original graph, and
+ * the node data the path search needs is kept in side arrays. The graph has
+ * to be frozen again after the original graph was changed.
+ */
+class DataFlowGraphCSR {
+private:
+    std::vector<GraphDataFlow::vertex_descriptor> _vertices;
+    std::unordered_map<GraphDataFlow::vertex_descriptor, uint32_t> _ids;
+
+    std::vector<uint32_t> _out_offsets;
+    std::vector<uint32_t> _out_targets;
+    std::vector<uint8_t> _out_is_ret;
+
+    std::vector<uint8_t> _instr_types;
+    std::vector<uint8_t> _instr_is_call;
+    std::vector<uint64_t> _instr_addrs;
+
+public:
+    void freeze(const GraphDataFlow &graph);
+
+    uint32_t num_nodes() const {
+        return _vertices.size();
+    }
+
+    uint32_t get_id(GraphDataFlow::vertex_descriptor vertex) const {
+        return _ids.at(vertex);
+    }
+
+    GraphDataFlow::vertex_descriptor get_vertex(uint32_t id) const {
+        return _vertices[id];
+    }
+
+    uint32_t out_begin(uint32_t id) const {
+        return _out_offsets[id];
+    }
+
+    uint32_t out_end(uint32_t id) const {
+        return _out_offsets[id + 1];
+    }
+
+    uint32_t get_target(uint32_t edge) const {
+        return _out_targets[edge];
+    }
+
+    bool is_ret_edge(uint32_t edge) const {
+        return _out_is_ret[edge];
+    }
+
+    InstructionTypeSSA get_instr_type(uint32_t id) const {
+        return static_cast<InstructionTypeSSA>(_instr_types[id]);
+    }
+
+    bool is_call(uint32_t id) const {
+        return _instr_is_call[id];
+    }
+
+    uint64_t get_instr_addr(uint32_t id) const {
+        return _instr_addrs[id];
+    }
+};
+
+enum GraphJournalEntryType {
+    GraphJournalAddVertex = 0,
+    GraphJournalAddEdge,
+    GraphJournalChangeVertex,
+    GraphJournalChangeEdge,
+};
+
+struct GraphJournalEntry {
+    GraphJournalEntryType type;
+    GraphDataFlow::vertex_descriptor vertex;
+    GraphDataFlow::edge_descriptor edge;
+
+    // Previous attributes of a changed vertex or edge.
+    DataFlowNode node_data;
+    DataFlowEdge edge_data;
+};
+
+/*!
+ * \brief Log of the changes to the final graph since the transaction
+ * started (replayed backwards on a rollback).
+ */
+struct GraphDataFlowJournal {
+    bool active = false;
+    std::vector<GraphJournalEntry> entries;
+};
 
 enum TrackingType {
     TrackingTypeCaller = 0,
@@ -133,6 +225,68 @@ typedef std::unordered_set<TrackingInstruction,
                            TrackingInstruction::Hash,
                            TrackingInstruction::Compare> TrackingInstructionSet;
 
+//! Tracking instructions that only live as long as the analysis (allocated
+//! from the arena of the item if created during one).
+typedef std::unordered_set<TrackingInstruction,
+                           TrackingInstruction::Hash,
+                           TrackingInstruction::Compare,
+                           ScratchAllocator<TrackingInstruction>>
+                                                ScratchTrackingInstructionSet;
+typedef RingQueue<TrackingInstruction,
+                  ScratchAllocator<TrackingInstruction>>
+                                                ScratchTrackingInstructionQueue;
+
+// Operand slots per tracking type in the visited bits of an instruction
+// (four tracking types fill one 64 bit word).
+#define TRACKING_VISITED_SLOTS 16
+
+/*!
+ * \brief Set of the tracking instructions that were already processed.
+ *
+ * A tracking instruction of an SSA instruction of a function (and without a
+ * transition order) is stored as one bit of the function's bitset, indexed
+ * by the id of the instruction, the tracking type and the position of the
+ * tracked operand in the uses of the instruction. All others (e.g.,
+ * instructions created by the analysis) are kept in a hash set.
+ */
+class TrackingVisitedSet {
+private:
+    typedef std::vector<uint64_t, ScratchAllocator<uint64_t>> Words;
+    typedef std::unordered_map<const Function*,
+                               Words,
+                               std::hash<const Function*>,
+                               std::equal_to<const Function*>,
+                               ScratchAllocator<std::pair<const Function* const,
+                                                          Words>>> FunctionWords;
+
+    FunctionWords _functions;
+
+    // Bitset of the last function (consecutive tracking instructions mostly
+    // lie in the same function).
+    const Function *_last_function = nullptr;
+    Words *_last_words = nullptr;
+
+    ScratchTrackingInstructionSet _others;
+
+    /*!
+     * \brief Returns the position of the operand in the uses of the
+     * instruction (`TRACKING_VISITED_SLOTS` if it is not one of the first
+     * uses).
+     */
+    static uint32_t get_operand_slot(const BaseInstructionSSA &instr,
+                                     const OperandSSA &operand);
+
+public:
+    /*!
+     * \brief Adds the tracking instruction which refers to the given SSA
+     * instruction of the given function.
+     * \return Returns `false` if it was already part of the set.
+     */
+    bool insert(const Function &function,
+                const BaseInstructionSSA &instr,
+                const TrackingInstruction &track);
+};
+
 template <class T>
 class FullDataFlowNodeWriter {
 public:
@@ -291,17 +445,31 @@ public:
     CallOfRetInstruction(const CallOfRetInstruction &obj);
 };
 
+struct DefUseStep;
+
 class BacktraceAnalysis {
 private:
     const std::string &_module_name;
     const std::string &_target_dir;
     std::unordered_set<uint64_t> _unresolvable_icalls;
     std::string _graph_dump_dir;
+    std::string _dir_prefix;
+
+    // Stages of the rounds whose graphs are captured (\see `GraphCapture`).
+    uint32_t _capture_stages = 0;
     uint32_t _round = 0;
     GraphDataFlow _master_graph;
     InstrGraphNodeMap _master_instr_graph_node_map;
     boost::property_map<GraphDataFlow, boost::vertex_index_t>::type _indexmap;
     bool _indexmap_dirty = false;
+    DataFlowGraphCSR _graph_csr;
+    bool _graph_csr_dirty = true;
+    GraphDataFlowJournal _journal;
+
+    // Graph of the operand tracked in the current round (reused in order
+    // to avoid allocations in each round).
+    GraphDataFlow _round_graph;
+    InstrGraphNodeMap _round_instr_graph_node_map;
 
 protected:
     uint64_t _start_addr;
@@ -310,8 +478,8 @@ protected:
     const VTableFile &_vtables;
     const VCallFile &_vcalls;
     const std::unordered_set<uint64_t> &_new_operators;
-    std::queue<TrackingInstruction> _work_queue;
-    TrackingInstructionSet _processed_instrs;
+    ScratchTrackingInstructionQueue _work_queue;
+    TrackingVisitedSet _processed_instrs;
     GraphDataFlow &_graph;
     InstrGraphNodeMap &_instr_graph_node_map;
 
@@ -323,12 +491,32 @@ private:
     void basic_ctor(uint64_t start_addr,
                     const std::string &dir_prefix);
 
+    /*!
+     * \brief Logs the given edge of the final graph in the journal if a
+     * transaction is active.
+     */
+    GraphDataFlow::edge_descriptor journal_edge(
+                                    const GraphDataFlow &graph,
+                                    const GraphDataFlow::edge_descriptor &edge,
+                                    bool is_new);
+
     void augment_use(GraphDataFlow &graph,
                      InstrGraphNodeMap &instr_graph_node_map,
                      const Function &function,
                      const OperandSSAPtr &initial_use,
                      const BaseInstructionSSAPtr &initial_instr);
 
+    /*!
+     * \brief Marks the def-use steps that are relevant and lie on a path to
+     * the initial instruction and collects the instructions of these paths
+     * (including the initial instruction).
+     */
+    void select_def_use_steps(const std::vector<DefUseStep> &steps,
+                              const OperandSSAPtr &initial_use,
+                              const BaseInstructionSSAPtr &initial_instr,
+                              std::vector<bool> &out_relevant_steps,
+                              BaseInstructionSSAPtrSet &out_reached_instrs);
+
     /*!
      * \brief Preprocessing of tailjmps (e.g., search the definition of
      * the operand we want to track in the function).
@@ -373,6 +561,15 @@ private:
     void draw_final_edge(const TrackingInstruction &curr,
                          const BaseInstructionSSAPtr &curr_instr);
 
+    /*!
+     * \brief Hands the graph to the graph capture (`curr` is the tracking
+     * instruction of the round in function `function_addr` if any).
+     */
+    void capture_graph(const GraphDataFlow &graph,
+                       GraphCaptureStage stage,
+                       const TrackingInstruction *curr,
+                       uint64_t function_addr);
+
 protected:
     /*!
      * \brief Dumps the graph as .dot file to the given file name.
@@ -440,6 +637,24 @@ protected:
                                 const BaseInstructionSSAPtr &initial_instr,
                                 const TrackingInstruction &initial_track) = 0;
 
+    /*!
+     * \brief Returns `true` if `augment_use()` shall only build the part of
+     * the data flow graph that reaches the initial instruction over the
+     * def-use steps accepted by `is_def_use_step_relevant()`. Branches that
+     * would be pruned afterwards anyway are then never built (default:
+     * `false`, the whole def-use chain is added).
+     */
+    virtual bool prune_during_augment_use() const;
+
+    /*!
+     * \brief Decides if the edge of the given def-use step is part of the
+     * data flow graph (only used if `prune_during_augment_use()` is set).
+     */
+    virtual bool is_def_use_step_relevant(
+                                const DefUseStep &step,
+                                const OperandSSAPtr &initial_use,
+                                const BaseInstructionSSAPtr &initial_instr) const;
+
     /*!
      * \brief Finalizes the created graph before the function obtain() is
      * terminated.
@@ -524,6 +739,25 @@ protected:
 
     void merge_graphs(const GraphDataFlow &graph);
 
+    /*!
+     * \brief Starts logging all node and edge additions and attribute
+     * changes of the final graph so that they can be undone. Nodes must not
+     * be removed from the final graph during a transaction.
+     */
+    void begin_graph_transaction();
+
+    /*!
+     * \brief Keeps all changes since `begin_graph_transaction`.
+     */
+    void commit_graph_transaction();
+
+    /*!
+     * \brief Undoes all changes to the final graph since
+     * `begin_graph_transaction` (data of the specializations changed in
+     * `post_merge_graphs` is not restored).
+     */
+    void rollback_graph_transaction();
+
     boost::property_map<GraphDataFlow, boost::vertex_index_t>::type
                                           create_indexmap(GraphDataFlow &graph);
 
@@ -568,6 +802,12 @@ public:
 
     void update_indexmap();
 
+    /*!
+     * \brief Returns the graph in CSR layout for the path searches. It is
+     * frozen on first use after the graph was changed.
+     */
+    const DataFlowGraphCSR &get_graph_csr();
+
     const InstrGraphNodeMap &get_graph_instr_map() const;
 
     const std::unordered_set<uint64_t> &get_unresolvable_icalls() const;
@@ -21,6 +21,9 @@ protected:
 
     const FileFormatType _file_format;
 
+    // Calling convention of the module (resolved once).
+    const Abi &_abi;
+
     PathStates _states;
     PathStates _side_effects;
 
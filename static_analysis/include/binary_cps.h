@@ -5,15 +5,55 @@
 #include "instruction_backtrace_intra.h"
 #include "block.h"
 
+#include <future>
+
 struct BinaryCPSVfunc {
     uint64_t addr;
     uint32_t vtbl_idx;
+
+    bool operator==(const BinaryCPSVfunc &other) const {
+        return addr == other.addr && vtbl_idx == other.vtbl_idx;
+    }
+
+    /*!
+     * \brief Type that specifies how `BinaryCPSVfunc` is hashed.
+     */
+    struct Hash {
+        std::size_t operator() (const BinaryCPSVfunc &e) const {
+            size_t h = 0;
+            std::hash_combine(h, e.addr);
+            std::hash_combine(h, e.vtbl_idx);
+            return h;
+        }
+    };
+};
+
+/*!
+ * \brief Concurrent memo of the `has_vtable_write` results per (virtual
+ * function, vtable).
+ *
+ * The first thread asking for a pair computes the result, concurrent threads
+ * asking for the same pair wait for it instead of repeating the backtrace.
+ */
+class VtableWriteMemo {
+private:
+    std::mutex _mtx;
+    std::unordered_map<BinaryCPSVfunc,
+                       std::shared_future<bool>,
+                       BinaryCPSVfunc::Hash> _results;
+
+public:
+    bool get(const BinaryCPSVfunc &candidate,
+             const std::function<bool()> &compute);
+
+    void clear();
 };
 
 extern std::queue<BinaryCPSVfunc> queue_vfunc_addrs;
 extern std::mutex queue_vfunc_mtx;
 extern std::vector<BinaryCPSVfunc> dtor_candidates;
 extern std::mutex dtor_candidates_mtx;
+extern VtableWriteMemo vtable_write_memo;
 
 void binary_cps_analysis(const std::string &target_file,
                          const std::string &module_name,
@@ -26,6 +66,15 @@ void binary_cps_dtor_analysis(const std::string &module_name,
                               EngelsAnalysisObjects &analysis_obj,
                               uint32_t thread_number);
 
+std::vector<BinaryCPSVfunc> order_callee_first(
+                                  const Translator &translator,
+                                  const std::vector<BinaryCPSVfunc> &candidates);
+
+bool has_vtable_write_memo(const std::string &module_name,
+                           const std::string &target_dir,
+                           EngelsAnalysisObjects &analysis_obj,
+                           const BinaryCPSVfunc &candidate);
+
 bool has_vtable_write(const std::string &module_name,
                       const std::string &target_dir,
                       EngelsAnalysisObjects &analysis_obj,
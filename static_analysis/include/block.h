@@ -3,6 +3,8 @@
 
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
 
 #include "state.h"
 
@@ -10,7 +12,11 @@ extern "C" {
 #include <valgrind/libvex.h>
 }
 
+// Id of blocks that are not part of a function's CFG.
+#define BLOCK_ID_NONE UINT64_MAX
+
 class Block;
+class BlockTransfer;
 
 std::ostream &operator<<(std::ostream &stream, const Block &block);
 
@@ -70,6 +76,16 @@ struct Terminator {
     bool is_tail;
 };
 
+/*!
+ * \brief The transfer function of a block, compiled on first use.
+ *
+ * Shared by all copies of a `Block` (they describe the same code).
+ */
+struct BlockTransferCache {
+    std::once_flag compiled;
+    std::shared_ptr<const BlockTransfer> transfer;
+};
+
 /*!
  * \brief Class tieing together the underlying VEX block and additional
  * information such as block address and terminator.
@@ -77,18 +93,20 @@ struct Terminator {
 class Block {
 private:
     uintptr_t _address;
-    IRSB *_vex_block;
+    uint64_t _id;
+    const IRSB *_vex_block;
     Terminator _terminator;
     std::set<uint64_t> _addresses;
     uint32_t _num_instructions;
+    std::shared_ptr<BlockTransferCache> _transfer_cache;
 
 public:
     Block(uintptr_t address,
-          IRSB *block,
+          const IRSB *block,
           const Terminator &terminator);
 
     Block(uintptr_t address,
-          IRSB *block,
+          const IRSB *block,
           const Terminator &terminator,
           uint32_t num_instructions);
 
@@ -100,6 +118,16 @@ public:
         return _address;
     }
 
+    /*!
+     * \brief Returns the id of the block. Ids are assigned consecutively to
+     * all blocks of a function's CFG constructed by the process (copies keep
+     * the id), hence they can be used to index dense tables. Artificial blocks
+     * built with an explicit instruction count have the id `BLOCK_ID_NONE`.
+     */
+    uint64_t get_id() const {
+        return _id;
+    }
+
     /*!
      * \brief get_last_address
      * \return Returns the block's last virtual address
@@ -133,6 +161,8 @@ public:
 
     void retrieve_semantics(State &state) const;
 
+    const BlockTransfer &get_transfer() const;
+
     /*!
      * \brief Returns if the block contains the given address.
      * \return Returns `true` if the block contains the given address.
@@ -1,6 +1,7 @@
 #ifndef BLOCK_SEMANTICS_H
 #define BLOCK_SEMANTICS_H
 
+#include "block.h"
 #include "expression.h"
 #include "state.h"
 
@@ -10,34 +11,200 @@ extern "C" {
 }
 
 #include <map>
+#include <string>
+#include <vector>
 #include <unordered_map>
 
 #define arg_out
-class BlockSemantics;
+class BlockTransfer;
 
-typedef ExpressionPtr (BlockSemantics::*ExpressionParser)(const IRExpr&);
-typedef bool (BlockSemantics::*StatementHandler)(const IRStmt&);
+typedef uint32_t (BlockTransfer::*ExpressionCompiler)(const IRExpr&);
+typedef void (BlockTransfer::*StatementCompiler)(const IRStmt&);
 
 // TODO: Handle calls, calling conventions (System-V for now).
 // FIXME: This class is infected with shared_ptr:s, consider boost::variant.
 
-class Block;
+/*!
+ * \brief Enumerates the nodes of a `TransferExpression` tree.
+ */
+enum TransferExpressionType {
+    //! The value is not known (independent of the state).
+    TransferExpressionUnknown = 0,
+
+    //! A constant value (`value`).
+    TransferExpressionConstant,
+
+    //! The value of register `value` as found in the state (looked up by
+    //! the key `BlockTransfer::_keys[lhs]`).
+    TransferExpressionGet,
+
+    //! The value of temporary `value` as found in the state (looked up by
+    //! the key `BlockTransfer::_keys[lhs]`).
+    TransferExpressionRdTmp,
+
+    //! The operation `operation` combining the nodes `lhs` and `rhs`.
+    TransferExpressionOperation,
+
+    //! A memory indirection of the address given by node `lhs`.
+    TransferExpressionLoad,
+
+    //! The addition of node `lhs` (a register or temporary) and the
+    //! constant `value` (fuses the common `Get`/`Add64`/`Const` sequence).
+    TransferExpressionOffset,
+
+    //! The VEX expression cannot be handled, evaluating it throws a
+    //! `runtime_error` (with message `BlockTransfer::_errors[value]`).
+    TransferExpressionError,
+};
+
+/*!
+ * \brief Node of an expression of a `BlockTransfer`. Children are referenced
+ * by their index.
+ */
+struct TransferExpression {
+    TransferExpressionType type;
+    OperationType operation;
+    uint64_t value;
+    uint32_t lhs;
+    uint32_t rhs;
+};
+
+/*!
+ * \brief Enumerates the statements of a `BlockTransfer` (the VEX statements
+ * without any effect on the state are dropped when compiling).
+ */
+enum TransferStatementType {
+    //! Binds temporary `target` to node `data`.
+    TransferStatementWrTmp = 0,
+
+    //! Binds register `target` to node `data`.
+    TransferStatementPut,
+
+    //! Binds the memory at the address given by node `target` to node `data`.
+    TransferStatementStore,
+
+    //! Reverts the return address set up by a call or `ret` (the target is
+    //! given by node `data`, `rsp` is adjusted using `operation`).
+    TransferStatementAbiHint,
+
+    //! Extracting the semantics fails (after evaluating node `data`).
+    TransferStatementFail,
+
+    //! The VEX statement cannot be handled, a `runtime_error` is thrown
+    //! (with message `BlockTransfer::_errors[target]`).
+    TransferStatementError,
+};
+
+/*!
+ * \brief Statement of a `BlockTransfer`.
+ */
+struct TransferStatement {
+    TransferStatementType type;
+    OperationType operation;
+    uint32_t target;
+    uint32_t data;
+
+    //! Symbol bound to the destination if its value is not known (the
+    //! address is the payload of the symbol).
+    SymbolicKind unknown_kind;
+    uint64_t unknown_address;
+};
+
+/*!
+ * \brief The transfer function of a `Block`, i.e., its VEX block compiled
+ * into a flat program working on `State`s.
+ *
+ * Everything that does not depend on the incoming state (statement and
+ * expression handlers, types, unsupported operations, the number of
+ * instructions held by the block and the names of symbols) is resolved
+ * once. Applying the transfer function substitutes the registers and
+ * temporaries it reads with their values in the given state and yields
+ * exactly the state `BlockSemantics` computed from the VEX block itself.
+ *
+ * Objects of this class are immutable after construction and can be applied
+ * by several threads at once. \see `Block::get_transfer`
+ */
+class BlockTransfer {
+private:
+    std::vector<TransferExpression> _expressions;
+    std::vector<TransferStatement> _statements;
+    std::vector<std::string> _errors;
+
+    // Registers and temporaries read by the block (only used as lookup keys,
+    // never stored in a state).
+    std::vector<ExpressionPtr> _keys;
+
+    // Only used while compiling.
+    uintptr_t _address;
+    TerminatorType _terminator_type;
+    uint64_t _curr_addr = 0;
+
+    static ExpressionCompiler get_expression_compiler(IRExprTag tag);
+    static StatementCompiler get_statement_compiler(IRStmtTag tag);
+
+public:
+    BlockTransfer() = delete;
+    BlockTransfer(const BlockTransfer&) = delete;
+    void operator=(const BlockTransfer&) = delete;
+
+    BlockTransfer(const Block &block);
+
+    bool apply(State &state) const;
+
+private:
+    ExpressionPtr evaluate(uint32_t index, const State &state,
+                           const ExpressionPtr &unknown) const;
+    bool is_unknown(uint32_t index) const;
+    bool is_error(uint32_t index) const;
+
+    uint32_t add_expression(TransferExpressionType type,
+                            uint64_t value=0,
+                            OperationType operation=OperationAdd,
+                            uint32_t lhs=0,
+                            uint32_t rhs=0);
+    uint32_t add_error(const std::string &message);
+    uint32_t add_key(const ExpressionPtr &key);
+    void add_statement(TransferStatementType type,
+                       uint32_t target,
+                       uint32_t data,
+                       SymbolicKind unknown_kind=SymbolicNamed,
+                       uint64_t unknown_address=0,
+                       OperationType operation=OperationAdd);
+
+    uint32_t compile_expression(const IRExpr &expression);
+    bool compile_statement(const IRStmt &statement);
+
+    bool get_size(const IRType &type, arg_out uint8_t &size) const;
+
+    // Expression compilers.
+    uint32_t compile_get(const IRExpr &expression);
+    uint32_t compile_unknown(const IRExpr &expression);
+    uint32_t compile_rdtmp(const IRExpr &expression);
+    uint32_t compile_binop(const IRExpr &expression);
+    uint32_t compile_unop(const IRExpr &expression);
+    uint32_t compile_load(const IRExpr &expression);
+    uint32_t compile_const(const IRExpr &expression);
+
+    // Statement compilers.
+    void compile_noop(const IRStmt &statement);
+    void compile_put(const IRStmt &statement);
+    void compile_wrtmp(const IRStmt &statement);
+    void compile_store(const IRStmt &statement);
+    void compile_abi_hint(const IRStmt &statement);
+};
 
 /*!
  * \brief Class computing the effective semantics of a given `Block`.
  *
+ * The semantics are computed by applying the (cached) transfer function of
+ * the block. \see `BlockTransfer`
+ *
  * \todo Allow sub-classes of this class at every point where this class is
  * currently use. This enables a user to implement custom semantics.
  */
 class BlockSemantics {
 private:
     State &_state;
-    const Block &_block;
-    std::shared_ptr<Unknown> _unknown;
-    uint64_t _curr_addr;
-
-    static const std::map<IRExprTag, ExpressionParser> _expression_parser;
-    static const std::map<IRStmtTag, StatementHandler> _statement_handler;
 
 public:
     BlockSemantics() = delete;
@@ -53,44 +220,6 @@ public:
     const State &get_state() const {
         return _state;
     }
-
-private:
-    bool extract_semantics(const IRSB &block);
-
-    ExpressionPtr parse_expression(const IRExpr &expression);
-    bool handle_statement(const IRStmt &statement);
-
-    uint64_t get_mask(uint8_t size) const;
-    bool get_size(const IRType &type, arg_out uint8_t &size) const;
-    bool parse_type(const IRType &type, arg_out uint8_t &size,
-                    arg_out uint64_t &mask) const;
-
-    // Expression parsers.
-    ExpressionPtr parse_get(const IRExpr &expression);
-    ExpressionPtr parse_geti(const IRExpr &expression);
-
-    ExpressionPtr parse_rdtmp(const IRExpr &expression);
-
-    ExpressionPtr parse_qop(const IRExpr &expression);
-    ExpressionPtr parse_triop(const IRExpr &expression);
-    ExpressionPtr parse_binop(const IRExpr &expression);
-    ExpressionPtr parse_unop(const IRExpr &expression);
-
-    ExpressionPtr parse_load(const IRExpr &expression);
-    ExpressionPtr parse_const(const IRExpr &expression);
-
-    ExpressionPtr parse_ccall(const IRExpr &expression);
-    ExpressionPtr parse_ite(const IRExpr &expression);
-
-    // Statement handlers.
-    bool handle_noop(const IRStmt &statement);
-    bool handle_put(const IRStmt &statement);
-    bool handle_puti(const IRStmt &statement);
-    bool handle_wrtmp(const IRStmt &statement);
-    bool handle_store(const IRStmt &statement);
-    bool handle_storeg(const IRStmt &statement);
-    bool handle_loadg(const IRStmt &statement);
-    bool handle_abi_hint(const IRStmt &statement);
 };
 
 #endif // BLOCK_SEMANTICS_H
@@ -0,0 +1,43 @@
+#ifndef CHUNKED_TEXT_H
+#define CHUNKED_TEXT_H
+
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Number of items formatted into one chunk.
+#define CHUNKED_TEXT_ITEMS_PER_CHUNK 4096
+
+/*!
+ * \brief Appends the value as lower case hex digits without prefix (same
+ * text as `ostream << hex`).
+ */
+void append_hex(std::string &out, uint64_t value);
+
+/*!
+ * \brief Appends the value as decimal digits (same text as `ostream << dec`).
+ */
+void append_dec(std::string &out, uint64_t value);
+
+typedef std::function<void(size_t begin, size_t end, std::string &out)>
+                                                         ChunkFormatter;
+
+/*!
+ * \brief Writes the given header and the text of `num_items` items into the
+ * given file.
+ *
+ * The items are formatted in chunks of `CHUNKED_TEXT_ITEMS_PER_CHUNK`
+ * (`format` appends the text of the items `[begin, end)`) by the given
+ * number of threads while the calling thread writes the finished chunks in
+ * order. Hence, the file does not depend on the number of threads.
+ *
+ * \return `false` if the file could not be written.
+ */
+bool write_chunked_text(const std::string &file_name,
+                        const std::string &header,
+                        size_t num_items,
+                        uint32_t num_threads,
+                        const ChunkFormatter &format);
+
+#endif // CHUNKED_TEXT_H
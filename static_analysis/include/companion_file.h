@@ -0,0 +1,138 @@
+#ifndef COMPANION_FILE_H
+#define COMPANION_FILE_H
+
+#include "mapped_file.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <type_traits>
+
+#define COMPANION_FILE_MAGIC "MARXBIN\0"
+#define COMPANION_FILE_VERSION 1
+
+enum CompanionFileType {
+    CompanionFileVTables = 1,
+    CompanionFileHierarchy,
+    CompanionFileIncremental,
+    CompanionFileSummary,
+};
+
+/*!
+ * \brief Header at the beginning of a companion file.
+ */
+struct CompanionFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t type;
+
+    // Hash of the text input(s) the companion file was created from.
+    uint64_t source_hash;
+};
+
+/*!
+ * \brief Class reading a binary companion file of a text input in place.
+ *
+ * Companion files (`{TEXT_FILE}.marx_bin`) hold the same data as the text
+ * input they belong to as a flat sequence of little-endian values, arrays
+ * (element count followed by the elements) and strings (length followed by
+ * the characters). All values are aligned to 8 bytes, hence arrays can be
+ * used directly from the mapping.
+ *
+ * All read functions return `false` if the file is truncated.
+ */
+class CompanionFileReader {
+private:
+    MappedFile _file;
+    size_t _offset = 0;
+
+    const uint8_t *consume(size_t size);
+
+public:
+    CompanionFileReader(const std::string &file_name);
+
+    /*!
+     * \brief Checks if the file is a companion file of the given type that
+     * was created from the text input with the given hash.
+     */
+    bool is_valid(CompanionFileType type, uint64_t source_hash);
+
+    bool read_value(uint64_t &value);
+
+    template<typename T>
+    bool read(T &value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                      "Only integral values are stored as value.");
+        uint64_t temp;
+        if(!read_value(temp)) {
+            return false;
+        }
+        value = static_cast<T>(temp);
+        return true;
+    }
+
+    /*!
+     * \brief Returns a pointer to an array of 64 bit values inside the
+     * mapping.
+     */
+    bool read_array(const uint64_t *&values, uint64_t &count);
+
+    bool read_string(std::string &value);
+};
+
+/*!
+ * \brief Class writing a binary companion file.
+ * \see `CompanionFileReader`
+ *
+ * The data is written into a temporary file which replaces the companion
+ * file when `finish` is called.
+ */
+class CompanionFileWriter {
+private:
+    const std::string _file_name;
+    std::ofstream _output;
+
+    void write_data(const void *data, size_t size);
+
+public:
+    CompanionFileWriter(const std::string &file_name,
+                        CompanionFileType type,
+                        uint64_t source_hash);
+
+    void write_value(uint64_t value);
+
+    template<typename T>
+    void write(T value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                      "Only integral values are stored as value.");
+        write_value(static_cast<uint64_t>(value));
+    }
+
+    void write_array(const uint64_t *values, uint64_t count);
+
+    template<typename Container>
+    void write_container(const Container &values) {
+        write_value(values.size());
+        for(uint64_t value : values) {
+            write_value(value);
+        }
+    }
+
+    void write_string(const std::string &value);
+
+    /*!
+     * \brief Finishes the companion file.
+     * \return `false` if the companion file could not be written.
+     */
+    bool finish();
+};
+
+/*!
+ * \brief Combines the content hashes of the given files.
+ *
+ * \return The hash value or 0 if one of the files can not be opened.
+ */
+uint64_t hash_files(const std::vector<std::string> &file_names);
+
+#endif // COMPANION_FILE_H
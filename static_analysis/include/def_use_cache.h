@@ -0,0 +1,120 @@
+#ifndef DEF_USE_CACHE_H
+#define DEF_USE_CACHE_H
+
+#include "function.h"
+#include "ssa_instruction.h"
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#define DEF_USE_CACHE_NUM_SHARDS 64
+
+/*!
+ * \brief One edge of the def-use chain of an operand
+ * (`def_instr -> use_instr` via `operand`).
+ */
+struct DefUseStep {
+    BaseInstructionSSAPtr use_instr;
+    BaseInstructionSSAPtr def_instr;
+    OperandSSAPtr operand;
+};
+
+/*!
+ * \brief Intra-procedural def-use chain of an operand used by an instruction.
+ *
+ * The steps are stored in the order they are found by the backward walk,
+ * hence replaying them creates exactly the same graph as walking the
+ * function again.
+ */
+struct DefUseSummary {
+    std::vector<DefUseStep> steps;
+};
+
+typedef std::shared_ptr<const DefUseSummary> DefUseSummaryPtr;
+
+/*!
+ * \brief The operand that is tracked starting from an instruction of
+ * a function.
+ */
+struct DefUseSummaryKey {
+    const Function *function;
+    const BaseInstructionSSA *instr;
+    OperandSSAPtr operand;
+
+    /*!
+     * \brief Type that specifies how `DefUseSummaryKey` is hashed.
+     */
+    struct Hash {
+        std::size_t operator() (const DefUseSummaryKey &e) const {
+            size_t h = std::hash<const Function*>()(e.function);
+            std::hash_combine(h, std::hash<const BaseInstructionSSA*>()(
+                                                                   e.instr));
+            std::hash_combine(h, e.operand->hash());
+            return h;
+        }
+    };
+    /*!
+     * \brief Type that specifies how `DefUseSummaryKey` is compared.
+     */
+    struct Compare {
+        size_t operator() (DefUseSummaryKey const &a,
+                           DefUseSummaryKey const &b) const {
+            return a.function == b.function
+                   && a.instr == b.instr
+                   && *(a.operand) == *(b.operand);
+        }
+    };
+};
+
+/*!
+ * \brief Singleton memoizing the intra-procedural def-use chains that are
+ * walked by `BacktraceAnalysis::augment_use()`.
+ *
+ * Many icalls share the same operands (e.g., the same `this` pointer
+ * loaded once in a function and used by several vcalls), hence the chains
+ * are walked once and spliced into the graphs of all later queries
+ * (including queries of other threads and other analyses). The SSA data of
+ * a function does not change after the `Translator` is finalized, so entries
+ * never have to be invalidated.
+ *
+ * The cache is split into shards that are locked independently in order
+ * to keep the contention of the worker threads low.
+ */
+class DefUseSummaryCache {
+private:
+    typedef std::unordered_map<DefUseSummaryKey,
+                               DefUseSummaryPtr,
+                               DefUseSummaryKey::Hash,
+                               DefUseSummaryKey::Compare> DefUseSummaryMap;
+
+    struct Shard {
+        std::mutex mtx;
+        DefUseSummaryMap summaries;
+    };
+
+    Shard _shards[DEF_USE_CACHE_NUM_SHARDS];
+
+    DefUseSummaryCache() = default;
+
+public:
+    DefUseSummaryCache(const DefUseSummaryCache&) = delete;
+    void operator=(const DefUseSummaryCache&) = delete;
+
+    static DefUseSummaryCache &get_instance();
+
+    /*!
+     * \brief Returns the def-use chain of the given operand used by the
+     * given instruction (walks the function if it is not cached yet).
+     */
+    DefUseSummaryPtr get_summary(const Function &function,
+                                 const OperandSSAPtr &initial_use,
+                                 const BaseInstructionSSAPtr &initial_instr);
+
+private:
+    DefUseSummaryPtr create_summary(const Function &function,
+                                    const OperandSSAPtr &initial_use) const;
+};
+
+#endif // DEF_USE_CACHE_H
@@ -1,7 +1,9 @@
 #ifndef ENGELS_H
 #define ENGELS_H
 
+#include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <queue>
 #include <string>
@@ -9,6 +11,7 @@
 #include <unordered_map>
 #include <map>
 #include <thread>
+#include "abi.h"
 #include "amd64_ssa.h"
 #include "translator.h"
 #include "new_operators.h"
@@ -20,17 +23,24 @@
 #include "icalls.h"
 #include "engels_boost.h"
 #include "vtable_hierarchy.h"
+#include "work_queue.h"
 
 #define DEBUG_ENGELS_PRINT_PATHS 0
 #define DEBUG_ENGELS_PRINT_VERBOSE 0
 #define DEBUG_ENGELS_PRINT_SYM_EXEC_STATES 0
 #define DEBUG_ENGELS_PRINT 0
 
-extern std::queue<uint64_t> queue_icall_addrs;
-extern std::mutex queue_icall_mtx;
+// Keeps the icall instruction and the call register expression of each
+// result until the export (only needed for printing them).
+#define DEBUG_ENGELS_KEEP_RESULT_DIAGNOSTICS 0
 
-extern std::queue<uint64_t> queue_vcall_addrs;
-extern std::mutex queue_vcall_mtx;
+class IncrementalState;
+class EngelsCheckpoint;
+struct AnalysisShard;
+
+extern WorkQueue queue_icall_addrs;
+
+extern WorkQueue queue_vcall_addrs;
 
 extern std::unordered_set<uint64_t> repeat_icall_addrs;
 // key = address of the icall to analyze
@@ -43,10 +53,19 @@ extern std::unordered_map<uint64_t,
 extern std::unordered_map<uint64_t,
                           std::unordered_set<uint64_t>>
                                         vfunc_addr_unresolvable_map;
+// key = address of an unresolvable icall
+// value = set of icall addresses whose analysis waits for it
+extern std::unordered_map<uint64_t,
+                          std::unordered_set<uint64_t>>
+                                        icall_addr_dependents_map;
+// key = address of a virtual function that has no xref
+// value = set of icall addresses whose analysis waits for it
+extern std::unordered_map<uint64_t,
+                          std::unordered_set<uint64_t>>
+                                        vfunc_addr_dependents_map;
 extern std::mutex repeat_icall_mtx;
 
-extern std::queue<uint64_t> queue_vtable_xref_addrs;
-extern std::mutex queue_vtable_xref_mtx;
+extern WorkQueue queue_vtable_xref_addrs;
 extern std::mutex vtable_xref_data_mtx;
 
 typedef std::unordered_map<GraphDataFlow::vertex_descriptor,
@@ -101,17 +120,92 @@ struct EngelsVTableXrefAnalysis {
     std::map<uint64_t, VtableBacktraceAnalysisPtr> xref_analysis_map;
 };
 
+/*!
+ * \brief Shared state of the worker threads of the engels analysis
+ * (guarded by `mtx`).
+ */
+struct EngelsPipeline {
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    // Number of queued or running items of each phase.
+    size_t pending_vtable_xrefs = 0;
+    size_t pending_lightweight = 0;
+    size_t pending_vcalls = 0;
+
+    // All icalls that were ever queued for the icall analysis.
+    std::unordered_set<uint64_t> scheduled_vcalls;
+
+    // Incremented on every change in order to wake up waiting workers.
+    uint64_t version = 0;
+
+    bool stop = false;
+    bool exit_when_idle = false;
+};
+
+/*!
+ * \brief Result of the analysis of an icall.
+ *
+ * Only the data needed for the export is kept, hence the analysis graph and
+ * expressions of the icall can be released as soon as its analysis
+ * finished (unless `DEBUG_ENGELS_KEEP_RESULT_DIAGNOSTICS` is set).
+ */
 struct EngelsResult {
-    BaseInstructionSSAPtr icall_instr;
-    ExpressionPtr call_reg_expr_ptr;
+    uint64_t icall_addr;
     uint32_t vtable_idx;
     uint32_t entry_idx;
+#if DEBUG_ENGELS_KEEP_RESULT_DIAGNOSTICS
+    BaseInstructionSSAPtr icall_instr;
+    ExpressionPtr call_reg_expr_ptr;
+#endif
 };
 
 typedef std::map<uint64_t, std::vector<EngelsResult>> EngelsResultMap;
 
+/*!
+ * \brief Append-only log of the results one worker thread found since
+ * the last merge. \see `engels_merge_results`
+ */
+typedef std::vector<EngelsResult> EngelsResultDelta;
+
+/*!
+ * \brief The icalls and virtual functions that got results (respectively
+ * xrefs) by a merge, hence icalls waiting for them can be resumed.
+ * \see `engels_merge_results`
+ */
+struct EngelsPublished {
+    std::unordered_set<uint64_t> icall_addrs;
+    std::unordered_set<uint64_t> vfunc_addrs;
+};
+
+/*!
+ * \brief Tiers of the icall analysis: the lightweight analysis classifies
+ * every icall, only the possible vcalls it does not settle are passed on to
+ * the (heavy) icall analysis.
+ */
+enum EngelsTier {
+    EngelsTierLightweight = 0,
+    EngelsTierHeavy,
+
+    EngelsTierNum
+};
+
+/*!
+ * \brief Work done by one tier of the icall analysis.
+ */
+struct EngelsTierStats {
+    std::atomic<uint64_t> num_sites{0};
+
+    // Sites that do not need another tier (lightweight: no vcall or
+    // resolved, heavy: at least one result).
+    std::atomic<uint64_t> num_settled{0};
+
+    std::atomic<uint64_t> time_us{0};
+};
+
 struct EngelsAnalysisObjects {
     const FileFormatType file_format;
+    const Abi &abi;
     const VTableFile &vtable_file;
     const VTableHierarchies &vtable_hierarchies;
     const std::unordered_set<uint64_t> &new_operators;
@@ -120,7 +214,29 @@ struct EngelsAnalysisObjects {
     Vex &vex;
     VCallFile &vcall_file;
     EngelsResultMap results;
-    std::mutex results_mtx;
+
+    // One delta per worker thread. Workers only append to their own delta
+    // and only read `results` which is not modified while they work.
+    std::vector<EngelsResultDelta> result_deltas;
+
+    // Stores the finished items if set (and holds the items of an
+    // interrupted run). \see `EngelsCheckpoint`
+    EngelsCheckpoint *checkpoint = nullptr;
+
+    // Restricts the icalls analyzed to the given part if set (vtable xrefs
+    // are always analyzed). \see `AnalysisShard`
+    const AnalysisShard *shard = nullptr;
+
+    // Lets the lightweight analysis resolve vcalls through a constant vtable
+    // itself (they skip the icall analysis). \see `EngelsTier`
+    bool tiering = false;
+
+    // Icalls confirmed as vcalls by the dynamic analysis if set, they are
+    // queued for the icall analysis directly (without the lightweight
+    // analysis).
+    const ICallSet *dynamic_vcalls = nullptr;
+
+    EngelsTierStats tier_stats[EngelsTierNum];
 
     EngelsAnalysisObjects(const FileFormatType format,
                           const VTableFile &vtbl_file,
@@ -131,6 +247,7 @@ struct EngelsAnalysisObjects {
                           Vex &vex_obj,
                           VCallFile &vcalls)
                           : file_format(format),
+                            abi(get_abi(format)),
                             vtable_file(vtbl_file),
                             vtable_hierarchies(hierarchies),
                             new_operators(new_ops),
@@ -144,40 +261,74 @@ void engels_analysis(const std::string &target_file,
                      const std::string &module_name,
                      const std::string &target_dir,
                      EngelsAnalysisObjects &analysis_obj,
-                     uint32_t num_threads);
+                     uint32_t num_threads,
+                     const IncrementalState *incremental=nullptr);
+
+void engels_pipeline_worker(const std::string &module_name,
+                            const std::string &target_dir,
+                            EngelsAnalysisObjects &analysis_obj,
+                            EngelsVTableXrefAnalysis &vtable_xref_data,
+                            EngelsPipeline &pipeline,
+                            uint32_t thread_number);
+
+void engels_pipeline_push_vcall(EngelsPipeline &pipeline,
+                                uint64_t vcall_addr);
+
+void engels_checkpoint_vcall(EngelsCheckpoint &checkpoint,
+                             uint64_t vcall_addr,
+                             size_t num_results);
+
+bool engels_pipeline_is_idle(const EngelsPipeline &pipeline);
+
+void engels_add_result(const BaseInstructionSSAPtr &icall_instr,
+                       const ExpressionPtr &call_reg_expr_ptr,
+                       uint32_t vtable_idx,
+                       uint32_t entry_idx);
+
+bool engels_has_result(const EngelsAnalysisObjects &analysis_obj,
+                       uint64_t icall_addr,
+                       uint32_t vtable_idx);
+
+void engels_merge_results(EngelsAnalysisObjects &analysis_obj,
+                          EngelsPublished *published=nullptr);
+
+size_t engels_results_footprint(const EngelsResultMap &results);
+
+void engels_add_vcall_data(EngelsAnalysisObjects &analysis_obj,
+                           uint64_t icall_addr,
+                           uint32_t vtable_idx,
+                           uint32_t entry_idx,
+                           EngelsPublished *published=nullptr);
+
+void engels_park_icall(uint64_t icall_addr,
+                       const std::unordered_set<uint64_t> &unresolvable_icalls,
+                       const std::unordered_set<uint64_t> &unresolvable_vfuncs);
 
 void engels_icall_analysis(const std::string &module_name,
                         const std::string &target_dir,
                         EngelsAnalysisObjects &analysis_obj,
                         EngelsVTableXrefAnalysis &vtable_xref_data,
+                        uint64_t icall_addr,
                         uint32_t thread_number);
 
 void engels_vtable_xref_analysis(const std::string &module_name,
                         const std::string &target_dir,
                         EngelsAnalysisObjects &analysis_obj,
                         EngelsVTableXrefAnalysis &vtable_xref_data,
+                        uint64_t vtable_xref_addr,
                         uint32_t thread_number);
 
-void engels_vcall_lightweight_analysis(
+bool engels_vcall_lightweight_analysis(
                            const std::string &module_name,
                            const std::string &target_dir,
                            EngelsAnalysisObjects &analysis_obj,
-                           uint32_t thread_number);
-
-DataFlowPath create_dataflow_path(
-                     EngelsAnalysisObjects &analysis_obj,
-                     const GraphDataFlow &graph,
-                     const boost::property_map<GraphDataFlow,
-                                         boost::vertex_index_t>::type &indexmap,
-                     GraphDataFlow::vertex_descriptor src_node,
-                     GraphDataFlow::vertex_descriptor dst_node);
+                           uint64_t icall_addr,
+                           uint32_t thread_number,
+                           bool &is_resolved);
 
-ControlFlowPath create_controlflow_path(
-                     const GraphCfg &graph,
-                     const boost::property_map<GraphCfg,
-                                         boost::vertex_index_t>::type &indexmap,
-                     GraphCfg::vertex_descriptor src_node,
-                     GraphCfg::vertex_descriptor dst_node);
+ControlFlowPath create_controlflow_path(const GraphCfg &graph,
+                                        CfgNode src_node,
+                                        CfgNode dst_node);
 
 void process_icall_dataflow_graph(
                                EngelsAnalysisObjects &analysis_obj,
@@ -188,18 +339,39 @@ void process_icall_dataflow_graph(
 bool process_vcall_lightweight_analysis(EngelsAnalysisObjects &analysis_obj,
                                         VCallBacktraceLightweight &analysis);
 
+/*!
+ * \brief Returns all paths from the source to the destination node that
+ * respect the call stack at return edges (searched on the CSR layout of the
+ * graph, \see `BacktraceAnalysis::get_graph_csr`).
+ */
 std::vector<DataFlowPath> create_dataflow_paths(
                      EngelsAnalysisObjects &analysis_obj,
-                     const GraphDataFlow &graph,
-                     const boost::property_map<GraphDataFlow,
-                                         boost::vertex_index_t>::type &indexmap,
+                     const DataFlowGraphCSR &graph,
                      GraphDataFlow::vertex_descriptor src_node,
                      GraphDataFlow::vertex_descriptor dst_node);
 
+/*!
+ * \brief Returns the paths from the source node to each of the destination
+ * nodes (in the order of `dst_nodes`), the initial shortest paths of all
+ * destination nodes are found by a single search.
+ */
+std::vector<std::vector<DataFlowPath>> create_dataflow_paths(
+              EngelsAnalysisObjects &analysis_obj,
+              const DataFlowGraphCSR &graph,
+              GraphDataFlow::vertex_descriptor src_node,
+              const std::vector<GraphDataFlow::vertex_descriptor> &dst_nodes);
+
 void sym_execute_blocks(const EngelsAnalysisObjects &analysis_obj,
                         const std::vector<BlockPtr> &exec_blocks,
                         State &state);
 
+typedef std::function<bool (size_t, State&)> SymExecPathCallback;
+
+bool sym_execute_block_paths(const EngelsAnalysisObjects &analysis_obj,
+                             const std::vector<std::vector<BlockPtr>> &paths,
+                             const State &initial_state,
+                             const SymExecPathCallback &callback);
+
 std::vector<BlockPtr> create_artificial_block_vector(
                                       const EngelsAnalysisObjects &analysis_obj,
                                       const GraphDataFlow &graph,
@@ -0,0 +1,160 @@
+#ifndef ENGELS_CHECKPOINT_H
+#define ENGELS_CHECKPOINT_H
+
+#include "incremental_state.h"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <cstdint>
+
+#define ENGELS_CHECKPOINT_MAGIC "MARXCKPT"
+#define ENGELS_CHECKPOINT_VERSION 1
+
+/*!
+ * \brief The part of the work items analyzed by one worker process of a
+ * sharded run.
+ *
+ * Items are assigned by a hash of their address, hence all processes agree
+ * on the assignment without any communication.
+ */
+struct AnalysisShard {
+    uint32_t index = 0;
+    uint32_t count = 1;
+
+    bool is_sharded() const {
+        return count > 1;
+    }
+
+    bool contains(uint64_t item) const {
+        uint64_t hash = item * 0x9e3779b97f4a7c15ULL;
+        return (hash >> 32) % count == index;
+    }
+};
+
+/*!
+ * \brief An icall analyzed by the (heavy) icall analysis of an interrupted
+ * run.
+ */
+struct CheckpointVCall {
+    // Set if the analysis has to be repeated once one of the unresolvable
+    // icalls or virtual functions becomes resolvable.
+    bool is_repeat = false;
+    std::unordered_set<uint64_t> unresolvable_icalls;
+    std::unordered_set<uint64_t> unresolvable_vfuncs;
+};
+
+/*!
+ * \brief Append-only store of the finished work items of the engels
+ * analysis.
+ *
+ * The file `{BINARY_NAME}.engels_checkpoint` holds one record per finished
+ * lightweight or icall analysis (with the results it found). It is flushed
+ * at most every `interval` seconds, so an interrupted run only loses the
+ * items finished since the last flush. A run with the same context (config
+ * and input files) resumes with the remaining items only. The file is
+ * removed once the analysis finished.
+ *
+ * Vtable xrefs are always analyzed again since the icall analysis needs
+ * their data flow graphs.
+ *
+ * The worker processes of a sharded run write their items (and object
+ * allocations) into one checkpoint per shard, which the merging process
+ * imports. \see `AnalysisShard`
+ */
+class EngelsCheckpoint {
+private:
+    const std::string _target_file;
+    const std::string _checkpoint_file;
+    const uint32_t _interval;
+
+    std::ofstream _file;
+    std::mutex _mtx;
+    std::chrono::steady_clock::time_point _last_flush;
+
+    bool _is_resumed = false;
+    bool _is_finished = false;
+    std::unordered_map<uint64_t, bool> _done_lightweight;
+    std::unordered_map<uint64_t, CheckpointVCall> _done_vcalls;
+    IncrementalResults _results;
+    IncrementalObjectAllocations _obj_allocs;
+
+    bool read_file(const std::string &file_name,
+                   uint64_t context_hash,
+                   std::vector<uint8_t> &data,
+                   size_t &offset) const;
+    size_t import_records(const std::vector<uint8_t> &data);
+    void append(const std::vector<uint8_t> &record);
+
+public:
+    EngelsCheckpoint(const std::string &target_file, uint32_t interval);
+
+    EngelsCheckpoint(const EngelsCheckpoint&) = delete;
+    void operator=(const EngelsCheckpoint&) = delete;
+
+    bool open(uint64_t context_hash);
+
+    bool merge_shard(const AnalysisShard &shard, uint64_t context_hash);
+
+    /*!
+     * \brief Returns the target file that the checkpoint of the given shard
+     * is created for.
+     */
+    static std::string get_shard_target(const std::string &target_file,
+                                        const AnalysisShard &shard);
+
+    /*!
+     * \brief Returns `true` if items of a previous run were imported.
+     */
+    bool is_resumed() const {
+        return _is_resumed;
+    }
+
+    /*!
+     * \brief Returns the icalls whose lightweight analysis finished (and if
+     * they were identified as possible vcalls).
+     */
+    const std::unordered_map<uint64_t, bool> &get_done_lightweight() const {
+        return _done_lightweight;
+    }
+
+    /*!
+     * \brief Returns the icalls whose icall analysis finished.
+     */
+    const std::unordered_map<uint64_t, CheckpointVCall> &
+                                                   get_done_vcalls() const {
+        return _done_vcalls;
+    }
+
+    /*!
+     * \brief Returns the results of the imported items.
+     */
+    const IncrementalResults &get_results() const {
+        return _results;
+    }
+
+    /*!
+     * \brief Returns the object allocations of the imported shards.
+     */
+    const IncrementalObjectAllocations &get_object_allocations() const {
+        return _obj_allocs;
+    }
+
+    void add_lightweight(uint64_t icall_addr, bool is_vcall);
+
+    void add_vcall(uint64_t vcall_addr,
+                   const IncrementalResults &results,
+                   const CheckpointVCall &vcall);
+
+    void add_object_allocation(const IncrementalObjectAllocation &obj_alloc);
+
+    void finish();
+
+    void remove();
+};
+
+#endif // ENGELS_CHECKPOINT_H
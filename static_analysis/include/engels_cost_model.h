@@ -0,0 +1,52 @@
+#ifndef ENGELS_COST_MODEL_H
+#define ENGELS_COST_MODEL_H
+
+#include "translator.h"
+#include "vtable_file.h"
+#include "instrumentation.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+/*!
+ * \brief Predicts the cost of the work items of the engels analysis before
+ * they are analyzed.
+ *
+ * The estimate of an item is derived from its containing function (number
+ * of blocks, SSA uses and vtable xrefs in it). If the instrumentation report
+ * of a previous run exists, the measured duration of an item replaces the
+ * estimate (scaled to the same unit). The queues are filled with the most
+ * expensive items first, so they do not become the critical path at the end
+ * of a round.
+ */
+class EngelsCostModel {
+private:
+    const Translator &_translator;
+
+    // Number of vtable xrefs by the entry of the containing function.
+    std::unordered_map<uint64_t, uint32_t> _func_vtable_xrefs;
+
+    std::unordered_map<uint64_t, uint64_t> _history[InstrItemNum];
+    double _history_scale[InstrItemNum];
+
+    uint64_t estimate_static(uint64_t addr) const;
+
+public:
+    EngelsCostModel(const Translator &translator,
+                    const VTableFile &vtable_file);
+
+    EngelsCostModel(const EngelsCostModel&) = delete;
+    void operator=(const EngelsCostModel&) = delete;
+
+    bool import_history(const std::string &target_dir,
+                        const std::string &module_name);
+
+    uint64_t estimate(InstrumentationItemType type, uint64_t addr) const;
+
+    void sort_by_cost(InstrumentationItemType type,
+                      std::vector<uint64_t> &items) const;
+};
+
+#endif // ENGELS_COST_MODEL_H
@@ -26,7 +26,7 @@ enum ExpressionType {
     //! A constant (64-bit) value.
     ExpressionConstant,
 
-    //! A symbolic value, described using a `std::string`.
+    //! A symbolic value, described using a `SymbolicKind` and a payload.
     ExpressionSymbolic,
 
     /*!
@@ -80,6 +80,22 @@ typedef std::shared_ptr<Expression> ExpressionPtr;
  * `std::shared_ptr<Expression>` to something more efficient. Maybe
  * `boost::variant`?
  */
+uint64_t new_expression_epoch_base();
+
+/*!
+ * \brief Returns the epoch of the calling thread, which is advanced by each
+ * `Expression::propagate` that modifies an expression in-place.
+ *
+ * Compound expressions remember the epoch in which their whole tree was last
+ * found unchanged, so `has_changed` (and with it `optimize`) does not visit
+ * unchanged trees again as long as nothing was propagated. The epochs of
+ * different threads never overlap.
+ */
+inline uint64_t &expression_epoch() {
+    static thread_local uint64_t epoch = new_expression_epoch_base();
+    return epoch;
+}
+
 class Expression {
 protected:
     bool _changed = true;
@@ -221,6 +237,17 @@ public:
 protected:
     bool operation_equal(const Expression &other) const;
 
+    /*!
+     * \brief Clears the changed flag of a leaf. The flag is not written if
+     * it is already cleared, hence leaves shared by all threads (see
+     * `make_register`) stay read-only once they were optimized.
+     */
+    void clear_changed() {
+        if(_changed) {
+            _changed = false;
+        }
+    }
+
     virtual bool equals(const Expression&) const = 0;
     virtual bool lower_than(const Expression&) const = 0;
 
@@ -255,7 +282,7 @@ public:
     }
 
     virtual void optimize() {
-        _changed = false;
+        clear_changed();
     }
 
     virtual bool contains(const Expression &other, size_t=0) {
@@ -295,30 +322,94 @@ private:
     }
 };
 
+/*!
+ * \brief Enumerates the kinds of `Symbolic` values.
+ *
+ * All kinds except `SymbolicNamed` are described by a 64-bit payload
+ * instead of a string. Their names are only formatted when printed.
+ */
+enum SymbolicKind {
+    //! A symbol described by an arbitrary name.
+    SymbolicNamed = 0,
+
+    //! The initial value of a register, e.g., `init_rdi` (register offset).
+    SymbolicInitialValue,
+
+    //! The return value of a call, `return_<addr>` (block address).
+    SymbolicReturnValue,
+
+    //! The object returned by a new operator, `new_obj_<addr>` (call address).
+    SymbolicNewObject,
+
+    //! The return value of a call not taken, `ret_<addr>` (call address).
+    SymbolicCallNotTaken,
+
+    //! An unknown value written by a block, `unknown_<addr>` (instruction
+    //! address).
+    SymbolicUnknown,
+
+    //! An unknown stack pointer after a block, `unknown_rsp_<addr>` (block
+    //! address).
+    SymbolicUnknownRsp,
+
+    SymbolicKindCount
+};
+
 /*!
  * \brief `Expression` sub-class depicting a symbolic value.
  *
- * Symbols are common strings.
+ * Symbols are either common strings (`SymbolicNamed`) or a `SymbolicKind`
+ * with an integer payload, which are compared and hashed without touching
+ * any string.
  */
 class Symbolic : public Expression {
 private:
+    SymbolicKind _kind;
+    uint64_t _payload;
     std::string _name;
+    size_t _hash;
 
 public:
     Symbolic(const std::string &name)
-        : Expression(ExpressionSymbolic), _name(name) {
+        : Expression(ExpressionSymbolic),
+          _kind(SymbolicNamed),
+          _payload(0),
+          _name(name) {
+        _hash = _type;
+        std::hash_combine(_hash, _kind);
+        std::hash_combine(_hash, std::hash<std::string>()(_name));
+    }
+
+    Symbolic(SymbolicKind kind, uint64_t payload)
+        : Expression(ExpressionSymbolic), _kind(kind), _payload(payload) {
+        _hash = _type;
+        std::hash_combine(_hash, _kind);
+        std::hash_combine(_hash, std::hash<uint64_t>()(_payload));
+    }
+
+    /*!
+     * \brief Returns the kind of the symbolic value.
+     */
+    SymbolicKind kind() const {
+        return _kind;
     }
 
     /*!
-     * \brief Returns the name of the symbolic value.
-     * \return A read-only string reference.
+     * \brief Returns the payload of the symbolic value (`0` for named
+     * symbols).
      */
-    const std::string &name() const {
-        return _name;
+    uint64_t payload() const {
+        return _payload;
     }
 
+    /*!
+     * \brief Returns the name of the symbolic value (formatted on each call
+     * unless the symbol is named).
+     */
+    std::string name() const;
+
     virtual void optimize() {
-        _changed = false;
+        clear_changed();
     }
 
     virtual bool contains(const Expression &other, size_t=0) {
@@ -330,13 +421,11 @@ public:
     }
 
     virtual size_t hash() const {
-        size_t h = _type;
-        std::hash_combine(h, std::hash<std::string>()(_name));
-        return h;
+        return _hash;
     }
 
     virtual ExpressionPtr clone() const {
-        auto result = std::make_shared<Symbolic>(_name);
+        auto result = std::make_shared<Symbolic>(*this);
         result->_changed = _changed;
 
         return result;
@@ -347,17 +436,21 @@ private:
         return _changed;
     }
 
-    virtual std::ostream &print(std::ostream &stream) const {
-        return stream << _name;
-    }
+    virtual std::ostream &print(std::ostream &stream) const;
 
     virtual bool equals(const Expression &other) const {
         const auto &o = static_cast<const Symbolic&>(other);
-        return _name == o._name;
+        return _kind == o._kind && _payload == o._payload && _name == o._name;
     }
 
     virtual bool lower_than(const Expression &other) const {
         const auto &o = static_cast<const Symbolic&>(other);
+        if(_kind != o._kind) {
+            return _kind < o._kind;
+        }
+        if(_payload != o._payload) {
+            return _payload < o._payload;
+        }
         return _name < o._name;
     }
 };
@@ -379,7 +472,7 @@ public:
     }
 
     virtual void optimize() {
-        _changed = false;
+        clear_changed();
     }
 
     virtual bool contains(const Expression &other, size_t=0) {
@@ -458,7 +551,7 @@ public:
     }
 
     virtual void optimize() {
-        _changed = false;
+        clear_changed();
     }
 
     virtual bool contains(const Expression &other, size_t=0) {
@@ -535,10 +628,11 @@ public:
     void value(uint64_t value) {
         _changed = true;
         _value = value;
+        expression_epoch()++;
     }
 
     virtual void optimize() {
-        _changed = false;
+        clear_changed();
     }
 
     virtual bool contains(const Expression &other, size_t=0) {
@@ -590,6 +684,7 @@ private:
 class Indirection : public Expression {
 private:
     ExpressionPtr _address;
+    uint64_t _unchanged_epoch = 0;
 
 public:
     Indirection(const ExpressionPtr &address)
@@ -628,6 +723,7 @@ public:
         if(*_address == *key) {
             _changed = true;
             _address = value;
+            expression_epoch()++;
             return true;
 
         } else {
@@ -655,7 +751,13 @@ public:
 
 private:
     virtual bool has_changed() {
+        if(!_changed && _unchanged_epoch == expression_epoch()) {
+            return false;
+        }
         _changed = _changed || _address->has_changed();
+        if(!_changed) {
+            _unchanged_epoch = expression_epoch();
+        }
         return _changed;
     }
 
@@ -684,6 +786,7 @@ class Operation : public Expression {
 private:
     ExpressionPtr _lhs, _rhs;
     OperationType _operation;
+    uint64_t _unchanged_epoch = 0;
 
 public:
     Operation(const ExpressionPtr &lhs, OperationType operation,
@@ -762,7 +865,10 @@ public:
             dirty |= _rhs->propagate(key, value);
         }
 
-        _changed = _changed || dirty;
+        if(dirty) {
+            _changed = true;
+            expression_epoch()++;
+        }
         return dirty;
     }
 
@@ -828,7 +934,13 @@ private:
     void sanitize();
 
     virtual bool has_changed() {
+        if(!_changed && _unchanged_epoch == expression_epoch()) {
+            return false;
+        }
         _changed = _changed || _lhs->has_changed() || _rhs->has_changed();
+        if(!_changed) {
+            _unchanged_epoch = expression_epoch();
+        }
         return _changed;
     }
 
@@ -854,4 +966,28 @@ private:
     }
 };
 
+/*!
+ * \brief Maximum number of expressions of one type interned per thread.
+ */
+#define MAX_INTERNED_EXPRESSIONS 65536
+
+/*
+ * Factories for leaf expressions. Leaf expressions are never modified after
+ * construction (only the `Operation` optimizer and `propagate` replace
+ * sub-expressions), hence equal leaves created by the same thread share one
+ * node. Equality checks on them then end at the pointer comparison in
+ * `Expression::operator==`.
+ *
+ * The amd64 registers (see `AMD64_REGISTERS` and `rip`) and their initial
+ * values are shared by all threads instead. These nodes are created once
+ * (already optimized) and never written afterwards.
+ */
+std::shared_ptr<Constant> make_constant(uint64_t value);
+std::shared_ptr<Register> make_register(uint32_t offset);
+std::shared_ptr<Temporary> make_temporary(uint32_t id);
+std::shared_ptr<Symbolic> make_symbolic(const std::string &name);
+std::shared_ptr<Symbolic> make_symbolic(SymbolicKind kind, uint64_t payload);
+
+std::shared_ptr<Symbolic> parse_symbolic(const std::string &name);
+
 #endif // EXPRESSION_H
@@ -0,0 +1,94 @@
+#ifndef EXT_MODULE_STORE_H
+#define EXT_MODULE_STORE_H
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+
+#include "vtable_file.h"
+#include "external_functions.h"
+
+/*!
+ * \brief Artefacts of an external module that do not depend on the module
+ * to analyze (read once, never changed afterwards).
+ */
+struct ExtModuleArtefacts {
+    bool vtables_parsed = false;
+    VTableModule vtables;
+
+    bool funcs_parsed = false;
+    ExternalFunctionVector funcs;
+
+    // Sizes and modification times of the source files the artefacts were
+    // read from.
+    std::vector<int64_t> source_stamp;
+};
+
+typedef std::shared_ptr<const ExtModuleArtefacts> ExtModuleArtefactsPtr;
+
+/*!
+ * \brief Keeps the artefacts of external modules resident between the
+ * analyses of several modules (server mode).
+ *
+ * The vtables and the functions of an external module are read on the first
+ * request and reused as long as their source files do not change. Each
+ * analysis copies them into its own `VTableFile` and `ExternalFunctions`
+ * objects since the vtable and function indexes depend on the module to
+ * analyze. Hierarchies, return values and vtable updates of the external
+ * modules reference these indexes and are therefore still read per
+ * analysis.
+ */
+class ExtModuleStore {
+private:
+    std::map<std::string, ExtModuleArtefactsPtr> _modules;
+    std::mutex _mtx;
+
+    static std::vector<int64_t> get_source_stamp(
+                                              const std::string &module_file);
+
+public:
+    ExtModuleStore() = default;
+
+    ExtModuleStore(const ExtModuleStore&) = delete;
+    void operator=(const ExtModuleStore&) = delete;
+
+    /*!
+     * \brief Returns the artefacts of the given external module (reads them
+     * if they are not resident yet or their source files changed).
+     *
+     * Can be called concurrently, the returned artefacts stay valid even if
+     * they are replaced by a later call.
+     */
+    ExtModuleArtefactsPtr get(const std::string &module_file,
+                              bool use_companion);
+
+    /*!
+     * \brief Returns the number of resident external modules.
+     */
+    size_t size();
+};
+
+/*!
+ * \brief Selects the external modules the module to analyze imports symbols
+ * from (lazy loading of the external modules).
+ *
+ * A module is selected if it exports one of the imported functions (`.plt`
+ * respectively `.idata` entries) or a member function of the class of an
+ * imported vtable (the named `.bss` and `.got` vtables of the module to
+ * analyze; the vtable files of the external modules do not name their
+ * vtables). Modules that are only reached through another external module
+ * are not selected.
+ *
+ * \param ext_funcs_modules The functions exported by each external module.
+ * \return Returns the indexes of the selected modules in ascending order.
+ */
+std::vector<size_t> select_imported_ext_modules(
+                const std::vector<ExternalFunctionVector> &ext_funcs_modules,
+                const std::unordered_set<std::string> &imported_funcs,
+                const VTableModule &this_vtables);
+
+#endif // EXT_MODULE_STORE_H
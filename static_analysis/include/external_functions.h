@@ -8,6 +8,10 @@
 #include <cassert>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+
+#define EXTERNAL_NAME_NO_ID 0xffffffff
 
 
 struct ExternalFunction {
@@ -15,24 +19,52 @@ struct ExternalFunction {
     uint64_t addr;
     std::string name;
     std::string module_name;
+
+    //! Id of the interned name. \see `ExternalFunctions::intern_name`
+    uint32_t name_id;
 };
 
 
 typedef std::vector<ExternalFunction> ExternalFunctionVector;
-typedef std::map<std::string, ExternalFunction*> ExternalFunctionMap;
+typedef std::vector<const ExternalFunction*> ExternalFunctionIdVector;
+typedef std::unordered_map<std::string,
+                           std::unordered_map<uint64_t,
+                                              const ExternalFunction*>>
+                                                    ExternalFunctionModuleMap;
 
 
 
 class ExternalFunctions {
 private:
     ExternalFunctionVector _external_functions;
-    ExternalFunctionMap _external_functions_map;
+    ExternalFunctionIdVector _external_functions_names;
+    ExternalFunctionModuleMap _external_functions_addrs;
     uint32_t _index = 0;
 
     bool _is_finalized = false;
 
+    static std::mutex _names_mtx;
+    static std::unordered_map<std::string, uint32_t> _names;
+
 public:
 
+    /*!
+     * \brief Interns the given symbol name.
+     *
+     * The ids are dense and shared by all modules (and the `ModulePlt`), so
+     * symbols can be looked up by id instead of by name.
+     *
+     * \return Returns the id of the name.
+     */
+    static uint32_t intern_name(const std::string &name);
+
+
+    /*!
+     * \brief Returns the id of the given symbol name or `EXTERNAL_NAME_NO_ID`
+     * if it was never interned.
+     */
+    static uint32_t find_name(const std::string &name);
+
     /*!
      * \brief Returns `true` if the external functions structure is finalized.
      * \return Returns `true` the external functions structure is finalized.
@@ -47,6 +79,22 @@ public:
     bool parse(const std::string &funcs_file);
 
 
+    /*!
+     * \brief Reads the functions of a given functions file without adding
+     * them (modules can be read concurrently). \see `parse`
+     */
+    static bool read_module(const std::string &funcs_file,
+                            ExternalFunctionVector &functions);
+
+
+    /*!
+     * \brief Adds the functions of a module that was read by `read_module`.
+     *
+     * The function indexes depend on the order in which the modules are added.
+     */
+    void add_module(ExternalFunctionVector &functions);
+
+
     /*!
      * \brief Finalizes the external functions structures.
      *
@@ -67,6 +115,21 @@ public:
             const std::string &name) const;
 
 
+    /*!
+     * \brief Returns a pointer to the external function given by the id of
+     * its name. \see `intern_name`
+     * \return Returns a pointer to the external function given by the id
+     * or null if it was not found.
+     */
+    const ExternalFunction* get_external_function_by_id(
+            uint32_t name_id) const {
+        if(name_id >= _external_functions_names.size()) {
+            return nullptr;
+        }
+        return _external_functions_names[name_id];
+    }
+
+
     /*!
      * \brief Returns a pointer to the external function given by the module
      * name and address.
@@ -0,0 +1,67 @@
+#ifndef FLAT_EXPRESSION_H
+#define FLAT_EXPRESSION_H
+
+#include "expression.h"
+
+#include <vector>
+#include <cstdint>
+
+#define FLAT_EXPRESSION_NO_CHILD 0xffffffff
+
+size_t canonical_hash(const Expression &expression,
+                      const size_t *child_hashes);
+size_t canonical_hash(const Expression &expression);
+
+/*!
+ * \brief Node of a `FlatExpression`. Children are referenced by their index
+ * (`FLAT_EXPRESSION_NO_CHILD` if the node has no such child).
+ */
+struct FlatExpressionNode {
+    const Expression *expression;
+    uint32_t lhs;
+    uint32_t rhs;
+};
+
+/*!
+ * \brief Flattened encoding of an expression tree.
+ *
+ * The sub-expressions are stored in post-order (children before their
+ * parent, the root is the last node) together with their canonical hashes
+ * in a separate array. Checking if a (small) expression is contained is a
+ * linear scan over the hashes, only nodes with a matching hash are compared.
+ *
+ * The encoding refers to the nodes of the tree, hence it is only valid as
+ * long as the tree is not modified.
+ */
+class FlatExpression {
+private:
+    std::vector<size_t> _hashes;
+    std::vector<FlatExpressionNode> _nodes;
+
+    uint32_t add(const Expression &expression);
+
+public:
+    FlatExpression(const Expression &expression);
+
+    /*!
+     * \brief Returns the canonical hashes of all sub-expressions.
+     */
+    const std::vector<size_t> &get_hashes() const {
+        return _hashes;
+    }
+
+    const std::vector<FlatExpressionNode> &get_nodes() const {
+        return _nodes;
+    }
+
+    /*!
+     * \brief Returns the canonical hash of the whole expression.
+     */
+    size_t hash() const {
+        return _hashes.back();
+    }
+
+    bool contains(const Expression &expression, size_t hash) const;
+};
+
+#endif // FLAT_EXPRESSION_H
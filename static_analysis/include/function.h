@@ -6,6 +6,7 @@
 #include "block_semantics.h"
 #include "ssa_export.pb.h"
 #include "ssa_block.h"
+#include "reachability.h"
 
 #include <map>
 #include <set>
@@ -13,6 +14,8 @@
 #include <cstddef>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
 extern "C" {
 #include <valgrind/libvex.h>
@@ -37,22 +40,62 @@ typedef std::shared_ptr<Block> BlockPtr;
 typedef std::vector<BlockPtr> BlockVector;
 typedef std::map<uintptr_t, BlockPtr> BlockMap;
 typedef std::map<uintptr_t, BlockSSAPtr> BlockSSAMap;
-typedef boost::directed_graph<BlockPtr> GraphCfg;
 
-template <class T>
-class SimpleCfgNodeWriter {
+/*!
+ * \brief Node of a `GraphCfg` (the index of its basic block).
+ */
+typedef uint32_t CfgNode;
+
+/*!
+ * \brief Control flow graph of a function stored as adjacency arrays.
+ *
+ * The nodes are the basic blocks of the function in address order. The
+ * successors of node `n` are `successors[successor_offsets[n]]` up to
+ * `successors[successor_offsets[n + 1]]` (exclusive).
+ */
+class GraphCfg {
+private:
+    BlockVector _blocks;
+    std::vector<uintptr_t> _addresses;
+    std::vector<uint32_t> _successor_offsets;
+    std::vector<CfgNode> _successors;
+
+    friend class Function;
+
 public:
-    SimpleCfgNodeWriter(const T &graph) : _graph(graph) {}
-    template <class VertexOrEdge>
-    void operator()(std::ostream& out, const VertexOrEdge& v) const {
-        out << "["
-            << "fontname=\"Ubuntu Mono\", "
-            << "shape=rect, "
-            << "label=\"" << std::hex << _graph[v]->get_address() << "\""
-            << "]";
+    typedef CfgNode vertex_descriptor;
+
+    size_t num_nodes() const {
+        return _blocks.size();
     }
-private:
-    const T &_graph;
+
+    const BlockPtr &operator[](CfgNode node) const {
+        return _blocks[node];
+    }
+
+    const CfgNode *successors_begin(CfgNode node) const {
+        return _successors.data() + _successor_offsets[node];
+    }
+
+    const CfgNode *successors_end(CfgNode node) const {
+        return _successors.data() + _successor_offsets[node + 1];
+    }
+
+    /*!
+     * \brief Searches the node of the basic block starting at the given
+     * address.
+     * \return Returns `false` if the cfg has no such node.
+     */
+    bool find_node(uintptr_t addr, CfgNode &node) const;
+};
+
+/*!
+ * \brief Cfg of a function that is built on first access (shared by the
+ * copies of the function).
+ */
+struct FunctionCfgState {
+    std::once_flag built;
+    GraphCfg cfg;
 };
 
 // Used to return references on empty sets.
@@ -71,6 +114,31 @@ typedef std::unordered_map<OperandSSAPtr,
                            SSAPtrDeref::Hash,
                            SSAPtrDeref::Compare> DefUseSSAMap;
 
+/*!
+ * \brief Definitions/uses of the SSA operands of a function by the operand
+ * ids (nullptr if the operand is not defined/used).
+ *
+ * The entries point into the `DefUseSSAMap`s of the function, hence a copy
+ * starts empty (lookups then fall back to the maps) while a move keeps them.
+ */
+struct DefUseSSAIndex {
+    std::vector<const BaseInstructionSSAPtrSet*> definitions;
+    std::vector<const BaseInstructionSSAPtrSet*> uses;
+
+    DefUseSSAIndex() = default;
+    DefUseSSAIndex(DefUseSSAIndex&&) = default;
+    DefUseSSAIndex &operator=(DefUseSSAIndex&&) = default;
+
+    DefUseSSAIndex(const DefUseSSAIndex&) {
+    }
+
+    DefUseSSAIndex &operator=(const DefUseSSAIndex&) {
+        definitions.clear();
+        uses.clear();
+        return *this;
+    }
+};
+
 /*!
  * \brief A function called on each visited basic block in a traversal.
  *
@@ -88,6 +156,73 @@ typedef std::function<void (void*, const Path&)> PathCallback;
 
 const uint8_t BRANCH_THRESHOLD = 0;
 
+const uint64_t TRAVERSAL_MAX_PATHS = 1 << 20;
+const uint64_t TRAVERSAL_MAX_BLOCKS = 1 << 24;
+const size_t TRAVERSAL_MAX_BYTES = 1 << 28;
+
+/*!
+ * \brief Limits of a full traversal (see `Function::traverse`). The traversal
+ * stops once any of them is exceeded.
+ */
+struct TraversalBudget {
+    //! Number of completed paths.
+    uint64_t max_paths = TRAVERSAL_MAX_PATHS;
+
+    //! Number of visited blocks (summed over all paths).
+    uint64_t max_blocks = TRAVERSAL_MAX_BLOCKS;
+
+    //! Memory used for the current path (approximated).
+    size_t max_bytes = TRAVERSAL_MAX_BYTES;
+};
+
+/*!
+ * \brief Statistics of a full traversal.
+ */
+struct TraversalStatistics {
+    uint64_t paths = 0;
+    uint64_t blocks = 0;
+    size_t max_depth = 0;
+    size_t max_bytes = 0;
+
+    //! Set if the traversal was stopped because the budget was exceeded.
+    bool truncated = false;
+};
+
+/*!
+ * \brief A tail jump of a function into another function.
+ */
+struct FunctionTailJmp {
+    uint64_t jmp_addr;
+    uint64_t target_entry;
+};
+
+/*!
+ * \brief Summary of how a function passes values back to its callers.
+ *
+ * Holds the SSA return instructions (in block order) and the tail jumps into
+ * other functions (whose return instructions also return to the callers).
+ * The summaries are built by `Translator::finalize()`.
+ */
+struct FunctionReturnSummary {
+    BaseInstructionSSAPtrs ret_instrs;
+    std::vector<FunctionTailJmp> tail_jmps;
+};
+
+class Function;
+
+/*!
+ * \brief State of a function whose VEX blocks are lifted on first access
+ * (see the on-demand mode of `Translator`).
+ *
+ * Each step is run exactly once, concurrent callers wait until it is done.
+ */
+struct FunctionLazyState {
+    std::once_flag lifted;
+    std::once_flag summarized;
+    std::function<void (Function&)> lift;
+    std::function<void (Function&)> summarize;
+};
+
 /*!
  * \brief Class representing a function translated to VEX.
  *
@@ -106,11 +241,21 @@ private:
     std::set<uint64_t> _vfunc_xrefs;
     DefUseSSAMap _definitions;
     DefUseSSAMap _uses;
+    OperandSSATable _operands_ssa;
+    DefUseSSAIndex _def_use_index;
+
+    // SSA instructions by their (dense) ids.
+    std::vector<const BaseInstructionSSA*> _instructions_ssa_by_id;
+
     std::set<uint64_t> _addresses;
+    FunctionReturnSummary _return_summary;
+
+    // Only set if the VEX blocks are lifted on first access.
+    std::shared_ptr<FunctionLazyState> _lazy;
 
-    GraphCfg _cfg;
-    boost::property_map<GraphCfg, boost::vertex_index_t>::type _indexmap;
-    std::map<uint32_t, GraphCfg::vertex_descriptor> _addr_graph_node_map;
+    // Only set once the function is finalized.
+    std::shared_ptr<FunctionCfgState> _cfg_state;
+    Reachability _reachability;
 
 public:
     Function() = default;
@@ -132,6 +277,7 @@ public:
      * \return Returns a vector of addresses.
      */
     std::vector<uintptr_t> get_block_addresses() const {
+        ensure_lifted();
         std::vector<uintptr_t> result;
         for(const auto &kv : _function_blocks) {
             result.push_back(kv.first);
@@ -147,6 +293,7 @@ public:
      * \return Returns a vector of addresses.
      */
     std::vector<uintptr_t> get_return_block_addresses() const {
+        ensure_lifted();
         std::vector<uintptr_t> result;
         for(const auto &kv : _function_blocks) {
             if(kv.second->get_terminator().type == TerminatorReturn) {
@@ -163,6 +310,7 @@ public:
      * block's address).
      */
     const BlockMap &get_blocks() const {
+        ensure_lifted();
         return _function_blocks;
     }
 
@@ -175,6 +323,16 @@ public:
         return _function_blocks_ssa;
     }
 
+    /*!
+     * \brief Returns the return instructions and tail jumps of the function.
+     * \return Returns a reference to the summary (empty as long as the
+     * `Translator` is not finalized, unless functions are lifted on demand).
+     */
+    const FunctionReturnSummary &get_return_summary() const {
+        ensure_summarized();
+        return _return_summary;
+    }
+
     /*!
      * \brief Returns if the function contains the given address.
      * \return Returns `true` if the function contains the given address.
@@ -225,27 +383,31 @@ public:
     const BlockSSAPtr &get_containing_block_ssa(uint64_t addr) const;
 
     /*!
-     * \brief Returns the graph that contains the cfg.
+     * \brief Returns the cfg (built on first access).
      *
-     * \return A reference of type `GraphCfg`.
+     * \return A reference of type `GraphCfg` (throws runtime_error
+     * exception if the function is not finalized).
      */
     const GraphCfg &get_cfg() const;
 
     /*!
-     * \brief Returns the indexmap for the cfg.
+     * \brief Returns the node for the cfg corresponding to the given address.
+     * Throws an exception if node does not exist.
      *
-     * \return A reference to the indexmap of the cfg.
+     * \return A node descriptor for the cfg.
      */
-    const boost::property_map<GraphCfg, boost::vertex_index_t>::type &
-                                                       get_cfg_indexmap() const;
+    CfgNode get_cfg_node(uint64_t addr) const;
 
     /*!
-     * \brief Returns the node for the cfg corresponding to the given address.
-     * Throws an exception if node does not exist.
+     * \brief Returns the reachability index of the blocks.
      *
-     * \return A node descriptor for the cfg.
+     * Unlike the cfg, it also follows (tail) jumps to blocks of the function,
+     * i.e., it covers all paths `PathBuilder` can construct.
      */
-    GraphCfg::vertex_descriptor get_cfg_node(uint64_t addr) const;
+    const Reachability &get_reachability() const {
+        ensure_lifted();
+        return _reachability;
+    }
 
     /*!
      * \brief Dumps the cfg as dot file to the given file name.
@@ -284,6 +446,35 @@ public:
     const BaseInstructionSSAPtrSet &get_instrs_define_op_ssa(
                                                  const OperandSSAPtr &op) const;
 
+    /*!
+     * \brief Returns the id of the given SSA instruction object (ids are
+     * dense and assigned in block order by `finalize_ssa`).
+     * \return Returns `INSTRUCTION_SSA_NO_ID` if the object itself is not
+     * part of this function (e.g., a copy created by an analysis).
+     */
+    uint32_t get_instruction_ssa_id(const BaseInstructionSSA &instr) const {
+        const uint32_t id = instr._function_id;
+        if(id < _instructions_ssa_by_id.size()
+           && _instructions_ssa_by_id[id] == &instr) {
+            return id;
+        }
+        return INSTRUCTION_SSA_NO_ID;
+    }
+
+    size_t get_number_instructions_ssa() const {
+        return _instructions_ssa_by_id.size();
+    }
+
+private:
+    static const BaseInstructionSSAPtrSet &get_instrs_op_ssa(
+                          const OperandSSAPtr &op,
+                          uint32_t id,
+                          const DefUseSSAMap &def_use,
+                          const std::vector<const BaseInstructionSSAPtrSet*>
+                                                                  &by_id);
+
+public:
+
     /*!
      * \brief Returns SSA instructions that use the given operand.
      * \return Returns a reference to the SSA instructions that use
@@ -304,36 +495,67 @@ public:
      */
     const std::set<uint64_t> &get_vfunc_xrefs() const;
 
+    /*!
+     * \brief Estimates the heap bytes of the blocks, the SSA data and the
+     * lookup tables of the function (the VEX blocks are accounted by `Vex`,
+     * functions lifted on demand only count once they are lifted).
+     */
+    size_t get_memory_footprint() const;
+
     void finalize();
 
 private:
+    /*!
+     * \brief Lifts the VEX blocks of the function if this is not done yet
+     * (only needed in the on-demand mode of `Translator`).
+     */
+    void ensure_lifted() const {
+        if(_lazy) {
+            std::call_once(_lazy->lifted,
+                           _lazy->lift,
+                           std::ref(const_cast<Function&>(*this)));
+        }
+    }
+
+    void ensure_summarized() const {
+        if(_lazy) {
+            ensure_lifted();
+            std::call_once(_lazy->summarized,
+                           _lazy->summarize,
+                           std::ref(const_cast<Function&>(*this)));
+        }
+    }
+
     bool traverser(const TraversalCallback &callback,
-                   void *user_defined=nullptr) const;
+                   const PathCallback &path_callback,
+                   const TraversalBudget &budget,
+                   void *user_defined,
+                   arg_out TraversalStatistics &statistics) const;
 
     void add_block(uintptr_t address, IRSB *block,
                    const Terminator &terminator);
 
     void add_block_ssa(const ssa::BasicBlock &basic_block);
 
+    /*!
+     * \brief Builds the lookup tables of the SSA definitions and uses and
+     * assigns the ids of the SSA instructions. Has to be called once all SSA
+     * blocks of the function are added.
+     */
+    void finalize_ssa();
+
     void add_xref(uint64_t xref_addr);
 
     void add_vfunc_xref(uint64_t xref_addr);
 
-    /*!
-     * \brief Returns the cfg descriptor for the given block if it exists.
-     * Otherwise a new node is created in the cfg and the corresponding
-     * descriptor is returned (needed for build_cfg()).
-     *
-     * \return Cfg descriptor for the given block.
-     */
-    GraphCfg::vertex_descriptor get_maybe_new_node_cfg(
-                                           const std::shared_ptr<Block> &block);
+    void build_cfg(GraphCfg &cfg) const;
 
-    void build_cfg();
+    void build_reachability();
 
     friend class Translator;
     friend class ModuleSSA;
     friend class ModuleFunctionXrefs;
+    friend class AnalysisCache;
 };
 
 #endif // FUNCTION_H
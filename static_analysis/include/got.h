@@ -1,14 +1,59 @@
 #ifndef GOT_H
 #define GOT_H
 
-#include <map>
+#include <vector>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
-typedef std::map<uint64_t, uint64_t> GotMap;
+class MappedElf;
 
+struct GotEntry {
+    uint64_t addr;
+    uint64_t content;
+};
+
+/*!
+ * \brief Read-only `.got` entries of a module sorted by their address.
+ */
+class GotMap {
+private:
+    std::vector<GotEntry> _entries;
+
+public:
+    GotMap() = default;
+
+    /*!
+     * \brief Builds the map from the given entries (the last entry wins if
+     * an address occurs multiple times).
+     */
+    explicit GotMap(std::vector<GotEntry> entries);
+
+    /*!
+     * \brief Returns the entry at the given address.
+     * \return Returns a pointer to the entry or `nullptr` if the address is
+     * not the address of a `.got` entry.
+     */
+    const GotEntry *find(uint64_t addr) const;
+
+    size_t size() const {
+        return _entries.size();
+    }
+};
+
+/*!
+ * \brief Imports the `.got` entries from the `{FILE}_got.txt` file.
+ */
 GotMap import_got(const std::string &target_file);
 
+/*!
+ * \brief Reads the `.got` and `.got.plt` entries directly from the
+ * mapped ELF file.
+ *
+ * Throws a `runtime_error` if the file has no `.got` section.
+ */
+GotMap import_got(const MappedElf &elf);
+
 #endif
@@ -0,0 +1,186 @@
+#ifndef GRAPH_CAPTURE_H
+#define GRAPH_CAPTURE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+
+#define GRAPH_CAPTURE_MAGIC "MARXGRF\0"
+#define GRAPH_CAPTURE_VERSION 1
+
+// A chunk is handed to the writer thread once it reaches this size.
+#define GRAPH_CAPTURE_CHUNK_SIZE (1 << 20)
+
+// Producers block while this many chunks wait for the writer thread.
+#define GRAPH_CAPTURE_MAX_PENDING_CHUNKS 8
+
+/*!
+ * \brief Points in a round of the backtrace analysis at which the data flow
+ * graph can be captured (used as bit mask in the config).
+ */
+enum GraphCaptureStage {
+    GraphCapturePreAugmentUse = 1,
+    GraphCaptureAugmentUse = 2,
+    GraphCapturePostAugmentUse = 4,
+    GraphCaptureMerged = 8,
+    GraphCaptureFinal = 16,
+
+    GraphCaptureAllStages = 31
+};
+
+enum GraphCaptureRecordType {
+    GraphRecordString = 1,
+    GraphRecordGraph,
+};
+
+struct GraphCaptureNode {
+    std::string label;
+    std::string comment;
+    uint32_t type = 0;
+    bool is_join = false;
+};
+
+struct GraphCaptureEdge {
+    uint32_t src = 0;
+    uint32_t dst = 0;
+    uint32_t type = 0;
+    std::string label;
+    std::string comment;
+};
+
+/*!
+ * \brief One captured data flow graph. The nodes are given by their index
+ * and labeled by the text of their instruction, the edges by the text of
+ * their operand (types are `DataFlowNodeType` and `DataFlowEdgeType`).
+ */
+struct GraphCaptureRecord {
+    std::string analysis; // Directory prefix of the analysis.
+    uint64_t start_addr = 0;
+    uint32_t round = 0;
+    uint32_t stage = 0;
+
+    // Tracking instruction of the round (not set for the final graph).
+    uint32_t tracking_type = 0;
+    uint64_t function_addr = 0;
+    uint64_t instr_addr = 0;
+    std::string operand;
+
+    std::vector<GraphCaptureNode> nodes;
+    std::vector<GraphCaptureEdge> edges;
+};
+
+/*!
+ * \brief Singleton capturing data flow graphs of the backtrace analyses into
+ * `{MODULE}.marx_graphs` while the analysis runs (replaces the `.dot` dumps
+ * that needed a rebuild).
+ *
+ * Only the selected stages of the analyses started at the selected
+ * addresses (all if none are given) are captured, for all other analyses
+ * the cost is one check when they are created. The file starts with the
+ * magic and version (each as 8 byte value) followed by records. Each
+ * record is a type byte followed by LEB128 encoded values:
+ *
+ *  - `GraphRecordString`: string id, length, characters (emitted the first
+ *    time a label is used, all later uses refer to the id).
+ *  - `GraphRecordGraph`: analysis string id, start address, round, stage,
+ *    tracking type, function address, instruction address, operand string
+ *    id, number of nodes, per node (label id, comment id, type, is join),
+ *    number of edges, per edge (source index, target index, type, label id,
+ *    comment id).
+ *
+ * Records are written by a dedicated writer thread like the ones of
+ * `ResultStream`. The tool `marx_graph_to_dot` converts the captured
+ * graphs into `.dot` files offline.
+ */
+class GraphCapture {
+private:
+    std::atomic<uint32_t> _stages{0};
+    std::unordered_set<uint64_t> _start_addrs;
+
+    std::ofstream _file;
+    std::string _file_name;
+
+    std::unordered_map<std::string, uint64_t> _string_ids;
+
+    std::string _chunk;
+    std::deque<std::string> _pending_chunks;
+    bool _stop = false;
+
+    std::thread _writer;
+    std::mutex _mtx;
+    std::condition_variable _cv_writer;
+    std::condition_variable _cv_producers;
+
+    GraphCapture() = default;
+
+    void writer_main();
+
+    void append_value(uint64_t value);
+    uint64_t append_string(const std::string &value);
+
+public:
+    GraphCapture(const GraphCapture&) = delete;
+    void operator=(const GraphCapture&) = delete;
+
+    ~GraphCapture() {
+        finish();
+    }
+
+    static GraphCapture &get_instance();
+
+    /*!
+     * \brief Starts capturing the given stages (bit mask of
+     * `GraphCaptureStage`) of the analyses started at the given addresses
+     * (all if empty).
+     *
+     * \return `false` if the file could not be created.
+     */
+    bool start(uint32_t stages,
+               const std::unordered_set<uint64_t> &start_addrs,
+               const std::string &target_dir,
+               const std::string &module_name);
+
+    /*!
+     * \brief Returns the stages that are captured for the analysis started
+     * at the given address (0 if it is not captured).
+     */
+    uint32_t get_stages(uint64_t start_addr) const {
+        const uint32_t stages = _stages;
+        if(stages == 0
+           || (!_start_addrs.empty()
+               && _start_addrs.find(start_addr) == _start_addrs.cend())) {
+            return 0;
+        }
+        return stages;
+    }
+
+    void add_graph(const GraphCaptureRecord &record);
+
+    /*!
+     * \brief Writes all remaining records and closes the file.
+     *
+     * \return `false` if the file could not be written.
+     */
+    bool finish();
+};
+
+/*!
+ * \brief Reads a file written by `GraphCapture` and calls the given
+ * function for each graph.
+ *
+ * \return `false` if the file could not be read or is corrupt.
+ */
+bool read_graph_capture(
+            const std::string &file_name,
+            const std::function<void (const GraphCaptureRecord&)> &callback);
+
+#endif // GRAPH_CAPTURE_H
@@ -38,11 +38,6 @@ private:
 
 private:
 
-    void remove_unnecessary_nodes(GraphDataFlow &graph,
-                                  InstrGraphNodeMap &instr_graph_node_map,
-                                  const OperandSSAPtr &initial_use,
-                                  const BaseInstructionSSAPtr &initial_instr);
-
     void add_vtable_call_nodes(GraphDataFlow &graph,
                                InstrGraphNodeMap &instr_graph_node_map,
                                const Function &function,
@@ -71,10 +66,17 @@ protected:
                                  const TrackingInstruction &);
 
     /*!
-     * \brief Prune internal function data flow graph in such a way that
-     * "call" functions are boundaries and each node has a path
-     * to the initial instruction.
+     * \brief The internal function data flow graph is pruned while it is
+     * built in such a way that "call" functions are boundaries and each
+     * node has a path to the initial instruction.
      */
+    virtual bool prune_during_augment_use() const;
+
+    virtual bool is_def_use_step_relevant(
+                                const DefUseStep &step,
+                                const OperandSSAPtr &initial_use,
+                                const BaseInstructionSSAPtr &initial_instr) const;
+
     virtual void post_augment_use(GraphDataFlow &graph,
                                   InstrGraphNodeMap &instr_graph_node_map,
                                   const Function &function,
@@ -12,4 +12,15 @@ typedef std::set<uint64_t> ICallSet;
 
 ICallSet import_icalls(const std::string &target_file);
 
+/*!
+ * \brief Imports the vcalls of the module confirmed by the dynamic analysis
+ * (`{DIR}/{MODULE}_dynamic_vcalls.marx_addr` or `.txt` as written by
+ * `dynamic_analysis/merge_profiles.cpp`).
+ *
+ * \return `false` if the directory holds no such file for the module.
+ */
+bool import_dynamic_vcalls(const std::string &feedback_dir,
+                           const std::string &module_name,
+                           ICallSet &vcalls);
+
 #endif
@@ -1,15 +1,69 @@
 #ifndef IDATA_H
 #define IDATA_H
 
-#include <map>
+#include <vector>
 #include <string>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
-typedef std::map<uint64_t, std::string> IDataMap;
+class MappedPe;
 
+struct IDataEntry {
+    uint64_t addr;
+    std::string name;
+};
+
+/*!
+ * \brief Read-only `.idata` (import address table) entries of a module
+ * sorted by their address.
+ */
+class IDataMap {
+private:
+    std::vector<IDataEntry> _entries;
+
+public:
+    IDataMap() = default;
+
+    /*!
+     * \brief Builds the map from the given entries (the last entry wins if
+     * an address occurs multiple times).
+     */
+    explicit IDataMap(std::vector<IDataEntry> entries);
+
+    /*!
+     * \brief Returns the entry at the given address.
+     * \return Returns a pointer to the entry or `nullptr` if the address is
+     * not the address of an `.idata` entry.
+     */
+    const IDataEntry *find(uint64_t addr) const;
+
+    size_t size() const {
+        return _entries.size();
+    }
+
+    /*!
+     * \brief Returns all entries (sorted by address).
+     */
+    const std::vector<IDataEntry> &get_entries() const {
+        return _entries;
+    }
+};
+
+/*!
+ * \brief Imports the `.idata` entries from the `{FILE}_idata.txt` file.
+ */
 IDataMap import_idata(const std::string &target_file);
 
+/*!
+ * \brief Reads the import address table entries directly from the mapped
+ * PE file (addresses are relative to the image base like all addresses
+ * of PE modules).
+ *
+ * Throws a `runtime_error` if the import directory is malformed.
+ */
+IDataMap import_idata(const MappedPe &pe);
+
 #endif
@@ -0,0 +1,159 @@
+#ifndef INCREMENTAL_STATE_H
+#define INCREMENTAL_STATE_H
+
+#include "translator.h"
+#include "vtable_file.h"
+#include "companion_file.h"
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <cstdint>
+
+class VCallFile;
+class ObjectAllocationFile;
+
+/*!
+ * \brief A vcall result of a previous run (vtable given by index into
+ * the current `VTableFile`).
+ */
+struct IncrementalResult {
+    uint64_t icall_addr;
+    uint32_t vtable_idx;
+    uint32_t entry_idx;
+};
+
+/*!
+ * \brief A vtable pointer init instruction found by the object allocation
+ * analysis of a previous run.
+ */
+struct IncrementalObjectAllocation {
+    uint64_t addr;
+    std::vector<uint32_t> vtbl_idxs;
+    std::vector<uint64_t> vtbl_xref_addrs;
+};
+
+typedef std::vector<IncrementalResult> IncrementalResults;
+typedef std::vector<IncrementalObjectAllocation> IncrementalObjectAllocations;
+
+/*!
+ * \brief Class handling the state that is kept between two runs in order
+ * to only re-analyze what changed.
+ *
+ * The state file `{BINARY_NAME}.marx_incremental` holds a hash of the SSA
+ * data of each function and the results of the object allocation and
+ * engels analysis. On the next run, the functions whose SSA data changed
+ * (or that are new) and their direct callers and callees are considered
+ * as affected. Cached results are dropped if their icall or their
+ * vtable pointer init instruction resides in an affected function or if
+ * the vtable of the result is referenced from an affected function.
+ * Only affected icalls, vtable xrefs in affected functions and vtable
+ * xrefs of vtables the dropped results refer to are analyzed again.
+ *
+ * The state is only used if the vtables of all modules and the config
+ * did not change (since functions are identified by address, moved code
+ * is considered as changed).
+ */
+class IncrementalState {
+private:
+    const std::string _state_file;
+    const Translator &_translator;
+    const VTableFile &_vtable_file;
+
+    std::unordered_map<uint64_t, uint64_t> _function_hashes;
+
+    bool _is_incremental = false;
+    std::unordered_set<uint64_t> _affected_functions;
+    std::unordered_set<uint64_t> _affected_icalls;
+    std::unordered_set<uint32_t> _affected_vtables;
+
+    IncrementalResults _cached_results;
+    std::unordered_set<uint64_t> _cached_possible_vcalls;
+    IncrementalObjectAllocations _cached_obj_allocs;
+
+    bool import_state_priv(uint64_t context_hash,
+                           std::unordered_map<uint64_t, uint64_t> &prev_hashes,
+                           IncrementalResults &prev_results,
+                           std::unordered_set<uint64_t> &prev_possible_vcalls,
+                           IncrementalObjectAllocations &prev_obj_allocs);
+
+    void compute_function_hashes();
+
+    void compute_affected_functions(
+                    const std::unordered_map<uint64_t, uint64_t> &prev_hashes);
+
+public:
+    IncrementalState(const std::string &target_file,
+                     const Translator &translator,
+                     const VTableFile &vtable_file);
+
+    IncrementalState(const IncrementalState&) = delete;
+    void operator=(const IncrementalState&) = delete;
+
+    /*!
+     * \brief Imports the state of the previous run and determines which
+     * parts of the module have to be analyzed again.
+     *
+     * `context_hash` is the hash of all inputs that are not tracked per
+     * function (the state is ignored if it differs from the previous run).
+     *
+     * \return `false` if no usable state exists (everything has to be
+     * analyzed in this case).
+     */
+    bool import_state(uint64_t context_hash);
+
+    /*!
+     * \brief Returns if the state of the previous run is used.
+     */
+    bool is_incremental() const;
+
+    /*!
+     * \brief Returns if the function containing the given address has to
+     * be analyzed again (always `true` if the state is not used).
+     */
+    bool is_affected(uint64_t addr) const;
+
+    /*!
+     * \brief Returns if the given icall has to be analyzed again.
+     */
+    bool is_affected_icall(uint64_t icall_addr) const;
+
+    /*!
+     * \brief Returns if the xrefs of the given vtable have to be analyzed
+     * again.
+     */
+    bool is_affected_vtable(uint32_t vtable_idx) const;
+
+    /*!
+     * \brief Returns the vcall results of the previous run that are
+     * still valid.
+     */
+    const IncrementalResults &get_cached_results() const;
+
+    /*!
+     * \brief Returns the possible vcalls of the previous run that are
+     * still valid.
+     */
+    const std::unordered_set<uint64_t> &get_cached_possible_vcalls() const;
+
+    /*!
+     * \brief Returns the object allocations of the previous run that are
+     * still valid.
+     */
+    const IncrementalObjectAllocations &get_cached_object_allocations() const;
+
+    /*!
+     * \brief Writes the state of this run (function hashes, the given
+     * vcall results, possible vcalls and object allocations).
+     * `import_state` has to be called before.
+     *
+     * \return `false` if the state file can not be written.
+     */
+    bool export_state(uint64_t context_hash,
+                      const IncrementalResults &results,
+                      const VCallFile &vcall_file,
+                      const ObjectAllocationFile &obj_alloc_file) const;
+};
+
+#endif // INCREMENTAL_STATE_H
@@ -0,0 +1,256 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+enum InstrumentationCounter {
+    InstrCounterSymExecBlocks = 0,
+    InstrCounterVexTranslations,
+    InstrCounterVexCacheHits,
+    InstrCounterStateKills,
+    InstrCounterStateCopies,
+    InstrCounterDefUseCacheHits,
+    InstrCounterDefUseCacheMisses,
+    InstrCounterBudgetExceeded,
+
+    InstrCounterNum
+};
+
+enum InstrumentationItemType {
+    InstrItemVTableXref = 0,
+    InstrItemLightweightICall,
+    InstrItemVCall,
+
+    InstrItemNum
+};
+
+typedef std::chrono::steady_clock InstrumentationClock;
+
+/*!
+ * \brief Costs of one analyzed work item (for example one vcall address).
+ */
+struct InstrumentationItem {
+    InstrumentationItemType type;
+    uint64_t addr;
+    uint64_t duration_us;
+    uint64_t graph_size;
+    uint64_t counters[InstrCounterNum];
+};
+
+/*!
+ * \brief Accumulated time of one phase.
+ */
+struct InstrumentationPhase {
+    std::string name;
+    uint64_t duration_us;
+    uint64_t count;
+
+    // Resident set size at the end of the phase and its peak during the
+    // phase (maximum over all occurrences, 0 if unknown).
+    uint64_t rss_kb;
+    uint64_t peak_rss_kb;
+};
+
+/*!
+ * \brief Estimated heap size of one of the major data structures.
+ */
+struct InstrumentationFootprint {
+    std::string name;
+    uint64_t bytes;
+};
+
+// Heap bytes of a node besides its value in the node based standard
+// containers (tree node: three pointers and the color, hash node: next
+// pointer and cached hash).
+#define INSTR_TREE_NODE_OVERHEAD 32
+#define INSTR_HASH_NODE_OVERHEAD 16
+
+/*!
+ * \brief Estimates the heap bytes of the given vector (without what its
+ * elements point to).
+ */
+template<typename T>
+size_t footprint_vector(const T &container) {
+    return container.capacity() * sizeof(typename T::value_type);
+}
+
+/*!
+ * \brief Estimates the heap bytes of the given `std::map`/`std::set`
+ * (without what its elements point to).
+ */
+template<typename T>
+size_t footprint_tree(const T &container) {
+    return container.size() * (sizeof(typename T::value_type)
+                               + INSTR_TREE_NODE_OVERHEAD);
+}
+
+/*!
+ * \brief Estimates the heap bytes of the given unordered container
+ * (without what its elements point to).
+ */
+template<typename T>
+size_t footprint_hash(const T &container) {
+    return container.size() * (sizeof(typename T::value_type)
+                               + INSTR_HASH_NODE_OVERHEAD)
+           + container.bucket_count() * sizeof(void*);
+}
+
+/*!
+ * \brief Counters and work items of one thread (only written by the
+ * owning thread).
+ */
+struct InstrumentationThreadData {
+    uint64_t counters[InstrCounterNum] = {};
+    std::vector<InstrumentationItem> items;
+};
+
+/*!
+ * \brief Singleton collecting timings and counters of the analysis.
+ *
+ * Counters are kept per thread, hence counting does not need any
+ * synchronization. The thread data is owned by the singleton and is
+ * summed up when the report is written (after all workers are joined).
+ * Timers are only taken if the instrumentation is enabled
+ * (config option `INSTRUMENTATION`).
+ */
+class Instrumentation {
+private:
+    bool _enabled = false;
+
+    std::vector<InstrumentationPhase> _phases;
+    std::vector<InstrumentationFootprint> _footprints;
+    std::vector<std::unique_ptr<InstrumentationThreadData>> _thread_data;
+    std::mutex _mtx;
+
+    Instrumentation() = default;
+
+public:
+    Instrumentation(const Instrumentation&) = delete;
+    void operator=(const Instrumentation&) = delete;
+
+    static Instrumentation &get_instance();
+
+    void set_enabled(bool enabled) {
+        _enabled = enabled;
+    }
+
+    bool is_enabled() const {
+        return _enabled;
+    }
+
+    /*!
+     * \brief Returns the data of the calling thread.
+     */
+    InstrumentationThreadData &get_thread_data();
+
+    /*!
+     * \brief Increments the given counter of the calling thread.
+     */
+    void count(InstrumentationCounter counter) {
+        get_thread_data().counters[counter]++;
+    }
+
+    /*!
+     * \brief Adds the duration to the phase with the given name (phases
+     * are reported in the order they were first seen).
+     */
+    void add_phase(const std::string &name,
+                   uint64_t duration_us,
+                   uint64_t rss_kb = 0,
+                   uint64_t peak_rss_kb = 0);
+
+    /*!
+     * \brief Adds the estimated size of a data structure to the footprint
+     * breakdown of the report (sizes with the same name are summed up).
+     */
+    void add_footprint(const std::string &name, uint64_t bytes);
+
+    /*!
+     * \brief Reads the current and the peak resident set size of the
+     * process from `/proc/self/status`.
+     *
+     * \return `false` if it is not available (both are set to 0).
+     */
+    static bool read_rss(uint64_t &rss_kb, uint64_t &peak_rss_kb);
+
+    /*!
+     * \brief Writes the phases, the summed up counters and the footprint
+     * breakdown into `{MODULE}_instrumentation.json` and all work items into
+     * `{MODULE}_instrumentation.csv`.
+     */
+    void export_report(const std::string &target_dir,
+                       const std::string &module_name);
+
+    /*!
+     * \brief Drops all phases, counters, footprints and work items (before the next
+     * module is analyzed by the same process, no worker may be running).
+     */
+    void reset();
+
+    /*!
+     * \brief Reads the work items of the report of a previous run (only the
+     * type, address and duration are set).
+     *
+     * \return `false` if no report exists.
+     */
+    static bool import_items(const std::string &target_dir,
+                             const std::string &module_name,
+                             std::vector<InstrumentationItem> &items);
+};
+
+/*!
+ * \brief Measures the time and the resident set size of a phase until
+ * `stop` is called or the object is destroyed.
+ *
+ * The peak of the process is only known since its start. If it grew during
+ * the phase, the phase reached it; otherwise the peak of the phase is
+ * approximated by the larger of the sizes at its start and end.
+ */
+class ScopedPhaseTimer {
+private:
+    const std::string _name;
+    bool _running;
+    bool _stopped = false;
+    InstrumentationClock::time_point _start;
+    uint64_t _start_rss_kb = 0;
+    uint64_t _start_peak_rss_kb = 0;
+
+public:
+    ScopedPhaseTimer(const std::string &name);
+    ~ScopedPhaseTimer();
+
+    ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+    void operator=(const ScopedPhaseTimer&) = delete;
+
+    void stop();
+};
+
+/*!
+ * \brief Records the time and the counter deltas of the calling thread for
+ * one work item until the object is destroyed.
+ */
+class ScopedItemTimer {
+private:
+    const bool _enabled;
+    InstrumentationItem _item;
+    InstrumentationClock::time_point _start;
+
+public:
+    ScopedItemTimer(InstrumentationItemType type, uint64_t addr);
+    ~ScopedItemTimer();
+
+    ScopedItemTimer(const ScopedItemTimer&) = delete;
+    void operator=(const ScopedItemTimer&) = delete;
+
+    void set_graph_size(uint64_t graph_size) {
+        _item.graph_size = graph_size;
+    }
+};
+
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,63 @@
+#ifndef IR_ARENA_H
+#define IR_ARENA_H
+
+extern "C" {
+#include <valgrind/libvex.h>
+#include <valgrind/libvex_ir.h>
+}
+
+#include <vector>
+#include <cstddef>
+
+#define IR_ARENA_CHUNK_SIZE (1 << 20)
+
+/*!
+ * \brief Compact storage for translated VEX blocks.
+ *
+ * `deepCopyIRSB_Heap` allocates every statement, expression and constant
+ * separately on the heap (and each allocation is tracked by `Vex`). The
+ * arena instead copies a block into few large chunks: statements and
+ * expressions are packed next to each other, the statement array and the
+ * type environment are trimmed to the used entries. The copy has the same
+ * layout as any other `IRSB`, hence all consumers work with it unmodified.
+ *
+ * All copies are freed when the arena is destroyed. The arena is not
+ * thread-safe.
+ */
+class IRArena {
+private:
+    std::vector<char*> _chunks;
+    char *_current = nullptr;
+    size_t _remaining = 0;
+    size_t _size = 0;
+
+public:
+    IRArena() = default;
+    IRArena(const IRArena&) = delete;
+    void operator=(const IRArena&) = delete;
+
+    ~IRArena();
+
+    IRSB *copy(const IRSB *block);
+
+    /*!
+     * \brief Returns the number of bytes used by all copies.
+     */
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    void *allocate(size_t size);
+
+    template<typename T>
+    T *copy_plain(const T *object);
+
+    IRExpr *copy(const IRExpr *expression);
+    IRExpr **copy(IRExpr *const *arguments);
+    IRStmt *copy(const IRStmt *statement);
+    IRTypeEnv *copy(const IRTypeEnv *type_env);
+    IRDirty *copy(const IRDirty *dirty);
+};
+
+#endif // IR_ARENA_H
@@ -0,0 +1,88 @@
+#ifndef ITEM_BUDGET_H
+#define ITEM_BUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+
+enum ItemBudgetKind {
+    ItemBudgetTime = 0,
+    ItemBudgetGraphNodes,
+    ItemBudgetPaths,
+
+    ItemBudgetNum
+};
+
+/*!
+ * \brief Limits of the analysis of one work item (0 means unlimited).
+ */
+struct ItemBudgetLimits {
+    uint32_t max_seconds = 0;
+    uint64_t max_graph_nodes = 0;
+    uint64_t max_paths = 0;
+};
+
+/*!
+ * \brief Thrown by the checks of `ScopedItemBudget` if the item being
+ * analyzed by the calling thread exceeds one of its limits.
+ */
+class ItemBudgetExceeded : public std::runtime_error {
+private:
+    const ItemBudgetKind _kind;
+
+public:
+    ItemBudgetExceeded(ItemBudgetKind kind);
+
+    ItemBudgetKind kind() const {
+        return _kind;
+    }
+};
+
+/*!
+ * \brief Budget of the work item analyzed by the calling thread until the
+ * object is destroyed.
+ *
+ * The analyses check the budget cooperatively at their loop boundaries (the
+ * checks do nothing if the thread does not analyze a budgeted item). A check
+ * that exceeds the budget throws `ItemBudgetExceeded`, which the owner of the
+ * budget catches in order to degrade the result of the item.
+ */
+class ScopedItemBudget {
+private:
+    static ItemBudgetLimits _limits;
+    static std::atomic<uint64_t> _num_exceeded[ItemBudgetNum];
+
+    std::chrono::steady_clock::time_point _deadline;
+    uint64_t _num_paths = 0;
+    ScopedItemBudget *_prev;
+
+public:
+    ScopedItemBudget();
+    ~ScopedItemBudget();
+
+    ScopedItemBudget(const ScopedItemBudget&) = delete;
+    void operator=(const ScopedItemBudget&) = delete;
+
+    /*!
+     * \brief Sets the limits of all items (config option `BUDGET`).
+     */
+    static void set_limits(const ItemBudgetLimits &limits) {
+        _limits = limits;
+    }
+
+    static void check_time();
+    static void check_graph_nodes(uint64_t num_nodes);
+    static void add_paths(uint64_t num_paths);
+
+    static void count_exceeded(ItemBudgetKind kind);
+
+    /*!
+     * \brief Returns the number of items that exceeded the given limit.
+     */
+    static uint64_t get_num_exceeded(ItemBudgetKind kind) {
+        return _num_exceeded[kind];
+    }
+};
+
+#endif // ITEM_BUDGET_H
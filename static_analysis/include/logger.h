@@ -0,0 +1,169 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+enum LogLevel {
+    LogError = 0,
+    LogWarning,
+    LogInfo,
+    LogProgress,
+    LogDebug,
+
+    LogLevelNum
+};
+
+// Longer messages are truncated.
+#define LOG_RECORD_SIZE 248
+#define LOG_RING_RECORDS 512
+
+#define LOG_DEFAULT_PROGRESS_INTERVAL_MS 100
+
+/*!
+ * \brief One message in a `LogRing`.
+ */
+struct LogRecord {
+    uint16_t level;
+    uint16_t length;
+    char text[LOG_RECORD_SIZE];
+};
+
+/*!
+ * \brief Single producer single consumer ring buffer of the messages of one
+ * thread (the producer is the owning thread, the consumer the drain thread).
+ */
+struct LogRing {
+    LogRecord records[LOG_RING_RECORDS];
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+
+    // Set while a thread owns the ring (released rings are reused).
+    std::atomic<bool> in_use{false};
+
+    // Only accessed by the owning thread.
+    std::chrono::steady_clock::time_point last_progress;
+};
+
+/*!
+ * \brief Singleton writing the messages of the worker threads to stdout.
+ *
+ * Each thread appends its messages to its own ring buffer without any
+ * locking; a background thread drains all rings. Hence logging does not
+ * serialize the workers, even inside of critical sections. If a ring is
+ * full, the writing thread drains the rings itself (messages are only
+ * dropped and counted if this is not sufficient).
+ *
+ * Progress messages are rate limited per thread (at most one message per
+ * progress interval). Use the `LOG_*` macros, they only format the message
+ * if it is actually written.
+ */
+class Logger {
+private:
+    std::atomic<uint32_t> _level{LogProgress};
+    std::atomic<uint32_t> _progress_interval_ms{
+                                            LOG_DEFAULT_PROGRESS_INTERVAL_MS};
+    std::atomic<uint64_t> _dropped{0};
+
+    std::vector<std::unique_ptr<LogRing>> _rings;
+    std::mutex _rings_mtx;
+
+    // Held while draining (by the drain thread or `flush`).
+    std::mutex _drain_mtx;
+
+    std::thread _drain_thread;
+    std::mutex _wakeup_mtx;
+    std::condition_variable _wakeup_cv;
+    bool _stop = false;
+
+    Logger();
+
+    LogRing &get_thread_ring();
+
+    bool drain();
+
+    void drain_loop();
+
+public:
+    Logger(const Logger&) = delete;
+    void operator=(const Logger&) = delete;
+
+    ~Logger();
+
+    static Logger &get_instance();
+
+    void set_level(LogLevel level) {
+        _level = level;
+    }
+
+    /*!
+     * \brief Sets the minimum time between two progress messages of a
+     * thread (0 writes all of them).
+     */
+    void set_progress_interval(uint32_t interval_ms) {
+        _progress_interval_ms = interval_ms;
+    }
+
+    bool is_enabled(LogLevel level) const {
+        return static_cast<uint32_t>(level) <= _level.load(
+                                                    std::memory_order_relaxed);
+    }
+
+    /*!
+     * \brief Checks if a progress message of the calling thread is due (and
+     * if so, restarts its interval).
+     */
+    bool progress_due();
+
+    /*!
+     * \brief Appends the message to the ring of the calling thread.
+     */
+    void write(LogLevel level, const std::string &message);
+
+    /*!
+     * \brief Writes all pending messages to stdout (before writing to
+     * stdout directly).
+     */
+    void flush();
+
+    /*!
+     * \brief Returns the number of messages dropped because a ring was full.
+     */
+    uint64_t get_dropped() const {
+        return _dropped;
+    }
+};
+
+#define LOG_MESSAGE(level, message) \
+    do { \
+        Logger &log_instance_ = Logger::get_instance(); \
+        if(log_instance_.is_enabled(level)) { \
+            std::ostringstream log_stream_; \
+            log_stream_ << message; \
+            log_instance_.write(level, log_stream_.str()); \
+        } \
+    } while(0)
+
+#define LOG_PROGRESS(message) \
+    do { \
+        Logger &log_instance_ = Logger::get_instance(); \
+        if(log_instance_.is_enabled(LogProgress) \
+           && log_instance_.progress_due()) { \
+            std::ostringstream log_stream_; \
+            log_stream_ << message; \
+            log_instance_.write(LogProgress, log_stream_.str()); \
+        } \
+    } while(0)
+
+#define LOG_INFO(message) LOG_MESSAGE(LogInfo, message)
+#define LOG_DEBUG(message) LOG_MESSAGE(LogDebug, message)
+
+#endif // LOGGER_H
@@ -2,23 +2,31 @@
 #define MAPPED_ELF_H
 
 #include <string>
-#include <vector>
 #include <cstdint>
 
 #include <elf.h>
 #include <link.h>
 
 #include "memory.h"
+#include "mapped_file.h"
 
 /*!
  * \brief Class holding information about a memory-mapped ELF file.
+ *
+ * The file is mapped read-only, hence pages are only loaded once they are
+ * accessed (and can be dropped again by the kernel).
  */
 class MappedElf : public Memory {
 private:
-    std::vector<char> _buffer;
+    MappedFile _file;
 
-    ElfW(Ehdr) *_e_header = nullptr;
-    ElfW(Phdr) *_p_header = nullptr;
+    const ElfW(Ehdr) *_e_header = nullptr;
+    const ElfW(Phdr) *_p_header = nullptr;
+
+    // Section headers are optional (`nullptr` if the file has none).
+    const ElfW(Shdr) *_s_header = nullptr;
+    uint32_t _num_sections = 0;
+    const ElfW(Shdr) *_section_names = nullptr;
 
     uintptr_t _base = 0;
     size_t _size = 0;
@@ -45,6 +53,29 @@ public:
     virtual uintptr_t get_load_end() const {
         return _base + _size;
     }
+
+    /*!
+     * \brief Returns the header of the section with the given name.
+     * \return Returns a pointer to the section header or `nullptr` if the
+     * file has no such section.
+     */
+    const ElfW(Shdr) *get_section(const std::string &name) const;
+
+    /*!
+     * \brief Returns the header of the section with the given index
+     * (e.g., the `sh_link` of another section).
+     * \return Returns a pointer to the section header or `nullptr` if the
+     * index is out of range.
+     */
+    const ElfW(Shdr) *get_section(uint32_t idx) const;
+
+    /*!
+     * \brief Returns the content of the given section as stored in the file.
+     * \return Returns a pointer to the first byte of the section or `nullptr`
+     * if the section has no content in the file (e.g., `.bss`) or
+     * exceeds it.
+     */
+    const uint8_t *get_section_data(const ElfW(Shdr) &section) const;
 };
 
 #endif // MAPPED_ELF_H
@@ -0,0 +1,63 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * \brief Class holding a read-only memory mapping of a whole file.
+ *
+ * The mapping is released when the object is destroyed.
+ */
+class MappedFile {
+private:
+    int _fd = -1;
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+
+public:
+    MappedFile(const MappedFile&) = delete;
+    void operator=(const MappedFile&) = delete;
+
+    MappedFile(const std::string &file_name);
+    ~MappedFile();
+
+    /*!
+     * \brief Returns the begin of the mapped file.
+     * \return Returns a pointer to the first byte (`nullptr` for empty files).
+     */
+    const uint8_t *data() const {
+        return _data;
+    }
+
+    /*!
+     * \brief Returns the size of the mapped file.
+     * \return Returns the size in bytes.
+     */
+    size_t size() const {
+        return _size;
+    }
+
+    /*!
+     * \brief Gives the kernel a hint how the given range of the file will be
+     * accessed (e.g., `MADV_WILLNEED` or `MADV_SEQUENTIAL`, see `madvise`).
+     *
+     * Hints are best-effort, hence failures are ignored.
+     */
+    void advise(size_t offset, size_t length, int advice) const;
+
+    /*!
+     * \brief Returns if the given file exists and can be opened for reading.
+     */
+    static bool exists(const std::string &file_name);
+};
+
+/*!
+ * \brief Hashes the content of the given file (64 bit FNV-1a).
+ *
+ * \return The hash value or 0 if the file can not be opened.
+ */
+uint64_t hash_file(const std::string &file_name);
+
+#endif // MAPPED_FILE_H
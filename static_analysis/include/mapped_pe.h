@@ -2,27 +2,36 @@
 #define MAPPED_PE_H
 
 #include <string>
-#include <vector>
 #include <cstdint>
 
 #include "pe.h"
 
 #include "memory.h"
+#include "mapped_file.h"
 
 /*!
  * \brief Class holding information about a memory-mapped PE file.
+ *
+ * The file is mapped read-only, hence pages are only loaded once they are
+ * accessed (and can be dropped again by the kernel).
  */
 class MappedPe : public Memory {
 private:
-    std::vector<char> _buffer;
+    MappedFile _file;
 
-    mz_hdr *_mz_header = nullptr;
-    pe_hdr *_pe_header = nullptr;
+    const mz_hdr *_mz_header = nullptr;
+    const pe_hdr *_pe_header = nullptr;
 
-    pe32_opt_hdr *_pe32_opt_header = nullptr;
-    pe32plus_opt_hdr *_pe32_plus_opt_header = nullptr;
+    const pe32_opt_hdr *_pe32_opt_header = nullptr;
+    const pe32plus_opt_hdr *_pe32_plus_opt_header = nullptr;
 
-    section_header *_text_section_header = nullptr;
+    const section_header *_text_section_header = nullptr;
+
+    const section_header *_section_headers = nullptr;
+    uint32_t _num_sections = 0;
+
+    // Only set for PE32+ files with all data directory entries.
+    const data_directory *_data_directory = nullptr;
 
     uintptr_t _base = 0;
     size_t _size = 0;
@@ -51,6 +60,23 @@ public:
     virtual uintptr_t get_load_end() const {
         return _base + _size;
     }
+
+    /*!
+     * \brief Returns the data directory of the optional header.
+     * \return Returns a pointer to the data directory or `nullptr` if the
+     * file is no PE32+ file or its data directory is incomplete.
+     */
+    const data_directory *get_data_directory() const {
+        return _data_directory;
+    }
+
+    /*!
+     * \brief Returns the content of the file at the given relative virtual
+     * address.
+     * \return Returns a pointer to the content or `nullptr` if the range is
+     * not completely stored in the raw data of one section.
+     */
+    const uint8_t *get_rva_data(uint32_t rva, size_t size) const;
 };
 
 #endif // MAPPED_PE_H
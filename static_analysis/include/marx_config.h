@@ -0,0 +1,76 @@
+#ifndef MARX_CONFIG_H
+#define MARX_CONFIG_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+
+#include "memory.h"
+#include "item_budget.h"
+#include "numa_placement.h"
+#include "state.h"
+#include "result_stream.h"
+#include "logger.h"
+#include "graph_capture.h"
+#include "vtable_xref_scanner.h"
+
+/*!
+ * \brief Options of one module to analyze (given in the config file).
+ */
+struct MarxModuleConfig {
+    std::string module_name; // File name == module name
+    std::string target_dir;
+    std::unordered_set<uint64_t> new_operators;
+    std::unordered_set<uint64_t> vtv_verify_addrs;
+};
+
+/*!
+ * \brief Options given in the config file.
+ */
+struct MarxConfig {
+    std::vector<MarxModuleConfig> modules;
+    FileFormatType file_format = FileFormatCount;
+    std::vector<std::string> ext_modules;
+    uint32_t use_analysis_cache = 0;
+    uint32_t use_incremental = 0;
+    uint32_t checkpoint_interval = 0;
+    ItemBudgetLimits budget_limits;
+    uint32_t numa_mode = NumaDisabled;
+    uint32_t state_backend = StateBackendTree;
+    uint32_t use_instrumentation = 0;
+    uint32_t result_stream_mode = ResultStreamDisabled;
+    uint32_t native_tables = 0;
+    uint32_t native_xrefs = NativeXrefsDisabled;
+    uint32_t num_threads = 1;
+    uint32_t on_demand = 0;
+    uint32_t tiering = 0;
+    uint32_t lazy_ext_modules = 0;
+
+    // Directory of the summaries shared between modules (empty if unused).
+    std::string summary_store_dir;
+
+    // Directory of the vcalls confirmed by the dynamic analysis (empty if
+    // unused).
+    std::string dynamic_vcalls_dir;
+    uint32_t log_level = LogProgress;
+    uint32_t progress_interval_ms = LOG_DEFAULT_PROGRESS_INTERVAL_MS;
+
+    // Stages of the data flow graphs to capture (bit mask of
+    // `GraphCaptureStage`) and the start addresses of the captured analyses
+    // (all if empty).
+    uint32_t graph_capture_stages = 0;
+    std::unordered_set<uint64_t> graph_capture_addrs;
+};
+
+/*!
+ * \brief Parses the given config file.
+ *
+ * A config can contain several modules. `MODULENAME` and `TARGETDIR` start
+ * the next module once the current one has them set, `NEWOPERATORS` and
+ * `VTVVERIFY` belong to the current module. All other options apply to all
+ * modules.
+ */
+MarxConfig parse_config(const std::string &config_file);
+
+#endif // MARX_CONFIG_H
@@ -0,0 +1,125 @@
+#ifndef MARX_QUERY_H
+#define MARX_QUERY_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "marx_config.h"
+#include "vtable_file.h"
+#include "vex.h"
+#include "blacklist_functions.h"
+
+class ExternalFunctions;
+class ModulePlt;
+class VTableHierarchies;
+class Translator;
+
+typedef std::vector<const VTable*> VTablePtrVector;
+
+
+/*!
+ * \brief Embeddable query interface for the results of one module
+ * (built as `libmarx`).
+ *
+ * Instead of running the whole analysis pipeline, only the artefacts needed
+ * to answer a query are loaded (on the first query that needs them) and kept
+ * for all following queries:
+ *
+ * - `get_hierarchy` needs the vtables and hierarchies of the module and of
+ *   all external modules.
+ * - `get_allocation_sites` additionally needs the lifted module (taken from
+ *   the analysis cache if enabled) and runs the object allocation analysis
+ *   once.
+ * - `get_allowed_vtables` attaches to the `.vcalls` file of a previous full
+ *   run, since the vcall results are a fixpoint over the whole module.
+ *
+ * All queries can be made concurrently. Returned pointers stay valid for the
+ * lifetime of the query object.
+ */
+class MarxQuery {
+private:
+    const MarxConfig _config;
+    const MarxModuleConfig _module;
+    const std::string _module_name;
+    const std::string _target_file;
+
+    // Members depending on each other are declared in construction order.
+    std::unique_ptr<Translator> _translator;
+    std::unique_ptr<VTableFile> _vtable_file;
+    std::unique_ptr<ModulePlt> _module_plt;
+    std::unique_ptr<ExternalFunctions> _external_funcs;
+    BlacklistFuncsSet _funcs_blacklist;
+    std::unique_ptr<VTableHierarchies> _vtable_hierarchies;
+
+    bool _obj_allocs_loaded = false;
+    std::unordered_map<uint32_t, std::vector<uint64_t>> _obj_alloc_sites;
+
+    bool _vcalls_loaded = false;
+    std::unordered_map<uint64_t, VTablePtrVector> _vcalls;
+
+    bool _restore_vex = false;
+    VexRegisterUpdates _orig_iropt_register_updates;
+
+    std::mutex _mtx;
+
+private:
+    void load_translator();
+
+    void load_vtables();
+
+    void load_object_allocations();
+
+    void load_vcalls();
+
+public:
+
+    /*!
+     * \brief Prepares queries for the module with the given index of the
+     * config. Nothing is loaded until the first query.
+     */
+    MarxQuery(const MarxConfig &config, size_t module_idx=0);
+
+    ~MarxQuery();
+
+    MarxQuery(const MarxQuery&) = delete;
+    MarxQuery& operator=(const MarxQuery&) = delete;
+
+    /*!
+     * \brief Returns the vtable at the given address of the given module
+     * (`nullptr` if it does not exist).
+     */
+    const VTable *get_vtable(const std::string &module_name, uint64_t addr);
+
+    /*!
+     * \brief Returns all vtables of the hierarchy the given vtable belongs
+     * to (only the vtable itself if it is not part of a hierarchy).
+     *
+     * \return Returns `false` if the vtable does not exist.
+     */
+    bool get_hierarchy(const std::string &module_name,
+                       uint64_t vtbl_addr,
+                       VTablePtrVector &hierarchy);
+
+    /*!
+     * \brief Returns the sorted addresses at which an object with the given
+     * vtable of the analyzed module is allocated.
+     *
+     * \return Returns `false` if the vtable does not exist.
+     */
+    bool get_allocation_sites(uint64_t vtbl_addr,
+                              std::vector<uint64_t> &alloc_sites);
+
+    /*!
+     * \brief Returns the vtables that are allowed at the given indirect
+     * callsite of the analyzed module.
+     *
+     * \return Returns `false` if the callsite is no known vcall.
+     */
+    bool get_allowed_vtables(uint64_t icall_addr,
+                             VTablePtrVector &allowed_vtables);
+};
+
+#endif // MARX_QUERY_H
@@ -5,23 +5,37 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
+#include <vector>
+
+class MappedElf;
 
 
 struct PltEntry {
     uint64_t addr;
     std::string func_name;
+
+    //! Id of the interned function name.
+    //! \see `ExternalFunctions::intern_name`
+    uint32_t name_id;
 };
 
 
-typedef std::map<uint64_t, PltEntry> PltMap;
+// Sorted by address (one entry per address).
+typedef std::vector<PltEntry> PltMap;
+typedef std::vector<const PltEntry*> PltIdVector;
 
 
 class ModulePlt {
 
     const std::string &_module_name;
     PltMap _plt_entries;
+    PltIdVector _plt_entries_names;
 
 private:
+    void add_entry(uint64_t addr, const std::string &func_name);
+
+    void finalize();
 
 public:
     ModulePlt(const std::string &module_name);
@@ -33,6 +47,17 @@ public:
     bool parse(const std::string &plt_file);
 
 
+    /*!
+     * \brief Reads the .plt entries directly from the mapped ELF file.
+     *
+     * Each `R_X86_64_JUMP_SLOT` relocation in `.rela.plt` belongs to the
+     * stub at the same position in `.plt.sec` (or `.plt` behind the initial
+     * resolver stub if the file has no `.plt.sec`), the name is taken from
+     * the dynamic symbol of the relocation.
+     */
+    bool parse(const MappedElf &elf);
+
+
     /*!
      * \brief Returns a pointer to the plt entry given by the address.
      * \return Returns a pointer to the plt entry given by the address
@@ -46,7 +71,29 @@ public:
      * \return Returns a pointer to the plt entry given by the address
      * or null if it was not found.
      */
-    const PltEntry* get_plt_entry(const std::string func_name) const;
+    const PltEntry* get_plt_entry(const std::string &func_name) const;
+
+
+    /*!
+     * \brief Returns a pointer to the plt entry given by the id of the
+     * function name. \see `ExternalFunctions::intern_name`
+     * \return Returns a pointer to the plt entry given by the id
+     * or null if it was not found.
+     */
+    const PltEntry* get_plt_entry_by_id(uint32_t name_id) const {
+        if(name_id >= _plt_entries_names.size()) {
+            return nullptr;
+        }
+        return _plt_entries_names[name_id];
+    }
+
+
+    /*!
+     * \brief Returns all plt entries (sorted by address).
+     */
+    const PltMap &get_plt_entries() const {
+        return _plt_entries;
+    }
 
 };
 
@@ -0,0 +1,65 @@
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+enum NumaMode {
+    NumaDisabled = 0,
+
+    // Worker threads are pinned to cores spread over all NUMA nodes.
+    NumaPinThreads,
+
+    // Additionally, the shared read-only structures (translator, vtables
+    // and hierarchies) are interleaved over the memory of all nodes.
+    NumaPinThreadsInterleave,
+};
+
+/*!
+ * \brief Places the worker threads and the shared data on the NUMA nodes of
+ * the machine (config option `NUMA`).
+ *
+ * All workers read the structures built by the main thread. Without
+ * interleaving they end up on the memory of the node of the main thread
+ * and each access from another socket crosses the interconnect. Interleaving
+ * spreads that load over all memory controllers, while the allocations of
+ * the (pinned) workers stay on their local node.
+ *
+ * The topology is read from `/sys/devices/system/node`. On machines with a
+ * single node everything is a no-op.
+ */
+class NumaPlacement {
+private:
+    NumaMode _mode = NumaDisabled;
+
+    // CPUs of each node.
+    std::vector<std::vector<uint32_t>> _node_cpus;
+
+    NumaPlacement() = default;
+
+    void read_topology();
+
+public:
+    NumaPlacement(const NumaPlacement&) = delete;
+    void operator=(const NumaPlacement&) = delete;
+
+    static NumaPlacement &get_instance();
+
+    void set_mode(NumaMode mode);
+
+    NumaMode get_mode() const {
+        return _mode;
+    }
+
+    size_t get_num_nodes() const {
+        return _node_cpus.size();
+    }
+
+    void begin_shared_allocations() const;
+    void end_shared_allocations() const;
+
+    void pin_thread(uint32_t thread_number) const;
+};
+
+#endif // NUMA_PLACEMENT_H
@@ -10,12 +10,17 @@
 
 #include "vtable_file.h"
 #include "translator.h"
+#include "work_queue.h"
+#include "result_stream.h"
 
 #define DEBUG_OBJ_ALLOC_PRINT 0
 #define DEBUG_OBJ_ALLOC_PRINT_VERBOSE 0
 
-extern std::queue<uint64_t> queue_vtable_addrs;
-extern std::mutex queue_vtable_addrs_mtx;
+extern WorkQueue queue_obj_alloc_tasks;
+
+class IncrementalState;
+class SummaryStore;
+struct AnalysisShard;
 
 
 struct ObjectAllocation {
@@ -80,19 +85,34 @@ private:
     const std::string &_module_name;
     ObjectAllocationMap _obj_allocs;
 
+    ResultStream *_result_stream = nullptr;
+    const VTableFile *_vtable_file = nullptr;
+
     mutable std::mutex _mtx;
 
 public:
 
     ObjectAllocationFile(const std::string &module_name);
 
+    /*!
+     * \brief Streams each new object allocation (one record per vtable and
+     * vtable xref) into the given stream.
+     */
+    void set_result_stream(ResultStream *result_stream,
+                           const VTableFile &vtable_file);
+
     const ObjectAllocationMap& get_object_allocations() const;
 
     void add_object_allocation(uint64_t vtable_init_addr,
                                uint32_t vtbl_idx,
                                uint64_t vtbl_xref_addr);
 
-    void export_object_allocations(const std::string &target_dir);
+    /*!
+     * \brief Exports the object allocations into `{MODULE}_obj_allocs.txt`
+     * (formatted by the given number of threads).
+     */
+    void export_object_allocations(const std::string &target_dir,
+                                   uint32_t num_threads=1);
 
 };
 
@@ -102,6 +122,9 @@ void object_allocation_analysis(const std::string &module_name,
                                 const Translator &translator,
                                 Vex &vex,
                                 ObjectAllocationFile &obj_alloc_file,
-                                uint32_t num_threads);
+                                uint32_t num_threads,
+                                const IncrementalState *incremental=nullptr,
+                                const AnalysisShard *shard=nullptr,
+                                SummaryStore *summary_store=nullptr);
 
 #endif //OBJECT_ALLOCATIONS_H
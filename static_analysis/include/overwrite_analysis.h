@@ -24,12 +24,10 @@
 
 #include <map>
 #include <set>
+#include <atomic>
 #include <memory>
 #include <unordered_set>
 
-#define NUMBER_SYSTEM_V_ARGS 6
-#define NUMBER_MSVC_ARGS 4
-
 #define DEBUG_PRINT_ICALL_RESOLUTION 0
 
 #define FOLLOW_ONLY_INTERESTING_CALLS 0
@@ -38,6 +36,15 @@
 
 const auto MAX_CALL_DEPTH = 2;
 
+// The cache holds 2^OVERWRITE_BLOCK_CACHE_CHUNK_BITS blocks per chunk.
+#define OVERWRITE_BLOCK_CACHE_CHUNK_BITS 16
+#define OVERWRITE_BLOCK_CACHE_NUM_CHUNKS (1 << (32 - \
+                                             OVERWRITE_BLOCK_CACHE_CHUNK_BITS))
+// Blocks with larger ids (or without id) bypass the cache.
+#define OVERWRITE_BLOCK_CACHE_MAX_BLOCKS \
+    ((uint64_t)OVERWRITE_BLOCK_CACHE_NUM_CHUNKS << \
+     OVERWRITE_BLOCK_CACHE_CHUNK_BITS)
+
 struct MultipleReturnValue {
     ExpressionPtr location;
     std::vector<ReturnValue> ret_values;
@@ -52,6 +59,39 @@ typedef std::unordered_set<ExpressionPtr, std::hash<ExpressionPtr>,
 typedef std::vector<MultipleReturnValue> MultipleReturnValues;
 
 
+/*!
+ * \brief Thread-safe cache of the results of
+ * `OverwriteAnalysis::block_predicate`, shared by all analyses of a module.
+ *
+ * The predicate only depends on the block itself and on module-wide data
+ * (the new operators and the vtables of the module), hence sibling analyses
+ * of different functions can share the results.
+ *
+ * The results are kept in a bitmap indexed by the id of the block (two bits
+ * per block: whether the result is known and the result itself). The bitmap
+ * is split into chunks that are allocated on first use; lookups and updates
+ * are lock-free. Blocks whose id lies beyond the bitmap (including artificial
+ * blocks without id) are never cached.
+ */
+class OverwriteBlockCache {
+private:
+    std::atomic<std::atomic<uint64_t>*>
+                                   _chunks[OVERWRITE_BLOCK_CACHE_NUM_CHUNKS];
+
+    std::atomic<uint64_t> *get_chunk(uint64_t block_id, bool create);
+
+public:
+    OverwriteBlockCache();
+    ~OverwriteBlockCache();
+
+    OverwriteBlockCache(const OverwriteBlockCache&) = delete;
+    void operator=(const OverwriteBlockCache&) = delete;
+
+    bool find(const Block &block, arg_out bool &interesting);
+    void insert(const Block &block, bool interesting);
+};
+
+
 /*!
  * \brief Class for analyzing the given module for vtable overwrites.
  *
@@ -81,22 +121,7 @@ private:
     const VTableMap &_this_vtables;
 
     const std::string _module_name;
-
-    const ExpressionPtr _system_v_arguments_init[NUMBER_SYSTEM_V_ARGS] = {
-        State::initial_values().at(OFFB_RDI),
-        State::initial_values().at(OFFB_RSI),
-        State::initial_values().at(OFFB_RDX),
-        State::initial_values().at(OFFB_RCX),
-        State::initial_values().at(OFFB_R8),
-        State::initial_values().at(OFFB_R9)
-    };
-
-    const ExpressionPtr _msvc_arguments_init[NUMBER_MSVC_ARGS] = {
-        State::initial_values().at(OFFB_RCX),
-        State::initial_values().at(OFFB_RDX),
-        State::initial_values().at(OFFB_R8),
-        State::initial_values().at(OFFB_R9)
-    };
+    const VTableModuleId _module_id;
 
     VTableUpdates _master_vtable_updates;
     VTableUpdates &_vtable_updates;
@@ -116,10 +141,7 @@ private:
     MultipleReturnValues _master_ret_value_mapping;
     MultipleReturnValues &_ret_value_mapping;
 
-    std::unordered_set<uint64_t> _master_block_cache_true;
-    std::unordered_set<uint64_t> &_block_cache_true;
-    std::unordered_set<uint64_t> _master_block_cache_false;
-    std::unordered_set<uint64_t> &_block_cache_false;
+    OverwriteBlockCache &_block_cache;
 
     std::shared_ptr<State> _last_state_ptr = nullptr;
     std::shared_ptr<Block> _last_block_ptr = nullptr;
@@ -152,6 +174,8 @@ private:
 
     void handle_new_operator(const Block&, State&);
 
+    bool is_interesting_block(const Block &block) const;
+
 public:
     using BaseAnalysis::BaseAnalysis;
 
@@ -172,6 +196,7 @@ public:
                       const FctReturnValuesFile &fct_return_values,
                       FctVTableUpdates &external_vtable_updates,
                       VCallFile &vcall_file,
+                      OverwriteBlockCache &block_cache,
                       const std::string &module_name,
                       uint64_t memory_begin,
                       uint64_t memory_end);
@@ -197,6 +222,7 @@ public:
                       const FctReturnValuesFile &fct_return_values,
                       FctVTableUpdates &external_vtable_updates,
                       VCallFile &vcall_file,
+                      OverwriteBlockCache &block_cache,
                       const std::string &module_name,
                       uint64_t memory_begin,
                       uint64_t memory_end,
@@ -206,9 +232,7 @@ public:
                       VTableUpdates &vtable_updates,
                       OperatorNewExprMap &op_new_candidates,
                       VTVVcalls &vtv_vcalls,
-                      MultipleReturnValues &ret_value_mapping,
-                      std::unordered_set<uint64_t> &block_cache_true,
-                      std::unordered_set<uint64_t> &block_cache_false);
+                      MultipleReturnValues &ret_value_mapping);
 
 
     /*!
@@ -274,7 +298,8 @@ public:
      * (used for path finding).
      *
      * Overwrite analysis considers all basic blocks as interesting that
-     * contain an indirect call or a vtable as a constant.
+     * contain an indirect call or a vtable as a constant. The results are
+     * cached module-wide. \see `OverwriteBlockCache`
      */
     virtual bool block_predicate(const Block &block);
 
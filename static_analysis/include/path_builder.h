@@ -4,9 +4,12 @@
 #include <map>
 #include <set>
 #include <deque>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <cstdint>
 #include <functional>
+#include <unordered_map>
 
 #include "block.h"
 #include "function.h"
@@ -17,8 +20,75 @@ using ConcretePath = std::deque<uintptr_t>;
 //! A map relating a node to a concrete path.
 using PathsByNode = std::map<uintptr_t, ConcretePath>;
 
+//! A concrete path given by the indexes of its blocks (in address order).
+using BlockIndexPath = std::vector<uint32_t>;
+
+//!
+//! \brief Set of distinct concrete paths.
+//!
+//! All paths are stored as sequences of block indexes in a single arena (the
+//! addresses are shared by all sets of a function), duplicates are detected
+//! by hashing. Indexes follow the address order, hence `sort` yields the same
+//! order as a `std::set<ConcretePath>`.
+//!
+class ConcretePathSet {
+private:
+    struct Entry {
+        size_t offset;
+        uint32_t length;
+        size_t hash;
+    };
+
+    std::shared_ptr<const std::vector<uintptr_t>> _addresses;
+    std::vector<uint32_t> _blocks;
+    std::vector<Entry> _paths;
+    std::unordered_multimap<size_t, uint32_t> _index;
+
+public:
+    ConcretePathSet(
+             const std::shared_ptr<const std::vector<uintptr_t>> &addresses);
+
+    bool insert(const uint32_t *blocks, uint32_t length);
+
+    bool insert(const BlockIndexPath &path) {
+        return insert(path.data(), path.size());
+    }
+
+    void merge(const ConcretePathSet &other);
+    void sort();
+
+    size_t size() const {
+        return _paths.size();
+    }
+
+    bool empty() const {
+        return _paths.empty();
+    }
+
+    //! \brief Returns the number of blocks of the given path.
+    uint32_t length(size_t path) const {
+        return _paths[path].length;
+    }
+
+    //! \brief Returns the address of the block at `position` of the path.
+    uintptr_t get_block(size_t path, uint32_t position) const {
+        return (*_addresses)[_blocks[_paths[path].offset + position]];
+    }
+
+private:
+    bool equals(const Entry &entry, const uint32_t *blocks,
+                uint32_t length) const;
+};
+
+//! The paths from a block to other blocks, by the index of the latter.
+using IndexPathsByNode = std::map<uint32_t, BlockIndexPath>;
+
 const uint8_t NODE_THRESHOLD = 20;
 
+//! The number of blocks a function has to exceed such that its paths are
+//! built by several threads. \see `PathBuilder::set_num_threads`
+const size_t PARALLEL_BLOCK_THRESHOLD = 2000;
+
 //!
 //! \brief Class calculating viable paths through a given `Function` (the
 //! "lightweight" policy used as a fallback in `Function::traverse`).
@@ -29,12 +99,28 @@ private:
     void *_user_defined;
     const uint8_t _node_threshold;
 
+    static std::atomic<uint32_t> _idle_threads;
+
 public:
     PathBuilder(const Function &function, void *user_defined=nullptr,
                 uint8_t node_threshold=NODE_THRESHOLD);
-    std::set<ConcretePath> build_paths(BlockPredicate predicate) const;
+    ConcretePathSet build_paths(BlockPredicate predicate) const;
+
+    static void set_num_threads(uint32_t num_threads);
 
 private:
+    void run_subtasks(bool parallel, size_t num_tasks,
+                      const std::function<void (size_t)> &task) const;
+
+    void stitch_paths(
+            const BlockIndexPath &root_to_first,
+            const std::map<uint32_t, std::vector<BlockIndexPath>>
+                                                        &interesting_to_exit,
+            const std::map<uint32_t, IndexPathsByNode>
+                                                 &interesting_to_interesting,
+            bool safety_threshold,
+            ConcretePathSet &paths) const;
+
     PathsByNode breadth_first(const BlockMap &blocks, uintptr_t root,
                               BlockPredicate predicate,
                               bool terminate_on_match=false) const;
@@ -0,0 +1,44 @@
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+//! The number of strongly connected components up to which the full
+//! reachability matrix is kept (it needs `n * n` bits).
+#define REACHABILITY_MAX_COMPONENTS 16384
+
+/*!
+ * \brief Reachability index of a graph of basic blocks.
+ *
+ * The graph is condensed into its strongly connected components once. For
+ * each component one row of a bit matrix holds all components reachable
+ * from it, so queries are answered in constant time. Graphs with more than
+ * `REACHABILITY_MAX_COMPONENTS` components only keep the condensation (and
+ * conservatively report everything within the graph as reachable).
+ */
+class Reachability {
+private:
+    std::unordered_map<uintptr_t, uint32_t> _components;
+    uint32_t _num_components = 0;
+    size_t _row_words = 0;
+    std::vector<uint64_t> _matrix;
+    bool _has_matrix = false;
+
+public:
+    void build(const std::vector<uintptr_t> &addresses,
+               const std::vector<std::vector<uint32_t>> &successors);
+
+    bool is_reachable(uintptr_t source, uintptr_t destination) const;
+
+    /*!
+     * \brief Returns the number of strongly connected components.
+     */
+    uint32_t get_num_components() const {
+        return _num_components;
+    }
+};
+
+#endif // REACHABILITY_H
@@ -0,0 +1,118 @@
+#ifndef RESULT_STREAM_H
+#define RESULT_STREAM_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <cstdint>
+
+#define RESULT_STREAM_MAGIC "MARXRES\0"
+#define RESULT_STREAM_VERSION 1
+
+// A chunk is handed to the writer thread once it reaches this size.
+#define RESULT_STREAM_CHUNK_SIZE (1 << 20)
+
+// Producers block while this many chunks wait for the writer thread.
+#define RESULT_STREAM_MAX_PENDING_CHUNKS 8
+
+enum ResultStreamMode {
+    ResultStreamDisabled = 0,
+    ResultStreamBinary,
+    ResultStreamText,
+};
+
+enum ResultRecordType {
+    ResultRecordModule = 1,
+    ResultRecordVCall,
+    ResultRecordPossibleVCall,
+    ResultRecordObjectAllocation,
+};
+
+/*!
+ * \brief Class streaming the results into `{MODULE}.marx_results` while the
+ * analysis runs.
+ *
+ * In binary mode the file starts with the magic and version (each as 8 byte
+ * value) followed by records. Each record is a type byte followed by
+ * LEB128 encoded values:
+ *
+ *  - `ResultRecordModule`: module id, name length, name characters
+ *    (emitted the first time a module is referenced).
+ *  - `ResultRecordVCall`: icall address, vtable module id, vtable address,
+ *    entry index.
+ *  - `ResultRecordPossibleVCall`: icall address.
+ *  - `ResultRecordObjectAllocation`: vtable pointer init address,
+ *    vtable module id, vtable address, vtable xref address.
+ *
+ * In text mode one line per record is written into
+ * `{MODULE}.marx_results.txt` (`vcall <icall> <module>:<vtable> <entry>`,
+ * `possible_vcall <icall>`,
+ * `obj_alloc <init> <module>:<vtable> <xref>`).
+ *
+ * Records are appended to a chunk that is written by a dedicated writer
+ * thread. If the writer falls behind, producers block until it caught up,
+ * hence the memory is bounded by the chunk size times the number of
+ * pending chunks.
+ */
+class ResultStream {
+private:
+    const ResultStreamMode _mode;
+    std::ofstream _file;
+    std::string _file_name;
+
+    std::unordered_map<std::string, uint64_t> _module_ids;
+
+    std::string _chunk;
+    std::deque<std::string> _pending_chunks;
+    bool _stop = false;
+
+    std::thread _writer;
+    std::mutex _mtx;
+    std::condition_variable _cv_writer;
+    std::condition_variable _cv_producers;
+
+    void writer_main();
+
+    void append_value(uint64_t value);
+    void append_module(const std::string &module_name);
+    void append_record_end();
+
+public:
+    ResultStream(ResultStreamMode mode,
+                 const std::string &target_dir,
+                 const std::string &module_name);
+    ~ResultStream();
+
+    ResultStream(const ResultStream&) = delete;
+    void operator=(const ResultStream&) = delete;
+
+    bool is_enabled() const {
+        return _mode != ResultStreamDisabled;
+    }
+
+    void add_vcall(uint64_t icall_addr,
+                   const std::string &vtable_module,
+                   uint64_t vtable_addr,
+                   uint64_t entry_index);
+
+    void add_possible_vcall(uint64_t icall_addr);
+
+    void add_object_allocation(uint64_t vtable_init_addr,
+                               const std::string &vtable_module,
+                               uint64_t vtable_addr,
+                               uint64_t vtbl_xref_addr);
+
+    /*!
+     * \brief Writes all remaining records and closes the file.
+     *
+     * \return `false` if the file could not be written.
+     */
+    bool finish();
+};
+
+#endif // RESULT_STREAM_H
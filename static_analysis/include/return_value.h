@@ -88,6 +88,21 @@ public:
     void import_ext_return_values(const std::string &module_file);
 
 
+    /*!
+     * \brief Reads the return values of an external module without adding
+     * them (modules can be read concurrently).
+     * \see `import_ext_return_values`
+     */
+    void read_ext_return_values(const std::string &module_file,
+                                ExtReturnValues &ext_return_values) const;
+
+
+    /*!
+     * \brief Adds the return values read by `read_ext_return_values`.
+     */
+    void add_ext_return_values(ExtReturnValues &ext_return_values);
+
+
     /*!
      * \brief Returns a function return values object given by .plt address.
      * \return Returns a function return values object pointer
@@ -0,0 +1,79 @@
+#ifndef RING_QUEUE_H
+#define RING_QUEUE_H
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+/*!
+ * \brief FIFO queue that keeps its elements in one flat ring buffer.
+ *
+ * Offers the part of the `std::queue` interface the analyses use. The
+ * capacity is a power of two and doubled when the buffer is full (the
+ * elements are moved over in order), popped slots are reset so that they
+ * do not hold on to resources.
+ */
+template<typename T, typename Allocator=std::allocator<T>>
+class RingQueue {
+private:
+    std::vector<T, Allocator> _items;
+    size_t _head = 0;
+    size_t _size = 0;
+
+    size_t mask() const {
+        return _items.size() - 1;
+    }
+
+    void grow() {
+        const size_t capacity = _items.empty() ? 16 : 2 * _items.size();
+        std::vector<T, Allocator> items(_items.get_allocator());
+        items.reserve(capacity);
+        for(size_t i = 0; i < _size; i++) {
+            items.push_back(std::move(_items[(_head + i) & mask()]));
+        }
+        items.resize(capacity);
+        _items.swap(items);
+        _head = 0;
+    }
+
+public:
+    bool empty() const {
+        return _size == 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    T &front() {
+        return _items[_head];
+    }
+
+    const T &front() const {
+        return _items[_head];
+    }
+
+    void push(const T &value) {
+        if(_size == _items.size()) {
+            grow();
+        }
+        _items[(_head + _size) & mask()] = value;
+        _size++;
+    }
+
+    void push(T &&value) {
+        if(_size == _items.size()) {
+            grow();
+        }
+        _items[(_head + _size) & mask()] = std::move(value);
+        _size++;
+    }
+
+    void pop() {
+        _items[_head] = T();
+        _head = (_head + 1) & mask();
+        _size--;
+    }
+};
+
+#endif // RING_QUEUE_H
@@ -0,0 +1,135 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <vector>
+#include <new>
+#include <cstddef>
+
+#define SCRATCH_ARENA_CHUNK_SIZE (1 << 20)
+
+// Number of chunks kept for the next item (the others are freed when the
+// arena is reset, so one huge item does not pin its memory forever).
+#define SCRATCH_ARENA_RETAINED_CHUNKS 8
+
+/*!
+ * \brief Monotonic per-thread storage of the scratch data of one work item.
+ *
+ * Memory is handed out from large chunks and never freed individually. When
+ * the item finishes, the arena is reset at once and the chunks are reused by
+ * the next item of the thread, hence the small objects of an item do not
+ * fragment the heap shared by all workers. The arena is not thread-safe.
+ *
+ * \see `ScopedScratchArena`, `ScratchAllocator`
+ */
+class ScratchArena {
+private:
+    std::vector<char*> _chunks;
+    std::vector<char*> _large_allocations;
+    size_t _chunk_idx = 0;
+    char *_current = nullptr;
+    size_t _remaining = 0;
+    size_t _large_size = 0;
+
+public:
+    ScratchArena() = default;
+    ScratchArena(const ScratchArena&) = delete;
+    void operator=(const ScratchArena&) = delete;
+
+    ~ScratchArena();
+
+    void *allocate(size_t size, size_t alignment);
+    void reset();
+
+    /*!
+     * \brief Returns the number of bytes handed out since the last reset
+     * (including the unused tails of the chunks left behind).
+     */
+    size_t get_used_size() const;
+
+    /*!
+     * \brief Returns the largest number of bytes a single item used in any
+     * arena of the process (recorded when the arena is reset).
+     */
+    static size_t get_peak_item_size();
+
+    /*!
+     * \brief Returns the arena of the item analyzed by the calling thread
+     * (`nullptr` if the thread does not analyze an item).
+     */
+    static ScratchArena *current();
+
+    friend class ScopedScratchArena;
+};
+
+/*!
+ * \brief Activates the arena of the calling thread for one work item until
+ * the object is destroyed and resets it afterwards.
+ *
+ * All scratch objects of the item have to be destroyed before this object,
+ * thus it has to be created before them. Nested scopes use the arena of the
+ * outermost scope.
+ */
+class ScopedScratchArena {
+private:
+    bool _is_owner;
+
+public:
+    ScopedScratchArena();
+    ~ScopedScratchArena();
+
+    ScopedScratchArena(const ScopedScratchArena&) = delete;
+    void operator=(const ScopedScratchArena&) = delete;
+};
+
+/*!
+ * \brief Allocator of the containers holding scratch data.
+ *
+ * A container created while the calling thread analyzes an item allocates
+ * from the arena of the item (deallocation is a no-op), otherwise it uses
+ * the heap. Hence, such containers must not outlive the item they were
+ * created in.
+ */
+template<typename T>
+class ScratchAllocator {
+private:
+    ScratchArena *_arena;
+
+    template<typename U>
+    friend class ScratchAllocator;
+
+public:
+    typedef T value_type;
+
+    ScratchAllocator()
+        : _arena(ScratchArena::current()) {}
+
+    template<typename U>
+    ScratchAllocator(const ScratchAllocator<U> &other)
+        : _arena(other._arena) {}
+
+    T *allocate(size_t number) {
+        if(_arena) {
+            return static_cast<T*>(_arena->allocate(number * sizeof(T),
+                                                    alignof(T)));
+        }
+        return static_cast<T*>(::operator new(number * sizeof(T)));
+    }
+
+    void deallocate(T *pointer, size_t) {
+        if(!_arena) {
+            ::operator delete(pointer);
+        }
+    }
+
+    template<typename U>
+    bool operator==(const ScratchAllocator<U> &other) const {
+        return _arena == other._arena;
+    }
+
+    template<typename U>
+    bool operator!=(const ScratchAllocator<U> &other) const {
+        return _arena != other._arena;
+    }
+};
+
+#endif // SCRATCH_ARENA_H
@@ -2,10 +2,139 @@
 #define SERIALIZATION_H
 
 #include "expression.h"
+#include "state.h"
 #include "iostream"
 
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
 void serialize(ExpressionPtr exp, std::ostream &output);
 ExpressionPtr unserialize(std::istream &input);
 
 
+/*!
+ * \brief Serializes expressions into one stream and stores repeated
+ * sub-expressions only once.
+ *
+ * Each written (sub-)expression gets the next id. Sub-expressions equal to
+ * an already written one are replaced by a reference to its id, hence the
+ * stream can only be read (in the same order) by one
+ * `SharedExpressionReader`.
+ */
+class SharedExpressionWriter {
+private:
+    std::ostream &_output;
+    std::unordered_map<ExpressionPtr, uint32_t,
+                       std::hash<ExpressionPtr>,
+                       ExpressionPtrComparison> _ids;
+
+public:
+    SharedExpressionWriter(std::ostream &output)
+        : _output(output) {
+    }
+
+    void write(const ExpressionPtr &exp);
+};
+
+
+/*!
+ * \brief Reads expressions written by a `SharedExpressionWriter` (or by
+ * `serialize`) and rebuilds each shared sub-expression once.
+ */
+class SharedExpressionReader {
+private:
+    std::istream &_input;
+    std::vector<ExpressionPtr> _expressions;
+
+public:
+    SharedExpressionReader(std::istream &input)
+        : _input(input) {
+    }
+
+    ExpressionPtr read();
+};
+
+
+
+/*!
+ * \brief Encodes expressions (and whole `State`s) into one contiguous byte
+ * buffer.
+ *
+ * The layout is the one of `serialize` (in pre-order) except that symbolic
+ * values are stored by their `SymbolicKind` and payload. The trees are
+ * walked iteratively, hence arbitrarily deep expressions can be encoded.
+ */
+class ExpressionEncoder {
+private:
+    std::vector<uint8_t> _buffer;
+    std::vector<const Expression*> _stack;
+
+    template<typename T>
+    void put(const T &value) {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+        _buffer.insert(_buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+public:
+    void encode(const ExpressionPtr &exp);
+    void encode(const State &state);
+
+    const std::vector<uint8_t> &data() const {
+        return _buffer;
+    }
+
+    void clear() {
+        _buffer.clear();
+    }
+};
+
+
+/*!
+ * \brief Decodes expressions and `State`s from a buffer written by an
+ * `ExpressionEncoder` (the buffer has to outlive the decoder).
+ *
+ * Decoding is iterative as well and stops at the first malformed entry.
+ */
+class ExpressionDecoder {
+private:
+    const uint8_t *_data;
+    size_t _size;
+    size_t _offset = 0;
+
+    struct Frame {
+        ExpressionType type;
+        OperationType operation;
+        ExpressionPtr lhs;
+    };
+    std::vector<Frame> _frames;
+
+    template<typename T>
+    bool get(T &value) {
+        if(_size - _offset < sizeof(T)) {
+            return false;
+        }
+        memcpy(&value, _data + _offset, sizeof(T));
+        _offset += sizeof(T);
+        return true;
+    }
+
+public:
+    ExpressionDecoder(const uint8_t *data, size_t size)
+        : _data(data), _size(size) {
+    }
+
+    bool decode(ExpressionPtr &exp);
+    bool decode(State &state);
+
+    /*!
+     * \brief Returns `true` if the whole buffer was decoded.
+     */
+    bool at_end() const {
+        return _offset == _size;
+    }
+};
+
+
 #endif
@@ -8,18 +8,34 @@
 #include <sstream>
 #include <iostream>
 #include <string>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <unordered_map>
+
+class AnalysisCache;
+
+// Functions whose SSA data was not found yet, indexed by entry address.
+typedef std::unordered_map<uintptr_t, Function*> UnclaimedFunctions;
 
 class ModuleSSA {
 
 private:
 
-    const ssa::Function &get_ssa_function(const ssa::Functions &ssa_functions,
-                                          uintptr_t address);
+    // Optional cache the imported SSA data is additionally written to.
+    AnalysisCache *_cache = nullptr;
+
+    void import_part(const ssa::Functions &part,
+                     UnclaimedFunctions &unclaimed,
+                     uint32_t num_threads);
 
 public:
     ModuleSSA();
 
-    bool parse(const std::string &target_file, Translator &translator);
+    bool parse(const std::string &target_file,
+               Translator &translator,
+               uint32_t num_threads=1,
+               AnalysisCache *cache=nullptr);
 
 };
 
@@ -35,7 +35,12 @@ private:
 
 public:
 
-    BlockSSA(const ssa::BasicBlock &basic_block);
+    /*!
+     * \brief Imports the given basic block. Its operands are shared with
+     * the equal operands of the given table (if any).
+     */
+    BlockSSA(const ssa::BasicBlock &basic_block,
+             OperandSSATable *operand_table=nullptr);
 
     /*!
      * \brief get_address
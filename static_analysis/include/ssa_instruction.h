@@ -4,6 +4,7 @@
 #include "ssa_export.pb.h"
 #include "ssa_operand.h"
 #include <string>
+#include <stdexcept>
 #include <unordered_set>
 
 enum InstructionTypeSSA {
@@ -14,7 +15,11 @@ enum InstructionTypeSSA {
     SSAInstrTypeCallOfRet, // Special type for backtrace analysis.
 };
 
+// Id of instructions that are not part of a `Function`.
+#define INSTRUCTION_SSA_NO_ID 0xffffffff
+
 class BaseInstructionSSA;
+class Function;
 
 //! A shared pointer used to hold an `BaseInstructionSSA`.
 typedef std::shared_ptr<BaseInstructionSSA> BaseInstructionSSAPtr;
@@ -34,6 +39,49 @@ typedef std::unordered_set<OperandSSAPtr,
 
 std::ostream &operator<<(std::ostream &stream, const BaseInstructionSSA &op);
 
+/*!
+ * \brief Read-only view of consecutive operand ptrs (used for the
+ * definitions and uses of an instruction, which share one array).
+ */
+class OperandSSASpan {
+private:
+    const OperandSSAPtr *_begin;
+    const OperandSSAPtr *_end;
+
+public:
+    OperandSSASpan(const OperandSSAPtr *begin, const OperandSSAPtr *end)
+        : _begin(begin),
+          _end(end) {
+    }
+
+    const OperandSSAPtr *begin() const {
+        return _begin;
+    }
+
+    const OperandSSAPtr *end() const {
+        return _end;
+    }
+
+    size_t size() const {
+        return _end - _begin;
+    }
+
+    bool empty() const {
+        return _begin == _end;
+    }
+
+    const OperandSSAPtr &operator[](size_t idx) const {
+        return _begin[idx];
+    }
+
+    const OperandSSAPtr &at(size_t idx) const {
+        if(idx >= size()) {
+            throw std::out_of_range("Operand index out of range.");
+        }
+        return _begin[idx];
+    }
+};
+
 /*!
  * \brief BaseInstructionSSA objects are meant to be immutable and therefore
  * do not offer an interface to change any values.
@@ -41,11 +89,18 @@ std::ostream &operator<<(std::ostream &stream, const BaseInstructionSSA &op);
 class BaseInstructionSSA {
 
 private:
-    const std::string _mnemonic;
+    // Interned, hence equal mnemonics have the same address.
+    const std::string *_mnemonic;
     uint64_t _address;
     OperandSSAPtrs _operands;
-    OperandSSAPtrs _definitions;
-    OperandSSAPtrs _uses;
+
+    // The definitions followed by the uses.
+    OperandSSAPtrs _def_uses;
+    uint32_t _num_definitions = 0;
+
+    // Position in the function that holds the instruction (not part of the
+    // value, not copied).
+    mutable uint32_t _function_id = INSTRUCTION_SSA_NO_ID;
 
     /*!
      * \brief Adds the operand ptr to the use and/or definitions (is called
@@ -62,8 +117,26 @@ protected:
 
     /*!
      * \brief Adds the SSA operand to the operands of the instruction.
+     *
+     * If an operand table is given, the operand is shared with the equal
+     * operands of the table.
+     */
+    void add_operand(const ssa::Operand &operand,
+                     OperandSSATable *operand_table);
+
+    /*!
+     * \brief Adds all SSA operands of the imported instruction.
      */
-    void add_operand(const ssa::Operand &operand);
+    template<typename T>
+    void add_all_operands(const T &instruction,
+                          OperandSSATable *operand_table) {
+        _operands.reserve(instruction.operands_size());
+        for(int i = 0; i < instruction.operands_size(); i++) {
+            add_operand(instruction.operands(i), operand_table);
+        }
+        _operands.shrink_to_fit();
+        _def_uses.shrink_to_fit();
+    }
 
 public:
     BaseInstructionSSA() = delete;
@@ -83,6 +156,12 @@ public:
      */
     const std::string &get_mnemonic() const;
 
+    /*!
+     * \brief Returns the interned mnemonic (stays valid for the lifetime of
+     * the program).
+     */
+    static const std::string *intern_mnemonic(const std::string &mnemonic);
+
     /*!
      * \brief get_type
      * \return Returns the instruction's type.
@@ -107,14 +186,14 @@ public:
      * \return Returns a reference to the instruction's operands that
      * are definitions.
      */
-    const OperandSSAPtrs &get_definitions() const;
+    OperandSSASpan get_definitions() const;
 
     /*!
      * \brief get_uses
      * \return Returns a reference to the instruction's operands that
      * are uses.
      */
-    const OperandSSAPtrs &get_uses() const;
+    OperandSSASpan get_uses() const;
 
     virtual bool is_instruction() const;
 
@@ -127,6 +206,8 @@ public:
     virtual bool is_unconditional_jmp() const;
 
     virtual bool is_ret() const;
+
+    friend class Function;
 };
 
 class InstructionSSA : public BaseInstructionSSA {
@@ -137,7 +218,8 @@ private:
 
 public:
     InstructionSSA() = delete;
-    InstructionSSA(const ssa::BaseInstruction &instruction);
+    InstructionSSA(const ssa::BaseInstruction &instruction,
+                   OperandSSATable *operand_table=nullptr);
     InstructionSSA(const InstructionSSA &obj);
 
     virtual bool is_instruction() const;
@@ -152,7 +234,8 @@ public:
 class PhiNodeSSA : public BaseInstructionSSA {
 public:
     PhiNodeSSA() = delete;
-    PhiNodeSSA(const ssa::PhiNode &phi_node);
+    PhiNodeSSA(const ssa::PhiNode &phi_node,
+               OperandSSATable *operand_table=nullptr);
     PhiNodeSSA(const PhiNodeSSA &obj);
 
     virtual bool is_phinode() const;
@@ -161,7 +244,8 @@ public:
 class CallingConventionSSA : public BaseInstructionSSA {
 public:
     CallingConventionSSA() = delete;
-    CallingConventionSSA(const ssa::CallingConvention &calling_convention);
+    CallingConventionSSA(const ssa::CallingConvention &calling_convention,
+                         OperandSSATable *operand_table=nullptr);
     CallingConventionSSA(const CallingConventionSSA &obj);
 
     virtual bool is_callingconvention() const;
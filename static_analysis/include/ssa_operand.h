@@ -3,6 +3,7 @@
 
 #include <ostream>
 #include <algorithm>
+#include <unordered_set>
 #include "expression.h" // Needed for std::hash_combine()
 #include "ssa_export.pb.h"
 #include "amd64_ssa.h"
@@ -21,7 +22,11 @@ enum OperandTypeSSA {
     SSAOpTypeMemoryX64,
 };
 
+// Id of operands that are not part of an `OperandSSATable`.
+#define OPERAND_SSA_NO_ID 0xffffffff
+
 class OperandSSA;
+class OperandSSATable;
 
 //! A shared pointer used to hold an `OperandSSA`.
 typedef std::shared_ptr<const OperandSSA> OperandSSAPtr;
@@ -34,6 +39,10 @@ std::ostream &operator<<(std::ostream &stream, const OperandSSA &op);
  */
 class OperandSSA {
 
+private:
+    // Position in the table that holds the operand (not part of the value).
+    mutable uint32_t _table_id = OPERAND_SSA_NO_ID;
+
 protected:
     OperandTypeSSA _type;
     OperandAccessTypeSSA _access_type;
@@ -109,6 +118,7 @@ public:
      */
     virtual bool contains(const OperandSSA &other) const = 0;
 
+    friend class OperandSSATable;
 };
 
 struct SSAPtrDeref {
@@ -134,6 +144,78 @@ struct SSAPtrDeref {
 };
 
 
+/*!
+ * \brief Table of the SSA operands of one function.
+ *
+ * Equal operands (with the same access type) of the instructions of a
+ * function share one object, hence an operand (e.g., a register with its
+ * phi index) is only stored once regardless of how often it is used.
+ */
+class OperandSSATable {
+private:
+    struct Hash {
+        size_t operator() (const OperandSSAPtr &op) const {
+            size_t h = op->hash();
+            std::hash_combine(h, op->get_access_type());
+            return h;
+        }
+    };
+    struct Compare {
+        bool operator() (const OperandSSAPtr &a,
+                         const OperandSSAPtr &b) const {
+            return a->get_access_type() == b->get_access_type() && *a == *b;
+        }
+    };
+
+    typedef std::unordered_set<OperandSSAPtr, Hash, Compare> OperandSet;
+
+    OperandSet _operands;
+
+    // Operands by their (dense) ids.
+    std::vector<const OperandSSA*> _ids;
+
+public:
+    typedef OperandSet::const_iterator const_iterator;
+
+    /*!
+     * \brief Returns the operand of the table that is equal to the given
+     * operand (adds the given operand if it is not known yet).
+     */
+    const OperandSSAPtr &intern(const OperandSSAPtr &op);
+
+    /*!
+     * \brief Returns the id of the given operand object (ids are dense and
+     * assigned in the order the operands are added).
+     * \return Returns `OPERAND_SSA_NO_ID` if the object itself is not part
+     * of this table (even if an equal operand is).
+     */
+    uint32_t get_id(const OperandSSA &op) const {
+        const uint32_t id = op._table_id;
+        if(id < _ids.size() && _ids[id] == &op) {
+            return id;
+        }
+        return OPERAND_SSA_NO_ID;
+    }
+
+    size_t size() const {
+        return _ids.size();
+    }
+
+    /*!
+     * \brief Estimates the heap bytes of the table and its operands.
+     */
+    size_t get_memory_footprint() const;
+
+    const_iterator begin() const {
+        return _operands.cbegin();
+    }
+
+    const_iterator end() const {
+        return _operands.cend();
+    }
+};
+
+
 class RegisterX64SSA : public OperandSSA {
 
 private:
@@ -3,6 +3,7 @@
 
 #include "expression.h"
 #include "amd64.h"
+#include "abi.h"
 #include "memory.h"
 
 #include <map>
@@ -37,6 +38,25 @@ using Expressions = std::vector<std::pair<ExpressionPtr, ExpressionPtr>>;
 using kill_results = std::unordered_set<ExpressionPtr, std::hash<ExpressionPtr>,
         ExpressionPtrComparison>;
 
+/*!
+ * \brief Reverse index from (the canonical hash of) sub-expressions to the
+ * bindings whose value contains them. \see `State::kill`
+ */
+using DependencyIndex = std::unordered_map<size_t,
+        std::vector<InternalState::iterator>>;
+
+/*!
+ * \brief Enumerates how `State::optimize` checks bindings for
+ * self-references.
+ */
+enum StateBackend {
+    //! Walks the expression trees (`Expression::contains`).
+    StateBackendTree = 0,
+
+    //! Scans flattened expressions. \see `FlatExpression`
+    StateBackendFlat,
+};
+
 /*!
  * \brief Class that represents a CPU state.
  *
@@ -50,12 +70,18 @@ using kill_results = std::unordered_set<ExpressionPtr, std::hash<ExpressionPtr>,
  * said destination. An assignment of the form `key -> value` is commonly called
  * a _binding_ (binding the value to the key expression).
  *
+ * The bindings are copy-on-write: copying a state only shares them with the
+ * copy, the first modification of either state copies them. Hence, mutable
+ * iterators (as returned by the non-const `find`) must not be used after the
+ * state was copied.
+ *
  * \see `InternalState`
  */
 class State {
 private:
     static InitialValues _initial_values;
-    InternalState _state;
+    static StateBackend _backend;
+    std::shared_ptr<InternalState> _state;
 
     std::shared_ptr<Unknown> _unknown;
 
@@ -66,6 +92,8 @@ public:
     State(bool initialize=true);
     State(const State&) = default;
 
+    State clone() const;
+
     /*!
      * \brief Static function that returns the initial register assignment.
      * \return Returns a (read-only) map, with keys being register offsets and
@@ -77,16 +105,31 @@ public:
         return _initial_values;
     }
 
+    /*!
+     * \brief Selects the backend used by all states (has to be set before
+     * any state is optimized).
+     */
+    static void set_backend(StateBackend backend) {
+        _backend = backend;
+    }
+
     void set_initial_state();
-    void purge_scratch_registers(FileFormatType file_format);
+    void purge_scratch_registers(const Abi &abi);
 
     void merge(const State &other);
     void optimize(bool do_purge_unchanged=false);
 
     const Expressions get_memory_accesses() const;
 
+    const_iterator begin() const {
+        return _state->cbegin();
+    }
+
+    const_iterator end() const {
+        return _state->cend();
+    }
+
     friend std::ostream &operator<<(std::ostream &stream, const State &state);
-    static const std::string format_return_value(uintptr_t address);
 
     InternalState::iterator erase(const InternalState::iterator &iterator);
     size_t erase(const InternalState::key_type &key);
@@ -100,7 +143,7 @@ public:
                 const InternalState::mapped_type &value);
 
 private:
-    static const std::string format_initial_value(size_t offset);
+    InternalState &mutable_bindings();
 
     bool optimizer(bool do_purge_unchanged=false);
     void optimize_entries();
@@ -110,9 +153,15 @@ private:
     bool purge_unchanged();
     bool purge_uninteresting();
 
-    kill_results kill_helper(const ExpressionPtr &key,
-                             const ExpressionPtr &value);
-    void kill(const ExpressionPtr &key, const ExpressionPtr &value);
+    void build_dependency_index(DependencyIndex &index);
+
+    void kill_self_references(DependencyIndex &index);
+    void kill_self_references_flat(DependencyIndex &index);
+
+    kill_results kill_helper(const ExpressionPtr &expression,
+                             DependencyIndex &index);
+    void kill(const ExpressionPtr &key, const ExpressionPtr &value,
+              DependencyIndex &index);
 };
 
 #endif // STATE_H
@@ -0,0 +1,114 @@
+#ifndef SUMMARY_STORE_H
+#define SUMMARY_STORE_H
+
+#include "function.h"
+#include "vtable_file.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#define SUMMARY_STORE_VERSION 1
+
+// File extension of a summary in the store directory.
+#define SUMMARY_STORE_EXTENSION ".marx_summary"
+
+enum SummaryKind {
+    SummaryKindObjectAllocations = 1,
+};
+
+/*!
+ * \brief Vtable pointer init instruction found by the object allocation
+ * analysis, relative to the entry of its function.
+ */
+struct SummaryObjectAllocation {
+    uint64_t init_offset;
+    uint64_t xref_offset;
+
+    // Position of the vtable in the vtables referenced by the function
+    // (ordered by address). \see `SummaryStore::compute_key`
+    uint32_t vtable_pos;
+};
+
+typedef std::vector<SummaryObjectAllocation> SummaryObjectAllocations;
+
+
+/*!
+ * \brief Class handling a directory of per-function analysis summaries that
+ * is shared by the analyses of different modules.
+ *
+ * Statically linked code appears byte-identical (up to relocations) in
+ * several modules. Summaries are therefore addressed by a hash of the SSA
+ * data of the function in which all addresses are normalized: targets
+ * inside of the function become offsets to its entry, addresses near a
+ * vtable the function references become the position of the vtable and
+ * the offset to it, and all other addresses are ignored. Hence the same
+ * function in another module (or at another address) maps to the same
+ * summary.
+ *
+ * Each summary is stored as companion file
+ * `{STORE_DIR}/{KEY}.marx_summary` (the key is the source hash of the
+ * file). Summaries are only ever added, a summary with the same key has
+ * the same content.
+ *
+ * Only the object allocation findings are summarized: they are the only
+ * per-function results that do not depend on the rest of the module.
+ */
+class SummaryStore {
+private:
+    const std::string _store_dir;
+    const uint32_t _addr_size;
+
+    std::atomic<uint64_t> _num_hits{0};
+    std::atomic<uint64_t> _num_misses{0};
+
+    std::string get_summary_file(uint64_t key) const;
+
+public:
+    SummaryStore(const std::string &store_dir, uint32_t addr_size);
+
+    SummaryStore(const SummaryStore&) = delete;
+    void operator=(const SummaryStore&) = delete;
+
+    /*!
+     * \brief Computes the relocation normalized key of the given function.
+     *
+     * \param vtables The vtables referenced by the function (ordered by
+     * address). Addresses near one of them are normalized relative to it.
+     * \param xrefs The analyzed vtable xrefs in the function together with
+     * the positions of the vtables they reference.
+     */
+    uint64_t compute_key(
+                SummaryKind kind,
+                const Function &func,
+                const std::vector<const VTable*> &vtables,
+                const std::vector<std::pair<uint64_t,
+                                            std::vector<uint32_t>>> &xrefs) const;
+
+    /*!
+     * \brief Reads the object allocation summary with the given key.
+     *
+     * \return `false` if the store does not contain it.
+     */
+    bool get_object_allocations(uint64_t key,
+                                SummaryObjectAllocations &obj_allocs);
+
+    /*!
+     * \brief Adds the object allocation summary with the given key.
+     *
+     * \return `false` if the summary can not be written.
+     */
+    bool add_object_allocations(uint64_t key,
+                                const SummaryObjectAllocations &obj_allocs);
+
+    uint64_t get_num_hits() const {
+        return _num_hits;
+    }
+
+    uint64_t get_num_misses() const {
+        return _num_misses;
+    }
+};
+
+#endif // SUMMARY_STORE_H
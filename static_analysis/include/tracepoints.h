@@ -0,0 +1,46 @@
+#ifndef TRACEPOINTS_H
+#define TRACEPOINTS_H
+
+/*
+ * Static tracepoints (USDT probes of the provider "marx") on the hot paths
+ * of the analysis. A probe is a single nop until a tracer attaches to it,
+ * hence they stay compiled in. They are available if <sys/sdt.h>
+ * (systemtap-sdt-dev) was found by cmake, otherwise the macros are empty.
+ *
+ * Probes (arguments in order):
+ *
+ * - item__begin / item__end: type (`InstrumentationItemType`), address
+ *   (item__end additionally: graph size)
+ * - phase__begin / phase__end: phase name
+ * - vex__translate: guest address, instruction count
+ * - sym__execute__begin / sym__execute__end: number of blocks
+ * - dataflow__paths__begin / dataflow__paths__end: source node, number of
+ *   destination nodes
+ * - state__kill: number of bindings of the state
+ * - hierarchy__merge__begin / hierarchy__merge__end: number of vtables
+ *   (end: number of hierarchies)
+ *
+ * Probes inside of a work item do not repeat its address, attribute them
+ * by thread to the enclosing item__begin/item__end pair, for example:
+ *
+ *   bpftrace -e 'usdt:./marx:marx:item__begin { @addr[tid] = arg1; }
+ *                usdt:./marx:marx:vex__translate { @[@addr[tid]] = count(); }'
+ */
+
+#if defined(MARX_TRACEPOINTS) && MARX_TRACEPOINTS
+
+#include <sys/sdt.h>
+
+#define MARX_TRACE1(name, a1) DTRACE_PROBE1(marx, name, a1)
+#define MARX_TRACE2(name, a1, a2) DTRACE_PROBE2(marx, name, a1, a2)
+#define MARX_TRACE3(name, a1, a2, a3) DTRACE_PROBE3(marx, name, a1, a2, a3)
+
+#else
+
+#define MARX_TRACE1(name, a1) do {} while(0)
+#define MARX_TRACE2(name, a1, a2) do {} while(0)
+#define MARX_TRACE3(name, a1, a2, a3) do {} while(0)
+
+#endif
+
+#endif // TRACEPOINTS_H
@@ -4,8 +4,10 @@
 #include <set>
 #include <map>
 #include <mutex>
+#include <atomic>
 #include <thread>
 #include <string>
+#include <vector>
 #include <cstddef>
 
 #include "vex.h"
@@ -19,6 +21,20 @@ extern "C" {
 #include <valgrind/libvex.h>
 }
 
+/*!
+ * \brief Address range covered by one block of a function.
+ */
+struct FunctionInterval {
+    uint64_t start;
+    uint64_t end;
+
+    // Maximum `end` of all intervals up to (and including) this one.
+    uint64_t max_end;
+
+    const Function *function;
+};
+
+typedef std::vector<FunctionInterval> FunctionIntervals;
 
 /*!
  * \brief Class responsible for translating functions into VEX blocks.
@@ -27,6 +43,12 @@ extern "C" {
  * script and information about non-returning functions and uses both to
  * generate `Function` instances. Basic blocks are mapped to VEX basic
  * blocks of type IRSB.
+ *
+ * In the on-demand mode, all `Function` objects are created upfront (so the
+ * SSA data and xrefs can be imported as usual), but their VEX blocks are only
+ * lifted when they are accessed first. Lifting is done once per function and
+ * is thread-safe, hence only the functions that are actually needed by the
+ * analysis are lifted.
  */
 class Translator {
 private:
@@ -39,20 +61,37 @@ private:
     const Memory *_memory;
 
     std::set<uintptr_t> _seen_blocks;
-    std::map<uintptr_t, const IRSB*> _blocks;
+
+    /*!
+     * \brief A block translated ahead by `parse_known_functions()`.
+     */
+    struct PretranslatedBlock {
+        IRSB *block;
+        uintptr_t end;
+    };
+
+    // Keyed by the start address and instruction count of the block.
+    typedef std::map<std::pair<uintptr_t, uintptr_t>, PretranslatedBlock>
+                                                            PretranslatedBlocks;
+    PretranslatedBlocks _pretranslated_blocks;
 
     std::map<uintptr_t, Function> _functions;
 
+    // Sorted by start address, built by `finalize()`.
+    FunctionIntervals _function_intervals;
+
     FileFormatType _file_format;
 
     mutable std::mutex _mutex;
 
-    bool _is_finalized;
+    // Set once by `finalize()`, afterwards all data is read-only and
+    // the accessors do not lock anymore.
+    std::atomic<bool> _is_finalized{false};
 
 public:
 
     Translator(Vex &vex, const std::string &file, FileFormatType file_format,
-               bool parse_on_demand=true);
+               bool parse_on_demand=true, uint32_t num_threads=1);
 
     const Function &cget_function(const uintptr_t address) const;
     const Function &get_function(const uintptr_t address);
@@ -64,6 +103,9 @@ public:
      * object as value.
      */
     const std::map<uintptr_t, Function> &get_functions() const {
+        if(is_finalized()) {
+            return _functions;
+        }
         std::lock_guard<std::mutex> _(_mutex);
 
         return _functions;
@@ -78,10 +120,10 @@ public:
      * \return A reference of type `Memory`.
      */
     const Memory &get_memory() const {
-        std::lock_guard<std::mutex> _(_mutex);
 
         // Since memory is only once initialized in the constructor and
-        // otherwise never changed, we assume that the pointer is always set.
+        // otherwise never changed, we assume that the pointer is always set
+        // (hence no lock is needed).
         return *_memory;
     }
 
@@ -98,8 +140,27 @@ public:
 
     /*!
      * \brief Finalizes `Translator` object in order to make it read-only.
+     *
+     * This also builds the return summaries of all functions on up to
+     * `num_threads` threads. \see `FunctionReturnSummary`
+     *
+     * Afterwards, no function is translated on demand anymore and all
+     * lookups are lock-free (the object can be shared by all worker
+     * threads without contention).
+     */
+    void finalize(uint32_t num_threads=1);
+
+    /*!
+     * \brief Returns if the `Translator` object is finalized (read-only).
+     */
+    bool is_finalized() const {
+        return _is_finalized.load(std::memory_order_acquire);
+    }
+
+    /*!
+     * \brief Estimates the heap bytes of all functions and their blocks.
      */
-    void finalize();
+    size_t get_memory_footprint() const;
 
     /*!
      * \brief Returns the function that contains the given address.
@@ -123,12 +184,19 @@ public:
     void add_function_vfunc_xref(uint64_t fct_addr, uint64_t xref_addr);
 
 private:
-    bool process_block(Function &function, const BlockDescriptor &block);
+    bool process_block(Function &function,
+                       const BlockDescriptor &block,
+                       std::set<uintptr_t> &seen_blocks);
     void finalize_block(Function &function, const BlockDescriptor &block,
                         IRSB *block_pointer);
 
-    void parse_known_functions();
+    void parse_known_functions(uint32_t num_threads);
+    void prepare_known_functions();
+    void pretranslate_block(const BlockDescriptor &block,
+                            PretranslatedBlocks &out_blocks) const;
     void detect_tail_jumps(Function &function);
+    void build_return_summary(Function &function) const;
+    const Function *find_containing_function(uint64_t addr) const;
 
     Function *maybe_translate_function(const uintptr_t address);
     Function *translate_function(const std::pair<uintptr_t, FunctionBlocks>&);
@@ -144,6 +212,7 @@ private:
 
     friend class ModuleSSA;
     friend class ModuleFunctionXrefs;
+    friend class AnalysisCache;
 };
 
 #endif // TRANSLATOR_H
@@ -12,6 +12,8 @@
 #include "vcall_types.h"
 #include "vtable_hierarchy.h"
 #include "vtable_file.h"
+#include "vtable_set.h"
+#include "result_stream.h"
 
 class VCallFile {
 private:
@@ -24,6 +26,8 @@ private:
     const VTableHierarchies &_vtable_hierarchies;
     const VTableFile &_vtable_file;
 
+    ResultStream *_result_stream = nullptr;
+
     mutable std::mutex _mtx;
 
 private:
@@ -31,6 +35,19 @@ private:
                       uint32_t vtbl_idx,
                       size_t entry_index);
 
+    void export_address_list(const std::string &target_file,
+                             std::vector<uint64_t> &addresses) const;
+
+    std::unordered_set<uint32_t> get_allowed_vtables(const VCall &vcall) const;
+
+    bool export_sets(const std::string &target_file,
+                     const VTableSetStore &set_store,
+                     const std::vector<VTableSetId> &vcall_sets) const;
+
+    bool export_policy(const std::string &target_file,
+                       const VTableSetStore &set_store,
+                       const std::vector<VTableSetId> &vcall_sets) const;
+
 public:
 
     VCallFile(const std::string &module_name,
@@ -43,6 +60,13 @@ public:
      */
     const VCalls &get_vcalls() const;
 
+    /*!
+     * \brief Streams each new vcall result (vtable and entry index as found,
+     * without the vtables of its hierarchy) and each new possible vcall
+     * into the given stream.
+     */
+    void set_result_stream(ResultStream *result_stream);
+
     /*!
      * \brief Returns the information about the virtual callsite given
      * by address.
@@ -59,7 +83,21 @@ public:
 
     const PossibleVCalls &get_possible_vcall() const;
 
-    void export_vcalls(const std::string &target_dir);
+    /*!
+     * \brief Exports the vcalls and possible vcalls (and the vtables of this
+     * module) into the target directory, both as text files and as binary
+     * address list files. \see `address_list_file.h`
+     *
+     * The allowed vtables of the vcalls are interned (\see `VTableSetStore`)
+     * and additionally exported as ranges over the vtables in hierarchy
+     * order (`.vcalls_sets`) and compiled into a policy for runtime checks.
+     * \see `vcall_policy_file.h`
+     *
+     * The files are written concurrently, the text files are formatted by
+     * the given number of threads (the output does not depend on it).
+     */
+    void export_vcalls(const std::string &target_dir,
+                       uint32_t num_threads=1);
 
     bool is_known_vcall(uint64_t icall_addr) const;
 };
@@ -0,0 +1,209 @@
+#ifndef VCALL_POLICY_FILE_H
+#define VCALL_POLICY_FILE_H
+
+// NOTE: This header is shared with the enforcement layer (which does not
+// link against marx), hence everything is inline and it only depends on the
+// standard library.
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#define VCALL_POLICY_FILE_MAGIC "MARXVPOL"
+#define VCALL_POLICY_FILE_VERSION 1
+
+// File extension of the compiled policy of a module.
+#define VCALL_POLICY_FILE_EXTENSION ".vcalls_policy"
+
+#define VCALL_POLICY_CACHE_LINE 64
+#define VCALL_POLICY_EMPTY_BUCKET 0xffffffffffffffff
+
+// A vtable is identified by the index of its module in the module table
+// (upper 16 bits) and its address inside the module (lower 48 bits).
+#define VCALL_POLICY_MODULE_SHIFT 48
+#define VCALL_POLICY_ADDR_MASK 0x0000ffffffffffff
+
+/*!
+ * \brief Header at the beginning of a compiled vcall policy file.
+ *
+ * Layout (all offsets from the start of the file, each part aligned to a
+ * cache line so the file can be used directly from a mapping):
+ *
+ * - the header,
+ * - the module table: `num_modules` zero-terminated module names
+ *   (the first one is the analyzed module),
+ * - `1 << bucket_bits` buckets (\see `VCallPolicyBucket`) of an open
+ *   addressing hash table over the callsite addresses (linear probing, load
+ *   factor at most 1/2, hence most lookups touch a single cache line),
+ * - the pool of allowed vtable sets: `num_set_entries` keys (\see
+ *   `vcall_policy_key`) sorted in ascending order per set. Callsites with the
+ *   same set share it, and sets that fit into a cache line do not cross one.
+ */
+struct VCallPolicyHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bucket_bits;
+    uint32_t num_modules;
+    uint32_t num_callsites;
+    uint64_t modules_offset;
+    uint64_t buckets_offset;
+    uint64_t sets_offset;
+    uint64_t num_set_entries;
+};
+
+/*!
+ * \brief Bucket of the callsite hash table (four buckets per cache line).
+ */
+struct VCallPolicyBucket {
+    uint64_t icall_addr;
+    uint32_t set_offset;
+    uint32_t set_size;
+};
+
+inline uint64_t vcall_policy_key(uint32_t module_idx, uint64_t vtbl_addr) {
+    return (static_cast<uint64_t>(module_idx) << VCALL_POLICY_MODULE_SHIFT)
+           | (vtbl_addr & VCALL_POLICY_ADDR_MASK);
+}
+
+inline uint64_t vcall_policy_bucket(uint64_t icall_addr,
+                                    uint32_t bucket_bits) {
+    if(bucket_bits == 0) {
+        return 0;
+    }
+    return (icall_addr * 0x9e3779b97f4a7c15ULL) >> (64 - bucket_bits);
+}
+
+inline size_t vcall_policy_align(size_t offset) {
+    return (offset + VCALL_POLICY_CACHE_LINE - 1)
+           & ~static_cast<size_t>(VCALL_POLICY_CACHE_LINE - 1);
+}
+
+/*!
+ * \brief View on a compiled vcall policy (parsed in place).
+ */
+struct VCallPolicy {
+    std::vector<std::string> module_names;
+    uint32_t bucket_bits = 0;
+    const VCallPolicyBucket *buckets = nullptr;
+    const uint64_t *set_entries = nullptr;
+
+    /*!
+     * \brief Returns the allowed vtable set of the given callsite.
+     *
+     * \return `false` if the callsite is not part of the policy.
+     */
+    bool get_allowed(uint64_t icall_addr,
+                     const uint64_t *&keys,
+                     uint32_t &count) const {
+        if(buckets == nullptr) {
+            return false;
+        }
+        const uint64_t mask = (static_cast<uint64_t>(1) << bucket_bits) - 1;
+        for(uint64_t i = vcall_policy_bucket(icall_addr, bucket_bits);;
+            i = (i + 1) & mask) {
+            const VCallPolicyBucket &bucket = buckets[i];
+            if(bucket.icall_addr == icall_addr) {
+                keys = set_entries + bucket.set_offset;
+                count = bucket.set_size;
+                return true;
+            }
+            if(bucket.icall_addr == VCALL_POLICY_EMPTY_BUCKET) {
+                return false;
+            }
+        }
+    }
+
+    /*!
+     * \brief Checks if the given vtable is allowed at the given callsite.
+     *
+     * \param module_idx Index of the module of the vtable in
+     * `module_names`.
+     */
+    bool is_allowed(uint64_t icall_addr,
+                    uint32_t module_idx,
+                    uint64_t vtbl_addr) const {
+        const uint64_t *keys;
+        uint32_t count;
+        if(!get_allowed(icall_addr, keys, count)) {
+            return false;
+        }
+        const uint64_t key = vcall_policy_key(module_idx, vtbl_addr);
+
+        // Binary search (sets are small, the first probes usually stay in
+        // the same cache line).
+        uint32_t low = 0;
+        uint32_t high = count;
+        while(low < high) {
+            const uint32_t mid = low + (high - low) / 2;
+            if(keys[mid] < key) {
+                low = mid + 1;
+            }
+            else {
+                high = mid;
+            }
+        }
+        return low < count && keys[low] == key;
+    }
+};
+
+/*!
+ * \brief Parses the compiled vcall policy given by its (mapped) content in
+ * place.
+ *
+ * \return `false` if the data is no valid vcall policy file.
+ */
+inline bool parse_vcall_policy(const uint8_t *data,
+                               size_t size,
+                               VCallPolicy &policy) {
+
+    if(size < sizeof(VCallPolicyHeader)
+       || memcmp(data, VCALL_POLICY_FILE_MAGIC, 8) != 0) {
+        return false;
+    }
+
+    VCallPolicyHeader header;
+    memcpy(&header, data, sizeof(header));
+    if(header.version != VCALL_POLICY_FILE_VERSION
+       || header.bucket_bits >= 32) {
+        return false;
+    }
+    const uint64_t num_buckets = static_cast<uint64_t>(1)
+                                 << header.bucket_bits;
+    if(header.modules_offset > header.buckets_offset
+       || header.buckets_offset > size
+       || (size - header.buckets_offset) / sizeof(VCallPolicyBucket)
+          < num_buckets
+       || header.sets_offset < header.buckets_offset
+                               + num_buckets * sizeof(VCallPolicyBucket)
+       || header.sets_offset > size
+       || (size - header.sets_offset) / sizeof(uint64_t)
+          < header.num_set_entries) {
+        return false;
+    }
+
+    policy.module_names.clear();
+    const char *name = reinterpret_cast<const char*>(data
+                                                     + header.modules_offset);
+    const char *names_end = reinterpret_cast<const char*>(data
+                                                     + header.buckets_offset);
+    for(uint32_t i = 0; i < header.num_modules; i++) {
+        const char *end = static_cast<const char*>(
+                                  memchr(name, 0, names_end - name));
+        if(end == nullptr) {
+            return false;
+        }
+        policy.module_names.emplace_back(name, end);
+        name = end + 1;
+    }
+
+    policy.bucket_bits = header.bucket_bits;
+    policy.buckets = reinterpret_cast<const VCallPolicyBucket*>(
+                                                data + header.buckets_offset);
+    policy.set_entries = reinterpret_cast<const uint64_t*>(
+                                                data + header.sets_offset);
+    return true;
+}
+
+#endif // VCALL_POLICY_FILE_H
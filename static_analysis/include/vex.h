@@ -1,6 +1,8 @@
 #ifndef VEX_H
 #define VEX_H
 
+#include "ir_arena.h"
+
 extern "C" {
 #include <valgrind/libvex.h>
 #include <valgrind/libvex_ir.h>
@@ -10,15 +12,32 @@ extern "C" {
 #include <string>
 #include <cstdint>
 #include <mutex>
-
-extern std::mutex vex_mutex;
+#include <unordered_map>
 
 enum CONFIGURATION : size_t {
-    MAX_INSTRUCTIONS = 100
+    MAX_INSTRUCTIONS = 100,
+    MAX_INSTRUCTION_LENGTH = 15,
+    INSTRUCTION_CACHE_SHARDS = 64
 };
 
 #define arg_out
 
+/*!
+ * \brief Translation state that is private to one thread.
+ *
+ * Each thread translating code gets its own translate args and guest
+ * extents, and receives its translated block directly as a copy in the
+ * arena of `Vex`.
+ */
+struct VexContext {
+    VexAbiInfo abi_info;
+    VexArchInfo arch_info;
+    VexGuestExtents guest_extents;
+    VexTranslateArgs args;
+
+    IRSB *block = nullptr;
+};
+
 /*!
  * \brief Main class which acts as an interface to the linked VEX library.
  *
@@ -29,18 +48,28 @@ enum CONFIGURATION : size_t {
  */
 class Vex {
 private:
-    VexAbiInfo _abi_info;
-    VexArchInfo _arch_info;
-    VexGuestExtents _guest_extents;
-
     VexControl _control;
-    VexTranslateArgs _args;
 
-    IRSB *_block;
+    // libVEX itself keeps its translation state in globals, so only the
+    // call into the library is serialized.
+    mutable std::mutex _translate_mtx;
 
     // Consider std::set (tree size?).
     std::vector<void*> _allocations;
 
+    // Storage of all translated blocks (only used while holding
+    // `_translate_mtx`).
+    IRArena _arena;
+
+    // Cache of single instruction and instruction run translations. It is
+    // split into shards with their own lock to keep contention low for
+    // concurrent lookups.
+    struct InstructionCacheShard {
+        mutable std::mutex mtx;
+        std::unordered_map<uintptr_t, const IRSB*> blocks;
+    };
+    InstructionCacheShard _instruction_cache[INSTRUCTION_CACHE_SHARDS];
+
 public:
     /*!
      * \brief `get_instance` returns the only instance of this singleton class.
@@ -56,24 +85,51 @@ public:
 
     ~Vex();
 
-    const IRSB &translate(const uint8_t *bytes,
-                          uintptr_t guest_address,
-                          size_t instruction_count=MAX_INSTRUCTIONS,
-                          arg_out uintptr_t *vex_block_end=nullptr);
+    IRSB *translate(const uint8_t *bytes,
+                    uintptr_t guest_address,
+                    size_t instruction_count=MAX_INSTRUCTIONS,
+                    arg_out uintptr_t *vex_block_end=nullptr,
+                    VexRegisterUpdates register_updates=VexRegUpd_INVALID);
+
+    const IRSB *translate_instruction(const uint8_t *bytes,
+                                      uintptr_t guest_address,
+                                      VexRegisterUpdates register_updates);
+
+    const IRSB *translate_instructions(const uint8_t *bytes,
+                                       const uintptr_t *guest_addresses,
+                                       size_t count,
+                                       VexRegisterUpdates register_updates,
+                                       arg_out size_t *num_translated);
 
     /*!
      * \brief Change `iropt_register_updates_default` value of
      * VexControl struct which controls Vex's optimiser.
+     *
+     * This is the default of all following translations that do not pass
+     * their own register update mode.
      */
     void set_iropt_register_updates_default(VexRegisterUpdates value);
 
     VexRegisterUpdates get_iropt_register_updates_default() const;
 
+    /*!
+     * \brief Estimates the heap bytes of all translated blocks and the
+     * instruction cache.
+     */
+    size_t get_memory_footprint() const;
+
 private:
     Vex();
 
-    void initialize();
-    void initialize_amd64();
+    const IRSB *translate_cached(const uint8_t *bytes,
+                                 uintptr_t guest_address,
+                                 size_t instruction_count,
+                                 VexRegisterUpdates register_updates);
+
+    static VexContext &get_context();
+
+    void initialize(VexContext &context);
+    void initialize_amd64(VexContext &context);
 
     static void __attribute__((noreturn)) failure_exit() {
         throw std::string("Fatal exit from libVEX.");
@@ -3,6 +3,7 @@
 
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <string>
@@ -13,6 +14,8 @@
 #include <cassert>
 
 #include "memory.h"
+#include "companion_file.h"
+#include "address_filter.h"
 
 enum VTableType {
     VTableTypeNormal = 0,
@@ -34,6 +37,9 @@ struct VTable {
     std::string module_name;
     std::unordered_set<uint64_t> xrefs;
 
+    // Handle of `module_name` (only valid after `VTableFile::finalize`).
+    uint32_t module_id;
+
     // Only .bss and got_reloc vtables have names.
     std::string name;
 
@@ -55,10 +61,53 @@ struct VTable {
 typedef std::map<uint64_t, VTable*> VTableMap;
 typedef std::map<uint64_t, std::unordered_set<VTable*>> EntryVTablePtrsMap;
 typedef std::vector<VTable> VTableVector;
-typedef std::map<std::string, VTableMap*> VTableModulesPtrMap;
-typedef std::map<std::string, EntryVTablePtrsMap> VTableModuleEntriesMap;
 typedef std::vector<VTableMap> VTableModulesVector;
 
+/*!
+ * \brief Handle of a module managed by a `VTableFile` (assigned by
+ * `VTableFile::finalize`, only valid for the object that assigned it).
+ */
+typedef uint32_t VTableModuleId;
+
+
+/*!
+ * \brief Position of a function in a vtable (first entry that holds it).
+ */
+struct VTableEntryPosition {
+    uint32_t vtbl_idx;
+    uint32_t pos;
+};
+
+typedef std::vector<VTableEntryPosition> VTableEntryPositions;
+
+
+/*!
+ * \brief Read-only lookup structure of the vtables of one module
+ * (built by `VTableFile::finalize`).
+ *
+ * Contains the vtable addresses of the module in ascending order and
+ * the corresponding vtable indexes at the same position. Additionally,
+ * each function maps to its positions in the vtables of the module
+ * (ordered by vtable address).
+ */
+struct VTableModuleIndex {
+    std::vector<uint64_t> addrs;
+    std::vector<uint32_t> indexes;
+    std::unordered_map<uint64_t, VTableEntryPositions> entry_positions;
+};
+
+typedef std::vector<VTableModuleIndex> VTableModuleIndexes;
+
+
+/*!
+ * \brief The vtables of one module that were read but not yet added to
+ * a `VTableFile` (indexes are relative to the module).
+ */
+struct VTableModule {
+    std::string module_name;
+    VTableVector vtables;
+};
+
 
 /*!
  * \brief Class collecting the information that was produced by the IDA
@@ -71,9 +120,23 @@ private:
     const FileFormatType _file_format;
     VTableVector _vtables;
     VTableModulesVector _module_vtables;
-    VTableModulesPtrMap _module_vtables_map;
-    VTableModuleEntriesMap _module_vtable_entries_map;
-    VTableModuleEntriesMap _module_vtable_entry_addrs_map;
+    VTableModuleIndexes _module_indexes;
+
+    // Interned module names (ids are the positions in `_module_vtables`
+    // and `_module_indexes`).
+    std::unordered_map<std::string, VTableModuleId> _module_ids;
+    VTableModuleId _this_module_id;
+
+    // Entries are only queried for the module to analyze.
+    EntryVTablePtrsMap _this_vtable_entries;
+    EntryVTablePtrsMap _this_vtable_entry_addrs;
+
+    // Filters in front of the maps of the module to analyze (most queries
+    // are for addresses that are not contained).
+    AddressFilter _this_vtables_filter;
+    AddressFilter _this_vtable_entries_filter;
+    AddressFilter _this_vtable_entry_addrs_filter;
+
     std::set<std::string> _managed_modules;
     uint32_t _index;
 
@@ -81,6 +144,26 @@ private:
     bool _is_finalized = false;
     uint32_t _addr_size;
 
+    static bool parse_text(const std::string &vtables_file,
+                           VTableModule &module);
+
+    static bool import_companion(const std::string &companion_file,
+                                 uint64_t source_hash,
+                                 VTableModule &module);
+
+    static bool export_companion(const std::string &companion_file,
+                                 uint64_t source_hash,
+                                 const VTableModule &module);
+
+    const VTable* find_vtable(VTableModuleId module_id,
+                              uint64_t addr) const;
+
+    void finalize_module(VTableModuleId module_id,
+                         const std::vector<VTable*> &vtables);
+    void finalize_this_module();
+
+    void check_module_id(VTableModuleId module_id) const;
+
 public:
     VTableFile(const std::string &this_module_name,
                const FileFormatType file_format);
@@ -110,6 +193,32 @@ public:
     const VTableMap& get_this_vtables() const;
 
 
+    /*!
+     * \brief Returns `true` if a vtable of this module starts at the given
+     * address (same as a lookup in `get_this_vtables`, but cheaper for
+     * addresses that are not contained).
+     */
+    bool is_this_vtable(uint64_t addr) const {
+        return _this_vtables_filter.contains(addr);
+    }
+
+    /*!
+     * \brief Returns `true` if the given function is an entry of a vtable of
+     * this module. \see `get_this_vtable_entries`
+     */
+    bool is_this_vtable_entry(uint64_t func_addr) const {
+        return _this_vtable_entries_filter.contains(func_addr);
+    }
+
+    /*!
+     * \brief Returns `true` if the given address is the address of an entry
+     * of a vtable of this module. \see `get_this_vtable_entry_addrs`
+     */
+    bool is_this_vtable_entry_addr(uint64_t entry_addr) const {
+        return _this_vtable_entry_addrs_filter.contains(entry_addr);
+    }
+
+
     /*!
      * \brief Returns all known vtables for the given module.
      * \return Returns a `map` with all known vtables (address as key,
@@ -117,6 +226,33 @@ public:
      */
     const VTableMap& get_vtables(const std::string &module_name) const;
 
+    /*!
+     * \brief Returns all known vtables for the given module handle.
+     * \see `get_vtables`
+     */
+    const VTableMap& get_vtables(VTableModuleId module_id) const;
+
+
+    /*!
+     * \brief Returns the handle of the given module name.
+     *
+     * Module names are only resolved at the I/O boundary, lookups inside
+     * the analyses should use the handle (or `VTable::module_id`).
+     * \return Returns the module handle (throws if the module is unknown).
+     */
+    VTableModuleId get_module_id(const std::string &module_name) const;
+
+    /*!
+     * \brief Returns the handle of the module to analyze.
+     */
+    VTableModuleId get_this_module_id() const;
+
+    /*!
+     * \brief Returns the number of managed modules (handles are
+     * `0 .. get_num_modules() - 1`).
+     */
+    uint32_t get_num_modules() const;
+
 
     /*!
      * \brief Returns all known vtables.
@@ -127,8 +263,32 @@ public:
 
     /*!
      * \brief Parses a given vtable file and builds internal vtable structure.
+     *
+     * If `use_companion` is set, the vtables are loaded from the binary
+     * companion file `{FILE}_vtables.marx_bin` as long as it was created
+     * from the current `_vtables.txt` and `_vtables_xrefs.txt` files.
+     * Otherwise, the text files are parsed and the companion file
+     * is (re-)created.
      */
-    bool parse(const std::string &vtables_file);
+    bool parse(const std::string &vtables_file, bool use_companion=false);
+
+
+    /*!
+     * \brief Reads the vtables of a given vtable file without adding them
+     * (does not access any object state, hence modules can be read
+     * concurrently). \see `parse`
+     */
+    static bool read_module(const std::string &vtables_file,
+                            bool use_companion,
+                            VTableModule &module);
+
+
+    /*!
+     * \brief Adds the vtables of a module that was read by `read_module`.
+     *
+     * The vtable indexes depend on the order in which the modules are added.
+     */
+    bool add_module(VTableModule &module);
 
 
     /*!
@@ -137,9 +297,10 @@ public:
      * This function finalizes the vtable structures. It can only be used
      * once all vtable files are imported via the `parse` function.
      * After `finalize` was executed, no changes to the vtable structures
-     * are possible.
+     * are possible. The lookup structures of the modules are built
+     * concurrently by the given number of threads.
      */
-    void finalize();
+    void finalize(uint32_t num_threads=1);
 
 
     /*!
@@ -148,6 +309,11 @@ public:
      */
     bool is_finalized() const;
 
+    /*!
+     * \brief Estimates the heap bytes of all vtables and lookup structures.
+     */
+    size_t get_memory_footprint() const;
+
 
     /*!
      * \brief Returns a vtable object given by module name and address.
@@ -156,6 +322,12 @@ public:
     const VTable& get_vtable(const std::string &module_name, uint64_t addr)
         const;
 
+    /*!
+     * \brief Returns a vtable object given by module handle and address.
+     * \return Returns a vtable object.
+     */
+    const VTable& get_vtable(VTableModuleId module_id, uint64_t addr) const;
+
 
     /*!
      * \brief Returns a vtable object given by its index.
@@ -172,6 +344,33 @@ public:
     const VTable* get_vtable_ptr(const std::string &module_name,
                                              uint64_t addr) const;
 
+    /*!
+     * \brief Returns a vtable object given by module handle and address.
+     * \return Returns a vtable object pointer or nullptr if object does
+     * not exist.
+     */
+    const VTable* get_vtable_ptr(VTableModuleId module_id,
+                                 uint64_t addr) const;
+
+
+    /*!
+     * \brief Returns the positions of a function in the vtables of the
+     * given module.
+     * \return Returns the positions (ordered by vtable address) or nullptr
+     * if no vtable of the module contains the function.
+     */
+    const VTableEntryPositions* get_entry_positions(
+                                            const std::string &module_name,
+                                            uint64_t func_addr) const;
+
+    /*!
+     * \brief Returns the positions of a function in the vtables of the
+     * given module handle. \see `get_entry_positions`
+     */
+    const VTableEntryPositions* get_entry_positions(
+                                            VTableModuleId module_id,
+                                            uint64_t func_addr) const;
+
     uint32_t get_addr_size() const;
 };
 
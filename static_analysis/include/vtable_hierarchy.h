@@ -13,12 +13,49 @@
 #include <cassert>
 #include <cstring>
 #include <vector>
+#include <memory>
 #include <mutex>
 
 
 typedef std::set<uint32_t> DependentVTables;
 typedef std::vector<DependentVTables> HierarchiesVTable;
 
+/*!
+ * \brief Groups of vtable indices of which each group belongs to one
+ * hierarchy. \see `VTableHierarchies::update_hierarchy_batch`
+ */
+typedef std::vector<std::vector<uint32_t>> VTableGroups;
+
+
+/*!
+ * \brief Marks a vtable that is not part of any hierarchy.
+ */
+#define NO_HIERARCHY 0xffffffff
+
+
+/*!
+ * \brief Immutable snapshot of the merged hierarchies.
+ *
+ * Each merge publishes a new snapshot, hence a snapshot can be read by
+ * other threads without locking while the hierarchies are updated.
+ */
+struct HierarchiesSnapshot {
+    HierarchiesVTable hierarchies;
+
+    // Index into `hierarchies` for each vtable index.
+    std::vector<uint32_t> hierarchy_idxs;
+
+    const DependentVTables *get_hierarchy(uint32_t vtable_idx) const {
+        if(vtable_idx >= hierarchy_idxs.size()
+           || hierarchy_idxs[vtable_idx] == NO_HIERARCHY) {
+            return nullptr;
+        }
+        return &hierarchies[hierarchy_idxs[vtable_idx]];
+    }
+};
+
+typedef std::shared_ptr<const HierarchiesSnapshot> HierarchiesSnapshotPtr;
+
 
 #define DEBUG_WRITE_HIERARCHY_STEPS 0
 #define DEBUG_PRINT_DEPENDENCIES 0
@@ -34,10 +71,23 @@ typedef std::vector<DependentVTables> HierarchiesVTable;
  * already found hierarchies and add it to its structure (makes it possible
  * to analyze binaries in an iterative manner). Found hierarchy can be
  * exported into a `.hierarchy` file for further usage.
+ *
+ * Internally, the hierarchies are kept as disjoint-set forest over the vtable
+ * indices (union by rank, path compression). The set representation returned
+ * by `get_hierarchies` is rebuilt from the forest when merging and published
+ * as immutable snapshot (\see `HierarchiesSnapshot`). Updates must not be
+ * made concurrently.
  */
 class VTableHierarchies {
 private:
-    HierarchiesVTable _hierarchies;
+    // Disjoint-set forest indexed by vtable index (`NO_HIERARCHY` if the
+    // vtable is not part of any hierarchy).
+    std::vector<uint32_t> _parents;
+    std::vector<uint8_t> _ranks;
+
+    // Accessed with the atomic `shared_ptr` functions.
+    HierarchiesSnapshotPtr _snapshot;
+    bool _is_merged = true;
     const FileFormatType _file_format;
     const VTableFile &_vtable_file;
     const VTableMap &_this_vtables;
@@ -57,6 +107,12 @@ private:
 
     void merge_hierarchies_priv();
 
+    uint32_t find_root(uint32_t vtable_idx);
+
+    void add_vtable(uint32_t vtable_idx);
+
+    bool unite(uint32_t vtable_1_idx, uint32_t vtable_2_idx);
+
     bool get_vtable_dependencies(const VTableUpdates &vtable_updates,
                                  const ExpressionPtr &base_base,
                                  uint32_t base_index,
@@ -76,6 +132,17 @@ private:
                                uint32_t vtable_2_idx,
                                bool merge_hierarchy);
 
+    void add_hierarchy(const DependentVTables &hierarchy);
+
+    bool import_companion(const std::string &companion_file,
+                          uint64_t source_hash,
+                          HierarchiesVTable &hierarchies) const;
+
+    bool export_companion(const std::string &companion_file,
+                          uint64_t source_hash,
+                          const std::string &module_name,
+                          const HierarchiesVTable &hierarchies) const;
+
 public:
     VTableHierarchies(const FileFormatType file_format,
                       const VTableFile &vtable_file,
@@ -99,6 +166,35 @@ public:
     const HierarchiesVTable& get_hierarchies() const;
 
 
+    /*!
+     * \brief Returns the hierarchy the given vtable belongs to.
+     *
+     * Only reflects the state of the last merge (see `merge_hierarchies`).
+     *
+     * \return Returns the hierarchy or `nullptr` if the vtable is not part of
+     * any hierarchy.
+     */
+    const DependentVTables *get_hierarchy(uint32_t vtable_idx) const;
+
+
+    /*!
+     * \brief Returns the snapshot of the last merge.
+     *
+     * In contrast to `get_hierarchies` and `get_hierarchy`, the snapshot
+     * stays valid (and unchanged) while the hierarchies are updated by
+     * another thread.
+     */
+    HierarchiesSnapshotPtr get_snapshot() const {
+        return std::atomic_load(&_snapshot);
+    }
+
+    /*!
+     * \brief Estimates the heap bytes of the disjoint-set forest and the
+     * current snapshot (a snapshot still held by a reader is not counted).
+     */
+    size_t get_memory_footprint() const;
+
+
     /*!
      * \brief Updates the hierarchy structure with the new given information.
      *
@@ -134,16 +230,47 @@ public:
                           bool merge_hierarchy=true);
 
 
+    /*!
+     * \brief Adds all vtables of each given group into one hierarchy.
+     *
+     * All groups are united in one pass and merged once afterwards (which
+     * publishes a new snapshot).
+     */
+    void update_hierarchy_batch(const VTableGroups &vtable_groups);
+
+
     /*!
      * \brief Exports the current hierarchy structure into a file.
+     *
+     * If `use_companion` is set, the binary companion file
+     * `{MODULE}.hierarchy.marx_bin` is written as well.
      */
-    void export_hierarchy(const std::string &target_dir);
+    void export_hierarchy(const std::string &target_dir,
+                          bool use_companion=false);
 
 
     /*!
      * \brief Imports a hierarchy from file, adds it to the current hierarchy.
+     *
+     * If `use_companion` is set, the hierarchy is loaded from the binary
+     * companion file as long as it was created from the current
+     * `.hierarchy` file. Otherwise, the text file is parsed and the
+     * companion file is (re-)created.
+     */
+    void import_hierarchy(const std::string &target_file,
+                          bool use_companion=false);
+
+
+    /*!
+     * \brief Reads a hierarchy file without adding it to the current
+     * hierarchy (only reads the finalized vtable file, hence hierarchy
+     * files can be read concurrently). \see `import_hierarchy`
+     *
+     * \return `false` if the hierarchy file does not exist.
      */
-    void import_hierarchy(const std::string &target_file);
+    bool read_hierarchy(const std::string &target_file,
+                        bool use_companion,
+                        HierarchiesVTable &hierarchies) const;
 
 
     /*!
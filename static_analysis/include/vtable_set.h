@@ -0,0 +1,103 @@
+#ifndef VTABLE_SET_H
+#define VTABLE_SET_H
+
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <cstdint>
+
+#include "vtable_file.h"
+#include "vtable_hierarchy.h"
+
+typedef uint32_t VTableSetId;
+
+/*!
+ * \brief Range `[first, last]` of positions in hierarchy order.
+ */
+struct VTableRange {
+    uint32_t first;
+    uint32_t last;
+
+    bool operator<(const VTableRange &other) const {
+        return first < other.first
+               || (first == other.first && last < other.last);
+    }
+};
+
+typedef std::vector<VTableRange> VTableRanges;
+
+
+/*!
+ * \brief Interns sets of vtables (for example the allowed vtables of the
+ * vcalls) as ranges over the vtables in hierarchy order.
+ *
+ * The vtables of each hierarchy get consecutive positions (followed by all
+ * vtables without hierarchy in index order), hence a set consisting of
+ * whole hierarchies is stored as one range per hierarchy. Identical sets
+ * are stored once and share their id.
+ *
+ * The order is taken from the hierarchies at construction, the store has
+ * to be rebuilt if they change.
+ */
+class VTableSetStore {
+private:
+    // Position in hierarchy order for each vtable index and vice versa.
+    std::vector<uint32_t> _positions;
+    std::vector<uint32_t> _vtable_idxs;
+
+    std::map<VTableRanges, VTableSetId> _set_ids;
+    std::vector<const VTableRanges*> _sets;
+
+public:
+
+    VTableSetStore(const VTableFile &vtable_file,
+                   const VTableHierarchies &vtable_hierarchies);
+
+    /*!
+     * \brief Interns the given set of vtable indices.
+     * \return Returns the id of the (possibly already known) set.
+     */
+    VTableSetId intern(const std::unordered_set<uint32_t> &vtable_idxs);
+
+    /*!
+     * \brief Returns the ranges of the given set (sorted, not overlapping
+     * and not adjacent).
+     */
+    const VTableRanges &get_ranges(VTableSetId set_id) const;
+
+    /*!
+     * \brief Checks if the given vtable index is part of the given set.
+     */
+    bool contains(VTableSetId set_id, uint32_t vtable_idx) const;
+
+    /*!
+     * \brief Returns the vtable index at the given position in hierarchy
+     * order.
+     */
+    uint32_t get_vtable_idx(uint32_t position) const {
+        return _vtable_idxs[position];
+    }
+
+    /*!
+     * \brief Calls `func` with the vtable index of each element of the set
+     * (in hierarchy order).
+     */
+    template<typename F>
+    void for_each(VTableSetId set_id, F func) const {
+        for(const VTableRange &range : get_ranges(set_id)) {
+            for(uint32_t pos = range.first; pos <= range.last; pos++) {
+                func(_vtable_idxs[pos]);
+            }
+        }
+    }
+
+    size_t size() const {
+        return _sets.size();
+    }
+
+    size_t get_num_vtables() const {
+        return _vtable_idxs.size();
+    }
+};
+
+#endif // VTABLE_SET_H
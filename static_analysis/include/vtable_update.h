@@ -54,7 +54,15 @@ private:
                                 arg_out std::string &base_str);
 
     bool convert_str_expression(const std::string &base_str,
-                                arg_out ExpressionPtr &base);
+                                arg_out ExpressionPtr &base) const;
+
+    void read_updates(std::istream &file,
+                      arg_out std::string &import_module_name,
+                      arg_out VTableUpdatesMap &vtable_updates_map) const;
+
+    void read_updates_text(std::istream &file,
+                           arg_out std::string &import_module_name,
+                           arg_out VTableUpdatesMap &vtable_updates_map) const;
 
 public:
 
@@ -70,7 +78,8 @@ public:
 
 
     /*!
-     * \brief Exports the vtable updates that are done by this module.
+     * \brief Exports the vtable updates that are done by this module
+     * (in a binary format).
      */
     void export_vtable_updates(const std::string &target_dir);
 
@@ -88,6 +97,8 @@ public:
     /*!
      * \brief Imports a vtable update from file,
      * adds it to the current vtable updates.
+     *
+     * Files in the text format of earlier versions are still accepted.
      */
     void import_updates(const std::string &target_file);
 
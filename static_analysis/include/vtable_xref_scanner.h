@@ -0,0 +1,64 @@
+#ifndef VTABLE_XREF_SCANNER_H
+#define VTABLE_XREF_SCANNER_H
+
+#include <vector>
+#include <cstdint>
+
+#include "memory.h"
+#include "vtable_file.h"
+
+class Translator;
+
+// The executable segment is scanned in chunks of this size (one chunk is
+// processed by one thread at a time).
+#define VTABLE_XREF_SCAN_CHUNK_SIZE (1 << 20)
+
+enum NativeXrefsMode {
+    NativeXrefsDisabled = 0,
+    NativeXrefsValidate, // Only report differences to the exported xrefs.
+    NativeXrefsReplace, // Use the found xrefs instead of the exported ones.
+};
+
+struct VTableXrefScanStats {
+    uint64_t num_xrefs = 0;
+
+    // Exported xrefs that were not found and found xrefs that were not
+    // exported.
+    uint64_t num_missing = 0;
+    uint64_t num_additional = 0;
+};
+
+/*!
+ * \brief Finds the instructions of the executable segment that reference
+ * one of the given (ascending) addresses.
+ *
+ * Recognized are the RIP-relative `lea` and the absolute `mov r32, imm32`,
+ * `mov r64, imm64` and `mov r/m64, imm32` forms. Every 4 byte window is
+ * range checked against the addresses (with SSE2 if available) and only
+ * the windows in range are decoded and looked up. The chunks of the segment
+ * are scanned concurrently, the result does not depend on the number of
+ * threads.
+ *
+ * \return Returns the ascending candidate instruction addresses for each
+ * address (same position as in `addrs`). A reference can yield more than
+ * one candidate if the start of its instruction is ambiguous.
+ */
+std::vector<std::vector<uint64_t>> find_addr_xrefs(
+                                        const Memory &memory,
+                                        const std::vector<uint64_t> &addrs,
+                                        uint32_t num_threads);
+
+/*!
+ * \brief Finds the xrefs of the normal vtables of the given module (read by
+ * `VTableFile::read_module`) in its executable segment and compares them
+ * with the exported ones. Candidates are only kept if they start an
+ * instruction of a function of the (finalized) translator. If `mode` is
+ * `NativeXrefsReplace`, `VTable::xrefs` is set to the found xrefs afterwards
+ * (the indirect xrefs of .got and .bss vtables are always kept).
+ */
+VTableXrefScanStats scan_vtable_xrefs(const Translator &translator,
+                                      NativeXrefsMode mode,
+                                      uint32_t num_threads,
+                                      VTableModule &module);
+
+#endif // VTABLE_XREF_SCANNER_H
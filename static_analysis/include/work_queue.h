@@ -0,0 +1,86 @@
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+// Maximum number of items a worker moves from its deque into its batch at
+// once.
+#define WORK_QUEUE_POP_BATCH 8
+
+/*!
+ * \brief Work-stealing queue of addresses that are processed by a fixed
+ * number of worker threads.
+ *
+ * Each worker owns a deque (guarded by its own lock) from which it takes
+ * items from the front. A worker whose deque ran dry steals half of the
+ * items from the back of another worker's deque at once, so expensive items
+ * do not stall the remaining workers and the locks are rarely contended.
+ *
+ * Pops are batched as well: a worker moves up to `WORK_QUEUE_POP_BATCH`
+ * items (but at most half of its deque, the rest stays stealable) into its
+ * batch at once and hands them out without touching the deque's lock.
+ */
+class WorkQueue {
+private:
+    struct WorkerDeque {
+        std::mutex mtx;
+        std::deque<uint64_t> items;
+
+        // Items taken by the owning worker (only contended if several
+        // threads use the same worker index).
+        std::mutex batch_mtx;
+        std::vector<uint64_t> batch;
+        size_t batch_pos = 0;
+    };
+
+    std::vector<std::unique_ptr<WorkerDeque>> _deques;
+    std::atomic<size_t> _size;
+    std::atomic<uint32_t> _next_push;
+
+public:
+    WorkQueue(uint32_t num_workers=1);
+
+    WorkQueue(const WorkQueue&) = delete;
+    void operator=(const WorkQueue&) = delete;
+
+    /*!
+     * \brief Sets the number of workers and distributes all queued items
+     * among them. Must not be called while workers are running.
+     */
+    void set_num_workers(uint32_t num_workers);
+
+    /*!
+     * \brief Adds an item (items are distributed round-robin over the deques
+     * of all workers).
+     */
+    void push(uint64_t item);
+
+    /*!
+     * \brief Takes the next item for the given worker.
+     *
+     * \return `false` if no item is left in any deque.
+     */
+    bool pop(uint32_t worker, uint64_t &item);
+
+    /*!
+     * \brief Returns the number of queued items (only a snapshot while
+     * workers are running).
+     */
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+private:
+    bool steal(uint32_t worker);
+};
+
+#endif // WORK_QUEUE_H
@@ -0,0 +1,70 @@
+#include "abi.h"
+#include "state.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+static_assert(sizeof(system_v_arguments) / sizeof(system_v_arguments[0])
+              == AbiTraitsSystemV::num_arguments,
+              "System V argument registers do not match.");
+static_assert(sizeof(system_v_scratch) / sizeof(system_v_scratch[0])
+              == AbiTraitsSystemV::num_scratch,
+              "System V scratch registers do not match.");
+static_assert(sizeof(msvc_arguments) / sizeof(msvc_arguments[0])
+              == AbiTraitsMsvc::num_arguments,
+              "MSVC argument registers do not match.");
+static_assert(sizeof(msvc_scratch) / sizeof(msvc_scratch[0])
+              == AbiTraitsMsvc::num_scratch,
+              "MSVC scratch registers do not match.");
+
+// The register tables are defined per translation unit (see amd64.h), hence
+// the traits only return them from here.
+const shared_ptr<Register> *AbiTraitsSystemV::arguments() {
+    return system_v_arguments;
+}
+
+const shared_ptr<Register> *AbiTraitsSystemV::scratch() {
+    return system_v_scratch;
+}
+
+const shared_ptr<Register> *AbiTraitsMsvc::arguments() {
+    return msvc_arguments;
+}
+
+const shared_ptr<Register> *AbiTraitsMsvc::scratch() {
+    return msvc_scratch;
+}
+
+template<typename Traits>
+static Abi make_abi() {
+    static_assert(Traits::num_arguments <= ABI_MAX_ARGUMENTS,
+                  "Too many argument registers.");
+
+    Abi abi;
+    abi.file_format = Traits::file_format;
+    abi.arguments = Traits::arguments();
+    abi.num_arguments = Traits::num_arguments;
+    abi.scratch = Traits::scratch();
+    abi.num_scratch = Traits::num_scratch;
+    abi.return_value = register_rax;
+    for(size_t i = 0; i < Traits::num_arguments; i++) {
+        abi.arguments_init[i] = State::initial_values().at(
+                                                abi.arguments[i]->offset());
+    }
+    return abi;
+}
+
+const Abi &get_abi(FileFormatType file_format) {
+    static const Abi abi_system_v = make_abi<AbiTraitsSystemV>();
+    static const Abi abi_msvc = make_abi<AbiTraitsMsvc>();
+
+    switch(file_format) {
+        case FileFormatELF64:
+            return abi_system_v;
+        case FileFormatPE64:
+            return abi_msvc;
+        default:
+            throw runtime_error("Do not know how to handle file format.");
+    }
+}
@@ -0,0 +1,32 @@
+#include "address_filter.h"
+
+using namespace std;
+
+/*!
+ * \brief Builds the filter for the given addresses (about 16 bits of filter
+ * per address).
+ */
+void AddressFilter::build(vector<uint64_t> addrs) {
+    sort(addrs.begin(), addrs.end());
+    addrs.erase(unique(addrs.begin(), addrs.end()), addrs.end());
+    _addrs = move(addrs);
+
+    uint64_t num_blocks = 1;
+    while(num_blocks * ADDRESS_FILTER_BLOCK_WORDS * 64 < _addrs.size() * 16) {
+        num_blocks <<= 1;
+    }
+    _block_mask = num_blocks - 1;
+    _blocks.assign(num_blocks * ADDRESS_FILTER_BLOCK_WORDS, 0);
+
+    for(uint64_t addr : _addrs) {
+        uint64_t hash = mix(addr);
+        uint64_t *block =
+                &_blocks[(hash & _block_mask) * ADDRESS_FILTER_BLOCK_WORDS];
+        hash >>= 28;
+        for(uint32_t i = 0; i < ADDRESS_FILTER_NUM_BITS; i++) {
+            uint32_t bit = hash & 0x1ff;
+            block[bit >> 6] |= 1ULL << (bit & 63);
+            hash >>= 9;
+        }
+    }
+}
@@ -0,0 +1,224 @@
+#include "analysis_cache.h"
+
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+using namespace std;
+
+static_assert(sizeof(AnalysisCacheHeader) == 72,
+              "Unexpected padding in cache header.");
+static_assert(sizeof(AnalysisCacheEntry) == 40,
+              "Unexpected padding in cache entry.");
+
+AnalysisCache::AnalysisCache(const string &target_file)
+    : _target_file(target_file),
+      _cache_file(target_file + ".marx_cache") {
+}
+
+const AnalysisCacheKey &AnalysisCache::get_key() const {
+    if(_key_computed) {
+        return _key;
+    }
+
+    _key.binary = hash_file(_target_file);
+    _key.dump = hash_file(_target_file + ".dmp");
+    _key.dump_no_return = hash_file(_target_file + ".dmp.no-return");
+    _key.funcs_xrefs = hash_file(_target_file + "_funcs_xrefs.txt");
+
+    // Combine the hashes of all protobuf parts.
+    _key.ssa = 0;
+    uint32_t file_ctr = 0;
+    while(true) {
+        string input_file = _target_file + "_ssa.pb2_part"
+                            + to_string(file_ctr);
+        uint64_t part_hash = hash_file(input_file);
+        if(!part_hash) {
+            break;
+        }
+        size_t temp = _key.ssa;
+        std::hash_combine(temp, part_hash);
+        _key.ssa = temp;
+        file_ctr++;
+    }
+
+    _key_computed = true;
+    return _key;
+}
+
+bool AnalysisCache::is_valid() const {
+    if(!MappedFile::exists(_cache_file)) {
+        return false;
+    }
+
+    MappedFile file(_cache_file);
+    if(file.size() < sizeof(AnalysisCacheHeader)) {
+        return false;
+    }
+
+    const AnalysisCacheHeader &header =
+                *reinterpret_cast<const AnalysisCacheHeader*>(file.data());
+    if(memcmp(header.magic, ANALYSIS_CACHE_MAGIC, sizeof(header.magic)) != 0
+       || header.version != ANALYSIS_CACHE_VERSION) {
+        return false;
+    }
+
+    uint64_t index_size = header.num_functions * sizeof(AnalysisCacheEntry);
+    if(header.index_offset > file.size()
+       || index_size > file.size() - header.index_offset) {
+        return false;
+    }
+
+    return header.key == get_key();
+}
+
+bool AnalysisCache::import_cache(Translator &translator) const {
+
+    MappedFile file(_cache_file);
+    const uint8_t *data = file.data();
+    const AnalysisCacheHeader &header =
+                         *reinterpret_cast<const AnalysisCacheHeader*>(data);
+    const AnalysisCacheEntry *entries =
+            reinterpret_cast<const AnalysisCacheEntry*>(data
+                                                       + header.index_offset);
+
+    map<uintptr_t, Function> &functions = translator.get_functions_mutable();
+    if(header.num_functions != functions.size()) {
+        return false;
+    }
+
+    // Check that the cache covers all functions before importing anything.
+    vector<Function*> targets;
+    targets.reserve(header.num_functions);
+    for(uint64_t i = 0; i < header.num_functions; i++) {
+        const AnalysisCacheEntry &entry = entries[i];
+        const auto needle = functions.find(entry.address);
+        if(needle == functions.end()
+           || entry.ssa_offset + entry.ssa_size > file.size()
+           || entry.xrefs_offset + entry.xrefs_count * sizeof(uint64_t)
+                > file.size()) {
+            return false;
+        }
+        targets.push_back(&needle->second);
+    }
+
+    for(uint64_t i = 0; i < header.num_functions; i++) {
+        const AnalysisCacheEntry &entry = entries[i];
+        Function &function = *targets[i];
+
+        // The protobuf message is parsed directly from the mapped file.
+        ssa::Function ssa_function;
+        if(!ssa_function.ParseFromArray(data + entry.ssa_offset,
+                                       entry.ssa_size)) {
+            stringstream err_msg;
+            err_msg << "Corrupted SSA data in cache file for function "
+                    << "with address: "
+                    << hex << entry.address << ".";
+            throw runtime_error(err_msg.str().c_str());
+        }
+        for(int j = 0; j < ssa_function.basic_blocks_size(); j++) {
+            function.add_block_ssa(ssa_function.basic_blocks(j));
+        }
+        function.finalize_ssa();
+
+        const uint64_t *xrefs =
+                reinterpret_cast<const uint64_t*>(data + entry.xrefs_offset);
+        for(uint64_t j = 0; j < entry.xrefs_count; j++) {
+            function.add_xref(xrefs[j]);
+        }
+    }
+
+    return true;
+}
+
+void AnalysisCache::write_data(const void *data, uint64_t size) {
+    _output.write(static_cast<const char*>(data), size);
+    _output_offset += size;
+}
+
+void AnalysisCache::align_output() {
+    static const char padding[sizeof(uint64_t)] = {0};
+    uint64_t remainder = _output_offset % sizeof(uint64_t);
+    if(remainder) {
+        write_data(padding, sizeof(uint64_t) - remainder);
+    }
+}
+
+bool AnalysisCache::begin_export() {
+    lock_guard<mutex> _(_mtx);
+
+    _entries.clear();
+    _output.open(_cache_file + ".tmp", ios::binary | ios::trunc);
+    if(!_output) {
+        return false;
+    }
+
+    // The header is written again when the file is finished.
+    AnalysisCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    _output_offset = 0;
+    write_data(&header, sizeof(header));
+    return true;
+}
+
+void AnalysisCache::add_ssa_function(const ssa::Function &ssa_function) {
+    const string serialized = ssa_function.SerializeAsString();
+
+    lock_guard<mutex> _(_mtx);
+
+    AnalysisCacheEntry &entry = _entries[ssa_function.address()];
+    entry.address = ssa_function.address();
+    entry.ssa_offset = _output_offset;
+    entry.ssa_size = serialized.size();
+    entry.xrefs_offset = 0;
+    entry.xrefs_count = 0;
+    write_data(serialized.data(), serialized.size());
+}
+
+bool AnalysisCache::finish_export(const Translator &translator) {
+    lock_guard<mutex> _(_mtx);
+
+    // Add function xrefs.
+    align_output();
+    for(const auto &kv : translator.get_functions()) {
+        const auto needle = _entries.find(kv.first);
+        if(needle == _entries.end()) {
+            _output.close();
+            remove((_cache_file + ".tmp").c_str());
+            return false;
+        }
+
+        const set<uint64_t> &xrefs = kv.second.get_xrefs();
+        needle->second.xrefs_offset = _output_offset;
+        needle->second.xrefs_count = xrefs.size();
+        for(uint64_t xref_addr : xrefs) {
+            write_data(&xref_addr, sizeof(xref_addr));
+        }
+    }
+
+    // Write index sorted by function address.
+    AnalysisCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ANALYSIS_CACHE_MAGIC, sizeof(header.magic));
+    header.version = ANALYSIS_CACHE_VERSION;
+    header.key = get_key();
+    header.num_functions = _entries.size();
+    header.index_offset = _output_offset;
+    for(const auto &kv : _entries) {
+        write_data(&kv.second, sizeof(kv.second));
+    }
+
+    _output.seekp(0);
+    _output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _output.close();
+    if(_output.fail()) {
+        remove((_cache_file + ".tmp").c_str());
+        return false;
+    }
+
+    // Only replace the old cache file once the new one is complete.
+    if(rename((_cache_file + ".tmp").c_str(), _cache_file.c_str()) != 0) {
+        return false;
+    }
+    return true;
+}
@@ -1,4 +1,8 @@
 #include "backtrace_analysis.h"
+#include "def_use_cache.h"
+#include "item_budget.h"
+
+#include <queue>
 
 using namespace std;
 
@@ -18,6 +22,47 @@ CallOfRetInstruction::CallOfRetInstruction(const CallOfRetInstruction &obj)
     : InstructionSSA(obj) {
 }
 
+uint32_t TrackingVisitedSet::get_operand_slot(const BaseInstructionSSA &instr,
+                                              const OperandSSA &operand) {
+    // Equal operands get the slot of the first equal use (the uses are
+    // usually shared with the operand table, hence the address check).
+    const OperandSSASpan uses = instr.get_uses();
+    for(uint32_t i = 0; i < uses.size() && i < TRACKING_VISITED_SLOTS; i++) {
+        if(uses[i].get() == &operand || *uses[i] == operand) {
+            return i;
+        }
+    }
+    return TRACKING_VISITED_SLOTS;
+}
+
+bool TrackingVisitedSet::insert(const Function &function,
+                                const BaseInstructionSSA &instr,
+                                const TrackingInstruction &track) {
+    const uint32_t instr_id = function.get_instruction_ssa_id(instr);
+    const uint32_t slot = get_operand_slot(instr, *track.operand);
+    if(instr_id == INSTRUCTION_SSA_NO_ID
+       || slot == TRACKING_VISITED_SLOTS
+       || !track.transition_order.empty()) {
+        return _others.insert(track).second;
+    }
+
+    if(_last_function != &function) {
+        _last_function = &function;
+        _last_words = &_functions[&function];
+    }
+    Words &words = *_last_words;
+    if(words.empty()) {
+        words.resize(function.get_number_instructions_ssa(), 0);
+    }
+
+    const uint64_t bit = 1ULL << (track.type * TRACKING_VISITED_SLOTS + slot);
+    if(words[instr_id] & bit) {
+        return false;
+    }
+    words[instr_id] |= bit;
+    return true;
+}
+
 BacktraceAnalysis::BacktraceAnalysis(
                                    const string &module_name,
                                    const string &target_dir,
@@ -67,6 +112,8 @@ BacktraceAnalysis::BacktraceAnalysis(
 void BacktraceAnalysis::basic_ctor(uint64_t start_addr,
                                    const string &dir_prefix) {
     _start_addr = start_addr;
+    _dir_prefix = dir_prefix;
+    _capture_stages = GraphCapture::get_instance().get_stages(start_addr);
 
     // Create directory for graph dumps.
     stringstream dump_dir;
@@ -174,6 +221,9 @@ void BacktraceAnalysis::draw_final_edge(
 
 bool BacktraceAnalysis::obtain(uint32_t num_rounds) {
 
+    // The graph is changed by this round.
+    _graph_csr_dirty = true;
+
     // Execute specialization specific pre obtain function.
     pre_obtain();
 
@@ -182,9 +232,12 @@ bool BacktraceAnalysis::obtain(uint32_t num_rounds) {
     // Process until either the work_queue is empty or our limit is reached.
     while(!_work_queue.empty() && _round < max_rounds) {
 
+        ScopedItemBudget::check_time();
+        ScopedItemBudget::check_graph_nodes(boost::num_vertices(_graph));
+
         // Get current instruction we have to process (do not process
         // same instruction twice).
-        TrackingInstruction curr = _work_queue.front();
+        TrackingInstruction curr = move(_work_queue.front());
         _work_queue.pop();
 
         const Function &curr_func =
@@ -233,7 +286,7 @@ bool BacktraceAnalysis::obtain(uint32_t num_rounds) {
 
         // Check if we already processed the instruction
         // for the given register in order to avoid recursion infinity loops.
-        if(_processed_instrs.find(curr) != _processed_instrs.end()) {
+        if(!_processed_instrs.insert(curr_func, *curr_instr, curr)) {
 
             // Compare of `TrackingInstruction` does not consider prev_node.
             // Therefore, we manually draw an edge from the previous node
@@ -243,7 +296,6 @@ bool BacktraceAnalysis::obtain(uint32_t num_rounds) {
 
             continue;
         }
-        _processed_instrs.insert(curr);
 
 #if DEBUG_PRINT
         cout << "Round: " << dec << _round
@@ -282,8 +334,11 @@ bool BacktraceAnalysis::obtain(uint32_t num_rounds) {
 
         // Give the analysis contol over the graph we want to create
         // before we track the operand back.
-        GraphDataFlow curr_graph;
-        InstrGraphNodeMap curr_instr_graph_node_map;
+        GraphDataFlow &curr_graph = _round_graph;
+        InstrGraphNodeMap &curr_instr_graph_node_map =
+                                                   _round_instr_graph_node_map;
+        curr_graph.clear();
+        curr_instr_graph_node_map.clear();
         pre_augment_use(curr_graph,
                         curr_instr_graph_node_map,
                         curr_func,
@@ -291,20 +346,12 @@ bool BacktraceAnalysis::obtain(uint32_t num_rounds) {
                         curr_instr,
                         curr);
 
-#if DEBUG_DUMP_GRAPHS
-        stringstream pre_dump_file;
-        pre_dump_file << setfill('0') << setw(3) << dec << _round
-                 << "_type_"
-                 << dec << curr.type
-                 << "_func_"
-                 << setfill('0') << setw(8) << hex << curr_func.get_entry()
-                 << "_instr_"
-                 << setfill('0') << setw(8) << hex << curr.addr
-                 << "_op_"
-                 << *curr.operand
-                 << "_pre_augment_use.dot";
-        dump_graph(curr_graph, pre_dump_file.str());
-#endif
+        if(_capture_stages & GraphCapturePreAugmentUse) {
+            capture_graph(curr_graph,
+                          GraphCapturePreAugmentUse,
+                          &curr,
+                          curr_func.get_entry());
+        }
 
         // Track the operand for the given instruction back.
         augment_use(curr_graph,
@@ -313,20 +360,12 @@ bool BacktraceAnalysis::obtain(uint32_t num_rounds) {
                     curr.operand,
                     curr_instr);
 
-#if DEBUG_DUMP_GRAPHS
-        stringstream dump_file;
-        dump_file << setfill('0') << setw(3) << dec << _round
-                 << "_type_"
-                 << dec << curr.type
-                 << "_func_"
-                 << setfill('0') << setw(8) << hex << curr_func.get_entry()
-                 << "_instr_"
-                 << setfill('0') << setw(8) << hex << curr.addr
-                 << "_op_"
-                 << *curr.operand
-                 << "_augment_use.dot";
-        dump_graph(curr_graph, dump_file.str());
-#endif
+        if(_capture_stages & GraphCaptureAugmentUse) {
+            capture_graph(curr_graph,
+                          GraphCaptureAugmentUse,
+                          &curr,
+                          curr_func.get_entry());
+        }
 
         // Give the analysis contol over the graph we created
         // (for example for pruning it).
@@ -337,41 +376,33 @@ bool BacktraceAnalysis::obtain(uint32_t num_rounds) {
                          curr_instr,
                          curr);
 
-#if DEBUG_DUMP_GRAPHS
-        stringstream post_dump_file;
-        post_dump_file << setfill('0') << setw(3) << dec << _round
-                 << "_type_"
-                 << dec << curr.type
-                 << "_func_"
-                 << setfill('0') << setw(8) << hex << curr_func.get_entry()
-                 << "_instr_"
-                 << setfill('0') << setw(8) << hex << curr.addr
-                 << "_op_"
-                 << *curr.operand
-                 << "_post_augment_use.dot";
-        dump_graph(curr_graph, post_dump_file.str());
-#endif
+        if(_capture_stages & GraphCapturePostAugmentUse) {
+            capture_graph(curr_graph,
+                          GraphCapturePostAugmentUse,
+                          &curr,
+                          curr_func.get_entry());
+        }
 
-        // Merge graph into final graph.
-        merge_graphs(curr_graph);
-
-        // Add edge between the final graph and the newly merged component.
-        draw_final_edge(curr, curr_instr);
-
-#if DEBUG_DUMP_GRAPHS
-        stringstream merge_dump_file;
-        merge_dump_file << setfill('0') << setw(3) << dec << _round
-                 << "_type_"
-                 << dec << curr.type
-                 << "_func_"
-                 << setfill('0') << setw(8) << hex << curr_func.get_entry()
-                 << "_instr_"
-                 << setfill('0') << setw(8) << hex << curr.addr
-                 << "_op_"
-                 << *curr.operand
-                 << "_merged.dot";
-        dump_graph(_graph, merge_dump_file.str());
-#endif
+        // Merge graph into final graph and add edge between the final graph
+        // and the newly merged component (undone if the merge fails in order
+        // to not leave a partly merged component in the final graph).
+        begin_graph_transaction();
+        try {
+            merge_graphs(curr_graph);
+            draw_final_edge(curr, curr_instr);
+        }
+        catch(...) {
+            rollback_graph_transaction();
+            throw;
+        }
+        commit_graph_transaction();
+
+        if(_capture_stages & GraphCaptureMerged) {
+            capture_graph(_graph,
+                          GraphCaptureMerged,
+                          &curr,
+                          curr_func.get_entry());
+        }
 
         // Get next instructions that we should track.
         get_next_tracking_instrs(next_instrs,
@@ -405,6 +436,9 @@ bool BacktraceAnalysis::obtain(uint32_t num_rounds) {
 
     // Dump final graph.
     dump_graph(_graph, "final.dot");
+    if(_capture_stages & GraphCaptureFinal) {
+        capture_graph(_graph, GraphCaptureFinal, nullptr, 0);
+    }
 
     // Execute specialization specific post obtain function.
     post_obtain();
@@ -755,141 +789,68 @@ void BacktraceAnalysis::augment_use(
                                    const OperandSSAPtr &initial_use,
                                    const BaseInstructionSSAPtr &initial_instr) {
 
-    queue<OperandSSAPtr> work_queue;
-    OperandsSSAset seen;
+    // The def-use chain only depends on the function, hence it is shared
+    // by all queries tracking the same operand.
+    DefUseSummaryPtr summary = DefUseSummaryCache::get_instance().get_summary(
+                                                                function,
+                                                                initial_use,
+                                                                initial_instr);
+
+    const vector<DefUseStep> &steps = summary->steps;
+
+    // Determine the steps on a path to the initial instruction if the
+    // specialization prunes the graph.
+    const bool prune = prune_during_augment_use();
+    vector<bool> relevant_steps;
+    BaseInstructionSSAPtrSet reached_instrs;
+    if(prune) {
+        select_def_use_steps(steps,
+                             initial_use,
+                             initial_instr,
+                             relevant_steps,
+                             reached_instrs);
+    }
 
-    work_queue.push(initial_use);
-    while(true) {
-        if(work_queue.empty()) {
-            break;
+    for(size_t i = 0; i < steps.size(); i++) {
+        const DefUseStep &step = steps[i];
+
+        // Nodes are created in the same order as without pruning.
+        const bool add_use = !prune || reached_instrs.find(step.use_instr)
+                                                    != reached_instrs.cend();
+        const bool add_def = !prune || reached_instrs.find(step.def_instr)
+                                                    != reached_instrs.cend();
+
+        // Add edge def_instruction -> use_instruction.
+        GraphDataFlow::vertex_descriptor use_node = 0;
+        if(add_use) {
+            use_node = get_maybe_new_node_graph(graph,
+                                                instr_graph_node_map,
+                                                step.use_instr);
+            graph[use_node].type = DataFlowNodeTypeNormal;
         }
-
-        OperandSSAPtr &use_op = work_queue.front();
-
-        if(seen.find(use_op) != seen.end()) {
-            work_queue.pop();
-            continue;
+        GraphDataFlow::vertex_descriptor def_node = 0;
+        if(add_def) {
+            def_node = get_maybe_new_node_graph(graph,
+                                                instr_graph_node_map,
+                                                step.def_instr);
+            graph[def_node].type = DataFlowNodeTypeNormal;
         }
-
-        seen.insert(use_op);
-
-        BaseInstructionSSAPtrSet def_instrs =
-                                      function.get_instrs_define_op_ssa(use_op);
-
-        // Set of operand uses we want to track.
-        OperandsSSAset use_ops;
-        use_ops.insert(use_op);
-
-        // Follow also the memory base register definition.
-        // We kind of "overtaint" here.
-        // Track both "rax" and "[rax-8]" in case of "mov [rax-8], rdi".
-        if(use_op->is_memory()) {
-            switch(use_op->get_type()) {
-                case SSAOpTypeMemoryX64: {
-                    const RegisterX64SSA &temp =
-                          static_cast<const MemoryX64SSA &>(*use_op).get_base();
-                    OperandSSAPtr base =
-                                        make_shared<const RegisterX64SSA>(temp);
-                    const BaseInstructionSSAPtrSet &mem_instrs =
-                                        function.get_instrs_define_op_ssa(base);
-                    def_instrs.insert(mem_instrs.begin(), mem_instrs.end());
-
-                    // Consider base of memory also as "use" (this is important
-                    // for example if we start our backtrace analysis from
-                    // a "definition" via memory object like mov [rax-8], rdi
-                    // where [rax-8] is our starting operand).
-                    use_ops.insert(base);
-                    break;
-                }
-                default:
-                    throw runtime_error("Unknown SSA memory object.");
-            }
+        if(prune && !relevant_steps[i]) {
+            continue;
         }
 
-        for(const OperandSSAPtr &track_op : use_ops) {
-            for(const BaseInstructionSSAPtr &use_instr :
-                                     function.get_instrs_use_op_ssa(track_op)) {
-                for(const BaseInstructionSSAPtr &def_instr : def_instrs) {
-
-                    // Only draw an edge with the operand if the definition
-                    // instruction actually defines the operand. For example,
-                    // mov rbx_69, [rbp_11-f0] -> mov rsi_88, [rbx_69+0]
-                    // would otherwise draw an edge with "rbx_69" and
-                    // "[rbx_69+0]". We only want the edge with "rbx_69".
-                    bool skip_edge = true;
-                    for(const OperandSSAPtr &op : def_instr->get_definitions()) {
-                        if(*op == *track_op) {
-                            skip_edge = false;
-                            break;
-                        }
-                    }
-                    if(skip_edge) {
-                        continue;
-                    }
-
-                    // Add edge def_instruction -> use_instruction.
-                    GraphDataFlow::vertex_descriptor use_node =
-                                            get_maybe_new_node_graph(
-                                                           graph,
-                                                           instr_graph_node_map,
-                                                           use_instr);
-                    graph[use_node].type = DataFlowNodeTypeNormal;
-                    GraphDataFlow::vertex_descriptor def_node =
-                                            get_maybe_new_node_graph(
-                                                           graph,
-                                                           instr_graph_node_map,
-                                                           def_instr);
-                    graph[def_node].type = DataFlowNodeTypeNormal;
-
-                    // Ignore cases in which the def and use node are the same.
-                    // This can happen because in cases of "[rbp_11-f0]"
-                    // we track also "rbp_11" back and therefore
-                    // instructions like mov "[rbp_11-f0], rcx_72"
-                    // have also a edge to itself with "rbp_11".
-                    if(def_node == use_node) {
-                        continue;
-                    }
-
-                    GraphDataFlow::edge_descriptor new_edge =
-                                                  get_maybe_new_edge_graph(
-                                                                      graph,
-                                                                      def_node,
-                                                                      use_node,
-                                                                      track_op);
-                    graph[new_edge].type = DataFlowEdgeTypeOperand;
-
-                    // Add definitions to operand uses to track next.
-                    for(const OperandSSAPtr next_op : def_instr->get_uses()) {
-
-                        work_queue.push(next_op);
-
-                        // Follow also the memory base register definition.
-                        // We kind of "overtaint" here.
-                        // Track both "rax" and "[rax-8]"
-                        // in case of "mov [rax-8], rdi".
-                        if(next_op->is_memory()) {
-                            switch(next_op->get_type()) {
-                                case SSAOpTypeMemoryX64: {
-                                    const RegisterX64SSA &temp =
-                                          static_cast<const MemoryX64SSA &>(
-                                                           *next_op).get_base();
-                                    work_queue.push(
-                                           make_shared<const RegisterX64SSA>(
-                                                                         temp));
-                                    break;
-                                }
-                                default:
-                                    throw runtime_error("Unknown SSA memory "\
-                                                        "object.");
-                            }
-                        }
-                    }
-                }
-            }
+        // Ignore cases in which the def and use node are the same
+        // (see `DefUseSummaryCache::create_summary()`).
+        if(def_node == use_node) {
+            continue;
         }
 
-        // Pop current processed operand.
-        work_queue.pop();
+        GraphDataFlow::edge_descriptor new_edge =
+                                          get_maybe_new_edge_graph(graph,
+                                                                   def_node,
+                                                                   use_node,
+                                                                   step.operand);
+        graph[new_edge].type = DataFlowEdgeTypeOperand;
     }
 
     // If operand could not be tracked (for example, if we start tracking rdi_0,
@@ -907,6 +868,58 @@ void BacktraceAnalysis::augment_use(
     graph[initial_node].type = DataFlowNodeTypeStart;
 }
 
+void BacktraceAnalysis::select_def_use_steps(
+                                 const vector<DefUseStep> &steps,
+                                 const OperandSSAPtr &initial_use,
+                                 const BaseInstructionSSAPtr &initial_instr,
+                                 vector<bool> &out_relevant_steps,
+                                 BaseInstructionSSAPtrSet &out_reached_instrs) {
+
+    // Relevant steps by their use instruction.
+    unordered_map<BaseInstructionSSAPtr,
+                  vector<uint32_t>,
+                  SSAPtrDeref::Hash,
+                  SSAPtrDeref::Compare> steps_by_use;
+    for(uint32_t i = 0; i < steps.size(); i++) {
+        if(is_def_use_step_relevant(steps[i], initial_use, initial_instr)) {
+            steps_by_use[steps[i].use_instr].push_back(i);
+        }
+    }
+
+    // Walk the relevant steps backwards from the initial instruction.
+    out_relevant_steps.assign(steps.size(), false);
+    out_reached_instrs.clear();
+    out_reached_instrs.insert(initial_instr);
+    vector<BaseInstructionSSAPtr> work_list;
+    work_list.push_back(initial_instr);
+    while(!work_list.empty()) {
+        const BaseInstructionSSAPtr instr = work_list.back();
+        work_list.pop_back();
+
+        const auto it = steps_by_use.find(instr);
+        if(it == steps_by_use.cend()) {
+            continue;
+        }
+        for(uint32_t idx : it->second) {
+            out_relevant_steps[idx] = true;
+            if(out_reached_instrs.insert(steps[idx].def_instr).second) {
+                work_list.push_back(steps[idx].def_instr);
+            }
+        }
+    }
+}
+
+bool BacktraceAnalysis::prune_during_augment_use() const {
+    return false;
+}
+
+bool BacktraceAnalysis::is_def_use_step_relevant(
+                                          const DefUseStep&,
+                                          const OperandSSAPtr&,
+                                          const BaseInstructionSSAPtr&) const {
+    return true;
+}
+
 GraphDataFlow::vertex_descriptor BacktraceAnalysis::get_maybe_new_node_graph(
                                         GraphDataFlow &graph,
                                         InstrGraphNodeMap &instr_graph_node_map,
@@ -917,9 +930,10 @@ GraphDataFlow::vertex_descriptor BacktraceAnalysis::get_maybe_new_node_graph(
            && "Graph corrupt. Does not have the same size as instruction map.");
 
     // Check if we already have the given instruction in our graph.
-    if(instr_graph_node_map.find(instr) != instr_graph_node_map.end()) {
+    const auto node_it = instr_graph_node_map.find(instr);
+    if(node_it != instr_graph_node_map.end()) {
 
-        GraphDataFlow::vertex_descriptor node = instr_graph_node_map[instr];
+        GraphDataFlow::vertex_descriptor node = node_it->second;
 
         stringstream err_msg;
         if(*(graph[node].instr) != *instr) {
@@ -930,18 +944,36 @@ GraphDataFlow::vertex_descriptor BacktraceAnalysis::get_maybe_new_node_graph(
             throw runtime_error(err_msg.str().c_str());
         }
 
+        // The caller can change the attributes of the returned node.
+        if(&graph == &_graph && _journal.active) {
+            GraphJournalEntry entry;
+            entry.type = GraphJournalChangeVertex;
+            entry.vertex = node;
+            entry.node_data = graph[node];
+            _journal.entries.push_back(entry);
+        }
+
         return node;
     }
 
     // If we work on the final graph object, set indexmap as dirty.
     if(&graph == &_graph) {
         _indexmap_dirty = true;
+        _graph_csr_dirty = true;
     }
 
     // Create new cfg node.
     GraphDataFlow::vertex_descriptor new_vertex = boost::add_vertex(graph);
     graph[new_vertex].instr = instr;
     instr_graph_node_map[instr] = new_vertex;
+
+    if(&graph == &_graph && _journal.active) {
+        GraphJournalEntry entry;
+        entry.type = GraphJournalAddVertex;
+        entry.vertex = new_vertex;
+        _journal.entries.push_back(entry);
+    }
+
     return new_vertex;
 }
 
@@ -951,6 +983,12 @@ GraphDataFlow::edge_descriptor BacktraceAnalysis::get_maybe_new_edge_graph(
                                     const GraphDataFlow::vertex_descriptor &dst,
                                     const OperandSSAPtr &operand) {
 
+    // The caller can change the returned edge, hence the frozen graph
+    // has to be rebuilt.
+    if(&graph == &_graph) {
+        _graph_csr_dirty = true;
+    }
+
     // To make it more efficient we first check if no edge exists
     // and create a new one if it does not.
     auto edge = boost::edge(src, dst, graph);
@@ -958,13 +996,13 @@ GraphDataFlow::edge_descriptor BacktraceAnalysis::get_maybe_new_edge_graph(
         GraphDataFlow::edge_descriptor new_edge =
                                          boost::add_edge(src, dst, graph).first;
         graph[new_edge].operand = operand;
-        return new_edge;
+        return journal_edge(graph, new_edge, true);
     }
 
     // Check if the found edge is the one we are searching for and return
     // it if it is.
     if(*(graph[edge.first].operand) == *operand) {
-        return edge.first;
+        return journal_edge(graph, edge.first, false);
     }
 
     // Since we can have multiple edges with different metadata, search
@@ -976,7 +1014,7 @@ GraphDataFlow::edge_descriptor BacktraceAnalysis::get_maybe_new_edge_graph(
         if(temp_src == src
            && temp_dst == dst
            && *(graph[*it].operand) == *operand) {
-            return *it;
+            return journal_edge(graph, *it, false);
         }
     }
 
@@ -985,9 +1023,67 @@ GraphDataFlow::edge_descriptor BacktraceAnalysis::get_maybe_new_edge_graph(
     GraphDataFlow::edge_descriptor new_edge =
                                      boost::add_edge(src, dst, graph).first;
     graph[new_edge].operand = operand;
-    return new_edge;
+    return journal_edge(graph, new_edge, true);
+}
+
+GraphDataFlow::edge_descriptor BacktraceAnalysis::journal_edge(
+                                     const GraphDataFlow &graph,
+                                     const GraphDataFlow::edge_descriptor &edge,
+                                     bool is_new) {
+    if(&graph == &_graph && _journal.active) {
+        GraphJournalEntry entry;
+        entry.type = is_new ? GraphJournalAddEdge : GraphJournalChangeEdge;
+        entry.edge = edge;
+        if(!is_new) {
+            entry.edge_data = graph[edge];
+        }
+        _journal.entries.push_back(entry);
+    }
+    return edge;
+}
+
+void BacktraceAnalysis::begin_graph_transaction() {
+    _journal.active = true;
+    _journal.entries.clear();
+}
+
+void BacktraceAnalysis::commit_graph_transaction() {
+    _journal.active = false;
+    _journal.entries.clear();
+}
+
+void BacktraceAnalysis::rollback_graph_transaction() {
+    _journal.active = false;
+
+    // Undo the changes in reverse order (edges added to a node are
+    // removed before the node itself).
+    for(auto it = _journal.entries.crbegin();
+        it != _journal.entries.crend();
+        ++it) {
+        switch(it->type) {
+            case GraphJournalChangeVertex:
+                _graph[it->vertex] = it->node_data;
+                break;
+            case GraphJournalChangeEdge:
+                _graph[it->edge] = it->edge_data;
+                break;
+            case GraphJournalAddEdge:
+                boost::remove_edge(it->edge, _graph);
+                break;
+            case GraphJournalAddVertex:
+                _instr_graph_node_map.erase(_graph[it->vertex].instr);
+                boost::remove_vertex(it->vertex, _graph);
+                break;
+        }
+    }
+    _journal.entries.clear();
+
+    _indexmap_dirty = true;
+    _graph_csr_dirty = true;
 }
 
+
+
 void BacktraceAnalysis::dump_graph(const GraphDataFlow &graph,
                                    const std::string &file_name) {
     ofstream dump_file;
@@ -1002,6 +1098,56 @@ void BacktraceAnalysis::dump_graph(const GraphDataFlow &graph,
     dump_file.close();
 }
 
+void BacktraceAnalysis::capture_graph(const GraphDataFlow &graph,
+                                      GraphCaptureStage stage,
+                                      const TrackingInstruction *curr,
+                                      uint64_t function_addr) {
+    GraphCaptureRecord record;
+    record.analysis = _dir_prefix;
+    record.start_addr = _start_addr;
+    record.round = _round;
+    record.stage = stage;
+    if(curr != nullptr) {
+        stringstream operand;
+        operand << *curr->operand;
+        record.tracking_type = curr->type;
+        record.function_addr = function_addr;
+        record.instr_addr = curr->addr;
+        record.operand = operand.str();
+    }
+
+    unordered_map<GraphDataFlow::vertex_descriptor, uint32_t> indices;
+    const auto vertices = boost::vertices(graph);
+    for(auto it = vertices.first; it != vertices.second; ++it) {
+        stringstream label;
+        label << *graph[*it].instr;
+
+        GraphCaptureNode node;
+        node.label = label.str();
+        node.comment = graph[*it].comment;
+        node.type = graph[*it].type;
+        node.is_join = graph[*it].is_join;
+        indices[*it] = record.nodes.size();
+        record.nodes.push_back(move(node));
+    }
+
+    const auto edges = boost::edges(graph);
+    for(auto it = edges.first; it != edges.second; ++it) {
+        stringstream label;
+        label << *graph[*it].operand;
+
+        GraphCaptureEdge edge;
+        edge.src = indices.at(boost::source(*it, graph));
+        edge.dst = indices.at(boost::target(*it, graph));
+        edge.type = graph[*it].type;
+        edge.label = label.str();
+        edge.comment = graph[*it].comment;
+        record.edges.push_back(move(edge));
+    }
+
+    GraphCapture::get_instance().add_graph(record);
+}
+
 GraphDataFlow::vertex_descriptor BacktraceAnalysis::get_node_graph(
                                   const GraphDataFlow &graph,
                                   const InstrGraphNodeMap &instr_graph_node_map,
@@ -1035,6 +1181,7 @@ GraphDataFlow::vertex_descriptor BacktraceAnalysis::get_node_graph(
 
 void BacktraceAnalysis::merge_graphs(const GraphDataFlow &graph) {
     NodeToNodeMap old_new_map;
+    old_new_map.reserve(boost::num_vertices(graph));
 
     // Copy all nodes to the final graph.
     const auto vertices = boost::vertices(graph);
@@ -1561,89 +1708,41 @@ void BacktraceAnalysis::prepare_ret_tracking_instrs(
         }
         const Function &target_func = *target_func_ptr;
 
-        // Search all return instructions of the called function
-        // of the subcall and add their uses to the instructions
-        // that are tracked next. Additionally, if the called function has a
-        // tail jump into another function, we have to process the
-        // return instructions of this function too.
-        for(const auto &kv : target_func.get_blocks_ssa()) {
-            const BlockSSAPtr &block = kv.second;
-            const BaseInstructionSSAPtrs &instrs = block->get_instructions();
-            if(instrs.empty()) {
-                continue;
+        // Add the uses of all return instructions of the called function
+        // to the instructions that are tracked next. Additionally, if the
+        // called function has a tail jump into another function, we have
+        // to process the return instructions of this function too
+        // (both are taken from the summary built by the `Translator`).
+        const FunctionReturnSummary &summary = target_func.get_return_summary();
+        for(const BaseInstructionSSAPtr &ret_instr : summary.ret_instrs) {
+            for(const OperandSSAPtr &use_op : ret_instr->get_uses()) {
+                TrackingInstruction new_track;
+                new_track.addr = ret_instr->get_address();
+                new_track.instr_type = ret_instr->get_type();
+                new_track.prev_node = call_node;
+                new_track.operand = use_op;
+                new_track.type = TrackingTypeRet;
+                new_track.transition_order = transition_order;
+                out_next_instrs.insert(new_track);
             }
-            // Return instruction is always the
-            // last instruction of a basic block.
-            const BaseInstructionSSAPtr &last_instr = instrs.back();
-            if(last_instr->is_ret()) {
-                for(const OperandSSAPtr &use_op : last_instr->get_uses()) {
-                    TrackingInstruction new_track;
-                    new_track.addr = last_instr->get_address();
-                    new_track.instr_type = last_instr->get_type();
-                    new_track.prev_node = call_node;
-                    new_track.operand = use_op;
-                    new_track.type = TrackingTypeRet;
-                    new_track.transition_order = transition_order;
-                    out_next_instrs.insert(new_track);
-                }
-            }
-
-            // Process tail jumps.
-            else if(last_instr->is_unconditional_jmp()) {
-
-                // Extract target address of jump operand.
-                const OperandSSAPtr &jmp_op = last_instr->get_operand(0);
-                uint64_t jmp_target_addr = 0;
-                switch(jmp_op->get_type()) {
-                    case SSAOpTypeConstantX64: {
-                        const ConstantX64SSA &temp =
-                                    static_cast<const ConstantX64SSA&>(*jmp_op);
-                        jmp_target_addr = temp.get_value();
-                        break;
-                    }
-                    case SSAOpTypeAddressX64: {
-                        const AddressX64SSA &temp =
-                                     static_cast<const AddressX64SSA&>(*jmp_op);
-                        jmp_target_addr = temp.get_value();
-                        break;
-                    }
-                    default:
-                        break;
-                }
+        }
 
-                // Check if we have a tail jump in the function.
-                if(jmp_target_addr != 0
-                   && !target_func.contains_address(jmp_target_addr)) {
-
-                    // Add target function to the processing list.
-                    // NOTE: This overestimates the reached return instructions.
-                    // For example, the tail jump can jump into the last
-                    // basic block of a function that has a return instruction.
-                    // Because we process the whole function, we add all
-                    // return instructions of the function as a possible
-                    // next instruction.
-                    try {
-                        const Function &jmp_func =
-                           _translator.get_containing_function(jmp_target_addr);
-                        TargetAddr next_target;
-                        next_target.addr = jmp_func.get_entry();
-                        next_target.transition_order = transition_order;
-
-                        // Use jump instruction address as next transition order
-                        // address.
-                        next_target.transition_order.push_back(
-                                                     last_instr->get_address());
-
-                        target_addrs.push_back(next_target);
-                    }
-                    catch(...) {
-#if DEBUG_PRINT
-                        cerr << "Did not find a function for tail jump target "
-                             << hex << jmp_target_addr << "\n";
-#endif
-                    }
-                }
-            }
+        // NOTE: This overestimates the reached return instructions.
+        // For example, the tail jump can jump into the last
+        // basic block of a function that has a return instruction.
+        // Because we process the whole function, we add all
+        // return instructions of the function as a possible
+        // next instruction.
+        for(const FunctionTailJmp &tail_jmp : summary.tail_jmps) {
+            TargetAddr next_target;
+            next_target.addr = tail_jmp.target_entry;
+            next_target.transition_order = transition_order;
+
+            // Use jump instruction address as next transition order
+            // address.
+            next_target.transition_order.push_back(tail_jmp.jmp_addr);
+
+            target_addrs.push_back(next_target);
         }
     }
 }
@@ -1693,6 +1792,11 @@ void BacktraceAnalysis::remove_node_graph(
                                  InstrGraphNodeMap &instr_graph_node_map,
                                  const GraphDataFlow::vertex_descriptor &node) {
 
+    if(&graph == &_graph && _journal.active) {
+        throw runtime_error("Nodes can not be removed from the final graph "\
+                            "during a transaction.");
+    }
+
     // Remove all incoming and outgoing edges to the node
     // (Boost does not offer a function for directed graphs
     // for this operation :( ).
@@ -1712,6 +1816,7 @@ void BacktraceAnalysis::remove_node_graph(
     // If we work on the final graph object, set indexmap to dirty.
     if(&graph == &_graph) {
         _indexmap_dirty = true;
+        _graph_csr_dirty = true;
     }
 }
 
@@ -1772,6 +1877,58 @@ void BacktraceAnalysis::update_indexmap() {
     }
 }
 
+const DataFlowGraphCSR &BacktraceAnalysis::get_graph_csr() {
+    if(_graph_csr_dirty) {
+        _graph_csr.freeze(_graph);
+        _graph_csr_dirty = false;
+    }
+    return _graph_csr;
+}
+
+void DataFlowGraphCSR::freeze(const GraphDataFlow &graph) {
+    const uint32_t num_vertices = boost::num_vertices(graph);
+    _vertices.clear();
+    _vertices.reserve(num_vertices);
+    _ids.clear();
+    _ids.reserve(num_vertices);
+    _instr_types.clear();
+    _instr_types.reserve(num_vertices);
+    _instr_is_call.clear();
+    _instr_is_call.reserve(num_vertices);
+    _instr_addrs.clear();
+    _instr_addrs.reserve(num_vertices);
+
+    const auto vertices = boost::vertices(graph);
+    for(auto it = vertices.first; it != vertices.second; ++it) {
+        _ids[*it] = _vertices.size();
+        _vertices.push_back(*it);
+
+        const BaseInstructionSSAPtr &instr = graph[*it].instr;
+        _instr_types.push_back(instr->get_type());
+        _instr_is_call.push_back(instr->is_call());
+        _instr_addrs.push_back(instr->get_address());
+    }
+
+    _out_offsets.clear();
+    _out_offsets.reserve(num_vertices + 1);
+    _out_targets.clear();
+    _out_targets.reserve(boost::num_edges(graph));
+    _out_is_ret.clear();
+    _out_is_ret.reserve(boost::num_edges(graph));
+    for(GraphDataFlow::vertex_descriptor vertex : _vertices) {
+        _out_offsets.push_back(_out_targets.size());
+        const auto out_edges = boost::out_edges(vertex, graph);
+        for(auto edge_it = out_edges.first;
+            edge_it != out_edges.second;
+            ++edge_it) {
+            _out_targets.push_back(_ids.at(boost::target(*edge_it, graph)));
+            _out_is_ret.push_back(graph[*edge_it].type
+                                  == DataFlowEdgeTypeRet);
+        }
+    }
+    _out_offsets.push_back(_out_targets.size());
+}
+
 const InstrGraphNodeMap &BacktraceAnalysis::get_graph_instr_map() const {
     return _instr_graph_node_map;
 }
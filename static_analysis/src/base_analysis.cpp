@@ -21,6 +21,7 @@ BaseAnalysis::BaseAnalysis(const Function &function,
                            FileFormatType file_format)
     : _function(function),
       _file_format(file_format),
+      _abi(get_abi(file_format)),
       _current_return_value(nullptr) {
 
     _initial_state.set_initial_state();
@@ -44,8 +45,8 @@ BaseAnalysis::BaseAnalysis(const Function &function,
  * \brief Runs the analysis.
  *
  * The traversal callback `BaseAnalysis::on_traversal` also handles
- * updates on the state across function calls. Currently, System V is assumed
- * per default.
+ * updates on the state across function calls (according to the calling
+ * convention of the file format).
  *
  * \see `BaseAnalysis::on_traversal`
  *
@@ -93,7 +94,7 @@ bool BaseAnalysis::on_traversal(const Path &path, const Block &block) {
         // Handle side-effects as caused by the calling convention used.
         const auto &side_effect = _side_effects.find(preceding_path);
         if(side_effect != _side_effects.cend()) {
-            new_state.purge_scratch_registers(_file_format);
+            new_state.purge_scratch_registers(_abi);
             new_state.merge(side_effect->second);
         }
     }
@@ -103,8 +104,8 @@ bool BaseAnalysis::on_traversal(const Path &path, const Block &block) {
     case TerminatorCall:
     case TerminatorCallUnresolved: {
 
-        auto formatted = State::format_return_value(block.get_address());
-        _current_return_value = make_shared<Symbolic>(formatted);
+        _current_return_value = make_symbolic(SymbolicReturnValue,
+                                              block.get_address());
 
         is_call = true;
         break;
@@ -121,12 +122,12 @@ bool BaseAnalysis::on_traversal(const Path &path, const Block &block) {
 
     // Handle calls specially as they introduce side-effects.
     if(is_call) {
-        State::iterator needle;
+        State::const_iterator needle;
         if(new_state.find(register_rip, needle)) {
             // Construct an empty state which will contain side-effects only.
             State side_effects(false);
 
-            side_effects.update(register_rax, _current_return_value);
+            side_effects.update(_abi.return_value, _current_return_value);
             _side_effects[path] = side_effects;
         }
     }
@@ -136,7 +137,7 @@ bool BaseAnalysis::on_traversal(const Path &path, const Block &block) {
 
     if(terminator.is_tail || terminator.type == TerminatorReturn) {
         new_state.erase(register_rip);
-        new_state.purge_scratch_registers(_file_format);
+        new_state.purge_scratch_registers(_abi);
 
         _semantics.push_back(new_state);
     } else {
@@ -1,4 +1,5 @@
 #include "binary_cps.h"
+#include "logger.h"
 
 using namespace std;
 
@@ -6,6 +7,47 @@ queue<BinaryCPSVfunc> queue_vfunc_addrs;
 mutex queue_vfunc_mtx;
 vector<BinaryCPSVfunc> dtor_candidates;
 mutex dtor_candidates_mtx;
+VtableWriteMemo vtable_write_memo;
+
+/*!
+ * \brief Returns the memoized result for the given candidate and computes
+ * it with `compute` if no thread did so before.
+ */
+bool VtableWriteMemo::get(const BinaryCPSVfunc &candidate,
+                          const function<bool()> &compute) {
+    promise<bool> result;
+    shared_future<bool> future;
+    {
+        lock_guard<mutex> _(_mtx);
+        auto it = _results.find(candidate);
+        if(it != _results.end()) {
+            future = it->second;
+        }
+        else {
+            _results[candidate] = result.get_future().share();
+        }
+    }
+
+    // Another thread computes (or computed) the result.
+    if(future.valid()) {
+        return future.get();
+    }
+
+    try {
+        bool value = compute();
+        result.set_value(value);
+        return value;
+    }
+    catch(...) {
+        result.set_exception(current_exception());
+        throw;
+    }
+}
+
+void VtableWriteMemo::clear() {
+    lock_guard<mutex> _(_mtx);
+    _results.clear();
+}
 
 void binary_cps_analysis(const string &target_file,
                          const string &module_name,
@@ -14,22 +56,25 @@ void binary_cps_analysis(const string &target_file,
                          uint32_t num_threads) {
 
     // Set up queue with all virtual function addresses
-    // that have to be analyzed.
-    queue_vfunc_mtx.lock();
+    // that have to be analyzed. Destructors call the destructors of their
+    // base classes, hence callees are analyzed first.
+    vector<BinaryCPSVfunc> candidates;
     for(const auto &kv : analysis_obj.vtable_file.get_this_vtables()) {
         for(uint64_t entry : kv.second->entries) {
 
             BinaryCPSVfunc candidate;
             candidate.vtbl_idx = kv.second->index;
             candidate.addr = entry;
-            queue_vfunc_addrs.push(candidate);
+            candidates.push_back(candidate);
         }
     }
+    queue_vfunc_mtx.lock();
+    for(const BinaryCPSVfunc &candidate
+        : order_callee_first(analysis_obj.translator, candidates)) {
+        queue_vfunc_addrs.push(candidate);
+    }
     queue_vfunc_mtx.unlock();
 
-    // TODO FOR DEBUGGING
-    num_threads = 1;
-
     // Analyze all virtual functions.
     // For debugging purposes do not spawn any thread.
     if(num_threads == 1) {
@@ -52,6 +97,9 @@ void binary_cps_analysis(const string &target_file,
         }
         delete [] all_threads;
     }
+
+    // Write the pending messages of the workers.
+    Logger::get_instance().flush();
 }
 
 void binary_cps_dtor_analysis(const string &module_name,
@@ -59,10 +107,9 @@ void binary_cps_dtor_analysis(const string &module_name,
                               EngelsAnalysisObjects &analysis_obj,
                               uint32_t thread_number) {
 
-    cout << "Starting dtor analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << "\n";
+    LOG_INFO("Starting dtor analysis (Thread: "
+             << dec << thread_number
+             << ")");
 
     while(true) {
 
@@ -76,20 +123,19 @@ void binary_cps_dtor_analysis(const string &module_name,
         candidate = queue_vfunc_addrs.front();
         uint64_t vfunc_addr = candidate.addr;
         queue_vfunc_addrs.pop();
-        cout << "Analyzing virtual function at address: "
-             << hex << vfunc_addr
-             << ". Remaining virtual functions to analyze: "
-             << dec << queue_vfunc_addrs.size()
-             << " (Thread: " << dec << thread_number << ")"
-             << "\n";
+        LOG_PROGRESS("Analyzing virtual function at address: "
+                     << hex << vfunc_addr
+                     << ". Remaining virtual functions to analyze: "
+                     << dec << queue_vfunc_addrs.size()
+                     << " (Thread: " << dec << thread_number << ")");
         queue_vfunc_mtx.unlock();
 
 
         // Check if we have a vtable write into the this ptr object.
-        if(has_vtable_write(module_name,
-                            target_dir,
-                            analysis_obj,
-                            candidate)) {
+        if(has_vtable_write_memo(module_name,
+                                 target_dir,
+                                 analysis_obj,
+                                 candidate)) {
 
             dtor_candidates_mtx.lock();
             dtor_candidates.push_back(candidate);
@@ -98,10 +144,104 @@ void binary_cps_dtor_analysis(const string &module_name,
 
     }
 
-    cout << "Finished dtor analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << "\n";
+    LOG_INFO("Finished dtor analysis (Thread: "
+             << dec << thread_number
+             << ")");
+}
+
+/*!
+ * \brief Orders the candidates such that the functions called (or tail
+ * jumped to) by a candidate function precede it. Candidates of the same
+ * function are adjacent and keep their order, candidates without a function
+ * object are moved to the end.
+ */
+vector<BinaryCPSVfunc> order_callee_first(
+                                  const Translator &translator,
+                                  const vector<BinaryCPSVfunc> &candidates) {
+
+    const auto &functions = translator.get_functions();
+    unordered_map<uint64_t, vector<BinaryCPSVfunc>> func_candidates;
+    vector<uint64_t> func_addrs;
+    vector<BinaryCPSVfunc> unknown;
+    for(const BinaryCPSVfunc &candidate : candidates) {
+        auto it = func_candidates.find(candidate.addr);
+        if(it == func_candidates.end()) {
+            if(!functions.count(candidate.addr)) {
+                unknown.push_back(candidate);
+                continue;
+            }
+            func_addrs.push_back(candidate.addr);
+            it = func_candidates.emplace(candidate.addr,
+                                         vector<BinaryCPSVfunc>()).first;
+        }
+        it->second.push_back(candidate);
+    }
+
+    // Iterative post-order traversal of the call graph between the
+    // candidate functions.
+    vector<BinaryCPSVfunc> result;
+    result.reserve(candidates.size());
+    unordered_set<uint64_t> visited;
+    for(uint64_t start_addr : func_addrs) {
+        if(!visited.insert(start_addr).second) {
+            continue;
+        }
+
+        // Pairs of function address and its not yet visited callees.
+        vector<pair<uint64_t, vector<uint64_t>>> stack;
+        auto push = [&](uint64_t func_addr) {
+            vector<uint64_t> callees;
+            const Function &function = functions.at(func_addr);
+            for(const auto &kv : function.get_blocks()) {
+                const Terminator &terminator = kv.second->get_terminator();
+                if(terminator.type == TerminatorCall
+                   || (terminator.type == TerminatorJump
+                       && terminator.is_tail)) {
+                    if(func_candidates.count(terminator.target)) {
+                        callees.push_back(terminator.target);
+                    }
+                }
+            }
+            stack.emplace_back(func_addr, move(callees));
+        };
+
+        push(start_addr);
+        while(!stack.empty()) {
+            vector<uint64_t> &callees = stack.back().second;
+            if(callees.empty()) {
+                const auto &entries = func_candidates[stack.back().first];
+                result.insert(result.end(), entries.begin(), entries.end());
+                stack.pop_back();
+                continue;
+            }
+
+            uint64_t callee_addr = callees.back();
+            callees.pop_back();
+            if(visited.insert(callee_addr).second) {
+                push(callee_addr);
+            }
+        }
+    }
+
+    result.insert(result.end(), unknown.begin(), unknown.end());
+    return result;
+}
+
+/*!
+ * \brief Checks `has_vtable_write` for the given candidate, each (virtual
+ * function, vtable) pair is only analyzed once. \see `VtableWriteMemo`
+ */
+bool has_vtable_write_memo(const string &module_name,
+                           const string &target_dir,
+                           EngelsAnalysisObjects &analysis_obj,
+                           const BinaryCPSVfunc &candidate) {
+
+    return vtable_write_memo.get(candidate, [&]() -> bool {
+        return has_vtable_write(module_name,
+                                target_dir,
+                                analysis_obj,
+                                candidate);
+    });
 }
 
 bool has_vtable_write(const string &module_name,
@@ -174,8 +314,7 @@ bool has_vtable_write(const string &module_name,
     for(auto root_node : root_nodes) {
         vector<DataFlowPath> paths_root_vtable = create_dataflow_paths(
                                                   analysis_obj,
-                                                  graph,
-                                                  analysis.get_graph_indexmap(),
+                                                  analysis.get_graph_csr(),
                                                   root_node, // src
                                                   vtable_node); // dst
 
@@ -188,29 +327,25 @@ bool has_vtable_write(const string &module_name,
             paths_root_vtable.push_back(path);
         }
 
-        // Symbolically execute the instructions of the data flow path.
+        // Create paths of artificial basic blocks with just
+        // the instructions of our data flow paths.
+        vector<vector<BlockPtr>> paths_blocks;
+        paths_blocks.reserve(paths_root_vtable.size());
         for(const DataFlowPath &path : paths_root_vtable) {
+            paths_blocks.push_back(create_artificial_block_vector(analysis_obj,
+                                                                  graph,
+                                                                  path));
+        }
 
-            // Prepare state.
-            State state;
-            ExpressionPtr sym_this_ptr = make_shared<Symbolic>("this_ptr");
-            state.update(system_v_arguments[0], sym_this_ptr);
-
-            ExpressionPtr sym_this_ptr_indirect =
-                                         make_shared<Indirection>(sym_this_ptr);
-
-            // Create a path of artificial basic blocks with just
-            // the instruction of our data flow path.
-            vector<BlockPtr> path_blocks = create_artificial_block_vector(
-                                                                   analysis_obj,
-                                                                   graph,
-                                                                   path);
-
-            sym_execute_blocks(analysis_obj,
-                               path_blocks,
-                               state);
+        // Prepare state.
+        State initial_state;
+        ExpressionPtr sym_this_ptr = make_symbolic("this_ptr");
+        initial_state.update(analysis_obj.abi.this_argument(), sym_this_ptr);
 
-            Constant vtable_value(vtable.addr);
+        // Symbolically execute the instructions of the data flow paths
+        // (the paths share long prefixes which are only executed once).
+        Constant vtable_value(vtable.addr);
+        auto is_vtable_write = [&](size_t, State &state) -> bool {
             const auto &state_memory = state.get_memory_accesses();
             for(const auto &kv_mem : state_memory) {
                 if(*(kv_mem.second) == vtable_value) {
@@ -253,6 +388,14 @@ bool has_vtable_write(const string &module_name,
                     }
                 }
             }
+            return false;
+        };
+
+        if(sym_execute_block_paths(analysis_obj,
+                                   paths_blocks,
+                                   initial_state,
+                                   is_vtable_write)) {
+            return true;
         }
     }
 
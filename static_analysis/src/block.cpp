@@ -2,8 +2,12 @@
 #include "block.h"
 #include "block_semantics.h"
 
+#include <atomic>
+
 using namespace std;
 
+static atomic<uint64_t> next_block_id(0);
+
 /*!
  * \brief Prints the basic block to the given output stream.
  * \param stream The output stream to which the instruction is printed.
@@ -38,12 +42,18 @@ ostream &operator<<(ostream &stream, const Block &block) {
  * \param num_instructions Number of instructions this basic blocks hold.
  * Used if the vex blocks has been translated with more instructions than
  * we would like to store in this basic block.
+ *
+ * Blocks built this way are artificial blocks of single paths that are
+ * created anew for every path, hence they do not draw an id (see
+ * `get_id()`).
  */
 Block::Block(uintptr_t address,
-      IRSB *block,
+      const IRSB *block,
       const Terminator &terminator,
       uint32_t num_instructions)
-    : _address(address), _vex_block(block), _terminator(terminator) {
+    : _address(address), _id(BLOCK_ID_NONE), _vex_block(block),
+      _terminator(terminator),
+      _transfer_cache(make_shared<BlockTransferCache>()) {
 
     _num_instructions = num_instructions;
     uint32_t counter = 0;
@@ -66,8 +76,11 @@ Block::Block(uintptr_t address,
  * \param block Pointer to an `IRSB` VEX block.
  * \param terminator Description of the block's terminator.
  */
-Block::Block(uintptr_t address, IRSB *block, const Terminator &terminator)
-    : _address(address), _vex_block(block), _terminator(terminator) {
+Block::Block(uintptr_t address, const IRSB *block,
+             const Terminator &terminator)
+    : _address(address), _id(next_block_id++), _vex_block(block),
+      _terminator(terminator),
+      _transfer_cache(make_shared<BlockTransferCache>()) {
 
     // Extracts addresses of all instructions.
     for(int i = 0; i < _vex_block->stmts_used; ++i) {
@@ -93,6 +106,19 @@ void Block::retrieve_semantics(State &state) const {
     state = semantics.get_state();
 }
 
+/*!
+ * \brief Returns the block's transfer function.
+ *
+ * It is compiled from the VEX block on the first call (thread-safe) and
+ * reused for all paths through the block afterwards.
+ */
+const BlockTransfer &Block::get_transfer() const {
+    call_once(_transfer_cache->compiled, [&] {
+        _transfer_cache->transfer = make_shared<BlockTransfer>(*this);
+    });
+    return *_transfer_cache->transfer;
+}
+
 /*!
  * \brief get_last_address
  * \return Returns the block's last virtual address
@@ -1,4 +1,3 @@
-
 #include "block_semantics.h"
 #include "block.h"
 
@@ -10,36 +9,67 @@
 
 using namespace std;
 
-const map<IRExprTag, ExpressionParser> BlockSemantics::_expression_parser = {
-    { Iex_Get,   ExpressionParser(&BlockSemantics::parse_get) },
-    { Iex_GetI,  ExpressionParser(&BlockSemantics::parse_geti) },
-    { Iex_RdTmp, ExpressionParser(&BlockSemantics::parse_rdtmp) },
-    { Iex_Qop,   ExpressionParser(&BlockSemantics::parse_qop) },
-    { Iex_Triop, ExpressionParser(&BlockSemantics::parse_triop) },
-    { Iex_Binop, ExpressionParser(&BlockSemantics::parse_binop) },
-    { Iex_Unop,  ExpressionParser(&BlockSemantics::parse_unop) },
-    { Iex_Load,  ExpressionParser(&BlockSemantics::parse_load) },
-    { Iex_Const, ExpressionParser(&BlockSemantics::parse_const) },
-    { Iex_CCall, ExpressionParser(&BlockSemantics::parse_ccall) },
-    { Iex_ITE,   ExpressionParser(&BlockSemantics::parse_ite) },
-};
-
-const map<IRStmtTag, StatementHandler> BlockSemantics::_statement_handler = {
-    { Ist_NoOp,    StatementHandler(&BlockSemantics::handle_noop) },
-    { Ist_IMark,   StatementHandler(&BlockSemantics::handle_noop) },
-    { Ist_AbiHint, StatementHandler(&BlockSemantics::handle_abi_hint) },
-    { Ist_WrTmp,   StatementHandler(&BlockSemantics::handle_wrtmp) },
-    { Ist_Put,     StatementHandler(&BlockSemantics::handle_put) },
-    { Ist_PutI,    StatementHandler(&BlockSemantics::handle_puti) },
-    { Ist_Store,   StatementHandler(&BlockSemantics::handle_store) },
-    { Ist_StoreG,  StatementHandler(&BlockSemantics::handle_storeg) },
-    { Ist_LoadG,   StatementHandler(&BlockSemantics::handle_loadg) },
-    { Ist_CAS,     StatementHandler(&BlockSemantics::handle_noop) },
-    { Ist_LLSC,    StatementHandler(&BlockSemantics::handle_noop) },
-    { Ist_Dirty,   StatementHandler(&BlockSemantics::handle_noop) },
-    { Ist_MBE,     StatementHandler(&BlockSemantics::handle_noop) },
-    { Ist_Exit,    StatementHandler(&BlockSemantics::handle_noop) },
-};
+/*!
+ * \brief Returns the compiler of the given VEX expression tag (`nullptr` if
+ * the tag cannot be handled).
+ */
+ExpressionCompiler BlockTransfer::get_expression_compiler(IRExprTag tag) {
+    switch(tag) {
+    case Iex_Get:
+        return &BlockTransfer::compile_get;
+    case Iex_RdTmp:
+        return &BlockTransfer::compile_rdtmp;
+    case Iex_Binop:
+        return &BlockTransfer::compile_binop;
+    case Iex_Unop:
+        return &BlockTransfer::compile_unop;
+    case Iex_Load:
+        return &BlockTransfer::compile_load;
+    case Iex_Const:
+        return &BlockTransfer::compile_const;
+    case Iex_GetI:
+    case Iex_Qop:
+    case Iex_Triop:
+    case Iex_CCall:
+    case Iex_ITE:
+        return &BlockTransfer::compile_unknown;
+    default:
+        return nullptr;
+    }
+}
+
+/*!
+ * \brief Returns the compiler of the given VEX statement tag (`nullptr` if
+ * the tag cannot be handled).
+ */
+StatementCompiler BlockTransfer::get_statement_compiler(IRStmtTag tag) {
+    switch(tag) {
+    case Ist_AbiHint:
+        return &BlockTransfer::compile_abi_hint;
+    case Ist_WrTmp:
+        return &BlockTransfer::compile_wrtmp;
+    case Ist_Put:
+        return &BlockTransfer::compile_put;
+    case Ist_Store:
+        return &BlockTransfer::compile_store;
+    case Ist_NoOp:
+    case Ist_IMark:
+    // TODO: We may be able to handle PutI if details are constant.
+    // Possibly should invalidate all registers for correctness.
+    case Ist_PutI:
+    // TODO: How to handle guarded loads/stores?
+    case Ist_StoreG:
+    case Ist_LoadG:
+    case Ist_CAS:
+    case Ist_LLSC:
+    case Ist_Dirty:
+    case Ist_MBE:
+    case Ist_Exit:
+        return &BlockTransfer::compile_noop;
+    default:
+        return nullptr;
+    }
+}
 
 /*!
  * \brief Constructs a new `BlockSemantics` object and immediately computes
@@ -52,32 +82,37 @@ const map<IRStmtTag, StatementHandler> BlockSemantics::_statement_handler = {
  * \param initial_state The initial state based on which semantics are computed.
  */
 BlockSemantics::BlockSemantics(const Block &block, State &initial_state)
-    : _state(initial_state), _block(block), _unknown(make_shared<Unknown>()) {
-
-    _curr_addr = 0;
+    : _state(initial_state) {
 
-    if(!extract_semantics(block.get_vex_block())) {
+    if(!block.get_transfer().apply(_state)) {
         stringstream stream;
         stream << "Cannot extract semantics for block at "
                << hex << block.get_address() << "." << endl;
         throw runtime_error(stream.str());
     }
 }
-#define DEBUG_PRINT_STEPS 0
 
-bool BlockSemantics::extract_semantics(const IRSB &block) {
+/*!
+ * \brief Compiles the transfer function of the given block.
+ *
+ * Only the instructions the block holds are compiled (VEX may have
+ * translated more instructions than we want to hold in the basic block).
+ *
+ * \param block The block whose VEX block is compiled.
+ */
+BlockTransfer::BlockTransfer(const Block &block)
+    : _address(block.get_address()),
+      _terminator_type(block.get_terminator().type) {
+
+    // Node 0 is shared by all expressions with an unknown value.
+    add_expression(TransferExpressionUnknown);
 
-    uint32_t num_instructions = _block.get_num_instructions();
-    int stmts_used = block.stmts_used;
+    const IRSB &vex_block = block.get_vex_block();
+    uint32_t num_instructions = block.get_num_instructions();
     uint32_t curr_instr = 0;
-    for(auto i = 0; i < stmts_used; ++i) {
-        const auto &current = *block.stmts[i];
-
-        // Abort any further execution of the vex block
-        // if we reached the number of instructions we are
-        // holding in our basic block.
-        // NOTE: Can happen if the vex block translated more instructions
-        // than we want to hold in the basic block.
+    for(auto i = 0; i < vex_block.stmts_used; ++i) {
+        const auto &current = *vex_block.stmts[i];
+
         if(current.tag == Ist_IMark) {
             if(curr_instr >= num_instructions) {
                 break;
@@ -86,64 +121,306 @@ bool BlockSemantics::extract_semantics(const IRSB &block) {
             curr_instr++;
         }
 
-#if DEBUG_PRINT_STEPS
-        cout << string(79, '=') << endl;
-        ppIRStmt(&current);
-        cout << endl;
-#endif
+        // Statements after one that cannot be handled are never reached.
+        if(!compile_statement(current)) {
+            break;
+        }
+    }
+}
+
+#define DEBUG_PRINT_STEPS 0
+
+/*!
+ * \brief Applies the transfer function to the given state.
+ *
+ * If a statement of the block cannot be handled, an exception of type
+ * `runtime_error` is thrown.
+ *
+ * \param[in,out] state The incoming state, updated with the block's
+ * semantics.
+ * \return `true`, if the semantics could be extracted; `false`, otherwise.
+ */
+bool BlockTransfer::apply(State &state) const {
+    const ExpressionPtr unknown = make_shared<Unknown>();
+
+    for(const auto &current : _statements) {
+        switch(current.type) {
+        case TransferStatementWrTmp: {
+            const auto e = evaluate(current.data, state, unknown);
+            const auto dst = make_temporary(current.target);
+
+            if(e->type() == ExpressionUnknown) {
+                state.erase(dst);
+                break;
+            }
+
+            state.update(dst, e);
+            break;
+        }
+
+        case TransferStatementPut: {
+            const auto e = evaluate(current.data, state, unknown);
+            const auto d = make_register(current.target);
+
+            // If destination is a register, store a symbolic value
+            // which states that we do not know tha value.
+            if(e->type() == ExpressionUnknown) {
+                state.update(d, make_symbolic(current.unknown_kind,
+                                              current.unknown_address));
+                break;
+            }
+
+            state.update(d, e);
+            break;
+        }
+
+        case TransferStatementStore: {
+            const auto e = evaluate(current.data, state, unknown);
+            const auto d = evaluate(current.target, state, unknown);
+
+            if(d->type() == ExpressionUnknown) {
+                break;
+            }
+
+            const auto dst = make_shared<Indirection>(d);
+            if(e->type() == ExpressionUnknown) {
+                state.erase(dst);
+                break;
+            }
+
+            // Special case in which we check if the key value would
+            // be [0x0]. This can happen because we ignore checks and
+            // can reach states that would not be reachable in the normal
+            // control-flow (i.e., because it is checked that rax != 0 before
+            // executing mov [rax], <something>).
+            if(d->type() == ExpressionConstant) {
+                const Constant &temp = static_cast<Constant &>(*d);
+                if(temp.value() == 0) {
+                    state.erase(dst);
+                    break;
+                }
+            }
+
+            state.update(dst, e);
+            break;
+        }
 
-        if(!handle_statement(current)) {
+        case TransferStatementAbiHint: {
+            const auto target = evaluate(current.data, state, unknown);
+
+            State::const_iterator needle;
+            ExpressionPtr rsp_value;
+            if(state.find(register_rsp, needle)) {
+                if(needle->second->type() == ExpressionUnknown) {
+                    return false;
+                }
+                rsp_value = needle->second;
+            }
+            // When we can not find the rsp, replace it with an unknown symbol
+            // in order to continue the symbolic execution.
+            else {
+                rsp_value = make_symbolic(current.unknown_kind,
+                                          current.unknown_address);
+            }
+
+            // Maybe also remove pushed return value here?
+            const auto element_width = make_constant(8);
+            const auto rsp = make_shared<Operation>(rsp_value,
+                                                    current.operation,
+                                                    element_width);
+
+            state.update(register_rsp, rsp);
+            state.update(register_rip, target);
+            break;
+        }
+
+        case TransferStatementFail:
+            evaluate(current.data, state, unknown);
             return false;
+
+        case TransferStatementError:
+            throw runtime_error(_errors[current.target]);
         }
 
 #if DEBUG_PRINT_STEPS
         cout << string(79, '-') << endl;
-        cout << endl << _state << endl;
+        cout << endl << state << endl;
 #endif
     }
 
-    _state.optimize();
+    state.optimize();
     return true;
 }
 
-ExpressionPtr BlockSemantics::parse_expression(const IRExpr &expression) {
-    const auto &needle = _expression_parser.find(expression.tag);
+/*!
+ * \brief Evaluates the given expression node in the given state.
+ *
+ * Nodes reading registers or temporaries are substituted with their values
+ * in the state, operations and indirections are created anew.
+ *
+ * \return The value of the node or `unknown` if it is not known.
+ */
+ExpressionPtr BlockTransfer::evaluate(uint32_t index, const State &state,
+                                      const ExpressionPtr &unknown) const {
+    const TransferExpression &expression = _expressions[index];
+
+    State::const_iterator needle;
+    switch(expression.type) {
+    case TransferExpressionConstant:
+        return make_constant(expression.value);
+
+    case TransferExpressionGet:
+        if(!state.find(_keys[expression.lhs], needle)) {
+            return unknown;
+        }
+
+        /* TODO: We should think about whether sharing pointers makes sense
+         * here or if we are better off by creating a copy.
+         */
+        return needle->second;
+
+    case TransferExpressionRdTmp:
+        if(!state.find(_keys[expression.lhs], needle)) {
+            return unknown;
+        }
+        return needle->second;
+
+    case TransferExpressionOffset: {
+        const auto base = evaluate(expression.lhs, state, unknown);
+        if(base->type() == ExpressionUnknown) {
+            return unknown;
+        }
+
+        return make_shared<Operation>(base,
+                                      OperationAdd,
+                                      make_constant(expression.value));
+    }
+
+    case TransferExpressionOperation: {
+        const auto lhs = evaluate(expression.lhs, state, unknown);
+        const auto rhs = evaluate(expression.rhs, state, unknown);
+
+        if(lhs->type() == ExpressionUnknown
+           || rhs->type() == ExpressionUnknown) {
+            return unknown;
+        }
+
+        return make_shared<Operation>(lhs, expression.operation, rhs);
+    }
+
+    case TransferExpressionLoad: {
+        const auto e = evaluate(expression.lhs, state, unknown);
+        if(e->type() == ExpressionUnknown) {
+            return unknown;
+        }
+
+        return make_shared<Indirection>(e);
+    }
+
+    case TransferExpressionError:
+        throw runtime_error(_errors[expression.value]);
+
+    default:
+        return unknown;
+    }
+}
+
+bool BlockTransfer::is_unknown(uint32_t index) const {
+    return _expressions[index].type == TransferExpressionUnknown;
+}
+
+bool BlockTransfer::is_error(uint32_t index) const {
+    return _expressions[index].type == TransferExpressionError;
+}
+
+uint32_t BlockTransfer::add_expression(TransferExpressionType type,
+                                       uint64_t value,
+                                       OperationType operation,
+                                       uint32_t lhs,
+                                       uint32_t rhs) {
+    TransferExpression expression;
+    expression.type = type;
+    expression.operation = operation;
+    expression.value = value;
+    expression.lhs = lhs;
+    expression.rhs = rhs;
+
+    _expressions.push_back(expression);
+    return _expressions.size() - 1;
+}
 
-    if(needle == _expression_parser.cend()) {
+uint32_t BlockTransfer::add_error(const string &message) {
+    _errors.push_back(message);
+    return _errors.size() - 1;
+}
+
+uint32_t BlockTransfer::add_key(const ExpressionPtr &key) {
+    _keys.push_back(key);
+    return _keys.size() - 1;
+}
+
+void BlockTransfer::add_statement(TransferStatementType type,
+                                  uint32_t target,
+                                  uint32_t data,
+                                  SymbolicKind unknown_kind,
+                                  uint64_t unknown_address,
+                                  OperationType operation) {
+    _statements.emplace_back();
+    TransferStatement &statement = _statements.back();
+    statement.type = type;
+    statement.operation = operation;
+    statement.target = target;
+    statement.data = data;
+    statement.unknown_kind = unknown_kind;
+    statement.unknown_address = unknown_address;
+}
+
+/*!
+ * \brief Compiles the given VEX expression.
+ *
+ * Expressions whose value does not depend on the state are folded. Errors
+ * are propagated to the root of the expression, as they abort the
+ * evaluation anyway.
+ *
+ * \return The index of the compiled node.
+ */
+uint32_t BlockTransfer::compile_expression(const IRExpr &expression) {
+    const ExpressionCompiler f = get_expression_compiler(expression.tag);
+
+    if(f == nullptr) {
         stringstream stream;
         stream << "Cannot handle expression with tag " << expression.tag
                << "." << endl;
-        throw runtime_error(stream.str());
+        return add_expression(TransferExpressionError,
+                              add_error(stream.str()));
     }
 
-    const auto &f = needle->second;
     return (this->*f)(expression);
 }
 
-bool BlockSemantics::handle_statement(const IRStmt &statement) {
-    const auto &needle = _statement_handler.find(statement.tag);
+/*!
+ * \brief Compiles the given VEX statement.
+ * \return `false`, if the statement cannot be handled (and hence all
+ * following statements are never reached); `true`, otherwise.
+ */
+bool BlockTransfer::compile_statement(const IRStmt &statement) {
+    const StatementCompiler f = get_statement_compiler(statement.tag);
 
-    if(needle == _statement_handler.cend()) {
+    if(f == nullptr) {
         stringstream stream;
         stream << "Cannot handle statement with tag " << statement.tag
                << "." << endl;
-        throw runtime_error(stream.str());
+        add_statement(TransferStatementError, add_error(stream.str()), 0);
+        return false;
     }
 
-    const auto &f = needle->second;
-    return (this->*f)(statement);
-}
-
-// We do not really need this for now.
-uint64_t BlockSemantics::get_mask(uint8_t size) const {
-    if(size == 64) {
-        return -1UL;
-    }
+    (this->*f)(statement);
 
-    return (1 << size) - 1;
+    return _statements.empty()
+           || _statements.back().type != TransferStatementError;
 }
 
-bool BlockSemantics::get_size(const IRType &type, arg_out uint8_t &size)
+bool BlockTransfer::get_size(const IRType &type, arg_out uint8_t &size)
     const {
     switch(type) {
     case Ity_I1:
@@ -166,66 +443,37 @@ bool BlockSemantics::get_size(const IRType &type, arg_out uint8_t &size)
     return true;
 }
 
-bool BlockSemantics::parse_type(const IRType &type, arg_out uint8_t &size,
-                               arg_out uint64_t &mask) const {
-    if(!get_size(type, size)) {
-        return false;
-    }
-
-    mask = get_mask(size);
-    return true;
-}
-
-ExpressionPtr BlockSemantics::parse_get(const IRExpr &expression) {
+uint32_t BlockTransfer::compile_get(const IRExpr &expression) {
     const auto &target = expression.Iex.Get;
 
-    uint64_t mask;
     uint8_t size;
-    if(!parse_type(target.ty, size, mask)) {
-        return _unknown;
+    if(!get_size(target.ty, size)) {
+        return 0;
     }
     if(size != 64 && size != 32) {
-        return _unknown;
-    }
-
-    auto r = make_shared<Register>(target.offset);
-
-    State::const_iterator needle;
-    if(!_state.find(r, needle)) {
-        return _unknown;
-    }
-
-    /* TODO: We should think about whether sharing pointers makes sense here
-     * or if we are better off by creating a copy.
-     */
-    return needle->second;
-}
-
-ExpressionPtr BlockSemantics::parse_geti(const IRExpr&) {
-    // TODO: We may be able to solve this if details are constant.
-    return _unknown;
-}
-
-ExpressionPtr BlockSemantics::parse_rdtmp(const IRExpr &expression) {
-    const auto &target = expression.Iex.RdTmp;
-
-    State::const_iterator needle;
-    if(!_state.find(make_shared<Temporary>(target.tmp), needle)) {
-        return _unknown;
+        return 0;
     }
 
-    return needle->second;
+    return add_expression(TransferExpressionGet,
+                          target.offset,
+                          OperationAdd,
+                          add_key(make_register(target.offset)));
 }
 
-ExpressionPtr BlockSemantics::parse_qop(const IRExpr&) {
-    return _unknown;
+uint32_t BlockTransfer::compile_unknown(const IRExpr&) {
+    // TODO: We may be able to solve GetI if details are constant.
+    return 0;
 }
 
-ExpressionPtr BlockSemantics::parse_triop(const IRExpr&) {
-    return _unknown;
+uint32_t BlockTransfer::compile_rdtmp(const IRExpr &expression) {
+    const auto tmp = expression.Iex.RdTmp.tmp;
+    return add_expression(TransferExpressionRdTmp,
+                          tmp,
+                          OperationAdd,
+                          add_key(make_temporary(tmp)));
 }
 
-ExpressionPtr BlockSemantics::parse_binop(const IRExpr &expression) {
+uint32_t BlockTransfer::compile_binop(const IRExpr &expression) {
     const auto &target = expression.Iex.Binop;
     OperationType operation;
 
@@ -249,22 +497,39 @@ ExpressionPtr BlockSemantics::parse_binop(const IRExpr &expression) {
         break;
 
     default:
-        return _unknown;
+        return 0;
     }
 
-    const auto lhs = parse_expression(*target.arg1);
-    const auto rhs = parse_expression(*target.arg2);
+    const auto lhs = compile_expression(*target.arg1);
+    const auto rhs = compile_expression(*target.arg2);
+
+    if(is_error(lhs)) {
+        return lhs;
+    }
+    if(is_error(rhs)) {
+        return rhs;
+    }
+    if(is_unknown(lhs) || is_unknown(rhs)) {
+        return 0;
+    }
 
-    if(lhs->type() == ExpressionUnknown || rhs->type() == ExpressionUnknown) {
-        return _unknown;
+    // Register/temporary plus constant offset.
+    const TransferExpressionType lhs_type = _expressions[lhs].type;
+    if(operation == OperationAdd
+       && (lhs_type == TransferExpressionGet
+           || lhs_type == TransferExpressionRdTmp)
+       && _expressions[rhs].type == TransferExpressionConstant) {
+        return add_expression(TransferExpressionOffset,
+                              _expressions[rhs].value,
+                              OperationAdd,
+                              lhs);
     }
 
-    return make_shared<Operation>(lhs, operation, rhs);
+    return add_expression(TransferExpressionOperation, 0, operation, lhs, rhs);
 }
 
-ExpressionPtr BlockSemantics::parse_unop(const IRExpr &expression) {
+uint32_t BlockTransfer::compile_unop(const IRExpr &expression) {
     const auto &target = expression.Iex.Unop;
-    OperationType operation;
 
     switch(target.op) {
     // We ignore casting completely. Vex does it often even if it
@@ -272,179 +537,122 @@ ExpressionPtr BlockSemantics::parse_unop(const IRExpr &expression) {
     // we just ignore the casting.
     case Iop_64to32:
     case Iop_32Sto64:
-    case Iop_32Uto64: {
-        const auto arg = parse_expression(*target.arg);
-        return arg;
-        }
+    case Iop_32Uto64:
+        return compile_expression(*target.arg);
+
     default:
-        return _unknown;
+        return 0;
     }
-
-    return _unknown;
 }
 
-ExpressionPtr BlockSemantics::parse_ccall(const IRExpr&) {
-    return _unknown;
-}
-
-ExpressionPtr BlockSemantics::parse_ite(const IRExpr&) {
-    return _unknown;
-}
-
-ExpressionPtr BlockSemantics::parse_load(const IRExpr &expression) {
+uint32_t BlockTransfer::compile_load(const IRExpr &expression) {
     const auto &target = expression.Iex.Load;
     if(target.end != Iend_LE) {
-        throw runtime_error("Cannot handle big-endian load instructions yet.");
+        return add_expression(TransferExpressionError,
+                              add_error("Cannot handle big-endian load "
+                                        "instructions yet."));
     }
 
-    uint64_t mask;
     uint8_t size;
-
-    if(!parse_type(target.ty, size, mask)) {
-        return _unknown;
+    if(!get_size(target.ty, size)) {
+        return 0;
     }
     if(size != 64 && size != 32) {
-        return _unknown;
+        return 0;
     }
 
-    const auto e = parse_expression(*target.addr);
-    if(e->type() == ExpressionUnknown) {
-        return _unknown;
+    const auto e = compile_expression(*target.addr);
+    if(is_error(e) || is_unknown(e)) {
+        return e;
     }
 
-    return make_shared<Indirection>(e);
+    return add_expression(TransferExpressionLoad, 0, OperationAdd, e);
 }
 
-ExpressionPtr BlockSemantics::parse_const(const IRExpr &expression) {
+uint32_t BlockTransfer::compile_const(const IRExpr &expression) {
     const auto &target = *expression.Iex.Const.con;
 
     switch(target.tag) {
     case Ico_U1:
-        return make_shared<Constant>(target.Ico.U1);
+        return add_expression(TransferExpressionConstant, target.Ico.U1);
 
     case Ico_U8:
-        return make_shared<Constant>(target.Ico.U8);
+        return add_expression(TransferExpressionConstant, target.Ico.U8);
 
     case Ico_U16:
-        return make_shared<Constant>(target.Ico.U16);
+        return add_expression(TransferExpressionConstant, target.Ico.U16);
 
     case Ico_U32:
-        return make_shared<Constant>(target.Ico.U32);
+        return add_expression(TransferExpressionConstant, target.Ico.U32);
 
     case Ico_U64:
-        return make_shared<Constant>(target.Ico.U64);
+        return add_expression(TransferExpressionConstant, target.Ico.U64);
 
     default:
         break;
     }
 
-    return _unknown;
+    return 0;
 }
 
-bool BlockSemantics::handle_noop(const IRStmt&) {
-    return true;
+void BlockTransfer::compile_noop(const IRStmt&) {
 }
 
-bool BlockSemantics::handle_wrtmp(const IRStmt &statement) {
+void BlockTransfer::compile_wrtmp(const IRStmt &statement) {
     const auto &current = statement.Ist.WrTmp;
 
-    const auto e = parse_expression(*current.data);
-    const auto dst = make_shared<Temporary>(current.tmp);
-
-    if(e->type() == ExpressionUnknown) {
-        _state.erase(dst);
-        return true;
+    const auto e = compile_expression(*current.data);
+    if(is_error(e)) {
+        add_statement(TransferStatementError, _expressions[e].value, 0);
+        return;
     }
 
-    _state.update(dst, e);
-    return true;
+    add_statement(TransferStatementWrTmp, current.tmp, e);
 }
 
-bool BlockSemantics::handle_put(const IRStmt &statement) {
+void BlockTransfer::compile_put(const IRStmt &statement) {
     const auto &current = statement.Ist.Put;
 
-    const auto e = parse_expression(*current.data);
-    const auto d = make_shared<Register>(current.offset);
-
-    if(d->type() == ExpressionUnknown) {
-        return true;
-    }
-
-    if(e->type() == ExpressionUnknown) {
-
-        // If destination is a register, store a symbolic value
-        // which states that we do not know tha value.
-        if(d->type() == ExpressionRegister) {
-            stringstream symbol_name;
-            symbol_name << "unknown_" << hex << _curr_addr;
-            ExpressionPtr unknown = make_shared<Symbolic>(symbol_name.str());
-            _state.update(d, unknown);
-        }
-        else {
-            _state.erase(d);
-        }
-        return true;
+    const auto e = compile_expression(*current.data);
+    if(is_error(e)) {
+        add_statement(TransferStatementError, _expressions[e].value, 0);
+        return;
     }
 
-    _state.update(d, e);
-    return true;
-}
-
-bool BlockSemantics::handle_puti(const IRStmt&) {
-    // TODO: We may be able to handle this if details are constant.
-    // Possibly should invalidate all registers for correctness.
-    return true;
+    add_statement(TransferStatementPut, current.offset, e, SymbolicUnknown,
+                  _curr_addr);
 }
 
-bool BlockSemantics::handle_store(const IRStmt &statement) {
+void BlockTransfer::compile_store(const IRStmt &statement) {
     const auto &current = statement.Ist.Store;
 
     if(current.end != Iend_LE) {
-        throw runtime_error("Cannot handle big-endian store instructions"
-                            " yet.");
+        add_statement(TransferStatementError,
+                      add_error("Cannot handle big-endian store instructions"
+                                " yet."),
+                      0);
+        return;
     }
 
-    const auto e = parse_expression(*current.data);
-    const auto d = parse_expression(*current.addr);
+    const auto e = compile_expression(*current.data);
+    const auto d = compile_expression(*current.addr);
 
-    if(d->type() == ExpressionUnknown) {
-        return true;
+    if(is_error(e)) {
+        add_statement(TransferStatementError, _expressions[e].value, 0);
+        return;
     }
-
-    const auto dst = make_shared<Indirection>(d);
-    if(e->type() == ExpressionUnknown) {
-        _state.erase(dst);
-        return true;
+    if(is_error(d)) {
+        add_statement(TransferStatementError, _expressions[d].value, 0);
+        return;
     }
-
-    // Special case in which we check if the key value would
-    // be [0x0]. This can happen because we ignore checks and
-    // can reach states that would not be reachable in the normal
-    // control-flow (i.e., because it is checked that rax != 0 before
-    // executing mov [rax], <something>).
-    if(d->type() == ExpressionConstant) {
-        const Constant &temp = static_cast<Constant &>(*d);
-        if(temp.value() == 0) {
-            _state.erase(dst);
-            return true;
-        }
+    if(is_unknown(d)) {
+        return;
     }
 
-    _state.update(dst, e);
-    return true;
-}
-
-bool BlockSemantics::handle_storeg(const IRStmt&) {
-    // TODO: How to handle guarded stores?
-    return true;
+    add_statement(TransferStatementStore, d, e);
 }
 
-bool BlockSemantics::handle_loadg(const IRStmt&) {
-    // TODO: How to handle guarded stores?
-    return true;
-}
-
-bool BlockSemantics::handle_abi_hint(const IRStmt &statement) {
+void BlockTransfer::compile_abi_hint(const IRStmt &statement) {
     /* We assume AbiHints are only generated for call/ret instructions. VEX
      * emits IR that set ups the return address, we will revert this here.
      *
@@ -466,27 +674,15 @@ bool BlockSemantics::handle_abi_hint(const IRStmt &statement) {
      * (or RSP at all). */
 
     const auto &current = statement.Ist.AbiHint;
-    const auto &target = parse_expression(*current.nia);
-
-    State::const_iterator needle;
-    ExpressionPtr rsp_value;
-    if(_state.find(register_rsp, needle)) {
-        if(needle->second->type() == ExpressionUnknown) {
-            return false;
-        }
-        rsp_value = needle->second;
-    }
-    // When we can not find the rsp, replace it with an unknown symbol
-    // in order to continue the symbolic execution.
-    else {
-        stringstream symbol_name;
-        symbol_name << "unknown_rsp_" << hex << _block.get_address();
-        rsp_value = make_shared<Symbolic>(symbol_name.str());
+    const auto target = compile_expression(*current.nia);
+    if(is_error(target)) {
+        add_statement(TransferStatementError, _expressions[target].value, 0);
+        return;
     }
 
     OperationType operation;
 
-    switch(_block.get_terminator().type) {
+    switch(_terminator_type) {
     case TerminatorCall:
     case TerminatorNoReturn:
     case TerminatorCallUnresolved:
@@ -498,15 +694,10 @@ bool BlockSemantics::handle_abi_hint(const IRStmt &statement) {
         break;
 
     default:
-        return false;
+        add_statement(TransferStatementFail, 0, target);
+        return;
     }
 
-    // Maybe also remove pushed return value here?
-    const auto element_width = make_shared<Constant>(8);
-    const auto rsp = make_shared<Operation>(rsp_value, operation,
-                                            element_width);
-
-    _state.update(register_rsp, rsp);
-    _state.update(register_rip, target);
-    return true;
+    add_statement(TransferStatementAbiHint, 0, target, SymbolicUnknownRsp,
+                  _address, operation);
 }
@@ -0,0 +1,108 @@
+#include "chunked_text.h"
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+void append_hex(string &out, uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    char buffer[16];
+    size_t pos = sizeof(buffer);
+    do {
+        buffer[--pos] = digits[value & 0xf];
+        value >>= 4;
+    } while(value);
+    out.append(buffer + pos, sizeof(buffer) - pos);
+}
+
+void append_dec(string &out, uint64_t value) {
+    char buffer[20];
+    size_t pos = sizeof(buffer);
+    do {
+        buffer[--pos] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while(value);
+    out.append(buffer + pos, sizeof(buffer) - pos);
+}
+
+bool write_chunked_text(const string &file_name,
+                        const string &header,
+                        size_t num_items,
+                        uint32_t num_threads,
+                        const ChunkFormatter &format) {
+
+    FILE *file = fopen(file_name.c_str(), "wb");
+    if(file == NULL) {
+        return false;
+    }
+    bool success = fwrite(header.data(), 1, header.size(), file)
+                   == header.size();
+
+    const size_t num_chunks = (num_items + CHUNKED_TEXT_ITEMS_PER_CHUNK - 1)
+                              / CHUNKED_TEXT_ITEMS_PER_CHUNK;
+    auto format_chunk = [&](size_t chunk_idx, string &out) {
+        const size_t begin = chunk_idx * CHUNKED_TEXT_ITEMS_PER_CHUNK;
+        format(begin,
+               min(num_items, begin + CHUNKED_TEXT_ITEMS_PER_CHUNK),
+               out);
+    };
+
+    // For debugging purposes do not spawn any thread.
+    const uint32_t num_workers = min<size_t>(num_threads, num_chunks);
+    if(num_workers <= 1) {
+        string out;
+        for(size_t i = 0; i < num_chunks; i++) {
+            out.clear();
+            format_chunk(i, out);
+            success &= fwrite(out.data(), 1, out.size(), file) == out.size();
+        }
+    }
+    else {
+        vector<string> chunks(num_chunks);
+        vector<bool> is_done(num_chunks, false);
+        atomic<size_t> next_chunk(0);
+        mutex mtx;
+        condition_variable cv;
+        auto worker = [&]() {
+            while(true) {
+                const size_t chunk_idx = next_chunk++;
+                if(chunk_idx >= num_chunks) {
+                    break;
+                }
+                string out;
+                format_chunk(chunk_idx, out);
+                lock_guard<mutex> _(mtx);
+                chunks[chunk_idx] = move(out);
+                is_done[chunk_idx] = true;
+                cv.notify_one();
+            }
+        };
+        vector<thread> threads;
+        for(uint32_t i = 0; i < num_workers; i++) {
+            threads.emplace_back(worker);
+        }
+
+        // Write the chunks in order as soon as they are formatted.
+        for(size_t i = 0; i < num_chunks; i++) {
+            string out;
+            {
+                unique_lock<mutex> lock(mtx);
+                cv.wait(lock, [&] { return is_done[i]; });
+                out = move(chunks[i]);
+            }
+            success &= fwrite(out.data(), 1, out.size(), file) == out.size();
+        }
+        for(thread &t : threads) {
+            t.join();
+        }
+    }
+
+    success = fclose(file) == 0 && success;
+    return success;
+}
@@ -0,0 +1,150 @@
+#include "companion_file.h"
+
+#include <cstring>
+#include <cstdio>
+
+using namespace std;
+
+static_assert(sizeof(CompanionFileHeader) == 24,
+              "Unexpected padding in companion file header.");
+
+static size_t align(size_t size) {
+    return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+/*!
+ * \brief Constructs a new `CompanionFileReader` instance.
+ * \param file_name The path to the companion file.
+ *
+ * If the file cannot be mapped, a `runtime_error` exception is thrown.
+ */
+CompanionFileReader::CompanionFileReader(const string &file_name)
+    : _file(file_name) {
+}
+
+const uint8_t *CompanionFileReader::consume(size_t size) {
+    size = align(size);
+    if(size > _file.size() - _offset) {
+        return nullptr;
+    }
+    const uint8_t *data = _file.data() + _offset;
+    _offset += size;
+    return data;
+}
+
+bool CompanionFileReader::is_valid(CompanionFileType type,
+                                   uint64_t source_hash) {
+    _offset = 0;
+    const uint8_t *data = consume(sizeof(CompanionFileHeader));
+    if(data == nullptr) {
+        return false;
+    }
+
+    const CompanionFileHeader &header =
+                         *reinterpret_cast<const CompanionFileHeader*>(data);
+    return memcmp(header.magic, COMPANION_FILE_MAGIC, sizeof(header.magic)) == 0
+           && header.version == COMPANION_FILE_VERSION
+           && header.type == type
+           && header.source_hash == source_hash;
+}
+
+bool CompanionFileReader::read_value(uint64_t &value) {
+    const uint8_t *data = consume(sizeof(uint64_t));
+    if(data == nullptr) {
+        return false;
+    }
+    value = *reinterpret_cast<const uint64_t*>(data);
+    return true;
+}
+
+bool CompanionFileReader::read_array(const uint64_t *&values,
+                                     uint64_t &count) {
+    if(!read_value(count)) {
+        return false;
+    }
+    if(count > (_file.size() - _offset) / sizeof(uint64_t)) {
+        return false;
+    }
+    values = reinterpret_cast<const uint64_t*>(
+                                       consume(count * sizeof(uint64_t)));
+    return true;
+}
+
+bool CompanionFileReader::read_string(string &value) {
+    uint64_t size;
+    if(!read_value(size)) {
+        return false;
+    }
+    if(size > _file.size() - _offset) {
+        return false;
+    }
+    const uint8_t *data = consume(size);
+    if(data == nullptr) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(data), size);
+    return true;
+}
+
+/*!
+ * \brief Constructs a new `CompanionFileWriter` instance and writes the
+ * header of the companion file.
+ */
+CompanionFileWriter::CompanionFileWriter(const string &file_name,
+                                         CompanionFileType type,
+                                         uint64_t source_hash)
+    : _file_name(file_name) {
+    _output.open(_file_name + ".tmp", ios::binary | ios::trunc);
+
+    CompanionFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPANION_FILE_MAGIC, sizeof(header.magic));
+    header.version = COMPANION_FILE_VERSION;
+    header.type = type;
+    header.source_hash = source_hash;
+    write_data(&header, sizeof(header));
+}
+
+void CompanionFileWriter::write_data(const void *data, size_t size) {
+    static const char padding[sizeof(uint64_t)] = {0};
+    _output.write(static_cast<const char*>(data), size);
+    _output.write(padding, align(size) - size);
+}
+
+void CompanionFileWriter::write_value(uint64_t value) {
+    write_data(&value, sizeof(value));
+}
+
+void CompanionFileWriter::write_array(const uint64_t *values,
+                                      uint64_t count) {
+    write_value(count);
+    write_data(values, count * sizeof(uint64_t));
+}
+
+void CompanionFileWriter::write_string(const string &value) {
+    write_value(value.size());
+    write_data(value.data(), value.size());
+}
+
+bool CompanionFileWriter::finish() {
+    _output.close();
+    if(_output.fail()) {
+        remove((_file_name + ".tmp").c_str());
+        return false;
+    }
+
+    // Only replace the old companion file once the new one is complete.
+    return rename((_file_name + ".tmp").c_str(), _file_name.c_str()) == 0;
+}
+
+uint64_t hash_files(const vector<string> &file_names) {
+    uint64_t hash = 0;
+    for(const string &file_name : file_names) {
+        uint64_t file_hash = hash_file(file_name);
+        if(!file_hash) {
+            return 0;
+        }
+        hash ^= file_hash + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash ? hash : 1;
+}
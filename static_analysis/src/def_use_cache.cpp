@@ -0,0 +1,172 @@
+#include "def_use_cache.h"
+#include "instrumentation.h"
+
+#include <queue>
+
+using namespace std;
+
+DefUseSummaryCache &DefUseSummaryCache::get_instance() {
+    static DefUseSummaryCache instance;
+    return instance;
+}
+
+DefUseSummaryPtr DefUseSummaryCache::get_summary(
+                                   const Function &function,
+                                   const OperandSSAPtr &initial_use,
+                                   const BaseInstructionSSAPtr &initial_instr) {
+
+    DefUseSummaryKey key;
+    key.function = &function;
+    key.instr = initial_instr.get();
+    key.operand = initial_use;
+
+    Shard &shard = _shards[DefUseSummaryKey::Hash()(key)
+                           % DEF_USE_CACHE_NUM_SHARDS];
+    {
+        lock_guard<mutex> _(shard.mtx);
+        auto it = shard.summaries.find(key);
+        if(it != shard.summaries.cend()) {
+            Instrumentation::get_instance().count(InstrCounterDefUseCacheHits);
+            return it->second;
+        }
+    }
+
+    // Walk without holding the lock. If another thread was faster, its
+    // (identical) summary is kept.
+    Instrumentation::get_instance().count(InstrCounterDefUseCacheMisses);
+    DefUseSummaryPtr summary = create_summary(function, initial_use);
+
+    lock_guard<mutex> _(shard.mtx);
+    return shard.summaries.emplace(key, summary).first->second;
+}
+
+DefUseSummaryPtr DefUseSummaryCache::create_summary(
+                                       const Function &function,
+                                       const OperandSSAPtr &initial_use) const {
+
+    shared_ptr<DefUseSummary> summary = make_shared<DefUseSummary>();
+
+    queue<OperandSSAPtr> work_queue;
+    OperandsSSAset seen;
+
+    work_queue.push(initial_use);
+    while(true) {
+        if(work_queue.empty()) {
+            break;
+        }
+
+        OperandSSAPtr &use_op = work_queue.front();
+
+        if(seen.find(use_op) != seen.end()) {
+            work_queue.pop();
+            continue;
+        }
+
+        seen.insert(use_op);
+
+        BaseInstructionSSAPtrSet def_instrs =
+                                      function.get_instrs_define_op_ssa(use_op);
+
+        // Set of operand uses we want to track.
+        OperandsSSAset use_ops;
+        use_ops.insert(use_op);
+
+        // Follow also the memory base register definition.
+        // We kind of "overtaint" here.
+        // Track both "rax" and "[rax-8]" in case of "mov [rax-8], rdi".
+        if(use_op->is_memory()) {
+            switch(use_op->get_type()) {
+                case SSAOpTypeMemoryX64: {
+                    const RegisterX64SSA &temp =
+                          static_cast<const MemoryX64SSA &>(*use_op).get_base();
+                    OperandSSAPtr base =
+                                        make_shared<const RegisterX64SSA>(temp);
+                    const BaseInstructionSSAPtrSet &mem_instrs =
+                                        function.get_instrs_define_op_ssa(base);
+                    def_instrs.insert(mem_instrs.begin(), mem_instrs.end());
+
+                    // Consider base of memory also as "use" (this is important
+                    // for example if we start our backtrace analysis from
+                    // a "definition" via memory object like mov [rax-8], rdi
+                    // where [rax-8] is our starting operand).
+                    use_ops.insert(base);
+                    break;
+                }
+                default:
+                    throw runtime_error("Unknown SSA memory object.");
+            }
+        }
+
+        for(const OperandSSAPtr &track_op : use_ops) {
+            for(const BaseInstructionSSAPtr &use_instr :
+                                     function.get_instrs_use_op_ssa(track_op)) {
+                for(const BaseInstructionSSAPtr &def_instr : def_instrs) {
+
+                    // Only draw an edge with the operand if the definition
+                    // instruction actually defines the operand. For example,
+                    // mov rbx_69, [rbp_11-f0] -> mov rsi_88, [rbx_69+0]
+                    // would otherwise draw an edge with "rbx_69" and
+                    // "[rbx_69+0]". We only want the edge with "rbx_69".
+                    bool skip_edge = true;
+                    for(const OperandSSAPtr &op : def_instr->get_definitions()) {
+                        if(*op == *track_op) {
+                            skip_edge = false;
+                            break;
+                        }
+                    }
+                    if(skip_edge) {
+                        continue;
+                    }
+
+                    DefUseStep step;
+                    step.use_instr = use_instr;
+                    step.def_instr = def_instr;
+                    step.operand = track_op;
+                    summary->steps.push_back(step);
+
+                    // Ignore cases in which the def and use node are the same.
+                    // This can happen because in cases of "[rbp_11-f0]"
+                    // we track also "rbp_11" back and therefore
+                    // instructions like mov "[rbp_11-f0], rcx_72"
+                    // have also a edge to itself with "rbp_11"
+                    // (the step is kept since it creates the node).
+                    if(*def_instr == *use_instr) {
+                        continue;
+                    }
+
+                    // Add definitions to operand uses to track next.
+                    for(const OperandSSAPtr next_op : def_instr->get_uses()) {
+
+                        work_queue.push(next_op);
+
+                        // Follow also the memory base register definition.
+                        // We kind of "overtaint" here.
+                        // Track both "rax" and "[rax-8]"
+                        // in case of "mov [rax-8], rdi".
+                        if(next_op->is_memory()) {
+                            switch(next_op->get_type()) {
+                                case SSAOpTypeMemoryX64: {
+                                    const RegisterX64SSA &temp =
+                                          static_cast<const MemoryX64SSA &>(
+                                                           *next_op).get_base();
+                                    work_queue.push(
+                                           make_shared<const RegisterX64SSA>(
+                                                                         temp));
+                                    break;
+                                }
+                                default:
+                                    throw runtime_error("Unknown SSA memory "\
+                                                        "object.");
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Pop current processed operand.
+        work_queue.pop();
+    }
+
+    return summary;
+}
@@ -1,241 +1,371 @@
 #include "engels.h"
+#include "incremental_state.h"
+#include "instrumentation.h"
+#include "engels_checkpoint.h"
+#include "engels_cost_model.h"
+#include "item_budget.h"
+#include "numa_placement.h"
+#include "scratch_arena.h"
+#include "logger.h"
+#include "tracepoints.h"
+
+#include <algorithm>
+#include <chrono>
+#include <tuple>
 
 using namespace std;
 
-queue<uint64_t> queue_icall_addrs;
-mutex queue_icall_mtx;
+WorkQueue queue_icall_addrs;
 
-queue<uint64_t> queue_vcall_addrs;
-mutex queue_vcall_mtx;
+WorkQueue queue_vcall_addrs;
 
 unordered_set<uint64_t> repeat_icall_addrs;
 unordered_map<uint64_t, unordered_set<uint64_t>> icall_addr_unresolvable_map;
 unordered_map<uint64_t, unordered_set<uint64_t>> vfunc_addr_unresolvable_map;
+unordered_map<uint64_t, unordered_set<uint64_t>> icall_addr_dependents_map;
+unordered_map<uint64_t, unordered_set<uint64_t>> vfunc_addr_dependents_map;
 mutex repeat_icall_mtx;
 
-queue<uint64_t> queue_vtable_xref_addrs;
-mutex queue_vtable_xref_mtx;
+WorkQueue queue_vtable_xref_addrs;
 mutex vtable_xref_data_mtx;
 BlockPtr ret_block_ptr;
 
+// Result delta of the worker running on this thread.
+static thread_local EngelsResultDelta *thread_result_delta = nullptr;
+
+/*!
+ * \brief Vtable entry the lightweight analysis resolved an icall to.
+ */
+struct EngelsLightweightResolution {
+    bool is_resolved = false;
+    uint32_t vtable_idx = 0;
+    uint32_t entry_idx = 0;
+    BaseInstructionSSAPtr icall_instr;
+    ExpressionPtr target_expr;
+};
+
+// Resolution of the lightweight analysis running on this thread (only set
+// if tiering is enabled).
+static thread_local EngelsLightweightResolution *thread_lightweight_resolution
+                                                                    = nullptr;
+
+// Highest vtable entry a constant target address is searched for.
+#define ENGELS_TIER_MAX_ENTRY_IDX 1024
+
+static void engels_count_tier(EngelsAnalysisObjects &analysis_obj,
+                              EngelsTier tier,
+                              chrono::steady_clock::time_point start,
+                              bool is_settled) {
+    EngelsTierStats &stats = analysis_obj.tier_stats[tier];
+    const auto elapsed = chrono::steady_clock::now() - start;
+    stats.num_sites.fetch_add(1, memory_order_relaxed);
+    if(is_settled) {
+        stats.num_settled.fetch_add(1, memory_order_relaxed);
+    }
+    stats.time_us.fetch_add(
+              chrono::duration_cast<chrono::microseconds>(elapsed).count(),
+              memory_order_relaxed);
+}
+
 void engels_analysis(const string &target_file,
                      const string &module_name,
                      const string &target_dir,
                      EngelsAnalysisObjects &analysis_obj,
-                     uint32_t num_threads) {
+                     uint32_t num_threads,
+                     const IncrementalState *incremental) {
 
     // Create special basic block that performs a return instruction.
     unsigned char ret_instr_bytes = '\xc3'; // TODO architecture specific
     size_t real_end = 0;
-    const IRSB &translated_block = analysis_obj.vex.translate(&ret_instr_bytes,
-                                                              0,
-                                                              1,
-                                                              &real_end);
-    IRSB *irsb_ptr = deepCopyIRSB_Heap(&translated_block);
+    IRSB *irsb_ptr = analysis_obj.vex.translate(&ret_instr_bytes,
+                                                0,
+                                                1,
+                                                &real_end);
     Terminator terminator;
     terminator.type = TerminatorReturn;
     terminator.target = 0;
     terminator.fall_through = 0;
     ret_block_ptr = make_shared<Block>(0, irsb_ptr, terminator, 1);
 
+    ScopedPhaseTimer engels_timer("engels_analysis");
+
+    // Drop the icalls a previous analysis in the same process could not
+    // resolve (server mode).
+    repeat_icall_addrs.clear();
+    icall_addr_unresolvable_map.clear();
+    vfunc_addr_unresolvable_map.clear();
+    icall_addr_dependents_map.clear();
+    vfunc_addr_dependents_map.clear();
+
     // Import all icall addrs.
     ICallSet icall_set = import_icalls(target_file);
 
+    // Each worker thread collects its results separately.
+    analysis_obj.result_deltas.assign(num_threads, EngelsResultDelta());
+
+    // Add the still valid results of the previous run before any
+    // analysis starts (they are not part of the results map since
+    // the instruction and expression objects are not stored).
+    bool is_incremental = incremental && incremental->is_incremental();
+    if(is_incremental) {
+        for(const IncrementalResult &result :
+            incremental->get_cached_results()) {
+            engels_add_vcall_data(analysis_obj,
+                                  result.icall_addr,
+                                  result.vtable_idx,
+                                  result.entry_idx);
+        }
+        for(uint64_t vcall_addr : incremental->get_cached_possible_vcalls()) {
+            analysis_obj.vcall_file.add_possible_vcall(vcall_addr);
+        }
+    }
+
+    // Add the results of the items an interrupted run finished already
+    // (these items are not queued again).
+    const EngelsCheckpoint *checkpoint = analysis_obj.checkpoint;
+    bool is_resumed = checkpoint && checkpoint->is_resumed();
+    if(is_resumed) {
+        for(const IncrementalResult &result : checkpoint->get_results()) {
+            engels_add_vcall_data(analysis_obj,
+                                  result.icall_addr,
+                                  result.vtable_idx,
+                                  result.entry_idx);
+        }
+        for(const auto &kv : checkpoint->get_done_lightweight()) {
+            if(kv.second) {
+                analysis_obj.vcall_file.add_possible_vcall(kv.first);
+            }
+        }
+
+        // The repetition of icalls is decided after the first round.
+        repeat_icall_mtx.lock();
+        for(const auto &kv : checkpoint->get_done_vcalls()) {
+            if(kv.second.is_repeat) {
+                engels_park_icall(kv.first,
+                                  kv.second.unresolvable_icalls,
+                                  kv.second.unresolvable_vfuncs);
+            }
+        }
+        repeat_icall_mtx.unlock();
+
+        cout << "Resuming engels analysis with "
+             << dec << checkpoint->get_done_lightweight().size()
+             << " lightweight and "
+             << dec << checkpoint->get_done_vcalls().size()
+             << " icall analyses finished."
+             << "\n";
+    }
+
+    const AnalysisShard *shard = analysis_obj.shard;
+    bool is_sharded = shard && shard->is_sharded();
+
+    // Each thread gets its own part of the queues.
+    queue_icall_addrs.set_num_workers(num_threads);
+    queue_vcall_addrs.set_num_workers(num_threads);
+    queue_vtable_xref_addrs.set_num_workers(num_threads);
+
+    // The most expensive items are queued first (and hence started first
+    // by the workers).
+    EngelsCostModel cost_model(analysis_obj.translator,
+                               analysis_obj.vtable_file);
+    cost_model.import_history(target_dir, module_name);
+
     // Set up queue with all icall addresses that have to be analyzed.
-    queue_icall_mtx.lock();
+    vector<uint64_t> icall_items;
+    uint64_t num_dynamic_vcalls = 0;
     for(uint64_t icall_addr : icall_set) {
+        if(is_incremental && !incremental->is_affected_icall(icall_addr)) {
+            continue;
+        }
+        if(is_resumed
+           && checkpoint->get_done_lightweight().count(icall_addr)) {
+            continue;
+        }
+        if(is_sharded && !shard->contains(icall_addr)) {
+            continue;
+        }
+        if(analysis_obj.dynamic_vcalls
+           && analysis_obj.dynamic_vcalls->count(icall_addr)) {
+            analysis_obj.vcall_file.add_possible_vcall(icall_addr);
+            num_dynamic_vcalls++;
+            continue;
+        }
+        icall_items.push_back(icall_addr);
+    }
+    if(analysis_obj.dynamic_vcalls) {
+        cout << "Dynamically confirmed vcalls: "
+             << dec << num_dynamic_vcalls
+             << " queued without lightweight analysis."
+             << "\n";
+    }
+    cost_model.sort_by_cost(InstrItemLightweightICall, icall_items);
+    for(uint64_t icall_addr : icall_items) {
         queue_icall_addrs.push(icall_addr);
     }
-    queue_icall_mtx.unlock();
 
     // Set up all vtable xrefs that have to be analyzed.
     EngelsVTableXrefAnalysis vtable_xref_data;
     const VTableMap &this_vtables = analysis_obj.vtable_file.get_this_vtables();
-    queue_vtable_xref_mtx.lock();
+    vector<uint64_t> vtable_xref_items;
     vtable_xref_data_mtx.lock();
     for(const auto &kv : this_vtables) {
+        bool is_affected = !is_incremental
+                           || incremental->is_affected_vtable(
+                                                          kv.second->index);
         for(uint64_t xref_addr : kv.second->xrefs) {
-            queue_vtable_xref_addrs.push(xref_addr);
+            if(is_affected) {
+                vtable_xref_items.push_back(xref_addr);
+            }
             vtable_xref_data.xref_vtable_idx_map[xref_addr] = kv.second->index;
         }
     }
     vtable_xref_data_mtx.unlock();
-    queue_vtable_xref_mtx.unlock();
-
-    // Analyze all icalls in a fast way to find possible vcalls.
-    // For debugging purposes do not spawn any thread.
-    if(num_threads == 1) {
-        engels_vcall_lightweight_analysis(module_name,
-                                    target_dir,
-                                    analysis_obj,
-                                    0);
+    cost_model.sort_by_cost(InstrItemVTableXref, vtable_xref_items);
+    for(uint64_t xref_addr : vtable_xref_items) {
+        queue_vtable_xref_addrs.push(xref_addr);
     }
-    else {
-        thread *all_threads = new thread[num_threads];
-        for(uint32_t i = 0; i < num_threads; i++) {
-            all_threads[i] = thread(engels_vcall_lightweight_analysis,
-                                    module_name,
-                                    target_dir,
-                                    ref(analysis_obj),
-                                    i);
-        }
-        for(uint32_t i = 0; i < num_threads; i++) {
-            all_threads[i].join();
+
+    // Get all already as vcall identified addresses for our heavy
+    // analysis pass. Addresses identified by the lightweight analysis
+    // are added by the pipeline as soon as they are found.
+    EngelsPipeline pipeline;
+    pipeline.pending_vtable_xrefs = queue_vtable_xref_addrs.size();
+    pipeline.pending_lightweight = queue_icall_addrs.size();
+    if(is_resumed) {
+        for(const auto &kv : checkpoint->get_done_vcalls()) {
+            pipeline.scheduled_vcalls.insert(kv.first);
         }
-        delete [] all_threads;
     }
-
-    // Get all as vcall identified addresses for our heavy analysis pass.
-    const PossibleVCalls &possible_vcalls =
+    const PossibleVCalls possible_vcalls =
                                    analysis_obj.vcall_file.get_possible_vcall();
-
-    queue_vcall_mtx.lock();
+    vector<uint64_t> vcall_items;
     for(uint64_t vcall_addr : possible_vcalls) {
-        queue_vcall_addrs.push(vcall_addr);
+        if(is_incremental && !incremental->is_affected_icall(vcall_addr)) {
+            continue;
+        }
+        if(is_resumed && checkpoint->get_done_vcalls().count(vcall_addr)) {
+            continue;
+        }
+        if(is_sharded && !shard->contains(vcall_addr)) {
+            continue;
+        }
+        vcall_items.push_back(vcall_addr);
+    }
+    cost_model.sort_by_cost(InstrItemVCall, vcall_items);
+    for(uint64_t vcall_addr : vcall_items) {
+        engels_pipeline_push_vcall(pipeline, vcall_addr);
     }
-    queue_vcall_mtx.unlock();
 
-    // Analyze all vtable xrefs.
-    // For debugging purposes do not spawn any thread.
+    // The worker threads are kept alive for all rounds of the icall
+    // analysis. For debugging purposes do not spawn any thread.
+    thread *all_threads = nullptr;
     if(num_threads == 1) {
-        engels_vtable_xref_analysis(module_name,
-                                    target_dir,
-                                    analysis_obj,
-                                    vtable_xref_data,
-                                    0);
+        pipeline.exit_when_idle = true;
     }
     else {
-        thread *all_threads = new thread[num_threads];
+        all_threads = new thread[num_threads];
         for(uint32_t i = 0; i < num_threads; i++) {
-            all_threads[i] = thread(engels_vtable_xref_analysis,
+            all_threads[i] = thread(engels_pipeline_worker,
                                     module_name,
                                     target_dir,
                                     ref(analysis_obj),
                                     ref(vtable_xref_data),
+                                    ref(pipeline),
                                     i);
         }
-        for(uint32_t i = 0; i < num_threads; i++) {
-            all_threads[i].join();
-        }
-        delete [] all_threads;
     }
 
+    // Icalls parked by an interrupted run can depend on the imported
+    // results, hence all of them are checked after the first round.
+    bool is_check_all = is_resumed;
+
     while(true) {
 
-        // Analyze all icalls.
-        // For debugging purposes do not spawn any thread.
+        // Wait until all queued work of this round is processed.
+        ScopedPhaseTimer round_timer("engels_round");
         if(num_threads == 1) {
-            engels_icall_analysis(module_name,
-                               target_dir,
-                               analysis_obj,
-                               vtable_xref_data,
-                               0);
+            engels_pipeline_worker(module_name,
+                                   target_dir,
+                                   analysis_obj,
+                                   vtable_xref_data,
+                                   pipeline,
+                                   0);
         }
         else {
-            thread *all_threads = new thread[num_threads];
-            for(uint32_t i = 0; i < num_threads; i++) {
-                all_threads[i] = thread(engels_icall_analysis,
-                                        module_name,
-                                        target_dir,
-                                        ref(analysis_obj),
-                                        ref(vtable_xref_data),
-                                        i);
-            }
-            for(uint32_t i = 0; i < num_threads; i++) {
-                all_threads[i].join();
-            }
-            delete [] all_threads;
+            unique_lock<mutex> lock(pipeline.mtx);
+            pipeline.cv.wait(lock, [&] {
+                return engels_pipeline_is_idle(pipeline);
+            });
         }
 
-        // Copy all engel results into our vcall result object
-        // and add them to the function xrefs.
-        analysis_obj.results_mtx.lock();
-        Translator &translator = analysis_obj.translator;
-        for(const auto &kv : analysis_obj.results) {
-            uint64_t icall_addr = kv.first;
-            for(const EngelsResult &result : kv.second) {
-
-                // Check the sanity of the result (i.e., .bss vtables
-                // do not have entries at the moment).
-                const VTable &vtable = analysis_obj.vtable_file.get_vtable(
-                                                             result.vtable_idx);
-                if(result.entry_idx >= vtable.entries.size()) {
-                    continue;
-                }
-
-                // Add vcall data.
-                analysis_obj.vcall_file.add_vcall(icall_addr,
-                                                  result.vtable_idx,
-                                                  result.entry_idx);
-
-                // Add function xref data.
-                uint64_t fct_addr = vtable.entries.at(result.entry_idx);
-                try {
-                    translator.add_function_vfunc_xref(fct_addr, icall_addr);
-                }
-                catch(...) {
-                    cerr << "Not able to add callsite xref from function "
-                         << hex << fct_addr
-                         << " to callsite "
-                         << hex << icall_addr
-                         << ". Function does not exist."
-                         << "\n";
-                }
-                // Add also all known vtables from the hierarchy.
-                const HierarchiesVTable &hierarchies =
-                              analysis_obj.vtable_hierarchies.get_hierarchies();
-                for(const DependentVTables &hierarchy : hierarchies) {
-                    if(hierarchy.find(result.vtable_idx) != hierarchy.cend()) {
-                        for(uint32_t hier_vtbl_idx : hierarchy) {
-                            const VTable &hier_vtbl =
-                                    analysis_obj.vtable_file.get_vtable(
-                                                                 hier_vtbl_idx);
-                            if(result.entry_idx >= hier_vtbl.entries.size()) {
-                                continue;
-                            }
-                            fct_addr = hier_vtbl.entries.at(result.entry_idx);
-                            try {
-                                translator.add_function_vfunc_xref(fct_addr,
-                                                                   icall_addr);
-                            }
-                            catch(...) {
-                            }
-                        }
-                        break;
-                    }
-                }
-            }
+        // All workers are idle, hence their results can be merged.
+        EngelsPublished published;
+        {
+            ScopedPhaseTimer merge_timer("engels_merge_results");
+            engels_merge_results(analysis_obj, &published);
         }
-        analysis_obj.results_mtx.unlock();
+        const Translator &translator = analysis_obj.translator;
 
         // Stop icall analysis if we do not have any icall which analysis
-        // should be repeated.
-        if(repeat_icall_addrs.empty()) {
+        // should be repeated. A shard only does the first round, the
+        // repetitions (stored in its checkpoint) are done after the merge
+        // since they depend on the results of all shards.
+        if(repeat_icall_addrs.empty() || is_sharded) {
             break;
         }
 
         // Process icall candidates whose analysis should be repeated.
+        // Only icalls waiting for one of the icalls or virtual functions
+        // published by this merge can have become resolvable.
         else {
-            queue_vcall_mtx.lock();
             repeat_icall_mtx.lock();
 
+            unordered_set<uint64_t> candidates;
+            if(is_check_all) {
+                candidates = repeat_icall_addrs;
+                is_check_all = false;
+            }
+            for(uint64_t icall_addr : published.icall_addrs) {
+                auto it = icall_addr_dependents_map.find(icall_addr);
+                if(it != icall_addr_dependents_map.end()) {
+                    candidates.insert(it->second.begin(), it->second.end());
+                    icall_addr_dependents_map.erase(it);
+                }
+            }
+            for(uint64_t vfunc_addr : published.vfunc_addrs) {
+                auto it = vfunc_addr_dependents_map.find(vfunc_addr);
+                if(it != vfunc_addr_dependents_map.end()) {
+                    candidates.insert(it->second.begin(), it->second.end());
+                    vfunc_addr_dependents_map.erase(it);
+                }
+            }
+
+            // Resume the icalls in a deterministic order.
+            vector<uint64_t> candidate_addrs;
+            for(uint64_t icall_addr : candidates) {
+                if(repeat_icall_addrs.count(icall_addr)) {
+                    candidate_addrs.push_back(icall_addr);
+                }
+            }
+            sort(candidate_addrs.begin(), candidate_addrs.end());
+
             uint32_t ctr_icall_resolvable = 0;
             uint32_t ctr_vfunc_resolvable = 0;
-            for(auto it = repeat_icall_addrs.begin();
-                it != repeat_icall_addrs.end();) {
+            uint32_t ctr_repeat = 0;
+            for(uint64_t icall_addr : candidate_addrs) {
 
                 // Mark icall as repeatable if we can now resolve its
                 // unresolvable icall instructions during the
                 // data flow analysis.
                 bool is_repeatable = false;
                 for(uint64_t unresolvable_icall_addr :
-                    icall_addr_unresolvable_map.at(*it)) {
+                    icall_addr_unresolvable_map.at(icall_addr)) {
 
                     if(analysis_obj.vcall_file.is_known_vcall(
                                                  unresolvable_icall_addr)) {
                         ctr_icall_resolvable++;
                         is_repeatable = true;
-                        icall_addr_unresolvable_map[*it].clear();
+                        icall_addr_unresolvable_map[icall_addr].clear();
                         break;
                     }
                 }
@@ -243,7 +373,7 @@ void engels_analysis(const string &target_file,
                 // Mark icall as repeatable if we can now resolve its
                 // unresolvable virtual functions during the data flow analysis.
                 for(uint64_t unresolvable_vfunc_addr :
-                    vfunc_addr_unresolvable_map.at(*it)) {
+                    vfunc_addr_unresolvable_map.at(icall_addr)) {
 
                     try {
                         const Function &vfunc = translator.cget_function(
@@ -251,7 +381,7 @@ void engels_analysis(const string &target_file,
                         if(!vfunc.get_vfunc_xrefs().empty()) {
                             ctr_vfunc_resolvable++;
                             is_repeatable = true;
-                            vfunc_addr_unresolvable_map[*it].clear();
+                            vfunc_addr_unresolvable_map[icall_addr].clear();
                             break;
                         }
                     }
@@ -259,13 +389,12 @@ void engels_analysis(const string &target_file,
                     }
                 }
 
-                // Add icall to queue if it is marked as repeatable.
+                // Add icall to queue if it is marked as repeatable
+                // (the idle workers start with it right away).
                 if(is_repeatable) {
-                    queue_vcall_addrs.push(*it);
-                    it = repeat_icall_addrs.erase(it);
-                }
-                else {
-                    ++it;
+                    engels_pipeline_push_vcall(pipeline, icall_addr);
+                    ctr_repeat++;
+                    repeat_icall_addrs.erase(icall_addr);
                 }
             }
 
@@ -277,357 +406,785 @@ void engels_analysis(const string &target_file,
                  << "\n";
 
             repeat_icall_mtx.unlock();
-            queue_vcall_mtx.unlock();
 
             // Stop processing if we do not have any new icall that
             // can deliver new results.
-            if(queue_vcall_addrs.empty()) {
+            if(ctr_repeat == 0) {
                 break;
             }
 
             cout << "Re-analyzing "
                  << dec
-                 << queue_vcall_addrs.size()
+                 << ctr_repeat
                  << " indirect calls."
                  << "\n";
         }
     }
+
+    // Shut down the worker threads.
+    pipeline.mtx.lock();
+    pipeline.stop = true;
+    pipeline.version++;
+    pipeline.mtx.unlock();
+    pipeline.cv.notify_all();
+    if(all_threads) {
+        for(uint32_t i = 0; i < num_threads; i++) {
+            all_threads[i].join();
+        }
+        delete [] all_threads;
+    }
+
+    // Write the pending messages of the workers.
+    Logger::get_instance().flush();
+
+    uint64_t num_exceeded_time =
+                     ScopedItemBudget::get_num_exceeded(ItemBudgetTime);
+    uint64_t num_exceeded_nodes =
+                     ScopedItemBudget::get_num_exceeded(ItemBudgetGraphNodes);
+    uint64_t num_exceeded_paths =
+                     ScopedItemBudget::get_num_exceeded(ItemBudgetPaths);
+    if(num_exceeded_time || num_exceeded_nodes || num_exceeded_paths) {
+        cout << "Items exceeding their budget: "
+             << dec << num_exceeded_time
+             << " (time), "
+             << dec << num_exceeded_nodes
+             << " (graph nodes), "
+             << dec << num_exceeded_paths
+             << " (paths)."
+             << "\n";
+    }
+
+    const char *tier_names[EngelsTierNum] = {"lightweight", "icall"};
+    for(uint32_t tier = 0; tier < EngelsTierNum; tier++) {
+        const EngelsTierStats &stats = analysis_obj.tier_stats[tier];
+        cout << "Tier "
+             << tier_names[tier]
+             << ": "
+             << dec << stats.num_sites
+             << " sites analyzed, "
+             << dec << stats.num_settled
+             << " settled, "
+             << dec << stats.time_us / 1000
+             << " ms."
+             << "\n";
+    }
 }
 
-void engels_vtable_xref_analysis(const string &module_name,
-                                 const string &target_dir,
-                                 EngelsAnalysisObjects &analysis_obj,
-                                 EngelsVTableXrefAnalysis &vtable_xref_data,
-                                 uint32_t thread_number) {
+/*!
+ * \brief Merges the result deltas of all worker threads into the results
+ * (must only be called while no worker is running).
+ *
+ * Only the new results are added to the vcall result object and
+ * the function xrefs.
+ *
+ * \param published If set, the icalls and virtual functions that got
+ * results are added to it.
+ */
+void engels_merge_results(EngelsAnalysisObjects &analysis_obj,
+                          EngelsPublished *published) {
+    for(EngelsResultDelta &delta : analysis_obj.result_deltas) {
+        for(const EngelsResult &result : delta) {
+            uint64_t icall_addr = result.icall_addr;
+            analysis_obj.results[icall_addr].push_back(result);
+            engels_add_vcall_data(analysis_obj,
+                                  icall_addr,
+                                  result.vtable_idx,
+                                  result.entry_idx,
+                                  published);
+        }
+        delta.clear();
+    }
+}
+
+/*!
+ * \brief Adds the vcall data and function xrefs of a result
+ * (must only be called while no worker is running).
+ */
+void engels_add_vcall_data(EngelsAnalysisObjects &analysis_obj,
+                           uint64_t icall_addr,
+                           uint32_t vtable_idx,
+                           uint32_t entry_idx,
+                           EngelsPublished *published) {
+    Translator &translator = analysis_obj.translator;
+
+    // Check the sanity of the result (i.e., .bss vtables
+    // do not have entries at the moment).
+    const VTable &vtable = analysis_obj.vtable_file.get_vtable(vtable_idx);
+    if(entry_idx >= vtable.entries.size()) {
+        return;
+    }
 
-    cout << "Starting vtable xref analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
+    // Add vcall data.
+    analysis_obj.vcall_file.add_vcall(icall_addr, vtable_idx, entry_idx);
+    if(published) {
+        published->icall_addrs.insert(icall_addr);
+    }
+
+    // Add function xref data.
+    uint64_t fct_addr = vtable.entries.at(entry_idx);
+    try {
+        translator.add_function_vfunc_xref(fct_addr, icall_addr);
+        if(published) {
+            published->vfunc_addrs.insert(fct_addr);
+        }
+    }
+    catch(...) {
+        cerr << "Not able to add callsite xref from function "
+             << hex << fct_addr
+             << " to callsite "
+             << hex << icall_addr
+             << ". Function does not exist."
+             << "\n";
+    }
+
+    // Add also all known vtables from the hierarchy.
+    const DependentVTables *hierarchy =
+                     analysis_obj.vtable_hierarchies.get_hierarchy(vtable_idx);
+    if(hierarchy != nullptr) {
+        for(uint32_t hier_vtbl_idx : *hierarchy) {
+            const VTable &hier_vtbl =
+                           analysis_obj.vtable_file.get_vtable(hier_vtbl_idx);
+            if(entry_idx >= hier_vtbl.entries.size()) {
+                continue;
+            }
+            fct_addr = hier_vtbl.entries.at(entry_idx);
+            try {
+                translator.add_function_vfunc_xref(fct_addr, icall_addr);
+                if(published) {
+                    published->vfunc_addrs.insert(fct_addr);
+                }
+            }
+            catch(...) {
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Parks the analysis of the given icall until one of the given icalls
+ * or virtual functions becomes resolvable (`repeat_icall_mtx` has to be
+ * held). \see `EngelsPublished`
+ */
+void engels_park_icall(uint64_t icall_addr,
+                       const unordered_set<uint64_t> &unresolvable_icalls,
+                       const unordered_set<uint64_t> &unresolvable_vfuncs) {
+    repeat_icall_addrs.insert(icall_addr);
+    icall_addr_unresolvable_map[icall_addr] = unresolvable_icalls;
+    vfunc_addr_unresolvable_map[icall_addr] = unresolvable_vfuncs;
+    for(uint64_t unresolvable_icall_addr : unresolvable_icalls) {
+        icall_addr_dependents_map[unresolvable_icall_addr].insert(icall_addr);
+    }
+    for(uint64_t unresolvable_vfunc_addr : unresolvable_vfuncs) {
+        vfunc_addr_dependents_map[unresolvable_vfunc_addr].insert(icall_addr);
+    }
+}
+
+/*!
+ * \brief Adds a result to the delta of the calling worker thread.
+ */
+void engels_add_result(const BaseInstructionSSAPtr &icall_instr,
+                       const ExpressionPtr &call_reg_expr_ptr,
+                       uint32_t vtable_idx,
+                       uint32_t entry_idx) {
+    EngelsResult result;
+    result.icall_addr = icall_instr->get_address();
+    result.vtable_idx = vtable_idx;
+    result.entry_idx = entry_idx;
+#if DEBUG_ENGELS_KEEP_RESULT_DIAGNOSTICS
+    result.icall_instr = icall_instr;
+    result.call_reg_expr_ptr = call_reg_expr_ptr;
+#endif
+    thread_result_delta->push_back(result);
+}
+
+/*!
+ * \brief Estimates the heap bytes of the given results.
+ */
+size_t engels_results_footprint(const EngelsResultMap &results) {
+    size_t bytes = footprint_tree(results);
+    for(const auto &kv : results) {
+        bytes += footprint_vector(kv.second);
+    }
+    return bytes;
+}
+
+/*!
+ * \brief Returns if a result for the given icall and vtable was found
+ * (either in a previous round or by the calling worker thread).
+ */
+bool engels_has_result(const EngelsAnalysisObjects &analysis_obj,
+                       uint64_t icall_addr,
+                       uint32_t vtable_idx) {
+    for(const EngelsResult &result : *thread_result_delta) {
+        if(result.vtable_idx == vtable_idx
+           && result.icall_addr == icall_addr) {
+            return true;
+        }
+    }
+
+    const auto results_it = analysis_obj.results.find(icall_addr);
+    if(results_it == analysis_obj.results.cend()) {
+        return false;
+    }
+    for(const EngelsResult &result : results_it->second) {
+        if(result.vtable_idx == vtable_idx) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+ * \brief Stores the results the calling worker thread found for the given
+ * icall since the delta had `num_results` entries (and if its analysis is
+ * repeated) in the checkpoint.
+ */
+void engels_checkpoint_vcall(EngelsCheckpoint &checkpoint,
+                             uint64_t vcall_addr,
+                             size_t num_results) {
+    IncrementalResults results;
+    for(size_t i = num_results; i < thread_result_delta->size(); i++) {
+        const EngelsResult &result = thread_result_delta->at(i);
+        IncrementalResult checkpoint_result;
+        checkpoint_result.icall_addr = result.icall_addr;
+        checkpoint_result.vtable_idx = result.vtable_idx;
+        checkpoint_result.entry_idx = result.entry_idx;
+        results.push_back(checkpoint_result);
+    }
+
+    CheckpointVCall vcall;
+    repeat_icall_mtx.lock();
+    if(repeat_icall_addrs.find(vcall_addr) != repeat_icall_addrs.cend()) {
+        vcall.is_repeat = true;
+        vcall.unresolvable_icalls = icall_addr_unresolvable_map[vcall_addr];
+        vcall.unresolvable_vfuncs = vfunc_addr_unresolvable_map[vcall_addr];
+    }
+    repeat_icall_mtx.unlock();
+
+    checkpoint.add_vcall(vcall_addr, results, vcall);
+}
+
+/*!
+ * \brief Adds an icall to the queue of the (heavy) icall analysis.
+ */
+void engels_pipeline_push_vcall(EngelsPipeline &pipeline,
+                                uint64_t vcall_addr) {
+    pipeline.mtx.lock();
+    pipeline.scheduled_vcalls.insert(vcall_addr);
+    pipeline.pending_vcalls++;
+    pipeline.version++;
+    queue_vcall_addrs.push(vcall_addr);
+    pipeline.mtx.unlock();
+    pipeline.cv.notify_all();
+}
+
+/*!
+ * \brief Returns if all queued work is processed (`pipeline.mtx` has to
+ * be held).
+ */
+bool engels_pipeline_is_idle(const EngelsPipeline &pipeline) {
+    return pipeline.pending_vtable_xrefs == 0
+           && pipeline.pending_lightweight == 0
+           && pipeline.pending_vcalls == 0;
+}
+
+/*!
+ * \brief Worker thread processing the vtable xref, vcall lightweight and
+ * icall analysis without barriers between them.
+ *
+ * Vtable xrefs are processed first. Icalls start as soon as all vtable xref
+ * analyses are finished because they incorporate their results. Icalls
+ * identified as possible vcalls by the lightweight analysis are queued for
+ * the icall analysis directly.
+ */
+void engels_pipeline_worker(const string &module_name,
+                            const string &target_dir,
+                            EngelsAnalysisObjects &analysis_obj,
+                            EngelsVTableXrefAnalysis &vtable_xref_data,
+                            EngelsPipeline &pipeline,
+                            uint32_t thread_number) {
+
+    NumaPlacement::get_instance().pin_thread(thread_number);
+
+    LOG_INFO("Starting engels analysis (Thread: "
+             << dec << thread_number
+             << ")");
+
+    thread_result_delta = &analysis_obj.result_deltas.at(thread_number);
 
     while(true) {
 
-        // Get next vtable xref that has to be analyzed.
-        uint64_t vtable_xref_addr;
-        queue_vtable_xref_mtx.lock();
-        if(queue_vtable_xref_addrs.empty()) {
-            queue_vtable_xref_mtx.unlock();
-            break;
+        pipeline.mtx.lock();
+        uint64_t version = pipeline.version;
+        bool vtable_xrefs_done = pipeline.pending_vtable_xrefs == 0;
+        pipeline.mtx.unlock();
+
+        uint64_t addr;
+        if(queue_vtable_xref_addrs.pop(thread_number, addr)) {
+            engels_vtable_xref_analysis(module_name,
+                                        target_dir,
+                                        analysis_obj,
+                                        vtable_xref_data,
+                                        addr,
+                                        thread_number);
+
+            pipeline.mtx.lock();
+            pipeline.pending_vtable_xrefs--;
+            pipeline.version++;
+            pipeline.mtx.unlock();
+            pipeline.cv.notify_all();
+            continue;
         }
-        vtable_xref_addr = queue_vtable_xref_addrs.front();
-        queue_vtable_xref_addrs.pop();
-        cout << "Analyzing vtable xref at address: "
-             << hex << vtable_xref_addr
-             << ". Remaining vtable xrefs to analyze: "
-             << dec << queue_vtable_xref_addrs.size()
-             << " (Thread: " << dec << thread_number << ")"
-             << endl;
-        queue_vtable_xref_mtx.unlock();
-
-        // Make sure the function object for the vtable xref address exists.
-        const Function *temp_start_func = nullptr;
-        try {
-            temp_start_func = &analysis_obj.translator.get_containing_function(
-                                                              vtable_xref_addr);
-        }
-        catch(...) {
-            cerr << "Function for vtable xref address "
-                 << hex << vtable_xref_addr
-                 << " not found. Skipping."
-                 << "\n";
+
+        if(vtable_xrefs_done
+           && queue_vcall_addrs.pop(thread_number, addr)) {
+            size_t num_results = thread_result_delta->size();
+            const auto tier_start = chrono::steady_clock::now();
+            engels_icall_analysis(module_name,
+                                  target_dir,
+                                  analysis_obj,
+                                  vtable_xref_data,
+                                  addr,
+                                  thread_number);
+            engels_count_tier(analysis_obj,
+                              EngelsTierHeavy,
+                              tier_start,
+                              thread_result_delta->size() != num_results);
+            if(analysis_obj.checkpoint) {
+                engels_checkpoint_vcall(*analysis_obj.checkpoint,
+                                        addr,
+                                        num_results);
+            }
+
+            pipeline.mtx.lock();
+            pipeline.pending_vcalls--;
+            pipeline.version++;
+            pipeline.mtx.unlock();
+            pipeline.cv.notify_all();
             continue;
         }
-        const Function &start_func = *temp_start_func;
-
-        const BaseInstructionSSAPtr *temp_instr_ptr = nullptr;
-        try {
-            // `SSAInstrTypeInstruction` can only have one instruction returned
-            // (otherwise the data structure is corrupted). Use the only
-            // instruction from the set.
-            const BaseInstructionSSAPtrSet temp_instrs =
-                                start_func.get_instruction_ssa(
-                                                       vtable_xref_addr,
-                                                       SSAInstrTypeInstruction);
-            for(const BaseInstructionSSAPtr &temp_instr : temp_instrs) {
-                temp_instr_ptr = &temp_instr;
-                break;
+
+        if(queue_icall_addrs.pop(thread_number, addr)) {
+            size_t num_results = thread_result_delta->size();
+            const auto tier_start = chrono::steady_clock::now();
+            bool is_resolved = false;
+            bool is_vcall = engels_vcall_lightweight_analysis(module_name,
+                                                              target_dir,
+                                                              analysis_obj,
+                                                              addr,
+                                                              thread_number,
+                                                              is_resolved);
+            engels_count_tier(analysis_obj,
+                              EngelsTierLightweight,
+                              tier_start,
+                              !is_vcall || is_resolved);
+            if(analysis_obj.checkpoint) {
+                analysis_obj.checkpoint->add_lightweight(addr, is_vcall);
+
+                // A resolved vcall is finished as well.
+                if(is_resolved) {
+                    engels_checkpoint_vcall(*analysis_obj.checkpoint,
+                                            addr,
+                                            num_results);
+                }
             }
-            if(temp_instr_ptr == nullptr) {
-                throw runtime_error("Not able to find instruction");
+
+            // Icalls that were already queued are not added twice.
+            pipeline.mtx.lock();
+            bool is_new = is_vcall
+                     && !is_resolved
+                     && pipeline.scheduled_vcalls.find(addr)
+                        == pipeline.scheduled_vcalls.cend();
+            pipeline.mtx.unlock();
+            if(is_new) {
+                engels_pipeline_push_vcall(pipeline, addr);
             }
-        }
-        catch(...) {
-            cerr << "Not able to find instruction with address "
-                 << hex << vtable_xref_addr
-                 << " and type "
-                 << dec << SSAInstrTypeInstruction
-                 << " to process vtable xref. Skipping.";
+
+            pipeline.mtx.lock();
+            pipeline.pending_lightweight--;
+            pipeline.version++;
+            pipeline.mtx.unlock();
+            pipeline.cv.notify_all();
             continue;
         }
-        const BaseInstructionSSAPtr &start_instr = *temp_instr_ptr;
 
-        // Check if we have a definition.
-        const OperandSSAPtrs &defs = start_instr->get_definitions();
-        if(defs.empty()) {
-            cerr << "Instruction "
-                 << *start_instr
-                 << " does not have definition. Skipping.";
-            continue;
+        // No work is available at the moment. Wait until the
+        // state of the pipeline changes.
+        unique_lock<mutex> lock(pipeline.mtx);
+        if(pipeline.stop
+           || (pipeline.exit_when_idle && engels_pipeline_is_idle(pipeline))) {
+            break;
         }
+        pipeline.cv.wait(lock, [&] {
+            return pipeline.version != version || pipeline.stop;
+        });
+    }
 
-        // Create xref analysis object in a global data structure in order
-        // to reuse its results during the icall analysis.
-        vtable_xref_data_mtx.lock();
-        vtable_xref_data.xref_analysis_map.emplace(
-                                      vtable_xref_addr,
-                                      std::make_shared<VtableBacktraceAnalysis>(
-                                             module_name,
-                                             target_dir,
-                                             analysis_obj.translator,
-                                             analysis_obj.vcall_file,
-                                             analysis_obj.vtable_file,
-                                             analysis_obj.new_operators,
-                                             vtable_xref_addr));
-        vtable_xref_data_mtx.unlock();
-        VtableBacktraceAnalysisPtr &analysis =
-                           vtable_xref_data.xref_analysis_map[vtable_xref_addr];
-
-        analysis->obtain(400); // TODO make rounds configurable
-
-        // Extract all root instructions of the vtable xref analysis
-        // and store a specialized form of the generated graph.
-        const GraphDataFlow &target_graph = analysis->get_graph();
-        const auto vertices = boost::vertices(target_graph);
-        for(auto it = vertices.first; it != vertices.second; ++it) {
-            const auto in_edges = boost::in_edges(*it, target_graph);
-            if(in_edges.first == in_edges.second) {
-
-                const BaseInstructionSSAPtr &root_instr =
-                                                        target_graph[*it].instr;
-                vtable_xref_data_mtx.lock();
-                vtable_xref_data.root_instr_xrefs_map[root_instr].insert(
-                                                              vtable_xref_addr);
-                vtable_xref_data_mtx.unlock();
-            }
-        }
-    }
-
-    cout << "Finished vtable xref analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
+    LOG_INFO("Finished engels analysis (Thread: "
+             << dec << thread_number
+             << ")");
 }
 
-void engels_vcall_lightweight_analysis(
+void engels_vtable_xref_analysis(const string &module_name,
+                                 const string &target_dir,
+                                 EngelsAnalysisObjects &analysis_obj,
+                                 EngelsVTableXrefAnalysis &vtable_xref_data,
+                                 uint64_t vtable_xref_addr,
+                                 uint32_t thread_number) {
+
+    LOG_PROGRESS("Analyzing vtable xref at address: "
+                 << hex << vtable_xref_addr
+                 << ". Remaining vtable xrefs to analyze: "
+                 << dec << queue_vtable_xref_addrs.size()
+                 << " (Thread: " << dec << thread_number << ")");
+
+    ScopedItemTimer item_timer(InstrItemVTableXref, vtable_xref_addr);
+
+    // Make sure the function object for the vtable xref address exists.
+    const Function *temp_start_func = nullptr;
+    try {
+        temp_start_func = &analysis_obj.translator.get_containing_function(
+                                                          vtable_xref_addr);
+    }
+    catch(...) {
+        cerr << "Function for vtable xref address "
+             << hex << vtable_xref_addr
+             << " not found. Skipping."
+             << "\n";
+        return;
+    }
+    const Function &start_func = *temp_start_func;
+
+    const BaseInstructionSSAPtr *temp_instr_ptr = nullptr;
+    try {
+        // `SSAInstrTypeInstruction` can only have one instruction returned
+        // (otherwise the data structure is corrupted). Use the only
+        // instruction from the set.
+        const BaseInstructionSSAPtrSet temp_instrs =
+                            start_func.get_instruction_ssa(
+                                                   vtable_xref_addr,
+                                                   SSAInstrTypeInstruction);
+        for(const BaseInstructionSSAPtr &temp_instr : temp_instrs) {
+            temp_instr_ptr = &temp_instr;
+            break;
+        }
+        if(temp_instr_ptr == nullptr) {
+            throw runtime_error("Not able to find instruction");
+        }
+    }
+    catch(...) {
+        cerr << "Not able to find instruction with address "
+             << hex << vtable_xref_addr
+             << " and type "
+             << dec << SSAInstrTypeInstruction
+             << " to process vtable xref. Skipping.";
+        return;
+    }
+    const BaseInstructionSSAPtr &start_instr = *temp_instr_ptr;
+
+    // Check if we have a definition.
+    const OperandSSASpan defs = start_instr->get_definitions();
+    if(defs.empty()) {
+        cerr << "Instruction "
+             << *start_instr
+             << " does not have definition. Skipping.";
+        return;
+    }
+
+    // Create xref analysis object in a global data structure in order
+    // to reuse its results during the icall analysis.
+    vtable_xref_data_mtx.lock();
+    vtable_xref_data.xref_analysis_map.emplace(
+                                  vtable_xref_addr,
+                                  std::make_shared<VtableBacktraceAnalysis>(
+                                         module_name,
+                                         target_dir,
+                                         analysis_obj.translator,
+                                         analysis_obj.vcall_file,
+                                         analysis_obj.vtable_file,
+                                         analysis_obj.new_operators,
+                                         vtable_xref_addr));
+    vtable_xref_data_mtx.unlock();
+    VtableBacktraceAnalysisPtr &analysis =
+                       vtable_xref_data.xref_analysis_map[vtable_xref_addr];
+
+    analysis->obtain(400); // TODO make rounds configurable
+
+    // Extract all root instructions of the vtable xref analysis
+    // and store a specialized form of the generated graph.
+    const GraphDataFlow &target_graph = analysis->get_graph();
+    item_timer.set_graph_size(boost::num_vertices(target_graph));
+    const auto vertices = boost::vertices(target_graph);
+    for(auto it = vertices.first; it != vertices.second; ++it) {
+        const auto in_edges = boost::in_edges(*it, target_graph);
+        if(in_edges.first == in_edges.second) {
+
+            const BaseInstructionSSAPtr &root_instr =
+                                                    target_graph[*it].instr;
+            vtable_xref_data_mtx.lock();
+            vtable_xref_data.root_instr_xrefs_map[root_instr].insert(
+                                                          vtable_xref_addr);
+            vtable_xref_data_mtx.unlock();
+        }
+    }
+}
+
+bool engels_vcall_lightweight_analysis(
                            const string &module_name,
                            const string &target_dir,
                            EngelsAnalysisObjects &analysis_obj,
-                           uint32_t thread_number) {
+                           uint64_t icall_addr,
+                           uint32_t thread_number,
+                           bool &is_resolved) {
 
-    cout << "Starting vcall lightweight analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
+    is_resolved = false;
 
-    while(true) {
+    LOG_PROGRESS("Analyzing icall at address: "
+                 << hex << icall_addr
+                 << ". Remaining icalls to analyze: "
+                 << dec << queue_icall_addrs.size()
+                 << " (Thread: " << dec << thread_number << ")");
 
-        // Get next icall that has to be analyzed.
-        uint64_t icall_addr;
-        queue_icall_mtx.lock();
-        if(queue_icall_addrs.empty()) {
-            queue_icall_mtx.unlock();
-            break;
-        }
-        icall_addr = queue_icall_addrs.front();
-        queue_icall_addrs.pop();
-        cout << "Analyzing icall at address: "
+    ScopedItemTimer item_timer(InstrItemLightweightICall, icall_addr);
+
+    // All scratch data of the analysis is released at once at the end.
+    ScopedScratchArena scratch_arena;
+
+    // Make sure the function object for the starting address exists.
+    try {
+        analysis_obj.translator.get_containing_function(icall_addr);
+    }
+    catch(...) {
+        cerr << "Function for icall address "
              << hex << icall_addr
-             << ". Remaining icalls to analyze: "
-             << dec << queue_icall_addrs.size()
-             << " (Thread: " << dec << thread_number << ")"
-             << endl;
-        queue_icall_mtx.unlock();
-
-        // Make sure the function object for the starting address exists.
-        try {
-            analysis_obj.translator.get_containing_function(icall_addr);
-        }
-        catch(...) {
-            cerr << "Function for icall address "
-                 << hex << icall_addr
-                 << " not found. Skipping."
-                 << "\n";
-            continue;
-        }
+             << " not found. Skipping."
+             << "\n";
+        return false;
+    }
 
-        VCallBacktraceLightweight analysis(module_name,
-                               target_dir,
-                               analysis_obj.translator,
-                               analysis_obj.vcall_file,
-                               analysis_obj.vtable_file,
-                               analysis_obj.new_operators,
-                               analysis_obj.vtv_verify_addrs,
-                               icall_addr);
+    VCallBacktraceLightweight analysis(module_name,
+                           target_dir,
+                           analysis_obj.translator,
+                           analysis_obj.vcall_file,
+                           analysis_obj.vtable_file,
+                           analysis_obj.new_operators,
+                           analysis_obj.vtv_verify_addrs,
+                           icall_addr);
+
+    EngelsLightweightResolution resolution;
+    if(analysis_obj.tiering) {
+        thread_lightweight_resolution = &resolution;
+    }
 
+    // An icall exceeding its budget is not considered a possible vcall.
+    ScopedItemBudget budget;
+    bool is_vcall = false;
+    try {
         analysis.obtain(200); // TODO make rounds configurable
+        item_timer.set_graph_size(boost::num_vertices(analysis.get_graph()));
 
-        bool is_vcall = process_vcall_lightweight_analysis(analysis_obj,
-                                                           analysis);
-        if(is_vcall) {
-            analysis_obj.vcall_file.add_possible_vcall(icall_addr);
+        is_vcall = process_vcall_lightweight_analysis(analysis_obj,
+                                                      analysis);
+        thread_lightweight_resolution = nullptr;
+    }
+    catch(const ItemBudgetExceeded &e) {
+        thread_lightweight_resolution = nullptr;
+        ScopedItemBudget::count_exceeded(e.kind());
+        cerr << e.what()
+             << " Lightweight analysis of icall "
+             << hex << icall_addr
+             << " unresolved."
+             << "\n";
+        return false;
+    }
+    if(is_vcall) {
+        analysis_obj.vcall_file.add_possible_vcall(icall_addr);
+
+        // The target is loaded from a known vtable, hence the icall
+        // analysis can not find anything else.
+        if(resolution.is_resolved) {
+            if(!engels_has_result(analysis_obj,
+                                  icall_addr,
+                                  resolution.vtable_idx)) {
+                engels_add_result(resolution.icall_instr,
+                                  resolution.target_expr,
+                                  resolution.vtable_idx,
+                                  resolution.entry_idx);
+            }
+            is_resolved = true;
         }
     }
-
-    cout << "Finished vcall lightweight analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
+    return is_vcall;
 }
 
+static void engels_icall_analysis_budgeted(
+                                EngelsAnalysisObjects &analysis_obj,
+                                ICallAnalysis &analysis,
+                                EngelsVTableXrefAnalysis &vtable_xref_data,
+                                uint64_t icall_addr,
+                                uint32_t thread_number,
+                                ScopedItemTimer &item_timer);
+
 void engels_icall_analysis(const string &module_name,
                            const string &target_dir,
                            EngelsAnalysisObjects &analysis_obj,
                            EngelsVTableXrefAnalysis &vtable_xref_data,
+                           uint64_t icall_addr,
                            uint32_t thread_number) {
 
-    cout << "Starting icall analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
+    LOG_PROGRESS("Analyzing icall at address: "
+                 << hex << icall_addr
+                 << ". Remaining icalls to analyze: "
+                 << dec << queue_vcall_addrs.size()
+                 << " (Thread: " << dec << thread_number << ")");
+
+    ScopedItemTimer item_timer(InstrItemVCall, icall_addr);
 
-    while(true) {
+    // All scratch data of the analysis is released at once at the end.
+    ScopedScratchArena scratch_arena;
 
-        // Get next icall that has to be analyzed.
-        uint64_t icall_addr;
-        queue_vcall_mtx.lock();
-        if(queue_vcall_addrs.empty()) {
-            queue_vcall_mtx.unlock();
-            break;
-        }
-        icall_addr = queue_vcall_addrs.front();
-        queue_vcall_addrs.pop();
-        cout << "Analyzing icall at address: "
+    // Make sure the function object for the starting address exists.
+    try {
+        analysis_obj.translator.get_containing_function(icall_addr);
+    }
+    catch(...) {
+        cerr << "Function for icall address "
              << hex << icall_addr
-             << ". Remaining icalls to analyze: "
-             << dec << queue_vcall_addrs.size()
-             << " (Thread: " << dec << thread_number << ")"
-             << endl;
-        queue_vcall_mtx.unlock();
-
-        // Make sure the function object for the starting address exists.
-        try {
-            analysis_obj.translator.get_containing_function(icall_addr);
-        }
-        catch(...) {
-            cerr << "Function for icall address "
-                 << hex << icall_addr
-                 << " not found. Skipping."
-                 << "\n";
-            continue;
-        }
+             << " not found. Skipping."
+             << "\n";
+        return;
+    }
 
-        ICallAnalysis analysis(module_name,
-                               target_dir,
-                               analysis_obj.translator,
-                               analysis_obj.vcall_file,
-                               analysis_obj.vtable_file,
-                               analysis_obj.new_operators,
-                               analysis_obj.vtv_verify_addrs,
-                               icall_addr);
+    ICallAnalysis analysis(module_name,
+                           target_dir,
+                           analysis_obj.translator,
+                           analysis_obj.vcall_file,
+                           analysis_obj.vtable_file,
+                           analysis_obj.new_operators,
+                           analysis_obj.vtv_verify_addrs,
+                           icall_addr);
+
+    // A vcall exceeding its budget keeps the lightweight result (it stays
+    // a possible vcall) and the results found until then.
+    ScopedItemBudget budget;
+    try {
+        engels_icall_analysis_budgeted(analysis_obj,
+                                       analysis,
+                                       vtable_xref_data,
+                                       icall_addr,
+                                       thread_number,
+                                       item_timer);
+    }
+    catch(const ItemBudgetExceeded &e) {
+        ScopedItemBudget::count_exceeded(e.kind());
+        cerr << e.what()
+             << " Icall analysis of vcall "
+             << hex << icall_addr
+             << " degraded to the lightweight result."
+             << "\n";
+    }
+}
 
-        //analysis.obtain(400); // TODO make rounds configurable
-        analysis.obtain(200); // TODO make rounds configurable
+/*!
+ * \brief Runs the icall analysis of `engels_icall_analysis` (may throw
+ * `ItemBudgetExceeded` at any time).
+ */
+static void engels_icall_analysis_budgeted(
+                                EngelsAnalysisObjects &analysis_obj,
+                                ICallAnalysis &analysis,
+                                EngelsVTableXrefAnalysis &vtable_xref_data,
+                                uint64_t icall_addr,
+                                uint32_t thread_number,
+                                ScopedItemTimer &item_timer) {
 
-        const GraphDataFlow &graph = analysis.get_graph();
+    //analysis.obtain(400); // TODO make rounds configurable
+    analysis.obtain(200); // TODO make rounds configurable
+
+    const GraphDataFlow &graph = analysis.get_graph();
 
 
 
-        // TODO / DEBUG
-        bool merged = false;
+    // TODO / DEBUG
+    bool merged = false;
 
 
 
-        // Copy vertex descriptors of the original graph since we can not
-        // iterate over the graph while we are modifying it.
-        auto vertices = boost::vertices(graph);
-        unordered_set<GraphDataFlow::vertex_descriptor> orig_vertices;
-        for(auto it = vertices.first; it != vertices.second; ++it) {
-            orig_vertices.insert(*it);
-        }
+    // Copy vertex descriptors of the original graph since we can not
+    // iterate over the graph while we are modifying it.
+    auto vertices = boost::vertices(graph);
+    unordered_set<GraphDataFlow::vertex_descriptor> orig_vertices;
+    for(auto it = vertices.first; it != vertices.second; ++it) {
+        orig_vertices.insert(*it);
+    }
 
-        // Check if the vtable xrefs have the same root instructions as
-        // our current icall analysis pass.
-        NodeToNodesMap join_to_vtables_map;
-        for(const auto node : orig_vertices) {
-            const auto in_edges = boost::in_edges(node, graph);
-            if(in_edges.first == in_edges.second) {
-                const BaseInstructionSSAPtr &root_instr = graph[node].instr;
-                if(vtable_xref_data.root_instr_xrefs_map.find(root_instr)
-                   != vtable_xref_data.root_instr_xrefs_map.cend()) {
+    // Check if the vtable xrefs have the same root instructions as
+    // our current icall analysis pass.
+    NodeToNodesMap join_to_vtables_map;
+    for(const auto node : orig_vertices) {
+        const auto in_edges = boost::in_edges(node, graph);
+        if(in_edges.first == in_edges.second) {
+            const BaseInstructionSSAPtr &root_instr = graph[node].instr;
+            if(vtable_xref_data.root_instr_xrefs_map.find(root_instr)
+               != vtable_xref_data.root_instr_xrefs_map.cend()) {
 
-                    // Incorporate all vtable xref graphs into the icall
-                    // analysis graph.
-                    for(uint64_t xref_addr :
-                        vtable_xref_data.root_instr_xrefs_map.at(root_instr)) {
+                // Incorporate all vtable xref graphs into the icall
+                // analysis graph.
+                for(uint64_t xref_addr :
+                    vtable_xref_data.root_instr_xrefs_map.at(root_instr)) {
 
 #if DEBUG_PRINT
-                        cout << "Merging icall "
-                             << hex << icall_addr
-                             << " with vtable xref "
-                             << hex << xref_addr
-                             << " (Thread: " << thread_number << ")"
-                             << "\n";
+                    cout << "Merging icall "
+                         << hex << icall_addr
+                         << " with vtable xref "
+                         << hex << xref_addr
+                         << " (Thread: " << thread_number << ")"
+                         << "\n";
 #endif
 
-                        // Incorporate the vtable xref graph into the icall
-                        // analysis results.
-                        const VtableBacktraceAnalysisPtr &xref_analysis =
-                               vtable_xref_data.xref_analysis_map.at(xref_addr);
-                        const GraphDataFlow &vtbl_xref_graph =
-                                xref_analysis->get_graph();
-                        const InstrGraphNodeMap &vtbl_xref_instr_node_map =
-                                xref_analysis->get_graph_instr_map();
-                        const boost::property_map<GraphDataFlow,
-                                boost::vertex_index_t>::type &indexmap =
-                                            xref_analysis->get_graph_indexmap();
-
-                        GraphDataFlow::vertex_descriptor join_node;
-                        GraphDataFlow::vertex_descriptor vtable_node;
-                        analysis.incorporate_vtable_xref_graph(
-                                                 vtbl_xref_graph,
-                                                 vtbl_xref_instr_node_map,
-                                                 indexmap,
-                                                 root_instr,
-                                                 join_node, // out
-                                                 vtable_node); // out
-
-                        // Store the relation between the join node
-                        // and the vtable assignment node.
-                        join_to_vtables_map[join_node].insert(vtable_node);
-                    }
-
-                    // TODO / DEBUG
-                    merged = true;
+                    // Incorporate the vtable xref graph into the icall
+                    // analysis results.
+                    const VtableBacktraceAnalysisPtr &xref_analysis =
+                           vtable_xref_data.xref_analysis_map.at(xref_addr);
+                    const GraphDataFlow &vtbl_xref_graph =
+                            xref_analysis->get_graph();
+                    const InstrGraphNodeMap &vtbl_xref_instr_node_map =
+                            xref_analysis->get_graph_instr_map();
+                    const boost::property_map<GraphDataFlow,
+                            boost::vertex_index_t>::type &indexmap =
+                                        xref_analysis->get_graph_indexmap();
+
+                    GraphDataFlow::vertex_descriptor join_node;
+                    GraphDataFlow::vertex_descriptor vtable_node;
+                    analysis.incorporate_vtable_xref_graph(
+                                             vtbl_xref_graph,
+                                             vtbl_xref_instr_node_map,
+                                             indexmap,
+                                             root_instr,
+                                             join_node, // out
+                                             vtable_node); // out
+
+                    // Store the relation between the join node
+                    // and the vtable assignment node.
+                    join_to_vtables_map[join_node].insert(vtable_node);
                 }
-            }
-        }
 
-        // TODO / DEBUG
-        if(merged) {
-            analysis.dump_graph("final_merged.dot");
+                // TODO / DEBUG
+                merged = true;
+            }
         }
+    }
 
-        process_icall_dataflow_graph(analysis_obj,
-                                     analysis,
-                                     vtable_xref_data,
-                                     join_to_vtables_map);
-
+    // TODO / DEBUG
+    if(merged) {
+        analysis.dump_graph("final_merged.dot");
     }
 
-    cout << "Finished icall analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
+    item_timer.set_graph_size(boost::num_vertices(graph));
+
+    process_icall_dataflow_graph(analysis_obj,
+                                 analysis,
+                                 vtable_xref_data,
+                                 join_to_vtables_map);
 }
 
 GraphDataFlow::vertex_descriptor get_last_node_in_function_on_path(
@@ -703,30 +1260,10 @@ bool have_control_flow_connection(const Function &function,
     // Get the corresponding nodes in the cfg for the source and destination
     // addresses.
     const GraphCfg &cfg = function.get_cfg();
-    GraphCfg::vertex_descriptor src_cfg_node;
-    GraphCfg::vertex_descriptor dst_cfg_node;
-    bool src_cfg_node_found = false;
-    bool dst_cfg_node_found = false;
-    const auto cfg_vertices = boost::vertices(cfg);
-    for(auto it = cfg_vertices.first;
-        it != cfg_vertices.second;
-        ++it) {
-
-        if(cfg[*it]->get_address() == src_block_addr) {
-            src_cfg_node = *it;
-            src_cfg_node_found = true;
-            if(src_cfg_node_found && dst_cfg_node_found) {
-                break;
-            }
-        }
-        else if(cfg[*it]->get_address() == dst_block_addr) {
-            dst_cfg_node = *it;
-            dst_cfg_node_found = true;
-            if(src_cfg_node_found && dst_cfg_node_found) {
-                break;
-            }
-        }
-    }
+    CfgNode src_cfg_node;
+    CfgNode dst_cfg_node;
+    bool src_cfg_node_found = cfg.find_node(src_block_addr, src_cfg_node);
+    bool dst_cfg_node_found = cfg.find_node(dst_block_addr, dst_cfg_node);
     if(!src_cfg_node_found && !dst_cfg_node_found) {
         stringstream err_msg;
         err_msg << "Not able to find basic blocks in CFG. "
@@ -736,16 +1273,12 @@ bool have_control_flow_connection(const Function &function,
                 << hex << dst_block_addr;
         throw runtime_error(err_msg.str().c_str());
     }
-
-    // Get indexmap in order to work with boost algorithms on the graph.
-    const boost::property_map<
-                        GraphCfg,
-                        boost::vertex_index_t>::type &cfg_indexmap =
-                                                    function.get_cfg_indexmap();
+    if(!src_cfg_node_found || !dst_cfg_node_found) {
+        return false;
+    }
 
     // Generate a path from the source to the destination node.
     ControlFlowPath path_src_dst = create_controlflow_path(cfg,
-                                                           cfg_indexmap,
                                                            src_cfg_node,
                                                            dst_cfg_node);
 
@@ -760,37 +1293,39 @@ vector<BlockPtr> create_artificial_block_vector(
                                       const GraphDataFlow &graph,
                                       const DataFlowPath &data_flow_path) {
 
-    // Since we only create basic blocks with one instruction and vex translates
-    // the whole basic block, we do not want any optimization since we
-    // can lose information otherwise (i.e., lea rdx [rip+0x10000], add rax, rdx
-    // would only write the intermediate into rax).
-    VexRegisterUpdates orig_iropt_register_updates_default =
-                          analysis_obj.vex.get_iropt_register_updates_default();
-    analysis_obj.vex.set_iropt_register_updates_default(
-                                                    VexRegUpdAllregsAtEachInsn);
+    // Since we only create basic blocks with few instructions and vex
+    // translates the whole basic block, we do not want any optimization since
+    // we can lose information otherwise (i.e., lea rdx [rip+0x10000],
+    // add rax, rdx would only write the intermediate into rax). The mode is
+    // passed to each translation since the default is shared by all threads.
 
     const Memory &memory = analysis_obj.translator.get_memory();
 
-    // Create a path of artificial basic blocks with just
-    // the instruction of our data flow path.
-    vector<BlockPtr> path_blocks;
+    vector<uintptr_t> addresses;
+    addresses.reserve(data_flow_path.size());
     for(auto node : data_flow_path) {
+        addresses.push_back(graph[node].instr->get_address());
+    }
 
-        const BaseInstructionSSAPtr &instr = graph[node].instr;
-
-        // Vex is not thread safe, so we have to lock this section.
-        // NOTE: all attempts to make the Vex object thread safe
-        // did not succeed.
-        vex_mutex.lock();
-        size_t real_end = 0;
-        const IRSB &translated_block = analysis_obj.vex.translate(
-                                           memory[instr->get_address()],
-                                           instr->get_address(),
-                                           1,
-                                           &real_end);
-        IRSB *irsb_ptr = deepCopyIRSB_Heap(&translated_block);
-        vex_mutex.unlock();
-
+    // Create a path of artificial basic blocks with just
+    // the instructions of our data flow path. Instructions that directly
+    // follow each other in memory are translated into one block.
+    vector<BlockPtr> path_blocks;
+    size_t pos = 0;
+    while(pos < addresses.size()) {
+
+        size_t num_instrs = 0;
+        const IRSB *irsb_ptr = analysis_obj.vex.translate_instructions(
+                                                   memory[addresses[pos]],
+                                                   &addresses[pos],
+                                                   addresses.size() - pos,
+                                                   VexRegUpdAllregsAtEachInsn,
+                                                   &num_instrs);
+
+        // Vex ends the translation at a call or return instruction, hence
+        // only the last instruction of the block can be one.
+        const BaseInstructionSSAPtr &instr =
+                                 graph[data_flow_path[pos+num_instrs-1]].instr;
         Terminator terminator;
         if(instr->is_call()) {
             terminator.type = TerminatorCall;
@@ -803,195 +1338,528 @@ vector<BlockPtr> create_artificial_block_vector(
         }
         terminator.target = 0;
         terminator.fall_through = 0;
-        BlockPtr block = make_shared<Block>(instr->get_address(),
+        BlockPtr block = make_shared<Block>(addresses[pos],
                                             irsb_ptr,
                                             terminator,
-                                            1);
+                                            num_instrs);
         path_blocks.push_back(block);
+        pos += num_instrs;
     }
 
-    // Reset vex options.
-    analysis_obj.vex.set_iropt_register_updates_default(
-                                           orig_iropt_register_updates_default);
-
     return path_blocks;
 }
 
-void sym_execute_blocks(const EngelsAnalysisObjects &analysis_obj,
-                        const vector<BlockPtr> &exec_blocks,
-                        State &state) {
+/*!
+ * \brief Symbolically executes the block at index `i` of the given blocks.
+ *
+ * The result depends on the block itself and on whether the next block is
+ * the artificial return block (i.e., address 0x0).
+ */
+static void sym_execute_block(const EngelsAnalysisObjects &analysis_obj,
+                              const vector<BlockPtr> &exec_blocks,
+                              uint32_t i,
+                              State &state) {
 
     const unordered_set<uint64_t> &vtv_verify_addrs =
                                                   analysis_obj.vtv_verify_addrs;
     const unordered_set<uint64_t> &new_operators = analysis_obj.new_operators;
 
-    for(uint32_t i = 0; i < exec_blocks.size(); i++) {
-        const BlockPtr &block_ptr = exec_blocks.at(i);
+    const BlockPtr &block_ptr = exec_blocks.at(i);
 
-        // Symbolically execute block.
-        BlockSemantics semantics(*block_ptr, state);
-        state = semantics.get_state();
+    // Symbolically execute block.
+    BlockSemantics semantics(*block_ptr, state);
+    state = semantics.get_state();
 
 #if DEBUG_ENGELS_PRINT_SYM_EXEC_STATES
-        cout << "Block address: " << hex << block_ptr->get_address() << endl;
-        cout << "State:" << endl;
-        cout << state << endl;
+    cout << "Block address: " << hex << block_ptr->get_address() << endl;
+    cout << "State:" << endl;
+    cout << state << endl;
 #endif
 
-        // If the last instruction of the block was a call,
-        // check if it is a call to a vtv verify function.
-        bool is_vtv_verify = false;
-        bool is_new_operator = false;
-        bool is_call_not_taken = false;
-        State::const_iterator ip_value;
-        if(block_ptr->get_terminator().type == TerminatorCall
-           && state.find(register_rip, ip_value)) { // TODO architecture specific
-            ExpressionPtr call_target = ip_value->second;
-            switch(call_target->type()) {
-                case ExpressionConstant: {
-                    Constant &const_temp = static_cast<Constant&>(
-                                                          *call_target);
-                    uint64_t target_addr = const_temp.value();
-
-                    // Our artificial return basic block has the address 0x0,
-                    // hence we can check if we skipped the call.
-                    if((i+1) < exec_blocks.size()
-                       && exec_blocks.at(i+1)->get_address() == 0x0) {
-                        is_call_not_taken = true;
-                    }
-                    if(is_call_not_taken
-                       && vtv_verify_addrs.find(target_addr)
+    // If the last instruction of the block was a call,
+    // check if it is a call to a vtv verify function.
+    bool is_vtv_verify = false;
+    bool is_new_operator = false;
+    bool is_call_not_taken = false;
+    State::const_iterator ip_value;
+    if(block_ptr->get_terminator().type == TerminatorCall
+       && state.find(register_rip, ip_value)) { // TODO architecture specific
+        ExpressionPtr call_target = ip_value->second;
+        switch(call_target->type()) {
+            case ExpressionConstant: {
+                Constant &const_temp = static_cast<Constant&>(
+                                                      *call_target);
+                uint64_t target_addr = const_temp.value();
+
+                // Our artificial return basic block has the address 0x0,
+                // hence we can check if we skipped the call.
+                if((i+1) < exec_blocks.size()
+                   && exec_blocks.at(i+1)->get_address() == 0x0) {
+                    is_call_not_taken = true;
+                }
+                if(is_call_not_taken
+                   && vtv_verify_addrs.find(target_addr)
+                        != vtv_verify_addrs.cend()) {
+                    is_vtv_verify = true;
+                }
+                else if(is_call_not_taken
+                        && new_operators.find(target_addr)
                             != vtv_verify_addrs.cend()) {
-                        is_vtv_verify = true;
-                    }
-                    else if(is_call_not_taken
-                            && new_operators.find(target_addr)
-                                != vtv_verify_addrs.cend()) {
-                        is_new_operator = true;
-                    }
-                    break;
+                    is_new_operator = true;
                 }
-                default:
-                    break;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // VTV stub to verify vtable looks like this:
+    // https://github.com/gcc-mirror/gcc/blob/master/libstdc%2B%2B-v3/libsupc%2B%2B/vtv_stubs.cc
+    // const void*
+    // __VLTVerifyVtablePointer(void**, const void* vtable_ptr)
+    // { return vtable_ptr; }
+    //
+    // Return value contains always vtable pointer
+    // given by the second argument
+    // => copy 2nd arg value to return value.
+    if(is_vtv_verify) {
+        const auto &second_arg_reg = analysis_obj.abi.arguments[1];
+        State::const_iterator ret_value;
+        if(state.find(second_arg_reg, ret_value)) {
+            state.update(analysis_obj.abi.return_value, ret_value->second);
+        }
+    }
+
+    // We do not follow new operators, but we need to simulate their
+    // behavior to return a memory object.
+    else if(is_new_operator) {
+        ExpressionPtr sym_obj_ptr = make_symbolic(
+                                               SymbolicNewObject,
+                                               block_ptr->get_last_address());
+        state.update(analysis_obj.abi.return_value, sym_obj_ptr);
+    }
+
+    // When we did not take the call, we put a symbolic object
+    // as return value.
+    else if(is_call_not_taken) {
+        ExpressionPtr sym_obj_ptr = make_symbolic(
+                                               SymbolicCallNotTaken,
+                                               block_ptr->get_last_address());
+        state.update(analysis_obj.abi.return_value, sym_obj_ptr);
+    }
+}
+
+void sym_execute_blocks(const EngelsAnalysisObjects &analysis_obj,
+                        const vector<BlockPtr> &exec_blocks,
+                        State &state) {
+
+    Instrumentation::get_instance().count(InstrCounterSymExecBlocks);
+    ScopedItemBudget::check_time();
+    MARX_TRACE1(sym__execute__begin, exec_blocks.size());
+
+    for(uint32_t i = 0; i < exec_blocks.size(); i++) {
+        sym_execute_block(analysis_obj, exec_blocks, i, state);
+    }
+
+    MARX_TRACE1(sym__execute__end, exec_blocks.size());
+}
+
+/*!
+ * \brief One step of a path executed by `sym_execute_block_paths` (all
+ * steps with the same description yield the same state if executed on the
+ * same state).
+ */
+struct SymExecStep {
+    uintptr_t address;
+    const IRSB *vex_block;
+    uint32_t num_instructions;
+    TerminatorType terminator_type;
+    bool next_is_ret_block;
+
+    bool operator<(const SymExecStep &other) const {
+        return tie(address, vex_block, num_instructions, terminator_type,
+                   next_is_ret_block)
+               < tie(other.address, other.vex_block, other.num_instructions,
+                     other.terminator_type, other.next_is_ret_block);
+    }
+};
+
+/*!
+ * \brief Node of the prefix tree built by `sym_execute_block_paths`.
+ */
+struct SymExecPathNode {
+    //! Children indexed by the step executed next.
+    map<SymExecStep, uint32_t> children;
+
+    //! Number of paths running through this node that are not executed yet.
+    uint32_t remaining_paths = 0;
+
+    //! State after executing this node (kept at branch points only).
+    unique_ptr<State> snapshot;
+};
+
+/*!
+ * \brief Symbolically executes the given paths of blocks (each starting with
+ * a clone of `initial_state`) and passes the resulting states to `callback`.
+ *
+ * The paths are organized into a prefix tree and the state is snapshotted at
+ * the branch points, hence each common prefix is only executed once. Paths
+ * are still processed in the given order and the result of each path equals
+ * the one of `sym_execute_blocks`.
+ *
+ * \param callback Called with the index and the final state of each path.
+ * Returning `true` stops the execution of all remaining paths.
+ * \return `true`, if the execution was stopped by `callback`.
+ */
+bool sym_execute_block_paths(const EngelsAnalysisObjects &analysis_obj,
+                             const vector<vector<BlockPtr>> &paths,
+                             const State &initial_state,
+                             const SymExecPathCallback &callback) {
+
+    // Build the prefix tree (node 0 is the initial state). A step depends
+    // on the next block as well, see `sym_execute_block`.
+    vector<SymExecPathNode> nodes(1);
+    vector<vector<uint32_t>> path_nodes(paths.size());
+    for(size_t p = 0; p < paths.size(); p++) {
+        const vector<BlockPtr> &blocks = paths[p];
+
+        uint32_t curr_node = 0;
+        nodes[curr_node].remaining_paths++;
+        for(uint32_t i = 0; i < blocks.size(); i++) {
+            const Block &block = *blocks[i];
+            SymExecStep step;
+            step.address = block.get_address();
+            step.vex_block = &block.get_vex_block();
+            step.num_instructions = block.get_num_instructions();
+            step.terminator_type = block.get_terminator().type;
+            step.next_is_ret_block = (i+1) < blocks.size()
+                                     && blocks[i+1]->get_address() == 0x0;
+
+            const auto needle = nodes[curr_node].children.find(step);
+            if(needle != nodes[curr_node].children.cend()) {
+                curr_node = needle->second;
+            }
+            else {
+                uint32_t new_node = nodes.size();
+                nodes[curr_node].children[step] = new_node;
+                nodes.emplace_back();
+                curr_node = new_node;
             }
+
+            nodes[curr_node].remaining_paths++;
+            path_nodes[p].push_back(curr_node);
         }
+    }
+    nodes[0].snapshot.reset(new State(initial_state.clone()));
+
+    for(size_t p = 0; p < paths.size(); p++) {
+        Instrumentation::get_instance().count(InstrCounterSymExecBlocks);
+        ScopedItemBudget::check_time();
 
-        // VTV stub to verify vtable looks like this:
-        // https://github.com/gcc-mirror/gcc/blob/master/libstdc%2B%2B-v3/libsupc%2B%2B/vtv_stubs.cc
-        // const void*
-        // __VLTVerifyVtablePointer(void**, const void* vtable_ptr)
-        // { return vtable_ptr; }
-        //
-        // Return value contains always vtable pointer
-        // given by the second argument
-        // => copy 2nd arg value to return value.
-        if(is_vtv_verify) {
-            const auto &second_arg_reg = system_v_arguments[1]; // TODO architecture specific
-            State::const_iterator ret_value;
-            if(state.find(second_arg_reg, ret_value)) {
-                state.update(register_rax, ret_value->second); // TODO architecture specific
+        const vector<uint32_t> &curr_nodes = path_nodes[p];
+
+        // Resume from the deepest snapshot on the path.
+        uint32_t start = curr_nodes.size();
+        while(start > 0 && !nodes[curr_nodes[start-1]].snapshot) {
+            start--;
+        }
+        const SymExecPathNode &resume_node =
+                               start > 0 ? nodes[curr_nodes[start-1]] : nodes[0];
+        State state = resume_node.snapshot->clone();
+
+        for(uint32_t i = start; i < curr_nodes.size(); i++) {
+            sym_execute_block(analysis_obj, paths[p], i, state);
+
+            // Keep the state if later paths branch off the current one here
+            // (i.e., not all remaining paths continue with the next step).
+            SymExecPathNode &node = nodes[curr_nodes[i]];
+            uint32_t next_remaining = (i+1) < curr_nodes.size()
+                                   ? nodes[curr_nodes[i+1]].remaining_paths
+                                   : 1;
+            if(node.remaining_paths > next_remaining) {
+                node.snapshot.reset(new State(state.clone()));
             }
         }
 
-        // We do not follow new operators, but we need to simulate their
-        // behavior to return a memory object.
-        else if(is_new_operator) {
-            stringstream symbol_name;
-            symbol_name << "new_obj_" << hex << block_ptr->get_last_address();
-            ExpressionPtr sym_obj_ptr = make_shared<Symbolic>(
-                                                             symbol_name.str());
-            state.update(register_rax, sym_obj_ptr); // TODO architecture specific
+        // Release the snapshots no other path resumes from.
+        nodes[0].remaining_paths--;
+        for(uint32_t node_idx : curr_nodes) {
+            SymExecPathNode &node = nodes[node_idx];
+            node.remaining_paths--;
+            if(node.remaining_paths == 0) {
+                node.snapshot.reset();
+            }
         }
 
-        // When we did not take the call, we put a symbolic object
-        // as return value.
-        else if(is_call_not_taken) {
-            stringstream symbol_name;
-            symbol_name << "ret_" << hex << block_ptr->get_last_address();
-            ExpressionPtr sym_obj_ptr = make_shared<Symbolic>(
-                                                             symbol_name.str());
-            state.update(register_rax, sym_obj_ptr); // TODO architecture specific
+        if(callback(p, state)) {
+            return true;
         }
     }
+
+    return false;
 }
 
-inline void get_path(DataFlowPath &out_path,
-                     const DataFlowNodeConnections &backward_node_connections,
-                     GraphDataFlow::vertex_descriptor src_node,
-                     GraphDataFlow::vertex_descriptor dst_node) {
-    GraphDataFlow::vertex_descriptor curr = dst_node;
-    out_path.push_back(curr);
-    while(true) {
-        curr = backward_node_connections.at(curr);
-        out_path.insert(out_path.begin(), curr);
-        if(curr == src_node) {
-            break;
+typedef vector<uint32_t> DataFlowIdPath;
+
+// Paths only needed while a path is expanded (allocated from the arena of
+// the item).
+typedef vector<uint32_t, ScratchAllocator<uint32_t>> ScratchIdPath;
+
+struct DataFlowIdPathHash {
+    template<typename Path>
+    size_t operator() (const Path &e) const {
+        size_t h = e.size();
+        for(uint32_t node : e) {
+            std::hash_combine(h, node);
         }
+        return h;
+    }
+};
+
+/*!
+ * \brief Buffers of the breadth first searches of the calling thread
+ * (nodes are visited if their stamp equals the stamp of the current search,
+ * hence the buffers do not have to be cleared between searches).
+ */
+struct DataFlowSearchBuffers {
+    vector<uint32_t> parents;
+    vector<uint32_t> stamps;
+    vector<uint32_t> target_stamps;
+    vector<uint32_t> queue;
+    vector<uint32_t> targets;
+    vector<DataFlowIdPath> found_paths;
+    DataFlowIdPath path;
+    vector<uint32_t> call_stack;
+    uint32_t stamp = 0;
+};
+
+static thread_local DataFlowSearchBuffers search_buffers;
+
+/*!
+ * \brief Checks if a ret edge can be taken during the search, i.e., if it
+ * returns to the last call made on the path from the source node to the
+ * edge (calls of new operators are ignored).
+ */
+static bool is_dataflow_edge_allowed(
+                               const DataFlowGraphCSR &graph,
+                               const unordered_set<uint64_t> &new_operators,
+                               DataFlowSearchBuffers &buffers,
+                               bool has_discovered,
+                               uint32_t src_node,
+                               uint32_t curr_node,
+                               uint32_t edge) {
+
+    // Only inspect edges that belong to return instructions.
+    if(!graph.is_ret_edge(edge) || !has_discovered) {
+        return true;
+    }
+    uint32_t dst_node = graph.get_target(edge);
+    if(graph.get_instr_type(dst_node) != SSAInstrTypeCallOfRet) {
+        return true;
     }
-}
 
-vector<DataFlowPath> create_dataflow_paths(
-                     EngelsAnalysisObjects &analysis_obj,
-                     const GraphDataFlow &graph,
-                     const boost::property_map<GraphDataFlow,
-                                         boost::vertex_index_t>::type &indexmap,
-                     GraphDataFlow::vertex_descriptor src_node,
-                     GraphDataFlow::vertex_descriptor dst_node) {
+    // Create the path from the source node of the search to the source
+    // node of this edge (in reverse order).
+    DataFlowIdPath &path = buffers.path;
+    path.clear();
+    uint32_t curr = curr_node;
+    path.push_back(curr);
+    while(curr != src_node) {
+        curr = buffers.parents[curr];
+        path.push_back(curr);
+    }
 
-    DataFlowNodeConnections backward_node_connections;
+    // Calculate the call stack on the path.
+    vector<uint32_t> &call_stack = buffers.call_stack;
+    call_stack.clear();
+    for(auto it = path.crbegin(); it != path.crend(); ++it) {
+        InstructionTypeSSA instr_type = graph.get_instr_type(*it);
 
-    GraphDataFlowFiltered filtered_graph(graph,
-                                         BlacklistNodesEdgePredicate(
-                                                     graph,
-                                                     analysis_obj.new_operators,
-                                                     backward_node_connections,
-                                                     src_node));
+        // Process call but ignore calls to new operators.
+        if(instr_type == SSAInstrTypeInstruction
+           && graph.is_call(*it)
+           && new_operators.find(graph.get_instr_addr(*it))
+              == new_operators.cend()) {
 
-    BfsGraphDataFlowFilteredNodesShortestPath vis(backward_node_connections,
-                                          src_node,
-                                          dst_node);
+            call_stack.push_back(*it);
+        }
 
-    // Last argument uses bgl_named_params:
-    // http://www.boost.org/doc/libs/1_58_0/libs/graph/doc/bgl_named_params.html
-    // => argument "visitor" and "vertex_index_map" are passed.
-    bool node_found = false;
-    try {
-        boost::breadth_first_search(filtered_graph,
-                                    src_node,
-                                    visitor(vis).vertex_index_map(indexmap));
+        // Process return instructions.
+        else if(instr_type == SSAInstrTypeCallOfRet) {
+            if(!call_stack.empty()) {
+                call_stack.pop_back();
+            }
+        }
     }
-    catch(NodeFound) {
-        node_found = true;
+
+    // Only process return instruction edge if we have a call stack.
+    if(!call_stack.empty()
+       && graph.get_instr_addr(dst_node)
+          != graph.get_instr_addr(call_stack.back())) {
+        return false;
     }
+    return true;
+}
 
-    // Build path starting from the destination node if we have found
-    // a way from source to destination.
-    DataFlowPath init_path;
-    if(node_found) {
-        get_path(init_path,
-                 backward_node_connections,
-                 src_node,
-                 dst_node);
+/*!
+ * \brief Searches the shortest paths from the source node to each of the
+ * destination nodes with one breadth first search and stores them in
+ * `out_paths` (an empty path if the destination node is not reachable).
+ *
+ * The search stops as soon as all destination nodes are discovered. Since
+ * the edges taken only depend on the part of the search tree discovered
+ * so far, each path is the same a search for its destination node alone
+ * would find.
+ *
+ * \return Returns the number of destination nodes a path exists to.
+ */
+static size_t find_dataflow_paths(const DataFlowGraphCSR &graph,
+                                  const unordered_set<uint64_t> &new_operators,
+                                  uint32_t src_node,
+                                  const vector<uint32_t> &dst_nodes,
+                                  vector<DataFlowIdPath> &out_paths) {
+
+    DataFlowSearchBuffers &buffers = search_buffers;
+    if(buffers.stamps.size() < graph.num_nodes()) {
+        buffers.stamps.resize(graph.num_nodes(), 0);
+        buffers.target_stamps.resize(graph.num_nodes(), 0);
+        buffers.parents.resize(graph.num_nodes());
+    }
+    buffers.stamp++;
+    if(buffers.stamp == 0) {
+        fill(buffers.stamps.begin(), buffers.stamps.end(), 0);
+        fill(buffers.target_stamps.begin(), buffers.target_stamps.end(), 0);
+        buffers.stamp = 1;
+    }
+    const uint32_t stamp = buffers.stamp;
+
+    // The source node is never discovered (and hence no target).
+    size_t num_remaining = 0;
+    for(uint32_t dst_node : dst_nodes) {
+        if(dst_node != src_node && buffers.target_stamps[dst_node] != stamp) {
+            buffers.target_stamps[dst_node] = stamp;
+            num_remaining++;
+        }
+    }
+
+    vector<uint32_t> &queue = buffers.queue;
+    queue.clear();
+    queue.push_back(src_node);
+    buffers.stamps[src_node] = stamp;
+    bool has_discovered = false;
+    for(size_t head = 0; head < queue.size() && num_remaining > 0; head++) {
+        uint32_t curr_node = queue[head];
+        for(uint32_t edge = graph.out_begin(curr_node);
+            edge < graph.out_end(curr_node);
+            edge++) {
+
+            if(!is_dataflow_edge_allowed(graph,
+                                         new_operators,
+                                         buffers,
+                                         has_discovered,
+                                         src_node,
+                                         curr_node,
+                                         edge)) {
+                continue;
+            }
+
+            uint32_t next_node = graph.get_target(edge);
+            if(buffers.stamps[next_node] == stamp) {
+                continue;
+            }
+            buffers.stamps[next_node] = stamp;
+            buffers.parents[next_node] = curr_node;
+            has_discovered = true;
+
+            if(buffers.target_stamps[next_node] == stamp
+               && --num_remaining == 0) {
+                break;
+            }
+            queue.push_back(next_node);
+        }
+    }
+
+    // Build the paths starting from the destination nodes.
+    size_t num_found = 0;
+    out_paths.resize(dst_nodes.size());
+    for(size_t i = 0; i < dst_nodes.size(); i++) {
+        DataFlowIdPath &out_path = out_paths[i];
+        out_path.clear();
+
+        uint32_t curr = dst_nodes[i];
+        if(curr == src_node || buffers.stamps[curr] != stamp) {
+            continue;
+        }
+        out_path.push_back(curr);
+        while(curr != src_node) {
+            curr = buffers.parents[curr];
+            out_path.push_back(curr);
+        }
+        reverse(out_path.begin(), out_path.end());
+        num_found++;
+    }
+    return num_found;
+}
+
+/*!
+ * \brief Searches the shortest path from the source to the destination
+ * node and stores it in `out_path`.
+ * \return Returns `true` if a path exists.
+ */
+static bool find_dataflow_path(const DataFlowGraphCSR &graph,
+                               const unordered_set<uint64_t> &new_operators,
+                               uint32_t src_node,
+                               uint32_t dst_node,
+                               DataFlowIdPath &out_path) {
+
+    DataFlowSearchBuffers &buffers = search_buffers;
+    buffers.targets.assign(1, dst_node);
+    if(find_dataflow_paths(graph,
+                           new_operators,
+                           src_node,
+                           buffers.targets,
+                           buffers.found_paths) == 0) {
+        return false;
     }
+    out_path.swap(buffers.found_paths[0]);
+    return true;
+}
 
-    vector<DataFlowPath> work_list;
-    vector<DataFlowPath> found_paths;
-    unordered_set<DataFlowPath,
-                  DataFlowPathSet::Hash,
-                  DataFlowPathSet::Compare> processed_base_paths;
-    if(init_path.size() > 0) {
-        work_list.push_back(init_path);
-        found_paths.push_back(init_path);
+/*!
+ * \brief Returns the given shortest path to the destination node together
+ * with all alternative paths that branch off at the return instructions
+ * along it.
+ */
+static vector<DataFlowPath> expand_dataflow_path(
+                                 const DataFlowGraphCSR &graph,
+                                 const unordered_set<uint64_t> &new_operators,
+                                 uint32_t dst_node,
+                                 const DataFlowIdPath &init_path) {
+
+    vector<ScratchIdPath, ScratchAllocator<ScratchIdPath>> work_list;
+    vector<ScratchIdPath, ScratchAllocator<ScratchIdPath>> found_paths;
+    unordered_set<ScratchIdPath,
+                  DataFlowIdPathHash,
+                  equal_to<ScratchIdPath>,
+                  ScratchAllocator<ScratchIdPath>> processed_base_paths;
+    if(!init_path.empty()) {
+        ScratchIdPath scratch_init_path(init_path.cbegin(), init_path.cend());
+        work_list.push_back(scratch_init_path);
+        found_paths.push_back(scratch_init_path);
     }
+    ScopedItemBudget::add_paths(found_paths.size());
 
     // Go backwards through each found path and try to find new paths
     // to the destination node at each return instruction.
+    vector<uint32_t> to_process;
+    DataFlowIdPath part_path;
     while(!work_list.empty()) {
 
-        DataFlowPath curr_path = work_list.back();
-        work_list.pop_back();
+        ScopedItemBudget::check_time();
 
-        DataFlowPath base_path = curr_path;
+        ScratchIdPath base_path = work_list.back();
+        work_list.pop_back();
 
         // Skip the last node (since it is always the destination node).
         base_path.pop_back();
@@ -999,7 +1867,7 @@ vector<DataFlowPath> create_dataflow_paths(
         // Process the path starting from the back.
         for(uint32_t i = base_path.size()-1; i >= 1; i--) {
 
-            GraphDataFlow::vertex_descriptor curr_node = base_path.at(i);
+            uint32_t curr_node = base_path.at(i);
 
             // Remove current node from the base path.
             base_path.pop_back();
@@ -1007,130 +1875,177 @@ vector<DataFlowPath> create_dataflow_paths(
             // Try to find another path through the dataflow at the
             // special call instructions that only handle return
             // instruction dataflow.
-            if(graph[curr_node].instr->get_type() == SSAInstrTypeCallOfRet) {
-
-                // Check if we have already processed this portion of the
-                // current base path.
-                // NOTE: the base path does not contain
-                // the current node anymore.
-                if(processed_base_paths.find(base_path)
-                   != processed_base_paths.end()) {
-                    break;
+            if(graph.get_instr_type(curr_node) != SSAInstrTypeCallOfRet) {
+                continue;
+            }
+
+            // Check if we have already processed this portion of the
+            // current base path.
+            // NOTE: the base path does not contain
+            // the current node anymore.
+            if(processed_base_paths.find(base_path)
+               != processed_base_paths.end()) {
+                break;
+            }
+
+            // Get all possible next nodes from the previous one
+            // as new source nodes for our path search.
+            uint32_t prev_node = base_path.at(i-1);
+            to_process.clear();
+            for(uint32_t edge = graph.out_begin(prev_node);
+                edge < graph.out_end(prev_node);
+                edge++) {
+                uint32_t temp_node = graph.get_target(edge);
+                if(temp_node != curr_node
+                   && find(to_process.cbegin(), to_process.cend(), temp_node)
+                      == to_process.cend()) {
+                    to_process.push_back(temp_node);
                 }
+            }
 
-                // Get all possible next nodes from the previous one
-                // as new source nodes for our path search.
-                GraphDataFlow::vertex_descriptor prev_node = base_path.at(i-1);
-                unordered_set<GraphDataFlow::vertex_descriptor> to_process;
-                auto out_edges = boost::out_edges(prev_node, graph);
-                for(auto edge_it = out_edges.first;
-                    edge_it != out_edges.second;
-                    ++edge_it) {
-                    GraphDataFlow::vertex_descriptor temp_node = boost::target(*edge_it, graph);
-                    to_process.insert(temp_node);
+            // Start a path search from the new source node.
+            for(uint32_t new_src_node : to_process) {
+                if(new_src_node == dst_node
+                   || !find_dataflow_path(graph,
+                                          new_operators,
+                                          new_src_node,
+                                          dst_node,
+                                          part_path)) {
+                    continue;
                 }
 
-                // Start a path search from the new source node.
-                for(auto new_src_node : to_process) {
-                    if(new_src_node == curr_node) {
-                        continue;
-                    }
+                // Add the base path to the beginning of the new
+                // found path.
+                part_path.insert(part_path.begin(),
+                                 base_path.cbegin(),
+                                 base_path.cend());
+
+                // Loop detection: check if each node is unique
+                // in the path and ignore if we have duplicates.
+                unordered_set<uint32_t,
+                              hash<uint32_t>,
+                              equal_to<uint32_t>,
+                              ScratchAllocator<uint32_t>> unique_nodes(
+                                                          part_path.cbegin(),
+                                                          part_path.cend());
+                if(part_path.size() != unique_nodes.size()) {
+                    continue;
+                }
 
-                    node_found = false;
-                    try {
-                        filtered_graph.m_edge_pred.set_src_node(new_src_node);
-                        backward_node_connections.clear();
-                        BfsGraphDataFlowFilteredNodesShortestPath
-                                             temp_vis(backward_node_connections,
-                                                      new_src_node,
-                                                      dst_node);
-
-                        boost::breadth_first_search(filtered_graph,
-                                                    new_src_node,
-                                                    visitor(temp_vis).vertex_index_map(indexmap));
-                    }
-                    catch(NodeFound) {
-                        node_found = true;
-                    }
+                // Add the newly found path as new base path
+                // for further processing.
+                ScratchIdPath new_path(part_path.cbegin(), part_path.cend());
+                work_list.push_back(new_path);
+                found_paths.push_back(move(new_path));
+                ScopedItemBudget::add_paths(1);
+            }
 
-                    if(node_found) {
-                        DataFlowPath part_path;
-                        get_path(part_path,
-                                 backward_node_connections,
-                                 new_src_node,
-                                 dst_node);
-
-                        // Add the base path to the beginning of the new
-                        // found path.
-                        for(int32_t j = base_path.size() - 1; j >= 0; j--) {
-                            part_path.insert(part_path.begin(),
-                                             base_path.at(j));
-                        }
+            // Store as processed base path (NOTE: the base path
+            // does not contain the current node anymore).
+            processed_base_paths.insert(base_path);
+        }
+    }
 
-                        // Loop detection: check if each node is unique
-                        // in the path and ignore if we have duplicates.
-                        unordered_set<GraphDataFlow::vertex_descriptor>
-                                                 unique_nodes(part_path.begin(),
-                                                              part_path.end());
-                        if(part_path.size() != unique_nodes.size()) {
-                            continue;
-                        }
+    vector<DataFlowPath> paths;
+    paths.reserve(found_paths.size());
+    for(const ScratchIdPath &found_path : found_paths) {
+        paths.emplace_back();
+        paths.back().reserve(found_path.size());
+        for(uint32_t node : found_path) {
+            paths.back().push_back(graph.get_vertex(node));
+        }
+    }
+    return paths;
+}
 
-                        // Add the newly found path as new base path
-                        // for further processing.
-                        work_list.push_back(part_path);
-                        found_paths.push_back(part_path);
-                    }
-                }
+vector<vector<DataFlowPath>> create_dataflow_paths(
+                     EngelsAnalysisObjects &analysis_obj,
+                     const DataFlowGraphCSR &graph,
+                     GraphDataFlow::vertex_descriptor src_vertex,
+                     const vector<GraphDataFlow::vertex_descriptor> &dst_vertices) {
 
-                // Store as processed base path (NOTE: the base path
-                // does not contain the current node anymore).
-                processed_base_paths.insert(base_path);
-            }
-        }
+    const unordered_set<uint64_t> &new_operators = analysis_obj.new_operators;
+    uint32_t src_node = graph.get_id(src_vertex);
+    vector<uint32_t> dst_nodes;
+    dst_nodes.reserve(dst_vertices.size());
+    for(GraphDataFlow::vertex_descriptor dst_vertex : dst_vertices) {
+        dst_nodes.push_back(graph.get_id(dst_vertex));
+    }
+
+    MARX_TRACE2(dataflow__paths__begin, src_node, dst_nodes.size());
+
+    // One search from the source node yields the initial paths to all
+    // destination nodes.
+    vector<DataFlowIdPath> init_paths;
+    find_dataflow_paths(graph, new_operators, src_node, dst_nodes, init_paths);
+
+    vector<vector<DataFlowPath>> paths;
+    paths.reserve(dst_nodes.size());
+    for(size_t i = 0; i < dst_nodes.size(); i++) {
+        paths.push_back(expand_dataflow_path(graph,
+                                             new_operators,
+                                             dst_nodes[i],
+                                             init_paths[i]));
     }
 
-    return found_paths;
+    MARX_TRACE2(dataflow__paths__end, src_node, paths.size());
+    return paths;
+}
+
+vector<DataFlowPath> create_dataflow_paths(
+                     EngelsAnalysisObjects &analysis_obj,
+                     const DataFlowGraphCSR &graph,
+                     GraphDataFlow::vertex_descriptor src_vertex,
+                     GraphDataFlow::vertex_descriptor dst_vertex) {
+
+    vector<GraphDataFlow::vertex_descriptor> dst_vertices(1, dst_vertex);
+    return move(create_dataflow_paths(analysis_obj,
+                                      graph,
+                                      src_vertex,
+                                      dst_vertices)[0]);
 }
 
-ControlFlowPath create_controlflow_path(
-                     const GraphCfg &graph,
-                     const boost::property_map<GraphCfg,
-                                         boost::vertex_index_t>::type &indexmap,
-                     GraphCfg::vertex_descriptor src_node,
-                     GraphCfg::vertex_descriptor dst_node) {
-
-    ControlFlowNodeConnections backward_node_connections;
-    BfsGraphCfgNodesShortestPath vis(backward_node_connections,
-                                     src_node,
-                                     dst_node);
-
-    // Last argument uses bgl_named_params:
-    // http://www.boost.org/doc/libs/1_58_0/libs/graph/doc/bgl_named_params.html
-    // => argument "visitor" and "vertex_index_map" are passed.
+ControlFlowPath create_controlflow_path(const GraphCfg &graph,
+                                        CfgNode src_node,
+                                        CfgNode dst_node) {
+
+    // Breadth first search that stops as soon as the destination node is
+    // discovered.
+    vector<CfgNode> parents(graph.num_nodes());
+    vector<bool> visited(graph.num_nodes(), false);
+    vector<CfgNode> queue;
+    queue.push_back(src_node);
+    visited[src_node] = true;
     bool node_found = false;
-    try {
-        boost::breadth_first_search(graph,
-                                    src_node,
-                                    visitor(vis).vertex_index_map(indexmap));
-    }
-    catch(NodeFound) {
-        node_found = true;
+    for(size_t head = 0; head < queue.size() && !node_found; head++) {
+        CfgNode curr_node = queue[head];
+        for(const CfgNode *it = graph.successors_begin(curr_node);
+            it != graph.successors_end(curr_node);
+            ++it) {
+            if(visited[*it]) {
+                continue;
+            }
+            visited[*it] = true;
+            parents[*it] = curr_node;
+            if(*it == dst_node) {
+                node_found = true;
+                break;
+            }
+            queue.push_back(*it);
+        }
     }
 
     // Build path starting from the destination node if we have found
     // a way from source to destination.
     ControlFlowPath path;
     if(node_found) {
-        GraphCfg::vertex_descriptor curr = dst_node;
+        CfgNode curr = dst_node;
         path.push_back(curr);
-        while(true) {
-            curr = backward_node_connections[curr];
-            path.insert(path.begin(), curr);
-            if(curr == src_node) {
-                break;
-            }
+        while(curr != src_node) {
+            curr = parents[curr];
+            path.push_back(curr);
         }
+        reverse(path.begin(), path.end());
     }
     return path;
 }
@@ -1244,7 +2159,7 @@ vector<BlockPtr> transform_dataflow_to_basic_blocks(
                                                                 src_instr_addr);
         const BlockPtr &src_block = src_function.get_containing_block_ptr(
                                                                 src_instr_addr);
-        GraphCfg::vertex_descriptor src_node_cfg = src_function.get_cfg_node(
+        CfgNode src_node_cfg = src_function.get_cfg_node(
                                                       src_block->get_address());
         const GraphCfg &cfg = src_function.get_cfg();
         bbs_path.push_back(cfg[src_node_cfg]);
@@ -1290,8 +2205,8 @@ vector<BlockPtr> transform_dataflow_to_basic_blocks(
             }
 
             TerminatorType src_terminator = src_block->get_terminator().type;
-            GraphCfg::vertex_descriptor src_node_cfg;
-            GraphCfg::vertex_descriptor dst_node_cfg;
+            CfgNode src_node_cfg;
+            CfgNode dst_node_cfg;
 
             // Handle calls into the destination function.
             if(src_terminator == TerminatorCall
@@ -1463,15 +2378,13 @@ vector<BlockPtr> transform_dataflow_to_basic_blocks(
                 throw runtime_error(err_msg.str().c_str());
             }
 
-            // Get cfg and indexmap.
+            // Get cfg.
             const GraphCfg &dst_cfg = dst_function.get_cfg();
-            const auto &indexmap = dst_function.get_cfg_indexmap();
 
             // Find a control flow path between function entry/jmp target
             // and destination node from the data flow path.
             ControlFlowPath src_dst_path_cf = create_controlflow_path(
                                                                   dst_cfg,
-                                                                  indexmap,
                                                                   src_node_cfg,
                                                                   dst_node_cfg);
             if(src_dst_path_cf.size() == 0) {
@@ -1506,11 +2419,10 @@ vector<BlockPtr> transform_dataflow_to_basic_blocks(
 
             // Get source and destination node in cfg.
             const GraphCfg &src_cfg = src_function.get_cfg();
-            const auto &indexmap = src_function.get_cfg_indexmap();
-            GraphCfg::vertex_descriptor src_node_cfg =
+            CfgNode src_node_cfg =
                                                 src_function.get_cfg_node(
                                                       src_block->get_address());
-            GraphCfg::vertex_descriptor dst_node_cfg =
+            CfgNode dst_node_cfg =
                                                 src_function.get_cfg_node(
                                                       dst_block->get_address());
 
@@ -1539,7 +2451,6 @@ vector<BlockPtr> transform_dataflow_to_basic_blocks(
             // from the data flow path.
             ControlFlowPath src_dst_path_cf = create_controlflow_path(
                                                                   src_cfg,
-                                                                  indexmap,
                                                                   src_node_cfg,
                                                                   dst_node_cfg);
             if(src_dst_path_cf.size() == 0) {
@@ -1631,14 +2542,12 @@ void glue_block_paths_together(vector<BlockPtr> &out_path_blocks,
        != dst_block->get_address()) {
 
         const GraphCfg &cfg = join_function.get_cfg();
-        const auto &indexmap = join_function.get_cfg_indexmap();
 
-        GraphCfg::vertex_descriptor src_node_cfg = join_function.get_cfg_node(
+        CfgNode src_node_cfg = join_function.get_cfg_node(
                                                       src_block->get_address());
-        GraphCfg::vertex_descriptor dst_node_cfg = join_function.get_cfg_node(
+        CfgNode dst_node_cfg = join_function.get_cfg_node(
                                                       dst_block->get_address());
         ControlFlowPath src_dst_path_cf = create_controlflow_path(cfg,
-                                                                  indexmap,
                                                                   src_node_cfg,
                                                                   dst_node_cfg);
 
@@ -1968,10 +2877,11 @@ bool process_result(EngelsAnalysisObjects &analysis_obj,
 
     bool has_result = false;
 
+    const VTableFile &vtable_file = analysis_obj.vtable_file;
     const EntryVTablePtrsMap &this_vtable_entry_addrs =
-            analysis_obj.vtable_file.get_this_vtable_entry_addrs();
+            vtable_file.get_this_vtable_entry_addrs();
 
-    ExpressionPtr sym_vtable_ptr = make_shared<Symbolic>("vtable_ptr");
+    ExpressionPtr sym_vtable_ptr = make_symbolic("vtable_ptr");
 
     // Extract the operand used by the icall instruction as target.
     const OperandSSAPtr &call_operand = icall_instr->get_uses().at(0);
@@ -1989,8 +2899,7 @@ bool process_result(EngelsAnalysisObjects &analysis_obj,
             // call [rax_18] with 0x110c3b0
             uint64_t entry_addr = constant.value();
             if(call_operand->is_memory()
-               && this_vtable_entry_addrs.find(entry_addr)
-                    != this_vtable_entry_addrs.cend()) {
+               && vtable_file.is_this_vtable_entry_addr(entry_addr)) {
 
 #if DEBUG_ENGELS_PRINT
                 cout << "Virtual callsite found: "
@@ -2025,16 +2934,10 @@ bool process_result(EngelsAnalysisObjects &analysis_obj,
              << "\n";
 #endif
 
-                    EngelsResult result;
-                    result.icall_instr = icall_instr;
-                    result.call_reg_expr_ptr = call_reg_expr_ptr;
-                    result.vtable_idx = vtbl_obj->index;
-                    result.entry_idx = entry_idx;
-
-                    analysis_obj.results_mtx.lock();
-                    analysis_obj.results[
-                                  icall_instr->get_address()].push_back(result);
-                    analysis_obj.results_mtx.unlock();
+                    engels_add_result(icall_instr,
+                                      call_reg_expr_ptr,
+                                      vtbl_obj->index,
+                                      entry_idx);
                     has_result = true;
                 }
             }
@@ -2078,16 +2981,10 @@ bool process_result(EngelsAnalysisObjects &analysis_obj,
              << "\n";
 #endif
 
-                EngelsResult result;
-                result.icall_instr = icall_instr;
-                result.call_reg_expr_ptr = call_reg_expr_ptr;
-                result.vtable_idx = vtable_idx;
-                result.entry_idx = entry_idx;
-
-                analysis_obj.results_mtx.lock();
-                analysis_obj.results[icall_instr->get_address()].push_back(
-                                                                        result);
-                analysis_obj.results_mtx.unlock();
+                engels_add_result(icall_instr,
+                                  call_reg_expr_ptr,
+                                  vtable_idx,
+                                  entry_idx);
                 has_result = true;
             }
         }
@@ -2105,8 +3002,7 @@ bool process_result(EngelsAnalysisObjects &analysis_obj,
                                                                 *ind.address());
 
                 uint64_t entry_addr = constant.value();
-                if(this_vtable_entry_addrs.find(entry_addr)
-                        != this_vtable_entry_addrs.cend()) {
+                if(vtable_file.is_this_vtable_entry_addr(entry_addr)) {
 
 #if DEBUG_ENGELS_PRINT
                     cout << "Virtual callsite found: "
@@ -2140,16 +3036,10 @@ bool process_result(EngelsAnalysisObjects &analysis_obj,
              << dec << entry_idx;
 #endif
 
-                        EngelsResult result;
-                        result.icall_instr = icall_instr;
-                        result.call_reg_expr_ptr = call_reg_expr_ptr;
-                        result.vtable_idx = vtbl_obj->index;
-                        result.entry_idx = entry_idx;
-
-                        analysis_obj.results_mtx.lock();
-                        analysis_obj.results[
-                                  icall_instr->get_address()].push_back(result);
-                        analysis_obj.results_mtx.unlock();
+                        engels_add_result(icall_instr,
+                                          call_reg_expr_ptr,
+                                          vtbl_obj->index,
+                                          entry_idx);
                         has_result = true;
                     }
                 }
@@ -2175,8 +3065,7 @@ bool process_result(EngelsAnalysisObjects &analysis_obj,
                                                                      *op.rhs());
 
                     uint64_t entry_addr = lhs.value();
-                    if(this_vtable_entry_addrs.find(entry_addr)
-                            != this_vtable_entry_addrs.cend()) {
+                    if(vtable_file.is_this_vtable_entry_addr(entry_addr)) {
                         bool is_vtable_entry = false;
                         switch(op.operation()) {
                             case OperationAdd:
@@ -2228,16 +3117,10 @@ bool process_result(EngelsAnalysisObjects &analysis_obj,
              << dec << entry_idx;
 #endif
 
-                                EngelsResult result;
-                                result.icall_instr = icall_instr;
-                                result.call_reg_expr_ptr = call_reg_expr_ptr;
-                                result.vtable_idx = vtbl_obj->index;
-                                result.entry_idx = entry_idx;
-
-                                analysis_obj.results_mtx.lock();
-                                analysis_obj.results[
-                                  icall_instr->get_address()].push_back(result);
-                                analysis_obj.results_mtx.unlock();
+                                engels_add_result(icall_instr,
+                                                  call_reg_expr_ptr,
+                                                  vtbl_obj->index,
+                                                  entry_idx);
                                 has_result = true;
                             }
                         }
@@ -2275,16 +3158,10 @@ bool process_result(EngelsAnalysisObjects &analysis_obj,
              << dec << entry_idx;
 #endif
 
-                    EngelsResult result;
-                    result.icall_instr = icall_instr;
-                    result.call_reg_expr_ptr = call_reg_expr_ptr;
-                    result.vtable_idx = vtable_idx;
-                    result.entry_idx = entry_idx;
-
-                    analysis_obj.results_mtx.lock();
-                    analysis_obj.results[
-                                  icall_instr->get_address()].push_back(result);
-                    analysis_obj.results_mtx.unlock();
+                    engels_add_result(icall_instr,
+                                      call_reg_expr_ptr,
+                                      vtable_idx,
+                                      entry_idx);
                     has_result = true;
                 }
             }
@@ -2311,17 +3188,11 @@ bool process_vtable_call_nodes(
 
     bool has_overall_result = false;
 
-    // Create indexmap in order to work with boost algorithms on the graph.
-    boost::property_map<GraphDataFlow,
-                        boost::vertex_index_t>::type indexmap =
-                                                  analysis.get_graph_indexmap(); // TODO optimize indexmap creation by caching
-
     for(auto root_node : vtable_call_nodes) {
 
         vector<DataFlowPath> paths_root_icall = create_dataflow_paths(
                                                              analysis_obj,
-                                                             graph,
-                                                             indexmap,
+                                                             analysis.get_graph_csr(),
                                                              root_node, // src
                                                              icall_node); // dst
 
@@ -2386,9 +3257,9 @@ bool process_vtable_call_nodes(
             // Symbolically execute the final path with a symbolic vtable ptr
             // in the this argument.
             State state;
-            ExpressionPtr sym_vtable_ptr = make_shared<Symbolic>("vtable_ptr");
+            ExpressionPtr sym_vtable_ptr = make_symbolic("vtable_ptr");
             State::const_iterator this_ptr_value;
-            state.find(system_v_arguments[0], this_ptr_value); // TODO architecture specific
+            state.find(analysis_obj.abi.this_argument(), this_ptr_value);
             ExpressionPtr this_ptr_indirect =
                     make_shared<Indirection>(this_ptr_value->second);
             state.update(this_ptr_indirect, sym_vtable_ptr);
@@ -2422,15 +3293,9 @@ bool process_vtable_call_nodes(
             // When we have found a result, check if it is a result
             // for our current vtable (otherwise continue the search).
             if(has_result) {
-                has_result = false;
-                for(const EngelsResult &result
-                    : analysis_obj.results.at(icall_instr->get_address())) {
-
-                    if(result.vtable_idx == vtable_idx) {
-                        has_result = true;
-                        break;
-                    }
-                }
+                has_result = engels_has_result(analysis_obj,
+                                               icall_instr->get_address(),
+                                               vtable_idx);
                 if(has_result) {
                     break;
                 }
@@ -2805,16 +3670,14 @@ bool process_root_vtable_icall_dataflow_path(
                                             start_block->get_address());
     if(start_function.get_entry() != start_block->get_address()) {
         const GraphCfg &start_cfg = start_function.get_cfg();
-        const auto &start_indexmap = start_function.get_cfg_indexmap();
 
         // Search path from function entry to common start basic block.
-        GraphCfg::vertex_descriptor src_node_cfg =
+        CfgNode src_node_cfg =
                 start_function.get_cfg_node(start_function.get_entry());
-        GraphCfg::vertex_descriptor dst_node_cfg =
+        CfgNode dst_node_cfg =
                 start_function.get_cfg_node(start_block->get_address());
         ControlFlowPath src_dst_path_cf = create_controlflow_path(
                                                          start_cfg,
-                                                         start_indexmap,
                                                          src_node_cfg,
                                                          dst_node_cfg);
         if(src_dst_path_cf.size() == 0) {
@@ -3080,14 +3943,13 @@ bool process_root_vtable_icall_dataflow_path(
     // Replace the value of the vtable assignment
     // (which is the last executed in the last basic block of the
     // first part of the final path) with a symbolical vtable ptr value.
-    const OperandSSAPtrs &use_ops =
-                                   graph[vtable_node].instr->get_uses();
+    const OperandSSASpan use_ops = graph[vtable_node].instr->get_uses();
     const ConstantX64SSA &op = static_cast<const ConstantX64SSA&>(
                                                         *use_ops.at(0));
     int64_t vtable_value_raw = op.get_value();
     Constant vtable_value(vtable_value_raw);
     const auto &memory = state.get_memory_accesses();
-    ExpressionPtr sym_vtable_ptr = make_shared<Symbolic>("vtable_ptr");
+    ExpressionPtr sym_vtable_ptr = make_symbolic("vtable_ptr");
     for(const auto &kv_mem : memory) {
         if(*(kv_mem.second) == vtable_value) {
             state.update(kv_mem.first, sym_vtable_ptr);
@@ -3136,18 +3998,12 @@ bool process_vtable_nodes(
 
     bool has_overall_result = false;
 
-    // Create indexmap in order to work with boost algorithms on the graph.
-    boost::property_map<GraphDataFlow,
-                        boost::vertex_index_t>::type indexmap =
-                                              analysis.get_graph_indexmap();
-
     for(const auto &kv_nodes : join_to_vtables_map) {
 
         GraphDataFlow::vertex_descriptor root_node = kv_nodes.first;
         vector<DataFlowPath> paths_root_icall = create_dataflow_paths(
                                                              analysis_obj,
-                                                             graph,
-                                                             indexmap,
+                                                             analysis.get_graph_csr(),
                                                              root_node, // src
                                                              icall_node); // dst
 
@@ -3156,14 +4012,24 @@ bool process_vtable_nodes(
             continue;
         }
 
-        for(auto vtable_node : kv_nodes.second) {
-
-            vector<DataFlowPath> paths_root_vtable = create_dataflow_paths(
-                                                            analysis_obj,
-                                                            graph,
-                                                            indexmap,
-                                                            root_node, // src
-                                                            vtable_node); // dst
+        // Search the paths from the root node to all vtable nodes at once.
+        vector<GraphDataFlow::vertex_descriptor> vtable_nodes(
+                                                      kv_nodes.second.cbegin(),
+                                                      kv_nodes.second.cend());
+        vector<vector<DataFlowPath>> paths_root_vtables = create_dataflow_paths(
+                                                     analysis_obj,
+                                                     analysis.get_graph_csr(),
+                                                     root_node, // src
+                                                     vtable_nodes); // dst
+
+        for(size_t vtable_ctr = 0;
+            vtable_ctr < vtable_nodes.size();
+            vtable_ctr++) {
+
+            GraphDataFlow::vertex_descriptor vtable_node =
+                                                      vtable_nodes[vtable_ctr];
+            vector<DataFlowPath> &paths_root_vtable =
+                                               paths_root_vtables[vtable_ctr];
 
             // Skip if we do not have a path from the join node to the
             // vtable node.
@@ -3210,15 +4076,9 @@ bool process_vtable_nodes(
                     // When we have found a result, check if it is a result
                     // for our current vtable (otherwise continue the search).
                     if(has_result) {
-                        has_result = false;
-                        for(const EngelsResult &result
-                            : analysis_obj.results.at(icall_addr)) {
-
-                            if(result.vtable_idx == vtable_idx) {
-                                has_result = true;
-                                break;
-                            }
-                        }
+                        has_result = engels_has_result(analysis_obj,
+                                                       icall_addr,
+                                                       vtable_idx);
                         if(has_result) {
                             break;
                         }
@@ -3286,18 +4146,77 @@ void process_icall_dataflow_graph(
     if(!has_result) {
         if(!analysis.get_unresolvable_icalls().empty()
            || !analysis.get_unresolvable_vfuncs().empty()) {
-            uint64_t start_addr = analysis.get_start_addr();
             repeat_icall_mtx.lock();
-            repeat_icall_addrs.insert(start_addr);
-            icall_addr_unresolvable_map[start_addr] =
-                                             analysis.get_unresolvable_icalls();
-            vfunc_addr_unresolvable_map[start_addr] =
-                                             analysis.get_unresolvable_vfuncs();
+            engels_park_icall(analysis.get_start_addr(),
+                              analysis.get_unresolvable_icalls(),
+                              analysis.get_unresolvable_vfuncs());
             repeat_icall_mtx.unlock();
         }
     }
 }
 
+/*!
+ * \brief Resolves a target loaded from a constant address inside a vtable of
+ * the analyzed module (the object was created in the analyzed code).
+ *
+ * \return `false` if the target is not of the form `[C]` or `[(C + off)]`.
+ */
+static bool resolve_lightweight_constant_target(
+                                 const EngelsAnalysisObjects &analysis_obj,
+                                 const ExpressionPtr &target_expr,
+                                 const BaseInstructionSSAPtr &icall_instr,
+                                 EngelsLightweightResolution &resolution) {
+
+    if(target_expr->type() != ExpressionIndirection) {
+        return false;
+    }
+    const Indirection &ind = static_cast<const Indirection&>(*target_expr);
+
+    uint64_t target_addr = 0;
+    if(ind.address()->type() == ExpressionConstant) {
+        target_addr = static_cast<const Constant&>(*ind.address()).value();
+    }
+    else if(ind.address()->type() == ExpressionOperation) {
+        const Operation &op = static_cast<const Operation&>(*ind.address());
+        if(op.operation() != OperationAdd
+           || op.lhs()->type() != ExpressionConstant
+           || op.rhs()->type() != ExpressionConstant) {
+            return false;
+        }
+        target_addr = static_cast<const Constant&>(*op.lhs()).value()
+                      + static_cast<const Constant&>(*op.rhs()).value();
+    }
+    else {
+        return false;
+    }
+
+    const VTableFile &vtable_file = analysis_obj.vtable_file;
+    const VTableModuleId module_id = vtable_file.get_this_module_id();
+    const uint64_t addr_size = vtable_file.get_addr_size();
+    for(uint32_t entry_idx = 0;
+        entry_idx < ENGELS_TIER_MAX_ENTRY_IDX
+        && entry_idx * addr_size <= target_addr;
+        entry_idx++) {
+
+        const VTable *vtbl_ptr = vtable_file.get_vtable_ptr(
+                                           module_id,
+                                           target_addr - entry_idx * addr_size);
+        if(vtbl_ptr == nullptr) {
+            continue;
+        }
+        if(entry_idx >= vtbl_ptr->entries.size()) {
+            return false;
+        }
+        resolution.is_resolved = true;
+        resolution.vtable_idx = vtbl_ptr->index;
+        resolution.entry_idx = entry_idx;
+        resolution.icall_instr = icall_instr;
+        resolution.target_expr = target_expr;
+        return true;
+    }
+    return false;
+}
+
 bool process_lightweight_result(const GraphDataFlow &graph,
                                 EngelsAnalysisObjects &analysis_obj,
                                 const State &state_this,
@@ -3324,6 +4243,15 @@ bool process_lightweight_result(const GraphDataFlow &graph,
                  << "\n";
 #endif
 
+            if(thread_lightweight_resolution != nullptr
+               && resolve_lightweight_constant_target(
+                                          analysis_obj,
+                                          target_expr,
+                                          graph[path_target_icall.back()].instr,
+                                          *thread_lightweight_resolution)) {
+                return true;
+            }
+
             // THIS -> [(init_rdi + 0x28)]
             // TARGET -> [([[(init_rdi + 0x28)]] + 0x10)]
             if(target_expr->type() == ExpressionIndirection) {
@@ -3487,15 +4415,13 @@ bool process_lightweight_data_flow_separate(
 
     vector<DataFlowPath> paths_this_icall = create_dataflow_paths(
                                               analysis_obj,
-                                              graph,
-                                              analysis.get_graph_indexmap(),
+                                              analysis.get_graph_csr(),
                                               start_this_op, // src
                                               icall_node); // dst
 
     vector<DataFlowPath> paths_target_icall = create_dataflow_paths(
                                               analysis_obj,
-                                              graph,
-                                              analysis.get_graph_indexmap(),
+                                              analysis.get_graph_csr(),
                                               start_target_op, // src
                                               icall_node); // dst
 
@@ -3743,15 +4669,13 @@ bool process_lightweight_data_flow_merge(
 
             vector<DataFlowPath> paths_this_icall = create_dataflow_paths(
                                                   analysis_obj,
-                                                  graph,
-                                                  analysis.get_graph_indexmap(),
+                                                  analysis.get_graph_csr(),
                                                   start_this_op, // src
                                                   icall_node); // dst
 
             vector<DataFlowPath> paths_target_icall = create_dataflow_paths(
                                                   analysis_obj,
-                                                  graph,
-                                                  analysis.get_graph_indexmap(),
+                                                  analysis.get_graph_csr(),
                                                   start_target_op, // src
                                                   icall_node); // dst
 
@@ -0,0 +1,358 @@
+#include "engels_checkpoint.h"
+
+#include <cstring>
+#include <cstdio>
+#include <iterator>
+#include <unistd.h>
+
+using namespace std;
+
+enum CheckpointRecordType {
+    CheckpointRecordLightweight = 1,
+    CheckpointRecordVCall,
+    CheckpointRecordObjectAllocation,
+
+    // Written by a shard once all of its items are finished.
+    CheckpointRecordFinished,
+};
+
+static const size_t checkpoint_header_size = 8
+                                             + sizeof(uint32_t)
+                                             + sizeof(uint64_t);
+
+template<typename T>
+static void put(vector<uint8_t> &record, const T &value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+    record.insert(record.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+static bool get(const vector<uint8_t> &data, size_t &offset, T &value) {
+    if(data.size() - offset < sizeof(T)) {
+        return false;
+    }
+    memcpy(&value, data.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+static bool get_set(const vector<uint8_t> &data,
+                    size_t &offset,
+                    unordered_set<uint64_t> &values) {
+    uint32_t number;
+    if(!get(data, offset, number)) {
+        return false;
+    }
+    for(uint32_t i = 0; i < number; i++) {
+        uint64_t value;
+        if(!get(data, offset, value)) {
+            return false;
+        }
+        values.insert(value);
+    }
+    return true;
+}
+
+template<typename T>
+static bool get_vector(const vector<uint8_t> &data,
+                       size_t &offset,
+                       vector<T> &values) {
+    uint32_t number;
+    if(!get(data, offset, number)) {
+        return false;
+    }
+    for(uint32_t i = 0; i < number; i++) {
+        T value;
+        if(!get(data, offset, value)) {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return true;
+}
+
+template<typename Container>
+static void put_all(vector<uint8_t> &record, const Container &values) {
+    put<uint32_t>(record, values.size());
+    for(const auto &value : values) {
+        put(record, value);
+    }
+}
+
+EngelsCheckpoint::EngelsCheckpoint(const string &target_file,
+                                   uint32_t interval)
+    : _target_file(target_file),
+      _checkpoint_file(target_file + ".engels_checkpoint"),
+      _interval(interval) {
+}
+
+/*!
+ * \brief Imports the records of a previous run with the same context and
+ * opens the checkpoint file for appending.
+ *
+ * A record that was only partially written when the previous run was
+ * interrupted is dropped.
+ *
+ * \return `false` if the checkpoint file can not be written.
+ */
+bool EngelsCheckpoint::open(uint64_t context_hash) {
+    lock_guard<mutex> _(_mtx);
+
+    vector<uint8_t> data;
+    size_t offset = 0;
+    if(read_file(_checkpoint_file, context_hash, data, offset)) {
+        size_t valid_size = offset + import_records(
+                                vector<uint8_t>(data.begin() + offset,
+                                                data.end()));
+        _is_resumed = !_done_lightweight.empty() || !_done_vcalls.empty();
+
+        if(truncate(_checkpoint_file.c_str(), valid_size) != 0) {
+            return false;
+        }
+        _file.open(_checkpoint_file, ios::out|ios::binary|ios::app);
+    }
+    else {
+        vector<uint8_t> header;
+        header.insert(header.end(),
+                      ENGELS_CHECKPOINT_MAGIC,
+                      ENGELS_CHECKPOINT_MAGIC + 8);
+        put<uint32_t>(header, ENGELS_CHECKPOINT_VERSION);
+        put<uint64_t>(header, context_hash);
+
+        _file.open(_checkpoint_file, ios::out|ios::binary|ios::trunc);
+        _file.write(reinterpret_cast<const char*>(header.data()),
+                    header.size());
+        _file.flush();
+    }
+
+    _last_flush = chrono::steady_clock::now();
+    return _file.good();
+}
+
+/*!
+ * \brief Reads the given checkpoint file.
+ *
+ * \param offset Set to the offset of the first record.
+ * \return `false` if the file does not exist or belongs to another context.
+ */
+bool EngelsCheckpoint::read_file(const string &file_name,
+                                 uint64_t context_hash,
+                                 vector<uint8_t> &data,
+                                 size_t &offset) const {
+
+    ifstream input(file_name, ios::in|ios::binary);
+    data.assign(istreambuf_iterator<char>(input),
+                istreambuf_iterator<char>());
+    input.close();
+
+    if(data.size() < checkpoint_header_size) {
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version = 0;
+    uint64_t file_hash = 0;
+    memcpy(magic, data.data(), sizeof(magic));
+    offset = sizeof(magic);
+    get(data, offset, version);
+    get(data, offset, file_hash);
+    return memcmp(magic, ENGELS_CHECKPOINT_MAGIC, 8) == 0
+           && version == ENGELS_CHECKPOINT_VERSION
+           && file_hash == context_hash
+           && context_hash != 0;
+}
+
+string EngelsCheckpoint::get_shard_target(const string &target_file,
+                                          const AnalysisShard &shard) {
+    return target_file
+           + ".shard" + to_string(shard.index)
+           + "_of_" + to_string(shard.count);
+}
+
+/*!
+ * \brief Imports the items of the given (finished) shard. The checkpoint
+ * is not backed by a file afterwards.
+ *
+ * \return `false` if the checkpoint of the shard does not exist, belongs to
+ * another context or the shard did not finish.
+ */
+bool EngelsCheckpoint::merge_shard(const AnalysisShard &shard,
+                                   uint64_t context_hash) {
+    lock_guard<mutex> _(_mtx);
+
+    vector<uint8_t> data;
+    size_t offset = 0;
+    if(!read_file(get_shard_target(_target_file, shard)
+                  + ".engels_checkpoint",
+                  context_hash,
+                  data,
+                  offset)) {
+        return false;
+    }
+
+    _is_finished = false;
+    import_records(vector<uint8_t>(data.begin() + offset, data.end()));
+    _is_resumed = true;
+    return _is_finished;
+}
+
+/*!
+ * \brief Imports all complete records.
+ * \return The number of bytes of the complete records.
+ */
+size_t EngelsCheckpoint::import_records(const vector<uint8_t> &data) {
+    size_t offset = 0;
+    size_t valid_size = 0;
+
+    while(true) {
+        uint8_t type;
+        uint64_t addr;
+        if(!get(data, offset, type) || !get(data, offset, addr)) {
+            break;
+        }
+
+        if(type == CheckpointRecordLightweight) {
+            uint8_t is_vcall;
+            if(!get(data, offset, is_vcall)) {
+                break;
+            }
+            _done_lightweight[addr] = is_vcall != 0;
+        }
+        else if(type == CheckpointRecordVCall) {
+            uint32_t number;
+            if(!get(data, offset, number)) {
+                break;
+            }
+
+            IncrementalResults results;
+            bool is_complete = true;
+            for(uint32_t i = 0; i < number && is_complete; i++) {
+                IncrementalResult result;
+                is_complete = get(data, offset, result.icall_addr)
+                              && get(data, offset, result.vtable_idx)
+                              && get(data, offset, result.entry_idx);
+                results.push_back(result);
+            }
+
+            CheckpointVCall vcall;
+            uint8_t is_repeat;
+            if(!is_complete
+               || !get(data, offset, is_repeat)
+               || !get_set(data, offset, vcall.unresolvable_icalls)
+               || !get_set(data, offset, vcall.unresolvable_vfuncs)) {
+                break;
+            }
+            vcall.is_repeat = is_repeat != 0;
+
+            // Records of later rounds replace the earlier ones.
+            _done_vcalls[addr] = vcall;
+            _results.insert(_results.end(), results.begin(), results.end());
+        }
+        else if(type == CheckpointRecordObjectAllocation) {
+            IncrementalObjectAllocation obj_alloc;
+            obj_alloc.addr = addr;
+            if(!get_vector(data, offset, obj_alloc.vtbl_idxs)
+               || !get_vector(data, offset, obj_alloc.vtbl_xref_addrs)) {
+                break;
+            }
+            _obj_allocs.push_back(obj_alloc);
+        }
+        else if(type == CheckpointRecordFinished) {
+            _is_finished = true;
+        }
+        else {
+            break;
+        }
+
+        valid_size = offset;
+    }
+
+    return valid_size;
+}
+
+void EngelsCheckpoint::append(const vector<uint8_t> &record) {
+    lock_guard<mutex> _(_mtx);
+
+    if(!_file.is_open()) {
+        return;
+    }
+    _file.write(reinterpret_cast<const char*>(record.data()),
+                record.size());
+
+    auto now = chrono::steady_clock::now();
+    if(now - _last_flush >= chrono::seconds(_interval)) {
+        _file.flush();
+        _last_flush = now;
+    }
+}
+
+/*!
+ * \brief Stores that the lightweight analysis of the given icall finished.
+ */
+void EngelsCheckpoint::add_lightweight(uint64_t icall_addr, bool is_vcall) {
+    vector<uint8_t> record;
+    put<uint8_t>(record, CheckpointRecordLightweight);
+    put(record, icall_addr);
+    put<uint8_t>(record, is_vcall);
+    append(record);
+}
+
+/*!
+ * \brief Stores that the icall analysis of the given icall finished with
+ * the given results.
+ */
+void EngelsCheckpoint::add_vcall(uint64_t vcall_addr,
+                                 const IncrementalResults &results,
+                                 const CheckpointVCall &vcall) {
+    vector<uint8_t> record;
+    put<uint8_t>(record, CheckpointRecordVCall);
+    put(record, vcall_addr);
+    put<uint32_t>(record, results.size());
+    for(const IncrementalResult &result : results) {
+        put(record, result.icall_addr);
+        put(record, result.vtable_idx);
+        put(record, result.entry_idx);
+    }
+    put<uint8_t>(record, vcall.is_repeat);
+    put_all(record, vcall.unresolvable_icalls);
+    put_all(record, vcall.unresolvable_vfuncs);
+    append(record);
+}
+
+/*!
+ * \brief Stores an object allocation found by this shard.
+ */
+void EngelsCheckpoint::add_object_allocation(
+                               const IncrementalObjectAllocation &obj_alloc) {
+    vector<uint8_t> record;
+    put<uint8_t>(record, CheckpointRecordObjectAllocation);
+    put(record, obj_alloc.addr);
+    put_all(record, obj_alloc.vtbl_idxs);
+    put_all(record, obj_alloc.vtbl_xref_addrs);
+    append(record);
+}
+
+/*!
+ * \brief Marks all items of this shard as finished and flushes the file.
+ */
+void EngelsCheckpoint::finish() {
+    vector<uint8_t> record;
+    put<uint8_t>(record, CheckpointRecordFinished);
+    put<uint64_t>(record, 0);
+    append(record);
+
+    lock_guard<mutex> _(_mtx);
+    _file.flush();
+}
+
+/*!
+ * \brief Removes the checkpoint file (once the analysis finished).
+ */
+void EngelsCheckpoint::remove() {
+    lock_guard<mutex> _(_mtx);
+
+    if(_file.is_open()) {
+        _file.close();
+    }
+    std::remove(_checkpoint_file.c_str());
+}
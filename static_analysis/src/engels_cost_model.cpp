@@ -0,0 +1,129 @@
+#include "engels_cost_model.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+// Weights of the features of the containing function (in blocks).
+static const uint64_t cost_per_use_divisor = 8;
+static const uint64_t cost_per_vtable_xref = 32;
+
+EngelsCostModel::EngelsCostModel(const Translator &translator,
+                                 const VTableFile &vtable_file)
+    : _translator(translator) {
+
+    for(uint32_t i = 0; i < InstrItemNum; i++) {
+        _history_scale[i] = 0.0;
+    }
+
+    // Functions initializing objects keep the analysis of their vtable
+    // pointers alive for long.
+    for(const auto &kv : vtable_file.get_this_vtables()) {
+        for(uint64_t xref_addr : kv.second->xrefs) {
+            try {
+                const Function &func =
+                             _translator.get_containing_function(xref_addr);
+                _func_vtable_xrefs[func.get_entry()]++;
+            }
+            catch(...) {
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Returns the estimate of the item at the given address from its
+ * containing function only.
+ */
+uint64_t EngelsCostModel::estimate_static(uint64_t addr) const {
+    try {
+        const Function &func = _translator.get_containing_function(addr);
+
+        uint64_t cost = 1 + func.get_blocks_ssa().size()
+                        + func.get_uses_ssa().size() / cost_per_use_divisor;
+        const auto it = _func_vtable_xrefs.find(func.get_entry());
+        if(it != _func_vtable_xrefs.cend()) {
+            cost += it->second * cost_per_vtable_xref;
+        }
+        return cost;
+    }
+    catch(...) {
+        return 1;
+    }
+}
+
+/*!
+ * \brief Imports the measured durations of the items of a previous run
+ * (written if the config option `INSTRUMENTATION` is set).
+ *
+ * \return `false` if no report of a previous run exists.
+ */
+bool EngelsCostModel::import_history(const string &target_dir,
+                                     const string &module_name) {
+
+    vector<InstrumentationItem> items;
+    if(!Instrumentation::import_items(target_dir, module_name, items)) {
+        return false;
+    }
+
+    // Items analyzed in several rounds are summed up.
+    for(const InstrumentationItem &item : items) {
+        _history[item.type][item.addr] += item.duration_us;
+    }
+
+    // The measured durations are scaled to the unit of the static estimate
+    // so that items without history can be compared against them.
+    for(uint32_t i = 0; i < InstrItemNum; i++) {
+        uint64_t sum_static = 0;
+        uint64_t sum_history = 0;
+        for(const auto &kv : _history[i]) {
+            sum_static += estimate_static(kv.first);
+            sum_history += kv.second;
+        }
+        if(sum_history != 0) {
+            _history_scale[i] = static_cast<double>(sum_static) / sum_history;
+        }
+    }
+
+    return true;
+}
+
+/*!
+ * \brief Returns the predicted cost of the given item (in the unit of the
+ * static estimate).
+ */
+uint64_t EngelsCostModel::estimate(InstrumentationItemType type,
+                                   uint64_t addr) const {
+    if(_history_scale[type] != 0.0) {
+        const auto it = _history[type].find(addr);
+        if(it != _history[type].cend()) {
+            return 1 + static_cast<uint64_t>(it->second
+                                             * _history_scale[type]);
+        }
+    }
+    return estimate_static(addr);
+}
+
+/*!
+ * \brief Sorts the given items by descending predicted cost (longest
+ * processing time first). Items of the same cost keep the address order.
+ */
+void EngelsCostModel::sort_by_cost(InstrumentationItemType type,
+                                   vector<uint64_t> &items) const {
+    vector<pair<uint64_t, uint64_t>> costs;
+    costs.reserve(items.size());
+    for(uint64_t item : items) {
+        costs.push_back(make_pair(estimate(type, item), item));
+    }
+
+    stable_sort(costs.begin(), costs.end(),
+                [](const pair<uint64_t, uint64_t> &a,
+                   const pair<uint64_t, uint64_t> &b) {
+                    return a.first > b.first;
+                });
+
+    for(size_t i = 0; i < costs.size(); i++) {
+        items[i] = costs[i].second;
+    }
+}
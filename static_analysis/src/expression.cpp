@@ -1,8 +1,200 @@
 
 #include "expression.h"
 
+#include <sstream>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+#include <atomic>
+
 using namespace std;
 
+/*!
+ * \brief Returns the first epoch of a new thread (each thread gets a range
+ * of 2^40 epochs).
+ */
+uint64_t new_expression_epoch_base() {
+    static atomic<uint64_t> next_base(1);
+    return next_base++ << 40;
+}
+
+template<typename T, typename K>
+static shared_ptr<T> intern_expression(unordered_map<K, shared_ptr<T>> &table,
+                                       const K &key) {
+    const auto needle = table.find(key);
+    if(needle != table.cend()) {
+        return needle->second;
+    }
+
+    auto result = make_shared<T>(key);
+    if(table.size() < MAX_INTERNED_EXPRESSIONS) {
+        table.emplace(key, result);
+    }
+    return result;
+}
+
+shared_ptr<Constant> make_constant(uint64_t value) {
+    static thread_local unordered_map<uint64_t, shared_ptr<Constant>> table;
+    return intern_expression(table, value);
+}
+
+/*!
+ * \brief The leaves shared by all threads (indexed by register offset).
+ */
+struct SharedLeaves {
+    vector<shared_ptr<Register>> registers;
+    vector<shared_ptr<Symbolic>> initial_values;
+
+    SharedLeaves() {
+        registers.resize(OFFB_RIP + 1);
+        initial_values.resize(OFFB_RIP + 1);
+
+        for(const auto offset : AMD64_REGISTERS) {
+            add(offset);
+        }
+        add(OFFB_RIP);
+    }
+
+    void add(uint32_t offset) {
+        registers[offset] = make_shared<Register>(offset);
+        registers[offset]->optimize();
+        initial_values[offset] = make_shared<Symbolic>(SymbolicInitialValue,
+                                                       offset);
+        initial_values[offset]->optimize();
+    }
+};
+
+static const SharedLeaves &get_shared_leaves() {
+    static const SharedLeaves shared_leaves;
+    return shared_leaves;
+}
+
+shared_ptr<Register> make_register(uint32_t offset) {
+    const SharedLeaves &shared_leaves = get_shared_leaves();
+    if(offset < shared_leaves.registers.size()
+       && shared_leaves.registers[offset]) {
+        return shared_leaves.registers[offset];
+    }
+
+    static thread_local unordered_map<uint32_t, shared_ptr<Register>> table;
+    return intern_expression(table, offset);
+}
+
+shared_ptr<Temporary> make_temporary(uint32_t id) {
+    static thread_local unordered_map<uint32_t, shared_ptr<Temporary>> table;
+    return intern_expression(table, id);
+}
+
+shared_ptr<Symbolic> make_symbolic(const string &name) {
+    static thread_local unordered_map<string, shared_ptr<Symbolic>> table;
+    return intern_expression(table, name);
+}
+
+shared_ptr<Symbolic> make_symbolic(SymbolicKind kind, uint64_t payload) {
+    if(kind == SymbolicInitialValue) {
+        const SharedLeaves &shared_leaves = get_shared_leaves();
+        if(payload < shared_leaves.initial_values.size()
+           && shared_leaves.initial_values[payload]) {
+            return shared_leaves.initial_values[payload];
+        }
+    }
+
+    static thread_local unordered_map<uint64_t, shared_ptr<Symbolic>>
+                                                    tables[SymbolicKindCount];
+    auto &table = tables[kind];
+
+    const auto needle = table.find(payload);
+    if(needle != table.cend()) {
+        return needle->second;
+    }
+
+    auto result = make_shared<Symbolic>(kind, payload);
+    if(table.size() < MAX_INTERNED_EXPRESSIONS) {
+        table.emplace(payload, result);
+    }
+    return result;
+}
+
+//! Name prefixes of the `SymbolicKind`s with an address as payload.
+static const char *SYMBOLIC_ADDRESS_PREFIXES[SymbolicKindCount] = {
+    nullptr, nullptr, "return_", "new_obj_", "ret_", "unknown_", "unknown_rsp_"
+};
+
+/*!
+ * \brief Creates the symbolic value of the given (printed) name.
+ *
+ * Names of the form of one of the `SymbolicKind`s are mapped back to it, so
+ * that unserialized symbols compare equal to the ones of the analysis.
+ */
+shared_ptr<Symbolic> parse_symbolic(const string &name) {
+    const string initial_prefix = "init_";
+    if(name.compare(0, initial_prefix.size(), initial_prefix) == 0) {
+        const string reg = name.substr(initial_prefix.size());
+        for(const auto &kv : AMD64_DISPLAY_REGISTERS) {
+            if(kv.second == reg) {
+                return make_symbolic(SymbolicInitialValue, kv.first);
+            }
+        }
+        if(reg.size() > 1 && reg[0] == 'r') {
+            char *end;
+            uint64_t offset = strtoull(reg.c_str() + 1, &end, 10);
+            if(*end == '\0') {
+                return make_symbolic(SymbolicInitialValue, offset);
+            }
+        }
+    }
+
+    // Longest prefixes first ("unknown_rsp_" before "unknown_").
+    for(int kind = SymbolicKindCount - 1; kind > SymbolicInitialValue; kind--) {
+        const string prefix = SYMBOLIC_ADDRESS_PREFIXES[kind];
+        if(name.size() <= prefix.size()
+           || name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+
+        char *end;
+        uint64_t address = strtoull(name.c_str() + prefix.size(), &end, 16);
+        if(*end == '\0') {
+            return make_symbolic(static_cast<SymbolicKind>(kind), address);
+        }
+    }
+
+    return make_symbolic(name);
+}
+
+string Symbolic::name() const {
+    if(_kind == SymbolicNamed) {
+        return _name;
+    }
+
+    stringstream stream;
+    print(stream);
+    return stream.str();
+}
+
+ostream &Symbolic::print(ostream &stream) const {
+    if(_kind == SymbolicNamed) {
+        return stream << _name;
+    }
+
+    const auto flags = stream.flags();
+    if(_kind == SymbolicInitialValue) {
+        const auto &needle = AMD64_DISPLAY_REGISTERS.find(_payload);
+        if(needle != AMD64_DISPLAY_REGISTERS.cend()) {
+            stream << "init_" << needle->second;
+        }
+        else {
+            stream << "init_r" << dec << _payload;
+        }
+    }
+    else {
+        stream << SYMBOLIC_ADDRESS_PREFIXES[_kind] << hex << _payload;
+    }
+    stream.flags(flags);
+
+    return stream;
+}
+
 bool Operation::optimizer() {
     /* Operations are the only expressions that could possibly be
      * ambiguous. We need to make sure to sanitize and optimize it as for
@@ -40,8 +232,8 @@ bool Operation::optimizer() {
     if(_operation == OperationSub) {
         // (X - X) = (0 + 0).
         if(*_lhs == *_rhs) {
-            _lhs = std::make_shared<Constant>(0);
-            _rhs = std::make_shared<Constant>(0);
+            _lhs = make_constant(0);
+            _rhs = make_constant(0);
 
             _operation = OperationAdd;
             dirty = true;
@@ -55,8 +247,8 @@ bool Operation::optimizer() {
             auto &rhs = static_cast<Constant&>(*_rhs);
 
             if(rhs.value()) {
-                _lhs = make_shared<Constant>(lhs.value() - rhs.value());
-                _rhs = make_shared<Constant>(0);
+                _lhs = make_constant(lhs.value() - rhs.value());
+                _rhs = make_constant(0);
 
                 dirty = true;
             }
@@ -72,8 +264,8 @@ bool Operation::optimizer() {
             auto &rhs = static_cast<Constant&>(*_rhs);
 
             if(lhs.value() && rhs.value()) {
-                _lhs = make_shared<Constant>(lhs.value() + rhs.value());
-                _rhs = make_shared<Constant>(0);
+                _lhs = make_constant(lhs.value() + rhs.value());
+                _rhs = make_constant(0);
 
                 dirty = true;
             }
@@ -89,8 +281,8 @@ bool Operation::optimizer() {
 
             if(rhs.value() != 0xffffffffffffffff &&
                     lhs.value() != 0xffffffffffffffff) {
-                _lhs = make_shared<Constant>(lhs.value() & rhs.value());
-                _rhs = make_shared<Constant>(0xffffffffffffffff);
+                _lhs = make_constant(lhs.value() & rhs.value());
+                _rhs = make_constant(0xffffffffffffffff);
 
                 dirty = true;
             }
@@ -100,8 +292,8 @@ bool Operation::optimizer() {
         if(_rhs->type() == ExpressionConstant) {
             auto &rhs = static_cast<Constant&>(*_rhs);
             if(rhs.value() == 0) {
-                _lhs = std::make_shared<Constant>(0);
-                _rhs = std::make_shared<Constant>(0);
+                _lhs = make_constant(0);
+                _rhs = make_constant(0);
 
                 _operation = OperationAdd;
                 dirty = true;
@@ -110,8 +302,8 @@ bool Operation::optimizer() {
         else if(_lhs->type() == ExpressionConstant) {
             auto &lhs = static_cast<Constant&>(*_lhs);
             if(lhs.value() == 0) {
-                _lhs = std::make_shared<Constant>(0);
-                _rhs = std::make_shared<Constant>(0);
+                _lhs = make_constant(0);
+                _rhs = make_constant(0);
 
                 _operation = OperationAdd;
                 dirty = true;
@@ -143,7 +335,7 @@ bool Operation::optimizer() {
             }
 
             auto &rhs = static_cast<Constant&>(*_rhs);
-            _rhs = make_shared<Constant>(-rhs.value());
+            _rhs = make_constant(-rhs.value());
 
             dirty = true;
         }
@@ -170,7 +362,7 @@ bool Operation::optimizer() {
                 }
 
                 _operation = lhs._operation;
-                _rhs = make_shared<Constant>(value);
+                _rhs = make_constant(value);
 
                 dirty = true;
             }
@@ -0,0 +1,112 @@
+#include "ext_module_store.h"
+
+#include <set>
+#include <sys/stat.h>
+
+using namespace std;
+
+vector<int64_t> ExtModuleStore::get_source_stamp(const string &module_file) {
+    vector<int64_t> stamp;
+    for(const char *suffix : { "_vtables.txt",
+                               "_vtables_xrefs.txt",
+                               "_funcs.txt" }) {
+        struct stat file_stat;
+        if(stat((module_file + suffix).c_str(), &file_stat) == -1) {
+            stamp.push_back(-1);
+            stamp.push_back(-1);
+            continue;
+        }
+        stamp.push_back(file_stat.st_size);
+        stamp.push_back(file_stat.st_mtim.tv_sec * 1000000000LL
+                        + file_stat.st_mtim.tv_nsec);
+    }
+    return stamp;
+}
+
+ExtModuleArtefactsPtr ExtModuleStore::get(const string &module_file,
+                                          bool use_companion) {
+
+    vector<int64_t> source_stamp = get_source_stamp(module_file);
+    {
+        lock_guard<mutex> _(_mtx);
+        const auto it = _modules.find(module_file);
+        if(it != _modules.cend() && it->second->source_stamp == source_stamp) {
+            return it->second;
+        }
+    }
+
+    // Modules are read without holding the lock (reading the same module
+    // concurrently only costs time).
+    shared_ptr<ExtModuleArtefacts> artefacts =
+                                          make_shared<ExtModuleArtefacts>();
+    artefacts->source_stamp = move(source_stamp);
+    artefacts->vtables_parsed = VTableFile::read_module(module_file,
+                                                        use_companion,
+                                                        artefacts->vtables);
+    artefacts->funcs_parsed = ExternalFunctions::read_module(module_file,
+                                                             artefacts->funcs);
+
+    lock_guard<mutex> _(_mtx);
+    _modules[module_file] = artefacts;
+    return artefacts;
+}
+
+size_t ExtModuleStore::size() {
+    lock_guard<mutex> _(_mtx);
+    return _modules.size();
+}
+
+vector<size_t> select_imported_ext_modules(
+                     const vector<ExternalFunctionVector> &ext_funcs_modules,
+                     const unordered_set<string> &imported_funcs,
+                     const VTableModule &this_vtables) {
+
+    // The member functions of a class share the prefix of the nested name:
+    // _ZTVN3foo3BarE -> _ZN3foo3Bar..., _ZTV3Bar -> _ZN3Bar...
+    unordered_set<string> class_prefixes;
+    set<size_t> prefix_lengths;
+    for(const VTable &vtable : this_vtables.vtables) {
+        if(vtable.type == VTableTypeNormal
+           || vtable.name.compare(0, 4, "_ZTV") != 0) {
+            continue;
+        }
+        string class_name = vtable.name.substr(4);
+        if(!class_name.empty() && class_name.front() == 'N') {
+            class_name = class_name.substr(1);
+            if(!class_name.empty() && class_name.back() == 'E') {
+                class_name.pop_back();
+            }
+        }
+        if(class_name.empty()) {
+            continue;
+        }
+        class_prefixes.insert("_ZN" + class_name);
+        prefix_lengths.insert(class_name.size() + 3);
+    }
+
+    vector<size_t> selected;
+    for(size_t idx = 0; idx < ext_funcs_modules.size(); idx++) {
+        bool is_imported = false;
+        for(const ExternalFunction &func : ext_funcs_modules[idx]) {
+            if(imported_funcs.find(func.name) != imported_funcs.cend()) {
+                is_imported = true;
+                break;
+            }
+            for(size_t length : prefix_lengths) {
+                if(length <= func.name.size()
+                   && class_prefixes.find(func.name.substr(0, length))
+                      != class_prefixes.cend()) {
+                    is_imported = true;
+                    break;
+                }
+            }
+            if(is_imported) {
+                break;
+            }
+        }
+        if(is_imported) {
+            selected.push_back(idx);
+        }
+    }
+    return selected;
+}
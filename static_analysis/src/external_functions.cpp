@@ -4,6 +4,25 @@
 
 using namespace std;
 
+mutex ExternalFunctions::_names_mtx;
+unordered_map<string, uint32_t> ExternalFunctions::_names;
+
+
+uint32_t ExternalFunctions::intern_name(const string &name) {
+    lock_guard<mutex> _(_names_mtx);
+    return _names.emplace(name, _names.size()).first->second;
+}
+
+
+uint32_t ExternalFunctions::find_name(const string &name) {
+    lock_guard<mutex> _(_names_mtx);
+    auto it = _names.find(name);
+    if(it == _names.cend()) {
+        return EXTERNAL_NAME_NO_ID;
+    }
+    return it->second;
+}
+
 
 bool ExternalFunctions::is_finalized() const {
     return _is_finalized;
@@ -18,6 +37,18 @@ bool ExternalFunctions::parse(const string &funcs_file) {
                             " finalized.");
     }
 
+    ExternalFunctionVector functions;
+    if(!read_module(funcs_file, functions)) {
+        return false;
+    }
+    add_module(functions);
+    return true;
+}
+
+
+bool ExternalFunctions::read_module(const string &funcs_file,
+                                    ExternalFunctionVector &functions) {
+
     ifstream file(funcs_file + "_funcs.txt");
     if(!file) {
         return false;
@@ -55,22 +86,37 @@ bool ExternalFunctions::parse(const string &funcs_file) {
         func.addr = func_addr;
         func.name = func_name;
         func.module_name = module_name;
+        func.index = 0;
+        func.name_id = intern_name(func_name);
+
+        functions.push_back(func);
+    }
+
+    return true;
+}
+
+
+void ExternalFunctions::add_module(ExternalFunctionVector &functions) {
+
+    // Make sure that we add modules only if object was not finalized yet.
+    if(_is_finalized) {
+        throw runtime_error("Parse attempt after ExternalFunctions object was"\
+                            " finalized.");
+    }
+
+    for(ExternalFunction &func : functions) {
 
         // NOTE: Index is a unique identifier for all functions in all
         // external modules.
         func.index = _index;
 
-        _external_functions.push_back(func);
-        assert(_external_functions[_index].module_name == func.module_name
-               && _external_functions[_index].addr == func.addr
-               && _external_functions[_index].name == func.name
-               && _external_functions[_index].index == func.index
+        _external_functions.push_back(move(func));
+        assert(_external_functions[_index].index == _index
                && "Index of function and index in vector are not the same.");
 
         _index++;
     }
-
-    return true;
+    functions.clear();
 }
 
 
@@ -82,9 +128,15 @@ void ExternalFunctions::finalize() {
     }
     _is_finalized = true;
 
-    // Build external functions map for this module.
-    for(auto &it : _external_functions) {
-        _external_functions_map[it.name] = &it;
+    // Build external functions lookup tables. Functions with the same name
+    // are resolved to the last one, functions at the same address of a
+    // module to the first one.
+    for(const auto &it : _external_functions) {
+        if(it.name_id >= _external_functions_names.size()) {
+            _external_functions_names.resize(it.name_id + 1, nullptr);
+        }
+        _external_functions_names[it.name_id] = &it;
+        _external_functions_addrs[it.module_name].emplace(it.addr, &it);
     }
 
     return;
@@ -99,10 +151,7 @@ const ExternalFunction* ExternalFunctions::get_external_function(
         throw runtime_error("ExternalFunctions object was not finalized.");
     }
 
-    if(_external_functions_map.find(name) == _external_functions_map.cend()) {
-        return nullptr;
-    }
-    return _external_functions_map.at(name);
+    return get_external_function_by_id(find_name(name));
 }
 
 
@@ -115,11 +164,13 @@ const ExternalFunction* ExternalFunctions::get_external_function(
         throw runtime_error("ExternalFunctions object was not finalized.");
     }
 
-    for(const auto &it : _external_functions) {
-        if(it.module_name == module_name
-            && it.addr == func_addr) {
-            return &it;
-        }
+    const auto module_it = _external_functions_addrs.find(module_name);
+    if(module_it == _external_functions_addrs.cend()) {
+        return nullptr;
+    }
+    const auto it = module_it->second.find(func_addr);
+    if(it == module_it->second.cend()) {
+        return nullptr;
     }
-    return nullptr;
+    return it->second;
 }
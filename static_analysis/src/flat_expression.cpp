@@ -0,0 +1,132 @@
+#include "flat_expression.h"
+
+using namespace std;
+
+/*!
+ * \brief Computes a hash of the expression that is equal for all expressions
+ * that are equal in terms of `Expression::operator==`.
+ *
+ * `Expression::hash` does not fulfill this since operations that are semantic
+ * no-ops (see `Operation::equals_inner`) are equal to their left-hand side.
+ * Such operations take the hash of their left-hand side here.
+ *
+ * \param child_hashes Canonical hashes of the sub-expressions (address of an
+ * indirection or left-hand and right-hand side of an operation).
+ */
+size_t canonical_hash(const Expression &expression,
+                      const size_t *child_hashes) {
+    switch(expression.type()) {
+        case ExpressionIndirection: {
+            size_t h = expression.type();
+            std::hash_combine(h, child_hashes[0]);
+            return h;
+        }
+
+        case ExpressionOperation: {
+            const auto &operation = static_cast<const Operation&>(expression);
+            if(operation.rhs()->type() == ExpressionConstant) {
+                const auto &constant =
+                               static_cast<const Constant&>(*operation.rhs());
+                switch(operation.operation()) {
+                    case OperationAdd:
+                    case OperationSub:
+                        if(constant.value() == 0) {
+                            return child_hashes[0];
+                        }
+                        break;
+                    case OperationAnd:
+                        if(constant.value() != 0xffffffffffffffff) {
+                            return child_hashes[0];
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+            size_t h = expression.type();
+            std::hash_combine(h, operation.operation());
+            std::hash_combine(h, child_hashes[0]);
+            std::hash_combine(h, child_hashes[1]);
+            return h;
+        }
+
+        default:
+            return expression.hash();
+    }
+}
+
+/*!
+ * \brief Computes the canonical hash of an expression without indexing it.
+ */
+size_t canonical_hash(const Expression &expression) {
+    size_t child_hashes[2] = {0, 0};
+    if(expression.type() == ExpressionIndirection) {
+        const auto &indirection = static_cast<const Indirection&>(expression);
+        child_hashes[0] = canonical_hash(*indirection.address());
+    }
+    else if(expression.type() == ExpressionOperation) {
+        const auto &operation = static_cast<const Operation&>(expression);
+        child_hashes[0] = canonical_hash(*operation.lhs());
+        child_hashes[1] = canonical_hash(*operation.rhs());
+    }
+    return canonical_hash(expression, child_hashes);
+}
+
+FlatExpression::FlatExpression(const Expression &expression) {
+    add(expression);
+}
+
+uint32_t FlatExpression::add(const Expression &expression) {
+    FlatExpressionNode node;
+    node.expression = &expression;
+    node.lhs = FLAT_EXPRESSION_NO_CHILD;
+    node.rhs = FLAT_EXPRESSION_NO_CHILD;
+
+    size_t child_hashes[2] = {0, 0};
+    if(expression.type() == ExpressionIndirection) {
+        const auto &indirection = static_cast<const Indirection&>(expression);
+        node.lhs = add(*indirection.address());
+        child_hashes[0] = _hashes[node.lhs];
+    }
+    else if(expression.type() == ExpressionOperation) {
+        const auto &operation = static_cast<const Operation&>(expression);
+        node.lhs = add(*operation.lhs());
+        node.rhs = add(*operation.rhs());
+        child_hashes[0] = _hashes[node.lhs];
+        child_hashes[1] = _hashes[node.rhs];
+    }
+
+    _hashes.push_back(canonical_hash(expression, child_hashes));
+    _nodes.push_back(node);
+    return _nodes.size() - 1;
+}
+
+/*!
+ * \brief Checks if the given expression is a sub-expression (or the whole
+ * expression), i.e., the same as `Expression::contains` without a depth
+ * limit.
+ *
+ * \param hash The canonical hash of `expression`.
+ */
+bool FlatExpression::contains(const Expression &expression,
+                              size_t hash) const {
+
+    // The scan does not branch (hence it is vectorized), the nodes are only
+    // compared if any hash matches.
+    const size_t *hashes = _hashes.data();
+    const size_t num = _hashes.size();
+    bool has_match = false;
+    for(size_t i = 0; i < num; i++) {
+        has_match |= hashes[i] == hash;
+    }
+    if(!has_match) {
+        return false;
+    }
+
+    for(size_t i = 0; i < num; i++) {
+        if(hashes[i] == hash && *_nodes[i].expression == expression) {
+            return true;
+        }
+    }
+    return false;
+}
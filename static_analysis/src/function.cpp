@@ -1,20 +1,34 @@
 
 #include "function.h"
 #include "path_builder.h"
+#include "instrumentation.h"
 
 #include <map>
 #include <set>
-#include <deque>
 #include <sstream>
 #include <cstddef>
 #include <cassert>
 #include <iterator>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
-typedef set<uintptr_t> SeenBlocks;
-typedef map<Path, SeenBlocks> PathBlocks;
+/*!
+ * \brief A block on the path of a full traversal together with the successors
+ * that still have to be visited.
+ */
+struct TraversalFrame {
+    uintptr_t address;
+    uintptr_t successors[2];
+    bool annotations[2];
+    uint8_t num_successors = 0;
+    uint8_t next_successor = 0;
+
+    //! Set if any successor was visited (otherwise the path ends here).
+    bool has_successor = false;
+};
 
 /*!
  * \brief Creates a new instance of the class, explicitly setting its entry
@@ -38,6 +52,7 @@ Function::Function(uintptr_t entry, uint8_t branch_threshold)
  * otherwise.
  */
 bool Function::can_be_fully_traversed() const {
+    ensure_lifted();
     auto branches = 0;
     for(const auto &kv : _function_blocks) {
         if(kv.second->get_terminator().type == TerminatorJcc) {
@@ -49,17 +64,39 @@ bool Function::can_be_fully_traversed() const {
 }
 
 bool Function::contains_address(uint64_t addr) const {
+    ensure_lifted();
     if(_addresses.find(addr) != _addresses.cend()) {
         return true;
     }
     return false;
 }
 
+/*!
+ * \brief Returns the block map entry of the block containing the given
+ * address (or `end()` if none exists).
+ *
+ * Blocks of a function do not overlap, hence only the last block starting
+ * at or before the address has to be checked.
+ */
+template<typename T>
+static typename T::const_iterator find_containing_block(const T &blocks,
+                                                        uint64_t addr) {
+    auto it = blocks.upper_bound(addr);
+    if(it == blocks.cbegin()) {
+        return blocks.cend();
+    }
+    --it;
+    if(it->second->contains_address(addr)) {
+        return it;
+    }
+    return blocks.cend();
+}
+
 const Block &Function::get_containing_block(uint64_t addr) const {
-    for(const auto &kv : _function_blocks) {
-        if(kv.second->contains_address(addr)) {
-            return *kv.second;
-        }
+    ensure_lifted();
+    const auto it = find_containing_block(_function_blocks, addr);
+    if(it != _function_blocks.cend()) {
+        return *it->second;
     }
     stringstream err_msg;
     err_msg << "Block with address "
@@ -69,10 +106,10 @@ const Block &Function::get_containing_block(uint64_t addr) const {
 }
 
 const BlockPtr &Function::get_containing_block_ptr(uint64_t addr) const {
-    for(const auto &kv : _function_blocks) {
-        if(kv.second->contains_address(addr)) {
-            return kv.second;
-        }
+    ensure_lifted();
+    const auto it = find_containing_block(_function_blocks, addr);
+    if(it != _function_blocks.cend()) {
+        return it->second;
     }
     stringstream err_msg;
     err_msg << "Block with address "
@@ -82,10 +119,9 @@ const BlockPtr &Function::get_containing_block_ptr(uint64_t addr) const {
 }
 
 const BlockSSAPtr &Function::get_containing_block_ssa(uint64_t addr) const {
-    for(const auto &kv : _function_blocks_ssa) {
-        if(kv.second->contains_address(addr)) {
-            return kv.second;
-        }
+    const auto it = find_containing_block(_function_blocks_ssa, addr);
+    if(it != _function_blocks_ssa.cend()) {
+        return it->second;
     }
     stringstream err_msg;
     err_msg << "Block with address "
@@ -101,7 +137,8 @@ const BlockSSAPtr &Function::get_containing_block_ssa(uint64_t addr) const {
  * callback on each encountered basic block. If it is infeasible to traverse
  * all possible paths (as determined by `can_be_fully_traversed`), logic
  * switches to a lightweight path generation algorithm. For this to work
- * properly, `block_predicate` has to be set.
+ * properly, `block_predicate` has to be set. A full traversal stops (with a
+ * message on `cerr`) once it exceeds the default `TraversalBudget`.
  *
  * The traversal callback is passed several parameters:
  *
@@ -124,10 +161,17 @@ bool Function::traverse(const TraversalCallback &block_callback,
                         const PathCallback &path_callback,
                         void *user_defined)
     const {
+    ensure_lifted();
     if(can_be_fully_traversed()) {
-        throw runtime_error("Path callbacks are not yet implemented for full"
-                            " traversals.");
-        return traverser(block_callback, user_defined);
+        TraversalStatistics statistics;
+        bool result = traverser(block_callback, path_callback,
+                                TraversalBudget(), user_defined, statistics);
+        if(statistics.truncated) {
+            cerr << "Full traversal of function " << hex << _entry
+                 << " truncated after " << dec << statistics.paths
+                 << " paths (" << statistics.blocks << " blocks)." << endl;
+        }
+        return result;
     }
 
     if(!block_predicate) {
@@ -139,13 +183,13 @@ bool Function::traverse(const TraversalCallback &block_callback,
     const auto paths = builder.build_paths(block_predicate);
 
     // FIXME: This duplicates code from below.
-    for(const auto &path : paths) {
+    for(size_t i = 0; i < paths.size(); i++) {
 
         Path current_path;
         const Terminator *previous_terminator = nullptr;
 
-        for(const auto &block : path) {
-            const auto &needle = _function_blocks.find(block);
+        for(uint32_t j = 0; j < paths.length(i); j++) {
+            const auto &needle = _function_blocks.find(paths.get_block(i, j));
             if(needle == _function_blocks.cend()) {
                 break;
             }
@@ -202,69 +246,132 @@ bool Function::traverse(const TraversalCallback &block_callback,
     return true;
 }
 
+/*!
+ * \brief Traverses all paths through the function (depth-first).
+ *
+ * Only the current path is kept: a stack of its blocks, its annotations and
+ * the set of blocks on it (a path ends as soon as it would revisit one of
+ * them). Backtracking removes the last block from all three, hence memory is
+ * linear in the length of the longest path. Successors are visited in the
+ * order of the former work list (the `true` annotation first).
+ *
+ * \param path_callback Called whenever a path ends (may be empty).
+ * \param budget Limits after which the traversal stops.
+ * \param statistics Filled with the statistics of the traversal.
+ * \return Always `true`.
+ */
 bool Function::traverser(const TraversalCallback &callback,
-                         void *user_defined) const {
-
-    deque<pair<uintptr_t, Path>> work_list;
-
-    PathBlocks path_seen_blocks;
-    work_list.push_back(make_pair(_entry, Path()));
+                         const PathCallback &path_callback,
+                         const TraversalBudget &budget,
+                         void *user_defined,
+                         arg_out TraversalStatistics &statistics) const {
 
-    while(!work_list.empty()) {
-        const auto pair = work_list.back();
-        work_list.pop_back();
+    statistics = TraversalStatistics();
 
-        uintptr_t current_address = pair.first;
-        const Path &path = pair.second;
+    vector<TraversalFrame> stack;
+    unordered_set<uintptr_t> on_path;
+    Path path;
 
-        SeenBlocks &seen_blocks = path_seen_blocks[path];
-        if(seen_blocks.find(current_address) != seen_blocks.cend()) {
-            continue;
+    // Visits the given block and pushes it onto the path.
+    auto enter = [&](uintptr_t address) -> bool {
+        if(on_path.find(address) != on_path.cend()) {
+            return false;
         }
 
-        const auto &needle = _function_blocks.find(current_address);
+        const auto &needle = _function_blocks.find(address);
         if(needle == _function_blocks.cend()) {
             /* We cannot find a block with the given address that lies within
              * the current function. This is most likely the case due to the
              * invocation of a non-returning call. We must not follow these
              * anyway. */
-            continue;
+            return false;
         }
 
-        seen_blocks.insert(current_address);
-        if(!callback(user_defined, path, *needle->second)) {
-            /* The callback has decided not to follow this path any further. */
-            continue;
-        }
+        statistics.blocks++;
+        on_path.insert(address);
 
-        // The current path may be extended by a true or false annotation.
-        Path path_false = path, path_true = path;
+        TraversalFrame frame;
+        frame.address = address;
 
-        path_false.push_back(false);
-        path_true.push_back(true);
+        if(callback(user_defined, path, *needle->second)) {
+            const Terminator &terminator = needle->second->get_terminator();
 
-        const Terminator &terminator = needle->second->get_terminator();
+            switch(terminator.type) {
+            case TerminatorJump:
+                frame.successors[frame.num_successors] = terminator.target;
+                frame.annotations[frame.num_successors++] = true;
+                break;
 
-        switch(terminator.type) {
-        case TerminatorJump:
-            work_list.push_back(make_pair(terminator.target, path_true));
-            path_seen_blocks[path_true] = seen_blocks;
-            break;
+            case TerminatorJcc:
+            case TerminatorFallthrough:
+            case TerminatorCallUnresolved:
+            case TerminatorCall:
+                frame.successors[frame.num_successors] =
+                                                        terminator.fall_through;
+                frame.annotations[frame.num_successors++] = true;
+
+                if(terminator.type == TerminatorJcc) {
+                    frame.successors[frame.num_successors] = terminator.target;
+                    frame.annotations[frame.num_successors++] = false;
+                }
+                break;
 
-        case TerminatorJcc:
-            work_list.push_back(make_pair(terminator.target, path_false));
-            path_seen_blocks[path_false] = seen_blocks;
+            default:
+                break;
+            }
+        }
+        /* Otherwise, the callback has decided not to follow this path any
+         * further. */
 
-        case TerminatorFallthrough:
-        case TerminatorCallUnresolved:
-        case TerminatorCall:
-            work_list.push_back(make_pair(terminator.fall_through, path_true));
-            path_seen_blocks[path_true] = seen_blocks;
-            break;
+        stack.push_back(frame);
 
-        default:
+        size_t bytes = stack.size() * (sizeof(TraversalFrame)
+                                       + sizeof(uintptr_t))
+                       + path.size() / 8;
+        statistics.max_depth = max(statistics.max_depth, stack.size());
+        statistics.max_bytes = max(statistics.max_bytes, bytes);
+        return true;
+    };
+
+    enter(_entry);
+    while(!stack.empty()) {
+        if(statistics.paths >= budget.max_paths
+           || statistics.blocks >= budget.max_blocks
+           || statistics.max_bytes >= budget.max_bytes) {
+            statistics.truncated = true;
             break;
         }
+
+        TraversalFrame &frame = stack.back();
+        if(frame.next_successor < frame.num_successors) {
+            uint8_t index = frame.next_successor++;
+            uintptr_t successor = frame.successors[index];
+
+            path.push_back(frame.annotations[index]);
+
+            // The frame reference is invalidated when entering the successor.
+            size_t parent = stack.size() - 1;
+            if(enter(successor)) {
+                stack[parent].has_successor = true;
+            }
+            else {
+                path.pop_back();
+            }
+            continue;
+        }
+
+        if(!frame.has_successor) {
+            statistics.paths++;
+            if(path_callback) {
+                path_callback(user_defined, path);
+            }
+        }
+
+        on_path.erase(frame.address);
+        stack.pop_back();
+        if(!stack.empty()) {
+            path.pop_back();
+        }
     }
 
     return true;
@@ -276,9 +383,13 @@ void Function::add_block(uintptr_t address, IRSB *block,
 }
 
 void Function::add_block_ssa(const ssa::BasicBlock &basic_block) {
-    const shared_ptr<BlockSSA> &bb_ssa = make_shared<BlockSSA>(basic_block);
+    const shared_ptr<BlockSSA> &bb_ssa = make_shared<BlockSSA>(basic_block,
+                                                               &_operands_ssa);
     _function_blocks_ssa[basic_block.address()] = bb_ssa;
 
+    // The lookup tables are built again by `finalize_ssa`.
+    _def_use_index = DefUseSSAIndex();
+
     // Build definitions/uses.
     for(const BaseInstructionSSAPtr &instr: bb_ssa->get_instructions()) {
 
@@ -291,7 +402,9 @@ void Function::add_block_ssa(const ssa::BasicBlock &basic_block) {
                     case SSAOpTypeMemoryX64: {
                         const RegisterX64SSA &temp =
                               static_cast<const MemoryX64SSA &>(*op).get_base();
-                        _uses[make_shared<RegisterX64SSA>(temp)].insert(instr);
+                        _uses[_operands_ssa.intern(
+                                make_shared<RegisterX64SSA>(temp))].insert(
+                                                                        instr);
                         break;
                     }
                     default:
@@ -308,7 +421,9 @@ void Function::add_block_ssa(const ssa::BasicBlock &basic_block) {
                     case SSAOpTypeMemoryX64: {
                         const RegisterX64SSA &temp =
                               static_cast<const MemoryX64SSA &>(*op).get_base();
-                        _uses[make_shared<RegisterX64SSA>(temp)].insert(instr);
+                        _uses[_operands_ssa.intern(
+                                make_shared<RegisterX64SSA>(temp))].insert(
+                                                                        instr);
                         break;
                     }
                     default:
@@ -338,138 +453,168 @@ const std::set<uint64_t> &Function::get_vfunc_xrefs() const {
     return _vfunc_xrefs;
 }
 
-GraphCfg::vertex_descriptor Function::get_maybe_new_node_cfg(
-                                               const shared_ptr<Block> &block) {
-
-    // Check if block already exists in cfg => return this one.
-    const auto vertices = boost::vertices(_cfg);
-    for(auto it = vertices.first; it != vertices.second; ++it) {
-        if(_cfg[*it] == block) {
-            return *it;
-        }
+bool GraphCfg::find_node(uintptr_t addr, CfgNode &node) const {
+    const auto it = lower_bound(_addresses.cbegin(), _addresses.cend(), addr);
+    if(it == _addresses.cend() || *it != addr) {
+        return false;
     }
-    // Create new cfg node.
-    GraphCfg::vertex_descriptor new_vertex = boost::add_vertex(_cfg);
-    _cfg[new_vertex] = block;
-    return new_vertex;
+    node = it - _addresses.cbegin();
+    return true;
 }
 
-void Function::build_cfg() {
+void Function::build_cfg(GraphCfg &cfg) const {
+    const size_t num_blocks = _function_blocks.size();
+    cfg._blocks.reserve(num_blocks);
+    cfg._addresses.reserve(num_blocks);
+    unordered_map<uintptr_t, CfgNode> nodes(num_blocks);
     for(const auto &kv : _function_blocks) {
+        nodes[kv.first] = cfg._blocks.size();
+        cfg._blocks.push_back(kv.second);
+        cfg._addresses.push_back(kv.first);
+    }
 
-        const shared_ptr<Block> current_block = kv.second;
-        GraphCfg::vertex_descriptor current_node =
-                                          get_maybe_new_node_cfg(current_block);
+    cfg._successor_offsets.reserve(num_blocks + 1);
+    for(const auto &kv : _function_blocks) {
+        cfg._successor_offsets.push_back(cfg._successors.size());
+        auto add_successor = [&](uintptr_t address) {
+            const auto needle = nodes.find(address);
+            if(needle != nodes.cend()) {
+                cfg._successors.push_back(needle->second);
+            }
+        };
 
-        const Terminator &terminator = current_block->get_terminator();
+        const Terminator &terminator = kv.second->get_terminator();
         switch(terminator.type) {
         case TerminatorJump:
             // If jump is not a tail jump and can be found in the basic blocks
             // add an edge between both.
             if(!terminator.is_tail) {
-                for(const auto &sub_kv : _function_blocks) {
-                    if(sub_kv.second->get_address() == terminator.target) {
-                        GraphCfg::vertex_descriptor next_node =
-                                          get_maybe_new_node_cfg(sub_kv.second);
-                        boost::add_edge(current_node, next_node, _cfg);
-                        break;
-                    }
-                }
+                add_successor(terminator.target);
             }
             break;
 
         case TerminatorJcc:
             // Add edge to target basic block.
-            for(const auto &sub_kv : _function_blocks) {
-                if(sub_kv.second->get_address() == terminator.target) {
-                    GraphCfg::vertex_descriptor next_node =
-                                          get_maybe_new_node_cfg(sub_kv.second);
-                    boost::add_edge(current_node, next_node, _cfg);
-                    break;
-                }
-            }
+            add_successor(terminator.target);
 
         case TerminatorFallthrough:
         case TerminatorCallUnresolved:
         case TerminatorCall:
             // Add edge to fall through basic block.
-            for(const auto &sub_kv : _function_blocks) {
-                if(sub_kv.second->get_address() == terminator.fall_through) {
-                    GraphCfg::vertex_descriptor next_node =
-                                          get_maybe_new_node_cfg(sub_kv.second);
-                    boost::add_edge(current_node, next_node, _cfg);
-                    break;
-                }
-            }
+            add_successor(terminator.fall_through);
             break;
 
         default:
             break;
         }
     }
+    cfg._successor_offsets.push_back(cfg._successors.size());
+}
 
-    // Since "VertexList=listS" does not have an internal vertex_index
-    // property, we have to create one manually
-    // for the boost algorithms to work.
-    // http://www.boost.org/doc/libs/1_50_0/libs/graph/doc/breadth_first_search.html
-    // http://www.boost.org/doc/libs/1_64_0/libs/graph/example/dijkstra-example-listS.cpp
-    // Also generate address node mapping.
-    auto vertices = boost::vertices(_cfg);
-    _indexmap = boost::get(boost::vertex_index, _cfg);
-    int index = 0;
-    for(auto it = vertices.first; it != vertices.second; ++it) {
-        _indexmap[*it] = index;
-        index++;
-
-        _addr_graph_node_map[_cfg[*it]->get_address()] = *it;
+void Function::build_reachability() {
+    // Index the reachability of blocks once (the successors are the ones
+    // followed by `PathBuilder`).
+    vector<uintptr_t> addresses;
+    unordered_map<uintptr_t, uint32_t> indexes;
+    for(const auto &kv : _function_blocks) {
+        indexes[kv.first] = addresses.size();
+        addresses.push_back(kv.first);
     }
-}
 
-const GraphCfg &Function::get_cfg() const {
-    return _cfg;
-}
+    vector<vector<uint32_t>> successors(addresses.size());
+    for(const auto &kv : _function_blocks) {
+        vector<uint32_t> &current = successors[indexes[kv.first]];
+        auto add_successor = [&](uintptr_t address) {
+            const auto &needle = indexes.find(address);
+            if(needle != indexes.cend()) {
+                current.push_back(needle->second);
+            }
+        };
+
+        const Terminator &terminator = kv.second->get_terminator();
+        switch(terminator.type) {
+        case TerminatorJump:
+            add_successor(terminator.target);
+            break;
+
+        case TerminatorJcc:
+            add_successor(terminator.target);
+
+        case TerminatorFallthrough:
+        case TerminatorCallUnresolved:
+        case TerminatorCall:
+            add_successor(terminator.fall_through);
+            break;
+
+        default:
+            break;
+        }
+    }
 
-const boost::property_map<GraphCfg, boost::vertex_index_t>::type &
-                                            Function::get_cfg_indexmap() const {
-    return _indexmap;
+    _reachability.build(addresses, successors);
 }
 
-GraphCfg::vertex_descriptor Function::get_cfg_node(uint64_t addr) const {
-    try {
-        return _addr_graph_node_map.at(addr);
+const GraphCfg &Function::get_cfg() const {
+    ensure_lifted();
+    if(!_cfg_state) {
+        throw runtime_error("Function is not finalized.");
     }
-    catch(...) {
-        stringstream dump_dir;
-        dump_dir << "/tmp/engels_cfg_"
-                 << setfill('0') << setw(8) << hex << _entry
-                 << ".dot";
-        dump_cfg(dump_dir.str());
-
-        stringstream err_msg;
-        err_msg << "Node with address "
-                << hex << addr
-                << " does not exist in cfg. Dumping cfg to '"
-                << dump_dir.str()
-                << "'.";
-        throw runtime_error(err_msg.str().c_str());
+    call_once(_cfg_state->built, [this]() {
+        build_cfg(_cfg_state->cfg);
+    });
+    return _cfg_state->cfg;
+}
+
+CfgNode Function::get_cfg_node(uint64_t addr) const {
+    const GraphCfg &cfg = get_cfg();
+    CfgNode node;
+    if(cfg.find_node(addr, node)) {
+        return node;
     }
+
+    stringstream dump_dir;
+    dump_dir << "/tmp/engels_cfg_"
+             << setfill('0') << setw(8) << hex << _entry
+             << ".dot";
+    dump_cfg(dump_dir.str());
+
+    stringstream err_msg;
+    err_msg << "Node with address "
+            << hex << addr
+            << " does not exist in cfg. Dumping cfg to '"
+            << dump_dir.str()
+            << "'.";
+    throw runtime_error(err_msg.str().c_str());
 }
 
 void Function::dump_cfg(const string &file_name) const {
+    const GraphCfg &cfg = get_cfg();
     ofstream dump_file;
     dump_file.open(file_name.c_str());
-    SimpleCfgNodeWriter<GraphCfg> node_writer(_cfg);
-    boost::write_graphviz(dump_file, _cfg, node_writer);
+    dump_file << "digraph G {\n";
+    for(CfgNode node = 0; node < cfg.num_nodes(); node++) {
+        dump_file << node
+                  << "[fontname=\"Ubuntu Mono\", shape=rect, label=\""
+                  << hex << cfg[node]->get_address() << dec
+                  << "\"];\n";
+    }
+    for(CfgNode node = 0; node < cfg.num_nodes(); node++) {
+        for(const CfgNode *it = cfg.successors_begin(node);
+            it != cfg.successors_end(node);
+            ++it) {
+            dump_file << node << "->" << *it << " ;\n";
+        }
+    }
+    dump_file << "}\n";
     dump_file.close();
 }
 
 const BaseInstructionSSAPtrSet Function::get_instruction_ssa(
                                                 uint64_t addr,
                                                 InstructionTypeSSA type) const {
-    for(const auto &kv : _function_blocks_ssa) {
-        if(kv.second->contains_address(addr)) {
-            return kv.second->get_instruction(addr, type);
-        }
+    const auto it = find_containing_block(_function_blocks_ssa, addr);
+    if(it != _function_blocks_ssa.cend()) {
+        return it->second->get_instruction(addr, type);
     }
     BaseInstructionSSAPtrSet result;
     return result;
@@ -483,24 +628,75 @@ const DefUseSSAMap &Function::get_uses_ssa() const {
     return _uses;
 }
 
-const BaseInstructionSSAPtrSet &Function::get_instrs_define_op_ssa(
-                                                const OperandSSAPtr &op) const {
-    if(_definitions.find(op) != _definitions.cend()) {
-        return _definitions.at(op);
+// Operands of the function's instructions are looked up by their ids,
+// all others (e.g., created during an analysis) by their values.
+const BaseInstructionSSAPtrSet &Function::get_instrs_op_ssa(
+                          const OperandSSAPtr &op,
+                          uint32_t id,
+                          const DefUseSSAMap &def_use,
+                          const vector<const BaseInstructionSSAPtrSet*> &by_id) {
+    if(id < by_id.size()) {
+        if(by_id[id] != nullptr) {
+            return *by_id[id];
+        }
+        return EMPTY_INSTRUCTION_SSA_PTR_SET;
+    }
+
+    const auto it = def_use.find(op);
+    if(it != def_use.cend()) {
+        return it->second;
     }
     return EMPTY_INSTRUCTION_SSA_PTR_SET;
 }
 
+const BaseInstructionSSAPtrSet &Function::get_instrs_define_op_ssa(
+                                                const OperandSSAPtr &op) const {
+    return get_instrs_op_ssa(op,
+                             _operands_ssa.get_id(*op),
+                             _definitions,
+                             _def_use_index.definitions);
+}
+
 const BaseInstructionSSAPtrSet &Function::get_instrs_use_op_ssa(
                                                 const OperandSSAPtr &op) const {
-    if(_uses.find(op) != _uses.cend()) {
-        return _uses.at(op);
+    return get_instrs_op_ssa(op,
+                             _operands_ssa.get_id(*op),
+                             _uses,
+                             _def_use_index.uses);
+}
+
+void Function::finalize_ssa() {
+    _instructions_ssa_by_id.clear();
+    for(const auto &kv : _function_blocks_ssa) {
+        for(const BaseInstructionSSAPtr &instr
+                : kv.second->get_instructions()) {
+            instr->_function_id = _instructions_ssa_by_id.size();
+            _instructions_ssa_by_id.push_back(instr.get());
+        }
+    }
+
+    _def_use_index.definitions.assign(_operands_ssa.size(), nullptr);
+    _def_use_index.uses.assign(_operands_ssa.size(), nullptr);
+
+    for(const OperandSSAPtr &op : _operands_ssa) {
+        const uint32_t id = _operands_ssa.get_id(*op);
+
+        const auto def_it = _definitions.find(op);
+        if(def_it != _definitions.cend()) {
+            _def_use_index.definitions[id] = &def_it->second;
+        }
+        const auto use_it = _uses.find(op);
+        if(use_it != _uses.cend()) {
+            _def_use_index.uses[id] = &use_it->second;
+        }
     }
-    return EMPTY_INSTRUCTION_SSA_PTR_SET;
 }
 
 void Function::finalize() {
-    build_cfg();
+
+    // The cfg is only built if it is used (\see `get_cfg`).
+    _cfg_state = make_shared<FunctionCfgState>();
+    build_reachability();
 
     // Copy all addresses that are hold by this function.
     for(const auto &kv : _function_blocks) {
@@ -522,10 +718,62 @@ void Function::finalize() {
     }
 }
 
+/*!
+ * \brief Estimates the heap bytes of the given definition/use map.
+ */
+static size_t get_def_use_footprint(const DefUseSSAMap &def_use_map) {
+    size_t bytes = footprint_hash(def_use_map);
+    for(const auto &kv : def_use_map) {
+        bytes += footprint_hash(kv.second);
+    }
+    return bytes;
+}
+
+size_t Function::get_memory_footprint() const {
+
+    // Shared objects are allocated together with their control block
+    // (two counters and the virtual table pointer).
+    const size_t shared_overhead = 16;
+
+    size_t bytes = footprint_tree(_function_blocks);
+    for(const auto &kv : _function_blocks) {
+        bytes += sizeof(Block) + shared_overhead
+                 + footprint_tree(kv.second->get_addresses());
+    }
+    bytes += footprint_vector(_blocks_ret);
+    bytes += footprint_vector(_blocks_tail_jmp);
+
+    bytes += footprint_tree(_function_blocks_ssa);
+    for(const auto &kv : _function_blocks_ssa) {
+        const BaseInstructionSSAPtrs &instrs = kv.second->get_instructions();
+        bytes += sizeof(BlockSSA) + shared_overhead
+                 + footprint_vector(instrs);
+        for(const BaseInstructionSSAPtr &instr : instrs) {
+            bytes += sizeof(BaseInstructionSSA) + shared_overhead
+                     + footprint_vector(instr->get_operands());
+        }
+    }
+
+    bytes += footprint_tree(_xrefs);
+    bytes += footprint_tree(_vfunc_xrefs);
+    bytes += footprint_tree(_addresses);
+    bytes += get_def_use_footprint(_definitions);
+    bytes += get_def_use_footprint(_uses);
+    bytes += _operands_ssa.get_memory_footprint();
+    bytes += footprint_vector(_def_use_index.definitions);
+    bytes += footprint_vector(_def_use_index.uses);
+    bytes += footprint_vector(_instructions_ssa_by_id);
+    bytes += footprint_vector(_return_summary.ret_instrs);
+    bytes += footprint_vector(_return_summary.tail_jmps);
+    return bytes;
+}
+
 const BlockVector &Function::get_ret_blocks() const {
+    ensure_lifted();
     return _blocks_ret;
 }
 
 const BlockVector &Function::get_tail_jmp_blocks() const {
+    ensure_lifted();
     return _blocks_tail_jmp;
 }
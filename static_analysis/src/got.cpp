@@ -1,7 +1,46 @@
 #include "got.h"
+#include "mapped_elf.h"
+
+#include <algorithm>
 
 using namespace std;
 
+GotMap::GotMap(vector<GotEntry> entries) {
+    stable_sort(entries.begin(),
+                entries.end(),
+                [](const GotEntry &a, const GotEntry &b) {
+                    return a.addr < b.addr;
+                });
+    for(const GotEntry &entry : entries) {
+        if(!_entries.empty() && _entries.back().addr == entry.addr) {
+            _entries.back() = entry;
+            continue;
+        }
+        _entries.push_back(entry);
+    }
+}
+
+const GotEntry *GotMap::find(uint64_t addr) const {
+
+    // Most queried constants are not even close to the .got section.
+    if(_entries.empty()
+       || addr < _entries.front().addr
+       || addr > _entries.back().addr) {
+        return nullptr;
+    }
+
+    const auto it = lower_bound(_entries.cbegin(),
+                                _entries.cend(),
+                                addr,
+                                [](const GotEntry &entry, uint64_t value) {
+                                    return entry.addr < value;
+                                });
+    if(it == _entries.cend() || it->addr != addr) {
+        return nullptr;
+    }
+    return &(*it);
+}
+
 GotMap import_got(const string &target_file) {
 
     ifstream file(target_file + "_got.txt");
@@ -22,25 +61,55 @@ GotMap import_got(const string &target_file) {
         throw runtime_error("Parsing .got file failed.");
     }
 
-    GotMap got_map;
+    vector<GotEntry> entries;
 
     while(getline(file, line)) {
         istringstream parser(line);
-        uint64_t got_entry_addr = 0;
-        uint64_t got_entry_content = 0;
+        GotEntry entry;
 
-        parser >> hex >> got_entry_addr;
+        parser >> hex >> entry.addr;
         if(parser.fail()) {
             throw runtime_error("Parsing .got file failed.");
         }
 
-        parser >> hex >> got_entry_content;
+        parser >> hex >> entry.content;
         if(parser.fail()) {
             throw runtime_error("Parsing .got file failed.");
         }
 
-        got_map[got_entry_addr] = got_entry_content;
+        entries.push_back(entry);
+    }
+
+    return GotMap(move(entries));
+}
+
+GotMap import_got(const MappedElf &elf) {
+
+    const ElfW(Shdr) *got = elf.get_section(".got");
+    if(got == nullptr) {
+        throw runtime_error("Module has no .got section.");
+    }
+
+    // The exporter considers the .got segment of IDA, which also contains
+    // the .got.plt entries if the linker created that section.
+    vector<GotEntry> entries;
+    for(const ElfW(Shdr) *section : { got, elf.get_section(".got.plt") }) {
+        if(section == nullptr) {
+            continue;
+        }
+        const uint8_t *data = elf.get_section_data(*section);
+        if(data == nullptr) {
+            throw runtime_error("Malformed .got section.");
+        }
+        for(uint64_t offset = 0;
+            offset + sizeof(uint64_t) <= section->sh_size;
+            offset += sizeof(uint64_t)) {
+            GotEntry entry;
+            entry.addr = section->sh_addr + offset;
+            memcpy(&entry.content, data + offset, sizeof(entry.content));
+            entries.push_back(entry);
+        }
     }
 
-    return got_map;
+    return GotMap(move(entries));
 }
@@ -0,0 +1,315 @@
+#include "graph_capture.h"
+
+#include <iostream>
+#include <iterator>
+#include <cstring>
+
+using namespace std;
+
+GraphCapture &GraphCapture::get_instance() {
+    static GraphCapture instance;
+    return instance;
+}
+
+bool GraphCapture::start(uint32_t stages,
+                         const unordered_set<uint64_t> &start_addrs,
+                         const string &target_dir,
+                         const string &module_name) {
+    finish();
+    _stages = 0;
+    if(stages == 0) {
+        return true;
+    }
+
+    _file_name = target_dir + "/" + module_name + ".marx_graphs";
+    _file.open(_file_name, ios::binary | ios::trunc);
+    _file.write(GRAPH_CAPTURE_MAGIC, 8);
+    uint64_t version = GRAPH_CAPTURE_VERSION;
+    _file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    if(!_file) {
+        cerr << "Not able to open graph capture file '"
+             << _file_name
+             << "'."
+             << "\n";
+        _file.close();
+        return false;
+    }
+
+    _start_addrs = start_addrs;
+    _string_ids.clear();
+    _stop = false;
+    _chunk.reserve(GRAPH_CAPTURE_CHUNK_SIZE);
+    _writer = thread(&GraphCapture::writer_main, this);
+    _stages = stages;
+    return true;
+}
+
+void GraphCapture::writer_main() {
+    unique_lock<mutex> lock(_mtx);
+    while(true) {
+        _cv_writer.wait(lock, [&] {
+            return _stop || !_pending_chunks.empty();
+        });
+        if(_pending_chunks.empty()) {
+            return;
+        }
+
+        // Write without holding the lock so producers can keep appending.
+        string chunk = move(_pending_chunks.front());
+        _pending_chunks.pop_front();
+        _cv_producers.notify_all();
+        lock.unlock();
+        _file.write(chunk.data(), chunk.size());
+        lock.lock();
+    }
+}
+
+// Values are stored as unsigned LEB128.
+void GraphCapture::append_value(uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if(value) {
+            byte |= 0x80;
+        }
+        _chunk.push_back(static_cast<char>(byte));
+    } while(value);
+}
+
+uint64_t GraphCapture::append_string(const string &value) {
+    const auto it = _string_ids.find(value);
+    if(it != _string_ids.cend()) {
+        return it->second;
+    }
+    uint64_t string_id = _string_ids.size();
+    _string_ids[value] = string_id;
+
+    _chunk.push_back(static_cast<char>(GraphRecordString));
+    append_value(string_id);
+    append_value(value.size());
+    _chunk.append(value);
+    return string_id;
+}
+
+void GraphCapture::add_graph(const GraphCaptureRecord &record) {
+    if(!_stages) {
+        return;
+    }
+
+    // The labels are interned first, hence their records precede the graph.
+    unique_lock<mutex> lock(_mtx);
+    vector<uint64_t> ids;
+    ids.reserve(2 + 2 * record.nodes.size() + 2 * record.edges.size());
+    ids.push_back(append_string(record.analysis));
+    ids.push_back(append_string(record.operand));
+    for(const GraphCaptureNode &node : record.nodes) {
+        ids.push_back(append_string(node.label));
+        ids.push_back(append_string(node.comment));
+    }
+    for(const GraphCaptureEdge &edge : record.edges) {
+        ids.push_back(append_string(edge.label));
+        ids.push_back(append_string(edge.comment));
+    }
+
+    size_t idx = 0;
+    _chunk.push_back(static_cast<char>(GraphRecordGraph));
+    append_value(ids[idx++]);
+    append_value(record.start_addr);
+    append_value(record.round);
+    append_value(record.stage);
+    append_value(record.tracking_type);
+    append_value(record.function_addr);
+    append_value(record.instr_addr);
+    append_value(ids[idx++]);
+    append_value(record.nodes.size());
+    for(const GraphCaptureNode &node : record.nodes) {
+        append_value(ids[idx++]);
+        append_value(ids[idx++]);
+        append_value(node.type);
+        append_value(node.is_join);
+    }
+    append_value(record.edges.size());
+    for(const GraphCaptureEdge &edge : record.edges) {
+        append_value(edge.src);
+        append_value(edge.dst);
+        append_value(edge.type);
+        append_value(ids[idx++]);
+        append_value(ids[idx++]);
+    }
+
+    // Hand the chunk to the writer thread once it is full.
+    if(_chunk.size() < GRAPH_CAPTURE_CHUNK_SIZE) {
+        return;
+    }
+    _cv_producers.wait(lock, [&] {
+        return _pending_chunks.size() < GRAPH_CAPTURE_MAX_PENDING_CHUNKS;
+    });
+    _pending_chunks.push_back(move(_chunk));
+    _chunk = string();
+    _chunk.reserve(GRAPH_CAPTURE_CHUNK_SIZE);
+    _cv_writer.notify_one();
+}
+
+bool GraphCapture::finish() {
+    if(!_writer.joinable()) {
+        return true;
+    }
+
+    _mtx.lock();
+    _stages = 0;
+    if(!_chunk.empty()) {
+        _pending_chunks.push_back(move(_chunk));
+        _chunk = string();
+    }
+    _stop = true;
+    _mtx.unlock();
+    _cv_writer.notify_one();
+    _writer.join();
+
+    _file.close();
+    if(_file.fail()) {
+        cerr << "Not able to write graph capture file '"
+             << _file_name
+             << "'."
+             << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Decoding of the records (`pos` is advanced past the read value).
+static bool read_capture_value(const string &data,
+                               size_t &pos,
+                               uint64_t &value) {
+    value = 0;
+    for(uint32_t shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+        const uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if(!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename T>
+static bool read_capture(const string &data, size_t &pos, T &value) {
+    uint64_t temp;
+    if(!read_capture_value(data, pos, temp)) {
+        return false;
+    }
+    value = static_cast<T>(temp);
+    return true;
+}
+
+static bool read_capture_string_id(const string &data,
+                                   size_t &pos,
+                                   const vector<string> &strings,
+                                   string &value) {
+    uint64_t id;
+    if(!read_capture_value(data, pos, id) || id >= strings.size()) {
+        return false;
+    }
+    value = strings[id];
+    return true;
+}
+
+static bool read_capture_graph(const string &data,
+                               size_t &pos,
+                               const vector<string> &strings,
+                               GraphCaptureRecord &record) {
+    uint64_t num_nodes;
+    if(!read_capture_string_id(data, pos, strings, record.analysis)
+       || !read_capture(data, pos, record.start_addr)
+       || !read_capture(data, pos, record.round)
+       || !read_capture(data, pos, record.stage)
+       || !read_capture(data, pos, record.tracking_type)
+       || !read_capture(data, pos, record.function_addr)
+       || !read_capture(data, pos, record.instr_addr)
+       || !read_capture_string_id(data, pos, strings, record.operand)
+       || !read_capture_value(data, pos, num_nodes)) {
+        return false;
+    }
+    for(uint64_t i = 0; i < num_nodes; i++) {
+        GraphCaptureNode node;
+        if(!read_capture_string_id(data, pos, strings, node.label)
+           || !read_capture_string_id(data, pos, strings, node.comment)
+           || !read_capture(data, pos, node.type)
+           || !read_capture(data, pos, node.is_join)) {
+            return false;
+        }
+        record.nodes.push_back(move(node));
+    }
+
+    uint64_t num_edges;
+    if(!read_capture_value(data, pos, num_edges)) {
+        return false;
+    }
+    for(uint64_t i = 0; i < num_edges; i++) {
+        GraphCaptureEdge edge;
+        if(!read_capture(data, pos, edge.src)
+           || !read_capture(data, pos, edge.dst)
+           || !read_capture(data, pos, edge.type)
+           || !read_capture_string_id(data, pos, strings, edge.label)
+           || !read_capture_string_id(data, pos, strings, edge.comment)
+           || edge.src >= num_nodes
+           || edge.dst >= num_nodes) {
+            return false;
+        }
+        record.edges.push_back(move(edge));
+    }
+    return true;
+}
+
+bool read_graph_capture(
+                 const string &file_name,
+                 const function<void (const GraphCaptureRecord&)> &callback) {
+    ifstream file(file_name, ios::binary);
+    if(!file) {
+        return false;
+    }
+    const string data((istreambuf_iterator<char>(file)),
+                      istreambuf_iterator<char>());
+
+    uint64_t version = 0;
+    if(data.size() < 8 + sizeof(version)
+       || memcmp(data.data(), GRAPH_CAPTURE_MAGIC, 8) != 0) {
+        return false;
+    }
+    memcpy(&version, data.data() + 8, sizeof(version));
+    if(version != GRAPH_CAPTURE_VERSION) {
+        return false;
+    }
+
+    vector<string> strings;
+    size_t pos = 8 + sizeof(version);
+    while(pos < data.size()) {
+        const uint8_t type = static_cast<uint8_t>(data[pos++]);
+        switch(type) {
+            case GraphRecordString: {
+                uint64_t id;
+                uint64_t size;
+                if(!read_capture_value(data, pos, id)
+                   || id != strings.size()
+                   || !read_capture_value(data, pos, size)
+                   || size > data.size() - pos) {
+                    return false;
+                }
+                strings.push_back(data.substr(pos, size));
+                pos += size;
+                break;
+            }
+            case GraphRecordGraph: {
+                GraphCaptureRecord record;
+                if(!read_capture_graph(data, pos, strings, record)) {
+                    return false;
+                }
+                callback(record);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "icall_analysis.h"
+#include "def_use_cache.h"
 
 using namespace std;
 
@@ -152,18 +153,15 @@ void ICallAnalysis::post_augment_use(GraphDataFlow &graph,
                                      InstrGraphNodeMap &instr_graph_node_map,
                                      const Function &function,
                                      const OperandSSAPtr &initial_use,
-                                     const BaseInstructionSSAPtr &initial_instr,
+                                     const BaseInstructionSSAPtr&,
                                      const TrackingInstruction&) {
 
-    // Remove all unnecessary nodes from the current graph.
-    remove_unnecessary_nodes(graph,
-                             instr_graph_node_map,
-                             initial_use,
-                             initial_instr);
+    // Unnecessary nodes were already left out by `augment_use()`
+    // (see `is_def_use_step_relevant()`).
 
     // Add artificial nodes for a call from a vtable.
     uint64_t func_addr = function.get_entry();
-    if(_this_vtable_entries.find(func_addr) != _this_vtable_entries.cend()) {
+    if(_vtables.is_this_vtable_entry(func_addr)) {
         add_vtable_call_nodes(graph,
                               instr_graph_node_map,
                               function,
@@ -346,152 +344,49 @@ void ICallAnalysis::add_vtable_call_nodes(
     }
 }
 
-void ICallAnalysis::remove_unnecessary_nodes(
-                                   GraphDataFlow &graph,
-                                   InstrGraphNodeMap &instr_graph_node_map,
-                                   const OperandSSAPtr &initial_use,
-                                   const BaseInstructionSSAPtr &initial_instr) {
-
-    // Change initial node type to `start`.
-    GraphDataFlow::vertex_descriptor initial_node = get_node_graph(
-                                                           graph,
-                                                           instr_graph_node_map,
-                                                           initial_instr);
-
-    // Remove all incoming edges to the initial instruction that do not contain
-    // the operand we are tracking currently and remove all outgoing edges
-    // of the initial instruction.
-    {
-        auto in_edges = boost::in_edges(initial_node, graph);
-        for(auto it = in_edges.first; it != in_edges.second;) {
-            // Check both ways, if incoming edge contains the initial operand
-            // or if the initial operand contains the incoming edge
-            // (the latter can happen when we have "call [r15_6]#98" and an
-            // incoming edge with r15_6).
-            if(graph[*it].operand->contains_coarse(*initial_use)
-               || initial_use->contains_coarse(*graph[*it].operand)) {
-                ++it;
-            }
-            else {
-                GraphDataFlow::edge_descriptor temp = *it;
-                ++it;
-                boost::remove_edge(temp, graph);
-                in_edges = boost::in_edges(initial_node, graph);
-            }
-        }
-
-        auto out_edges = boost::out_edges(initial_node, graph);
-        while(out_edges.first != out_edges.second) {
-            boost::remove_edge(*(out_edges.first), graph);
-            out_edges = boost::out_edges(initial_node, graph);
-        }
-    }
-
-    // "call" instructions are the artificial boundary which end the
-    // data flow backtracing. Remove all incoming edges of a "call"
-    // instruction.
-    // Also, filter out certain instructions.
-    auto vertices = boost::vertices(graph);
-    for(auto it = vertices.first; it != vertices.second;) {
-        GraphDataFlow::vertex_descriptor curr_node = *it;
-        ++it;
-        if(graph[curr_node].instr->is_call()) {
-
-            // Ignore the initial instruction since we want to
-            // trace its data backwards.
-            if(curr_node == initial_node) {
-                continue;
-            }
-
-            // Remove incoming edges.
-            auto in_edges = boost::in_edges(curr_node, graph);
-            while(in_edges.first != in_edges.second) {
-                boost::remove_edge(*(in_edges.first), graph);
-                in_edges = boost::in_edges(curr_node, graph);
-            }
-        }
+// Xor instructions that null the definition like xor rcx_14 rcx_13 rcx_13.
+static bool is_null_xor(const BaseInstructionSSA &instr) {
+    return instr.get_mnemonic() == "xor" // TODO architecture specific
+           && *instr.get_operand(1) == *instr.get_operand(2);
+}
 
-        // Filter out certain instructions.
-        else {
-            const BaseInstructionSSAPtr &instr = graph[curr_node].instr;
+bool ICallAnalysis::prune_during_augment_use() const {
+    return true;
+}
 
-            // Remove xor instruction that null the definition like
-            // xor rcx_14 rcx_13 rcx_13
-            if(instr->get_mnemonic() == "xor" // TODO architecture specific
-               && *instr->get_operand(1) == *instr->get_operand(2)) {
+bool ICallAnalysis::is_def_use_step_relevant(
+                             const DefUseStep &step,
+                             const OperandSSAPtr &initial_use,
+                             const BaseInstructionSSAPtr &initial_instr) const {
 
-                // Incoming and outgoing edges are handled by removing process.
-                remove_node_graph(graph, instr_graph_node_map, curr_node);
-            }
-        }
+    // Remove all outgoing edges of the initial instruction.
+    if(*step.def_instr == *initial_instr) {
+        return false;
     }
 
-    // Remove all leaf nodes that are not the source from which we started.
-    unordered_set<GraphDataFlow::vertex_descriptor> to_remove;
-    bool changed = true;
-    while(changed) {
-        changed = false;
-        to_remove.clear();
-        vertices = boost::vertices(graph);
-        for(auto it = vertices.first; it != vertices.second; ++it) {
-            // Ignore the initial instruction.
-            if(*it == initial_node) {
-                continue;
-            }
-
-            // Mark node for removal that does not have outgoing edges.
-            const auto edges = boost::out_edges(*it, graph);
-            if(edges.first == edges.second) {
-                to_remove.insert(*it);
-                changed = true;
-            }
-        }
-
-        // Remove all nodes and their incoming edges.
-        for(const auto vertex : to_remove) {
-            remove_node_graph(graph, instr_graph_node_map, vertex);
-        }
+    // Filter out certain instructions.
+    if(is_null_xor(*step.def_instr)) {
+        return false;
     }
 
-    // Check if each node has a path to the initial node.
-    // If it does not have one then we have a component in the graph that
-    // is not connected to the main component we are searching for. Remove
-    // these nodes.
-    vertices = boost::vertices(graph);
-    to_remove.clear();
-    boost::property_map<GraphDataFlow, boost::vertex_index_t>::type indexmap =
-                                                         create_indexmap(graph);
-    for(auto it = vertices.first; it != vertices.second; ++it) {
-
-        // Ignore nodes that do not reach the initial node.
-        if(to_remove.find(*it) != to_remove.end()) {
-            continue;
-        }
-
-        // Bfs visitor is passed by value. To keep the state we have to
-        // work on references.
-        // http://www.boost.org/doc/libs/1_50_0/libs/graph/doc/breadth_first_search.html#1
-        DataFlowVertexSet visited;
-        BfsGraphDataFlowNodesVisited vis(visited);
-
-        // Last argument uses bgl_named_params:
-        // http://www.boost.org/doc/libs/1_58_0/libs/graph/doc/bgl_named_params.html
-        // => argument "visitor" and "vertex_index_map" are passed.
-        boost::breadth_first_search(graph,
-                                    *it,
-                                    visitor(vis).vertex_index_map(indexmap));
-
-        // When the bfs did not visit the initial node,
-        // it has no path to the initial node and thus can be removed.
-        if(visited.find(initial_node) == visited.end()) {
-            to_remove.insert(visited.begin(), visited.end());
-        }
+    // Remove all incoming edges to the initial instruction that do not
+    // contain the operand we are tracking currently. Check both ways, if
+    // incoming edge contains the initial operand or if the initial operand
+    // contains the incoming edge (the latter can happen when we have
+    // "call [r15_6]#98" and an incoming edge with r15_6).
+    if(*step.use_instr == *initial_instr) {
+        return step.operand->contains_coarse(*initial_use)
+               || initial_use->contains_coarse(*step.operand);
     }
 
-    // Remove all nodes and their incoming edges.
-    for(const auto vertex : to_remove) {
-        remove_node_graph(graph, instr_graph_node_map, vertex);
+    // "call" instructions are the artificial boundary which end the
+    // data flow backtracing. Remove all incoming edges of a "call"
+    // instruction.
+    if(step.use_instr->is_call()) {
+        return false;
     }
+
+    return !is_null_xor(*step.use_instr);
 }
 
 bool ICallAnalysis::mark_node_vtable(GraphDataFlow &graph,
@@ -520,7 +415,7 @@ bool ICallAnalysis::mark_node_vtable(GraphDataFlow &graph,
                     throw runtime_error("Unknown SSA constant object.");
             }
 
-            if(_this_vtables.find(vtbl_candidate) != _this_vtables.cend()) {
+            if(_vtables.is_this_vtable(vtbl_candidate)) {
                 graph[node].type = DataFlowNodeTypeVtable;
                 return true;
             }
@@ -680,8 +575,7 @@ void ICallAnalysis::incorporate_vtable_xref_graph(
                                 visitor(vis).vertex_index_map(indexmap));
 
     // Copy nodes to new graph.
-    map<GraphDataFlow::vertex_descriptor, GraphDataFlow::vertex_descriptor>
-                                                                    old_new_map;
+    NodeToNodeMap old_new_map;
     const auto vertices = boost::vertices(graph);
     for(auto it = vertices.first; it != vertices.second; ++it) {
         // Only copy nodes into the new graph that were reachable by the BFS.
@@ -1,4 +1,8 @@
 #include "icalls.h"
+#include "mapped_file.h"
+#include "address_list_file.h"
+
+#include <stdexcept>
 
 using namespace std;
 
@@ -39,3 +43,56 @@ ICallSet import_icalls(const string &target_file) {
     return icall_set;
 }
 
+
+bool import_dynamic_vcalls(const string &feedback_dir,
+                           const string &module_name,
+                           ICallSet &vcalls) {
+    vcalls.clear();
+
+    const string base_file = feedback_dir + "/" + module_name
+                             + "_dynamic_vcalls";
+    const string binary_file = base_file + ADDRESS_LIST_FILE_EXTENSION;
+    if(MappedFile::exists(binary_file)) {
+        MappedFile mapped_file(binary_file);
+        string import_module_name;
+        const uint64_t *addresses;
+        uint64_t count;
+        if(!parse_address_list(mapped_file.data(),
+                               mapped_file.size(),
+                               import_module_name,
+                               addresses,
+                               count)
+           || import_module_name != module_name) {
+            throw runtime_error("Parsing '_dynamic_vcalls' file failed.");
+        }
+        vcalls.insert(addresses, addresses + count);
+        return true;
+    }
+
+    ifstream file(base_file + ".txt");
+    if(!file) {
+        return false;
+    }
+
+    string line;
+    getline(file, line);
+    istringstream header_parser(line);
+    string import_module_name;
+    header_parser >> import_module_name;
+    if(header_parser.fail() || import_module_name != module_name) {
+        throw runtime_error("Parsing '_dynamic_vcalls' file failed.");
+    }
+
+    while(getline(file, line)) {
+        istringstream parser(line);
+        uint64_t vcall_addr = 0;
+
+        parser >> hex >> vcall_addr;
+        if(parser.fail()) {
+            throw runtime_error("Parsing '_dynamic_vcalls' file failed.");
+        }
+
+        vcalls.insert(vcall_addr);
+    }
+    return true;
+}
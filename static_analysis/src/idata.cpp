@@ -1,7 +1,57 @@
 #include "idata.h"
+#include "mapped_pe.h"
+
+#include <algorithm>
 
 using namespace std;
 
+// Entry of the import directory.
+struct ImportDescriptor {
+    uint32_t import_lookup_table;
+    uint32_t time_date_stamp;
+    uint32_t forwarder_chain;
+    uint32_t name;
+    uint32_t import_address_table;
+};
+
+#define IMPORT_BY_ORDINAL_FLAG (1ULL << 63)
+
+IDataMap::IDataMap(vector<IDataEntry> entries) {
+    stable_sort(entries.begin(),
+                entries.end(),
+                [](const IDataEntry &a, const IDataEntry &b) {
+                    return a.addr < b.addr;
+                });
+    for(IDataEntry &entry : entries) {
+        if(!_entries.empty() && _entries.back().addr == entry.addr) {
+            _entries.back() = move(entry);
+            continue;
+        }
+        _entries.push_back(move(entry));
+    }
+}
+
+const IDataEntry *IDataMap::find(uint64_t addr) const {
+
+    // Most queried constants are not even close to the .idata section.
+    if(_entries.empty()
+       || addr < _entries.front().addr
+       || addr > _entries.back().addr) {
+        return nullptr;
+    }
+
+    const auto it = lower_bound(_entries.cbegin(),
+                                _entries.cend(),
+                                addr,
+                                [](const IDataEntry &entry, uint64_t value) {
+                                    return entry.addr < value;
+                                });
+    if(it == _entries.cend() || it->addr != addr) {
+        return nullptr;
+    }
+    return &(*it);
+}
+
 IDataMap import_idata(const string &target_file) {
 
     ifstream file(target_file + "_idata.txt");
@@ -22,25 +72,105 @@ IDataMap import_idata(const string &target_file) {
         throw runtime_error("Parsing .idata file failed.");
     }
 
-    IDataMap idata_map;
+    vector<IDataEntry> entries;
 
     while(getline(file, line)) {
         istringstream parser(line);
-        uint64_t idata_entry_addr = 0;
-        string idata_entry_content;
+        IDataEntry entry;
 
-        parser >> hex >> idata_entry_addr;
+        parser >> hex >> entry.addr;
         if(parser.fail()) {
             throw runtime_error("Parsing .idata file failed.");
         }
 
-        parser >> idata_entry_content;
+        parser >> entry.name;
         if(parser.fail()) {
             throw runtime_error("Parsing .idata file failed.");
         }
 
-        idata_map[idata_entry_addr] = idata_entry_content;
+        entries.push_back(move(entry));
+    }
+
+    return IDataMap(move(entries));
+}
+
+// Reads a C-like string at the given relative virtual address.
+static bool read_rva_string(const MappedPe &pe, uint32_t rva, string &str) {
+    str.clear();
+    while(true) {
+        const uint8_t *data = pe.get_rva_data(rva, 1);
+        if(data == nullptr) {
+            return false;
+        }
+        if(*data == 0) {
+            return true;
+        }
+        str.push_back(static_cast<char>(*data));
+        rva++;
+    }
+}
+
+IDataMap import_idata(const MappedPe &pe) {
+
+    const data_directory *directory = pe.get_data_directory();
+    if(directory == nullptr) {
+        throw runtime_error("Module has no data directory.");
+    }
+
+    vector<IDataEntry> entries;
+    uint32_t descriptor_rva = directory->imports.virtual_address;
+    if(descriptor_rva == 0) {
+        return IDataMap();
+    }
+
+    // The import directory is terminated by an empty descriptor.
+    while(true) {
+        const auto *descriptor = reinterpret_cast<const ImportDescriptor*>(
+                    pe.get_rva_data(descriptor_rva, sizeof(ImportDescriptor)));
+        if(descriptor == nullptr) {
+            throw runtime_error("Malformed import directory.");
+        }
+        if(descriptor->import_address_table == 0) {
+            break;
+        }
+
+        // The names are taken from the lookup table since the address
+        // table can already be bound. Without lookup table, the address
+        // table in the file contains the same values.
+        uint32_t lookup_rva = descriptor->import_lookup_table
+                              ? descriptor->import_lookup_table
+                              : descriptor->import_address_table;
+        for(uint32_t i = 0; ; i++) {
+            const uint8_t *lookup_data = pe.get_rva_data(
+                                            lookup_rva + i * sizeof(uint64_t),
+                                            sizeof(uint64_t));
+            if(lookup_data == nullptr) {
+                throw runtime_error("Malformed import lookup table.");
+            }
+            uint64_t lookup;
+            memcpy(&lookup, lookup_data, sizeof(lookup));
+            if(lookup == 0) {
+                break;
+            }
+
+            IDataEntry entry;
+            entry.addr = descriptor->import_address_table
+                         + i * sizeof(uint64_t);
+            if(lookup & IMPORT_BY_ORDINAL_FLAG) {
+                entry.name = "Ordinal_" + to_string(lookup & 0xffff);
+            }
+
+            // Name entries start with a 2 byte hint.
+            else if(!read_rva_string(pe,
+                                     static_cast<uint32_t>(lookup) + 2,
+                                     entry.name)) {
+                throw runtime_error("Malformed import name.");
+            }
+            entries.push_back(move(entry));
+        }
+
+        descriptor_rva += sizeof(ImportDescriptor);
     }
 
-    return idata_map;
+    return IDataMap(move(entries));
 }
@@ -0,0 +1,384 @@
+#include "incremental_state.h"
+#include "vcall.h"
+#include "object_allocations.h"
+
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+IncrementalState::IncrementalState(const string &target_file,
+                                   const Translator &translator,
+                                   const VTableFile &vtable_file)
+    : _state_file(target_file + ".marx_incremental"),
+      _translator(translator),
+      _vtable_file(vtable_file) {
+}
+
+// Hashes the SSA data of all functions (64 bit FNV-1a over the textual
+// representation of all SSA instructions).
+void IncrementalState::compute_function_hashes() {
+    _function_hashes.clear();
+    for(const auto &kv : _translator.get_functions()) {
+        stringstream function_str;
+        for(const auto &kv_block : kv.second.get_blocks_ssa()) {
+            function_str << hex << kv_block.first << "\n";
+            for(const auto &instr : kv_block.second->get_instructions()) {
+                function_str << *instr << "\n";
+            }
+        }
+
+        const string data = function_str.str();
+        uint64_t hash = 0xcbf29ce484222325;
+        for(char c : data) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3;
+        }
+        _function_hashes[kv.first] = hash;
+    }
+}
+
+// Marks all changed or new functions and their direct callers and callees
+// as affected.
+// NOTE: Effects of a change that reach further along the call graph
+// (for example, a changed return value that is passed on by an unchanged
+// caller) are not considered.
+void IncrementalState::compute_affected_functions(
+                         const unordered_map<uint64_t, uint64_t> &prev_hashes) {
+
+    const map<uintptr_t, Function> &functions = _translator.get_functions();
+    for(const auto &kv : _function_hashes) {
+        const auto prev_it = prev_hashes.find(kv.first);
+        if(prev_it != prev_hashes.cend() && prev_it->second == kv.second) {
+            continue;
+        }
+
+        const Function &function = functions.at(kv.first);
+        _affected_functions.insert(kv.first);
+
+        // Callers of the function.
+        for(uint64_t xref_addr : function.get_xrefs()) {
+            try {
+                const Function &caller =
+                          _translator.get_containing_function(xref_addr);
+                _affected_functions.insert(caller.get_entry());
+            }
+            catch(...) {
+            }
+        }
+
+        // Callees of the function (including tail jumps).
+        for(const auto &kv_block : function.get_blocks()) {
+            const Terminator &terminator = kv_block.second->get_terminator();
+            if(terminator.type != TerminatorCall
+               && !(terminator.type == TerminatorJump && terminator.is_tail)) {
+                continue;
+            }
+            if(functions.find(terminator.target) != functions.cend()) {
+                _affected_functions.insert(terminator.target);
+            }
+        }
+    }
+}
+
+bool IncrementalState::import_state_priv(
+                           uint64_t context_hash,
+                           unordered_map<uint64_t, uint64_t> &prev_hashes,
+                           IncrementalResults &prev_results,
+                           unordered_set<uint64_t> &prev_possible_vcalls,
+                           IncrementalObjectAllocations &prev_obj_allocs) {
+
+    CompanionFileReader reader(_state_file);
+    if(!reader.is_valid(CompanionFileIncremental, context_hash)) {
+        return false;
+    }
+
+    uint64_t num_modules;
+    if(!reader.read(num_modules)) {
+        return false;
+    }
+    vector<VTableModuleId> module_ids(num_modules);
+    for(uint64_t i = 0; i < num_modules; i++) {
+        string module_name;
+        if(!reader.read_string(module_name)) {
+            return false;
+        }
+        module_ids[i] = _vtable_file.get_module_id(module_name);
+    }
+
+    // Vtables are stored as module id followed by vtable address,
+    // returns `nullptr` if the vtable does not exist anymore.
+    auto get_vtable = [&](uint64_t module_id,
+                          uint64_t vtable_addr) -> const VTable* {
+        if(module_id >= num_modules) {
+            return nullptr;
+        }
+        return _vtable_file.get_vtable_ptr(module_ids[module_id],
+                                           vtable_addr);
+    };
+
+    // Each function is stored as address followed by its hash.
+    const uint64_t *values;
+    uint64_t count;
+    if(!reader.read_array(values, count) || count % 2) {
+        return false;
+    }
+    for(uint64_t i = 0; i < count; i += 2) {
+        prev_hashes[values[i]] = values[i + 1];
+    }
+
+    // Each result is stored as icall address, vtable and entry index.
+    if(!reader.read_array(values, count) || count % 4) {
+        return false;
+    }
+    for(uint64_t i = 0; i < count; i += 4) {
+        const VTable *vtable = get_vtable(values[i + 1], values[i + 2]);
+        if(vtable == nullptr) {
+            return false;
+        }
+        IncrementalResult result;
+        result.icall_addr = values[i];
+        result.vtable_idx = vtable->index;
+        result.entry_idx = values[i + 3];
+        prev_results.push_back(result);
+    }
+
+    if(!reader.read_array(values, count)) {
+        return false;
+    }
+    prev_possible_vcalls.insert(values, values + count);
+
+    uint64_t num_obj_allocs;
+    if(!reader.read(num_obj_allocs)) {
+        return false;
+    }
+    prev_obj_allocs.resize(num_obj_allocs);
+    for(uint64_t i = 0; i < num_obj_allocs; i++) {
+        IncrementalObjectAllocation &obj_alloc = prev_obj_allocs[i];
+        if(!reader.read(obj_alloc.addr)
+           || !reader.read_array(values, count)
+           || count % 2) {
+            return false;
+        }
+        for(uint64_t j = 0; j < count; j += 2) {
+            const VTable *vtable = get_vtable(values[j], values[j + 1]);
+            if(vtable == nullptr) {
+                return false;
+            }
+            obj_alloc.vtbl_idxs.push_back(vtable->index);
+        }
+
+        if(!reader.read_array(values, count)) {
+            return false;
+        }
+        obj_alloc.vtbl_xref_addrs.assign(values, values + count);
+    }
+
+    return true;
+}
+
+bool IncrementalState::import_state(uint64_t context_hash) {
+
+    _is_incremental = false;
+    _affected_functions.clear();
+    _affected_icalls.clear();
+    _affected_vtables.clear();
+    _cached_results.clear();
+    _cached_possible_vcalls.clear();
+    _cached_obj_allocs.clear();
+    compute_function_hashes();
+
+    if(!MappedFile::exists(_state_file)) {
+        return false;
+    }
+
+    unordered_map<uint64_t, uint64_t> prev_hashes;
+    IncrementalResults prev_results;
+    unordered_set<uint64_t> prev_possible_vcalls;
+    IncrementalObjectAllocations prev_obj_allocs;
+    if(!import_state_priv(context_hash,
+                          prev_hashes,
+                          prev_results,
+                          prev_possible_vcalls,
+                          prev_obj_allocs)) {
+        return false;
+    }
+
+    // From here on `is_affected` considers the affected functions.
+    _is_incremental = true;
+    compute_affected_functions(prev_hashes);
+
+    // Vtables referenced from affected functions.
+    for(const auto &kv : _vtable_file.get_this_vtables()) {
+        const VTable &vtable = *kv.second;
+        for(uint64_t xref_addr : vtable.xrefs) {
+            if(is_affected(xref_addr)) {
+                _affected_vtables.insert(vtable.index);
+            }
+        }
+        for(const auto &kv_xref : vtable.indirect_xrefs) {
+            for(uint64_t xref_addr : kv_xref.second) {
+                if(is_affected(xref_addr)) {
+                    _affected_vtables.insert(vtable.index);
+                }
+            }
+        }
+    }
+
+    // All results of an icall are dropped as soon as one of them is
+    // not valid anymore.
+    for(const IncrementalResult &result : prev_results) {
+        if(is_affected(result.icall_addr)
+           || _affected_vtables.find(result.vtable_idx)
+              != _affected_vtables.cend()) {
+            _affected_icalls.insert(result.icall_addr);
+        }
+    }
+    for(const IncrementalResult &result : prev_results) {
+        if(_affected_icalls.find(result.icall_addr)
+           != _affected_icalls.cend()) {
+
+            // The xrefs of the vtables of dropped results have to be
+            // analyzed again in order to re-analyze the icall.
+            _affected_vtables.insert(result.vtable_idx);
+            continue;
+        }
+        _cached_results.push_back(result);
+    }
+
+    for(uint64_t possible_vcall : prev_possible_vcalls) {
+        if(!is_affected_icall(possible_vcall)) {
+            _cached_possible_vcalls.insert(possible_vcall);
+        }
+    }
+
+    // The vtable pointer init instruction resides in the same function
+    // as the vtable xrefs it was found for.
+    for(IncrementalObjectAllocation &obj_alloc : prev_obj_allocs) {
+        if(!is_affected(obj_alloc.addr)) {
+            _cached_obj_allocs.push_back(move(obj_alloc));
+        }
+    }
+
+    cout << "Incremental analysis: "
+         << dec << _affected_functions.size()
+         << " of "
+         << dec << _function_hashes.size()
+         << " functions affected, "
+         << dec << _cached_results.size()
+         << " vcall results reused."
+         << "\n";
+
+    return true;
+}
+
+bool IncrementalState::is_incremental() const {
+    return _is_incremental;
+}
+
+bool IncrementalState::is_affected(uint64_t addr) const {
+    if(!_is_incremental) {
+        return true;
+    }
+    try {
+        const Function &function = _translator.get_containing_function(addr);
+        return _affected_functions.find(function.get_entry())
+               != _affected_functions.cend();
+    }
+    catch(...) {
+        return true;
+    }
+}
+
+bool IncrementalState::is_affected_icall(uint64_t icall_addr) const {
+    return is_affected(icall_addr)
+           || _affected_icalls.find(icall_addr) != _affected_icalls.cend();
+}
+
+bool IncrementalState::is_affected_vtable(uint32_t vtable_idx) const {
+    return !_is_incremental
+           || _affected_vtables.find(vtable_idx) != _affected_vtables.cend();
+}
+
+const IncrementalResults &IncrementalState::get_cached_results() const {
+    return _cached_results;
+}
+
+const unordered_set<uint64_t> &
+                         IncrementalState::get_cached_possible_vcalls() const {
+    return _cached_possible_vcalls;
+}
+
+const IncrementalObjectAllocations &
+                       IncrementalState::get_cached_object_allocations() const {
+    return _cached_obj_allocs;
+}
+
+bool IncrementalState::export_state(
+                                uint64_t context_hash,
+                                const IncrementalResults &results,
+                                const VCallFile &vcall_file,
+                                const ObjectAllocationFile &obj_alloc_file)
+                                const {
+
+    // Map the module handles of all vtables to ids local to the file.
+    vector<uint64_t> module_ids(_vtable_file.get_num_modules(), UINT64_MAX);
+    vector<const string*> module_names;
+    auto add_vtable = [&](vector<uint64_t> &values, uint32_t vtable_idx) {
+        const VTable &vtable = _vtable_file.get_vtable(vtable_idx);
+        if(module_ids[vtable.module_id] == UINT64_MAX) {
+            module_ids[vtable.module_id] = module_names.size();
+            module_names.push_back(&vtable.module_name);
+        }
+        values.push_back(module_ids[vtable.module_id]);
+        values.push_back(vtable.addr);
+    };
+
+    vector<uint64_t> result_values;
+    for(const IncrementalResult &result : results) {
+        result_values.push_back(result.icall_addr);
+        add_vtable(result_values, result.vtable_idx);
+        result_values.push_back(result.entry_idx);
+    }
+
+    const ObjectAllocationMap &obj_allocs =
+                                       obj_alloc_file.get_object_allocations();
+    vector<vector<uint64_t>> obj_alloc_vtables;
+    for(const auto &kv : obj_allocs) {
+        obj_alloc_vtables.emplace_back();
+        for(uint32_t vtable_idx : kv.second.vtbl_idxs) {
+            add_vtable(obj_alloc_vtables.back(), vtable_idx);
+        }
+    }
+
+    CompanionFileWriter writer(_state_file,
+                               CompanionFileIncremental,
+                               context_hash);
+    writer.write(module_names.size());
+    for(const string *module_name : module_names) {
+        writer.write_string(*module_name);
+    }
+
+    vector<uint64_t> function_values;
+    for(const auto &kv : _function_hashes) {
+        function_values.push_back(kv.first);
+        function_values.push_back(kv.second);
+    }
+    writer.write_array(function_values.data(), function_values.size());
+
+    writer.write_array(result_values.data(), result_values.size());
+
+    writer.write_container(vcall_file.get_possible_vcall());
+
+    writer.write(obj_allocs.size());
+    uint32_t obj_alloc_ctr = 0;
+    for(const auto &kv : obj_allocs) {
+        const vector<uint64_t> &vtable_values =
+                                          obj_alloc_vtables[obj_alloc_ctr++];
+        writer.write(kv.second.addr);
+        writer.write_array(vtable_values.data(), vtable_values.size());
+        writer.write_container(kv.second.vtbl_xref_addrs);
+    }
+
+    return writer.finish();
+}
@@ -173,7 +173,7 @@ bool InstructionBacktraceIntra::mark_node_vtable(
                     throw runtime_error("Unknown SSA constant object.");
             }
 
-            if(_this_vtables.find(vtbl_candidate) != _this_vtables.cend()) {
+            if(_vtables.is_this_vtable(vtbl_candidate)) {
 
                 // Only mark as vtable node if it is not the start node
                 // of the analysis.
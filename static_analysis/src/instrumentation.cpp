@@ -0,0 +1,339 @@
+#include "instrumentation.h"
+#include "tracepoints.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+static thread_local InstrumentationThreadData *thread_data = nullptr;
+
+static const char *counter_names[InstrCounterNum] = {
+    "sym_execute_blocks",
+    "vex_translations",
+    "vex_cache_hits",
+    "state_kills",
+    "state_copies",
+    "def_use_cache_hits",
+    "def_use_cache_misses",
+    "budget_exceeded",
+};
+
+static const char *item_type_names[InstrItemNum] = {
+    "vtable_xref",
+    "lightweight_icall",
+    "vcall",
+};
+
+static uint64_t elapsed_us(const InstrumentationClock::time_point &start) {
+    return chrono::duration_cast<chrono::microseconds>(
+                              InstrumentationClock::now() - start).count();
+}
+
+Instrumentation &Instrumentation::get_instance() {
+    static Instrumentation instance;
+    return instance;
+}
+
+InstrumentationThreadData &Instrumentation::get_thread_data() {
+    if(thread_data == nullptr) {
+        lock_guard<mutex> _(_mtx);
+        _thread_data.emplace_back(new InstrumentationThreadData());
+        thread_data = _thread_data.back().get();
+    }
+    return *thread_data;
+}
+
+void Instrumentation::add_phase(const string &name,
+                                uint64_t duration_us,
+                                uint64_t rss_kb,
+                                uint64_t peak_rss_kb) {
+    lock_guard<mutex> _(_mtx);
+
+    for(InstrumentationPhase &phase : _phases) {
+        if(phase.name == name) {
+            phase.duration_us += duration_us;
+            phase.count++;
+            phase.rss_kb = max(phase.rss_kb, rss_kb);
+            phase.peak_rss_kb = max(phase.peak_rss_kb, peak_rss_kb);
+            return;
+        }
+    }
+
+    InstrumentationPhase phase;
+    phase.name = name;
+    phase.duration_us = duration_us;
+    phase.count = 1;
+    phase.rss_kb = rss_kb;
+    phase.peak_rss_kb = peak_rss_kb;
+    _phases.push_back(phase);
+}
+
+void Instrumentation::add_footprint(const string &name, uint64_t bytes) {
+    lock_guard<mutex> _(_mtx);
+
+    for(InstrumentationFootprint &footprint : _footprints) {
+        if(footprint.name == name) {
+            footprint.bytes += bytes;
+            return;
+        }
+    }
+
+    InstrumentationFootprint footprint;
+    footprint.name = name;
+    footprint.bytes = bytes;
+    _footprints.push_back(footprint);
+}
+
+bool Instrumentation::read_rss(uint64_t &rss_kb, uint64_t &peak_rss_kb) {
+    rss_kb = 0;
+    peak_rss_kb = 0;
+
+    ifstream status_file("/proc/self/status");
+    if(!status_file) {
+        return false;
+    }
+
+    // Lines have the form "VmRSS:     1234 kB".
+    bool found_rss = false;
+    bool found_peak = false;
+    string line;
+    while(getline(status_file, line) && !(found_rss && found_peak)) {
+        istringstream parser(line);
+        string key;
+        uint64_t value;
+        parser >> key >> dec >> value;
+        if(parser.fail()) {
+            continue;
+        }
+        if(key == "VmRSS:") {
+            rss_kb = value;
+            found_rss = true;
+        }
+        else if(key == "VmHWM:") {
+            peak_rss_kb = value;
+            found_peak = true;
+        }
+    }
+    return found_rss && found_peak;
+}
+
+void Instrumentation::reset() {
+    lock_guard<mutex> _(_mtx);
+
+    _phases.clear();
+    _footprints.clear();
+    for(const auto &data : _thread_data) {
+        for(uint32_t i = 0; i < InstrCounterNum; i++) {
+            data->counters[i] = 0;
+        }
+        data->items.clear();
+    }
+}
+
+void Instrumentation::export_report(const string &target_dir,
+                                    const string &module_name) {
+    lock_guard<mutex> _(_mtx);
+
+    if(!_enabled) {
+        return;
+    }
+
+    uint64_t counters[InstrCounterNum] = {};
+    uint64_t num_items = 0;
+    for(const auto &data : _thread_data) {
+        for(uint32_t i = 0; i < InstrCounterNum; i++) {
+            counters[i] += data->counters[i];
+        }
+        num_items += data->items.size();
+    }
+
+    uint64_t rss_kb;
+    uint64_t peak_rss_kb;
+    read_rss(rss_kb, peak_rss_kb);
+
+    uint64_t footprint_bytes = 0;
+    for(const InstrumentationFootprint &footprint : _footprints) {
+        footprint_bytes += footprint.bytes;
+    }
+
+    const string report_file = target_dir + "/" + module_name
+                               + "_instrumentation";
+
+    // Phases and counters (names do not need any escaping).
+    ofstream json_file(report_file + ".json");
+    json_file << "{\n";
+    json_file << "  \"module\": \"" << module_name << "\",\n";
+    json_file << "  \"phases\": [\n";
+    for(uint32_t i = 0; i < _phases.size(); i++) {
+        const InstrumentationPhase &phase = _phases[i];
+        json_file << "    {\"name\": \"" << phase.name << "\", "
+                  << "\"duration_us\": " << dec << phase.duration_us << ", "
+                  << "\"count\": " << dec << phase.count << ", "
+                  << "\"rss_kb\": " << dec << phase.rss_kb << ", "
+                  << "\"peak_rss_kb\": " << dec << phase.peak_rss_kb << "}"
+                  << (i + 1 < _phases.size() ? "," : "") << "\n";
+    }
+    json_file << "  ],\n";
+    json_file << "  \"counters\": {\n";
+    for(uint32_t i = 0; i < InstrCounterNum; i++) {
+        json_file << "    \"" << counter_names[i] << "\": "
+                  << dec << counters[i]
+                  << (i + 1 < InstrCounterNum ? "," : "") << "\n";
+    }
+    json_file << "  },\n";
+
+    // Estimated sizes of the data structures alive at the end of the run.
+    json_file << "  \"footprint\": {\n";
+    for(const InstrumentationFootprint &footprint : _footprints) {
+        json_file << "    \"" << footprint.name << "\": "
+                  << dec << footprint.bytes << ",\n";
+    }
+    json_file << "    \"total\": " << dec << footprint_bytes << "\n";
+    json_file << "  },\n";
+    json_file << "  \"rss_kb\": " << dec << rss_kb << ",\n";
+    json_file << "  \"peak_rss_kb\": " << dec << peak_rss_kb << ",\n";
+    json_file << "  \"num_items\": " << dec << num_items << "\n";
+    json_file << "}\n";
+    json_file.close();
+
+    // Costs of each work item.
+    ofstream csv_file(report_file + ".csv");
+    csv_file << "type,addr,duration_us,graph_size";
+    for(uint32_t i = 0; i < InstrCounterNum; i++) {
+        csv_file << "," << counter_names[i];
+    }
+    csv_file << "\n";
+    for(const auto &data : _thread_data) {
+        for(const InstrumentationItem &item : data->items) {
+            csv_file << item_type_names[item.type] << ","
+                     << hex << item.addr << ","
+                     << dec << item.duration_us << ","
+                     << dec << item.graph_size;
+            for(uint32_t i = 0; i < InstrCounterNum; i++) {
+                csv_file << "," << dec << item.counters[i];
+            }
+            csv_file << "\n";
+        }
+    }
+    csv_file.close();
+
+    if(json_file.fail() || csv_file.fail()) {
+        cerr << "Not able to write instrumentation report '"
+             << report_file
+             << "'."
+             << "\n";
+    }
+}
+
+bool Instrumentation::import_items(const string &target_dir,
+                                   const string &module_name,
+                                   vector<InstrumentationItem> &items) {
+
+    ifstream csv_file(target_dir + "/" + module_name
+                      + "_instrumentation.csv");
+    if(!csv_file) {
+        return false;
+    }
+
+    // Skip the header.
+    string line;
+    getline(csv_file, line);
+    while(getline(csv_file, line)) {
+        istringstream parser(line);
+        string type_name;
+        char separator;
+        InstrumentationItem item = {};
+        if(!getline(parser, type_name, ',')) {
+            continue;
+        }
+        parser >> hex >> item.addr >> separator >> dec >> item.duration_us;
+        if(parser.fail()) {
+            continue;
+        }
+
+        uint32_t type = 0;
+        while(type < InstrItemNum
+              && strcmp(item_type_names[type], type_name.c_str()) != 0) {
+            type++;
+        }
+        if(type == InstrItemNum) {
+            continue;
+        }
+        item.type = static_cast<InstrumentationItemType>(type);
+        items.push_back(item);
+    }
+    return true;
+}
+
+ScopedPhaseTimer::ScopedPhaseTimer(const string &name)
+    : _name(name),
+      _running(Instrumentation::get_instance().is_enabled()) {
+    MARX_TRACE1(phase__begin, _name.c_str());
+    if(_running) {
+        Instrumentation::read_rss(_start_rss_kb, _start_peak_rss_kb);
+        _start = InstrumentationClock::now();
+    }
+}
+
+ScopedPhaseTimer::~ScopedPhaseTimer() {
+    stop();
+}
+
+void ScopedPhaseTimer::stop() {
+    if(!_stopped) {
+        MARX_TRACE1(phase__end, _name.c_str());
+        _stopped = true;
+    }
+    if(_running) {
+        const uint64_t duration_us = elapsed_us(_start);
+        uint64_t rss_kb;
+        uint64_t peak_rss_kb;
+        Instrumentation::read_rss(rss_kb, peak_rss_kb);
+        if(peak_rss_kb <= _start_peak_rss_kb) {
+            peak_rss_kb = max(_start_rss_kb, rss_kb);
+        }
+        Instrumentation::get_instance().add_phase(_name,
+                                                  duration_us,
+                                                  rss_kb,
+                                                  peak_rss_kb);
+        _running = false;
+    }
+}
+
+ScopedItemTimer::ScopedItemTimer(InstrumentationItemType type, uint64_t addr)
+    : _enabled(Instrumentation::get_instance().is_enabled()) {
+    _item.type = type;
+    _item.addr = addr;
+    _item.graph_size = 0;
+    MARX_TRACE2(item__begin, type, addr);
+    if(!_enabled) {
+        return;
+    }
+
+    // The counters are stored as start values until the item is finished.
+    const InstrumentationThreadData &data =
+                            Instrumentation::get_instance().get_thread_data();
+    for(uint32_t i = 0; i < InstrCounterNum; i++) {
+        _item.counters[i] = data.counters[i];
+    }
+    _start = InstrumentationClock::now();
+}
+
+ScopedItemTimer::~ScopedItemTimer() {
+    MARX_TRACE3(item__end, _item.type, _item.addr, _item.graph_size);
+    if(!_enabled) {
+        return;
+    }
+
+    InstrumentationThreadData &data =
+                            Instrumentation::get_instance().get_thread_data();
+    _item.duration_us = elapsed_us(_start);
+    for(uint32_t i = 0; i < InstrCounterNum; i++) {
+        _item.counters[i] = data.counters[i] - _item.counters[i];
+    }
+    data.items.push_back(_item);
+}
@@ -0,0 +1,274 @@
+#include "ir_arena.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace std;
+
+// Largest alignment of any VEX IR type.
+static const size_t ir_alignment = alignof(max_align_t);
+
+IRArena::~IRArena() {
+    for(char *chunk : _chunks) {
+        free(chunk);
+    }
+}
+
+void *IRArena::allocate(size_t size) {
+    size = (size + ir_alignment - 1) & ~(ir_alignment - 1);
+    _size += size;
+
+    // Objects larger than a chunk get their own allocation (the current
+    // chunk is kept for subsequent objects).
+    if(size > IR_ARENA_CHUNK_SIZE) {
+        char *chunk = static_cast<char*>(malloc(size));
+        if(chunk == nullptr) {
+            throw bad_alloc();
+        }
+        _chunks.push_back(chunk);
+        return chunk;
+    }
+
+    if(size > _remaining) {
+        _current = static_cast<char*>(malloc(IR_ARENA_CHUNK_SIZE));
+        if(_current == nullptr) {
+            _remaining = 0;
+            throw bad_alloc();
+        }
+        _chunks.push_back(_current);
+        _remaining = IR_ARENA_CHUNK_SIZE;
+    }
+
+    void *result = _current;
+    _current += size;
+    _remaining -= size;
+    return result;
+}
+
+template<typename T>
+T *IRArena::copy_plain(const T *object) {
+    if(object == nullptr) {
+        return nullptr;
+    }
+    T *result = static_cast<T*>(allocate(sizeof(T)));
+    memcpy(result, object, sizeof(T));
+    return result;
+}
+
+/*!
+ * \brief Copies the given VEX block into the arena.
+ *
+ * \param block The block to copy (typically living in VEX's temporary
+ * storage which is reused by the next translation).
+ * \return A pointer to the copy which stays valid as long as the arena.
+ */
+IRSB *IRArena::copy(const IRSB *block) {
+    IRSB *result = copy_plain(block);
+    result->tyenv = copy(block->tyenv);
+    result->next = copy(block->next);
+
+    result->stmts_size = block->stmts_used;
+    result->stmts = static_cast<IRStmt**>(allocate(
+                                   sizeof(IRStmt*) * block->stmts_used));
+    for(int i = 0; i < block->stmts_used; ++i) {
+        result->stmts[i] = copy(block->stmts[i]);
+    }
+
+    return result;
+}
+
+IRTypeEnv *IRArena::copy(const IRTypeEnv *type_env) {
+    IRTypeEnv *result = copy_plain(type_env);
+    result->types_size = type_env->types_used;
+    result->types = static_cast<IRType*>(allocate(
+                                   sizeof(IRType) * type_env->types_used));
+    memcpy(result->types, type_env->types,
+           sizeof(IRType) * type_env->types_used);
+    return result;
+}
+
+// Copies the NULL-terminated argument vector of helper calls.
+IRExpr **IRArena::copy(IRExpr *const *arguments) {
+    if(arguments == nullptr) {
+        return nullptr;
+    }
+
+    size_t num_arguments = 0;
+    while(arguments[num_arguments] != nullptr) {
+        num_arguments++;
+    }
+
+    IRExpr **result = static_cast<IRExpr**>(allocate(
+                                     sizeof(IRExpr*) * (num_arguments + 1)));
+    for(size_t i = 0; i < num_arguments; ++i) {
+        result[i] = copy(arguments[i]);
+    }
+    result[num_arguments] = nullptr;
+    return result;
+}
+
+IRExpr *IRArena::copy(const IRExpr *expression) {
+    if(expression == nullptr) {
+        return nullptr;
+    }
+
+    // Copy the node as a whole and replace the pointers afterwards.
+    IRExpr *result = copy_plain(expression);
+    switch(expression->tag) {
+    case Iex_GetI:
+        result->Iex.GetI.descr = copy_plain(expression->Iex.GetI.descr);
+        result->Iex.GetI.ix = copy(expression->Iex.GetI.ix);
+        break;
+
+    case Iex_Qop: {
+        const IRQop &details = *expression->Iex.Qop.details;
+        IRQop *qop = copy_plain(&details);
+        qop->arg1 = copy(details.arg1);
+        qop->arg2 = copy(details.arg2);
+        qop->arg3 = copy(details.arg3);
+        qop->arg4 = copy(details.arg4);
+        result->Iex.Qop.details = qop;
+        break;
+    }
+
+    case Iex_Triop: {
+        const IRTriop &details = *expression->Iex.Triop.details;
+        IRTriop *triop = copy_plain(&details);
+        triop->arg1 = copy(details.arg1);
+        triop->arg2 = copy(details.arg2);
+        triop->arg3 = copy(details.arg3);
+        result->Iex.Triop.details = triop;
+        break;
+    }
+
+    case Iex_Binop:
+        result->Iex.Binop.arg1 = copy(expression->Iex.Binop.arg1);
+        result->Iex.Binop.arg2 = copy(expression->Iex.Binop.arg2);
+        break;
+
+    case Iex_Unop:
+        result->Iex.Unop.arg = copy(expression->Iex.Unop.arg);
+        break;
+
+    case Iex_Load:
+        result->Iex.Load.addr = copy(expression->Iex.Load.addr);
+        break;
+
+    case Iex_Const:
+        result->Iex.Const.con = copy_plain(expression->Iex.Const.con);
+        break;
+
+    case Iex_CCall:
+        // The callee's name is a static string of the VEX helpers.
+        result->Iex.CCall.cee = copy_plain(expression->Iex.CCall.cee);
+        result->Iex.CCall.args = copy(expression->Iex.CCall.args);
+        break;
+
+    case Iex_ITE:
+        result->Iex.ITE.cond = copy(expression->Iex.ITE.cond);
+        result->Iex.ITE.iftrue = copy(expression->Iex.ITE.iftrue);
+        result->Iex.ITE.iffalse = copy(expression->Iex.ITE.iffalse);
+        break;
+
+    // Binder, Get, RdTmp, VECRET and GSPTR do not hold any pointers.
+    default:
+        break;
+    }
+
+    return result;
+}
+
+IRDirty *IRArena::copy(const IRDirty *dirty) {
+    IRDirty *result = copy_plain(dirty);
+    result->cee = copy_plain(dirty->cee);
+    result->guard = copy(dirty->guard);
+    result->args = copy(dirty->args);
+    result->mAddr = copy(dirty->mAddr);
+    return result;
+}
+
+IRStmt *IRArena::copy(const IRStmt *statement) {
+    IRStmt *result = copy_plain(statement);
+    switch(statement->tag) {
+    case Ist_AbiHint:
+        result->Ist.AbiHint.base = copy(statement->Ist.AbiHint.base);
+        result->Ist.AbiHint.nia = copy(statement->Ist.AbiHint.nia);
+        break;
+
+    case Ist_Put:
+        result->Ist.Put.data = copy(statement->Ist.Put.data);
+        break;
+
+    case Ist_PutI: {
+        const IRPutI &details = *statement->Ist.PutI.details;
+        IRPutI *puti = copy_plain(&details);
+        puti->descr = copy_plain(details.descr);
+        puti->ix = copy(details.ix);
+        puti->data = copy(details.data);
+        result->Ist.PutI.details = puti;
+        break;
+    }
+
+    case Ist_WrTmp:
+        result->Ist.WrTmp.data = copy(statement->Ist.WrTmp.data);
+        break;
+
+    case Ist_Store:
+        result->Ist.Store.addr = copy(statement->Ist.Store.addr);
+        result->Ist.Store.data = copy(statement->Ist.Store.data);
+        break;
+
+    case Ist_StoreG: {
+        const IRStoreG &details = *statement->Ist.StoreG.details;
+        IRStoreG *storeg = copy_plain(&details);
+        storeg->addr = copy(details.addr);
+        storeg->data = copy(details.data);
+        storeg->guard = copy(details.guard);
+        result->Ist.StoreG.details = storeg;
+        break;
+    }
+
+    case Ist_LoadG: {
+        const IRLoadG &details = *statement->Ist.LoadG.details;
+        IRLoadG *loadg = copy_plain(&details);
+        loadg->addr = copy(details.addr);
+        loadg->alt = copy(details.alt);
+        loadg->guard = copy(details.guard);
+        result->Ist.LoadG.details = loadg;
+        break;
+    }
+
+    case Ist_CAS: {
+        const IRCAS &details = *statement->Ist.CAS.details;
+        IRCAS *cas = copy_plain(&details);
+        cas->addr = copy(details.addr);
+        cas->expdHi = copy(details.expdHi);
+        cas->expdLo = copy(details.expdLo);
+        cas->dataHi = copy(details.dataHi);
+        cas->dataLo = copy(details.dataLo);
+        result->Ist.CAS.details = cas;
+        break;
+    }
+
+    case Ist_LLSC:
+        result->Ist.LLSC.addr = copy(statement->Ist.LLSC.addr);
+        result->Ist.LLSC.storedata = copy(statement->Ist.LLSC.storedata);
+        break;
+
+    case Ist_Dirty:
+        result->Ist.Dirty.details = copy(statement->Ist.Dirty.details);
+        break;
+
+    case Ist_Exit:
+        result->Ist.Exit.guard = copy(statement->Ist.Exit.guard);
+        result->Ist.Exit.dst = copy_plain(statement->Ist.Exit.dst);
+        break;
+
+    // NoOp, IMark and MBE do not hold any pointers.
+    default:
+        break;
+    }
+
+    return result;
+}
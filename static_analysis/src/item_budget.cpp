@@ -0,0 +1,78 @@
+#include "item_budget.h"
+#include "instrumentation.h"
+
+using namespace std;
+
+static thread_local ScopedItemBudget *current_budget = nullptr;
+
+static const char *budget_messages[ItemBudgetNum] = {
+    "Item exceeded its time budget.",
+    "Item exceeded its graph node budget.",
+    "Item exceeded its path budget.",
+};
+
+ItemBudgetLimits ScopedItemBudget::_limits;
+atomic<uint64_t> ScopedItemBudget::_num_exceeded[ItemBudgetNum];
+
+ItemBudgetExceeded::ItemBudgetExceeded(ItemBudgetKind kind)
+    : runtime_error(budget_messages[kind]), _kind(kind) {
+}
+
+ScopedItemBudget::ScopedItemBudget()
+    : _prev(current_budget) {
+    if(_limits.max_seconds) {
+        _deadline = chrono::steady_clock::now()
+                    + chrono::seconds(_limits.max_seconds);
+    }
+    current_budget = this;
+}
+
+ScopedItemBudget::~ScopedItemBudget() {
+    current_budget = _prev;
+}
+
+/*!
+ * \brief Throws `ItemBudgetExceeded` if the wall time of the current item
+ * exceeds its limit.
+ */
+void ScopedItemBudget::check_time() {
+    if(current_budget
+       && _limits.max_seconds
+       && chrono::steady_clock::now() >= current_budget->_deadline) {
+        throw ItemBudgetExceeded(ItemBudgetTime);
+    }
+}
+
+/*!
+ * \brief Throws `ItemBudgetExceeded` if the graph of the current item
+ * exceeds the node limit.
+ */
+void ScopedItemBudget::check_graph_nodes(uint64_t num_nodes) {
+    if(current_budget
+       && _limits.max_graph_nodes
+       && num_nodes > _limits.max_graph_nodes) {
+        throw ItemBudgetExceeded(ItemBudgetGraphNodes);
+    }
+}
+
+/*!
+ * \brief Adds the given number of paths found for the current item and
+ * throws `ItemBudgetExceeded` if their total exceeds the path limit.
+ */
+void ScopedItemBudget::add_paths(uint64_t num_paths) {
+    if(current_budget && _limits.max_paths) {
+        current_budget->_num_paths += num_paths;
+        if(current_budget->_num_paths > _limits.max_paths) {
+            throw ItemBudgetExceeded(ItemBudgetPaths);
+        }
+    }
+}
+
+/*!
+ * \brief Counts an item that exceeded the given limit (also reported by the
+ * instrumentation).
+ */
+void ScopedItemBudget::count_exceeded(ItemBudgetKind kind) {
+    _num_exceeded[kind]++;
+    Instrumentation::get_instance().count(InstrCounterBudgetExceeded);
+}
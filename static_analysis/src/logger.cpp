@@ -0,0 +1,145 @@
+#include "logger.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+
+/*!
+ * \brief Ring of the calling thread (released when the thread exits).
+ */
+struct LogRingHandle {
+    LogRing *ring = nullptr;
+
+    ~LogRingHandle() {
+        if(ring != nullptr) {
+            ring->in_use.store(false, memory_order_release);
+        }
+    }
+};
+
+static thread_local LogRingHandle thread_ring;
+
+
+Logger::Logger() {
+    _drain_thread = thread(&Logger::drain_loop, this);
+}
+
+Logger::~Logger() {
+    {
+        lock_guard<mutex> lock(_wakeup_mtx);
+        _stop = true;
+    }
+    _wakeup_cv.notify_all();
+    _drain_thread.join();
+    flush();
+}
+
+Logger &Logger::get_instance() {
+    static Logger instance;
+    return instance;
+}
+
+LogRing &Logger::get_thread_ring() {
+    if(thread_ring.ring != nullptr) {
+        return *thread_ring.ring;
+    }
+
+    lock_guard<mutex> lock(_rings_mtx);
+    for(const auto &ring : _rings) {
+        bool expected = false;
+        if(ring->in_use.compare_exchange_strong(expected, true)) {
+            thread_ring.ring = ring.get();
+            return *ring;
+        }
+    }
+    _rings.emplace_back(new LogRing());
+    _rings.back()->in_use = true;
+    thread_ring.ring = _rings.back().get();
+    return *thread_ring.ring;
+}
+
+bool Logger::progress_due() {
+    const uint32_t interval_ms = _progress_interval_ms.load(
+                                                    memory_order_relaxed);
+    if(interval_ms == 0) {
+        return true;
+    }
+    LogRing &ring = get_thread_ring();
+    const auto now = chrono::steady_clock::now();
+    if(now - ring.last_progress < chrono::milliseconds(interval_ms)) {
+        return false;
+    }
+    ring.last_progress = now;
+    return true;
+}
+
+void Logger::write(LogLevel level, const string &message) {
+    LogRing &ring = get_thread_ring();
+    const uint64_t tail = ring.tail.load(memory_order_relaxed);
+    if(tail - ring.head.load(memory_order_acquire) >= LOG_RING_RECORDS) {
+
+        // Only happens in bursts faster than the drain thread, drain the
+        // rings from this thread instead of losing messages.
+        drain();
+        if(tail - ring.head.load(memory_order_acquire) >= LOG_RING_RECORDS) {
+            _dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+    }
+
+    LogRecord &record = ring.records[tail % LOG_RING_RECORDS];
+    record.level = level;
+    record.length = min(message.size(),
+                        static_cast<size_t>(LOG_RECORD_SIZE));
+    memcpy(record.text, message.data(), record.length);
+    ring.tail.store(tail + 1, memory_order_release);
+}
+
+bool Logger::drain() {
+    lock_guard<mutex> drain_lock(_drain_mtx);
+
+    vector<LogRing*> rings;
+    {
+        lock_guard<mutex> lock(_rings_mtx);
+        for(const auto &ring : _rings) {
+            rings.push_back(ring.get());
+        }
+    }
+
+    string output;
+    for(LogRing *ring : rings) {
+        const uint64_t tail = ring->tail.load(memory_order_acquire);
+        uint64_t head = ring->head.load(memory_order_relaxed);
+        for(; head != tail; head++) {
+            const LogRecord &record = ring->records[head % LOG_RING_RECORDS];
+            output.append(record.text, record.length);
+            output.push_back('\n');
+        }
+        ring->head.store(head, memory_order_release);
+    }
+    if(output.empty()) {
+        return false;
+    }
+    fwrite(output.data(), 1, output.size(), stdout);
+    fflush(stdout);
+    return true;
+}
+
+void Logger::drain_loop() {
+    unique_lock<mutex> lock(_wakeup_mtx);
+    while(!_stop) {
+        lock.unlock();
+        const bool drained = drain();
+        lock.lock();
+        if(!drained) {
+            _wakeup_cv.wait_for(lock, chrono::milliseconds(10));
+        }
+    }
+}
+
+void Logger::flush() {
+    drain();
+}
@@ -1,6 +1,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
 #include <sstream>
 #include <cstddef>
 #include <fstream>
@@ -12,10 +13,18 @@
 #include <mutex>
 #include <algorithm>
 #include <queue>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <chrono>
 #include <execinfo.h>
+#include <boost/filesystem.hpp>
 
 #include "vex.h"
 #include "translator.h"
+#include "mapped_elf.h"
+#include "mapped_pe.h"
 
 //#include "custom_analysis.h"
 #include "vtable_file.h"
@@ -31,18 +40,32 @@
 #include "new_operators.h"
 #include "vtv_vcall_gt.h"
 #include "ssa.h"
+#include "analysis_cache.h"
+#include "incremental_state.h"
+#include "summary_store.h"
+#include "instrumentation.h"
+#include "path_builder.h"
 
 #include "function_xrefs.h"
 #include "engels.h"
+#include "engels_checkpoint.h"
+#include "item_budget.h"
+#include "numa_placement.h"
 #include "binary_cps.h"
 #include "object_allocations.h"
 #include "object_allocations_gt.h"
+#include "result_stream.h"
+#include "ext_module_store.h"
+#include "marx_config.h"
+#include "logger.h"
+#include "scratch_arena.h"
+#include "graph_capture.h"
+#include "vtable_xref_scanner.h"
 
 #define DEBUG_BUILD 1
 
 using namespace std;
 
-const bool on_demand = false;
 queue<uint64_t> queue_func_address;
 mutex queue_func_mtx;
 
@@ -93,128 +116,201 @@ struct AnalysisObjects {
 };
 
 
-void playground(const string &config_file) {
+/*!
+ * \brief Runs the given task for each module index on up to `num_threads`
+ * threads.
+ *
+ * Exceptions thrown by the tasks are rethrown in module order after all
+ * tasks are finished.
+ */
+static void for_each_module(size_t num_modules,
+                            uint32_t num_threads,
+                            const function<void(size_t)> &task) {
 
-    // Parse config file.
-    ifstream file(config_file);
-    if(!file) {
-        throw runtime_error("Opening config file failed.");
-    }
-
-    string module_name; // File name == module name
-    string target_dir;
-    string file_format_str;
-    FileFormatType file_format;
-    unordered_set<uint64_t> new_operators;
-    unordered_set<uint64_t> vtv_verify_addrs;
-    vector<string> ext_modules;
-    uint32_t num_threads = 1;
-
-    string line;
-    while(getline(file, line)) {
-        istringstream parser(line);
-
-        string option;
-        parser >> option;
-        if(parser.fail()) {
-            throw runtime_error("Parsing config file failed.");
-        }
-        transform(option.begin(),
-                  option.end(),
-                  option.begin(),
-                  ::toupper);
-
-        if(option == "MODULENAME") {
-            parser >> module_name;
-            if(parser.fail()) {
-                throw runtime_error("Parsing config file failed.");
+    vector<exception_ptr> errors(num_modules);
+    atomic<size_t> next_module(0);
+    auto worker = [&]() {
+        while(true) {
+            size_t module_idx = next_module++;
+            if(module_idx >= num_modules) {
+                break;
             }
-        }
-        else if(option == "TARGETDIR") {
-            parser >> target_dir;
-            if(parser.fail()) {
-                throw runtime_error("Parsing config file failed.");
+            try {
+                task(module_idx);
             }
-        }
-        else if(option == "NEWOPERATORS") {
-            uint32_t number;
-            parser >> dec >> number;
-            if(parser.fail()) {
-                throw runtime_error("Parsing config file failed.");
-            }
-            for(uint32_t i = 0; i < number; i++) {
-                uint64_t new_op_addr;
-                parser >> hex >> new_op_addr;
-                if(parser.fail()) {
-                    throw runtime_error("Parsing config file failed.");
-                }
-                new_operators.insert(new_op_addr);
+            catch(...) {
+                errors[module_idx] = current_exception();
             }
         }
-        else if(option == "EXTERNALMODULES") {
-            uint32_t number;
-            parser >> dec >> number;
-            if(parser.fail()) {
-                throw runtime_error("Parsing config file failed.");
-            }
-            for(uint32_t i = 0; i < number; i++) {
-                string ext_module;
-                parser >> ext_module;
-                if(parser.fail()) {
-                    throw runtime_error("Parsing config file failed.");
-                }
-                ext_modules.push_back(ext_module);
-            }
-        }
-        else if(option == "FORMAT") {
-            parser >> file_format_str;
-            if(parser.fail()) {
-                throw runtime_error("Parsing config file failed.");
-            }
-            transform(file_format_str.begin(),
-                      file_format_str.end(),
-                      file_format_str.begin(),
-                      ::toupper);
-            if(file_format_str == "PE64") {
-                file_format = FileFormatPE64;
-            }
-            else if(file_format_str == "ELF64") {
-                file_format = FileFormatELF64;
-            }
-            else {
-                throw runtime_error("Format not known.");
-            }
+    };
+
+    // For debugging purposes do not spawn any thread.
+    uint32_t num_workers = min<size_t>(num_threads, num_modules);
+    if(num_workers <= 1) {
+        worker();
+    }
+    else {
+        thread *all_threads = new thread[num_workers];
+        for(uint32_t i = 0; i < num_workers; i++) {
+            all_threads[i] = thread(worker);
         }
-        else if(option == "NUMTHREADS") {
-            parser >> dec >> num_threads;
-            if(parser.fail()) {
-                throw runtime_error("Parsing config file failed.");
-            }
+        for(uint32_t i = 0; i < num_workers; i++) {
+            all_threads[i].join();
         }
-        else if(option == "VTVVERIFY") {
-            uint32_t number;
-            parser >> dec >> number;
-            if(parser.fail()) {
-                throw runtime_error("Parsing config file failed.");
-            }
-            for(uint32_t i = 0; i < number; i++) {
-                uint64_t vtv_verify_addr;
-                parser >> hex >> vtv_verify_addr;
-                if(parser.fail()) {
-                    throw runtime_error("Parsing config file failed.");
-                }
-                vtv_verify_addrs.insert(vtv_verify_addr);
-            }
+        delete [] all_threads;
+    }
+
+    for(const exception_ptr &error : errors) {
+        if(error) {
+            rethrow_exception(error);
         }
-        else {
-            throw runtime_error("Config option not known.");
+    }
+}
+
+/*!
+ * \brief Returns all input files of the module (the config and the files
+ * exported by the IDA scripts) that the results of the engels analysis
+ * depend on.
+ */
+static vector<string> get_context_files(const string &config_file,
+                                        const string &target_file,
+                                        const vector<string> &ext_modules) {
+    vector<string> context_files;
+    context_files.push_back(config_file);
+    context_files.push_back(target_file + "_vtables.txt");
+    for(const auto &it : ext_modules) {
+        context_files.push_back(it + "_vtables.txt");
+    }
+    context_files.push_back(target_file + "_icalls.txt");
+    context_files.push_back(target_file + "_funcs_xrefs.txt");
+    for(uint32_t file_ctr = 0; ; file_ctr++) {
+        string ssa_file = target_file
+                          + "_ssa.pb2_part"
+                          + to_string(file_ctr);
+        if(!ifstream(ssa_file)) {
+            break;
         }
+        context_files.push_back(ssa_file);
+    }
+    return context_files;
+}
+
+/*!
+ * \brief Adds the estimated sizes of the major data structures to the
+ * instrumentation report (the Vex blocks are shared by all modules of the
+ * process).
+ */
+static void add_memory_footprints(const Vex &vex,
+                                  const Translator &translator,
+                                  const VTableFile &vtable_file,
+                                  const EngelsAnalysisObjects &analysis_obj) {
+    Instrumentation &instrumentation = Instrumentation::get_instance();
+    if(!instrumentation.is_enabled()) {
+        return;
     }
 
+    instrumentation.add_footprint("vex_blocks", vex.get_memory_footprint());
+    instrumentation.add_footprint("translator",
+                                  translator.get_memory_footprint());
+    instrumentation.add_footprint("vtables",
+                                  vtable_file.get_memory_footprint());
+    instrumentation.add_footprint(
+                       "hierarchies",
+                       analysis_obj.vtable_hierarchies.get_memory_footprint());
+    instrumentation.add_footprint(
+                                "engels_results",
+                                engels_results_footprint(analysis_obj.results));
+    instrumentation.add_footprint("dataflow_peak_item",
+                                  ScratchArena::get_peak_item_size());
+}
+
+/*!
+ * \brief Runs the analysis of one module of the config file.
+ *
+ * \param shard If sharded, the analysis of the given part of the work items
+ * is stored in the checkpoint of the shard instead of exporting results.
+ * \param is_merge Set if the checkpoints of all `shard.count` shards are
+ * merged and the results exported.
+ * \param ext_store If set, the artefacts of the external modules are taken
+ * from (and kept resident in) the given store instead of being read.
+ */
+static void analyze_module(const string &config_file,
+                           const MarxConfig &config,
+                           const MarxModuleConfig &module,
+                           const AnalysisShard &shard,
+                           bool is_merge,
+                           ExtModuleStore *ext_store) {
+
+    const string &module_name = module.module_name;
+    const string &target_dir = module.target_dir;
+    const unordered_set<uint64_t> &new_operators = module.new_operators;
+    const unordered_set<uint64_t> &vtv_verify_addrs = module.vtv_verify_addrs;
+    const FileFormatType file_format = config.file_format;
+    vector<string> ext_modules = config.ext_modules;
+    const uint32_t use_analysis_cache = config.use_analysis_cache;
+    uint32_t use_incremental = config.use_incremental;
+    const uint32_t checkpoint_interval = config.checkpoint_interval;
+    const ItemBudgetLimits &budget_limits = config.budget_limits;
+    const uint32_t numa_mode = config.numa_mode;
+    const uint32_t state_backend = config.state_backend;
+    const uint32_t use_instrumentation = config.use_instrumentation;
+    uint32_t result_stream_mode = config.result_stream_mode;
+    const uint32_t native_tables = config.native_tables;
+    const uint32_t native_xrefs = config.native_xrefs;
+    const uint32_t num_threads = config.num_threads;
+    const uint32_t on_demand = config.on_demand;
+    const uint32_t tiering = config.tiering;
+    const uint32_t lazy_ext_modules = config.lazy_ext_modules;
+    const string &summary_store_dir = config.summary_store_dir;
+    const string &dynamic_vcalls_dir = config.dynamic_vcalls_dir;
+
     stringstream temp_str;
     temp_str << target_dir << "/" << module_name;
     string target_file = temp_str.str();
 
+    // The processes of a sharded run share their results through the
+    // checkpoint files only.
+    bool is_shard_worker = shard.is_sharded() && !is_merge;
+    if(is_merge || is_shard_worker) {
+        use_incremental = 0;
+    }
+    if(is_shard_worker) {
+        result_stream_mode = ResultStreamDisabled;
+    }
+
+    ScopedItemBudget::set_limits(budget_limits);
+    State::set_backend(static_cast<StateBackend>(state_backend));
+
+    Logger &logger = Logger::get_instance();
+    logger.set_level(static_cast<LogLevel>(config.log_level));
+    logger.set_progress_interval(config.progress_interval_ms);
+
+    Instrumentation &instrumentation = Instrumentation::get_instance();
+    instrumentation.set_enabled(use_instrumentation);
+    instrumentation.reset();
+    ScopedPhaseTimer total_timer("total");
+
+    // The graphs of a sharded run would end up in the same file, hence
+    // only the other runs capture them.
+    GraphCapture &graph_capture = GraphCapture::get_instance();
+    if(!is_shard_worker
+       && !graph_capture.start(config.graph_capture_stages,
+                               config.graph_capture_addrs,
+                               target_dir,
+                               module_name)) {
+        cerr << "Not able to capture data flow graphs." << "\n";
+    }
+
+    // Large functions may borrow threads for building their paths (the
+    // workers running the analyses are mostly idle by then).
+    PathBuilder::set_num_threads(num_threads > 1 ? num_threads - 1 : 0);
+
+    // All structures built until the engels analysis starts are shared by
+    // the workers (and read-only once finalized).
+    NumaPlacement &numa_placement = NumaPlacement::get_instance();
+    numa_placement.set_mode(static_cast<NumaMode>(numa_mode));
+    numa_placement.begin_shared_allocations();
+
     Vex &vex = Vex::get_instance();
 
     // We encountered problems when a basic block does not end in an
@@ -234,43 +330,80 @@ void playground(const string &config_file) {
     VexRegisterUpdates orig_iropt_register_updates_default =
                                        vex.get_iropt_register_updates_default();
     vex.set_iropt_register_updates_default(VexRegUpdAllregsAtEachInsn);
-    Translator translator(vex, target_file, file_format, on_demand);
+    Translator translator(vex,
+                          target_file,
+                          file_format,
+                          on_demand != 0,
+                          num_threads);
     const auto &memory = translator.get_memory();
 
-    // Parse exported ssa data.
-    ModuleSSA ssa;
-    if(!ssa.parse(target_file, translator)) {
-        throw runtime_error("Cannot parse ssa files " + target_file + ".");
+    // Import ssa and function xref data from the analysis cache if it
+    // was created from the same input files.
+    AnalysisCache analysis_cache(target_file);
+    bool cache_hit = false;
+    if(use_analysis_cache && analysis_cache.is_valid()) {
+        ScopedPhaseTimer phase_timer("analysis_cache_import");
+        cache_hit = analysis_cache.import_cache(translator);
+        if(!cache_hit) {
+            cerr << "Analysis cache does not match module. Ignoring it."
+                 << "\n";
+        }
     }
 
-    // Parse exported function xref data.
-    ModuleFunctionXrefs func_xrefs;
-    if(!func_xrefs.parse(target_file, translator)) {
-        throw runtime_error("Cannot parse function xref files "
-                            + target_file + ".");
+    if(!cache_hit) {
+        ScopedPhaseTimer phase_timer("ssa_import");
+        AnalysisCache *cache = nullptr;
+        if(use_analysis_cache) {
+            if(analysis_cache.begin_export()) {
+                cache = &analysis_cache;
+            }
+            else {
+                cerr << "Not able to create analysis cache file." << "\n";
+            }
+        }
+
+        // Parse exported ssa data.
+        ModuleSSA ssa;
+        if(!ssa.parse(target_file, translator, num_threads, cache)) {
+            throw runtime_error("Cannot parse ssa files " + target_file + ".");
+        }
+
+        // Parse exported function xref data.
+        ModuleFunctionXrefs func_xrefs;
+        if(!func_xrefs.parse(target_file, translator)) {
+            throw runtime_error("Cannot parse function xref files "
+                                + target_file + ".");
+        }
+
+        if(cache && !analysis_cache.finish_export(translator)) {
+            cerr << "Not able to write analysis cache file." << "\n";
+        }
     }
 
     // Finalize translator object in order to make it read-only.
-    translator.finalize();
+    translator.finalize(num_threads);
 
-    // Import all vtable files.
-    VTableFile vtable_file(module_name, file_format);
-    if(!vtable_file.parse(target_file)) {
-        throw runtime_error("Cannot parse vtables file " + target_file + ".");
+    // The .plt, .got and .idata entries are either read directly from the
+    // module or from the files created by the exporter.
+    const MappedElf *mapped_elf = nullptr;
+    const MappedPe *mapped_pe = nullptr;
+    if(native_tables) {
+        mapped_elf = dynamic_cast<const MappedElf*>(&memory);
+        mapped_pe = dynamic_cast<const MappedPe*>(&memory);
     }
-    for(const auto &it : ext_modules) {
-        if(!vtable_file.parse(it)) {
-            throw runtime_error("Cannot parse vtables file '" + it + "'.");
-        }
-    }
-    vtable_file.finalize();
 
     // Import all plt entries.
     ModulePlt module_plt(module_name);
     switch(file_format) {
         case FileFormatELF64:
             // Import all plt entries.
-            if(!module_plt.parse(target_file)) {
+            if(mapped_elf != nullptr) {
+                if(!module_plt.parse(*mapped_elf)) {
+                    throw runtime_error("Cannot read .plt entries of module "
+                                        + target_file + ".");
+                }
+            }
+            else if(!module_plt.parse(target_file)) {
                 throw runtime_error("Cannot parse module plt file "
                                     + target_file + ".");
             }
@@ -282,14 +415,182 @@ void playground(const string &config_file) {
                                 "handle file format.");
     }
 
+    // Import .got / .data entries.
+    GotMap got_map;
+    IDataMap idata_map;
+    switch(file_format) {
+        case FileFormatELF64:
+            got_map = mapped_elf != nullptr
+                      ? import_got(*mapped_elf)
+                      : import_got(target_file);
+            break;
+        case FileFormatPE64:
+            idata_map = mapped_pe != nullptr
+                        ? import_idata(*mapped_pe)
+                        : import_idata(target_file);
+            break;
+        default:
+            throw runtime_error("Do not know how to "\
+                                "handle file format.");
+    }
+
+    // Read the vtable files of this module and all external modules and
+    // the functions of all external modules concurrently. They are added
+    // in config order afterwards which keeps the indexes deterministic.
+    vector<VTableModule> vtable_modules(ext_modules.size() + 1);
+    vector<uint32_t> vtable_modules_parsed(ext_modules.size() + 1, 0);
+    vector<ExternalFunctionVector> ext_funcs_modules(ext_modules.size());
+    vector<uint32_t> ext_funcs_modules_parsed(ext_modules.size(), 0);
+    ScopedPhaseTimer modules_timer("load_modules");
+
+    // In lazy mode, the functions of the external modules are read first
+    // as index of their symbols and only the modules this module imports
+    // symbols from are loaded.
+    if(lazy_ext_modules) {
+        for_each_module(ext_modules.size() + 1,
+                        num_threads,
+                        [&](size_t idx) {
+            if(idx == 0) {
+                vtable_modules_parsed[idx] = VTableFile::read_module(
+                                                         target_file,
+                                                         use_analysis_cache,
+                                                         vtable_modules[idx]);
+                return;
+            }
+            const string &ext_module = ext_modules[idx - 1];
+            if(ext_store != nullptr) {
+                ExtModuleArtefactsPtr artefacts = ext_store->get(
+                                                          ext_module,
+                                                          use_analysis_cache);
+                ext_funcs_modules_parsed[idx - 1] = artefacts->funcs_parsed;
+                ext_funcs_modules[idx - 1] = artefacts->funcs;
+                return;
+            }
+            ext_funcs_modules_parsed[idx - 1] = ExternalFunctions::read_module(
+                                                    ext_module,
+                                                    ext_funcs_modules[idx - 1]);
+        });
+        for(size_t i = 0; i < ext_modules.size(); i++) {
+            if(!ext_funcs_modules_parsed[i]) {
+                throw runtime_error("Cannot parse external functions file '"
+                                    + ext_modules[i] + "'.");
+            }
+        }
+
+        unordered_set<string> imported_funcs;
+        for(const PltEntry &plt_entry : module_plt.get_plt_entries()) {
+            imported_funcs.insert(plt_entry.func_name);
+        }
+        for(const IDataEntry &idata_entry : idata_map.get_entries()) {
+            imported_funcs.insert(idata_entry.name);
+        }
+        const vector<size_t> selected = select_imported_ext_modules(
+                                                         ext_funcs_modules,
+                                                         imported_funcs,
+                                                         vtable_modules[0]);
+        cout << "Loading "
+             << dec << selected.size()
+             << " of "
+             << dec << ext_modules.size()
+             << " external modules."
+             << "\n";
+
+        // The functions of the selected modules are kept.
+        vector<string> selected_modules;
+        vector<ExternalFunctionVector> selected_funcs;
+        for(size_t idx : selected) {
+            selected_modules.push_back(ext_modules[idx]);
+            selected_funcs.push_back(move(ext_funcs_modules[idx]));
+        }
+        ext_modules = move(selected_modules);
+        ext_funcs_modules = move(selected_funcs);
+        ext_funcs_modules_parsed.assign(ext_modules.size(), 1);
+        vtable_modules.resize(ext_modules.size() + 1);
+        vtable_modules_parsed.resize(ext_modules.size() + 1);
+    }
+
+    for_each_module(ext_modules.size() + 1,
+                    num_threads,
+                    [&](size_t idx) {
+        if(idx == 0) {
+            if(!lazy_ext_modules) {
+                vtable_modules_parsed[idx] = VTableFile::read_module(
+                                                         target_file,
+                                                         use_analysis_cache,
+                                                         vtable_modules[idx]);
+            }
+            return;
+        }
+        const string &ext_module = ext_modules[idx - 1];
+        if(ext_store != nullptr) {
+
+            // Adding the modules consumes them, hence copy the resident
+            // artefacts.
+            ExtModuleArtefactsPtr artefacts = ext_store->get(
+                                                          ext_module,
+                                                          use_analysis_cache);
+            vtable_modules_parsed[idx] = artefacts->vtables_parsed;
+            vtable_modules[idx] = artefacts->vtables;
+            ext_funcs_modules_parsed[idx - 1] = artefacts->funcs_parsed;
+            ext_funcs_modules[idx - 1] = artefacts->funcs;
+            return;
+        }
+        vtable_modules_parsed[idx] = VTableFile::read_module(
+                                                         ext_module,
+                                                         use_analysis_cache,
+                                                         vtable_modules[idx]);
+        if(!lazy_ext_modules) {
+            ext_funcs_modules_parsed[idx - 1] = ExternalFunctions::read_module(
+                                                    ext_module,
+                                                    ext_funcs_modules[idx - 1]);
+        }
+    });
+
+    // The xrefs of the vtables of this module can also be found in its code
+    // (either to check the exported ones or to replace them).
+    if(native_xrefs != NativeXrefsDisabled && vtable_modules_parsed[0]) {
+        ScopedPhaseTimer phase_timer("native_vtable_xrefs");
+        const VTableXrefScanStats stats = scan_vtable_xrefs(
+                                  translator,
+                                  static_cast<NativeXrefsMode>(native_xrefs),
+                                  num_threads,
+                                  vtable_modules[0]);
+        cout << "Native vtable xrefs: "
+             << dec << stats.num_xrefs
+             << " found, "
+             << dec << stats.num_missing
+             << " exported xrefs not found, "
+             << dec << stats.num_additional
+             << " not exported."
+             << "\n";
+    }
+
+    // Import all vtable files.
+    VTableFile vtable_file(module_name, file_format);
+    if(!vtable_modules_parsed[0]
+       || !vtable_file.add_module(vtable_modules[0])) {
+        throw runtime_error("Cannot parse vtables file " + target_file + ".");
+    }
+    for(size_t i = 0; i < ext_modules.size(); i++) {
+        if(!vtable_modules_parsed[i + 1]
+           || !vtable_file.add_module(vtable_modules[i + 1])) {
+            throw runtime_error("Cannot parse vtables file '"
+                                + ext_modules[i] + "'.");
+        }
+    }
+    vtable_file.finalize(num_threads);
+
     // Import all functions of other modules.
     ExternalFunctions external_funcs;
-    for(const auto &it : ext_modules) {
-        if(!external_funcs.parse(it)) {
-            throw runtime_error("Cannot parse external functions file '" + it + "'.");
+    for(size_t i = 0; i < ext_modules.size(); i++) {
+        if(!ext_funcs_modules_parsed[i]) {
+            throw runtime_error("Cannot parse external functions file '"
+                                + ext_modules[i] + "'.");
         }
+        external_funcs.add_module(ext_funcs_modules[i]);
     }
     external_funcs.finalize();
+    modules_timer.stop();
 
     // Import blacklisted functions (for example pure virtual function).
     // These functions are ignored during the main analysis iteration
@@ -300,6 +601,7 @@ void playground(const string &config_file) {
                                                                    target_file);
 
     // Import all known hierarchies.
+    ScopedPhaseTimer artefacts_timer("load_module_artefacts");
     VTableHierarchies vtable_hierarchies(file_format,
                                          vtable_file,
                                          module_name,
@@ -307,93 +609,194 @@ void playground(const string &config_file) {
                                          module_plt,
                                          funcs_blacklist,
                                          -1);
-    vtable_hierarchies.import_hierarchy(target_dir + "/" + module_name);
-    for(const auto &it : ext_modules) {
-        vtable_hierarchies.import_hierarchy(it);
-    }
-
-    // Create vtable hierarchies used by the threads.
-    vector<VTableHierarchies*> thread_vtbl_hierarchies;
-    for(uint32_t i = 0; i < num_threads; i++) {
-        VTableHierarchies *temp = new VTableHierarchies(file_format,
-                                                        vtable_file,
-                                                        module_name,
-                                                        external_funcs,
-                                                        module_plt,
-                                                        funcs_blacklist,
-                                                        i);
-        thread_vtbl_hierarchies.push_back(temp);
-    }
+    vtable_hierarchies.import_hierarchy(target_dir + "/" + module_name,
+                                        use_analysis_cache);
 
     NewOperators new_operators_candidates = NewOperators(module_name,
                                                          vtable_file,
                                                          vtable_hierarchies);
 
-    // Create new operators used by the threads.
-    vector<NewOperators*> thread_new_operators;
-    for(uint32_t i = 0; i < num_threads; i++) {
-        NewOperators *temp = new NewOperators(module_name,
-                                              vtable_file,
-                                              vtable_hierarchies);
-        thread_new_operators.push_back(temp);
-    }
-
     VTVVcallsFile vtv_vcalls_file = VTVVcallsFile(module_name);
 
-    // Create vtv vcalls used by the threads.
-    vector<VTVVcallsFile*> thread_vtv_vcalls;
-    for(uint32_t i = 0; i < num_threads; i++) {
-        VTVVcallsFile *temp = new VTVVcallsFile(module_name);
-        thread_vtv_vcalls.push_back(temp);
-    }
-
-    // Import all vtable updates that are made in external functions.
     FctVTableUpdates fct_vtable_updates(vtable_file,
                                         module_name);
-    for(const auto &it : ext_modules) {
-        fct_vtable_updates.import_updates(it);
-    }
 
-    // Import .got / .data entries.
-    GotMap got_map;
-    IDataMap idata_map;
-    switch(file_format) {
-        case FileFormatELF64:
-            got_map = import_got(target_file);
-            break;
-        case FileFormatPE64:
-            idata_map = import_idata(target_file);
-            break;
-        default:
-            throw runtime_error("Do not know how to "\
-                                "handle file format.");
+    FctReturnValuesFile fct_return_values(module_name,
+                                          vtable_file,
+                                          module_plt,
+                                          external_funcs);
+
+    // Import the hierarchies, the vtable updates that are made in external
+    // functions and the return values of all external modules concurrently
+    // (they only read the finalized vtable and external function objects).
+    vector<HierarchiesVTable> ext_hierarchies(ext_modules.size());
+    vector<ExtReturnValues> ext_return_values(ext_modules.size());
+    for_each_module(ext_modules.size(),
+                    num_threads,
+                    [&](size_t idx) {
+        const string &ext_module = ext_modules[idx];
+        vtable_hierarchies.read_hierarchy(ext_module,
+                                          use_analysis_cache,
+                                          ext_hierarchies[idx]);
+        fct_vtable_updates.import_updates(ext_module);
+        fct_return_values.read_ext_return_values(ext_module,
+                                                 ext_return_values[idx]);
+    });
+
+    // Add them in config order.
+    for(size_t i = 0; i < ext_modules.size(); i++) {
+        vtable_hierarchies.update_hierarchy(ext_hierarchies[i], false);
+        fct_return_values.add_ext_return_values(ext_return_values[i]);
     }
+    vtable_hierarchies.merge_hierarchies();
+    fct_return_values.finalize_ext_return_values();
+    artefacts_timer.stop();
+
+    numa_placement.end_shared_allocations();
+
+    // Stream results into a compact file as soon as they are found.
+    ResultStream result_stream(
+                         static_cast<ResultStreamMode>(result_stream_mode),
+                         target_dir,
+                         module_name);
 
     VCallFile vcall_file(module_name,
                          vtable_hierarchies,
                          vtable_file);
+    if(result_stream.is_enabled()) {
+        vcall_file.set_result_stream(&result_stream);
+    }
 
-    // Import return values of this modules .plt functions.
-    FctReturnValuesFile fct_return_values(module_name,
-                                          vtable_file,
-                                          module_plt,
-                                          external_funcs);
-    for(const auto &it : ext_modules) {
-        fct_return_values.import_ext_return_values(it);
+    // Import the state of the previous run in order to only re-analyze
+    // the functions that changed (and the results depending on them).
+    // The state is bound to the config and the vtables of all modules.
+    IncrementalState incremental_state(target_file, translator, vtable_file);
+    uint64_t incremental_hash = 0;
+    if(use_incremental) {
+        vector<string> context_files;
+        context_files.push_back(config_file);
+        context_files.push_back(target_file + "_vtables.txt");
+        for(const auto &it : ext_modules) {
+            context_files.push_back(it + "_vtables.txt");
+        }
+        incremental_hash = hash_files(context_files);
+        if(!incremental_state.import_state(incremental_hash)) {
+            cout << "No usable incremental state. Analyzing everything."
+                 << "\n";
+        }
+    }
+
+    // Store the finished items of the engels analysis every
+    // `checkpoint_interval` seconds and resume an interrupted run. The
+    // checkpoint is bound to the config and all input files of the module.
+    // Each shard always stores its items in its own checkpoint, the merging
+    // process imports all of them.
+    uint64_t context_hash = 0;
+    if(checkpoint_interval || shard.is_sharded()) {
+        context_hash = hash_files(get_context_files(config_file,
+                                                    target_file,
+                                                    ext_modules));
+    }
+    EngelsCheckpoint checkpoint(
+                      is_shard_worker
+                      ? EngelsCheckpoint::get_shard_target(target_file, shard)
+                      : target_file,
+                      checkpoint_interval ? checkpoint_interval : 60);
+    bool use_checkpoint = false;
+    if(is_merge) {
+        for(uint32_t i = 0; i < shard.count; i++) {
+            AnalysisShard other;
+            other.index = i;
+            other.count = shard.count;
+            if(!checkpoint.merge_shard(other, context_hash)) {
+                throw runtime_error("Checkpoint of shard "
+                                    + to_string(i)
+                                    + " missing or not finished.");
+            }
+        }
+        use_checkpoint = true;
+        cout << "Merged checkpoints of "
+             << dec << shard.count
+             << " shards."
+             << "\n";
+    }
+    else if(checkpoint_interval || is_shard_worker) {
+        use_checkpoint = checkpoint.open(context_hash);
+        if(!use_checkpoint) {
+            cerr << "Not able to write engels checkpoint file." << "\n";
+            if(is_shard_worker) {
+                throw runtime_error("Shard needs its checkpoint file.");
+            }
+        }
     }
-    fct_return_values.finalize_ext_return_values();
 
-    // Get all object allocation sites.
+    // Get all object allocation sites (the merging process takes them from
+    // the shards).
     ObjectAllocationFile obj_alloc_file(module_name);
-    object_allocation_analysis(module_name,
-                               vtable_file,
-                               translator,
-                               vex,
-                               obj_alloc_file,
-                               num_threads);
+    if(result_stream.is_enabled()) {
+        obj_alloc_file.set_result_stream(&result_stream, vtable_file);
+    }
+    ScopedPhaseTimer obj_alloc_timer("object_allocation_analysis");
+    if(is_merge) {
+        for(const IncrementalObjectAllocation &obj_alloc :
+            checkpoint.get_object_allocations()) {
+            for(uint32_t vtbl_idx : obj_alloc.vtbl_idxs) {
+                for(uint64_t vtbl_xref_addr : obj_alloc.vtbl_xref_addrs) {
+                    obj_alloc_file.add_object_allocation(obj_alloc.addr,
+                                                         vtbl_idx,
+                                                         vtbl_xref_addr);
+                }
+            }
+        }
+    }
+    else {
+        unique_ptr<SummaryStore> summary_store;
+        if(!summary_store_dir.empty()) {
+            summary_store.reset(new SummaryStore(
+                                            summary_store_dir,
+                                            vtable_file.get_addr_size()));
+        }
+        object_allocation_analysis(module_name,
+                                   vtable_file,
+                                   translator,
+                                   vex,
+                                   obj_alloc_file,
+                                   num_threads,
+                                   &incremental_state,
+                                   is_shard_worker ? &shard : nullptr,
+                                   summary_store.get());
+        if(summary_store) {
+            cout << "Function summaries reused: "
+                 << dec << summary_store->get_num_hits()
+                 << " (analyzed: "
+                 << dec << summary_store->get_num_misses()
+                 << ")."
+                 << "\n";
+        }
+    }
+    obj_alloc_timer.stop();
 
-    // Export analysis results directly.
-    obj_alloc_file.export_object_allocations(target_dir);
+    if(is_shard_worker) {
+        for(const auto &kv : obj_alloc_file.get_object_allocations()) {
+            IncrementalObjectAllocation obj_alloc;
+            obj_alloc.addr = kv.first;
+            obj_alloc.vtbl_idxs.assign(kv.second.vtbl_idxs.cbegin(),
+                                       kv.second.vtbl_idxs.cend());
+            obj_alloc.vtbl_xref_addrs.assign(
+                                       kv.second.vtbl_xref_addrs.cbegin(),
+                                       kv.second.vtbl_xref_addrs.cend());
+            checkpoint.add_object_allocation(obj_alloc);
+        }
+    }
+
+    // Export analysis results directly (in the background, the engels
+    // analysis does not touch them).
+    future<void> obj_allocs_exported;
+    if(!is_shard_worker) {
+        obj_allocs_exported = async(launch::async, [&]() {
+            obj_alloc_file.export_object_allocations(target_dir, num_threads);
+        });
+    }
 
     EngelsAnalysisObjects analysis_obj(file_format,
                                        vtable_file,
@@ -403,16 +806,133 @@ void playground(const string &config_file) {
                                        translator,
                                        vex,
                                        vcall_file);
+    if(use_checkpoint) {
+        analysis_obj.checkpoint = &checkpoint;
+    }
+    if(is_shard_worker) {
+        analysis_obj.shard = &shard;
+    }
+    analysis_obj.tiering = tiering != 0;
+
+    // Vcalls confirmed by the profiled runs of the module.
+    ICallSet dynamic_vcalls;
+    if(!dynamic_vcalls_dir.empty()) {
+        if(import_dynamic_vcalls(dynamic_vcalls_dir,
+                                 module_name,
+                                 dynamic_vcalls)) {
+            analysis_obj.dynamic_vcalls = &dynamic_vcalls;
+        }
+        else {
+            cerr << "No dynamically confirmed vcalls for module '"
+                 << module_name
+                 << "' found."
+                 << "\n";
+        }
+    }
 
     // engels analysis
     engels_analysis(target_file,
                     module_name,
                     target_dir,
                     analysis_obj,
-                    num_threads);
+                    num_threads,
+                    &incremental_state);
+
+    // A shard is done once its checkpoint is finished, the merging process
+    // exports the results.
+    if(is_shard_worker) {
+        checkpoint.finish();
+        total_timer.stop();
+        add_memory_footprints(vex, translator, vtable_file, analysis_obj);
+        instrumentation.export_report(target_dir, module_name);
+        cout << "Shard "
+             << dec << shard.index
+             << " of "
+             << dec << shard.count
+             << " finished."
+             << "\n";
+        return;
+    }
 
     // Export results.
-    analysis_obj.vcall_file.export_vcalls(target_dir);
+    analysis_obj.vcall_file.export_vcalls(target_dir, num_threads);
+    obj_allocs_exported.get();
+
+    // Results of this run together with the reused ones.
+    IncrementalResults all_results = incremental_state.get_cached_results();
+    all_results.insert(all_results.end(),
+                       checkpoint.get_results().begin(),
+                       checkpoint.get_results().end());
+    for(const auto &kv : analysis_obj.results) {
+        for(const auto &result : kv.second) {
+            IncrementalResult incremental_result;
+            incremental_result.icall_addr = kv.first;
+            incremental_result.vtable_idx = result.vtable_idx;
+            incremental_result.entry_idx = result.entry_idx;
+            all_results.push_back(incremental_result);
+        }
+    }
+
+    // The shards finish in any order, sort the results so that merged runs
+    // give the same output.
+    if(is_merge) {
+        sort(all_results.begin(), all_results.end(),
+             [](const IncrementalResult &a, const IncrementalResult &b) {
+                 if(a.icall_addr != b.icall_addr) {
+                     return a.icall_addr < b.icall_addr;
+                 }
+                 if(a.vtable_idx != b.vtable_idx) {
+                     return a.vtable_idx < b.vtable_idx;
+                 }
+                 return a.entry_idx < b.entry_idx;
+             });
+    }
+    if(use_incremental
+       && !incremental_state.export_state(incremental_hash,
+                                          all_results,
+                                          analysis_obj.vcall_file,
+                                          obj_alloc_file)) {
+        cerr << "Not able to write incremental state file." << "\n";
+    }
+
+    result_stream.finish();
+    if(!graph_capture.finish()) {
+        cerr << "Not able to write captured data flow graphs." << "\n";
+    }
+
+    // The results of the engels analysis are exported, an interrupted run
+    // can not occur anymore.
+    if(is_merge) {
+        for(uint32_t i = 0; i < shard.count; i++) {
+            AnalysisShard other;
+            other.index = i;
+            other.count = shard.count;
+            EngelsCheckpoint shard_checkpoint(
+                       EngelsCheckpoint::get_shard_target(target_file, other),
+                       0);
+            shard_checkpoint.remove();
+        }
+    }
+    else if(analysis_obj.checkpoint) {
+        checkpoint.remove();
+    }
+
+    total_timer.stop();
+    add_memory_footprints(vex, translator, vtable_file, analysis_obj);
+    instrumentation.export_report(target_dir, module_name);
+
+    // The results were streamed already, do not dump them again.
+    if(result_stream.is_enabled()) {
+        cout << "Results streamed: "
+             << dec << analysis_obj.vcall_file.get_vcalls().size()
+             << " vcalls, "
+             << dec << analysis_obj.vcall_file.get_possible_vcall().size()
+             << " possible vcalls, "
+             << dec << obj_alloc_file.get_object_allocations().size()
+             << " object allocations."
+             << "\n";
+        return;
+    }
 
     // TODO / DEBUG
     cout << "Possible vcalls: " << "\n";
@@ -420,6 +940,7 @@ void playground(const string &config_file) {
         cout << hex << vcall_addr << "\n";
     }
     cout << "\n";
+#if DEBUG_ENGELS_KEEP_RESULT_DIAGNOSTICS
     for(const auto &kv : analysis_obj.results) {
         cout << "Result for vcall: " << *kv.second.at(0).icall_instr << "\n";
         for(const auto &result : kv.second) {
@@ -427,15 +948,16 @@ void playground(const string &config_file) {
         }
         cout << "" << "\n";
     }
+#endif
     cout << "\n";
     cout << "Computer processable vcall result:" << "\n";
-    for(const auto &kv : analysis_obj.results) {
-        cout << hex << kv.second.at(0).icall_instr->get_address();
-        unordered_set<uint32_t> unique_vtable_idxs;
-        for(const auto &result : kv.second) {
-            unique_vtable_idxs.insert(result.vtable_idx);
-        }
-        for(auto vtable_idx : unique_vtable_idxs) {
+    map<uint64_t, unordered_set<uint32_t>> unique_vtable_idxs_map;
+    for(const auto &result : all_results) {
+        unique_vtable_idxs_map[result.icall_addr].insert(result.vtable_idx);
+    }
+    for(const auto &kv : unique_vtable_idxs_map) {
+        cout << hex << kv.first;
+        for(auto vtable_idx : kv.second) {
             const VTable &vtable = vtable_file.get_vtable(vtable_idx);
             cout << " " << hex << vtable.addr;
         }
@@ -443,25 +965,147 @@ void playground(const string &config_file) {
     }
 }
 
+/*!
+ * \brief Runs the analyses of all modules given by the config file (one
+ * after another).
+ *
+ * \param shard If sharded, the analysis of the given part of the work items
+ * is stored in the checkpoint of the shard instead of exporting results.
+ * \param is_merge Set if the checkpoints of all `shard.count` shards are
+ * merged and the results exported.
+ * \param ext_store If set, the artefacts of the external modules are taken
+ * from (and kept resident in) the given store instead of being read.
+ */
+void playground(const string &config_file,
+                const AnalysisShard &shard,
+                bool is_merge,
+                ExtModuleStore *ext_store) {
+
+    const MarxConfig config = parse_config(config_file);
+
+    // The modules of one config share the artefacts of the external modules.
+    ExtModuleStore config_ext_store;
+    if(ext_store == nullptr && config.modules.size() > 1) {
+        ext_store = &config_ext_store;
+    }
+
+    for(const MarxModuleConfig &module : config.modules) {
+        analyze_module(config_file,
+                       config,
+                       module,
+                       shard,
+                       is_merge,
+                       ext_store);
+    }
+}
+
 void handle_exception(const char *message) {
     cerr << "Exception occurred: " << message << endl;
 }
 
+/*!
+ * \brief Analyzes the jobs put into the given directory until a file named
+ * `stop` appears in it (server mode).
+ *
+ * A job is a file `{NAME}.job` containing the path of the config file of the
+ * module to analyze. It is claimed by renaming it to `{NAME}.running` (hence
+ * several servers can share a directory) and finished by writing
+ * `{NAME}.done` containing `ok` or the error message. The artefacts of the
+ * external modules stay resident between the jobs.
+ */
+static void serve(const string &job_dir) {
+    namespace fs = boost::filesystem;
+
+    ExtModuleStore ext_store;
+    AnalysisShard no_shard;
+    while(!MappedFile::exists(job_dir + "/stop")) {
+
+        // Jobs are processed in the order of their names.
+        vector<string> jobs;
+        for(fs::directory_iterator it(job_dir);
+            it != fs::directory_iterator();
+            ++it) {
+            if(it->path().extension() == ".job") {
+                jobs.push_back(it->path().stem().string());
+            }
+        }
+        if(jobs.empty()) {
+            this_thread::sleep_for(chrono::seconds(1));
+            continue;
+        }
+        sort(jobs.begin(), jobs.end());
+
+        for(const string &job : jobs) {
+            const string job_file = job_dir + "/" + job;
+            if(rename((job_file + ".job").c_str(),
+                      (job_file + ".running").c_str()) != 0) {
+                continue;
+            }
+
+            string config_file;
+            getline(ifstream(job_file + ".running"), config_file);
+
+            string status = "ok";
+            try {
+                playground(config_file, no_shard, false, &ext_store);
+            } catch(const exception &e) {
+                handle_exception(e.what());
+                status = e.what();
+            }
+
+            ofstream(job_file + ".done") << status << "\n";
+            remove((job_file + ".running").c_str());
+            cout << "Job "
+                 << job
+                 << " finished ("
+                 << dec << ext_store.size()
+                 << " resident external modules): "
+                 << status
+                 << endl;
+        }
+    }
+}
+
 int main(int argc, char* argv[]) {
 
-    if(argc != 2) {
+    // A sharded run starts one `shard` process per part (on any machine
+    // sharing the target directory) and a `merge` process once all of them
+    // finished.
+    AnalysisShard shard;
+    bool is_merge = false;
+    bool is_valid = argc == 2;
+    if(argc == 3 && strcmp(argv[1], "serve") == 0) {
+        serve(argv[2]);
+        cout << "Done." << endl;
+        return 0;
+    }
+    else if(argc == 5 && strcmp(argv[2], "shard") == 0) {
+        shard.index = strtoul(argv[3], nullptr, 10);
+        shard.count = strtoul(argv[4], nullptr, 10);
+        is_valid = shard.count > 0 && shard.index < shard.count;
+    }
+    else if(argc == 4 && strcmp(argv[2], "merge") == 0) {
+        shard.count = strtoul(argv[3], nullptr, 10);
+        is_merge = true;
+        is_valid = shard.count > 0;
+    }
+    if(!is_valid) {
         cerr << "Usage: "
              << argv[0]
-             << " <path_to_config>"
+             << " <path_to_config> [shard <index> <count> | merge <count>]"
+             << "\n"
+             << "       "
+             << argv[0]
+             << " serve <job_dir>"
              << "\n";
         return 0;
     }
 
 #if DEBUG_BUILD
-    playground(argv[1]);
+    playground(argv[1], shard, is_merge, nullptr);
 #else
     try {
-        playground(argv[1]);
+        playground(argv[1], shard, is_merge, nullptr);
     } catch(const exception &e) {
         handle_exception(e.what());
     }
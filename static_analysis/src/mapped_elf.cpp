@@ -1,9 +1,11 @@
 
 #include "mapped_elf.h"
 
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <cstring>
+
+#include <sys/mman.h>
 
 using namespace std;
 
@@ -14,17 +16,21 @@ using namespace std;
  * If the file cannot be found or seems to be malformed, a `runtime_error`
  * exception is thrown.
  */
-MappedElf::MappedElf(const string &elf_file) {
-    ifstream file(elf_file.c_str(), ios::binary);
-    if(!file) {
-        throw runtime_error("Cannot open file " + elf_file + ".");
-    }
+MappedElf::MappedElf(const string &elf_file)
+    : _file(elf_file) {
 
-    _buffer = vector<char>(istreambuf_iterator<char>(file),
-                           istreambuf_iterator<char>());
-    _e_header = reinterpret_cast<ElfW(Ehdr)*>(_buffer.data());
-    _p_header = reinterpret_cast<ElfW(Phdr)*>(_buffer.data() +
-                                              _e_header->e_phoff);
+    const uint8_t *data = _file.data();
+    if(_file.size() < sizeof(ElfW(Ehdr))) {
+        throw runtime_error("Malformed input file " + elf_file + ".");
+    }
+    _e_header = reinterpret_cast<const ElfW(Ehdr)*>(data);
+    if(_e_header->e_phoff > _file.size()
+       || _e_header->e_phnum * sizeof(ElfW(Phdr))
+          > _file.size() - _e_header->e_phoff) {
+        throw runtime_error("Malformed input file " + elf_file + ".");
+    }
+    _p_header = reinterpret_cast<const ElfW(Phdr)*>(data +
+                                                    _e_header->e_phoff);
 
     // FIXME: We rely on compilers a bit here, this can be generalized.
     for(auto i = 0; i < _e_header->e_phnum; ++i) {
@@ -39,6 +45,24 @@ MappedElf::MappedElf(const string &elf_file) {
     if(!_size) {
         throw runtime_error("Malformed input file " + elf_file + ".");
     }
+
+    // Section headers are only needed by the native import of the .plt
+    // and .got entries, hence files without them are accepted.
+    if(_e_header->e_shoff
+       && _e_header->e_shentsize == sizeof(ElfW(Shdr))
+       && _e_header->e_shoff <= _file.size()
+       && _e_header->e_shnum * sizeof(ElfW(Shdr))
+          <= _file.size() - _e_header->e_shoff) {
+        _s_header = reinterpret_cast<const ElfW(Shdr)*>(data +
+                                                        _e_header->e_shoff);
+        _num_sections = _e_header->e_shnum;
+        _section_names = get_section(
+                              static_cast<uint32_t>(_e_header->e_shstrndx));
+    }
+
+    // The executable segment is read by the initial translation of all
+    // functions, hence start reading it ahead.
+    _file.advise(0, _size, MADV_WILLNEED);
 }
 
 /*!
@@ -53,6 +77,49 @@ const uint8_t *MappedElf::operator[](const uintptr_t address) const {
         return nullptr;
     }
 
-    const uint8_t *data = reinterpret_cast<const uint8_t*>(_buffer.data());
-    return data + address - _base;
+    return _file.data() + address - _base;
+}
+
+const ElfW(Shdr) *MappedElf::get_section(uint32_t idx) const {
+    if(idx >= _num_sections) {
+        return nullptr;
+    }
+    return &_s_header[idx];
+}
+
+const ElfW(Shdr) *MappedElf::get_section(const string &name) const {
+    if(_section_names == nullptr) {
+        return nullptr;
+    }
+    const char *names = reinterpret_cast<const char*>(
+                                           get_section_data(*_section_names));
+    if(names == nullptr) {
+        return nullptr;
+    }
+
+    for(uint32_t i = 0; i < _num_sections; i++) {
+        const ElfW(Shdr) &section = _s_header[i];
+        if(section.sh_name >= _section_names->sh_size) {
+            continue;
+        }
+
+        // Names are only compared within the bounds of the string table.
+        size_t max_len = _section_names->sh_size - section.sh_name;
+        if(name.size() < max_len
+           && strncmp(names + section.sh_name,
+                      name.c_str(),
+                      name.size() + 1) == 0) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+const uint8_t *MappedElf::get_section_data(const ElfW(Shdr) &section) const {
+    if(section.sh_type == SHT_NOBITS
+       || section.sh_offset > _file.size()
+       || section.sh_size > _file.size() - section.sh_offset) {
+        return nullptr;
+    }
+    return _file.data() + section.sh_offset;
 }
@@ -0,0 +1,90 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/*!
+ * \brief Constructs a new `MappedFile` instance from a given file.
+ * \param file_name The path to the file which is to be mapped.
+ *
+ * If the file cannot be opened or mapped, a `runtime_error` exception is
+ * thrown.
+ */
+MappedFile::MappedFile(const string &file_name) {
+    _fd = open(file_name.c_str(), O_RDONLY);
+    if(_fd == -1) {
+        throw runtime_error("Cannot open file " + file_name + ".");
+    }
+
+    struct stat file_stat;
+    if(fstat(_fd, &file_stat) == -1) {
+        close(_fd);
+        throw runtime_error("Cannot stat file " + file_name + ".");
+    }
+    _size = file_stat.st_size;
+
+    // Mapping an empty file is not possible.
+    if(!_size) {
+        return;
+    }
+
+    void *mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if(mapping == MAP_FAILED) {
+        close(_fd);
+        throw runtime_error("Cannot map file " + file_name + ".");
+    }
+    _data = static_cast<const uint8_t*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    if(_data) {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+    if(_fd != -1) {
+        close(_fd);
+    }
+}
+
+void MappedFile::advise(size_t offset, size_t length, int advice) const {
+    if(!_data || offset >= _size) {
+        return;
+    }
+    if(length > _size - offset) {
+        length = _size - offset;
+    }
+
+    // The range has to start at a page boundary.
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t aligned_offset = offset - (offset % page_size);
+    madvise(const_cast<uint8_t*>(_data) + aligned_offset,
+            length + (offset - aligned_offset),
+            advice);
+}
+
+bool MappedFile::exists(const string &file_name) {
+    return access(file_name.c_str(), R_OK) == 0;
+}
+
+uint64_t hash_file(const string &file_name) {
+    if(!MappedFile::exists(file_name)) {
+        return 0;
+    }
+
+    MappedFile file(file_name);
+    const uint8_t *data = file.data();
+
+    uint64_t hash = 0xcbf29ce484222325;
+    for(size_t i = 0; i < file.size(); i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3;
+    }
+
+    // Distinguish an existing empty file from a missing one.
+    return hash ? hash : 1;
+}
@@ -1,11 +1,12 @@
 
 #include "mapped_pe.h"
 
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <cstring>
 
+#include <sys/mman.h>
+
 using namespace std;
 
 /*!
@@ -15,53 +16,78 @@ using namespace std;
  * If the file cannot be found or seems to be malformed, a `runtime_error`
  * exception is thrown.
  */
-MappedPe::MappedPe(const string &pe_file) {
-    ifstream file(pe_file.c_str(), ios::binary);
-    if(!file) {
-        throw runtime_error("Cannot open file " + pe_file + ".");
-    }
-
-    _buffer = vector<char>(istreambuf_iterator<char>(file),
-                           istreambuf_iterator<char>());
+MappedPe::MappedPe(const string &pe_file)
+    : _file(pe_file) {
 
+    const char *data = reinterpret_cast<const char*>(_file.data());
+    if(_file.size() < sizeof(mz_hdr)) {
+        throw runtime_error("Malformed input file " + pe_file + ".");
+    }
 
-    _mz_header = reinterpret_cast<mz_hdr*>(_buffer.data());
+    _mz_header = reinterpret_cast<const mz_hdr*>(data);
     if(_mz_header->magic != MZ_MAGIC) {
         throw runtime_error("Malformed input file " + pe_file + ".");
     }
 
-    _pe_header = reinterpret_cast<pe_hdr*>(_buffer.data() + _mz_header->peaddr);
+    if(_mz_header->peaddr > _file.size()
+       || sizeof(pe_hdr) + sizeof(uint16_t)
+          > _file.size() - _mz_header->peaddr) {
+        throw runtime_error("Malformed input file " + pe_file + ".");
+    }
+    _pe_header = reinterpret_cast<const pe_hdr*>(data + _mz_header->peaddr);
     if(_pe_header->magic != PE_MAGIC) {
         throw runtime_error("Malformed input file " + pe_file + ".");
     }
 
     // Magic value for optional header lies directly behind PE header.
-    uint16_t *opt_hdr_magic = reinterpret_cast<uint16_t*>(_buffer.data()
+    const uint16_t *opt_hdr_magic = reinterpret_cast<const uint16_t*>(data
                                                           + _mz_header->peaddr
                                                           + sizeof(pe_hdr));
 
     if(*opt_hdr_magic == IMAGE_FILE_OPT_PE32_MAGIC) {
-        _pe32_opt_header = reinterpret_cast<pe32_opt_hdr*>(_buffer.data()
+        _pe32_opt_header = reinterpret_cast<const pe32_opt_hdr*>(data
                                                            + _mz_header->peaddr
                                                            + sizeof(pe_hdr));
     }
     else if(*opt_hdr_magic == IMAGE_FILE_OPT_PE32_PLUS_MAGIC) {
-        _pe32_plus_opt_header = reinterpret_cast<pe32plus_opt_hdr*>(
-                                                            _buffer.data()
+        _pe32_plus_opt_header = reinterpret_cast<const pe32plus_opt_hdr*>(
+                                                            data
                                                             + _mz_header->peaddr
                                                             + sizeof(pe_hdr));
+
+        // The data directory lies directly behind the optional header.
+        uint64_t dir_offset = _mz_header->peaddr
+                              + sizeof(pe_hdr)
+                              + sizeof(pe32plus_opt_hdr);
+        if(_pe32_plus_opt_header->data_dirs * sizeof(data_dirent)
+              >= sizeof(data_directory)
+           && sizeof(pe32plus_opt_hdr) + sizeof(data_directory)
+              <= _pe_header->opt_hdr_size
+           && dir_offset + sizeof(data_directory) <= _file.size()) {
+            _data_directory = reinterpret_cast<const data_directory*>(
+                                                          data + dir_offset);
+        }
     }
     else {
         throw runtime_error("Malformed input file " + pe_file + ".");
     }
 
+    uint64_t section_headers_offset = _mz_header->peaddr
+                                      + sizeof(pe_hdr)
+                                      + _pe_header->opt_hdr_size;
+    if(section_headers_offset
+       + _pe_header->sections * sizeof(section_header) > _file.size()) {
+        throw runtime_error("Malformed input file " + pe_file + ".");
+    }
+    _section_headers = reinterpret_cast<const section_header*>(
+                                              data + section_headers_offset);
+    _num_sections = _pe_header->sections;
+
     for(uint32_t i = 0; i < _pe_header->sections; i++) {
-        _text_section_header = reinterpret_cast<section_header*>(
-                                                  _buffer.data()
-                                                  + _mz_header->peaddr
-                                                  + sizeof(pe_hdr)
-                                                  + _pe_header->opt_hdr_size
-                                                  + (i*sizeof(section_header)));
+        uint64_t section_offset = section_headers_offset
+                                  + (i*sizeof(section_header));
+        _text_section_header = reinterpret_cast<const section_header*>(
+                                                       data + section_offset);
 
         // FIXME: We rely on compilers a bit here, this can be generalized.
         if(strcmp(_text_section_header->name, ".text") == 0) {
@@ -76,6 +102,10 @@ MappedPe::MappedPe(const string &pe_file) {
     if(!_size) {
         throw runtime_error("Malformed input file " + pe_file + ".");
     }
+
+    // The text section is read by the initial translation of all
+    // functions, hence start reading it ahead.
+    _file.advise(_file_addr, _size, MADV_WILLNEED);
 }
 
 
@@ -91,7 +121,21 @@ const uint8_t *MappedPe::operator[](const uintptr_t address) const {
         return nullptr;
     }
 
-    const uint8_t *data = reinterpret_cast<const uint8_t*>(_buffer.data());
+    return _file.data() + address - _base + _file_addr;
+}
 
-    return data + address - _base + _file_addr;
+const uint8_t *MappedPe::get_rva_data(uint32_t rva, size_t size) const {
+    for(uint32_t i = 0; i < _num_sections; i++) {
+        const section_header &section = _section_headers[i];
+        if(rva < section.virtual_address) {
+            continue;
+        }
+        uint64_t offset = rva - section.virtual_address;
+        if(offset + size > section.raw_data_size
+           || section.data_addr + offset + size > _file.size()) {
+            continue;
+        }
+        return _file.data() + section.data_addr + offset;
+    }
+    return nullptr;
 }
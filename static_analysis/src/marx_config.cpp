@@ -0,0 +1,272 @@
+#include "marx_config.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+MarxConfig parse_config(const string &config_file) {
+
+    // Parse config file.
+    ifstream file(config_file);
+    if(!file) {
+        throw runtime_error("Opening config file failed.");
+    }
+
+    MarxConfig config;
+    string file_format_str;
+
+    string line;
+    while(getline(file, line)) {
+        istringstream parser(line);
+
+        string option;
+        parser >> option;
+        if(parser.fail()) {
+            throw runtime_error("Parsing config file failed.");
+        }
+        transform(option.begin(),
+                  option.end(),
+                  option.begin(),
+                  ::toupper);
+
+        if(option == "MODULENAME") {
+            string module_name;
+            parser >> module_name;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+            if(config.modules.empty()
+               || !config.modules.back().module_name.empty()) {
+                config.modules.emplace_back();
+            }
+            config.modules.back().module_name = module_name;
+        }
+        else if(option == "TARGETDIR") {
+            string target_dir;
+            parser >> target_dir;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+            if(config.modules.empty()
+               || !config.modules.back().target_dir.empty()) {
+                config.modules.emplace_back();
+            }
+            config.modules.back().target_dir = target_dir;
+        }
+        else if(option == "NEWOPERATORS") {
+            uint32_t number;
+            parser >> dec >> number;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+            if(config.modules.empty()) {
+                config.modules.emplace_back();
+            }
+            for(uint32_t i = 0; i < number; i++) {
+                uint64_t new_op_addr;
+                parser >> hex >> new_op_addr;
+                if(parser.fail()) {
+                    throw runtime_error("Parsing config file failed.");
+                }
+                config.modules.back().new_operators.insert(new_op_addr);
+            }
+        }
+        else if(option == "EXTERNALMODULES") {
+            uint32_t number;
+            parser >> dec >> number;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+            for(uint32_t i = 0; i < number; i++) {
+                string ext_module;
+                parser >> ext_module;
+                if(parser.fail()) {
+                    throw runtime_error("Parsing config file failed.");
+                }
+                config.ext_modules.push_back(ext_module);
+            }
+        }
+        else if(option == "FORMAT") {
+            parser >> file_format_str;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+            transform(file_format_str.begin(),
+                      file_format_str.end(),
+                      file_format_str.begin(),
+                      ::toupper);
+            if(file_format_str == "PE64") {
+                config.file_format = FileFormatPE64;
+            }
+            else if(file_format_str == "ELF64") {
+                config.file_format = FileFormatELF64;
+            }
+            else {
+                throw runtime_error("Format not known.");
+            }
+        }
+        else if(option == "NUMTHREADS") {
+            parser >> dec >> config.num_threads;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "ONDEMAND") {
+            parser >> dec >> config.on_demand;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "ANALYSISCACHE") {
+            parser >> dec >> config.use_analysis_cache;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "INCREMENTAL") {
+            parser >> dec >> config.use_incremental;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "CHECKPOINT") {
+            parser >> dec >> config.checkpoint_interval;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "BUDGET") {
+            parser >> dec >> config.budget_limits.max_seconds
+                   >> dec >> config.budget_limits.max_graph_nodes
+                   >> dec >> config.budget_limits.max_paths;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "NUMA") {
+            parser >> dec >> config.numa_mode;
+            if(parser.fail() || config.numa_mode > NumaPinThreadsInterleave) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "STATEBACKEND") {
+            parser >> dec >> config.state_backend;
+            if(parser.fail() || config.state_backend > StateBackendFlat) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "INSTRUMENTATION") {
+            parser >> dec >> config.use_instrumentation;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "RESULTSTREAM") {
+            parser >> dec >> config.result_stream_mode;
+            if(parser.fail() || config.result_stream_mode > ResultStreamText) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "NATIVETABLES") {
+            parser >> dec >> config.native_tables;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "NATIVEXREFS") {
+            parser >> dec >> config.native_xrefs;
+            if(parser.fail() || config.native_xrefs > NativeXrefsReplace) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "TIERING") {
+            parser >> dec >> config.tiering;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "LAZYEXTMODULES") {
+            parser >> dec >> config.lazy_ext_modules;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "SUMMARYSTORE") {
+            parser >> config.summary_store_dir;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "DYNAMICVCALLS") {
+            parser >> config.dynamic_vcalls_dir;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "LOGLEVEL") {
+            parser >> dec >> config.log_level;
+            if(parser.fail() || config.log_level >= LogLevelNum) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "PROGRESSINTERVAL") {
+            parser >> dec >> config.progress_interval_ms;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+        }
+        else if(option == "GRAPHCAPTURE") {
+            uint32_t number;
+            parser >> dec >> config.graph_capture_stages >> number;
+            if(parser.fail()
+               || config.graph_capture_stages > GraphCaptureAllStages) {
+                throw runtime_error("Parsing config file failed.");
+            }
+            for(uint32_t i = 0; i < number; i++) {
+                uint64_t start_addr;
+                parser >> hex >> start_addr;
+                if(parser.fail()) {
+                    throw runtime_error("Parsing config file failed.");
+                }
+                config.graph_capture_addrs.insert(start_addr);
+            }
+        }
+        else if(option == "VTVVERIFY") {
+            uint32_t number;
+            parser >> dec >> number;
+            if(parser.fail()) {
+                throw runtime_error("Parsing config file failed.");
+            }
+            if(config.modules.empty()) {
+                config.modules.emplace_back();
+            }
+            for(uint32_t i = 0; i < number; i++) {
+                uint64_t vtv_verify_addr;
+                parser >> hex >> vtv_verify_addr;
+                if(parser.fail()) {
+                    throw runtime_error("Parsing config file failed.");
+                }
+                config.modules.back().vtv_verify_addrs.insert(
+                                                           vtv_verify_addr);
+            }
+        }
+        else {
+            throw runtime_error("Config option not known.");
+        }
+    }
+
+    if(config.modules.empty()) {
+        throw runtime_error("Config contains no module.");
+    }
+    for(const MarxModuleConfig &module : config.modules) {
+        if(module.module_name.empty() || module.target_dir.empty()) {
+            throw runtime_error("Config contains module without "\
+                                "MODULENAME or TARGETDIR.");
+        }
+    }
+
+    return config;
+}
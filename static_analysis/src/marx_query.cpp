@@ -0,0 +1,324 @@
+#include "marx_query.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "translator.h"
+#include "mapped_elf.h"
+#include "module_plt.h"
+#include "external_functions.h"
+#include "vtable_hierarchy.h"
+#include "ssa.h"
+#include "function_xrefs.h"
+#include "analysis_cache.h"
+#include "object_allocations.h"
+
+using namespace std;
+
+
+static const MarxModuleConfig &get_module_config(const MarxConfig &config,
+                                                 size_t module_idx) {
+    if(module_idx >= config.modules.size()) {
+        throw runtime_error("Module index exceeds modules of config.");
+    }
+    return config.modules[module_idx];
+}
+
+
+MarxQuery::MarxQuery(const MarxConfig &config, size_t module_idx)
+    : _config(config),
+      _module(get_module_config(config, module_idx)),
+      _module_name(_module.module_name),
+      _target_file(_module.target_dir + "/" + _module.module_name) {
+}
+
+
+MarxQuery::~MarxQuery() {
+    _vtable_hierarchies.reset();
+    _translator.reset();
+    if(_restore_vex) {
+        Vex::get_instance().set_iropt_register_updates_default(
+                                                _orig_iropt_register_updates);
+    }
+}
+
+
+void MarxQuery::load_translator() {
+    if(_translator) {
+        return;
+    }
+
+    // Same translation settings as the full analysis
+    // (\see `analyze_module`).
+    Vex &vex = Vex::get_instance();
+    if(!_restore_vex) {
+        _orig_iropt_register_updates = vex.get_iropt_register_updates_default();
+        _restore_vex = true;
+    }
+    vex.set_iropt_register_updates_default(VexRegUpdAllregsAtEachInsn);
+
+    unique_ptr<Translator> translator(new Translator(vex,
+                                                     _target_file,
+                                                     _config.file_format,
+                                                     _config.on_demand != 0,
+                                                     _config.num_threads));
+
+    AnalysisCache analysis_cache(_target_file);
+    bool cache_hit = false;
+    if(_config.use_analysis_cache && analysis_cache.is_valid()) {
+        cache_hit = analysis_cache.import_cache(*translator);
+    }
+    if(!cache_hit) {
+        ModuleSSA ssa;
+        if(!ssa.parse(_target_file,
+                      *translator,
+                      _config.num_threads,
+                      nullptr)) {
+            throw runtime_error("Cannot parse ssa files "
+                                + _target_file + ".");
+        }
+        ModuleFunctionXrefs func_xrefs;
+        if(!func_xrefs.parse(_target_file, *translator)) {
+            throw runtime_error("Cannot parse function xref files "
+                                + _target_file + ".");
+        }
+    }
+    translator->finalize(_config.num_threads);
+
+    _translator = move(translator);
+}
+
+
+void MarxQuery::load_vtables() {
+    if(_vtable_hierarchies) {
+        return;
+    }
+
+    const FileFormatType file_format = _config.file_format;
+    const vector<string> &ext_modules = _config.ext_modules;
+    const uint32_t use_analysis_cache = _config.use_analysis_cache;
+
+    // Reading the .plt entries natively needs the mapped module.
+    const MappedElf *mapped_elf = nullptr;
+    if(_config.native_tables && file_format == FileFormatELF64) {
+        load_translator();
+        mapped_elf = dynamic_cast<const MappedElf*>(
+                                                &_translator->get_memory());
+    }
+
+    _vtable_file.reset(new VTableFile(_module_name, file_format));
+    VTableModule vtable_module;
+    if(!VTableFile::read_module(_target_file,
+                                use_analysis_cache,
+                                vtable_module)
+       || !_vtable_file->add_module(vtable_module)) {
+        throw runtime_error("Cannot parse vtables file "
+                            + _target_file + ".");
+    }
+    _external_funcs.reset(new ExternalFunctions());
+    for(const string &ext_module : ext_modules) {
+        VTableModule ext_vtable_module;
+        if(!VTableFile::read_module(ext_module,
+                                    use_analysis_cache,
+                                    ext_vtable_module)
+           || !_vtable_file->add_module(ext_vtable_module)) {
+            throw runtime_error("Cannot parse vtables file '"
+                                + ext_module + "'.");
+        }
+        ExternalFunctionVector ext_funcs;
+        if(!ExternalFunctions::read_module(ext_module, ext_funcs)) {
+            throw runtime_error("Cannot parse external functions file '"
+                                + ext_module + "'.");
+        }
+        _external_funcs->add_module(ext_funcs);
+    }
+    _vtable_file->finalize(_config.num_threads);
+    _external_funcs->finalize();
+
+    _module_plt.reset(new ModulePlt(_module_name));
+    switch(file_format) {
+        case FileFormatELF64:
+            if(mapped_elf != nullptr) {
+                if(!_module_plt->parse(*mapped_elf)) {
+                    throw runtime_error("Cannot read .plt entries of module "
+                                        + _target_file + ".");
+                }
+            }
+            else if(!_module_plt->parse(_target_file)) {
+                throw runtime_error("Cannot parse module plt file "
+                                    + _target_file + ".");
+            }
+            break;
+        case FileFormatPE64:
+            break;
+        default:
+            throw runtime_error("Do not know how to "\
+                                "handle file format.");
+    }
+
+    _funcs_blacklist = import_blacklist_funcs(_target_file);
+
+    unique_ptr<VTableHierarchies> vtable_hierarchies(
+                                   new VTableHierarchies(file_format,
+                                                         *_vtable_file,
+                                                         _module_name,
+                                                         *_external_funcs,
+                                                         *_module_plt,
+                                                         _funcs_blacklist,
+                                                         -1));
+    vtable_hierarchies->import_hierarchy(_target_file, use_analysis_cache);
+    for(const string &ext_module : ext_modules) {
+        HierarchiesVTable ext_hierarchies;
+        vtable_hierarchies->read_hierarchy(ext_module,
+                                           use_analysis_cache,
+                                           ext_hierarchies);
+        vtable_hierarchies->update_hierarchy(ext_hierarchies, false);
+    }
+    vtable_hierarchies->merge_hierarchies();
+
+    _vtable_hierarchies = move(vtable_hierarchies);
+}
+
+
+void MarxQuery::load_object_allocations() {
+    if(_obj_allocs_loaded) {
+        return;
+    }
+    load_vtables();
+    load_translator();
+
+    ObjectAllocationFile obj_alloc_file(_module_name);
+    object_allocation_analysis(_module_name,
+                               *_vtable_file,
+                               *_translator,
+                               Vex::get_instance(),
+                               obj_alloc_file,
+                               _config.num_threads);
+
+    for(const auto &kv : obj_alloc_file.get_object_allocations()) {
+        for(uint32_t vtbl_idx : kv.second.vtbl_idxs) {
+            _obj_alloc_sites[vtbl_idx].push_back(kv.first);
+        }
+    }
+    for(auto &kv : _obj_alloc_sites) {
+        sort(kv.second.begin(), kv.second.end());
+    }
+    _obj_allocs_loaded = true;
+}
+
+
+void MarxQuery::load_vcalls() {
+    if(_vcalls_loaded) {
+        return;
+    }
+    load_vtables();
+
+    // Format of `VCallFile::export_vcalls`:
+    // <module_name>
+    // <icall_addr> <module_name>:<vtbl_addr> ...
+    const string vcalls_file = _target_file + ".vcalls";
+    ifstream file(vcalls_file);
+    if(!file) {
+        throw runtime_error("Cannot open vcalls file " + vcalls_file + ".");
+    }
+
+    string line;
+    getline(file, line);
+    while(getline(file, line)) {
+        istringstream parser(line);
+        uint64_t icall_addr;
+        parser >> hex >> icall_addr;
+        if(parser.fail()) {
+            continue;
+        }
+
+        VTablePtrVector &allowed_vtables = _vcalls[icall_addr];
+        string vtbl_str;
+        while(parser >> vtbl_str) {
+            size_t pos = vtbl_str.rfind(':');
+            if(pos == string::npos) {
+                throw runtime_error("Parsing vcalls file failed.");
+            }
+            uint64_t vtbl_addr = strtoull(vtbl_str.c_str() + pos + 1,
+                                          nullptr,
+                                          16);
+            const VTable *vtbl_ptr = _vtable_file->get_vtable_ptr(
+                                                      vtbl_str.substr(0, pos),
+                                                      vtbl_addr);
+            if(vtbl_ptr != nullptr) {
+                allowed_vtables.push_back(vtbl_ptr);
+            }
+        }
+    }
+    _vcalls_loaded = true;
+}
+
+
+const VTable *MarxQuery::get_vtable(const string &module_name,
+                                    uint64_t addr) {
+    lock_guard<mutex> lock(_mtx);
+    load_vtables();
+    return _vtable_file->get_vtable_ptr(module_name, addr);
+}
+
+
+bool MarxQuery::get_hierarchy(const string &module_name,
+                              uint64_t vtbl_addr,
+                              VTablePtrVector &hierarchy) {
+    lock_guard<mutex> lock(_mtx);
+    load_vtables();
+
+    hierarchy.clear();
+    const VTable *vtbl_ptr = _vtable_file->get_vtable_ptr(module_name,
+                                                          vtbl_addr);
+    if(vtbl_ptr == nullptr) {
+        return false;
+    }
+    const DependentVTables *dependent_vtables =
+                            _vtable_hierarchies->get_hierarchy(vtbl_ptr->index);
+    if(dependent_vtables == nullptr) {
+        hierarchy.push_back(vtbl_ptr);
+        return true;
+    }
+    for(uint32_t vtbl_idx : *dependent_vtables) {
+        hierarchy.push_back(&_vtable_file->get_vtable(vtbl_idx));
+    }
+    return true;
+}
+
+
+bool MarxQuery::get_allocation_sites(uint64_t vtbl_addr,
+                                     vector<uint64_t> &alloc_sites) {
+    lock_guard<mutex> lock(_mtx);
+    load_object_allocations();
+
+    alloc_sites.clear();
+    const VTable *vtbl_ptr = _vtable_file->get_vtable_ptr(
+                                              _vtable_file->get_this_module_id(),
+                                              vtbl_addr);
+    if(vtbl_ptr == nullptr) {
+        return false;
+    }
+    const auto it = _obj_alloc_sites.find(vtbl_ptr->index);
+    if(it != _obj_alloc_sites.cend()) {
+        alloc_sites = it->second;
+    }
+    return true;
+}
+
+
+bool MarxQuery::get_allowed_vtables(uint64_t icall_addr,
+                                    VTablePtrVector &allowed_vtables) {
+    lock_guard<mutex> lock(_mtx);
+    load_vcalls();
+
+    allowed_vtables.clear();
+    const auto it = _vcalls.find(icall_addr);
+    if(it == _vcalls.cend()) {
+        return false;
+    }
+    allowed_vtables = it->second;
+    return true;
+}
@@ -1,5 +1,10 @@
 
 #include "module_plt.h"
+#include "external_functions.h"
+#include "mapped_elf.h"
+
+#include <algorithm>
+#include <cstring>
 
 
 using namespace std;
@@ -11,6 +16,49 @@ ModulePlt::ModulePlt(const string &module_name)
 }
 
 
+void ModulePlt::add_entry(uint64_t addr, const string &func_name) {
+    PltEntry plt_entry;
+    plt_entry.addr = addr;
+    plt_entry.func_name = func_name;
+    plt_entry.name_id = ExternalFunctions::intern_name(func_name);
+    _plt_entries.push_back(plt_entry);
+}
+
+
+void ModulePlt::finalize() {
+
+    // Sort the entries by address (the last added entry of an address wins).
+    stable_sort(_plt_entries.begin(),
+                _plt_entries.end(),
+                [](const PltEntry &a, const PltEntry &b) {
+                    return a.addr < b.addr;
+                });
+    PltMap entries;
+    entries.reserve(_plt_entries.size());
+    for(PltEntry &plt_entry : _plt_entries) {
+        if(!entries.empty() && entries.back().addr == plt_entry.addr) {
+            entries.back() = move(plt_entry);
+            continue;
+        }
+        entries.push_back(move(plt_entry));
+    }
+    _plt_entries = move(entries);
+
+    // Build the lookup table of the function names (a name is resolved to
+    // the entry with the lowest address).
+    _plt_entries_names.clear();
+    for(const PltEntry &plt_entry : _plt_entries) {
+        if(plt_entry.name_id >= _plt_entries_names.size()) {
+            _plt_entries_names.resize(plt_entry.name_id + 1, nullptr);
+        }
+        const PltEntry *&name_entry = _plt_entries_names[plt_entry.name_id];
+        if(name_entry == nullptr) {
+            name_entry = &plt_entry;
+        }
+    }
+}
+
+
 bool ModulePlt::parse(const string &plt_file) {
 
     ifstream file(plt_file + "_plt.txt");
@@ -51,30 +99,101 @@ bool ModulePlt::parse(const string &plt_file) {
             return false;
         }
 
-        PltEntry plt_entry;
-        plt_entry.addr = func_addr;
-        plt_entry.func_name = func_name;
+        add_entry(func_addr, func_name);
+    }
+
+    finalize();
+    return true;
+}
+
+
+bool ModulePlt::parse(const MappedElf &elf) {
 
-        _plt_entries[func_addr] = plt_entry;
+    const ElfW(Shdr) *rela_plt = elf.get_section(".rela.plt");
+    if(rela_plt == nullptr) {
+        return false;
+    }
+    const ElfW(Shdr) *dynsym = elf.get_section(rela_plt->sh_link);
+    if(dynsym == nullptr) {
+        return false;
+    }
+    const ElfW(Shdr) *dynstr = elf.get_section(dynsym->sh_link);
+    if(dynstr == nullptr) {
+        return false;
+    }
+
+    const auto *relocs = reinterpret_cast<const ElfW(Rela)*>(
+                                                elf.get_section_data(*rela_plt));
+    const auto *symbols = reinterpret_cast<const ElfW(Sym)*>(
+                                                elf.get_section_data(*dynsym));
+    const char *names = reinterpret_cast<const char*>(
+                                                elf.get_section_data(*dynstr));
+    if(relocs == nullptr || symbols == nullptr || names == nullptr) {
+        return false;
+    }
+    uint64_t num_relocs = rela_plt->sh_size / sizeof(ElfW(Rela));
+    uint64_t num_symbols = dynsym->sh_size / sizeof(ElfW(Sym));
+
+    // With IBT the stubs that are called reside in .plt.sec, otherwise
+    // they follow the initial resolver stub in .plt.
+    uint64_t stubs_addr;
+    uint64_t stub_size;
+    const ElfW(Shdr) *plt_sec = elf.get_section(".plt.sec");
+    if(plt_sec != nullptr) {
+        stub_size = plt_sec->sh_entsize ? plt_sec->sh_entsize : 16;
+        stubs_addr = plt_sec->sh_addr;
+    }
+    else {
+        const ElfW(Shdr) *plt = elf.get_section(".plt");
+        if(plt == nullptr) {
+            return false;
+        }
+        stub_size = plt->sh_entsize ? plt->sh_entsize : 16;
+        stubs_addr = plt->sh_addr + stub_size;
+    }
+
+    for(uint64_t i = 0; i < num_relocs; i++) {
+        const ElfW(Rela) &reloc = relocs[i];
+        if(ELF64_R_TYPE(reloc.r_info) != R_X86_64_JUMP_SLOT) {
+            continue;
+        }
+
+        uint64_t sym_idx = ELF64_R_SYM(reloc.r_info);
+        if(sym_idx == 0 || sym_idx >= num_symbols) {
+            continue;
+        }
+        const ElfW(Sym) &symbol = symbols[sym_idx];
+        if(symbol.st_name >= dynstr->sh_size) {
+            return false;
+        }
+        const char *name = names + symbol.st_name;
+        size_t name_len = strnlen(name, dynstr->sh_size - symbol.st_name);
+        if(name_len == 0) {
+            continue;
+        }
+
+        add_entry(stubs_addr + i * stub_size, string(name, name_len));
     }
 
+    finalize();
     return true;
 }
 
 
 const PltEntry* ModulePlt::get_plt_entry(uint64_t addr) const {
-    if(_plt_entries.find(addr) == _plt_entries.cend()) {
+    const auto it = lower_bound(_plt_entries.cbegin(),
+                                _plt_entries.cend(),
+                                addr,
+                                [](const PltEntry &entry, uint64_t value) {
+                                    return entry.addr < value;
+                                });
+    if(it == _plt_entries.cend() || it->addr != addr) {
         return nullptr;
     }
-    return &(_plt_entries.at(addr));
+    return &(*it);
 }
 
 
-const PltEntry* ModulePlt::get_plt_entry(const string func_name) const {
-    for(const auto &kv : _plt_entries) {
-        if(kv.second.func_name == func_name) {
-            return &(kv.second);
-        }
-    }
-    return nullptr;
+const PltEntry* ModulePlt::get_plt_entry(const string &func_name) const {
+    return get_plt_entry_by_id(ExternalFunctions::find_name(func_name));
 }
@@ -36,9 +36,6 @@ void NewOperators::export_new_operators(const string &target_dir) {
 
     new_op_file << _module_name << "\n";
 
-    const HierarchiesVTable &vtbl_hierarchies =
-                                        _vtable_hierarchies.get_hierarchies();
-
     for(const auto &new_op : _op_new_candidates) {
         unordered_set<uint32_t> possible_vtables;
         for(uint32_t idx : new_op.second.vtbl_idxs) {
@@ -46,12 +43,11 @@ void NewOperators::export_new_operators(const string &target_dir) {
             // Copy also the whole vtable hierarchy into the possible
             // vtable set.
             if(possible_vtables.find(idx) == possible_vtables.cend()) {
-                for(const auto &dep_vtables : vtbl_hierarchies) {
-                    if(dep_vtables.find(idx) != dep_vtables.cend()) {
-                        for(uint32_t dep_vtbl_idx : dep_vtables) {
-                            possible_vtables.insert(dep_vtbl_idx);
-                        }
-                        break;
+                const DependentVTables *dep_vtables =
+                                        _vtable_hierarchies.get_hierarchy(idx);
+                if(dep_vtables != nullptr) {
+                    for(uint32_t dep_vtbl_idx : *dep_vtables) {
+                        possible_vtables.insert(dep_vtbl_idx);
                     }
                 }
             }
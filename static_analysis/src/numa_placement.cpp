@@ -0,0 +1,153 @@
+#include "numa_placement.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+using namespace std;
+
+NumaPlacement &NumaPlacement::get_instance() {
+    static NumaPlacement instance;
+    return instance;
+}
+
+/*!
+ * \brief Parses a cpu list like `0-11,48-59`.
+ */
+static bool parse_cpu_list(const string &cpu_list, vector<uint32_t> &cpus) {
+    istringstream parser(cpu_list);
+    string range;
+    while(getline(parser, range, ',')) {
+        uint32_t first;
+        uint32_t last;
+        char separator;
+        istringstream range_parser(range);
+        range_parser >> dec >> first;
+        if(range_parser.fail()) {
+            return false;
+        }
+        last = first;
+        if(range_parser >> separator) {
+            range_parser >> dec >> last;
+            if(range_parser.fail() || separator != '-' || last < first) {
+                return false;
+            }
+        }
+        for(uint32_t cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return true;
+}
+
+void NumaPlacement::read_topology() {
+    _node_cpus.clear();
+    for(uint32_t node = 0; ; node++) {
+        ifstream file("/sys/devices/system/node/node"
+                      + to_string(node)
+                      + "/cpulist");
+        if(!file) {
+            break;
+        }
+
+        string cpu_list;
+        getline(file, cpu_list);
+        vector<uint32_t> cpus;
+        if(!parse_cpu_list(cpu_list, cpus)) {
+            cerr << "Not able to parse cpus of NUMA node "
+                 << dec << node
+                 << "."
+                 << "\n";
+            _node_cpus.clear();
+            return;
+        }
+
+        // Nodes without cpus (memory only) do not get threads.
+        if(!cpus.empty()) {
+            _node_cpus.push_back(cpus);
+        }
+    }
+}
+
+void NumaPlacement::set_mode(NumaMode mode) {
+    _mode = mode;
+    if(_mode == NumaDisabled) {
+        return;
+    }
+
+    read_topology();
+    if(_node_cpus.size() <= 1) {
+        cout << "Single NUMA node. Not placing threads."
+             << "\n";
+        _mode = NumaDisabled;
+        return;
+    }
+    cout << "Placing threads on "
+         << dec << _node_cpus.size()
+         << " NUMA nodes."
+         << "\n";
+}
+
+/*!
+ * \brief Interleaves the memory allocated by the calling thread over all
+ * nodes until `end_shared_allocations` is called.
+ */
+void NumaPlacement::begin_shared_allocations() const {
+    if(_mode != NumaPinThreadsInterleave) {
+        return;
+    }
+
+    // All nodes allowed (the kernel ignores nodes that do not exist).
+    unsigned long node_mask = ~0UL;
+    if(syscall(SYS_set_mempolicy,
+               MPOL_INTERLEAVE,
+               &node_mask,
+               sizeof(node_mask) * 8) != 0) {
+        cerr << "Not able to interleave memory over NUMA nodes."
+             << "\n";
+    }
+}
+
+/*!
+ * \brief Restores the local allocation of the calling thread.
+ */
+void NumaPlacement::end_shared_allocations() const {
+    if(_mode != NumaPinThreadsInterleave) {
+        return;
+    }
+    syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+}
+
+/*!
+ * \brief Pins the calling worker thread to one core. Consecutive thread
+ * numbers are placed on different nodes so that any number of threads
+ * is spread evenly.
+ */
+void NumaPlacement::pin_thread(uint32_t thread_number) const {
+    if(_mode == NumaDisabled) {
+        return;
+    }
+
+    const vector<uint32_t> &cpus =
+                           _node_cpus[thread_number % _node_cpus.size()];
+    uint32_t cpu = cpus[(thread_number / _node_cpus.size()) % cpus.size()];
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set)
+       != 0) {
+        cerr << "Not able to pin thread "
+             << dec << thread_number
+             << " to cpu "
+             << dec << cpu
+             << "."
+             << "\n";
+    }
+}
@@ -1,37 +1,77 @@
 #include "object_allocations.h"
+#include "incremental_state.h"
+#include "summary_store.h"
+#include "engels_checkpoint.h"
+#include "numa_placement.h"
+#include "logger.h"
+#include "chunked_text.h"
+
+#include <algorithm>
 
 using namespace std;
 
-queue<uint64_t> queue_vtable_addrs;
-mutex queue_vtable_addrs_mtx;
+WorkQueue queue_obj_alloc_tasks;
+
+/*!
+ * \brief All vtable xrefs inside of one function (the unit of work of the
+ * object allocation analysis).
+ */
+struct ObjectAllocationTask {
+    const Function *func;
+
+    // The vtables referenced by each xref address in the function.
+    map<uint64_t, set<const VTable*>> xrefs;
+};
+
+typedef pair<BaseInstructionSSAPtr, BaseInstructionSSAPtrs> VtablePtrStore;
 
 ObjectAllocationFile::ObjectAllocationFile(const std::string &module_name)
     : _module_name(module_name){
 }
 
+void ObjectAllocationFile::set_result_stream(ResultStream *result_stream,
+                                             const VTableFile &vtable_file) {
+    lock_guard<mutex> _(_mtx);
+
+    _result_stream = result_stream;
+    _vtable_file = &vtable_file;
+}
+
 void ObjectAllocationFile::export_object_allocations(
-                                                const std::string &target_dir) {
+                                                const std::string &target_dir,
+                                                uint32_t num_threads) {
     lock_guard<mutex> _(_mtx);
 
     stringstream temp_str;
     temp_str << target_dir << "/" << _module_name << "_obj_allocs.txt";
     string target_file = temp_str.str();
 
-    ofstream obj_alloc_file;
-    obj_alloc_file.open(target_file);
+    vector<const ObjectAllocation*> obj_allocs;
+    obj_allocs.reserve(_obj_allocs.size());
+    for(const auto &kv : _obj_allocs) {
+        obj_allocs.push_back(&kv.second);
+    }
 
-    obj_alloc_file << _module_name << "\n";
-    for(auto &kv : _obj_allocs) {
-        obj_alloc_file << hex << kv.second.addr
-                       << " ";
-        for(uint64_t xref_addr : kv.second.vtbl_xref_addrs) {
-            obj_alloc_file << hex << xref_addr
-                           << " ";
+    if(!write_chunked_text(target_file,
+                           _module_name + "\n",
+                           obj_allocs.size(),
+                           num_threads,
+                           [&](size_t begin, size_t end, string &out) {
+        for(size_t i = begin; i < end; i++) {
+            append_hex(out, obj_allocs[i]->addr);
+            out += ' ';
+            for(uint64_t xref_addr : obj_allocs[i]->vtbl_xref_addrs) {
+                append_hex(out, xref_addr);
+                out += ' ';
+            }
+            out += '\n';
         }
-        obj_alloc_file << "\n";
+    })) {
+        cerr << "Not able to write object allocations file '"
+             << target_file
+             << "'."
+             << "\n";
     }
-
-    obj_alloc_file.close();
 }
 
 const ObjectAllocationMap &ObjectAllocationFile::get_object_allocations() const {
@@ -43,14 +83,26 @@ void ObjectAllocationFile::add_object_allocation(uint64_t vtable_init_addr,
                                                  uint64_t vtbl_xref_addr) {
     lock_guard<mutex> _(_mtx);
 
+    bool is_new = false;
     if(_obj_allocs.find(vtable_init_addr) != _obj_allocs.end()) {
-        _obj_allocs[vtable_init_addr].vtbl_idxs.insert(vtbl_idx);
-        _obj_allocs[vtable_init_addr].vtbl_xref_addrs.insert(vtbl_xref_addr);
+        is_new |= _obj_allocs[vtable_init_addr].vtbl_idxs.insert(
+                                                              vtbl_idx).second;
+        is_new |= _obj_allocs[vtable_init_addr].vtbl_xref_addrs.insert(
+                                                        vtbl_xref_addr).second;
     }
     else {
         _obj_allocs[vtable_init_addr].addr = vtable_init_addr;
         _obj_allocs[vtable_init_addr].vtbl_idxs.insert(vtbl_idx);
         _obj_allocs[vtable_init_addr].vtbl_xref_addrs.insert(vtbl_xref_addr);
+        is_new = true;
+    }
+
+    if(is_new && _result_stream != nullptr) {
+        const VTable &vtable = _vtable_file->get_vtable(vtbl_idx);
+        _result_stream->add_object_allocation(vtable_init_addr,
+                                              vtable.module_name,
+                                              vtable.addr,
+                                              vtbl_xref_addr);
     }
 }
 
@@ -103,37 +155,36 @@ bool is_init_vtable_ptr_instr(const Translator &translator,
                               const BaseInstructionSSAPtrs &path,
                               Vex &vex) {
 
-    // Since we only create basic blocks with one instruction and vex translates
-    // the whole basic block, we do not want any optimization since we
-    // can lose information otherwise (i.e., lea rdx [rip+0x10000], add rax, rdx
-    // would only write the intermediate into rax).
-    VexRegisterUpdates orig_iropt_register_updates_default =
-                                       vex.get_iropt_register_updates_default();
-    vex.set_iropt_register_updates_default(VexRegUpdAllregsAtEachInsn);
+    // Since we only create basic blocks with few instructions and vex
+    // translates the whole basic block, we do not want any optimization since
+    // we can lose information otherwise (i.e., lea rdx [rip+0x10000],
+    // add rax, rdx would only write the intermediate into rax). The mode is
+    // passed to each translation since the default is shared by all threads.
+
+    // We are only interested in executing instructions.
+    vector<uintptr_t> addresses;
+    addresses.reserve(path.size());
+    for(const BaseInstructionSSAPtr &instr : path) {
+        if(instr->is_instruction()) {
+            addresses.push_back(instr->get_address());
+        }
+    }
 
     // Create a path of artificial basic blocks with just
-    // the instruction of our data flow path.
+    // the instructions of our data flow path. Instructions that directly
+    // follow each other in memory are translated into one block.
     const Memory &memory = translator.get_memory();
     vector<BlockPtr> exec_blocks;
-    for(const BaseInstructionSSAPtr &instr : path) {
-
-        // We are only interested in executing instructions.
-        if(!instr->is_instruction()) {
-            continue;
-        }
+    size_t pos = 0;
+    while(pos < addresses.size()) {
 
-        // Vex is not thread safe, so we have to lock this section.
-        // NOTE: all attempts to make the Vex object thread safe
-        // did not succeed.
-        vex_mutex.lock();
-        size_t real_end = 0;
-        const IRSB &translated_block = vex.translate(
-                                           memory[instr->get_address()],
-                                           instr->get_address(),
-                                           1,
-                                           &real_end);
-        IRSB *irsb_ptr = deepCopyIRSB_Heap(&translated_block);
-        vex_mutex.unlock();
+        size_t num_instrs = 0;
+        const IRSB *irsb_ptr = vex.translate_instructions(
+                                                     memory[addresses[pos]],
+                                                     &addresses[pos],
+                                                     addresses.size() - pos,
+                                                     VexRegUpdAllregsAtEachInsn,
+                                                     &num_instrs);
 
         // Our analysis skips call and ret instructions, therefore
         // we only have fallthrough terminators.
@@ -141,16 +192,14 @@ bool is_init_vtable_ptr_instr(const Translator &translator,
         terminator.type = TerminatorFallthrough;
         terminator.target = 0;
         terminator.fall_through = 0;
-        BlockPtr block = make_shared<Block>(instr->get_address(),
+        BlockPtr block = make_shared<Block>(addresses[pos],
                                             irsb_ptr,
                                             terminator,
-                                            1);
+                                            num_instrs);
         exec_blocks.push_back(block);
+        pos += num_instrs;
     }
 
-    // Reset vex options.
-    vex.set_iropt_register_updates_default(orig_iropt_register_updates_default);
-
     // Symbollically execute path.
     State state;
     for(uint32_t i = 0; i < exec_blocks.size(); i++) {
@@ -184,10 +233,10 @@ bool is_init_vtable_ptr_instr(const Translator &translator,
             // while vex uses uint and a subtract operation for negative values.
             const ConstantX64SSA &offset = mem.get_offset();
             if(offset.get_value() < 0) {
-                offset_expr = make_shared<Constant>(offset.get_value() * (-1));
+                offset_expr = make_constant(offset.get_value() * (-1));
             }
             else {
-                offset_expr = make_shared<Constant>(offset.get_value());
+                offset_expr = make_constant(offset.get_value());
             }
             break;
         }
@@ -383,20 +432,22 @@ bool is_init_vtable_ptr_instr(const Translator &translator,
 /*!
  * \brief Tracks data flow of start instruction forward until it is moved
  * into an memory object.
- * \return Returns BaseInstructionSSAPtrSet of the found instructions.
+ *
+ * The result does not depend on the vtable, hence it is computed once per
+ * xref and checked for all vtables referenced by it.
+ *
+ * \return Returns the found memory writes together with the data flow path
+ * leading to them.
  */
-BaseInstructionSSAPtrSet get_init_vtable_ptr_instr(
-                                     const Translator &translator,
+vector<VtablePtrStore> trace_vtable_ptr_stores(
                                      const Function &func,
-                                     const VTable &vtable,
-                                     const BaseInstructionSSAPtr &start_instr,
-                                     Vex &vex) {
+                                     const BaseInstructionSSAPtr &start_instr) {
 
-    typedef pair<BaseInstructionSSAPtr, BaseInstructionSSAPtrs> QueueElement;
+    typedef VtablePtrStore QueueElement;
 
     // Search all instructions which are possible vtable pointer init
     // instructions starting from our vtable xref instruction.
-    BaseInstructionSSAPtrSet init_vtbl_ptrs;
+    vector<VtablePtrStore> stores;
 
     OperandsSSAset seen;
     queue<QueueElement> work_queue;
@@ -430,14 +481,10 @@ cout << *curr_instr << endl;
                 cout << endl;
 #endif
 
-                // Symbollically execute path in order to check if the
-                // vtable pointer is written into a memory object.
-                if(is_init_vtable_ptr_instr(translator,
-                                            vtable,
-                                            curr_path,
-                                            vex)) {
-                    init_vtbl_ptrs.insert(curr_instr);
-                }
+                // The path is symbolically executed for each vtable
+                // afterwards in order to check if the vtable pointer is
+                // written into a memory object.
+                stores.push_back(make_pair(curr_instr, curr_path));
 
                 // Decide if memory resides on the stack.
                 // NOTE: at the moment it is a simple check.
@@ -545,34 +592,16 @@ cout << *curr_instr << endl;
         }
     }
 
-    return init_vtbl_ptrs;
+    return stores;
 }
 
 /*!
- * \brief Searches the instructions that moves the vtable pointer into the
- * object for the given vtable pointer xref address.
- * \return Returns a BaseInstructionSSAPtrSet of the found instructions.
+ * \brief Returns the instruction of the vtable pointer xref address which
+ * is traced forward.
  */
-BaseInstructionSSAPtrSet get_init_vtable_ptr_instr(const Translator &translator,
-                                                   const VTable &vtable,
-                                                   Vex &vex,
+const BaseInstructionSSAPtr &get_vtable_xref_instr(const Function &func,
                                                    uint64_t vtable_xref_addr) {
 
-    const Function *temp_start_func = nullptr;
-    try {
-        temp_start_func = &translator.get_containing_function(
-                                                  vtable_xref_addr);
-    }
-    catch(...) {
-        cerr << "Function for vtable xref address "
-             << hex << vtable_xref_addr
-             << " not found. Skipping."
-             << "\n";
-        BaseInstructionSSAPtrSet empty_vtbl_ptrs;
-        return empty_vtbl_ptrs;
-    }
-    const Function &func = *temp_start_func;
-
     // Find the correct instruction we want to trace forward
     // (since multiple instructions can have the same address like
     // multiple phi nodes).
@@ -594,121 +623,205 @@ BaseInstructionSSAPtrSet get_init_vtable_ptr_instr(const Translator &translator,
         throw runtime_error(err_msg.str().c_str());
     }
 
-    return get_init_vtable_ptr_instr(translator,
-                                     func,
-                                     vtable,
-                                     *temp_instr_ptr,
-                                     vex);
+    return *temp_instr_ptr;
 }
 
-void object_allocation_analysis_thread(const string &module_name,
-                                       const VTableFile &vtable_file,
-                                       const Translator &translator,
-                                       Vex &vex,
-                                       ObjectAllocationFile &obj_alloc_file,
-                                       uint32_t thread_number) {
-
-    cout << "Starting object allocation analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
-
-    while(true) {
-
-        // Get next vtable address that has to be analyzed.
-        uint64_t vtable_addr;
-        queue_vtable_addrs_mtx.lock();
-        if(queue_vtable_addrs.empty()) {
-            queue_vtable_addrs_mtx.unlock();
-            break;
+/*!
+ * \brief Searches the instructions that move the pointers of the referenced
+ * vtables into objects for all vtable xrefs of the task.
+ *
+ * Each xref is traced forward only once regardless of the number of vtables
+ * it references. If a summary store is given, the findings are taken from
+ * the summary of an identical function (and stored for the next module
+ * otherwise).
+ */
+void analyze_object_allocation_task(const Translator &translator,
+                                    Vex &vex,
+                                    ObjectAllocationFile &obj_alloc_file,
+                                    const ObjectAllocationTask &task,
+                                    SummaryStore *summary_store) {
+
+    const uint64_t func_entry = task.func->get_entry();
+
+    // The vtables referenced by the function ordered by address and the
+    // positions of the vtables of each xref in it.
+    vector<const VTable*> vtables;
+    vector<pair<uint64_t, vector<uint32_t>>> xref_positions;
+    uint64_t summary_key = 0;
+    SummaryObjectAllocations summary;
+    if(summary_store) {
+        for(const auto &kv_xref : task.xrefs) {
+            vtables.insert(vtables.end(),
+                           kv_xref.second.cbegin(),
+                           kv_xref.second.cend());
+        }
+        sort(vtables.begin(),
+             vtables.end(),
+             [](const VTable *a, const VTable *b) {
+                 return a->addr < b->addr
+                        || (a->addr == b->addr && a->index < b->index);
+             });
+        vtables.erase(unique(vtables.begin(), vtables.end()), vtables.end());
+
+        for(const auto &kv_xref : task.xrefs) {
+            xref_positions.emplace_back(kv_xref.first, vector<uint32_t>());
+            for(const VTable *vtable : kv_xref.second) {
+                xref_positions.back().second.push_back(
+                                 find(vtables.cbegin(), vtables.cend(), vtable)
+                                 - vtables.cbegin());
+            }
+            sort(xref_positions.back().second.begin(),
+                 xref_positions.back().second.end());
         }
-        vtable_addr = queue_vtable_addrs.front();
-        queue_vtable_addrs.pop();
-        cout << "Analyzing vtable at address: "
-             << hex << vtable_addr
-             << ". Remaining vtables to analyze: "
-             << dec << queue_vtable_addrs.size()
-             << " (Thread: " << dec << thread_number << ")"
-             << endl;
-        queue_vtable_addrs_mtx.unlock();
 
-        const VTable &vtable = vtable_file.get_vtable(module_name,
-                                                      vtable_addr);
+        summary_key = summary_store->compute_key(SummaryKindObjectAllocations,
+                                                 *task.func,
+                                                 vtables,
+                                                 xref_positions);
+        if(summary_store->get_object_allocations(summary_key, summary)) {
+            for(const SummaryObjectAllocation &obj_alloc : summary) {
+                if(obj_alloc.vtable_pos >= vtables.size()) {
+                    continue;
+                }
+                obj_alloc_file.add_object_allocation(
+                                     func_entry + obj_alloc.init_offset,
+                                     vtables[obj_alloc.vtable_pos]->index,
+                                     func_entry + obj_alloc.xref_offset);
+            }
+            return;
+        }
+    }
 
-        for(uint64_t vtable_xref_addr : vtable.xrefs) {
+    for(const auto &kv_xref : task.xrefs) {
+        uint64_t vtable_xref_addr = kv_xref.first;
 
-            BaseInstructionSSAPtrSet vtable_init_instrs =
-                                get_init_vtable_ptr_instr(translator,
-                                                          vtable,
-                                                          vex,
-                                                          vtable_xref_addr);
+        const BaseInstructionSSAPtr &start_instr =
+                                         get_vtable_xref_instr(*task.func,
+                                                               vtable_xref_addr);
+        const vector<VtablePtrStore> stores =
+                                 trace_vtable_ptr_stores(*task.func,
+                                                         start_instr);
 
-            // Skip if we could not find any
-            // vtable ptr init instruction.
-            if(vtable_init_instrs.empty()) {
-                continue;
-            }
+        for(const VtablePtrStore &store : stores) {
+            for(const VTable *vtable : kv_xref.second) {
 
-            for(const auto &vtable_init_instr: vtable_init_instrs) {
+                // Symbollically execute path in order to check if the
+                // vtable pointer is written into a memory object.
+                if(!is_init_vtable_ptr_instr(translator,
+                                             *vtable,
+                                             store.second,
+                                             vex)) {
+                    continue;
+                }
 
 #if DEBUG_OBJ_ALLOC_PRINT
                 cout << "Memory allocation instruction: "
-                     << *vtable_init_instr
+                     << *store.first
                      << " for vtable "
-                     << hex << vtable.addr
+                     << hex << vtable->addr
                      << " at xref addr "
                      << hex << vtable_xref_addr
                      << "\n";
 #endif
 
                 obj_alloc_file.add_object_allocation(
-                                               vtable_init_instr->get_address(),
-                                               vtable.index,
-                                               vtable_xref_addr);
+                                                    store.first->get_address(),
+                                                    vtable->index,
+                                                    vtable_xref_addr);
+
+                if(summary_store) {
+                    SummaryObjectAllocation obj_alloc;
+                    obj_alloc.init_offset = store.first->get_address()
+                                            - func_entry;
+                    obj_alloc.xref_offset = vtable_xref_addr - func_entry;
+                    obj_alloc.vtable_pos = find(vtables.cbegin(),
+                                                vtables.cend(),
+                                                vtable)
+                                           - vtables.cbegin();
+                    summary.push_back(obj_alloc);
+                }
             }
         }
+    }
 
-        for(auto &kv_xref : vtable.indirect_xrefs) {
-            for(uint64_t vtable_xref_addr : kv_xref.second) {
-
-                BaseInstructionSSAPtrSet vtable_init_instrs =
-                                get_init_vtable_ptr_instr(translator,
-                                                          vtable,
-                                                          vex,
-                                                          vtable_xref_addr);
+    if(summary_store
+       && !summary_store->add_object_allocations(summary_key, summary)) {
+        cerr << "Not able to write summary of function "
+             << hex << func_entry
+             << ". Skipping."
+             << "\n";
+    }
+}
 
-                // Skip if we could not find any
-                // vtable ptr init instruction.
-                if(vtable_init_instrs.empty()) {
-                    continue;
-                }
+void object_allocation_analysis_thread(
+                                 const vector<ObjectAllocationTask> &tasks,
+                                 const Translator &translator,
+                                 Vex &vex,
+                                 ObjectAllocationFile &obj_alloc_file,
+                                 SummaryStore *summary_store,
+                                 uint32_t thread_number) {
 
-                for(const auto &vtable_init_instr: vtable_init_instrs) {
+    NumaPlacement::get_instance().pin_thread(thread_number);
 
-#if DEBUG_OBJ_ALLOC_PRINT
-                    cout << "Memory allocation instruction: "
-                         << *vtable_init_instr
-                         << " for vtable "
-                         << hex << vtable.addr
-                         << " at xref addr "
-                         << hex << vtable_xref_addr
-                         << "\n";
-#endif
+    LOG_INFO("Starting object allocation analysis (Thread: "
+             << dec << thread_number
+             << ")");
 
-                    obj_alloc_file.add_object_allocation(
-                                               vtable_init_instr->get_address(),
-                                               vtable.index,
-                                               vtable_xref_addr);
+    while(true) {
 
-                }
-            }
+        // Get next function that has to be analyzed.
+        uint64_t task_idx;
+        if(!queue_obj_alloc_tasks.pop(thread_number, task_idx)) {
+            break;
         }
+        const ObjectAllocationTask &task = tasks[task_idx];
+        LOG_PROGRESS("Analyzing vtable xrefs in function: "
+                     << hex << task.func->get_entry()
+                     << ". Remaining functions to analyze: "
+                     << dec << queue_obj_alloc_tasks.size()
+                     << " (Thread: " << dec << thread_number << ")");
+
+        analyze_object_allocation_task(translator,
+                                       vex,
+                                       obj_alloc_file,
+                                       task,
+                                       summary_store);
+    }
+
+    LOG_INFO("Finished object allocation analysis (Thread: "
+             << dec << thread_number
+             << ")");
+}
+
+/*!
+ * \brief Adds the given vtable xref to the task of its containing function.
+ */
+void add_object_allocation_xref(const Translator &translator,
+                                const VTable &vtable,
+                                uint64_t vtable_xref_addr,
+                                const IncrementalState *incremental,
+                                map<uint64_t, ObjectAllocationTask> &tasks) {
+
+    // Results of unaffected functions are reused.
+    if(incremental && !incremental->is_affected(vtable_xref_addr)) {
+        return;
+    }
+
+    const Function *func = nullptr;
+    try {
+        func = &translator.get_containing_function(vtable_xref_addr);
+    }
+    catch(...) {
+        cerr << "Function for vtable xref address "
+             << hex << vtable_xref_addr
+             << " not found. Skipping."
+             << "\n";
+        return;
     }
 
-    cout << "Finished object allocation analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
+    ObjectAllocationTask &task = tasks[func->get_entry()];
+    task.func = func;
+    task.xrefs[vtable_xref_addr].insert(&vtable);
 }
 
 void object_allocation_analysis(const string &module_name,
@@ -716,15 +829,64 @@ void object_allocation_analysis(const string &module_name,
                                 const Translator &translator,
                                 Vex &vex,
                                 ObjectAllocationFile &obj_alloc_file,
-                                uint32_t num_threads) {
+                                uint32_t num_threads,
+                                const IncrementalState *incremental,
+                                const AnalysisShard *shard,
+                                SummaryStore *summary_store) {
+
+    // Add the still valid results of the previous run.
+    if(incremental && incremental->is_incremental()) {
+        for(const IncrementalObjectAllocation &obj_alloc :
+            incremental->get_cached_object_allocations()) {
+            for(uint32_t vtbl_idx : obj_alloc.vtbl_idxs) {
+                for(uint64_t vtbl_xref_addr : obj_alloc.vtbl_xref_addrs) {
+                    obj_alloc_file.add_object_allocation(obj_alloc.addr,
+                                                         vtbl_idx,
+                                                         vtbl_xref_addr);
+                }
+            }
+        }
+    }
 
-    // Set up queue with all vtable addresses that have to be analyzed.
-    queue_vtable_addrs_mtx.lock();
+    // Group all vtable xrefs by their containing function so that each
+    // function (usually a constructor) is analyzed by one task regardless of
+    // the number of vtables it references, and vtables with lots of xrefs
+    // are spread over all threads.
+    map<uint64_t, ObjectAllocationTask> func_tasks;
     for(const auto &kv : vtable_file.get_vtables(module_name)) {
         const VTable &vtable = *kv.second;
-        queue_vtable_addrs.push(vtable.addr);
+
+        for(uint64_t vtable_xref_addr : vtable.xrefs) {
+            add_object_allocation_xref(translator,
+                                       vtable,
+                                       vtable_xref_addr,
+                                       incremental,
+                                       func_tasks);
+        }
+        for(const auto &kv_xref : vtable.indirect_xrefs) {
+            for(uint64_t vtable_xref_addr : kv_xref.second) {
+                add_object_allocation_xref(translator,
+                                           vtable,
+                                           vtable_xref_addr,
+                                           incremental,
+                                           func_tasks);
+            }
+        }
+    }
+
+    // Set up queue with all tasks that have to be analyzed.
+    vector<ObjectAllocationTask> tasks;
+    tasks.reserve(func_tasks.size());
+    for(auto &kv : func_tasks) {
+        if(shard && !shard->contains(kv.first)) {
+            continue;
+        }
+        tasks.push_back(move(kv.second));
+    }
+    queue_obj_alloc_tasks.set_num_workers(num_threads);
+    for(uint64_t i = 0; i < tasks.size(); i++) {
+        queue_obj_alloc_tasks.push(i);
     }
-    queue_vtable_addrs_mtx.unlock();
 
 
 // TODO / DEBUG
@@ -734,22 +896,22 @@ void object_allocation_analysis(const string &module_name,
     // Analyze all vtable xrefs to find all vtable pointer init instructions.
     // For debugging purposes do not spawn any thread.
     if(num_threads == 1) {
-        object_allocation_analysis_thread(module_name,
-                                          vtable_file,
+        object_allocation_analysis_thread(tasks,
                                           translator,
                                           vex,
                                           obj_alloc_file,
+                                          summary_store,
                                           0);
     }
     else {
         thread *all_threads = new thread[num_threads];
         for(uint32_t i = 0; i < num_threads; i++) {
             all_threads[i] = thread(object_allocation_analysis_thread,
-                                    module_name,
-                                    ref(vtable_file),
+                                    cref(tasks),
                                     ref(translator),
                                     ref(vex),
                                     ref(obj_alloc_file),
+                                    summary_store,
                                     i);
         }
         for(uint32_t i = 0; i < num_threads; i++) {
@@ -757,4 +919,7 @@ void object_allocation_analysis(const string &module_name,
         }
         delete [] all_threads;
     }
+
+    // Write the pending messages of the workers.
+    Logger::get_instance().flush();
 }
@@ -1,4 +1,5 @@
 #include "object_allocations_gt.h"
+#include "logger.h"
 
 using namespace std;
 
@@ -96,10 +97,9 @@ void object_allocation_analysis_gt_thread(const string &module_name,
                                           ObjectAllocationGTFile &obj_alloc_gt_file,
                                           uint32_t thread_number) {
 
-    cout << "Starting object allocation GT analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
+    LOG_INFO("Starting object allocation GT analysis (Thread: "
+             << dec << thread_number
+             << ")");
 
     while(true) {
 
@@ -112,12 +112,11 @@ void object_allocation_analysis_gt_thread(const string &module_name,
         }
         vtable_print_addr = queue_vtable_print_addrs.front();
         queue_vtable_print_addrs.pop();
-        cout << "Analyzing vtable print at address: "
-             << hex << vtable_print_addr
-             << ". Remaining vtables to analyze: "
-             << dec << queue_vtable_print_addrs.size()
-             << " (Thread: " << dec << thread_number << ")"
-             << endl;
+        LOG_PROGRESS("Analyzing vtable print at address: "
+                     << hex << vtable_print_addr
+                     << ". Remaining vtables to analyze: "
+                     << dec << queue_vtable_print_addrs.size()
+                     << " (Thread: " << dec << thread_number << ")");
         queue_vtable_print_addrs_mtx.unlock();
 
         const Function *function_ptr = nullptr;
@@ -181,10 +180,9 @@ void object_allocation_analysis_gt_thread(const string &module_name,
         }
     }
 
-    cout << "Finished object allocation GT analysis (Thread: "
-         << dec << thread_number
-         << ")"
-         << endl;
+    LOG_INFO("Finished object allocation GT analysis (Thread: "
+             << dec << thread_number
+             << ")");
 }
 
 void object_allocation_gt_analysis(const std::string &module_name,
@@ -230,4 +228,7 @@ void object_allocation_gt_analysis(const std::string &module_name,
         }
         delete [] all_threads;
     }
+
+    // Write the pending messages of the workers.
+    Logger::get_instance().flush();
 }
@@ -23,6 +23,7 @@ OverwriteAnalysis::OverwriteAnalysis(Translator &translator,
     const FctReturnValuesFile &fct_return_values,
     FctVTableUpdates &external_vtable_updates,
     VCallFile &vcall_file,
+    OverwriteBlockCache &block_cache,
     const string &module_name,
     uint64_t memory_begin,
     uint64_t memory_end)
@@ -41,12 +42,12 @@ OverwriteAnalysis::OverwriteAnalysis(Translator &translator,
           _vcall_file(vcall_file),
           _this_vtables(_vtable_file.get_this_vtables()),
           _module_name(module_name),
+          _module_id(_vtable_file.get_module_id(module_name)),
           _vtable_updates(_master_vtable_updates),
           _op_new_candidates(_master_op_new_candidates),
           _vtv_vcalls(_master_vtv_vcalls),
           _ret_value_mapping(_master_ret_value_mapping),
-          _block_cache_true(_master_block_cache_true),
-          _block_cache_false(_master_block_cache_false) {
+          _block_cache(block_cache) {
 
     _call_depth = MAX_CALL_DEPTH;
 
@@ -59,16 +60,8 @@ OverwriteAnalysis::OverwriteAnalysis(Translator &translator,
 
     // consider function to be a function of an object (either virtual or
     // normal)
-    switch(_file_format) {
-        case FileFormatELF64: // => set RDI to be a this ptr candidate
-            add_this_candidate(State::initial_values().at(OFFB_RDI));
-            break;
-        case FileFormatPE64: // => set RCX to be a this ptr candidate
-            add_this_candidate(State::initial_values().at(OFFB_RCX));
-            break;
-        default:
-            throw runtime_error("Do not know how to handle file format.");
-    }
+    // (the initial value of the first argument is a this ptr candidate).
+    add_this_candidate(_abi.arguments_init[0]);
 
     // Make sure that the vtable file is finalized.
     if(!_vtable_file.is_finalized()) {
@@ -88,6 +81,7 @@ OverwriteAnalysis::OverwriteAnalysis(Translator &translator,
     const FctReturnValuesFile &fct_return_values,
     FctVTableUpdates &external_vtable_updates,
     VCallFile &vcall_file,
+    OverwriteBlockCache &block_cache,
     const string &module_name,
     uint64_t memory_begin,
     uint64_t memory_end,
@@ -97,9 +91,7 @@ OverwriteAnalysis::OverwriteAnalysis(Translator &translator,
     VTableUpdates &vtable_updates,
     OperatorNewExprMap &op_new_candidates,
     VTVVcalls &vtv_vcalls,
-    MultipleReturnValues &ret_value_mapping,
-    unordered_set<uint64_t> &block_cache_true,
-    unordered_set<uint64_t> &block_cache_false)
+    MultipleReturnValues &ret_value_mapping)
 
         : BaseAnalysis(function, translator.get_file_format()),
           _translator(translator),
@@ -115,12 +107,12 @@ OverwriteAnalysis::OverwriteAnalysis(Translator &translator,
           _vcall_file(vcall_file),
           _this_vtables(_vtable_file.get_this_vtables()),
           _module_name(module_name),
+          _module_id(_vtable_file.get_module_id(module_name)),
           _vtable_updates(vtable_updates),
           _op_new_candidates(op_new_candidates),
           _vtv_vcalls(vtv_vcalls),
           _ret_value_mapping(ret_value_mapping),
-          _block_cache_true(block_cache_true),
-          _block_cache_false(block_cache_false) {
+          _block_cache(block_cache) {
 
     _initial_state = initial_state;
     _call_depth = call_depth;
@@ -156,7 +148,7 @@ void OverwriteAnalysis::path_traversed(const Path &path) {
     // return value in a mapping.
     if(_last_block_ptr->get_terminator().type == TerminatorReturn) {
         State::const_iterator rax_value;
-        if(_last_state_ptr->find(register_rax, rax_value)) {
+        if(_last_state_ptr->find(_abi.return_value, rax_value)) {
 
             ReturnValue ret_value;
             ret_value.path = path;
@@ -209,26 +201,102 @@ void OverwriteAnalysis::path_traversed(const Path &path) {
 }
 
 
-// Blocks are interesting that have an indirect call, or a vtable as a
-// constant, or a call to a new operator.
-bool OverwriteAnalysis::block_predicate(const Block &block) {
+// Number of words of a chunk (32 blocks per word).
+static const size_t block_cache_chunk_words =
+                              (1 << OVERWRITE_BLOCK_CACHE_CHUNK_BITS) / 32;
 
-    // check if address of block is cached
-    auto end_true  = _block_cache_true.cend();
-    auto end_false = _block_cache_false.cend();
+OverwriteBlockCache::OverwriteBlockCache() {
+    for(auto &chunk : _chunks) {
+        chunk.store(nullptr, memory_order_relaxed);
+    }
+}
+
+OverwriteBlockCache::~OverwriteBlockCache() {
+    for(auto &chunk : _chunks) {
+        delete [] chunk.load(memory_order_relaxed);
+    }
+}
+
+atomic<uint64_t> *OverwriteBlockCache::get_chunk(uint64_t block_id,
+                                                 bool create) {
+    auto &slot = _chunks[block_id >> OVERWRITE_BLOCK_CACHE_CHUNK_BITS];
+    atomic<uint64_t> *chunk = slot.load(memory_order_acquire);
+    if(chunk != nullptr || !create) {
+        return chunk;
+    }
+
+    atomic<uint64_t> *new_chunk = new atomic<uint64_t>[
+                                                     block_cache_chunk_words];
+    for(size_t i = 0; i < block_cache_chunk_words; i++) {
+        new_chunk[i].store(0, memory_order_relaxed);
+    }
 
-    if(_block_cache_true.find(block.get_address()) != end_true) {
-        return true;
+    // Another thread may have been faster.
+    if(!slot.compare_exchange_strong(chunk, new_chunk,
+                                     memory_order_acq_rel)) {
+        delete [] new_chunk;
+        return chunk;
+    }
+    return new_chunk;
+}
+
+bool OverwriteBlockCache::find(const Block &block,
+                               arg_out bool &interesting) {
+    uint64_t id = block.get_id();
+    if(id >= OVERWRITE_BLOCK_CACHE_MAX_BLOCKS) {
+        return false;
+    }
+    const atomic<uint64_t> *chunk = get_chunk(id, false);
+    if(chunk == nullptr) {
+        return false;
     }
-    if(_block_cache_false.find(block.get_address()) != end_false) {
+
+    uint32_t offset = id & ((1 << OVERWRITE_BLOCK_CACHE_CHUNK_BITS) - 1);
+    uint64_t bits = chunk[offset / 32].load(memory_order_relaxed)
+                    >> ((offset % 32) * 2);
+    if(!(bits & 1)) {
         return false;
     }
+    interesting = (bits & 2) != 0;
+    return true;
+}
+
+void OverwriteBlockCache::insert(const Block &block, bool interesting) {
+    uint64_t id = block.get_id();
+    if(id >= OVERWRITE_BLOCK_CACHE_MAX_BLOCKS) {
+        return;
+    }
+    atomic<uint64_t> *chunk = get_chunk(id, true);
+
+    uint32_t offset = id & ((1 << OVERWRITE_BLOCK_CACHE_CHUNK_BITS) - 1);
+    uint64_t bits = interesting ? 3 : 1;
+    chunk[offset / 32].fetch_or(bits << ((offset % 32) * 2),
+                                memory_order_relaxed);
+}
+
+
+bool OverwriteAnalysis::block_predicate(const Block &block) {
+
+    // check if address of block is cached
+    bool interesting;
+    if(_block_cache.find(block, interesting)) {
+        return interesting;
+    }
+
+    interesting = is_interesting_block(block);
+    _block_cache.insert(block, interesting);
+    return interesting;
+}
+
+
+// Blocks are interesting that have an indirect call, or a vtable as a
+// constant, or a call to a new operator.
+bool OverwriteAnalysis::is_interesting_block(const Block &block) const {
 
     switch(block.get_terminator().type) {
 
         // BBs with an indirect call are interesting.
         case TerminatorCallUnresolved:
-            _block_cache_true.insert(block.get_address());
             return true;
 
         // Calls to new operators are interesting.
@@ -236,7 +304,6 @@ bool OverwriteAnalysis::block_predicate(const Block &block) {
             uint64_t callee_address = block.get_terminator().target;
 
             if(_new_operators.find(callee_address) != _new_operators.end()) {
-                _block_cache_true.insert(block.get_address());
                 return true;
             }
             break;
@@ -285,15 +352,13 @@ bool OverwriteAnalysis::block_predicate(const Block &block) {
             }
 
             // check if constant is a vtable candidate
-            if(vtable_candidate != 0 && _this_vtables.find(vtable_candidate) !=
-                    _this_vtables.cend()) {
-                _block_cache_true.insert(block.get_address());
+            if(vtable_candidate != 0
+               && _vtable_file.is_this_vtable(vtable_candidate)) {
                 return true;
             }
         }
     }
 
-    _block_cache_false.insert(block.get_address());
     return false;
 }
 
@@ -317,59 +382,25 @@ void OverwriteAnalysis::import_external_vtable_updates(
                 // the register.
                 VTableUpdate ext_update;
                 bool found = false;
-                switch(_file_format) {
-                    case FileFormatELF64: {
-                        for(uint32_t i = 0; i < NUMBER_SYSTEM_V_ARGS; i++) {
-                            if(*it.base == *_system_v_arguments_init[i]) {
-                                State::const_iterator arg_value;
-                                if(state.find(system_v_arguments[i],
-                                              arg_value)) {
-                                    ext_update.base =
-                                                     arg_value->second->clone();
-                                    ext_update.index = it.index;
-                                    ext_update.offset = it.offset;
-                                    found = true;
-                                    break;
-                                }
-                                else {
-                                    throw runtime_error("External functions "\
-                                                        "overwrites vtable in "\
-                                                        "an object residing "\
-                                                        "in a register which "\
-                                                        "is not set by "\
-                                                        "caller.");
-                                }
-                            }
+                for(uint32_t i = 0; i < _abi.num_arguments; i++) {
+                    if(*it.base == *_abi.arguments_init[i]) {
+                        State::const_iterator arg_value;
+                        if(state.find(_abi.arguments[i], arg_value)) {
+                            ext_update.base = arg_value->second->clone();
+                            ext_update.index = it.index;
+                            ext_update.offset = it.offset;
+                            found = true;
+                            break;
                         }
-                        break;
-                    }
-                    case FileFormatPE64: {
-                        for(uint32_t i = 0; i < NUMBER_MSVC_ARGS; i++) {
-                            if(*it.base == *_msvc_arguments_init[i]) {
-                                State::const_iterator arg_value;
-                                if(state.find(msvc_arguments[i], arg_value)) {
-                                    ext_update.base =
-                                                     arg_value->second->clone();
-                                    ext_update.index = it.index;
-                                    ext_update.offset = it.offset;
-                                    found = true;
-                                    break;
-                                }
-                                else {
-                                    throw runtime_error("External functions "\
-                                                        "overwrites vtable in "\
-                                                        "an object residing "\
-                                                        "in a register which "\
-                                                        "is not set by "\
-                                                        "caller.");
-                                }
-                            }
+                        else {
+                            throw runtime_error("External functions "\
+                                                "overwrites vtable in "\
+                                                "an object residing "\
+                                                "in a register which "\
+                                                "is not set by "\
+                                                "caller.");
                         }
-                        break;
                     }
-                    default:
-                        throw runtime_error("Do not know how to "\
-                                            "handle file format.");
                 }
                 if(!found) {
                     throw runtime_error("Not able to import external "\
@@ -451,19 +482,7 @@ inline void OverwriteAnalysis::handle_new_operator(const Block &block,
         temp.expr = _current_return_value;
 
         // Extract size that is used for new operator.
-        shared_ptr<Register> first_arg_reg_ptr;
-        switch(_file_format) {
-            case FileFormatELF64:
-                first_arg_reg_ptr = system_v_arguments[0];
-                break;
-            case FileFormatPE64:
-                first_arg_reg_ptr = msvc_arguments[0];
-                break;
-            default:
-                throw runtime_error("Do not know how to "\
-                                    "handle file format.");
-        }
-        const auto &first_arg_reg = first_arg_reg_ptr;
+        const auto &first_arg_reg = _abi.arguments[0];
 
         State::const_iterator first_arg_value;
         if(state.find(first_arg_reg, first_arg_value)) {
@@ -552,6 +571,7 @@ void OverwriteAnalysis::handle_jump(const Path &path,
                                        _fct_return_values,
                                        _external_vtable_updates,
                                        _vcall_file,
+                                       _block_cache,
                                        _module_name,
                                        _begin,
                                        _end,
@@ -561,9 +581,7 @@ void OverwriteAnalysis::handle_jump(const Path &path,
                                        _vtable_updates,
                                        _op_new_candidates,
                                        _vtv_vcalls,
-                                       _ret_value_mapping,
-                                       _block_cache_true,
-                                       _block_cache_false);
+                                       _ret_value_mapping);
 
         // copy the current this pointer candidates to the sub analysis
         for(const auto &it : _this_candidates) {
@@ -654,7 +672,7 @@ void OverwriteAnalysis::handle_jump(const Path &path,
                         stringstream stream;
                         stream << "func_return_" << hex << target_address;
                         Symbolic temp_sym(stream.str());
-                        temp.base = make_shared<Symbolic>(temp_sym);
+                        temp.base = make_symbolic(temp_sym);
                         add_vtable_update(temp);
                     }
                 }
@@ -677,9 +695,9 @@ void OverwriteAnalysis::handle_jump(const Path &path,
         const PltEntry *plt_entry = _module_plt.get_plt_entry(target_address);
         if(plt_entry != nullptr) {
 
-            const string &func_name = plt_entry->func_name;
             const ExternalFunction *ext_func;
-            ext_func = _external_funcs.get_external_function(func_name);
+            ext_func = _external_funcs.get_external_function_by_id(
+                                                         plt_entry->name_id);
 
             // Import vtable updates made by the external function.
             import_external_vtable_updates(ext_func, state);
@@ -750,53 +768,20 @@ void OverwriteAnalysis::handle_call(const Path &path,
     // Check if any arg register contains a this pointer candidate
     // => consider function as interesting.
     bool is_interesting = false;
-    switch(_file_format) {
-        case FileFormatELF64: {
-            for(const auto &arg_reg : system_v_arguments) {
-
-                State::const_iterator arg_value;
-                if(state.find(arg_reg, arg_value)) {
-
-                    // check if arg register contains any of the
-                    // this pointer candidates
-                    for(const auto &it : _this_candidates) {
-                        if(arg_value->second->contains(*it)) {
-
-                            is_interesting = true;
-                            break;
-                        }
-                    }
-                    if(is_interesting) {
-                        break;
-                    }
-                }
-            }
-            break;
-        }
-        case FileFormatPE64: {
-            for(const auto &arg_reg : msvc_arguments) {
-
-                State::const_iterator arg_value;
-                if(state.find(arg_reg, arg_value)) {
+    for(size_t i = 0; i < _abi.num_arguments && !is_interesting; i++) {
+        State::const_iterator arg_value;
+        if(state.find(_abi.arguments[i], arg_value)) {
 
-                    // check if arg register contains any of the
-                    // this pointer candidates
-                    for(const auto &it : _this_candidates) {
-                        if(arg_value->second->contains(*it)) {
+            // check if arg register contains any of the
+            // this pointer candidates
+            for(const auto &it : _this_candidates) {
+                if(arg_value->second->contains(*it)) {
 
-                            is_interesting = true;
-                            break;
-                        }
-                    }
-                    if(is_interesting) {
-                        break;
-                    }
+                    is_interesting = true;
+                    break;
                 }
             }
-            break;
         }
-        default:
-            throw runtime_error("Do not know how to handle file format.");
     }
 
     // Consider calls to a plt entry as interesting (since we only import
@@ -822,8 +807,7 @@ void OverwriteAnalysis::add_vtable_update(const ExpressionPtr &base,
                                           uint64_t new_vtable,
                                           size_t offset) {
 
-    const VTable &vtable = _vtable_file.get_vtable(_module_name,
-                                                   new_vtable);
+    const VTable &vtable = _vtable_file.get_vtable(_module_id, new_vtable);
     uint32_t index = vtable.index;
 
     // Check if vtable overwrite is already known.
@@ -852,17 +836,14 @@ uint64_t OverwriteAnalysis::get_used_table_entry(const ExpressionPtr &exp) {
         case ExpressionConstant: {
             Constant &temp = static_cast<Constant&>(*exp);
 
-            // TODO
-            // first check range to make it more performant
-
             switch(_file_format) {
                 case FileFormatELF64:
-                    if(_got_map.find(temp.value()) != _got_map.cend()) {
+                    if(_got_map.find(temp.value()) != nullptr) {
                         return temp.value();
                     }
                     break;
                 case FileFormatPE64:
-                    if(_idata_map.find(temp.value()) != _idata_map.cend()) {
+                    if(_idata_map.find(temp.value()) != nullptr) {
                         return temp.value();
                     }
                     break;
@@ -930,7 +911,7 @@ bool OverwriteAnalysis::in_traversal(const Path &path,
                 Indirection key_ind(key_exp_ptr);
                 key_exp_ptr = make_shared<Indirection>(key_ind);
 
-                Constant value_const(_got_map.at(got_entry_addr));
+                Constant value_const(_got_map.find(got_entry_addr)->content);
                 ExpressionPtr value_exp_ptr =
                                              make_shared<Constant>(value_const);
 
@@ -976,7 +957,7 @@ bool OverwriteAnalysis::in_traversal(const Path &path,
         }
 
         // check if constant value is a vtable
-        if(_this_vtables.find(vtable_addr) == _this_vtables.cend()) {
+        if(!_vtable_file.is_this_vtable(vtable_addr)) {
             continue;
         }
 
@@ -1050,7 +1031,7 @@ bool OverwriteAnalysis::in_traversal(const Path &path,
                     if(*op_new.second.expr == *it) {
 
                         const VTable &vtable = _vtable_file.get_vtable(
-                                                                _module_name,
+                                                                _module_id,
                                                                 vtable_addr);
                         uint32_t index = vtable.index;
                         op_new.second.vtbl_idxs.insert(index);
@@ -1148,19 +1129,7 @@ void OverwriteAnalysis::handle_indirect_call(const Path &path,
 
         // Check if this argument is used for call target
         // => possible vcall found.
-        shared_ptr<Register> this_arg_ptr;
-        switch(_file_format) {
-            case FileFormatELF64:
-                this_arg_ptr = system_v_arguments[0];
-                break;
-            case FileFormatPE64:
-                this_arg_ptr = msvc_arguments[0];
-                break;
-            default:
-                throw runtime_error("Do not know how to "\
-                                    "handle file format.");
-        }
-        const auto &this_arg = this_arg_ptr;
+        const auto &this_arg = _abi.this_argument();
 
         State::const_iterator this_value;
         if(state.find(this_arg, this_value)) {
@@ -1262,7 +1231,7 @@ void OverwriteAnalysis::handle_indirect_call(const Path &path,
                     // Check if constant value is a vtable pointer.
                     uint64_t vtbl_cand = const_temp.value();
                     const VTable *vtbl_ptr = _vtable_file.get_vtable_ptr(
-                                                            _module_name,
+                                                            _module_id,
                                                             vtbl_cand);
 
                     // Ignore value if it is not a vtable pointer.
@@ -1330,19 +1299,7 @@ void OverwriteAnalysis::handle_indirect_call(const Path &path,
                             // the this pointer candidates before
                             // considering it as a vcall
                             bool is_vcall = false;
-                            shared_ptr<Register> arg_ptr;
-                            switch(_file_format) {
-                                case FileFormatELF64:
-                                    arg_ptr = system_v_arguments[0];
-                                    break;
-                                case FileFormatPE64:
-                                    arg_ptr = msvc_arguments[0];
-                                    break;
-                                default:
-                                    throw runtime_error("Do not know how to "\
-                                                        "handle file format.");
-                            }
-                            const auto &arg_reg = arg_ptr;
+                            const auto &arg_reg = _abi.this_argument();
 
                             State::const_iterator arg_value;
                             if(state.find(arg_reg, arg_value)) {
@@ -1537,19 +1494,7 @@ void OverwriteAnalysis::handle_indirect_call(const Path &path,
                             // the this pointer candidates before
                             // considering it as a vcall
                             bool is_vcall = false;
-                            shared_ptr<Register> arg_ptr;
-                            switch(_file_format) {
-                                case FileFormatELF64:
-                                    arg_ptr = system_v_arguments[0];
-                                    break;
-                                case FileFormatPE64:
-                                    arg_ptr = msvc_arguments[0];
-                                    break;
-                                default:
-                                    throw runtime_error("Do not know how to "\
-                                                        "handle file format.");
-                            }
-                            const auto &arg_reg = arg_ptr;
+                            const auto &arg_reg = _abi.this_argument();
                             State::const_iterator arg_value;
                             if(state.find(arg_reg, arg_value)) {
 
@@ -1641,8 +1586,7 @@ void OverwriteAnalysis::add_active_vtable(const ExpressionPtr &vtbl_ptr_loc,
                                           bool from_caller,
                                           bool from_callee) {
 
-    const VTable &vtable = _vtable_file.get_vtable(_module_name,
-                                                   vtable_addr);
+    const VTable &vtable = _vtable_file.get_vtable(_module_id, vtable_addr);
     uint32_t index = vtable.index;
 
     add_active_vtable(vtbl_ptr_loc, path, from_caller, from_callee, index);
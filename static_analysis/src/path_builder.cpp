@@ -3,10 +3,15 @@
 
 #include <array>
 #include <queue>
+#include <thread>
+#include <vector>
+#include <exception>
 #include <algorithm>
 
 using namespace std;
 
+atomic<uint32_t> PathBuilder::_idle_threads(0);
+
 /*!
  * \brief Creates a new instance of the class.
  * \param function The function for which paths should be constructed.
@@ -22,6 +27,85 @@ PathBuilder::PathBuilder(const Function &function, void *user_defined,
       _node_threshold(node_threshold) {
 }
 
+/*!
+ * \brief Sets the number of threads shared by all instances to build the
+ * paths of large functions (exceeding `PARALLEL_BLOCK_THRESHOLD` blocks).
+ *
+ * The threads are taken while building the paths of a function and given
+ * back afterwards, thus the number of additional threads stays bounded even
+ * if several functions are handled at once. Defaults to 0 (i.e., the paths
+ * are built by the calling thread only).
+ */
+void PathBuilder::set_num_threads(uint32_t num_threads) {
+    _idle_threads = num_threads;
+}
+
+/*!
+ * \brief Runs `task` for each index up to `num_tasks`. Unless `parallel` is
+ * `false`, the shared idle threads help the calling thread.
+ *
+ * Exceptions thrown by the tasks are rethrown in task order after all tasks
+ * are finished.
+ */
+void PathBuilder::run_subtasks(bool parallel, size_t num_tasks,
+                               const function<void (size_t)> &task) const {
+
+    // Take as many idle threads as useful.
+    uint32_t num_helpers = 0;
+    if(parallel && num_tasks > 1) {
+        uint32_t idle = _idle_threads;
+        while(idle > 0) {
+            num_helpers = min<size_t>(idle, num_tasks - 1);
+            if(_idle_threads.compare_exchange_weak(idle, idle - num_helpers)) {
+                break;
+            }
+            num_helpers = 0;
+        }
+    }
+
+    if(num_helpers == 0) {
+        for(size_t i = 0; i < num_tasks; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    vector<exception_ptr> errors(num_tasks);
+    atomic<size_t> next_task(0);
+    auto worker = [&]() {
+        while(true) {
+            size_t task_idx = next_task++;
+            if(task_idx >= num_tasks) {
+                break;
+            }
+            try {
+                task(task_idx);
+            }
+            catch(...) {
+                errors[task_idx] = current_exception();
+            }
+        }
+    };
+
+    thread *all_threads = new thread[num_helpers];
+    for(uint32_t i = 0; i < num_helpers; i++) {
+        all_threads[i] = thread(worker);
+    }
+    worker();
+    for(uint32_t i = 0; i < num_helpers; i++) {
+        all_threads[i].join();
+    }
+    delete [] all_threads;
+
+    _idle_threads += num_helpers;
+
+    for(const exception_ptr &error : errors) {
+        if(error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
 using Successors = array<uintptr_t, 2>;
 
 Successors get_successors(const Block &block) {
@@ -55,18 +139,76 @@ bool is_exit_block(void*, const Block &block) {
 }
 
 template<typename T>
-bool contains_duplicates(const deque<T> &container) {
-    set<T> witness(container.cbegin(), container.cend());
+bool contains_duplicates(const T &container) {
+    set<typename T::value_type> witness(container.cbegin(), container.cend());
     return witness.size() != container.size();
 }
 
-deque<ConcretePath> paths(const PathsByNode &p) {
-    deque<ConcretePath> collect;
-    for(const auto &kv : p) {
-        collect.push_back(kv.second);
+ConcretePathSet::ConcretePathSet(
+                         const shared_ptr<const vector<uintptr_t>> &addresses)
+    : _addresses(addresses) {
+}
+
+bool ConcretePathSet::equals(const Entry &entry, const uint32_t *blocks,
+                             uint32_t length) const {
+    return entry.length == length
+           && equal(blocks, blocks + length, _blocks.cbegin() + entry.offset);
+}
+
+/*!
+ * \brief Adds the given path unless it is already contained.
+ * \return `true`, if the path was added.
+ */
+bool ConcretePathSet::insert(const uint32_t *blocks, uint32_t length) {
+    size_t hash = length;
+    for(uint32_t i = 0; i < length; i++) {
+        std::hash_combine(hash, blocks[i]);
+    }
+
+    auto range = _index.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it) {
+        if(equals(_paths[it->second], blocks, length)) {
+            return false;
+        }
+    }
+
+    Entry entry;
+    entry.offset = _blocks.size();
+    entry.length = length;
+    entry.hash = hash;
+
+    _index.emplace(hash, _paths.size());
+    _paths.push_back(entry);
+    _blocks.insert(_blocks.end(), blocks, blocks + length);
+    return true;
+}
+
+/*!
+ * \brief Adds all paths of the other set (which has to refer to the same
+ * blocks).
+ */
+void ConcretePathSet::merge(const ConcretePathSet &other) {
+    for(const Entry &entry : other._paths) {
+        insert(other._blocks.data() + entry.offset, entry.length);
     }
+}
 
-    return collect;
+/*!
+ * \brief Sorts the paths lexicographically by their block addresses.
+ */
+void ConcretePathSet::sort() {
+    std::sort(_paths.begin(), _paths.end(),
+              [&](const Entry &lhs, const Entry &rhs) {
+        auto lhs_begin = _blocks.cbegin() + lhs.offset;
+        auto rhs_begin = _blocks.cbegin() + rhs.offset;
+        return lexicographical_compare(lhs_begin, lhs_begin + lhs.length,
+                                       rhs_begin, rhs_begin + rhs.length);
+    });
+
+    _index.clear();
+    for(uint32_t i = 0; i < _paths.size(); i++) {
+        _index.emplace(_paths[i].hash, i);
+    }
 }
 
 //!
@@ -86,19 +228,54 @@ deque<ConcretePath> paths(const PathsByNode &p) {
 //! paths that visit _one_ interesting block (being optimistic about other
 //! interesting blocks lying on that very same path).
 //!
-set<ConcretePath> PathBuilder::build_paths(BlockPredicate predicate) const {
-    const auto blocks = _function.get_blocks();
+//! For functions exceeding `PARALLEL_BLOCK_THRESHOLD` blocks, the searches
+//! starting at the interesting blocks and the stitching (per path from the
+//! root) are split into subtasks. Only the search from the root invokes
+//! `predicate`, hence it does not need to be thread-safe.
+//!
+ConcretePathSet PathBuilder::build_paths(BlockPredicate predicate) const {
+    const auto &blocks = _function.get_blocks();
     const auto root = _function.get_entry();
+    bool parallel = blocks.size() > PARALLEL_BLOCK_THRESHOLD;
+
+    // Blocks are referred to by their index (in address order).
+    auto addresses = make_shared<vector<uintptr_t>>();
+    unordered_map<uintptr_t, uint32_t> indexes;
+    for(const auto &kv : blocks) {
+        indexes[kv.first] = addresses->size();
+        addresses->push_back(kv.first);
+    }
+
+    auto to_indexes = [&](const ConcretePath &path) -> BlockIndexPath {
+        BlockIndexPath result;
+        result.reserve(path.size());
+        for(const auto address : path) {
+            result.push_back(indexes.at(address));
+        }
+        return result;
+    };
 
     // Get paths from root to interesting nodes.
     auto root_to_interesting = breadth_first(blocks, root, predicate);
 
+    vector<uintptr_t> interesting;
+    for(const auto &kv : root_to_interesting) {
+        interesting.push_back(kv.first);
+    }
+
     // Get paths from interesting node to exit.
-    map<uintptr_t, deque<ConcretePath>> interesting_to_exit;
+    vector<vector<BlockIndexPath>> to_exits(interesting.size());
 
-    for(const auto &kv : root_to_interesting) {
-        auto to_exit = breadth_first(blocks, kv.first, &is_exit_block);
-        interesting_to_exit[kv.first] = paths(to_exit);
+    run_subtasks(parallel, interesting.size(), [&](size_t i) {
+        auto to_exit = breadth_first(blocks, interesting[i], &is_exit_block);
+        for(const auto &kv : to_exit) {
+            to_exits[i].push_back(to_indexes(kv.second));
+        }
+    });
+
+    map<uint32_t, vector<BlockIndexPath>> interesting_to_exit;
+    for(size_t i = 0; i < interesting.size(); i++) {
+        interesting_to_exit[indexes.at(interesting[i])] = move(to_exits[i]);
     }
 
     bool safety_threshold = root_to_interesting.size() > _node_threshold;
@@ -106,58 +283,113 @@ set<ConcretePath> PathBuilder::build_paths(BlockPredicate predicate) const {
     /* Get paths from one interesting node to another (distinct) node; done
      * only if the safe threshold is not exceeded.
      */
-    map<uintptr_t, PathsByNode> interesting_to_interesting;
-    if(!safety_threshold) {
-        for(const auto &kv : root_to_interesting) {
-            const auto source = kv.first;
-
-            for(const auto &kv_dst : root_to_interesting) {
-                const auto destination = kv_dst.first;
-                if(source == destination) {
-                    continue;
-                }
+    map<uint32_t, IndexPathsByNode> interesting_to_interesting;
+    if(!safety_threshold && interesting.size() > 1) {
+        const Reachability &reachability = _function.get_reachability();
+        vector<IndexPathsByNode> to_others(interesting.size());
+
+        run_subtasks(parallel, interesting.size(), [&](size_t i) {
+            const auto source = interesting[i];
+
+            /* Each search replaces the result of the previous destination,
+             * hence only the one for the last (other) destination is kept
+             * and has to be run at all. There is no path (and no need for a
+             * search) if the destination is not reachable.
+             */
+            auto last = interesting.crbegin();
+            if(*last == source) {
+                ++last;
+            }
+            const auto destination = *last;
+            if(!reachability.is_reachable(source, destination)) {
+                return;
+            }
+
+            auto to_other = breadth_first(blocks, source,
+                [&](void*, const Block &block) -> bool {
+                    return block.get_address() == destination;
+            }, true);
+
+            for(const auto &kv : to_other) {
+                to_others[i][indexes.at(kv.first)] = to_indexes(kv.second);
+            }
+        });
 
-                auto to_other = breadth_first(blocks, source,
-                    [&](void*, const Block &block) -> bool {
-                        return block.get_address() == destination;
-                }, true);
+        for(size_t i = 0; i < interesting.size(); i++) {
+            interesting_to_interesting[indexes.at(interesting[i])] =
+                                                         move(to_others[i]);
+        }
+    }
 
-                interesting_to_interesting[source] = to_other;
+    // Stitch together possible paths (the paths starting with different
+    // paths from the root are independent of each other).
+    vector<ConcretePathSet> stitched(interesting.size(),
+                                     ConcretePathSet(addresses));
+
+    run_subtasks(parallel, interesting.size(), [&](size_t i) {
+        stitch_paths(to_indexes(root_to_interesting.at(interesting[i])),
+                     interesting_to_exit,
+                     interesting_to_interesting,
+                     safety_threshold,
+                     stitched[i]);
+    });
+
+    ConcretePathSet paths(addresses);
+    for(const auto &result : stitched) {
+        paths.merge(result);
+    }
+
+    /* If there are no interesting blocks, collect all paths from the root
+     * node to any exit block.
+     */
+    if(paths.empty()) {
+        auto root_to_exit = breadth_first(blocks, root, &is_exit_block);
+        for(const auto &kv : root_to_exit) {
+            if(!contains_duplicates(kv.second)) {
+                paths.insert(to_indexes(kv.second));
             }
         }
     }
 
-    // Stitch together possible paths.
-    set<ConcretePath> paths;
+    // Keep the order in which the paths used to be traversed.
+    paths.sort();
+    return paths;
+}
+
+/*!
+ * \brief Stitches the sub-paths together into paths starting with the given
+ * path from the root to an interesting block.
+ */
+void PathBuilder::stitch_paths(
+        const BlockIndexPath &root_to_first,
+        const map<uint32_t, vector<BlockIndexPath>> &interesting_to_exit,
+        const map<uint32_t, IndexPathsByNode> &interesting_to_interesting,
+        bool safety_threshold,
+        ConcretePathSet &paths) const {
 
     /* TODO: Constraint the number of interesting nodes to chain on a
      * single path. */
     struct Entry {
-        ConcretePath path;
-        set<uintptr_t> visited;
+        BlockIndexPath path;
+        set<uint32_t> visited;
     };
 
     queue<Entry> work;
-    for(const auto &kv : root_to_interesting) {
-        Entry entry;
-        entry.path = kv.second;
-        entry.visited.insert(kv.first);
+    Entry entry;
+    entry.path = root_to_first;
+    entry.visited.insert(root_to_first.back());
 
-        work.push(entry);
-    }
+    work.push(entry);
 
+    BlockIndexPath head;
     while(!work.empty()) {
         auto current = work.front();
         work.pop();
 
-        auto tails = interesting_to_exit[current.path.back()];
+        const auto &tails = interesting_to_exit.at(current.path.back());
         for(const auto &tail : tails) {
-            deque<uintptr_t> head = current.path;
-            head.pop_back();
-
-            for(const auto &t : tail) {
-                head.push_back(t);
-            }
+            head.assign(current.path.cbegin(), current.path.cend() - 1);
+            head.insert(head.end(), tail.cbegin(), tail.cend());
 
             paths.insert(head);
         }
@@ -169,7 +401,13 @@ set<ConcretePath> PathBuilder::build_paths(BlockPredicate predicate) const {
             continue;
         }
 
-        for(const auto &kv : interesting_to_interesting[current.path.back()]) {
+        const auto &others = interesting_to_interesting.find(
+                                                         current.path.back());
+        if(others == interesting_to_interesting.cend()) {
+            continue;
+        }
+
+        for(const auto &kv : others->second) {
             const auto &next_node = kv.first;
 
             auto needle = current.visited.find(next_node);
@@ -180,12 +418,9 @@ set<ConcretePath> PathBuilder::build_paths(BlockPredicate predicate) const {
             Entry next;
             const auto &path_to_next = kv.second;
 
-            next.path = current.path;
-            next.path.pop_back();
-
-            for(const auto &p : path_to_next) {
-                next.path.push_back(p);
-            }
+            next.path.assign(current.path.cbegin(), current.path.cend() - 1);
+            next.path.insert(next.path.end(), path_to_next.cbegin(),
+                             path_to_next.cend());
 
             next.visited = current.visited;
             next.visited.insert(next_node);
@@ -193,20 +428,6 @@ set<ConcretePath> PathBuilder::build_paths(BlockPredicate predicate) const {
             work.push(next);
         }
     }
-
-    /* If there are no interesting blocks, collect all paths from the root
-     * node to any exit block.
-     */
-    if(paths.empty()) {
-        auto root_to_exit = breadth_first(blocks, root, &is_exit_block);
-        for(const auto &kv : root_to_exit) {
-            if(!contains_duplicates(kv.second)) {
-                paths.insert(kv.second);
-            }
-        }
-    }
-
-    return paths;
 }
 
 struct Node {
@@ -0,0 +1,141 @@
+#include "reachability.h"
+
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+using namespace std;
+
+/*!
+ * \brief Builds the index.
+ *
+ * \param addresses The addresses of the nodes.
+ * \param successors The successors (as indexes into `addresses`) of each node.
+ */
+void Reachability::build(const vector<uintptr_t> &addresses,
+                         const vector<vector<uint32_t>> &successors) {
+
+    const uint32_t unvisited = numeric_limits<uint32_t>::max();
+    const size_t num_nodes = addresses.size();
+
+    // Tarjan's algorithm (iteratively). Components are numbered in reverse
+    // topological order, i.e., successors of a component have lower numbers.
+    vector<uint32_t> index(num_nodes, unvisited);
+    vector<uint32_t> lowlink(num_nodes, 0);
+    vector<uint32_t> component(num_nodes, unvisited);
+    vector<bool> on_stack(num_nodes, false);
+    vector<uint32_t> stack;
+    vector<pair<uint32_t, size_t>> call_stack;
+    uint32_t next_index = 0;
+
+    _num_components = 0;
+    for(uint32_t root = 0; root < num_nodes; root++) {
+        if(index[root] != unvisited) {
+            continue;
+        }
+
+        index[root] = lowlink[root] = next_index++;
+        stack.push_back(root);
+        on_stack[root] = true;
+        call_stack.push_back(make_pair(root, 0));
+
+        while(!call_stack.empty()) {
+            auto &frame = call_stack.back();
+            uint32_t node = frame.first;
+
+            if(frame.second < successors[node].size()) {
+                uint32_t next = successors[node][frame.second++];
+                if(index[next] == unvisited) {
+                    index[next] = lowlink[next] = next_index++;
+                    stack.push_back(next);
+                    on_stack[next] = true;
+                    call_stack.push_back(make_pair(next, 0));
+                }
+                else if(on_stack[next]) {
+                    lowlink[node] = min(lowlink[node], index[next]);
+                }
+                continue;
+            }
+
+            if(lowlink[node] == index[node]) {
+                while(true) {
+                    uint32_t member = stack.back();
+                    stack.pop_back();
+                    on_stack[member] = false;
+                    component[member] = _num_components;
+                    if(member == node) {
+                        break;
+                    }
+                }
+                _num_components++;
+            }
+
+            call_stack.pop_back();
+            if(!call_stack.empty()) {
+                uint32_t parent = call_stack.back().first;
+                lowlink[parent] = min(lowlink[parent], lowlink[node]);
+            }
+        }
+    }
+
+    _components.clear();
+    for(uint32_t i = 0; i < num_nodes; i++) {
+        _components[addresses[i]] = component[i];
+    }
+
+    _matrix.clear();
+    _has_matrix = _num_components <= REACHABILITY_MAX_COMPONENTS;
+    if(!_has_matrix) {
+        return;
+    }
+
+    vector<vector<uint32_t>> members(_num_components);
+    for(uint32_t i = 0; i < num_nodes; i++) {
+        members[component[i]].push_back(i);
+    }
+
+    // Each row is the union of the rows of the successor components (which
+    // are all computed already).
+    _row_words = (_num_components + 63) / 64;
+    _matrix.assign(_num_components * _row_words, 0);
+    for(uint32_t c = 0; c < _num_components; c++) {
+        uint64_t *row = &_matrix[c * _row_words];
+        row[c / 64] |= 1ULL << (c % 64);
+
+        for(uint32_t node : members[c]) {
+            for(uint32_t next : successors[node]) {
+                uint32_t d = component[next];
+                if(d == c) {
+                    continue;
+                }
+
+                const uint64_t *other = &_matrix[d * _row_words];
+                for(size_t w = 0; w < _row_words; w++) {
+                    row[w] |= other[w];
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Returns whether `destination` can be reached from `source` (every
+ * node reaches itself).
+ *
+ * \return `false` if either address is not a node of the graph.
+ */
+bool Reachability::is_reachable(uintptr_t source,
+                                uintptr_t destination) const {
+
+    const auto &src = _components.find(source);
+    const auto &dst = _components.find(destination);
+    if(src == _components.cend() || dst == _components.cend()) {
+        return false;
+    }
+    if(src->second == dst->second || !_has_matrix) {
+        return true;
+    }
+
+    const uint64_t *row = &_matrix[src->second * _row_words];
+    return (row[dst->second / 64] >> (dst->second % 64)) & 1;
+}
@@ -0,0 +1,210 @@
+#include "result_stream.h"
+
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+ResultStream::ResultStream(ResultStreamMode mode,
+                           const string &target_dir,
+                           const string &module_name)
+    : _mode(mode) {
+
+    if(_mode == ResultStreamDisabled) {
+        return;
+    }
+
+    _file_name = target_dir + "/" + module_name + ".marx_results";
+    if(_mode == ResultStreamText) {
+        _file_name += ".txt";
+        _file.open(_file_name, ios::trunc);
+    }
+    else {
+        _file.open(_file_name, ios::binary | ios::trunc);
+        _file.write(RESULT_STREAM_MAGIC, 8);
+        uint64_t version = RESULT_STREAM_VERSION;
+        _file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+    if(!_file) {
+        cerr << "Not able to open result stream file '"
+             << _file_name
+             << "'."
+             << "\n";
+    }
+
+    _chunk.reserve(RESULT_STREAM_CHUNK_SIZE);
+    _writer = thread(&ResultStream::writer_main, this);
+}
+
+ResultStream::~ResultStream() {
+    finish();
+}
+
+void ResultStream::writer_main() {
+    unique_lock<mutex> lock(_mtx);
+    while(true) {
+        _cv_writer.wait(lock, [&] {
+            return _stop || !_pending_chunks.empty();
+        });
+        if(_pending_chunks.empty()) {
+            return;
+        }
+
+        // Write without holding the lock so producers can keep appending.
+        string chunk = move(_pending_chunks.front());
+        _pending_chunks.pop_front();
+        _cv_producers.notify_all();
+        lock.unlock();
+        _file.write(chunk.data(), chunk.size());
+        lock.lock();
+    }
+}
+
+// Values are stored as unsigned LEB128.
+void ResultStream::append_value(uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if(value) {
+            byte |= 0x80;
+        }
+        _chunk.push_back(static_cast<char>(byte));
+    } while(value);
+}
+
+void ResultStream::append_module(const string &module_name) {
+    if(_module_ids.find(module_name) != _module_ids.cend()) {
+        return;
+    }
+    uint64_t module_id = _module_ids.size();
+    _module_ids[module_name] = module_id;
+
+    _chunk.push_back(static_cast<char>(ResultRecordModule));
+    append_value(module_id);
+    append_value(module_name.size());
+    _chunk.append(module_name);
+}
+
+// Hands the chunk to the writer thread once it is full (must be called
+// with the lock held after each record).
+void ResultStream::append_record_end() {
+    if(_chunk.size() < RESULT_STREAM_CHUNK_SIZE) {
+        return;
+    }
+
+    unique_lock<mutex> lock(_mtx, adopt_lock);
+    _cv_producers.wait(lock, [&] {
+        return _pending_chunks.size() < RESULT_STREAM_MAX_PENDING_CHUNKS;
+    });
+    _pending_chunks.push_back(move(_chunk));
+    _chunk = string();
+    _chunk.reserve(RESULT_STREAM_CHUNK_SIZE);
+    _cv_writer.notify_one();
+    lock.release();
+}
+
+void ResultStream::add_vcall(uint64_t icall_addr,
+                             const string &vtable_module,
+                             uint64_t vtable_addr,
+                             uint64_t entry_index) {
+    if(_mode == ResultStreamDisabled) {
+        return;
+    }
+    _mtx.lock();
+
+    if(_mode == ResultStreamText) {
+        stringstream line;
+        line << "vcall "
+             << hex << icall_addr << " "
+             << vtable_module << ":" << hex << vtable_addr << " "
+             << dec << entry_index << "\n";
+        _chunk.append(line.str());
+    }
+    else {
+        append_module(vtable_module);
+        _chunk.push_back(static_cast<char>(ResultRecordVCall));
+        append_value(icall_addr);
+        append_value(_module_ids.at(vtable_module));
+        append_value(vtable_addr);
+        append_value(entry_index);
+    }
+
+    append_record_end();
+    _mtx.unlock();
+}
+
+void ResultStream::add_possible_vcall(uint64_t icall_addr) {
+    if(_mode == ResultStreamDisabled) {
+        return;
+    }
+    _mtx.lock();
+
+    if(_mode == ResultStreamText) {
+        stringstream line;
+        line << "possible_vcall " << hex << icall_addr << "\n";
+        _chunk.append(line.str());
+    }
+    else {
+        _chunk.push_back(static_cast<char>(ResultRecordPossibleVCall));
+        append_value(icall_addr);
+    }
+
+    append_record_end();
+    _mtx.unlock();
+}
+
+void ResultStream::add_object_allocation(uint64_t vtable_init_addr,
+                                         const string &vtable_module,
+                                         uint64_t vtable_addr,
+                                         uint64_t vtbl_xref_addr) {
+    if(_mode == ResultStreamDisabled) {
+        return;
+    }
+    _mtx.lock();
+
+    if(_mode == ResultStreamText) {
+        stringstream line;
+        line << "obj_alloc "
+             << hex << vtable_init_addr << " "
+             << vtable_module << ":" << hex << vtable_addr << " "
+             << hex << vtbl_xref_addr << "\n";
+        _chunk.append(line.str());
+    }
+    else {
+        append_module(vtable_module);
+        _chunk.push_back(static_cast<char>(ResultRecordObjectAllocation));
+        append_value(vtable_init_addr);
+        append_value(_module_ids.at(vtable_module));
+        append_value(vtable_addr);
+        append_value(vtbl_xref_addr);
+    }
+
+    append_record_end();
+    _mtx.unlock();
+}
+
+bool ResultStream::finish() {
+    if(_mode == ResultStreamDisabled || !_writer.joinable()) {
+        return true;
+    }
+
+    _mtx.lock();
+    if(!_chunk.empty()) {
+        _pending_chunks.push_back(move(_chunk));
+        _chunk = string();
+    }
+    _stop = true;
+    _mtx.unlock();
+    _cv_writer.notify_one();
+    _writer.join();
+
+    _file.close();
+    if(_file.fail()) {
+        cerr << "Not able to write result stream file '"
+             << _file_name
+             << "'."
+             << "\n";
+        return false;
+    }
+    return true;
+}
@@ -1,9 +1,14 @@
 
 #include "return_value.h"
 
+#include <cstring>
+
 
 using namespace std;
 
+#define RETURN_VALUES_FILE_MAGIC "MARXRETV"
+#define RETURN_VALUES_FILE_VERSION 1
+
 
 FctReturnValuesFile::FctReturnValuesFile(const string &module_name,
                                          const VTableFile &vtable_file,
@@ -76,6 +81,15 @@ void FctReturnValuesFile::export_return_values(const string &target_dir) {
     ofstream ret_file;
     ret_file.open(target_file, ios::out|ios::binary);
 
+    // The expressions of all functions share one table of
+    // sub-expressions (files without the magic store each expression in
+    // full and are still importable).
+    uint32_t version = RETURN_VALUES_FILE_VERSION;
+    ret_file.write(RETURN_VALUES_FILE_MAGIC, 8);
+    ret_file.write(reinterpret_cast<const char *>(&version),
+                   sizeof(version));
+    SharedExpressionWriter writer(ret_file);
+
     // First entry of file is always the module name.
     ret_file.write(_module_name.c_str(), _module_name.length() + 1);
 
@@ -88,7 +102,7 @@ void FctReturnValuesFile::export_return_values(const string &target_dir) {
         ret_file.write(reinterpret_cast<const char *>(&number),
                        sizeof(number));
         for(const auto &it : kv.second.return_values) {
-            serialize(it.content, ret_file);
+            writer.write(it.content);
         }
 
         number = kv.second.active_vtables.size();
@@ -96,7 +110,7 @@ void FctReturnValuesFile::export_return_values(const string &target_dir) {
                        sizeof(number));
         for(const auto &it : kv.second.active_vtables) {
 
-            serialize(it.vtbl_ptr_loc, ret_file);
+            writer.write(it.vtbl_ptr_loc);
 
             const VTable &vtable = _vtable_file.get_vtable(it.index);
 
@@ -114,6 +128,14 @@ void FctReturnValuesFile::export_return_values(const string &target_dir) {
 
 
 void FctReturnValuesFile::import_ext_return_values(const string &module_file) {
+    ExtReturnValues ext_return_values;
+    read_ext_return_values(module_file, ext_return_values);
+    add_ext_return_values(ext_return_values);
+}
+
+
+void FctReturnValuesFile::add_ext_return_values(
+                                         ExtReturnValues &ext_return_values) {
     lock_guard<mutex> _(_mtx);
 
     // Make sure that the object is finalized.
@@ -121,11 +143,46 @@ void FctReturnValuesFile::import_ext_return_values(const string &module_file) {
         throw runtime_error("FctReturnValuesFile object is finalized.");
     }
 
+    _ext_return_values.insert(_ext_return_values.end(),
+                              make_move_iterator(ext_return_values.begin()),
+                              make_move_iterator(ext_return_values.end()));
+    ext_return_values.clear();
+}
+
+
+void FctReturnValuesFile::read_ext_return_values(
+                                   const string &module_file,
+                                   ExtReturnValues &ext_return_values) const {
+
+    // Make sure that the object is finalized.
+    if(_is_finalized) {
+        throw runtime_error("FctReturnValuesFile object is finalized.");
+    }
+
     ifstream ret_file(module_file + ".ret_values", ios::in|ios::binary);
     if(!ret_file) {
         throw runtime_error("Could not open return values file.");
     }
 
+    char magic[8] = {0};
+    ret_file.read(magic, sizeof(magic));
+    if(ret_file && memcmp(magic, RETURN_VALUES_FILE_MAGIC, 8) == 0) {
+        uint32_t version = 0;
+        ret_file.read(reinterpret_cast<char *>(&version),
+                      sizeof(version));
+        if(version != RETURN_VALUES_FILE_VERSION) {
+            throw runtime_error("Unsupported return values file version.");
+        }
+    }
+    else {
+        ret_file.clear();
+        ret_file.seekg(0);
+    }
+
+    // Plain serialized expressions contain no references, hence the reader
+    // handles both formats.
+    SharedExpressionReader reader(ret_file);
+
     // First entry of file is always the module name.
     string import_module_name;
     // Read C-like string.
@@ -151,7 +208,7 @@ void FctReturnValuesFile::import_ext_return_values(const string &module_file) {
 
         for(uint32_t i = 0; i < number; i++) {
             ReturnValue ret_value;
-            ret_value.content = unserialize(ret_file);
+            ret_value.content = reader.read();
             ret_value.func_addr = 0;
             func_ret_values.return_values.push_back(ret_value);
         }
@@ -164,7 +221,7 @@ void FctReturnValuesFile::import_ext_return_values(const string &module_file) {
             VTableActive act_vtable;
             act_vtable.from_callee = true;
             act_vtable.from_caller = false;
-            act_vtable.vtbl_ptr_loc = unserialize(ret_file);
+            act_vtable.vtbl_ptr_loc = reader.read();
 
             string vtbl_module_name;
             // Read C-like string.
@@ -192,7 +249,7 @@ void FctReturnValuesFile::import_ext_return_values(const string &module_file) {
         ExternalFctReturnValues ext_ret_value;
         ext_ret_value.func_return_values = func_ret_values;
         ext_ret_value.ext_func = ext_func;
-        _ext_return_values.push_back(ext_ret_value);
+        ext_return_values.push_back(ext_ret_value);
     }
 
     ret_file.close();
@@ -265,7 +322,8 @@ void FctReturnValuesFile::finalize_ext_return_values() {
         ExternalFctReturnValues &ext_ret_value = _ext_return_values[i];
 
         const PltEntry *plt_entry;
-        plt_entry = _module_plt.get_plt_entry(ext_ret_value.ext_func->name);
+        plt_entry = _module_plt.get_plt_entry_by_id(
+                                              ext_ret_value.ext_func->name_id);
         if(plt_entry == nullptr) {
             continue;
         }
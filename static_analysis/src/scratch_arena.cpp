@@ -0,0 +1,117 @@
+#include "scratch_arena.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+
+using namespace std;
+
+static thread_local ScratchArena thread_arena;
+static thread_local ScratchArena *active_arena = nullptr;
+static atomic<size_t> peak_item_size{0};
+
+ScratchArena::~ScratchArena() {
+    for(char *chunk : _chunks) {
+        free(chunk);
+    }
+    for(char *allocation : _large_allocations) {
+        free(allocation);
+    }
+}
+
+void *ScratchArena::allocate(size_t size, size_t alignment) {
+
+    // Objects larger than a chunk get their own allocation (freed by the
+    // next reset).
+    if(size + alignment > SCRATCH_ARENA_CHUNK_SIZE) {
+        char *allocation = static_cast<char*>(malloc(size));
+        if(allocation == nullptr) {
+            throw bad_alloc();
+        }
+        _large_allocations.push_back(allocation);
+        _large_size += size;
+        return allocation;
+    }
+
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(_current)
+                                  % alignment) % alignment;
+    if(_current == nullptr || size + padding > _remaining) {
+
+        // Continue with the next retained chunk if one is left.
+        if(_current != nullptr) {
+            _chunk_idx++;
+        }
+        if(_chunk_idx == _chunks.size()) {
+            char *chunk = static_cast<char*>(malloc(SCRATCH_ARENA_CHUNK_SIZE));
+            if(chunk == nullptr) {
+                throw bad_alloc();
+            }
+            _chunks.push_back(chunk);
+        }
+        _current = _chunks[_chunk_idx];
+        _remaining = SCRATCH_ARENA_CHUNK_SIZE;
+        padding = (alignment - reinterpret_cast<uintptr_t>(_current)
+                               % alignment) % alignment;
+    }
+
+    void *result = _current + padding;
+    _current += padding + size;
+    _remaining -= padding + size;
+    return result;
+}
+
+/*!
+ * \brief Releases all objects of the arena at once.
+ */
+void ScratchArena::reset() {
+    const size_t used_size = get_used_size();
+    size_t peak_size = peak_item_size.load(memory_order_relaxed);
+    while(used_size > peak_size
+          && !peak_item_size.compare_exchange_weak(peak_size, used_size)) {
+    }
+
+    for(char *allocation : _large_allocations) {
+        free(allocation);
+    }
+    _large_allocations.clear();
+    _large_size = 0;
+
+    while(_chunks.size() > SCRATCH_ARENA_RETAINED_CHUNKS) {
+        free(_chunks.back());
+        _chunks.pop_back();
+    }
+    _chunk_idx = 0;
+    _current = nullptr;
+    _remaining = 0;
+}
+
+size_t ScratchArena::get_used_size() const {
+    if(_current == nullptr) {
+        return _large_size;
+    }
+    return _chunk_idx * SCRATCH_ARENA_CHUNK_SIZE
+           + (SCRATCH_ARENA_CHUNK_SIZE - _remaining)
+           + _large_size;
+}
+
+size_t ScratchArena::get_peak_item_size() {
+    return peak_item_size;
+}
+
+ScratchArena *ScratchArena::current() {
+    return active_arena;
+}
+
+ScopedScratchArena::ScopedScratchArena()
+    : _is_owner(active_arena == nullptr) {
+    if(_is_owner) {
+        active_arena = &thread_arena;
+    }
+}
+
+ScopedScratchArena::~ScopedScratchArena() {
+    if(_is_owner) {
+        active_arena = nullptr;
+        thread_arena.reset();
+    }
+}
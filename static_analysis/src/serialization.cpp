@@ -3,8 +3,19 @@
 
 using namespace std;
 
+//! Marks a reference to an expression that was written before (followed by
+//! its id). \see `SharedExpressionWriter`
+#define SERIALIZED_EXPRESSION_REFERENCE 0xff
 
-void serialize(ExpressionPtr exp, ostream &output) {
+
+/*!
+ * \brief Writes the given expression with `write_child` writing its
+ * sub-expressions.
+ */
+template<typename WriteChild>
+static void serialize_expression(const ExpressionPtr &exp,
+                                 ostream &output,
+                                 WriteChild write_child) {
 
     switch(exp->type()) {
 
@@ -25,9 +36,10 @@ void serialize(ExpressionPtr exp, ostream &output) {
         case ExpressionSymbolic: {
             output.put(ExpressionSymbolic);
             Symbolic &temp = static_cast<Symbolic&>(*exp);
+            const string name = temp.name();
             // Length + 1 to have \0 at the end.
-            output.write(temp.name().c_str(),
-                         temp.name().length() + 1);
+            output.write(name.c_str(),
+                         name.length() + 1);
             break;
         }
 
@@ -52,7 +64,7 @@ void serialize(ExpressionPtr exp, ostream &output) {
         case ExpressionIndirection: {
             output.put(ExpressionIndirection);
             Indirection &temp = static_cast<Indirection&>(*exp);
-            serialize(temp.address(), output);
+            write_child(temp.address());
             break;
         }
 
@@ -60,8 +72,8 @@ void serialize(ExpressionPtr exp, ostream &output) {
             output.put(ExpressionOperation);
             Operation &temp = static_cast<Operation&>(*exp);
             output.put(temp.operation());
-            serialize(temp.lhs(), output);
-            serialize(temp.rhs(), output);
+            write_child(temp.lhs());
+            write_child(temp.rhs());
             break;
         }
 
@@ -72,9 +84,16 @@ void serialize(ExpressionPtr exp, ostream &output) {
 }
 
 
-ExpressionPtr unserialize(istream &input) {
+/*!
+ * \brief Reads an expression of the given type with `read_child` reading
+ * its sub-expressions.
+ */
+template<typename ReadChild>
+static ExpressionPtr unserialize_expression(int type,
+                                            istream &input,
+                                            ReadChild read_child) {
 
-    switch(input.get()) {
+    switch(type) {
 
         case ExpressionUnknown: {
             Unknown temp;
@@ -86,45 +105,44 @@ ExpressionPtr unserialize(istream &input) {
             uint64_t value;
             input.read(reinterpret_cast<char *>(&value),
                        sizeof(value));
-            Constant temp(value);
-            return make_shared<Constant>(temp);
+            return make_constant(value);
         }
 
         case ExpressionSymbolic: {
             string name;
             // Read C-like string.
             getline(input, name, '\0');
-            Symbolic temp(name);
-            return make_shared<Symbolic>(temp);
+            return parse_symbolic(name);
         }
 
         case ExpressionTemporary: {
             uint32_t id;
             input.read(reinterpret_cast<char *>(&id),
                        sizeof(id));
-            Temporary temp(id);
-            return make_shared<Temporary>(temp);
+            return make_temporary(id);
         }
 
         case ExpressionRegister: {
             uint32_t offset;
             input.read(reinterpret_cast<char *>(&offset),
                        sizeof(offset));
-            Register temp(offset);
-            return make_shared<Register>(temp);
+            return make_register(offset);
         }
 
         case ExpressionIndirection: {
-            Indirection temp(unserialize(input));
+            Indirection temp(read_child());
             return make_shared<Indirection>(temp);
             break;
         }
 
         case ExpressionOperation: {
             OperationType op_type = static_cast<OperationType>(input.get());
-            Operation temp(unserialize(input),
+            // Operands have to be read in order.
+            ExpressionPtr lhs = read_child();
+            ExpressionPtr rhs = read_child();
+            Operation temp(lhs,
                            op_type,
-                           unserialize(input));
+                           rhs);
             return make_shared<Operation>(temp);
             break;
         }
@@ -136,3 +154,299 @@ ExpressionPtr unserialize(istream &input) {
     throw runtime_error("Do not know how to unserialize "\
                         "expression type.");
 }
+
+
+void serialize(ExpressionPtr exp, ostream &output) {
+    serialize_expression(exp,
+                         output,
+                         [&](const ExpressionPtr &child) {
+                             serialize(child, output);
+                         });
+}
+
+
+ExpressionPtr unserialize(istream &input) {
+    return unserialize_expression(input.get(),
+                                  input,
+                                  [&]() {
+                                      return unserialize(input);
+                                  });
+}
+
+
+void SharedExpressionWriter::write(const ExpressionPtr &exp) {
+    const auto needle = _ids.find(exp);
+    if(needle != _ids.cend()) {
+        _output.put(static_cast<char>(SERIALIZED_EXPRESSION_REFERENCE));
+        uint32_t id = needle->second;
+        _output.write(reinterpret_cast<const char *>(&id),
+                      sizeof(id));
+        return;
+    }
+
+    serialize_expression(exp,
+                         _output,
+                         [&](const ExpressionPtr &child) {
+                             write(child);
+                         });
+
+    // Ids are assigned after the sub-expressions (in the same order as
+    // the reader rebuilds them).
+    uint32_t id = _ids.size();
+    _ids.emplace(exp, id);
+}
+
+
+ExpressionPtr SharedExpressionReader::read() {
+    int type = _input.get();
+    if(type == SERIALIZED_EXPRESSION_REFERENCE) {
+        uint32_t id;
+        _input.read(reinterpret_cast<char *>(&id),
+                    sizeof(id));
+        if(!_input || id >= _expressions.size()) {
+            throw runtime_error("Invalid reference to serialized "\
+                                "expression.");
+        }
+        return _expressions[id];
+    }
+
+    ExpressionPtr result = unserialize_expression(type,
+                                                  _input,
+                                                  [&]() {
+                                                      return read();
+                                                  });
+    _expressions.push_back(result);
+    return result;
+}
+
+
+void ExpressionEncoder::encode(const ExpressionPtr &exp) {
+    _stack.clear();
+    _stack.push_back(exp.get());
+
+    while(!_stack.empty()) {
+        const Expression *current = _stack.back();
+        _stack.pop_back();
+
+        put<uint8_t>(current->type());
+        switch(current->type()) {
+
+            case ExpressionUnknown:
+                break;
+
+            case ExpressionConstant:
+                put<uint64_t>(static_cast<const Constant*>(current)->value());
+                break;
+
+            case ExpressionSymbolic: {
+                const Symbolic &temp = *static_cast<const Symbolic*>(current);
+                put<uint8_t>(temp.kind());
+                if(temp.kind() != SymbolicNamed) {
+                    put<uint64_t>(temp.payload());
+                    break;
+                }
+
+                // Length + 1 to have \0 at the end.
+                const string name = temp.name();
+                _buffer.insert(_buffer.end(),
+                               name.c_str(),
+                               name.c_str() + name.length() + 1);
+                break;
+            }
+
+            case ExpressionTemporary:
+                put<uint32_t>(static_cast<const Temporary*>(current)->id());
+                break;
+
+            case ExpressionRegister:
+                put<uint32_t>(static_cast<const Register*>(current)->offset());
+                break;
+
+            case ExpressionIndirection:
+                _stack.push_back(
+                     static_cast<const Indirection*>(current)->address().get());
+                break;
+
+            case ExpressionOperation: {
+                const Operation &temp = *static_cast<const Operation*>(current);
+                put<uint8_t>(temp.operation());
+
+                // The left-hand side is encoded first.
+                _stack.push_back(temp.rhs().get());
+                _stack.push_back(temp.lhs().get());
+                break;
+            }
+
+            default:
+                throw runtime_error("Do not know how to serialize "\
+                                    "expression type.");
+        }
+    }
+}
+
+
+/*!
+ * \brief Encodes all bindings of the given state (the number of bindings
+ * followed by each key and value).
+ */
+void ExpressionEncoder::encode(const State &state) {
+    put<uint32_t>(distance(state.begin(), state.end()));
+    for(const auto &kv : state) {
+        encode(kv.first);
+        encode(kv.second);
+    }
+}
+
+
+/*!
+ * \brief Decodes the next expression.
+ *
+ * \return `false` if the buffer does not hold a valid expression at the
+ * current position.
+ */
+bool ExpressionDecoder::decode(ExpressionPtr &exp) {
+    _frames.clear();
+
+    while(true) {
+        uint8_t type;
+        if(!get(type)) {
+            return false;
+        }
+
+        ExpressionPtr result;
+        switch(type) {
+
+            case ExpressionUnknown:
+                result = make_shared<Unknown>();
+                break;
+
+            case ExpressionConstant: {
+                uint64_t value;
+                if(!get(value)) {
+                    return false;
+                }
+                result = make_constant(value);
+                break;
+            }
+
+            case ExpressionSymbolic: {
+                uint8_t kind;
+                if(!get(kind) || kind >= SymbolicKindCount) {
+                    return false;
+                }
+                if(kind != SymbolicNamed) {
+                    uint64_t payload;
+                    if(!get(payload)) {
+                        return false;
+                    }
+                    result = make_symbolic(static_cast<SymbolicKind>(kind),
+                                           payload);
+                    break;
+                }
+
+                const uint8_t *name = _data + _offset;
+                const void *end = memchr(name, '\0', _size - _offset);
+                if(end == nullptr) {
+                    return false;
+                }
+                size_t length = static_cast<const uint8_t*>(end) - name;
+                result = make_symbolic(string(reinterpret_cast<const char*>(
+                                                                      name),
+                                              length));
+                _offset += length + 1;
+                break;
+            }
+
+            case ExpressionTemporary: {
+                uint32_t id;
+                if(!get(id)) {
+                    return false;
+                }
+                result = make_temporary(id);
+                break;
+            }
+
+            case ExpressionRegister: {
+                uint32_t offset;
+                if(!get(offset)) {
+                    return false;
+                }
+                result = make_register(offset);
+                break;
+            }
+
+            case ExpressionIndirection: {
+                Frame frame;
+                frame.type = ExpressionIndirection;
+                frame.operation = OperationCount;
+                _frames.push_back(frame);
+                continue;
+            }
+
+            case ExpressionOperation: {
+                uint8_t operation;
+                if(!get(operation) || operation >= OperationCount) {
+                    return false;
+                }
+
+                Frame frame;
+                frame.type = ExpressionOperation;
+                frame.operation = static_cast<OperationType>(operation);
+                _frames.push_back(frame);
+                continue;
+            }
+
+            default:
+                return false;
+        }
+
+        // Complete all frames whose operands are decoded by now.
+        while(!_frames.empty()) {
+            Frame &frame = _frames.back();
+            if(frame.type == ExpressionOperation && !frame.lhs) {
+                frame.lhs = result;
+                break;
+            }
+
+            if(frame.type == ExpressionIndirection) {
+                result = make_shared<Indirection>(result);
+            }
+            else {
+                result = make_shared<Operation>(frame.lhs,
+                                                frame.operation,
+                                                result);
+            }
+            _frames.pop_back();
+        }
+
+        if(_frames.empty()) {
+            exp = result;
+            return true;
+        }
+    }
+}
+
+
+/*!
+ * \brief Decodes the next state (the bindings are added to `state`).
+ *
+ * \return `false` if the buffer does not hold a valid state at the current
+ * position.
+ */
+bool ExpressionDecoder::decode(State &state) {
+    uint32_t number;
+    if(!get(number)) {
+        return false;
+    }
+
+    for(uint32_t i = 0; i < number; i++) {
+        ExpressionPtr key;
+        ExpressionPtr value;
+        if(!decode(key) || !decode(value)) {
+            return false;
+        }
+        state.update(key, value);
+    }
+
+    return true;
+}
@@ -1,5 +1,10 @@
-
 #include "ssa.h"
+#include "analysis_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
 
 using namespace std;
 
@@ -7,57 +12,166 @@ using namespace std;
 ModuleSSA::ModuleSSA() {
 }
 
-const ssa::Function &ModuleSSA::get_ssa_function(const ssa::Functions &ssa_functions,
-                                                 uintptr_t address) {
-    for(int i = 0; i < ssa_functions.functions_size(); i++) {
-        const ssa::Function &ssa_function = ssa_functions.functions(i);
-        if(ssa_function.address() == address) {
-            return ssa_function;
-        }
+/*!
+ * \brief Decodes the given `_ssa.pb2_partN` file.
+ *
+ * \return The decoded part or `nullptr` if the file could not be parsed.
+ */
+static unique_ptr<ssa::Functions> parse_part(const string &part_file) {
+    ifstream file(part_file);
+    unique_ptr<ssa::Functions> part(new ssa::Functions());
+    if(!file || !part->ParseFromIstream(&file)) {
+        return nullptr;
     }
-    stringstream err_msg;
-    err_msg << "Can not find SSA data for function with address: "
-            << hex << address << ".";
-    throw runtime_error(err_msg.str().c_str());
+    return part;
 }
 
-bool ModuleSSA::parse(const string &target_file, Translator &translator) {
+/*!
+ * \brief Transfers the SSA data of one part into the `Function` objects that
+ * have not been served by a previous part.
+ *
+ * The first part holding an address owns it (as it did with the linear
+ * search over the glued data), hence the owned functions are claimed before
+ * any of them is imported. The function objects are disjoint, hence they are
+ * filled concurrently with more than one thread. An error is reported for
+ * the first function (in part order) that failed.
+ */
+void ModuleSSA::import_part(const ssa::Functions &part,
+                            UnclaimedFunctions &unclaimed,
+                            uint32_t num_threads) {
 
-    // Import all protobuf data (it was split into several parts because
-    // of IDAs 32 bit memory restriction => glue it together again).
-    ssa::Functions ssa_functions;
-    uint32_t file_ctr = 0;
-    while(true) {
-        string input_file = target_file + "_ssa.pb2_part" + to_string(file_ctr);
-        ifstream file(input_file);
-        if(!file) {
-            break;
+    vector<pair<Function*, const ssa::Function*>> owned;
+    for(int i = 0; i < part.functions_size(); i++) {
+        const ssa::Function &ssa_function = part.functions(i);
+        const auto needle = unclaimed.find(ssa_function.address());
+        if(needle != unclaimed.end()) {
+            owned.emplace_back(needle->second, &ssa_function);
+            unclaimed.erase(needle);
         }
-        file_ctr++;
+    }
 
-        ssa::Functions temp_functions;
-        if(!temp_functions.ParseFromIstream(&file)) {
-            cerr << "Failed to parse pb2 file: " << input_file << "\n";
-            return false;
+    vector<exception_ptr> errors(owned.size());
+    atomic<size_t> next_function(0);
+    auto worker = [&]() {
+        while(true) {
+            const size_t func_idx = next_function++;
+            if(func_idx >= owned.size()) {
+                break;
+            }
+            try {
+                Function &function = *owned[func_idx].first;
+                const ssa::Function &ssa_function = *owned[func_idx].second;
+
+                // Add SSA information to function object.
+                for(int i = 0; i < ssa_function.basic_blocks_size(); i++) {
+                    const ssa::BasicBlock &basic_block =
+                                                 ssa_function.basic_blocks(i);
+                    function.add_block_ssa(basic_block);
+                }
+                function.finalize_ssa();
+            }
+            catch(...) {
+                errors[func_idx] = current_exception();
+            }
         }
+    };
+
+    // For debugging purposes do not spawn any thread.
+    const uint32_t num_workers = min<size_t>(num_threads, owned.size());
+    if(num_workers <= 1) {
+        worker();
+    }
+    else {
+        vector<thread> threads;
+        for(uint32_t i = 0; i < num_workers; i++) {
+            threads.emplace_back(worker);
+        }
+        for(thread &t : threads) {
+            t.join();
+        }
+    }
+    for(const exception_ptr &error : errors) {
+        if(error) {
+            rethrow_exception(error);
+        }
+    }
 
-        // Glue imported data together.
-        for(int i = 0; i < temp_functions.functions_size(); i++) {
-            ssa::Function *ssa_function = ssa_functions.add_functions();
-            ssa_function->CopyFrom(temp_functions.functions(i));
+    // The cache file is written in part order, independent of the
+    // order in which the functions were imported.
+    if(_cache) {
+        for(const auto &kv : owned) {
+            _cache->add_ssa_function(*kv.second);
         }
     }
+}
+
+/*!
+ * \brief Imports the exported SSA data of all functions.
+ *
+ * The `_ssa.pb2_partN` files are imported one after another and each part
+ * is released as soon as its functions were filled, hence at most the
+ * imported part and the next one (which is decoded in the meantime) are
+ * held in memory.
+ *
+ * \param num_threads With more than one thread, the next part is decoded
+ * while the current one is imported and the `Function` objects of a part
+ * are filled concurrently. The result is the same for any number of
+ * threads.
+ * \param cache If given, the SSA data of each imported function is also
+ * added to the analysis cache file that is currently written.
+ */
+bool ModuleSSA::parse(const string &target_file,
+                      Translator &translator,
+                      uint32_t num_threads,
+                      AnalysisCache *cache) {
 
+    _cache = cache;
+
+    // Import all protobuf data (it was split into several parts because
+    // of IDAs 32 bit memory restriction).
+    uint32_t num_parts = 0;
+    while(ifstream(target_file + "_ssa.pb2_part" + to_string(num_parts))) {
+        num_parts++;
+    }
+
+    UnclaimedFunctions unclaimed;
+    unclaimed.reserve(translator.get_functions().size());
     for(auto &kv_func : translator.get_functions_mutable()) {
-        Function &function = kv_func.second;
+        unclaimed.emplace(kv_func.second.get_entry(), &kv_func.second);
+    }
 
-        const ssa::Function &ssa_function = get_ssa_function(ssa_functions,
-                                                          function.get_entry());
+    const launch policy = num_threads > 1 ? launch::async : launch::deferred;
+    future<unique_ptr<ssa::Functions>> next_part;
+    if(num_parts > 0) {
+        next_part = async(policy, parse_part, target_file + "_ssa.pb2_part0");
+    }
+    for(uint32_t part_idx = 0; part_idx < num_parts; part_idx++) {
+        unique_ptr<ssa::Functions> part = next_part.get();
+        if(part_idx + 1 < num_parts) {
+            next_part = async(policy, parse_part,
+                              target_file + "_ssa.pb2_part"
+                              + to_string(part_idx + 1));
+        }
+
+        if(!part) {
+            cerr << "Failed to parse pb2 file: "
+                 << target_file << "_ssa.pb2_part" << dec << part_idx
+                 << "\n";
+            return false;
+        }
+
+        // The part is released at the end of the iteration, its protobuf
+        // data is not needed anymore after it was transferred into the
+        // function objects.
+        import_part(*part, unclaimed, num_threads);
+    }
 
-        // Add SSA information to function object.
-        for(int i = 0; i < ssa_function.basic_blocks_size(); i++) {
-            const ssa::BasicBlock &basic_block = ssa_function.basic_blocks(i);
-            function.add_block_ssa(basic_block);
+    for(const auto &kv_func : translator.get_functions()) {
+        if(unclaimed.find(kv_func.second.get_entry()) != unclaimed.cend()) {
+            stringstream err_msg;
+            err_msg << "Can not find SSA data for function with address: "
+                    << hex << kv_func.second.get_entry() << ".";
+            throw runtime_error(err_msg.str().c_str());
         }
     }
 
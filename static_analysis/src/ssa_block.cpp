@@ -29,7 +29,8 @@ const BaseInstructionSSAPtrSet BlockSSA::get_instruction(
     return result;
 }
 
-BlockSSA::BlockSSA(const ssa::BasicBlock &basic_block) {
+BlockSSA::BlockSSA(const ssa::BasicBlock &basic_block,
+                   OperandSSATable *operand_table) {
     _address = basic_block.address();
     _last_address = basic_block.end();
 
@@ -46,16 +47,19 @@ BlockSSA::BlockSSA(const ssa::BasicBlock &basic_block) {
         const ssa::Instruction &instruction = basic_block.instructions(i);
         if(instruction.has_instruction()) {
             _instructions.push_back(
-                        make_shared<InstructionSSA>(instruction.instruction()));
+                        make_shared<InstructionSSA>(instruction.instruction(),
+                                                    operand_table));
         }
         else if(instruction.has_phi_node()) {
             _instructions.push_back(
-                               make_shared<PhiNodeSSA>(instruction.phi_node()));
+                               make_shared<PhiNodeSSA>(instruction.phi_node(),
+                                                       operand_table));
         }
         else if(instruction.has_calling_convention()) {
             _instructions.push_back(
                     make_shared<CallingConventionSSA>(
-                                             instruction.calling_convention()));
+                                             instruction.calling_convention(),
+                                             operand_table));
         }
         else {
             throw runtime_error("Imported SSA instruction has unknown type.");
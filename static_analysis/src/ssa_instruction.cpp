@@ -1,8 +1,13 @@
 #include "ssa_instruction.h"
 #include "icall_analysis.h"
 
+#include <mutex>
+
 using namespace std;
 
+static mutex mnemonics_mtx;
+static unordered_set<string> mnemonics;
+
 /*!
  * \brief Prints the instruction to the given output stream.
  * \param stream The output stream to which the instruction is printed.
@@ -59,47 +64,23 @@ ostream &operator<<(ostream &stream, const BaseInstructionSSA &instr) {
 
 BaseInstructionSSA::BaseInstructionSSA(const std::string &mnemonic,
                                        uint64_t address)
-    : _mnemonic(mnemonic) {
+    : _mnemonic(intern_mnemonic(mnemonic)) {
     _address = address;
 }
 
+// Operands are immutable, hence the copy shares them.
 BaseInstructionSSA::BaseInstructionSSA(const BaseInstructionSSA &obj)
-    : _mnemonic(obj.get_mnemonic()) {
+    : _mnemonic(obj._mnemonic),
+      _operands(obj._operands),
+      _def_uses(obj._def_uses),
+      _num_definitions(obj._num_definitions) {
     _address = obj.get_address();
     _type = obj.get_type();
+}
 
-    // Copy operands.
-    for(const OperandSSAPtr &op : obj.get_operands()) {
-        switch(op->get_type()) {
-            case SSAOpTypeRegisterX64:
-                _operands.push_back(make_shared<const RegisterX64SSA>(
-                                      static_cast<const RegisterX64SSA&>(*op)));
-                break;
-
-            case SSAOpTypeConstantX64:
-                _operands.push_back(make_shared<const ConstantX64SSA>(
-                                      static_cast<const ConstantX64SSA&>(*op)));
-                break;
-
-            case SSAOpTypeAddressX64:
-                _operands.push_back(make_shared<const AddressX64SSA>(
-                                       static_cast<const AddressX64SSA&>(*op)));
-                break;
-
-            case SSAOpTypeMemoryX64:
-                _operands.push_back(make_shared<const MemoryX64SSA>(
-                                        static_cast<const MemoryX64SSA&>(*op)));
-                break;
-
-            default:
-                throw runtime_error("Unknown operand type.");
-        }
-    }
-
-    // Build definitions and uses.
-    for(const OperandSSAPtr &op : _operands) {
-        add_use_definition(op);
-    }
+const string *BaseInstructionSSA::intern_mnemonic(const string &mnemonic) {
+    lock_guard<mutex> _(mnemonics_mtx);
+    return &*mnemonics.insert(mnemonic).first;
 }
 
 bool BaseInstructionSSA::operator!=(const BaseInstructionSSA &other) const {
@@ -110,7 +91,7 @@ bool BaseInstructionSSA::operator ==(const BaseInstructionSSA &other) const {
     if(_type != other.get_type()) {
         return false;
     }
-    if(_mnemonic == other.get_mnemonic()
+    if(_mnemonic == other._mnemonic
        && _address == other.get_address()
        && _operands.size() == other.get_operands().size()) {
 
@@ -128,7 +109,7 @@ bool BaseInstructionSSA::operator ==(const BaseInstructionSSA &other) const {
 
 size_t BaseInstructionSSA::hash() const {
     size_t h = _type;
-    std::hash_combine(h, std::hash<std::string>()(_mnemonic));
+    std::hash_combine(h, std::hash<std::string>()(*_mnemonic));
     std::hash_combine(h, _address);
     for(const OperandSSAPtr &op : _operands) {
         std::hash_combine(h, op->hash());
@@ -141,7 +122,7 @@ uint64_t BaseInstructionSSA::get_address() const {
 }
 
 const std::string &BaseInstructionSSA::get_mnemonic() const {
-    return _mnemonic;
+    return *_mnemonic;
 }
 
 InstructionTypeSSA BaseInstructionSSA::get_type() const {
@@ -156,23 +137,23 @@ const OperandSSAPtr &BaseInstructionSSA::get_operand(uint32_t idx) const {
     return _operands.at(idx);
 }
 
-const OperandSSAPtrs &BaseInstructionSSA::get_definitions() const {
-    return _definitions;
+OperandSSASpan BaseInstructionSSA::get_definitions() const {
+    return OperandSSASpan(_def_uses.data(),
+                          _def_uses.data() + _num_definitions);
 }
 
-const OperandSSAPtrs &BaseInstructionSSA::get_uses() const {
-    return _uses;
+OperandSSASpan BaseInstructionSSA::get_uses() const {
+    return OperandSSASpan(_def_uses.data() + _num_definitions,
+                          _def_uses.data() + _def_uses.size());
 }
 
-void BaseInstructionSSA::add_operand(const ssa::Operand &operand) {
+void BaseInstructionSSA::add_operand(const ssa::Operand &operand,
+                                     OperandSSATable *operand_table) {
+    OperandSSAPtr op;
     if(operand.has_register_()) {
         const ssa::Register &reg = operand.register_();
         if(reg.has_register_x64()) {
-            const OperandSSAPtr &op = make_shared<RegisterX64SSA>(
-                                                            reg.register_x64());
-            _operands.push_back(op);
-            add_use_definition(op);
-
+            op = make_shared<RegisterX64SSA>(reg.register_x64());
         }
         else {
             throw runtime_error("Imported SSA register has unknown type.");
@@ -181,16 +162,10 @@ void BaseInstructionSSA::add_operand(const ssa::Operand &operand) {
     else if(operand.has_constant()) {
         const ssa::Constant &constant = operand.constant();
         if(constant.has_constant_x64()) {
-            const OperandSSAPtr &op = make_shared<ConstantX64SSA>(
-                                                       constant.constant_x64());
-            _operands.push_back(op);
-            add_use_definition(op);
+            op = make_shared<ConstantX64SSA>(constant.constant_x64());
         }
         else if(constant.has_address_x64()) {
-            const OperandSSAPtr &op = make_shared<AddressX64SSA>(
-                                                        constant.address_x64());
-            _operands.push_back(op);
-            add_use_definition(op);
+            op = make_shared<AddressX64SSA>(constant.address_x64());
         }
         else {
             throw runtime_error("Imported SSA constant has unknown type.");
@@ -199,10 +174,7 @@ void BaseInstructionSSA::add_operand(const ssa::Operand &operand) {
     else if(operand.has_memory()) {
         const ssa::Memory &memory = operand.memory();
         if(memory.has_memory_x64()) {
-            const OperandSSAPtr &op = make_shared<MemoryX64SSA>(
-                                                           memory.memory_x64());
-            _operands.push_back(op);
-            add_use_definition(op);
+            op = make_shared<MemoryX64SSA>(memory.memory_x64());
         }
         else {
             throw runtime_error("Imported SSA memory has unknown type.");
@@ -211,14 +183,21 @@ void BaseInstructionSSA::add_operand(const ssa::Operand &operand) {
     else {
         throw runtime_error("Imported SSA operand has unknown type.");
     }
+
+    if(operand_table != nullptr) {
+        op = operand_table->intern(op);
+    }
+    _operands.push_back(op);
+    add_use_definition(op);
 }
 
 void BaseInstructionSSA::add_use_definition(const OperandSSAPtr &op) {
-    if(op->is_read()) {
-        _uses.push_back(op);
-    }
     if(op->is_written()) {
-        _definitions.push_back(op);
+        _def_uses.insert(_def_uses.begin() + _num_definitions, op);
+        _num_definitions++;
+    }
+    if(op->is_read()) {
+        _def_uses.push_back(op);
     }
 }
 
@@ -246,7 +225,8 @@ bool BaseInstructionSSA::is_ret() const {
     return false;
 }
 
-InstructionSSA::InstructionSSA(const ssa::BaseInstruction &instruction)
+InstructionSSA::InstructionSSA(const ssa::BaseInstruction &instruction,
+                               OperandSSATable *operand_table)
     : BaseInstructionSSA(instruction.mnemonic(), instruction.address()) {
     _type = SSAInstrTypeInstruction;
 
@@ -261,10 +241,7 @@ InstructionSSA::InstructionSSA(const ssa::BaseInstruction &instruction)
         _is_ret = true;
     }
 
-    for(int i = 0; i < instruction.operands_size(); i++) {
-        const ssa::Operand &operand = instruction.operands(i);
-        add_operand(operand);
-    }
+    add_all_operands(instruction, operand_table);
 }
 
 InstructionSSA::InstructionSSA(const InstructionSSA &obj)
@@ -298,14 +275,12 @@ bool InstructionSSA::is_ret() const {
     return _is_ret;
 }
 
-PhiNodeSSA::PhiNodeSSA(const ssa::PhiNode &phi_node)
+PhiNodeSSA::PhiNodeSSA(const ssa::PhiNode &phi_node,
+                       OperandSSATable *operand_table)
     : BaseInstructionSSA(phi_node.mnemonic(), phi_node.address()) {
     _type = SSAInstrTypePhiNode;
 
-    for(int i = 0; i < phi_node.operands_size(); i++) {
-        const ssa::Operand &operand = phi_node.operands(i);
-        add_operand(operand);
-    }
+    add_all_operands(phi_node, operand_table);
 }
 
 PhiNodeSSA::PhiNodeSSA(const PhiNodeSSA &obj)
@@ -317,16 +292,14 @@ bool PhiNodeSSA::is_phinode() const {
 }
 
 CallingConventionSSA::CallingConventionSSA(
-                               const ssa::CallingConvention &calling_convention)
+                               const ssa::CallingConvention &calling_convention,
+                               OperandSSATable *operand_table)
     : BaseInstructionSSA(calling_convention.mnemonic(),
                          calling_convention.address()) {
 
     _type = SSAInstrTypeCallingConvention;
 
-    for(int i = 0; i < calling_convention.operands_size(); i++) {
-        const ssa::Operand &operand = calling_convention.operands(i);
-        add_operand(operand);
-    }
+    add_all_operands(calling_convention, operand_table);
 }
 
 CallingConventionSSA::CallingConventionSSA(const CallingConventionSSA &obj)
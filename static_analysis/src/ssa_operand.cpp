@@ -1,4 +1,5 @@
 #include "ssa_operand.h"
+#include "instrumentation.h"
 
 using namespace std;
 
@@ -64,6 +65,39 @@ bool OperandSSA::operator!=(const OperandSSA &other) const {
     return !(*this == other);
 }
 
+const OperandSSAPtr &OperandSSATable::intern(const OperandSSAPtr &op) {
+    const auto result = _operands.insert(op);
+    if(result.second) {
+        op->_table_id = _ids.size();
+        _ids.push_back(op.get());
+    }
+    return *result.first;
+}
+
+size_t OperandSSATable::get_memory_footprint() const {
+
+    // Shared objects are allocated together with their control block.
+    size_t bytes = footprint_hash(_operands) + footprint_vector(_ids);
+    for(const OperandSSAPtr &op : _operands) {
+        switch(op->get_type()) {
+            case SSAOpTypeRegisterX64:
+                bytes += sizeof(RegisterX64SSA);
+                break;
+            case SSAOpTypeConstantX64:
+                bytes += sizeof(ConstantX64SSA);
+                break;
+            case SSAOpTypeAddressX64:
+                bytes += sizeof(AddressX64SSA);
+                break;
+            default:
+                bytes += sizeof(MemoryX64SSA);
+                break;
+        }
+        bytes += INSTR_HASH_NODE_OVERHEAD;
+    }
+    return bytes;
+}
+
 bool OperandSSA::is_written() const {
     return (_access_type == SSAAccessTypeWirte
             || _access_type == SSAAccessTypeReadWrite);
@@ -1,6 +1,10 @@
 
 #include "state.h"
+#include "flat_expression.h"
+#include "instrumentation.h"
+#include "tracepoints.h"
 
+#include <algorithm>
 #include <memory>
 #include <sstream>
 
@@ -10,13 +14,15 @@ map<unsigned int, shared_ptr<Symbolic>> State::_initial_values = [] {
     map<unsigned int, shared_ptr<Symbolic>> result;
 
     for(const auto &r : AMD64_REGISTERS) {
-        const auto &initial = make_shared<Symbolic>(format_initial_value(r));
+        const auto &initial = make_symbolic(SymbolicInitialValue, r);
         result[r] = initial;
     }
 
     return result;
 }();
 
+StateBackend State::_backend = StateBackendTree;
+
 /*!
  * \brief Constructs a new `State` and initializes it (unless specified
  * otherwise).
@@ -28,52 +34,74 @@ map<unsigned int, shared_ptr<Symbolic>> State::_initial_values = [] {
  * base class first.
  */
 State::State(bool initialize)
-    : _unknown(make_shared<Unknown>()) {
+    : _state(make_shared<InternalState>()),
+      _unknown(make_shared<Unknown>()) {
     if(initialize) {
         set_initial_state();
     }
 }
 
 /*!
- * \brief Prints the state to the given output stream.
- * \param stream The output stream to which the state is printed.
- * \param state The `State` itself.
- * \return The (modified) output stream `stream`.
+ * \brief Returns a copy of the state that does not share any expressions with
+ * this state.
+ *
+ * Copying a state shares the expressions, which are updated in-place (e.g.,
+ * by `State::optimize`). A clone can be kept as a snapshot while the state
+ * itself is used for further computations. Expressions bound multiple times
+ * in this state are also shared by the clone. Leaf expressions are never
+ * modified, hence they are not cloned.
  */
-ostream &operator<<(ostream &stream, const State &state) {
-    for(const auto &kv : state._state) {
-        stream << *kv.first << " -> " << *kv.second << "\n";
-    }
+State State::clone() const {
+    State result(false);
+
+    unordered_map<const Expression*, ExpressionPtr> clones;
+    auto clone_expression = [&](const ExpressionPtr &expression)
+                                                          -> ExpressionPtr {
+        if(expression->type() != ExpressionOperation
+           && expression->type() != ExpressionIndirection) {
+            return expression;
+        }
+        auto &cloned = clones[expression.get()];
+        if(!cloned) {
+            cloned = expression->clone();
+        }
+        return cloned;
+    };
 
-    return stream;
+    InternalState &bindings = *result._state;
+    for(const auto &kv : *_state) {
+        bindings[clone_expression(kv.first)] = clone_expression(kv.second);
+    }
+    return result;
 }
 
-const string State::format_initial_value(size_t offset) {
-    // TODO: Precompute this.
-    const auto &needle = AMD64_DISPLAY_REGISTERS.find(offset);
-    if(needle != AMD64_DISPLAY_REGISTERS.cend()) {
-        return "init_" + needle->second;
+/*!
+ * \brief Returns the bindings of this state for modification.
+ *
+ * Copies of a state share their bindings until either of them is modified.
+ * The bindings are copied (once) here if they are still shared, i.e., forking
+ * a state is cheap and only states that diverge pay for a copy.
+ */
+InternalState &State::mutable_bindings() {
+    if(_state.use_count() > 1) {
+        Instrumentation::get_instance().count(InstrCounterStateCopies);
+        _state = make_shared<InternalState>(*_state);
     }
-
-    stringstream stream;
-    string symbolic_value;
-
-    stream << "init_r" << dec << offset;
-    stream >> symbolic_value;
-    return symbolic_value;
+    return *_state;
 }
 
 /*!
- * \brief Formats a return value of a call at the given address.
- * \param address The address of the call whose return value shall be formatted.
- * \return A unique string to be used for a symbol describing the return value
- * of the call.
+ * \brief Prints the state to the given output stream.
+ * \param stream The output stream to which the state is printed.
+ * \param state The `State` itself.
+ * \return The (modified) output stream `stream`.
  */
-const string State::format_return_value(uintptr_t address) {
-    stringstream stream;
-    stream << "return_" << hex << address;
+ostream &operator<<(ostream &stream, const State &state) {
+    for(const auto &kv : *state._state) {
+        stream << *kv.first << " -> " << *kv.second << "\n";
+    }
 
-    return stream.str();
+    return stream;
 }
 
 /*!
@@ -81,39 +109,29 @@ const string State::format_return_value(uintptr_t address) {
  *
  * Each register gets assigned a symbol depicting its initial value.
  *
- * \see `State::format_initial_value`
+ * \see `SymbolicInitialValue`
  */
 void State::set_initial_state() {
+    InternalState &bindings = mutable_bindings();
     for(const auto &r : AMD64_REGISTERS) {
         // Copy necessary here?
-        const auto &dst = make_shared<Register>(r);
-        const auto &src = make_shared<Symbolic>(format_initial_value(r));
+        const auto &dst = make_register(r);
+        const auto &src = make_symbolic(SymbolicInitialValue, r);
 
-        _state[dst] = src;
+        bindings[dst] = src;
     }
 }
 
 /*!
- * \brief Removes all System V scratch registers from the state.
+ * \brief Removes all scratch registers of the given calling convention
+ * from the state.
  *
- * \todo Support different calling conventions.
- * \see `system_v_scratch`
+ * \see `Abi`
  */
-void State::purge_scratch_registers(FileFormatType file_format) {
-    switch(file_format) {
-        case FileFormatELF64:
-            for(const auto &scratch : system_v_scratch) {
-                _state.erase(scratch);
-            }
-            break;
-        case FileFormatPE64:
-            for(const auto &scratch : msvc_scratch) {
-                _state.erase(scratch);
-            }
-            break;
-        default:
-            throw runtime_error("Do not know how to "\
-                                "handle file format.");
+void State::purge_scratch_registers(const Abi &abi) {
+    InternalState &bindings = mutable_bindings();
+    for(size_t i = 0; i < abi.num_scratch; i++) {
+        bindings.erase(abi.scratch[i]);
     }
 }
 
@@ -125,8 +143,9 @@ void State::purge_scratch_registers(FileFormatType file_format) {
  * \param other The state that is merged into this.
  */
 void State::merge(const State &other) {
-    for(const auto &kv : other._state) {
-        _state[kv.first] = kv.second;
+    InternalState &bindings = mutable_bindings();
+    for(const auto &kv : *other._state) {
+        bindings[kv.first] = kv.second;
     }
 }
 
@@ -141,7 +160,7 @@ void State::merge(const State &other) {
  */
 const Expressions State::get_memory_accesses() const {
     Expressions result;
-    for(const auto &kv : _state) {
+    for(const auto &kv : *_state) {
         if(kv.first->type() == ExpressionIndirection) {
             result.push_back(kv);
         }
@@ -160,11 +179,12 @@ const Expressions State::get_memory_accesses() const {
  * existence and throw `runtime_error` on mismatch.
  */
 void State::optimize(bool do_purge_unchanged) {
-    // Transitively kill expressions affected by a self-reference.
-    for(const auto &kv: _state) {
-        if(kv.second->contains(*kv.first)) {
-            kill(kv.first, kv.second);
-        }
+    DependencyIndex index;
+    if(_backend == StateBackendFlat) {
+        kill_self_references_flat(index);
+    }
+    else {
+        kill_self_references(index);
     }
 
     /* Purging unchanged registers will fail when propagating states (e.g.,
@@ -176,6 +196,72 @@ void State::optimize(bool do_purge_unchanged) {
     }
 }
 
+/*!
+ * \brief Transitively kills expressions affected by a self-reference.
+ *
+ * Killing only replaces values by `Unknown`, hence the index stays valid for
+ * all kills.
+ */
+void State::kill_self_references(DependencyIndex &index) {
+    InternalState &bindings = mutable_bindings();
+    bool has_index = false;
+    for(const auto &kv: bindings) {
+        if(kv.second->contains(*kv.first)) {
+            if(!has_index) {
+                build_dependency_index(index);
+                has_index = true;
+            }
+            kill(kv.first, kv.second, index);
+        }
+    }
+}
+
+/*!
+ * \brief Same as `kill_self_references`, but the values are flattened once
+ * and checked by scanning their hashes. The index is built from the same
+ * hashes.
+ */
+void State::kill_self_references_flat(DependencyIndex &index) {
+    InternalState &bindings = mutable_bindings();
+
+    vector<FlatExpression> flats;
+    vector<InternalState::iterator> iterators;
+    flats.reserve(bindings.size());
+    iterators.reserve(bindings.size());
+    for(auto i = bindings.begin(); i != bindings.end(); ++i) {
+        flats.emplace_back(*i->second);
+        iterators.push_back(i);
+    }
+
+    bool has_index = false;
+    for(size_t k = 0; k < iterators.size(); k++) {
+        const auto &kv = *iterators[k];
+
+        // Killed values are not covered by their encoding anymore.
+        bool is_self_reference;
+        if(flats[k].get_nodes().back().expression == kv.second.get()) {
+            is_self_reference = flats[k].contains(*kv.first,
+                                                  canonical_hash(*kv.first));
+        }
+        else {
+            is_self_reference = kv.second->contains(*kv.first);
+        }
+        if(!is_self_reference) {
+            continue;
+        }
+
+        if(!has_index) {
+            for(size_t j = 0; j < iterators.size(); j++) {
+                for(size_t h : flats[j].get_hashes()) {
+                    index[h].push_back(iterators[j]);
+                }
+            }
+            has_index = true;
+        }
+        kill(kv.first, kv.second, index);
+    }
+}
+
 bool State::optimizer(bool do_purge_unchanged) {
     bool dirty = false;
     if(do_purge_unchanged) {
@@ -190,25 +276,73 @@ bool State::optimizer(bool do_purge_unchanged) {
     return dirty;
 }
 
+static size_t add_dependencies(DependencyIndex &index,
+                               const Expression &expression,
+                               const InternalState::iterator &binding);
+
 bool State::propagate() {
+    InternalState &bindings = mutable_bindings();
     bool dirty = false;
 
     // Propagate any values which are also keys in the same state.
-    for(const auto &kv : _state) {
+    for(const auto &kv : bindings) {
         const auto &value = kv.second;
 
-        const auto &needle = _state.find(value);
-        if(needle != _state.cend()) {
-            _state[kv.first] = needle->second;
+        const auto &needle = bindings.find(value);
+        if(needle != bindings.cend()) {
+            bindings[kv.first] = needle->second;
             dirty = true;
         }
     }
 
-    // Propagate sub-expressions.
-    for(const auto &kv : _state) {
-        for(const auto &p : _state) {
-            dirty |= p.first->propagate(kv.first, kv.second);
-            dirty |= p.second->propagate(kv.first, kv.second);
+    // Propagate sub-expressions. Only the bindings whose key or value
+    // contains the propagated key are visited (found by the same index as
+    // used for kills), in the order of the bindings. Since sub-expressions
+    // may be shared between bindings, all visited bindings are indexed again
+    // once one of them changed, hence later keys find the sub-expressions
+    // they received.
+    DependencyIndex index;
+    unordered_map<const InternalState::value_type*, size_t> positions;
+    for(auto i = bindings.begin(); i != bindings.end(); ++i) {
+        add_dependencies(index, *i->first, i);
+        add_dependencies(index, *i->second, i);
+        positions.emplace(&*i, positions.size());
+    }
+
+    const auto by_position = [&positions](const InternalState::iterator &a,
+                                          const InternalState::iterator &b) {
+        return positions[&*a] < positions[&*b];
+    };
+    const auto is_same = [](const InternalState::iterator &a,
+                            const InternalState::iterator &b) {
+        return &*a == &*b;
+    };
+
+    vector<InternalState::iterator> candidates;
+    for(auto kv = bindings.begin(); kv != bindings.end(); ++kv) {
+        const auto needle = index.find(canonical_hash(*kv->first));
+        if(needle == index.cend()) {
+            continue;
+        }
+
+        // Copied since the index grows while propagating.
+        candidates = needle->second;
+        sort(candidates.begin(), candidates.end(), by_position);
+        candidates.erase(unique(candidates.begin(), candidates.end(), is_same),
+                         candidates.end());
+
+        bool changed = false;
+        for(const InternalState::iterator &p : candidates) {
+            changed |= p->first->propagate(kv->first, kv->second);
+            changed |= p->second->propagate(kv->first, kv->second);
+        }
+
+        if(changed) {
+            for(const InternalState::iterator &p : candidates) {
+                add_dependencies(index, *p->first, p);
+                add_dependencies(index, *p->second, p);
+            }
+            dirty = true;
         }
     }
 
@@ -216,7 +350,8 @@ bool State::propagate() {
 }
 
 void State::optimize_entries() {
-    for(auto i = _state.begin(); i != _state.end(); ++i) {
+    InternalState &bindings = mutable_bindings();
+    for(auto i = bindings.begin(); i != bindings.end(); ++i) {
         i->first->optimize();
         i->second->optimize();
     }
@@ -226,14 +361,15 @@ void State::optimize_entries() {
  * mess up logic trying to get a value regardless. Need to think about this.
  */
 bool State::purge_uninteresting() {
+    InternalState &bindings = mutable_bindings();
     bool dirty = false;
 
-    for(auto i = _state.begin(); i != _state.end();) {
+    for(auto i = bindings.begin(); i != bindings.end();) {
         Expression &key = *i->first;
         Expression &value = *i->second;
 
         if(key.type() == ExpressionTemporary) {
-            i = _state.erase(i);
+            i = bindings.erase(i);
             dirty = true;
             continue;
         }
@@ -241,7 +377,7 @@ bool State::purge_uninteresting() {
         // We want to keep Unknown:s for register values only.
         if(value.type() == ExpressionUnknown &&
            key.type() != ExpressionRegister) {
-            i = _state.erase(i);
+            i = bindings.erase(i);
             dirty = true;
             continue;
         }
@@ -250,7 +386,7 @@ bool State::purge_uninteresting() {
             auto reg = static_cast<const Register&>(key);
             if(reg.offset() > OFFB_R15 && reg.offset() != OFFB_RIP) {
 
-                i = _state.erase(i);
+                i = bindings.erase(i);
                 dirty = true;
                 continue;
             }
@@ -263,9 +399,10 @@ bool State::purge_uninteresting() {
 }
 
 bool State::purge_unchanged() {
+    InternalState &bindings = mutable_bindings();
     bool dirty = false;
 
-    for(auto i = _state.begin(); i != _state.end();) {
+    for(auto i = bindings.begin(); i != bindings.end();) {
         Expression &key = *i->first;
         Expression &value = *i->second;
 
@@ -275,7 +412,7 @@ bool State::purge_unchanged() {
 
             if(initial != _initial_values.cend()) {
                 if(*initial->second == value) {
-                    i = _state.erase(i);
+                    i = bindings.erase(i);
                     dirty = true;
                     continue;
                 }
@@ -289,17 +426,22 @@ bool State::purge_unchanged() {
 }
 
 InternalState::iterator State::erase(const InternalState::iterator &iterator) {
-    return _state.erase(iterator);
+    return mutable_bindings().erase(iterator);
 }
 
 size_t State::erase(const InternalState::key_type &key) {
-    return _state.erase(key);
+    // Do not unshare the bindings if there is nothing to erase.
+    if(_state->find(key) == _state->cend()) {
+        return 0;
+    }
+    return mutable_bindings().erase(key);
 }
 
 bool State::find(const InternalState::key_type &key,
                  arg_out InternalState::iterator &iterator) {
-    InternalState::iterator needle = _state.find(key);
-    if(needle == _state.end()) {
+    InternalState &bindings = mutable_bindings();
+    InternalState::iterator needle = bindings.find(key);
+    if(needle == bindings.end()) {
         return false;
     }
 
@@ -309,8 +451,8 @@ bool State::find(const InternalState::key_type &key,
 
 bool State::find(const InternalState::key_type &key,
                  arg_out InternalState::const_iterator &iterator) const {
-    InternalState::const_iterator needle = _state.find(key);
-    if(needle == _state.cend()) {
+    InternalState::const_iterator needle = _state->find(key);
+    if(needle == _state->cend()) {
         return false;
     }
 
@@ -318,31 +460,85 @@ bool State::find(const InternalState::key_type &key,
     return true;
 }
 
-kill_results State::kill_helper(const ExpressionPtr &key,
-                                const ExpressionPtr &value) {
+/*!
+ * \brief Adds all sub-expressions of `expression` to the index (pointing to
+ * the given binding).
+ *
+ * \return The canonical hash of `expression`.
+ */
+static size_t add_dependencies(DependencyIndex &index,
+                               const Expression &expression,
+                               const InternalState::iterator &binding) {
+    size_t child_hashes[2] = {0, 0};
+    if(expression.type() == ExpressionIndirection) {
+        const auto &indirection = static_cast<const Indirection&>(expression);
+        child_hashes[0] = add_dependencies(index,
+                                           *indirection.address(),
+                                           binding);
+    }
+    else if(expression.type() == ExpressionOperation) {
+        const auto &operation = static_cast<const Operation&>(expression);
+        child_hashes[0] = add_dependencies(index, *operation.lhs(), binding);
+        child_hashes[1] = add_dependencies(index, *operation.rhs(), binding);
+    }
+
+    size_t h = canonical_hash(expression, child_hashes);
+    index[h].push_back(binding);
+    return h;
+}
+
+void State::build_dependency_index(DependencyIndex &index) {
+    InternalState &bindings = mutable_bindings();
+    for(auto i = bindings.begin(); i != bindings.end(); ++i) {
+        add_dependencies(index, *i->second, i);
+    }
+}
+
+/*!
+ * \brief Sets all bindings whose value contains `expression` to `Unknown`.
+ *
+ * Only the bindings the index lists for the expression are checked.
+ *
+ * \return The keys of all bindings that were killed.
+ */
+kill_results State::kill_helper(const ExpressionPtr &expression,
+                                DependencyIndex &index) {
     kill_results affected;
 
-    for(auto i = _state.begin(), e = _state.end(); i != e; ++i) {
-        if(i->second->contains(*key) || i->second->contains(*value)) {
-            if(i->second->type() != ExpressionUnknown) {
-                affected.insert(i->first);
-                i->second = _unknown;
-            }
+    const auto needle = index.find(canonical_hash(*expression));
+    if(needle == index.cend()) {
+        return affected;
+    }
+
+    for(const InternalState::iterator &i : needle->second) {
+        if(i->second->type() != ExpressionUnknown
+           && i->second->contains(*expression)) {
+            affected.insert(i->first);
+            i->second = _unknown;
         }
     }
 
     return affected;
 }
 
-void State::kill(const ExpressionPtr &key, const ExpressionPtr &value) {
-    _state[key] = _unknown;
+void State::kill(const ExpressionPtr &key, const ExpressionPtr &value,
+                 DependencyIndex &index) {
+    Instrumentation::get_instance().count(InstrCounterStateKills);
+    mutable_bindings()[key] = _unknown;
+
+    // Bindings depending on the value are all killed in the first round,
+    // afterwards only the dependents of killed keys have to be checked.
+    kill_results affected = kill_helper(key, index);
+    for(const auto &k : kill_helper(value, index)) {
+        affected.insert(k);
+    }
+    MARX_TRACE1(state__kill, affected.size());
 
-    kill_results affected = { key };
     while(!affected.empty()) {
         kill_results work_list;
 
         for(const auto &a : affected) {
-            const auto &killed = kill_helper(a, value);
+            const auto &killed = kill_helper(a, index);
 
             for(const auto &k : killed) {
                 work_list.insert(k);
@@ -355,5 +551,5 @@ void State::kill(const ExpressionPtr &key, const ExpressionPtr &value) {
 
 void State::update(const InternalState::key_type &key,
                    const InternalState::mapped_type &value) {
-    _state[key] = value;
+    mutable_bindings()[key] = value;
 }
@@ -0,0 +1,216 @@
+#include "summary_store.h"
+#include "companion_file.h"
+
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+using namespace std;
+
+// Values in this range are considered addresses (everything else is a
+// plain constant that is hashed as is).
+#define SUMMARY_STORE_MIN_ADDR 0x10000
+#define SUMMARY_STORE_MAX_ADDR 0x800000000000
+
+
+/*!
+ * \brief Writes the given value normalized to the given stream.
+ * \see `SummaryStore`
+ */
+static void write_normalized_value(ostream &stream,
+                                   uint64_t func_begin,
+                                   uint64_t func_end,
+                                   const vector<const VTable*> &vtables,
+                                   uint32_t addr_size,
+                                   uint64_t value) {
+
+    if(value < SUMMARY_STORE_MIN_ADDR || value >= SUMMARY_STORE_MAX_ADDR) {
+        stream << hex << value;
+        return;
+    }
+    if(value >= func_begin && value <= func_end) {
+        stream << "F" << hex << value - func_begin;
+        return;
+    }
+
+    // The offset-to-top and RTTI entries precede the address point.
+    for(uint32_t pos = 0; pos < vtables.size(); pos++) {
+        const VTable &vtable = *vtables[pos];
+        const uint64_t begin = vtable.addr - 2 * addr_size;
+        const uint64_t end = vtable.addr + vtable.entries.size() * addr_size;
+        if(value >= begin && value <= end) {
+            stream << "V" << dec << pos << "+" << hex << value - begin;
+            return;
+        }
+    }
+
+    // Any other address (relocated).
+    stream << "R";
+}
+
+
+SummaryStore::SummaryStore(const string &store_dir, uint32_t addr_size)
+    : _store_dir(store_dir),
+      _addr_size(addr_size) {
+}
+
+string SummaryStore::get_summary_file(uint64_t key) const {
+    stringstream file_name;
+    file_name << _store_dir
+              << "/"
+              << hex << setw(16) << setfill('0') << key
+              << SUMMARY_STORE_EXTENSION;
+    return file_name.str();
+}
+
+uint64_t SummaryStore::compute_key(
+                       SummaryKind kind,
+                       const Function &func,
+                       const vector<const VTable*> &vtables,
+                       const vector<pair<uint64_t, vector<uint32_t>>> &xrefs)
+                                                                        const {
+
+    const BlockSSAMap &blocks = func.get_blocks_ssa();
+    const uint64_t func_begin = func.get_entry();
+    uint64_t func_end = func_begin;
+    for(const auto &kv_block : blocks) {
+        for(const auto &instr : kv_block.second->get_instructions()) {
+            func_end = max(func_end, instr->get_address());
+        }
+    }
+
+    stringstream function_str;
+    function_str << dec << SUMMARY_STORE_VERSION
+                 << " " << dec << kind
+                 << " " << dec << _addr_size
+                 << "\n";
+    for(const auto &kv_block : blocks) {
+        function_str << "B" << hex << kv_block.first - func_begin << "\n";
+        for(const auto &instr : kv_block.second->get_instructions()) {
+            function_str << dec << instr->get_type()
+                         << " F" << hex << instr->get_address() - func_begin
+                         << " " << instr->get_mnemonic();
+
+            for(const OperandSSAPtr &op : instr->get_operands()) {
+                function_str << " ";
+                switch(op->get_type()) {
+                    case SSAOpTypeRegisterX64:
+                        function_str << *op;
+                        break;
+                    case SSAOpTypeConstantX64:
+                        write_normalized_value(
+                           function_str,
+                           func_begin,
+                           func_end,
+                           vtables,
+                           _addr_size,
+                           static_cast<const ConstantX64SSA&>(*op).get_value());
+                        break;
+                    case SSAOpTypeAddressX64:
+                        write_normalized_value(
+                           function_str,
+                           func_begin,
+                           func_end,
+                           vtables,
+                           _addr_size,
+                           static_cast<const AddressX64SSA&>(*op).get_value());
+                        break;
+                    case SSAOpTypeMemoryX64: {
+                        const MemoryX64SSA &mem =
+                                        static_cast<const MemoryX64SSA&>(*op);
+                        function_str << "[" << mem.get_base() << "+";
+                        write_normalized_value(
+                                         function_str,
+                                         func_begin,
+                                         func_end,
+                                         vtables,
+                                         _addr_size,
+                                         mem.get_offset().get_value());
+                        if(mem.has_index()) {
+                            function_str << "+" << mem.get_index();
+                        }
+                        if(mem.has_index_factor()) {
+                            function_str << "*"
+                                         << dec
+                                         << mem.get_index_factor().get_value();
+                        }
+                        function_str << "]";
+                        break;
+                    }
+                    default:
+                        throw runtime_error("Unknown SSA operand.");
+                }
+            }
+            function_str << "\n";
+        }
+    }
+
+    for(const auto &xref : xrefs) {
+        function_str << "X" << hex << xref.first - func_begin;
+        for(uint32_t vtable_pos : xref.second) {
+            function_str << " " << dec << vtable_pos;
+        }
+        function_str << "\n";
+    }
+
+    const string data = function_str.str();
+    uint64_t hash = 0xcbf29ce484222325;
+    for(char c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash ? hash : 1;
+}
+
+bool SummaryStore::get_object_allocations(
+                                     uint64_t key,
+                                     SummaryObjectAllocations &obj_allocs) {
+    obj_allocs.clear();
+
+    const string summary_file = get_summary_file(key);
+    if(!MappedFile::exists(summary_file)) {
+        _num_misses++;
+        return false;
+    }
+
+    CompanionFileReader reader(summary_file);
+    uint64_t kind;
+    uint64_t count;
+    if(!reader.is_valid(CompanionFileSummary, key)
+       || !reader.read(kind)
+       || kind != SummaryKindObjectAllocations
+       || !reader.read(count)) {
+        _num_misses++;
+        return false;
+    }
+    for(uint64_t i = 0; i < count; i++) {
+        SummaryObjectAllocation obj_alloc;
+        if(!reader.read(obj_alloc.init_offset)
+           || !reader.read(obj_alloc.xref_offset)
+           || !reader.read(obj_alloc.vtable_pos)) {
+            obj_allocs.clear();
+            _num_misses++;
+            return false;
+        }
+        obj_allocs.push_back(obj_alloc);
+    }
+    _num_hits++;
+    return true;
+}
+
+bool SummaryStore::add_object_allocations(
+                               uint64_t key,
+                               const SummaryObjectAllocations &obj_allocs) {
+
+    CompanionFileWriter writer(get_summary_file(key),
+                               CompanionFileSummary,
+                               key);
+    writer.write(SummaryKindObjectAllocations);
+    writer.write(obj_allocs.size());
+    for(const SummaryObjectAllocation &obj_alloc : obj_allocs) {
+        writer.write(obj_alloc.init_offset);
+        writer.write(obj_alloc.xref_offset);
+        writer.write(obj_alloc.vtable_pos);
+    }
+    return writer.finish();
+}
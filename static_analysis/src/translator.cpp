@@ -1,5 +1,6 @@
 
 #include "translator.h"
+#include "instrumentation.h"
 
 #include <sstream>
 #include <algorithm>
@@ -16,11 +17,14 @@ using namespace std;
  *
  * \param vex The global `Vex` instance.
  * \param file The (full path to the) file that should be operated on.
- * \param parse_on_demand `true`, if functions shall be translated once they
- * are queried; `false` to parse all known functions at once.
+ * \param parse_on_demand `true`, if the VEX blocks of a function shall be
+ * lifted once they are accessed first; `false` to parse all known functions
+ * at once.
+ * \param num_threads The number of threads used to translate all known
+ * functions at once.
  */
 Translator::Translator(Vex &vex, const string &file,
-    FileFormatType file_format, bool parse_on_demand)
+    FileFormatType file_format, bool parse_on_demand, uint32_t num_threads)
     : _vex(vex), _dump_file(file + ".dmp") {
 
     _file_format = file_format;
@@ -37,11 +41,11 @@ Translator::Translator(Vex &vex, const string &file,
     }
 
     if(!parse_on_demand) {
-        parse_known_functions();
+        parse_known_functions(num_threads);
+    }
+    else {
+        prepare_known_functions();
     }
-
-    // Set translator object as mutable in the beginning.
-    _is_finalized = false;
 }
 
 void Translator::finalize_block(Function &function,
@@ -67,35 +71,45 @@ void Translator::finalize_block(Function &function,
     }
 
     function.add_block(block.block_start, block_pointer, terminator);
-    _blocks[block.block_start] = block_pointer;
 }
 
 bool Translator::process_block(Function &function,
-                               const BlockDescriptor &block) {
+                               const BlockDescriptor &block,
+                               set<uintptr_t> &seen_blocks) {
 
     if(block.block_start == block.block_end) {
         return true;
     }
 
     bool result = true;
-    if(_seen_blocks.find(block.block_start) != _seen_blocks.cend()) {
+    if(seen_blocks.find(block.block_start) != seen_blocks.cend()) {
         return true;
     }
 
     size_t real_end = 0;
 
-    const auto &translated_block = _vex.translate((*_memory)[block.block_start],
-            block.block_start, block.instruction_count, &real_end);
-
-    _seen_blocks.insert(block.block_start);
-
-    /* A regular deep copy won't work as memory returned by it is volatile and
+    /* The returned block is already a copy owned by `Vex` (see `IRArena`).
+     * A regular deep copy won't work as memory returned by it is volatile and
      * only valid within a libVEX_Translate callback (allocation strategies
      * AllocModeTEMP/AllocModePERM).
-     * We patched in another strategy using heap allocations directly.
      */
+    IRSB *block_pointer = nullptr;
+    const auto pretranslated = _pretranslated_blocks.find(
+                      make_pair(block.block_start, block.instruction_count));
+    if(pretranslated != _pretranslated_blocks.end()) {
+        block_pointer = pretranslated->second.block;
+        real_end = pretranslated->second.end;
+        _pretranslated_blocks.erase(pretranslated);
+    }
+    else {
+        // VEX translates up to its limit, the block is cut to its
+        // instruction count below (see `pretranslate_block`).
+        block_pointer = _vex.translate((*_memory)[block.block_start],
+                block.block_start, MAX_INSTRUCTIONS, &real_end);
+    }
+
+    seen_blocks.insert(block.block_start);
 
-    auto *block_pointer = deepCopyIRSB_Heap(&translated_block);
     auto &vex_block = *block_pointer;
 
     /* The basic block was non-strict and has been split by VEX at a call
@@ -123,7 +137,7 @@ bool Translator::process_block(Function &function,
         split.block_end = block.block_end;
         split.instruction_count = block.instruction_count - head_instructions;
 
-        result &= process_block(function, split);
+        result &= process_block(function, split, seen_blocks);
         finalize_block(function, block, block_pointer);
         return result;
     }
@@ -170,7 +184,11 @@ bool Translator::process_block(Function &function,
 }
 
 void Translator::detect_tail_jumps(Function &function) {
-    for(const auto &block : function.get_blocks()) {
+
+    // Uses the block map directly as this is also part of lifting a
+    // function on demand.
+    const auto &blocks = function._function_blocks;
+    for(const auto &block : blocks) {
         /* FIXME: We cannot really do this in finalize_block as we need to know
          * all other blocks in the function. Hence, we cheat "a little".
          */
@@ -178,7 +196,6 @@ void Translator::detect_tail_jumps(Function &function) {
             block.second->get_terminator());
         terminator.is_tail = false;
 
-        const auto &blocks = function.get_blocks();
         auto target = terminator.fall_through;
 
         /* Only consider resolvable tail jumps for now (is there anything else
@@ -217,7 +234,7 @@ Function *Translator::translate_function(const
     Function &function = _functions.at(address);
 
     for(auto i = blocks.cbegin(), e = blocks.cend(); i != e; ++i) {
-        if(!process_block(function, *i)) {
+        if(!process_block(function, *i, _seen_blocks)) {
             _functions.erase(address);
             return nullptr;
         }
@@ -256,9 +273,7 @@ Function *Translator::maybe_translate_function(const uintptr_t address) {
  * \return A (read-only) `Function` object.
  */
 const Function &Translator::get_function(const uintptr_t address) {
-    lock_guard<mutex> _(_mutex);
-
-    const Function *function = maybe_translate_function(address);
+    const Function *function = maybe_get_function(address);
     if(!function) {
         stringstream stream;
         stream << "Cannot translate function at address " << hex
@@ -281,7 +296,10 @@ const Function &Translator::get_function(const uintptr_t address) {
  * \return A (read-only) `Function` object.
  */
 const Function &Translator::cget_function(const uintptr_t address) const {
-    lock_guard<mutex> _(_mutex);
+    unique_lock<mutex> lock(_mutex, defer_lock);
+    if(!is_finalized()) {
+        lock.lock();
+    }
 
     const auto &function = _functions.find(address);
 
@@ -307,6 +325,17 @@ const Function &Translator::cget_function(const uintptr_t address) const {
  * not known.
  */
 const Function *Translator::maybe_get_function(const uintptr_t address) {
+
+    // A finalized object is read-only, hence no function is translated
+    // anymore and no lock is needed.
+    if(is_finalized()) {
+        const auto &function = _functions.find(address);
+        if(function != _functions.cend()) {
+            return &function->second;
+        }
+        return nullptr;
+    }
+
     lock_guard<mutex> _(_mutex);
     return maybe_translate_function(address);
 }
@@ -315,7 +344,7 @@ const Function *Translator::maybe_get_function(const uintptr_t address) {
 std::map<uintptr_t, Function> &Translator::get_functions_mutable() {
     std::lock_guard<std::mutex> _(_mutex);
 
-    if(_is_finalized) {
+    if(is_finalized()) {
         stringstream stream;
         stream << "Translator object is already finalized " << "\n";
         throw runtime_error(stream.str());
@@ -323,12 +352,128 @@ std::map<uintptr_t, Function> &Translator::get_functions_mutable() {
     return _functions;
 }
 
-void Translator::parse_known_functions() {
+void Translator::pretranslate_block(const BlockDescriptor &block,
+                                    PretranslatedBlocks &out_blocks) const {
+
+    if(block.block_start == block.block_end) {
+        return;
+    }
+
+    // VEX is asked for as many instructions as it translates at most. Blocks
+    // with fewer instructions are cut by `process_block` which turns them
+    // into fall through blocks, VEX would end them with a jump instead.
+    PretranslatedBlock result;
+    try {
+        result.block = _vex.translate((*_memory)[block.block_start],
+                                      block.block_start,
+                                      MAX_INSTRUCTIONS,
+                                      &result.end);
+    }
+    catch(...) {
+        // Translated (and reported) again by `process_block()`.
+        return;
+    }
+    out_blocks.emplace(make_pair(block.block_start, block.instruction_count),
+                       result);
+
+    // Also translate the remainder of a block that was split by VEX
+    // (see `process_block()`).
+    uintptr_t head_instructions = 0;
+    for(auto i = 0; i < result.block->stmts_used; ++i) {
+        if(result.block->stmts[i]->tag == Ist_IMark) {
+            head_instructions++;
+        }
+    }
+    if(head_instructions < block.instruction_count) {
+        BlockDescriptor split;
+        split.block_start = result.end;
+        split.block_end = block.block_end;
+        split.instruction_count = block.instruction_count - head_instructions;
+        pretranslate_block(split, out_blocks);
+    }
+}
+
+void Translator::parse_known_functions(uint32_t num_threads) {
     const auto &functions = _dump_file.get_functions();
 
+    // Translate all blocks concurrently first. Afterwards, the functions
+    // are built in address order exactly as without threads (blocks shared
+    // by several functions are only assigned to the first one), but take
+    // the already translated blocks.
+    if(num_threads > 1) {
+        vector<const FunctionBlocks*> all_blocks;
+        all_blocks.reserve(functions.size());
+        for(const auto &kv : functions) {
+            all_blocks.push_back(&kv.second);
+        }
+
+        vector<PretranslatedBlocks> thread_blocks(num_threads);
+        auto worker = [&](uint32_t thread_idx) {
+            for(size_t i = thread_idx;
+                i < all_blocks.size();
+                i += num_threads) {
+                for(const BlockDescriptor &block : *all_blocks[i]) {
+                    pretranslate_block(block, thread_blocks[thread_idx]);
+                }
+            }
+        };
+
+        thread *all_threads = new thread[num_threads];
+        for(uint32_t i = 0; i < num_threads; i++) {
+            all_threads[i] = thread(worker, i);
+        }
+        for(uint32_t i = 0; i < num_threads; i++) {
+            all_threads[i].join();
+        }
+        delete [] all_threads;
+
+        // Merge in thread order to stay deterministic.
+        for(const PretranslatedBlocks &blocks : thread_blocks) {
+            _pretranslated_blocks.insert(blocks.cbegin(), blocks.cend());
+        }
+    }
+
     for(const auto &kv : functions) {
         translate_function(kv);
     }
+
+    // Blocks that were never used (e.g., blocks shared by several functions
+    // are translated by each thread processing one of them) are freed
+    // together with all other translations by the `Vex` object.
+    _pretranslated_blocks.clear();
+}
+
+void Translator::prepare_known_functions() {
+    const auto &functions = _dump_file.get_functions();
+
+    // Blocks shared by several functions are assigned to the first one as
+    // it is done when all functions are translated at once. This is decided
+    // here already in order to not depend on the order the functions are
+    // accessed in.
+    set<uintptr_t> seen_blocks;
+    for(const auto &kv : functions) {
+        shared_ptr<FunctionBlocks> blocks = make_shared<FunctionBlocks>();
+        for(const BlockDescriptor &block : kv.second) {
+            if(seen_blocks.insert(block.block_start).second) {
+                blocks->push_back(block);
+            }
+        }
+
+        Function &function = _functions[kv.first];
+        function = Function(kv.first);
+        function._lazy = make_shared<FunctionLazyState>();
+        function._lazy->lift = [this, blocks](Function &lazy_function) {
+            set<uintptr_t> function_seen_blocks;
+            for(const BlockDescriptor &block : *blocks) {
+                process_block(lazy_function, block, function_seen_blocks);
+            }
+            detect_tail_jumps(lazy_function);
+            lazy_function.finalize();
+        };
+        function._lazy->summarize = [this](Function &lazy_function) {
+            build_return_summary(lazy_function);
+        };
+    }
 }
 
 Terminator Translator::get_terminator(const IRSB &block,
@@ -493,14 +638,189 @@ Terminator Translator::get_terminator(const IRSB &block,
     return result;
 }
 
-void Translator::finalize() {
-    _is_finalized = true;
+void Translator::finalize(uint32_t num_threads) {
+
+    // Build interval index over all blocks of all functions.
+    _function_intervals.clear();
+    for(const auto &kv_func : _functions) {
+
+        // Do not lift functions that are lifted on demand, the exported
+        // block ranges are used instead (the candidates are checked with
+        // `contains_address()` anyway).
+        if(kv_func.second._lazy) {
+            const auto &dump_functions = _dump_file.get_functions();
+            for(const BlockDescriptor &block :
+                                        dump_functions.at(kv_func.first)) {
+                if(block.block_start >= block.block_end) {
+                    continue;
+                }
+                FunctionInterval interval;
+                interval.start = block.block_start;
+                interval.end = block.block_end - 1;
+                interval.function = &kv_func.second;
+                _function_intervals.push_back(interval);
+            }
+            continue;
+        }
+
+        for(const auto &kv_block : kv_func.second.get_blocks()) {
+            if(kv_block.second->get_addresses().empty()) {
+                continue;
+            }
+            FunctionInterval interval;
+            interval.start = kv_block.second->get_address();
+            interval.end = kv_block.second->get_last_address();
+            interval.function = &kv_func.second;
+            _function_intervals.push_back(interval);
+        }
+    }
+    sort(_function_intervals.begin(),
+         _function_intervals.end(),
+         [](const FunctionInterval &a, const FunctionInterval &b) {
+             return a.start < b.start;
+         });
+    uint64_t max_end = 0;
+    for(FunctionInterval &interval : _function_intervals) {
+        max_end = max(max_end, interval.end);
+        interval.max_end = max_end;
+    }
+
+    // Build the return summaries (each thread only writes the functions
+    // it processes and reads the finalized interval index). Functions
+    // lifted on demand build their summary on first access.
+    vector<Function*> functions;
+    functions.reserve(_functions.size());
+    for(auto &kv_func : _functions) {
+        if(!kv_func.second._lazy) {
+            functions.push_back(&kv_func.second);
+        }
+    }
+    auto worker = [&](uint32_t thread_idx, uint32_t num_workers) {
+        for(size_t i = thread_idx; i < functions.size(); i += num_workers) {
+            build_return_summary(*functions[i]);
+        }
+    };
+
+    // For debugging purposes do not spawn any thread.
+    if(num_threads <= 1) {
+        worker(0, 1);
+    }
+    else {
+        thread *all_threads = new thread[num_threads];
+        for(uint32_t i = 0; i < num_threads; i++) {
+            all_threads[i] = thread(worker, i, num_threads);
+        }
+        for(uint32_t i = 0; i < num_threads; i++) {
+            all_threads[i].join();
+        }
+        delete [] all_threads;
+    }
+
+    // All readers observing the flag also observe the finalized data.
+    _is_finalized.store(true, memory_order_release);
+}
+
+void Translator::build_return_summary(Function &function) const {
+
+    FunctionReturnSummary &summary = function._return_summary;
+    summary.ret_instrs.clear();
+    summary.tail_jmps.clear();
+
+    for(const auto &kv : function.get_blocks_ssa()) {
+        const BaseInstructionSSAPtrs &instrs = kv.second->get_instructions();
+        if(instrs.empty()) {
+            continue;
+        }
+
+        // Return instruction is always the last instruction of a basic block.
+        const BaseInstructionSSAPtr &last_instr = instrs.back();
+        if(last_instr->is_ret()) {
+            summary.ret_instrs.push_back(last_instr);
+        }
+
+        else if(last_instr->is_unconditional_jmp()) {
+
+            // Extract target address of jump operand.
+            const OperandSSAPtr &jmp_op = last_instr->get_operand(0);
+            uint64_t jmp_target_addr = 0;
+            switch(jmp_op->get_type()) {
+                case SSAOpTypeConstantX64: {
+                    const ConstantX64SSA &temp =
+                                    static_cast<const ConstantX64SSA&>(*jmp_op);
+                    jmp_target_addr = temp.get_value();
+                    break;
+                }
+                case SSAOpTypeAddressX64: {
+                    const AddressX64SSA &temp =
+                                     static_cast<const AddressX64SSA&>(*jmp_op);
+                    jmp_target_addr = temp.get_value();
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            // Only jumps leaving the function are tail jumps.
+            if(jmp_target_addr == 0
+               || function.contains_address(jmp_target_addr)) {
+                continue;
+            }
+
+            const Function *jmp_func =
+                                find_containing_function(jmp_target_addr);
+            if(jmp_func == nullptr) {
+                continue;
+            }
+            FunctionTailJmp tail_jmp;
+            tail_jmp.jmp_addr = last_instr->get_address();
+            tail_jmp.target_entry = jmp_func->get_entry();
+            summary.tail_jmps.push_back(tail_jmp);
+        }
+    }
+}
+
+const Function *Translator::find_containing_function(uint64_t addr) const {
+
+    // Walk backwards from the last interval starting at or before the
+    // address as long as an interval can still reach it. Functions can
+    // share code, in this case the one with the lowest entry is used
+    // (as the function map is ordered by entry).
+    const Function *result = nullptr;
+    auto it = upper_bound(_function_intervals.cbegin(),
+                          _function_intervals.cend(),
+                          addr,
+                          [](uint64_t value, const FunctionInterval &i) {
+                              return value < i.start;
+                          });
+    while(it != _function_intervals.cbegin()) {
+        --it;
+        if(it->max_end < addr) {
+            break;
+        }
+        if(it->end >= addr
+           && it->function->contains_address(addr)
+           && (!result
+               || it->function->get_entry() < result->get_entry())) {
+            result = it->function;
+        }
+    }
+    return result;
 }
 
 const Function &Translator::get_containing_function(uint64_t addr) const {
-    for(const auto &kv : _functions) {
-        if(kv.second.contains_address(addr)) {
-            return kv.second;
+
+    if(is_finalized()) {
+        const Function *result = find_containing_function(addr);
+        if(result) {
+            return *result;
+        }
+    }
+    else {
+        lock_guard<mutex> _(_mutex);
+        for(const auto &kv : _functions) {
+            if(kv.second.contains_address(addr)) {
+                return kv.second;
+            }
         }
     }
     stringstream err_msg;
@@ -540,3 +860,16 @@ void Translator::add_function_vfunc_xref(uint64_t fct_addr,
 
     function->second.add_vfunc_xref(xref_addr);
 }
+
+size_t Translator::get_memory_footprint() const {
+    std::lock_guard<std::mutex> _(_mutex);
+
+    size_t bytes = footprint_tree(_seen_blocks)
+                   + footprint_tree(_pretranslated_blocks)
+                   + footprint_tree(_functions)
+                   + footprint_vector(_function_intervals);
+    for(const auto &kv : _functions) {
+        bytes += kv.second.get_memory_footprint();
+    }
+    return bytes;
+}
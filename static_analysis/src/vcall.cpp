@@ -1,6 +1,13 @@
 
 #include "vcall.h"
 #include "expression.h"
+#include "address_list_file.h"
+#include "vcall_policy_file.h"
+#include "chunked_text.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <future>
 
 using namespace std;
 
@@ -18,6 +25,12 @@ const VCalls &VCallFile::get_vcalls() const {
     return _vcalls;
 }
 
+void VCallFile::set_result_stream(ResultStream *result_stream) {
+    lock_guard<mutex> _(_mtx);
+
+    _result_stream = result_stream;
+}
+
 const VCall &VCallFile::get_vcall(uint64_t icall_addr) const {
     lock_guard<mutex> _(_mtx);
 
@@ -38,7 +51,10 @@ const VCall &VCallFile::get_vcall(uint64_t icall_addr) const {
 void VCallFile::add_possible_vcall(uint64_t icall_addr) {
     lock_guard<mutex> _(_mtx);
 
-    _possible_vcalls.insert(icall_addr);
+    if(_possible_vcalls.insert(icall_addr).second
+       && _result_stream != nullptr) {
+        _result_stream->add_possible_vcall(icall_addr);
+    }
 }
 
 void VCallFile::insert_vcall(uint64_t icall_addr,
@@ -50,20 +66,17 @@ void VCallFile::insert_vcall(uint64_t icall_addr,
     vcall.entry_index = entry_index;
 
     // Add also all known vtables from the hierarchy.
-    const HierarchiesVTable &hierarchies =
-                        _vtable_hierarchies.get_hierarchies();
-    for(const DependentVTables &hierarchy : hierarchies) {
-        if(hierarchy.find(vtbl_idx) != hierarchy.cend()) {
-            for(uint32_t hier_vtbl_idx : hierarchy) {
-
-                const VTable &hier_vtbl =
-                        _vtable_file.get_vtable(hier_vtbl_idx);
-                if(entry_index >= hier_vtbl.entries.size()) {
-                    continue;
-                }
-                vcall.vtbl_idxs.insert(hier_vtbl_idx);
+    const DependentVTables *hierarchy =
+                        _vtable_hierarchies.get_hierarchy(vtbl_idx);
+    if(hierarchy != nullptr) {
+        for(uint32_t hier_vtbl_idx : *hierarchy) {
+
+            const VTable &hier_vtbl =
+                    _vtable_file.get_vtable(hier_vtbl_idx);
+            if(entry_index >= hier_vtbl.entries.size()) {
+                continue;
             }
-            break;
+            vcall.vtbl_idxs.insert(hier_vtbl_idx);
         }
     }
 
@@ -86,29 +99,38 @@ void VCallFile::add_vcall(uint64_t icall_addr,
     // Check if we already know about the vcall and add it if we do not.
     if(_vcall_addrs.find(icall_addr) == _vcall_addrs.end()) {
         insert_vcall(icall_addr, vtbl_idx, entry_index);
+        if(_result_stream != nullptr) {
+            _result_stream->add_vcall(icall_addr,
+                                      vtbl.module_name,
+                                      vtbl.addr,
+                                      entry_index);
+        }
     }
 
     // We know the vcall already. Hence we have to search it the slow way.
     else {
         for(auto &it : _vcalls) {
             if(it.addr == icall_addr) {
-                it.vtbl_idxs.insert(vtbl_idx);
+                if(it.vtbl_idxs.insert(vtbl_idx).second
+                   && _result_stream != nullptr) {
+                    _result_stream->add_vcall(icall_addr,
+                                              vtbl.module_name,
+                                              vtbl.addr,
+                                              entry_index);
+                }
 
                 // Add also all known vtables from the hierarchy.
-                const HierarchiesVTable &hierarchies =
-                                    _vtable_hierarchies.get_hierarchies();
-                for(const DependentVTables &hierarchy : hierarchies) {
-                    if(hierarchy.find(vtbl_idx) != hierarchy.cend()) {
-                        for(uint32_t hier_vtbl_idx : hierarchy) {
-
-                            const VTable &hier_vtbl =
-                                    _vtable_file.get_vtable(hier_vtbl_idx);
-                            if(entry_index >= hier_vtbl.entries.size()) {
-                                continue;
-                            }
-                            it.vtbl_idxs.insert(hier_vtbl_idx);
+                const DependentVTables *hierarchy =
+                                    _vtable_hierarchies.get_hierarchy(vtbl_idx);
+                if(hierarchy != nullptr) {
+                    for(uint32_t hier_vtbl_idx : *hierarchy) {
+
+                        const VTable &hier_vtbl =
+                                _vtable_file.get_vtable(hier_vtbl_idx);
+                        if(entry_index >= hier_vtbl.entries.size()) {
+                            continue;
                         }
-                        break;
+                        it.vtbl_idxs.insert(hier_vtbl_idx);
                     }
                 }
 
@@ -133,102 +155,372 @@ void VCallFile::add_vcall(uint64_t icall_addr,
     }
 }
 
-void VCallFile::export_vcalls(const string &target_dir) {
+void VCallFile::export_vcalls(const string &target_dir,
+                              uint32_t num_threads) {
     lock_guard<mutex> _(_mtx);
 
     stringstream temp_str;
     temp_str << target_dir << "/" << _module_name << ".vcalls";
     string target_file = temp_str.str();
 
-    ofstream vcall_file;
-    vcall_file.open(target_file);
-
     stringstream temp_str_ext;
     temp_str_ext << target_dir << "/" << _module_name << ".vcalls_extended";
     string target_file_ext = temp_str_ext.str();
 
-    ofstream vcall_file_ext;
-    vcall_file_ext.open(target_file_ext);
+    // Vcalls of the same hierarchies share their set of allowed vtables
+    // (interned in vcall order, the files only read the store).
+    VTableSetStore set_store(_vtable_file, _vtable_hierarchies);
+    vector<VTableSetId> vcall_sets;
+    vcall_sets.reserve(_vcalls.size());
+    for(const auto &it : _vcalls) {
+        vcall_sets.push_back(set_store.intern(get_allowed_vtables(it)));
+    }
 
-    vcall_file << _module_name << "\n";
-    vcall_file_ext << _module_name << "\n";
+    // Export the hierarchy in the following format:
+    // <module_name:hex_addr_vtable> <module_name:hex_addr_function>
+    auto format_vcalls = [&](bool is_extended,
+                             size_t begin,
+                             size_t end,
+                             string &out) {
+        for(size_t i = begin; i < end; i++) {
+            const VCall &it = _vcalls[i];
+
+            // Address of vcall in module.
+            append_hex(out, it.addr);
+
+            // Index into vtable that is used by vcall.
+            if(is_extended) {
+                out += ' ';
+                append_hex(out, it.entry_index);
+            }
 
-    const HierarchiesVTable &hierarchies =
-                            _vtable_hierarchies.get_hierarchies();
-    for(const auto &it : _vcalls) {
+            set_store.for_each(vcall_sets[i], [&](uint32_t idx) {
+                const VTable& temp = _vtable_file.get_vtable(idx);
 
-        // Do not consider all vtables used in this vcall as in one hierarchy.
-        unordered_set<uint32_t> allowed_vtables;
-        for(const auto idx : it.vtbl_idxs) {
-            for(const auto dependent_vtbls : hierarchies) {
-                if(dependent_vtbls.find(idx) != dependent_vtbls.cend()) {
-                    for(uint32_t hier_idx : dependent_vtbls) {
-                        allowed_vtables.insert(hier_idx);
-                    }
+                // Export vtable address.
+                out += ' ';
+                out += temp.module_name;
+                out += ':';
+                append_hex(out, temp.addr);
+                if(!is_extended) {
+                    return;
                 }
-            }
 
-            // Add vtable index manually afterwards in order to also export
-            // vtables that do not belong to a hierarchy.
-            allowed_vtables.insert(idx);
+                // Export target function address.
+                uint64_t target_func = 0;
+                if(temp.entries.size() > it.entry_index) {
+                    target_func = temp.entries.at(it.entry_index);
+                }
+                out += ' ';
+                out += temp.module_name;
+                out += ':';
+                append_hex(out, target_func);
+            });
+            out += '\n';
         }
+    };
+
+    // The remaining files only depend on the interned sets, hence they are
+    // written while the vcall files are formatted.
+    const string policy_file = target_dir + "/" + _module_name
+                               + VCALL_POLICY_FILE_EXTENSION;
+    future<bool> policy_written = async(launch::async, [&]() {
+        return export_policy(policy_file, set_store, vcall_sets);
+    });
+    const string sets_file = target_file + "_sets";
+    future<bool> sets_written = async(launch::async, [&]() {
+        return export_sets(sets_file, set_store, vcall_sets);
+    });
+    future<bool> ext_written = async(launch::async, [&]() {
+        return write_chunked_text(target_file_ext,
+                                  _module_name + "\n",
+                                  _vcalls.size(),
+                                  num_threads,
+                                  [&](size_t begin, size_t end, string &out) {
+            format_vcalls(true, begin, end, out);
+        });
+    });
+
+    if(!write_chunked_text(target_file,
+                           _module_name + "\n",
+                           _vcalls.size(),
+                           num_threads,
+                           [&](size_t begin, size_t end, string &out) {
+        format_vcalls(false, begin, end, out);
+    })) {
+        cerr << "Not able to write vcalls file '"
+             << target_file
+             << "'."
+             << "\n";
+    }
+
+    stringstream temp_str_poss;
+    temp_str_poss << target_dir << "/" << _module_name << ".vcalls_possible";
+    string target_file_poss = temp_str_poss.str();
+
+    // Address of possible vcall in module.
+    vector<uint64_t> addresses(_possible_vcalls.cbegin(),
+                               _possible_vcalls.cend());
+    if(!write_chunked_text(target_file_poss,
+                           _module_name + "\n",
+                           addresses.size(),
+                           num_threads,
+                           [&](size_t begin, size_t end, string &out) {
+        for(size_t i = begin; i < end; i++) {
+            append_hex(out, addresses[i]);
+            out += '\n';
+        }
+    })) {
+        cerr << "Not able to write possible vcalls file '"
+             << target_file_poss
+             << "'."
+             << "\n";
+    }
 
-        // Address of vcall in module.
-        vcall_file << hex << it.addr;
-        vcall_file_ext << hex << it.addr;
-
-        // Index into vtable that is used by vcall.
-        vcall_file_ext << " " << hex << it.entry_index;
-
-        // Export the hierarchy in the following format:
-        // <module_name:hex_addr_vtable> <module_name:hex_addr_function>
-        for(const auto idx : allowed_vtables) {
-            const VTable& temp = _vtable_file.get_vtable(idx);
-
-            // Export vtable address.
-            vcall_file << " "
-                       << temp.module_name
-                       << ":"
-                       << hex << temp.addr;
-            vcall_file_ext << " "
-                           << temp.module_name
-                           << ":"
-                           << hex << temp.addr;
-
-            // Export target function address.
-            uint64_t target_func = 0;
-            if(temp.entries.size() > it.entry_index) {
-                target_func = temp.entries.at(it.entry_index);
+    // Binary versions of the address lists (the dynamic analysis reads them
+    // in place, see `address_list_file.h`).
+    export_address_list(target_file_poss, addresses);
+
+    addresses.clear();
+    for(const auto &it : _vcalls) {
+        addresses.push_back(it.addr);
+    }
+    export_address_list(target_file, addresses);
+
+    addresses.clear();
+    for(const auto &kv : _vtable_file.get_this_vtables()) {
+        addresses.push_back(kv.first);
+    }
+    export_address_list(target_dir + "/" + _module_name + "_vtables",
+                        addresses);
+
+    if(!ext_written.get()) {
+        cerr << "Not able to write vcalls file '"
+             << target_file_ext
+             << "'."
+             << "\n";
+    }
+    if(!policy_written.get()) {
+        cerr << "Not able to write vcall policy file '"
+             << policy_file
+             << "'."
+             << "\n";
+    }
+    if(!sets_written.get()) {
+        cerr << "Not able to write vcall sets file '"
+             << sets_file
+             << "'."
+             << "\n";
+    }
+}
+
+unordered_set<uint32_t> VCallFile::get_allowed_vtables(
+                                                    const VCall &vcall) const {
+
+    // Do not consider all vtables used in this vcall as in one hierarchy.
+    unordered_set<uint32_t> allowed_vtables;
+    for(const auto idx : vcall.vtbl_idxs) {
+        const DependentVTables *dependent_vtbls =
+                                    _vtable_hierarchies.get_hierarchy(idx);
+        if(dependent_vtbls != nullptr) {
+            for(uint32_t hier_idx : *dependent_vtbls) {
+                allowed_vtables.insert(hier_idx);
             }
-            vcall_file_ext << " "
-                           << temp.module_name
-                           << ":"
-                           << hex << target_func;
         }
 
-        vcall_file << "\n";
-        vcall_file_ext << "\n";
+        // Add vtable index manually afterwards in order to also export
+        // vtables that do not belong to a hierarchy.
+        allowed_vtables.insert(idx);
     }
+    return allowed_vtables;
+}
 
-    vcall_file.close();
-    vcall_file_ext.close();
+bool VCallFile::export_sets(const string &target_file,
+                            const VTableSetStore &set_store,
+                            const vector<VTableSetId> &vcall_sets) const {
+
+    // Format:
+    // <module_name>
+    // vtables <number>
+    // <module_name:hex_addr_vtable> (one line each, in hierarchy order)
+    // sets <number>
+    // <first>-<last> ... (one line each, positions of the vtables above)
+    // vcalls <number>
+    // <hex_addr_vcall> <set> (one line each)
+    ofstream file(target_file);
+    if(!file) {
+        return false;
+    }
 
-    stringstream temp_str_poss;
-    temp_str_poss << target_dir << "/" << _module_name << ".vcalls_possible";
-    string target_file_poss = temp_str_poss.str();
+    file << _module_name << "\n";
+    file << "vtables " << dec << set_store.get_num_vtables() << "\n";
+    for(size_t pos = 0; pos < set_store.get_num_vtables(); pos++) {
+        const VTable &vtable = _vtable_file.get_vtable(
+                                                set_store.get_vtable_idx(pos));
+        file << vtable.module_name << ":" << hex << vtable.addr << "\n";
+    }
+
+    file << "sets " << dec << set_store.size() << "\n";
+    for(VTableSetId set_id = 0; set_id < set_store.size(); set_id++) {
+        bool first = true;
+        for(const VTableRange &range : set_store.get_ranges(set_id)) {
+            file << (first ? "" : " ")
+                 << dec << range.first << "-" << dec << range.last;
+            first = false;
+        }
+        file << "\n";
+    }
+
+    file << "vcalls " << dec << _vcalls.size() << "\n";
+    for(size_t i = 0; i < _vcalls.size(); i++) {
+        file << hex << _vcalls[i].addr << " " << dec << vcall_sets[i] << "\n";
+    }
+
+    file.close();
+    return !file.fail();
+}
+
+bool VCallFile::export_policy(const string &target_file,
+                              const VTableSetStore &set_store,
+                              const vector<VTableSetId> &vcall_sets) const {
+
+    // The analyzed module is always the first one of the module table.
+    vector<uint32_t> policy_module_idxs(_vtable_file.get_num_modules(),
+                                        UINT32_MAX);
+    vector<string> module_names;
+    policy_module_idxs[_vtable_file.get_this_module_id()] = 0;
+    module_names.push_back(_module_name);
+
+    // Build the sorted keys of each interned set once (vcalls of the same
+    // hierarchies share it).
+    vector<vector<uint64_t>> set_keys(set_store.size());
+    for(VTableSetId set_id = 0; set_id < set_store.size(); set_id++) {
+        vector<uint64_t> &keys = set_keys[set_id];
+        set_store.for_each(set_id, [&](uint32_t idx) {
+            const VTable &vtable = _vtable_file.get_vtable(idx);
+            uint32_t &module_idx = policy_module_idxs[vtable.module_id];
+            if(module_idx == UINT32_MAX) {
+                module_idx = module_names.size();
+                module_names.push_back(vtable.module_name);
+            }
+            keys.push_back(vcall_policy_key(module_idx, vtable.addr));
+        });
+        sort(keys.begin(), keys.end());
+    }
+    vector<const vector<uint64_t>*> sets;
+    for(const vector<uint64_t> &keys : set_keys) {
+        sets.push_back(&keys);
+    }
+    vector<pair<uint64_t, uint32_t>> callsites;
+    for(size_t i = 0; i < _vcalls.size(); i++) {
+        callsites.emplace_back(_vcalls[i].addr, vcall_sets[i]);
+    }
+    if(module_names.size() > (static_cast<size_t>(1)
+                              << (64 - VCALL_POLICY_MODULE_SHIFT))) {
+        return false;
+    }
+
+    // Place the sets into the pool. A set that fits into a cache line is
+    // moved to the next one instead of crossing it.
+    const size_t keys_per_line = VCALL_POLICY_CACHE_LINE / sizeof(uint64_t);
+    vector<uint64_t> pool;
+    vector<uint32_t> set_offsets(sets.size());
+    for(size_t i = 0; i < sets.size(); i++) {
+        const vector<uint64_t> &keys = *sets[i];
+        const size_t line_offset = pool.size() % keys_per_line;
+        if(keys.size() <= keys_per_line
+           && line_offset + keys.size() > keys_per_line) {
+            pool.resize(pool.size() + keys_per_line - line_offset, 0);
+        }
+        set_offsets[i] = pool.size();
+        pool.insert(pool.end(), keys.cbegin(), keys.cend());
+    }
 
-    ofstream vcall_file_poss;
-    vcall_file_poss.open(target_file_poss);
+    // Hash table with a load factor of at most 1/2.
+    uint32_t bucket_bits = 0;
+    while((static_cast<size_t>(1) << bucket_bits) < 2 * callsites.size()) {
+        bucket_bits++;
+    }
+    const uint64_t num_buckets = static_cast<uint64_t>(1) << bucket_bits;
+    VCallPolicyBucket empty_bucket;
+    empty_bucket.icall_addr = VCALL_POLICY_EMPTY_BUCKET;
+    empty_bucket.set_offset = 0;
+    empty_bucket.set_size = 0;
+    vector<VCallPolicyBucket> buckets(num_buckets, empty_bucket);
+    for(const auto &callsite : callsites) {
+        uint64_t i = vcall_policy_bucket(callsite.first, bucket_bits);
+        while(buckets[i].icall_addr != VCALL_POLICY_EMPTY_BUCKET) {
+            i = (i + 1) & (num_buckets - 1);
+        }
+        buckets[i].icall_addr = callsite.first;
+        buckets[i].set_offset = set_offsets[callsite.second];
+        buckets[i].set_size = sets[callsite.second]->size();
+    }
 
-    vcall_file_poss << _module_name << "\n";
+    string module_table;
+    for(const string &module_name : module_names) {
+        module_table.append(module_name.c_str(), module_name.size() + 1);
+    }
 
-    for(const auto &it : _possible_vcalls) {
+    VCallPolicyHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VCALL_POLICY_FILE_MAGIC, 8);
+    header.version = VCALL_POLICY_FILE_VERSION;
+    header.bucket_bits = bucket_bits;
+    header.num_modules = module_names.size();
+    header.num_callsites = callsites.size();
+    header.modules_offset = vcall_policy_align(sizeof(header));
+    header.buckets_offset = vcall_policy_align(header.modules_offset
+                                               + module_table.size());
+    header.sets_offset = vcall_policy_align(header.buckets_offset
+                                            + num_buckets
+                                              * sizeof(VCallPolicyBucket));
+    header.num_set_entries = pool.size();
+
+    vector<uint8_t> data(header.sets_offset + pool.size() * sizeof(uint64_t),
+                         0);
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + header.modules_offset,
+           module_table.data(),
+           module_table.size());
+    memcpy(data.data() + header.buckets_offset,
+           buckets.data(),
+           buckets.size() * sizeof(VCallPolicyBucket));
+    if(!pool.empty()) {
+        memcpy(data.data() + header.sets_offset,
+               pool.data(),
+               pool.size() * sizeof(uint64_t));
+    }
 
-        // Address of possible vcall in module.
-        vcall_file_poss << hex << it << "\n";
+    // Write into a temporary file which replaces the policy at the end.
+    const string temp_file = target_file + ".tmp";
+    FILE *file = fopen(temp_file.c_str(), "wb");
+    if(file == NULL) {
+        return false;
     }
+    bool success = fwrite(data.data(), 1, data.size(), file) == data.size();
+    success = fclose(file) == 0 && success;
+
+    return success && rename(temp_file.c_str(), target_file.c_str()) == 0;
+}
 
-    vcall_file_poss.close();
+void VCallFile::export_address_list(const string &target_file,
+                                    vector<uint64_t> &addresses) const {
+
+    sort(addresses.begin(), addresses.end());
+    addresses.erase(unique(addresses.begin(), addresses.end()),
+                    addresses.end());
+
+    const string file_name = target_file + ADDRESS_LIST_FILE_EXTENSION;
+    if(!write_address_list(file_name,
+                           _module_name,
+                           addresses.data(),
+                           addresses.size())) {
+        cerr << "Not able to write address list file '"
+             << file_name
+             << "'."
+             << "\n";
+    }
 }
 
 bool VCallFile::is_known_vcall(uint64_t icall_addr) const {
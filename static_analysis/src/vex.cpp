@@ -1,6 +1,9 @@
 
 #include "vex.h"
+#include "instrumentation.h"
+#include "tracepoints.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <sstream>
@@ -9,10 +12,7 @@
 
 using namespace std;
 
-mutex vex_mutex;
-
-Vex::Vex()
-    : _block(nullptr) {
+Vex::Vex() {
 
     AllocationListener listener = &Vex::incoming_allocation;
     LibVEX_registerAllocationListener(this, listener);
@@ -44,38 +44,50 @@ void Vex::manage_allocation(void *allocation) {
     _allocations.push_back(allocation);
 }
 
+/*!
+ * \brief Returns the translation context of the calling thread.
+ */
+VexContext &Vex::get_context() {
+    static thread_local VexContext context;
+    return context;
+}
+
 // FIXME: This is specific to AMD-64.
-void Vex::initialize() {
-    memset(&_args, 0, sizeof(_args));
-    memset(&_abi_info, 0, sizeof(_abi_info));
-    memset(&_arch_info, 0, sizeof(_arch_info));
+void Vex::initialize(VexContext &context) {
+    VexTranslateArgs &args = context.args;
+    memset(&args, 0, sizeof(args));
+    memset(&context.abi_info, 0, sizeof(context.abi_info));
+    memset(&context.arch_info, 0, sizeof(context.arch_info));
 
-    LibVEX_default_VexAbiInfo(&_abi_info);
-    LibVEX_default_VexArchInfo(&_arch_info);
+    LibVEX_default_VexAbiInfo(&context.abi_info);
+    LibVEX_default_VexArchInfo(&context.arch_info);
 
-    _abi_info.guest_amd64_assume_fs_is_const = true;
-    _abi_info.guest_amd64_assume_gs_is_const = true;
+    context.abi_info.guest_amd64_assume_fs_is_const = true;
+    context.abi_info.guest_amd64_assume_gs_is_const = true;
 
-    _args.callback_opaque = this;
+    args.callback_opaque = &context;
 
-    _args.instrument1 = &Vex::instrument;
-    _args.chase_into_ok = &Vex::chase_into_ok;
-    _args.needs_self_check = &Vex::needs_self_check;
+    args.instrument1 = &Vex::instrument;
+    args.chase_into_ok = &Vex::chase_into_ok;
+    args.needs_self_check = &Vex::needs_self_check;
 
     const auto dispatch = reinterpret_cast<void*>(&Vex::dispatch);
-    _args.disp_cp_chain_me_to_fastEP = dispatch;
-    _args.disp_cp_chain_me_to_slowEP = dispatch;
-    _args.disp_cp_xassisted = dispatch;
-    _args.disp_cp_xindir = dispatch;
+    args.disp_cp_chain_me_to_fastEP = dispatch;
+    args.disp_cp_chain_me_to_slowEP = dispatch;
+    args.disp_cp_xassisted = dispatch;
+    args.disp_cp_xindir = dispatch;
 
-    _args.guest_extents = &_guest_extents;
+    args.guest_extents = &context.guest_extents;
 }
 
-void Vex::initialize_amd64() {
-    initialize();
+void Vex::initialize_amd64(VexContext &context) {
+    initialize(context);
+
+    VexArchInfo &arch_info = context.arch_info;
+    VexTranslateArgs &args = context.args;
 
-    _arch_info.endness = VexEndnessLE;
-    _arch_info.hwcaps =  VEX_HWCAPS_AMD64_SSE3 |
+    arch_info.endness = VexEndnessLE;
+    arch_info.hwcaps =  VEX_HWCAPS_AMD64_SSE3 |
             VEX_HWCAPS_AMD64_CX16 |
             VEX_HWCAPS_AMD64_LZCNT |
             VEX_HWCAPS_AMD64_AVX |
@@ -83,15 +95,15 @@ void Vex::initialize_amd64() {
             VEX_HWCAPS_AMD64_BMI |
             VEX_HWCAPS_AMD64_AVX2;
 
-    _abi_info.guest_stack_redzone_size = 128;
+    context.abi_info.guest_stack_redzone_size = 128;
 
-    _args.arch_host = VexArchAMD64;
-    _args.arch_guest = VexArchAMD64;
+    args.arch_host = VexArchAMD64;
+    args.arch_guest = VexArchAMD64;
 
-    _args.archinfo_host = _arch_info;
-    _args.archinfo_guest = _arch_info;
+    args.archinfo_host = arch_info;
+    args.archinfo_guest = arch_info;
 
-    _args.abiinfo_both = _abi_info;
+    args.abiinfo_both = context.abi_info;
 }
 
 void Vex::log_bytes(const char *bytes, size_t number_bytes) {
@@ -104,8 +116,13 @@ IRSB *Vex::instrument(void *callback_opaque, IRSB *block,
                             const VexGuestLayout*, const VexGuestExtents*,
                             const VexArchInfo*, IRType, IRType) {
 
-    Vex &self = *static_cast<Vex*>(callback_opaque);
-    self._block = deepCopyIRSB(block);
+    // The block only lives in VEX's temporary storage until the next
+    // translation, hence it is copied right away. The compact arena copy
+    // replaces `deepCopyIRSB_Heap` which allocates every node separately.
+    // We are called from within `LibVEX_Translate`, i.e., while holding
+    // `_translate_mtx`.
+    VexContext &context = *static_cast<VexContext*>(callback_opaque);
+    context.block = get_instance()._arena.copy(block);
 
     return block;
 }
@@ -119,26 +136,53 @@ IRSB *Vex::instrument(void *callback_opaque, IRSB *block,
  *
  * \param bytes The bytes that are to be processed.
  * \param guest_address The virtual address the bytes originally lie at.
- * \param instruction_count The number of instructions VEX shall translate.
+ * \param instruction_count The maximum number of instructions VEX shall
+ *  translate (at most `MAX_INSTRUCTIONS`).
  * \param[out] vex_block_end The virtual address of the end of the translated
  *  block.
- * \return A reference to the translated VEX block (of type IRSB). Due to the
- * way VEX works internally, this reference lives as long as no further
- * translation request is made and hence should be deep-copied immediately.
+ * \param register_updates The register update mode of VEX's optimiser for
+ *  this translation (`VexRegUpd_INVALID` uses the default set by
+ *  `set_iropt_register_updates_default`).
+ * \return A pointer to the translated VEX block (of type IRSB) which is a
+ * copy private to the caller. It is freed when the `Vex` object is destroyed.
+ * Each thread uses its own translation context.
  *
- * \todo VEX may not respect `instruction_count` properly. This should be
- * handled by the `Translator` class though.
+ * VEX ends the block earlier at control flow instructions. Splitting the
+ * blocks of the binary accordingly is handled by the `Translator` class.
  */
-const IRSB &Vex::translate(const uint8_t *bytes, uintptr_t guest_address,
-                           size_t instruction_count,
-                           arg_out uintptr_t *vex_block_end) {
-    initialize_amd64();
-    _control.guest_max_insns = instruction_count;
-
-    _args.guest_bytes = bytes;
-    _args.guest_bytes_addr = guest_address;
-
-    const auto result = LibVEX_Translate(&_args);
+IRSB *Vex::translate(const uint8_t *bytes, uintptr_t guest_address,
+                     size_t instruction_count,
+                     arg_out uintptr_t *vex_block_end,
+                     VexRegisterUpdates register_updates) {
+    VexContext &context = get_context();
+    initialize_amd64(context);
+    Instrumentation::get_instance().count(InstrCounterVexTranslations);
+    MARX_TRACE2(vex__translate, guest_address, instruction_count);
+
+    context.args.guest_bytes = bytes;
+    context.args.guest_bytes_addr = guest_address;
+    context.block = nullptr;
+
+    // libVEX only reads its global copy of the control, hence the limit and
+    // register update mode of this call are pushed into it while holding the
+    // lock. `_control` itself keeps the defaults.
+    _translate_mtx.lock();
+    VexControl control = _control;
+    control.guest_max_insns = max<size_t>(1, min<size_t>(instruction_count,
+                                                         MAX_INSTRUCTIONS));
+    if(register_updates != VexRegUpd_INVALID) {
+        control.iropt_register_updates_default = register_updates;
+    }
+    VexTranslateResult result;
+    try {
+        LibVEX_Update_Control(&control);
+        result = LibVEX_Translate(&context.args);
+    }
+    catch(...) {
+        _translate_mtx.unlock();
+        throw;
+    }
+    _translate_mtx.unlock();
 
     if(!(result.status & result.VexTransOK)) {
         stringstream stream;
@@ -151,10 +195,177 @@ const IRSB &Vex::translate(const uint8_t *bytes, uintptr_t guest_address,
 
     if(vex_block_end) {
         // FIXME: Assert only one guest extent was used.
-        *vex_block_end = guest_address + _args.guest_extents->len[0];
+        *vex_block_end = guest_address + context.guest_extents.len[0];
     }
 
-    return *_block;
+    return context.block;
+}
+
+/*!
+ * \brief Translates `instruction_count` instructions at a certain address and
+ * caches the resulting VEX block.
+ *
+ * Blocks are cached per address, number of instructions and register
+ * update mode.
+ */
+const IRSB *Vex::translate_cached(const uint8_t *bytes,
+                                  uintptr_t guest_address,
+                                  size_t instruction_count,
+                                  VexRegisterUpdates register_updates) {
+
+    // The register update mode and the number of instructions change the
+    // resulting block, hence they are part of the key (stored in the unused
+    // upper bits of the address). The mode is given explicitly since the
+    // default can be changed by other threads in the meantime.
+    uintptr_t mode = register_updates - VexRegUpd_INVALID;
+    uintptr_t key = guest_address
+                    | (static_cast<uintptr_t>(instruction_count) << 48)
+                    | (mode << 60);
+    InstructionCacheShard &shard =
+              _instruction_cache[(guest_address >> 2) % INSTRUCTION_CACHE_SHARDS];
+
+    shard.mtx.lock();
+    const auto needle = shard.blocks.find(key);
+    if(needle != shard.blocks.cend()) {
+        const IRSB *block = needle->second;
+        shard.mtx.unlock();
+        Instrumentation::get_instance().count(InstrCounterVexCacheHits);
+        return block;
+    }
+    shard.mtx.unlock();
+
+    // If two threads translate the same instructions concurrently,
+    // the block of the first one is kept.
+    const IRSB *block = translate(bytes,
+                                  guest_address,
+                                  instruction_count,
+                                  nullptr,
+                                  register_updates);
+    shard.mtx.lock();
+    block = shard.blocks.insert(make_pair(key, block)).first->second;
+    shard.mtx.unlock();
+    return block;
+}
+
+/*!
+ * \brief Translates the single instruction at a certain address and caches
+ * the resulting VEX block.
+ *
+ * The analyses symbolically execute artificial blocks consisting of one
+ * instruction for each data flow path and therefore request the same
+ * instructions over and over again.
+ *
+ * \param bytes The bytes of the instruction.
+ * \param guest_address The virtual address the instruction lies at.
+ * \param register_updates The register update mode of VEX's optimiser.
+ * \return A pointer to the translated VEX block which is shared
+ * by all callers and therefore must not be modified.
+ */
+const IRSB *Vex::translate_instruction(const uint8_t *bytes,
+                                       uintptr_t guest_address,
+                                       VexRegisterUpdates register_updates) {
+    return translate_cached(bytes, guest_address, 1, register_updates);
+}
+
+/*!
+ * \brief Translates the longest prefix of the given instructions that
+ * directly follow each other in memory into one (cached) VEX block.
+ *
+ * Data flow paths often contain runs of consecutive instructions. Since the
+ * instructions of an artificial path are executed one after another anyway,
+ * such a run is translated by one VEX call instead of one call per
+ * instruction. The block of a run must not be split per instruction since
+ * VEX forwards values between the instructions of a block.
+ *
+ * \param bytes The bytes of the first instruction.
+ * \param guest_addresses The virtual addresses of the instructions.
+ * \param count The number of addresses (at least 1).
+ * \param register_updates The register update mode of VEX's optimiser.
+ * \param[out] num_translated The number of instructions (beginning with the
+ *  first address) the returned block consists of.
+ * \return A pointer to the translated VEX block which is shared
+ * by all callers and therefore must not be modified.
+ */
+const IRSB *Vex::translate_instructions(const uint8_t *bytes,
+                                        const uintptr_t *guest_addresses,
+                                        size_t count,
+                                        VexRegisterUpdates register_updates,
+                                        arg_out size_t *num_translated) {
+
+    // Only addresses that can belong to the directly following instruction
+    // are candidates for the run, the actual instruction boundaries are
+    // only known after translating.
+    size_t num_candidates = 1;
+    while(num_candidates < count
+          && num_candidates < MAX_INSTRUCTIONS
+          && guest_addresses[num_candidates]
+               > guest_addresses[num_candidates-1]
+          && guest_addresses[num_candidates]
+               - guest_addresses[num_candidates-1]
+               <= MAX_INSTRUCTION_LENGTH) {
+        num_candidates++;
+    }
+
+    if(num_candidates == 1) {
+        *num_translated = 1;
+        return translate_instruction(bytes,
+                                     guest_addresses[0],
+                                     register_updates);
+    }
+
+    const IRSB *block = translate_cached(bytes,
+                                         guest_addresses[0],
+                                         num_candidates,
+                                         register_updates);
+
+    // Count the instructions of the block that match the given addresses.
+    // VEX ends the block early on control flow instructions.
+    size_t num_marks = 0;
+    size_t num_matching = 0;
+    for(int i = 0; i < block->stmts_used; i++) {
+        const IRStmt *stmt = block->stmts[i];
+        if(stmt->tag != Ist_IMark) {
+            continue;
+        }
+        if(num_marks == num_matching
+           && num_matching < num_candidates
+           && stmt->Ist.IMark.addr == guest_addresses[num_matching]) {
+            num_matching++;
+        }
+        num_marks++;
+    }
+
+    if(num_matching == num_marks) {
+        *num_translated = num_matching;
+        return block;
+    }
+
+    // The block contains instructions that are not part of the run,
+    // translate only the matching ones.
+    *num_translated = num_matching;
+    if(num_matching <= 1) {
+        *num_translated = 1;
+        return translate_instruction(bytes,
+                                     guest_addresses[0],
+                                     register_updates);
+    }
+    return translate_cached(bytes,
+                            guest_addresses[0],
+                            num_matching,
+                            register_updates);
+}
+
+size_t Vex::get_memory_footprint() const {
+    size_t bytes = 0;
+    {
+        lock_guard<mutex> _(_translate_mtx);
+        bytes += _arena.size() + footprint_vector(_allocations);
+    }
+    for(const InstructionCacheShard &shard : _instruction_cache) {
+        lock_guard<mutex> _(shard.mtx);
+        bytes += footprint_hash(shard.blocks);
+    }
+    return bytes;
 }
 
 void Vex::set_iropt_register_updates_default(VexRegisterUpdates value) {
@@ -172,10 +383,12 @@ void Vex::set_iropt_register_updates_default(VexRegisterUpdates value) {
 
             throw runtime_error(stream.str());
     }
+    lock_guard<mutex> _(_translate_mtx);
+    // Pushed to libVEX by the next translation.
     _control.iropt_register_updates_default = value;
-    LibVEX_Update_Control(&_control);
 }
 
 VexRegisterUpdates Vex::get_iropt_register_updates_default() const {
+    lock_guard<mutex> _(_translate_mtx);
     return _control.iropt_register_updates_default;
 }
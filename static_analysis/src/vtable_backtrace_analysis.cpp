@@ -51,7 +51,7 @@ VtableBacktraceAnalysis::VtableBacktraceAnalysis(const std::string &module_name,
     const BaseInstructionSSAPtr &start_instr = *temp_instr_ptr;
 
     // Check if we have a definition.
-    const OperandSSAPtrs &defs = start_instr->get_definitions();
+    const OperandSSASpan defs = start_instr->get_definitions();
     if(defs.empty()) {
         stringstream err_msg;
         err_msg << "Instruction "
@@ -187,7 +187,7 @@ void VtableBacktraceAnalysis::remove_unnecessary_nodes(
         else if(graph[*it].instr->is_instruction()
                 && !graph[*it].instr->is_unconditional_jmp()) {
 
-            const OperandSSAPtrs uses = graph[*it].instr->get_uses();
+            const OperandSSASpan uses = graph[*it].instr->get_uses();
             if(uses.size() == 1) {
                 if(uses.at(0)->is_constant()) {
                     to_remove.insert(*it);
@@ -219,7 +219,7 @@ void VtableBacktraceAnalysis::remove_unnecessary_nodes(
         {
             // Only consider nodes where the "definition"
             // operand is a memory object.
-            const OperandSSAPtrs &src_ops = graph[*it].instr->get_definitions();
+            const OperandSSASpan src_ops = graph[*it].instr->get_definitions();
             if(src_ops.empty()) {
                 continue;
             }
@@ -251,7 +251,7 @@ void VtableBacktraceAnalysis::remove_unnecessary_nodes(
                 // a memory object.
                 GraphDataFlow::vertex_descriptor dst_node =
                                                  boost::target(*edge_it, graph);
-                const OperandSSAPtrs &dst_ops =
+                const OperandSSASpan dst_ops =
                                        graph[dst_node].instr->get_definitions();
                 if(dst_ops.empty()) {
                     continue;
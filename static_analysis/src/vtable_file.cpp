@@ -1,5 +1,11 @@
 
 #include "vtable_file.h"
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <exception>
 
 using namespace std;
 
@@ -26,7 +32,7 @@ VTableFile::VTableFile(const string &this_module_name,
 
 }
 
-bool VTableFile::parse(const string &vtables_file) {
+bool VTableFile::parse(const string &vtables_file, bool use_companion) {
 
     // Make sure that we parse files only if object was not finalized yet.
     if(_is_finalized) {
@@ -35,6 +41,87 @@ bool VTableFile::parse(const string &vtables_file) {
         return false;
     }
 
+    VTableModule module;
+    return read_module(vtables_file, use_companion, module)
+           && add_module(module);
+}
+
+bool VTableFile::read_module(const string &vtables_file,
+                             bool use_companion,
+                             VTableModule &module) {
+
+    if(!use_companion) {
+        return parse_text(vtables_file, module);
+    }
+
+    const string companion_file = vtables_file + "_vtables.marx_bin";
+    const uint64_t source_hash = hash_files({
+                                        vtables_file + "_vtables.txt",
+                                        vtables_file + "_vtables_xrefs.txt"});
+    if(source_hash
+       && MappedFile::exists(companion_file)
+       && import_companion(companion_file, source_hash, module)) {
+        return true;
+    }
+
+    module = VTableModule();
+    if(!parse_text(vtables_file, module)) {
+        return false;
+    }
+
+    if(source_hash
+       && !export_companion(companion_file, source_hash, module)) {
+        cerr << "Not able to write companion file '"
+             << companion_file
+             << "'."
+             << "\n";
+    }
+    return true;
+}
+
+bool VTableFile::add_module(VTableModule &module) {
+
+    // Make sure that we add modules only if object was not finalized yet.
+    if(_is_finalized) {
+        cerr << "Parse attempt after VTableFile object was finalized."
+             << "\n";
+        return false;
+    }
+
+    // Check if we already parsed a vtables file for this module.
+    if(_managed_modules.find(module.module_name) != _managed_modules.cend()) {
+        cerr << "A vtables file for this module was already parsed." << "\n";
+        return false;
+    }
+
+    // Only add module to managed modules if it has at least one vtable.
+    if(module.vtables.empty()) {
+        return true;
+    }
+    _managed_modules.insert(module.module_name);
+
+    // NOTE: Index is a unique identifier for all vtables in all modules.
+    const uint32_t first_index = _index;
+    for(VTable &vtable : module.vtables) {
+        vtable.index += first_index;
+        if(vtable.type == VTableTypeGot) {
+            vtable.vtbl_ref_idx += first_index;
+        }
+
+        _vtables.push_back(move(vtable));
+        assert(_vtables[_index].index == _index
+               && "Index of vtable and index in vector are not the same.");
+
+        _index++;
+    }
+    module.vtables.clear();
+
+    return true;
+}
+
+bool VTableFile::parse_text(const string &vtables_file,
+                            VTableModule &module) {
+
     ifstream file(vtables_file + "_vtables.txt");
     if(!file) {
         cerr << "Not able to open '_vtables.txt' file." << "\n";
@@ -56,11 +143,7 @@ bool VTableFile::parse(const string &vtables_file) {
              << "\n";
     }
 
-    // Check if we already parsed a vtables file for this module.
-    if(_managed_modules.find(module_name) != _managed_modules.cend()) {
-        cerr << "A vtables file for this module was already parsed." << "\n";
-        return false;
-    }
+    module.module_name = module_name;
 
     bool has_vtables = false;
     while(getline(file, line)) {
@@ -150,8 +233,8 @@ bool VTableFile::parse(const string &vtables_file) {
         vtable.vtbl_ref_addr = vtable_ref_addr;
         vtable.vtbl_ref_idx = 0;
 
-        // NOTE: Index is a unique identifier for all vtables in all modules.
-        vtable.index = _index;
+        // NOTE: Index is relative to the module until it is added.
+        vtable.index = module.vtables.size();
 
         while(parser >> hex >> vtable_entry) {
             if(parser.fail()) {
@@ -164,45 +247,35 @@ bool VTableFile::parse(const string &vtables_file) {
             vtable.entries.push_back(vtable_entry);
         }
 
-        _vtables.push_back(vtable);
-        assert(_vtables[_index].module_name == vtable.module_name
-               && _vtables[_index].addr == vtable.addr
-               && _vtables[_index].index == vtable.index
-               && "Index of vtable and index in vector are not the same.");
+        module.vtables.push_back(vtable);
+    }
 
-        _index++;
+    // Map the vtable addresses of this module to their (first) index.
+    unordered_map<uint64_t, uint32_t> module_vtable_idxs;
+    for(const VTable &vtable : module.vtables) {
+        module_vtable_idxs.emplace(vtable.addr, vtable.index);
     }
 
     // Resolve .got vtable references to existing vtables.
-    for(auto &it : _vtables) {
-        if(it.type == VTableTypeGot) {
-            bool found = false;
-            for(auto &it_ref : _vtables) {
-                if(it_ref.addr == it.vtbl_ref_addr
-                   && it_ref.module_name == it.module_name) {
-                    it.vtbl_ref_idx = it_ref.index;
-                    found = true;
-                    break;
-                }
-            }
-            if(!found) {
+    for(VTable &vtable : module.vtables) {
+        if(vtable.type == VTableTypeGot) {
+            const auto ref_it = module_vtable_idxs.find(vtable.vtbl_ref_addr);
+            if(ref_it == module_vtable_idxs.cend()) {
                 cerr << "Reference vtable "
-                     << hex << it.vtbl_ref_addr
+                     << hex << vtable.vtbl_ref_addr
                      <<" of .got vtable "
-                     << hex << it.addr
+                     << hex << vtable.addr
                      << " not found. Corrupt data."
                      << endl;
                 return false;
             }
+            vtable.vtbl_ref_idx = ref_it->second;
         }
     }
 
     // Only parse xrefs file and if it has at least one vtable.
     if(has_vtables) {
 
-        // Only add module to managed modules if it has at least one vtable.
-        _managed_modules.insert(module_name);
-
         // Parse xrefs file.
         file = ifstream(vtables_file + "_vtables_xrefs.txt");
         if(!file) {
@@ -246,34 +319,30 @@ bool VTableFile::parse(const string &vtables_file) {
             }
 
             // Add xrefs to vtable object.
-            bool found = false;
-            for(auto &it : _vtables) {
-                if(it.module_name == module_name_xrefs
-                   && it.addr == vtable_addr) {
-                    found = true;
-                    while(parser >> hex >> vtable_xref_addr) {
-                        if(parser.fail()) {
-                            cerr << "Parsing error in "
-                                 << "'_vtables_xrefs.txt' file."
-                                 << "\n";
-                            return false;
-                        }
-
-                        // Xref file makes a distinction between
-                        // a direct xref (offset 0) and an indirect
-                        // xref (offset -16) which is used for .got and .bss.
-                        parser >> dec >> offset;
-                        if(offset == 0) {
-                            it.xrefs.insert(vtable_xref_addr);
-                        }
-                        else {
-                            it.indirect_xrefs[offset].insert(vtable_xref_addr);
-                        }
+            const auto vtable_it = module_vtable_idxs.find(vtable_addr);
+            if(vtable_it != module_vtable_idxs.cend()) {
+                VTable &vtable = module.vtables[vtable_it->second];
+                while(parser >> hex >> vtable_xref_addr) {
+                    if(parser.fail()) {
+                        cerr << "Parsing error in "
+                             << "'_vtables_xrefs.txt' file."
+                             << "\n";
+                        return false;
+                    }
+
+                    // Xref file makes a distinction between
+                    // a direct xref (offset 0) and an indirect
+                    // xref (offset -16) which is used for .got and .bss.
+                    parser >> dec >> offset;
+                    if(offset == 0) {
+                        vtable.xrefs.insert(vtable_xref_addr);
+                    }
+                    else {
+                        vtable.indirect_xrefs[offset].insert(vtable_xref_addr);
                     }
-                    break;
                 }
             }
-            if(!found) {
+            else {
                 cerr << "Vtable from '_vtables_xrefs.txt' file "
                      << "not in '_vtables.txt' file."
                      << "\n";
@@ -287,6 +356,103 @@ bool VTableFile::parse(const string &vtables_file) {
 }
 
 
+// Reads the vtables of one module from a companion file.
+bool VTableFile::import_companion(const string &companion_file,
+                                  uint64_t source_hash,
+                                  VTableModule &module) {
+
+    CompanionFileReader reader(companion_file);
+    if(!reader.is_valid(CompanionFileVTables, source_hash)) {
+        return false;
+    }
+
+    uint64_t num_vtables;
+    if(!reader.read_string(module.module_name)
+       || !reader.read(num_vtables)) {
+        return false;
+    }
+
+    module.vtables.resize(num_vtables);
+    for(uint64_t i = 0; i < num_vtables; i++) {
+        VTable &vtable = module.vtables[i];
+        vtable.module_name = module.module_name;
+        vtable.index = i;
+
+        uint32_t vtbl_ref_offset;
+        const uint64_t *values;
+        uint64_t count;
+        bool is_complete = reader.read(vtable.type)
+                           && reader.read(vtable.addr)
+                           && reader.read(vtable.offset_to_top)
+                           && reader.read_string(vtable.name)
+                           && reader.read(vtable.bss_size)
+                           && reader.read(vtable.bss_offset)
+                           && reader.read(vtbl_ref_offset)
+                           && reader.read(vtable.vtbl_ref_addr);
+        if(!is_complete || vtbl_ref_offset >= num_vtables) {
+            return false;
+        }
+        vtable.vtbl_ref_idx = vtable.type == VTableTypeGot
+                              ? vtbl_ref_offset
+                              : 0;
+
+        if(!reader.read_array(values, count)) {
+            return false;
+        }
+        vtable.entries.assign(values, values + count);
+
+        if(!reader.read_array(values, count)) {
+            return false;
+        }
+        vtable.xrefs.insert(values, values + count);
+
+        uint64_t num_offsets;
+        if(!reader.read(num_offsets)) {
+            return false;
+        }
+        for(uint64_t j = 0; j < num_offsets; j++) {
+            int32_t offset;
+            if(!reader.read(offset) || !reader.read_array(values, count)) {
+                return false;
+            }
+            vtable.indirect_xrefs[offset].insert(values, values + count);
+        }
+    }
+
+    return true;
+}
+
+// Writes the vtables of one (not yet added) module into a companion file.
+bool VTableFile::export_companion(const string &companion_file,
+                                  uint64_t source_hash,
+                                  const VTableModule &module) {
+
+    CompanionFileWriter writer(companion_file,
+                               CompanionFileVTables,
+                               source_hash);
+    writer.write_string(module.module_name);
+    writer.write(module.vtables.size());
+    for(const VTable &vtable : module.vtables) {
+        writer.write(vtable.type);
+        writer.write(vtable.addr);
+        writer.write(vtable.offset_to_top);
+        writer.write_string(vtable.name);
+        writer.write(vtable.bss_size);
+        writer.write(vtable.bss_offset);
+        writer.write(vtable.type == VTableTypeGot ? vtable.vtbl_ref_idx : 0);
+        writer.write(vtable.vtbl_ref_addr);
+        writer.write_array(vtable.entries.data(), vtable.entries.size());
+        writer.write_container(vtable.xrefs);
+        writer.write(vtable.indirect_xrefs.size());
+        for(const auto &kv : vtable.indirect_xrefs) {
+            writer.write(kv.first);
+            writer.write_container(kv.second);
+        }
+    }
+    return writer.finish();
+}
+
+
 const EntryVTablePtrsMap& VTableFile::get_this_vtable_entries() const {
 
     // Make sure that the object is finalized.
@@ -294,7 +460,7 @@ const EntryVTablePtrsMap& VTableFile::get_this_vtable_entries() const {
         throw runtime_error("VTableFile object was not finalized.");
     }
 
-    return _module_vtable_entries_map.at(_this_module_name);
+    return _this_vtable_entries;
 }
 
 const EntryVTablePtrsMap& VTableFile::get_this_vtable_entry_addrs() const {
@@ -304,7 +470,7 @@ const EntryVTablePtrsMap& VTableFile::get_this_vtable_entry_addrs() const {
         throw runtime_error("VTableFile object was not finalized.");
     }
 
-    return _module_vtable_entry_addrs_map.at(_this_module_name);
+    return _this_vtable_entry_addrs;
 }
 
 const VTableMap& VTableFile::get_this_vtables() const {
@@ -314,7 +480,7 @@ const VTableMap& VTableFile::get_this_vtables() const {
         throw runtime_error("VTableFile object was not finalized.");
     }
 
-    return *(_module_vtables_map.at(_this_module_name));
+    return _module_vtables[_this_module_id];
 }
 
 const VTableMap& VTableFile::get_vtables(const string &module_name) const {
@@ -324,11 +490,18 @@ const VTableMap& VTableFile::get_vtables(const string &module_name) const {
         throw runtime_error("VTableFile object was not finalized.");
     }
 
-    if(_module_vtables_map.find(module_name) == _module_vtables_map.cend()) {
-        throw runtime_error("VTableFile object does not know module name.");
+    return _module_vtables[get_module_id(module_name)];
+}
+
+const VTableMap& VTableFile::get_vtables(VTableModuleId module_id) const {
+
+    // Make sure that the object is finalized.
+    if(!_is_finalized) {
+        throw runtime_error("VTableFile object was not finalized.");
     }
 
-    return *(_module_vtables_map.at(module_name));
+    check_module_id(module_id);
+    return _module_vtables[module_id];
 }
 
 const VTableVector& VTableFile::get_all_vtables() const {
@@ -341,7 +514,7 @@ const VTableVector& VTableFile::get_all_vtables() const {
     return _vtables;
 }
 
-void VTableFile::finalize() {
+void VTableFile::finalize(uint32_t num_threads) {
 
     // Make sure that we only finalize this object once.
     if(_is_finalized) {
@@ -354,77 +527,259 @@ void VTableFile::finalize() {
                             "module to analyze.");
     }
 
-    // Build up a vector that contains a mapping for each module
-    // that maps from vtable address to vtable object.
+    // Intern the module names.
     uint32_t idx = 0;
     for(auto &module_it : _managed_modules) {
-        for(auto &vtbl_it : _vtables) {
-            if(vtbl_it.module_name != module_it) {
-                continue;
-            }
+        _module_ids[module_it] = idx;
+        idx++;
+    }
+    _this_module_id = _module_ids.at(_this_module_name);
+    _module_vtables.resize(_managed_modules.size());
+    _module_indexes.resize(_managed_modules.size());
+
+    // Group the vtables by module (in the order they were added).
+    vector<vector<VTable*>> module_vtables(_managed_modules.size());
+    for(auto &vtbl_it : _vtables) {
+        VTableModuleId module_id = _module_ids.at(vtbl_it.module_name);
+        vtbl_it.module_id = module_id;
+        module_vtables[module_id].push_back(&vtbl_it);
+    }
 
-            if(_module_vtables.size() <= idx) {
-                VTableMap temp;
-                temp[vtbl_it.addr] = &vtbl_it;
-                _module_vtables.push_back(temp);
+    // Each task only writes the structures of its own module. The module to
+    // analyze is taken first since its task also builds the entry maps.
+    vector<VTableModuleId> order;
+    order.push_back(_this_module_id);
+    for(idx = 0; idx < module_vtables.size(); idx++) {
+        if(idx != _this_module_id) {
+            order.push_back(idx);
+        }
+    }
+    vector<exception_ptr> errors(order.size());
+    atomic<size_t> next_task(0);
+    auto worker = [&]() {
+        while(true) {
+            const size_t task_idx = next_task++;
+            if(task_idx >= order.size()) {
+                break;
             }
-            else {
-                _module_vtables[idx][vtbl_it.addr] = &vtbl_it;
+            try {
+                const VTableModuleId module_id = order[task_idx];
+                finalize_module(module_id, module_vtables[module_id]);
+                if(module_id == _this_module_id) {
+                    finalize_this_module();
+                }
+            }
+            catch(...) {
+                errors[task_idx] = current_exception();
             }
         }
-        idx++;
+    };
+
+    // For debugging purposes do not spawn any thread.
+    const uint32_t num_workers = min<size_t>(num_threads, order.size());
+    if(num_workers <= 1) {
+        worker();
+    }
+    else {
+        vector<thread> threads;
+        for(uint32_t i = 0; i < num_workers; i++) {
+            threads.emplace_back(worker);
+        }
+        for(thread &t : threads) {
+            t.join();
+        }
     }
+    for(const exception_ptr &error : errors) {
+        if(error) {
+            rethrow_exception(error);
+        }
+    }
+}
 
-    // Build up a mapping that maps a module name to its vtable address
-    // to vtable object map.
-    idx = 0;
-    for(auto &module_it : _managed_modules) {
-        _module_vtables_map[module_it] = &_module_vtables[idx];
-        idx++;
+void VTableFile::finalize_module(VTableModuleId module_id,
+                                 const vector<VTable*> &vtables) {
+
+    // Build up the mapping from vtable address to vtable object and the
+    // sorted address arrays used for lookups.
+    VTableMap &vtable_map = _module_vtables[module_id];
+    vector<pair<uint64_t, uint32_t>> addrs;
+    addrs.reserve(vtables.size());
+    for(VTable *vtbl_ptr : vtables) {
+        vtable_map[vtbl_ptr->addr] = vtbl_ptr;
+        addrs.emplace_back(vtbl_ptr->addr, vtbl_ptr->index);
+    }
+
+    // Sorting by address and index keeps the last vtable with the
+    // same address (as the vtable map does).
+    sort(addrs.begin(), addrs.end());
+
+    VTableModuleIndex &module_index = _module_indexes[module_id];
+    module_index.addrs.reserve(addrs.size());
+    module_index.indexes.reserve(addrs.size());
+    for(const auto &kv : addrs) {
+        if(!module_index.addrs.empty()
+           && module_index.addrs.back() == kv.first) {
+            module_index.indexes.back() = kv.second;
+            continue;
+        }
+        module_index.addrs.push_back(kv.first);
+        module_index.indexes.push_back(kv.second);
+    }
+
+    // Build up the positions of the functions in the vtables of the module
+    // (only the first entry of a vtable that holds the function counts).
+    for(const auto &vtbl_kv : vtable_map) {
+        const vector<uint64_t> &entries = vtbl_kv.second->entries;
+        for(uint32_t pos = 0; pos < entries.size(); pos++) {
+            VTableEntryPositions &positions =
+                               module_index.entry_positions[entries[pos]];
+            if(!positions.empty()
+               && positions.back().vtbl_idx == vtbl_kv.second->index) {
+                continue;
+            }
+            positions.push_back({vtbl_kv.second->index, pos});
+        }
     }
 
     // Sanity check if module mapping is completely correct
     // (Added for now to exclude this as error source)
-    for(auto &module_it : _managed_modules) {
-        const auto &vtable_map = *(_module_vtables_map.at(module_it));
-        for(const auto &vtbl_kv : vtable_map) {
-            if(vtbl_kv.second->module_name != module_it) {
-                throw runtime_error("Error while finalizing vtable mapping.");
-            }
+    for(const auto &vtbl_kv : vtable_map) {
+        if(_module_ids.at(vtbl_kv.second->module_name) != module_id) {
+            throw runtime_error("Error while finalizing vtable mapping.");
         }
     }
+}
+
+void VTableFile::finalize_this_module() {
 
-    // Build up a map for each module that maps each vtable entry
+    // Build up a map for the module to analyze that maps each vtable entry
     // and vtable entry address to the vtable object.
     // Since one entry can be in multiple vtables,
     // the entry maps to a set of vtable ptrs.
-    for(auto &module_it : _managed_modules) {
-        EntryVTablePtrsMap &entry_map = _module_vtable_entries_map[module_it];
-        EntryVTablePtrsMap &entry_addr_map =
-                                      _module_vtable_entry_addrs_map[module_it];
+    const VTableMap &vtable_map = _module_vtables[_this_module_id];
+    for(const auto &vtbl_kv : vtable_map) {
+        VTable *vtbl_ptr = vtbl_kv.second;
+
+        uint32_t counter = 0;
+        for(const auto entry : vtbl_ptr->entries) {
+            _this_vtable_entries[entry].insert(vtbl_ptr);
+            _this_vtable_entry_addrs[
+                          vtbl_ptr->addr + (counter * _addr_size)].insert(
+                                                                      vtbl_ptr);
+            counter++;
+        }
+    }
 
-        for(auto &vtbl_it : _vtables) {
-            if(vtbl_it.module_name != module_it) {
-                continue;
-            }
+    // Build the filters in front of the maps of the module to analyze.
+    vector<uint64_t> addrs;
+    for(const auto &vtbl_kv : vtable_map) {
+        addrs.push_back(vtbl_kv.first);
+    }
+    _this_vtables_filter.build(move(addrs));
 
-            uint32_t counter = 0;
-            for(const auto entry : vtbl_it.entries) {
-                entry_map[entry].insert(&vtbl_it);
-                entry_addr_map[vtbl_it.addr + (counter * _addr_size)].insert(
-                                                                      &vtbl_it);
-                counter++;
-            }
-        }
+    addrs.clear();
+    for(const auto &kv : _this_vtable_entries) {
+        addrs.push_back(kv.first);
     }
+    _this_vtable_entries_filter.build(move(addrs));
 
-    return;
+    addrs.clear();
+    for(const auto &kv : _this_vtable_entry_addrs) {
+        addrs.push_back(kv.first);
+    }
+    _this_vtable_entry_addrs_filter.build(move(addrs));
 }
 
 bool VTableFile::is_finalized() const {
     return _is_finalized;
 }
 
+size_t VTableFile::get_memory_footprint() const {
+    size_t bytes = footprint_vector(_vtables);
+    for(const VTable &vtable : _vtables) {
+        bytes += footprint_vector(vtable.entries)
+                 + footprint_hash(vtable.xrefs)
+                 + footprint_tree(vtable.indirect_xrefs)
+                 + vtable.module_name.capacity()
+                 + vtable.name.capacity();
+        for(const auto &kv : vtable.indirect_xrefs) {
+            bytes += footprint_hash(kv.second);
+        }
+    }
+
+    bytes += footprint_vector(_module_vtables);
+    for(const VTableMap &module_vtables : _module_vtables) {
+        bytes += footprint_tree(module_vtables);
+    }
+    bytes += footprint_vector(_module_indexes);
+    for(const VTableModuleIndex &module_index : _module_indexes) {
+        bytes += footprint_vector(module_index.addrs)
+                 + footprint_vector(module_index.indexes)
+                 + footprint_hash(module_index.entry_positions);
+        for(const auto &kv : module_index.entry_positions) {
+            bytes += footprint_vector(kv.second);
+        }
+    }
+    for(const EntryVTablePtrsMap *entries : {&_this_vtable_entries,
+                                             &_this_vtable_entry_addrs}) {
+        bytes += footprint_tree(*entries);
+        for(const auto &kv : *entries) {
+            bytes += footprint_hash(kv.second);
+        }
+    }
+    bytes += footprint_hash(_module_ids);
+    bytes += footprint_tree(_managed_modules);
+    return bytes;
+}
+
+VTableModuleId VTableFile::get_module_id(const string &module_name) const {
+
+    // Make sure that the object is finalized.
+    if(!_is_finalized) {
+        throw runtime_error("VTableFile object was not finalized.");
+    }
+
+    const auto module_it = _module_ids.find(module_name);
+    if(module_it == _module_ids.cend()) {
+        throw runtime_error("VTableFile object does not know module name.");
+    }
+    return module_it->second;
+}
+
+VTableModuleId VTableFile::get_this_module_id() const {
+
+    // Make sure that the object is finalized.
+    if(!_is_finalized) {
+        throw runtime_error("VTableFile object was not finalized.");
+    }
+
+    return _this_module_id;
+}
+
+uint32_t VTableFile::get_num_modules() const {
+    return _module_indexes.size();
+}
+
+void VTableFile::check_module_id(VTableModuleId module_id) const {
+    if(module_id >= _module_indexes.size()) {
+        throw runtime_error("VTableFile object does not know module id.");
+    }
+}
+
+// Binary search in the sorted vtable addresses of the module.
+const VTable* VTableFile::find_vtable(VTableModuleId module_id,
+                                      uint64_t addr) const {
+    const VTableModuleIndex &module_index = _module_indexes[module_id];
+
+    const auto it = lower_bound(module_index.addrs.cbegin(),
+                                module_index.addrs.cend(),
+                                addr);
+    if(it == module_index.addrs.cend() || *it != addr) {
+        return nullptr;
+    }
+    return &_vtables[module_index.indexes[it - module_index.addrs.cbegin()]];
+}
+
 const VTable* VTableFile::get_vtable_ptr(const std::string &module_name,
                                         uint64_t addr) const {
 
@@ -433,24 +788,70 @@ const VTable* VTableFile::get_vtable_ptr(const std::string &module_name,
         throw runtime_error("VTableFile object was not finalized.");
     }
 
-    if(_module_vtables_map.at(module_name)->find(addr)
-            != _module_vtables_map.at(module_name)->cend()) {
+    return find_vtable(get_module_id(module_name), addr);
+}
+
+const VTable* VTableFile::get_vtable_ptr(VTableModuleId module_id,
+                                        uint64_t addr) const {
 
-        return (_module_vtables_map.at(module_name)->at(addr));
+    // Make sure that the object is finalized.
+    if(!_is_finalized) {
+        throw runtime_error("VTableFile object was not finalized.");
+    }
+
+    check_module_id(module_id);
+    return find_vtable(module_id, addr);
+}
+
+const VTableEntryPositions* VTableFile::get_entry_positions(
+                                                    const string &module_name,
+                                                    uint64_t func_addr) const {
+
+    // Make sure that the object is finalized.
+    if(!_is_finalized) {
+        throw runtime_error("VTableFile object was not finalized.");
+    }
+
+    return get_entry_positions(get_module_id(module_name), func_addr);
+}
+
+const VTableEntryPositions* VTableFile::get_entry_positions(
+                                                    VTableModuleId module_id,
+                                                    uint64_t func_addr) const {
+
+    // Make sure that the object is finalized.
+    if(!_is_finalized) {
+        throw runtime_error("VTableFile object was not finalized.");
+    }
+
+    check_module_id(module_id);
+    const VTableModuleIndex &module_index = _module_indexes[module_id];
+    const auto it = module_index.entry_positions.find(func_addr);
+    if(it == module_index.entry_positions.cend()) {
+        return nullptr;
     }
-    return nullptr;
+    return &it->second;
 }
 
 const VTable& VTableFile::get_vtable(const std::string &module_name,
                                      uint64_t addr) const {
+    return get_vtable(get_module_id(module_name), addr);
+}
+
+const VTable& VTableFile::get_vtable(VTableModuleId module_id,
+                                     uint64_t addr) const {
 
     // Make sure that the object is finalized.
     if(!_is_finalized) {
         throw runtime_error("VTableFile object was not finalized.");
     }
 
-    return *(_module_vtables_map.at(module_name)->at(addr));
-
+    check_module_id(module_id);
+    const VTable *vtable = find_vtable(module_id, addr);
+    if(vtable == nullptr) {
+        throw runtime_error("VTableFile object does not know vtable.");
+    }
+    return *vtable;
 }
 
 const VTable& VTableFile::get_vtable(uint32_t index) const {
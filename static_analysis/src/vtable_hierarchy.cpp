@@ -7,6 +7,8 @@
 #include <sstream>
 
 #include "vtable_hierarchy.h"
+#include "instrumentation.h"
+#include "tracepoints.h"
 
 using namespace std;
 
@@ -26,6 +28,8 @@ VTableHierarchies::VTableHierarchies(const FileFormatType file_format,
       _funcs_blacklist(funcs_blacklist),
       _thread_id(thread_id) {
 
+    _snapshot = make_shared<HierarchiesSnapshot>();
+
     // Make sure that the object is initialized.
     if(!_vtable_file.is_finalized()) {
         throw runtime_error("VTable file object was not finalized.");
@@ -38,115 +42,142 @@ VTableHierarchies::VTableHierarchies(const FileFormatType file_format,
 }
 
 
-// Adds both vtables to the hierarchy. Returns "true" if it is added
-// to an existing hierarchy (does not merge hierarchies that could be
-// dependent after that) and "false" if it creates a new hierarchy.
-bool VTableHierarchies::add_to_hierarchy(uint32_t vtable_1_idx,
-                                         uint32_t vtable_2_idx) {
+// Adds the vtable as its own hierarchy if it is not yet part of one.
+void VTableHierarchies::add_vtable(uint32_t vtable_idx) {
+    if(vtable_idx >= _parents.size()) {
+        _parents.resize(vtable_idx + 1, NO_HIERARCHY);
+        _ranks.resize(vtable_idx + 1, 0);
+    }
+    if(_parents[vtable_idx] == NO_HIERARCHY) {
+        _parents[vtable_idx] = vtable_idx;
+        _is_merged = false;
+    }
+}
 
-    // Insert dependency into vtables hierarchy result.
-    bool is_inserted = false;
-    for(auto &hierarchy_it : _hierarchies) {
-        if(hierarchy_it.find(vtable_1_idx) != hierarchy_it.cend()
-            || hierarchy_it.find(vtable_2_idx) != hierarchy_it.cend()) {
 
-            hierarchy_it.insert(vtable_1_idx);
-            hierarchy_it.insert(vtable_2_idx);
-            is_inserted = true;
-            break;
-        }
+// Returns the representative of the hierarchy the vtable belongs to
+// (the vtable has to be part of a hierarchy).
+uint32_t VTableHierarchies::find_root(uint32_t vtable_idx) {
+    uint32_t root = vtable_idx;
+    while(_parents[root] != root) {
+        root = _parents[root];
     }
-    if(!is_inserted) {
 
-        DependentVTables new_hierarchy;
-        new_hierarchy.insert(vtable_2_idx);
-        new_hierarchy.insert(vtable_1_idx);
-        _hierarchies.push_back(new_hierarchy);
+    // Path compression.
+    while(_parents[vtable_idx] != root) {
+        uint32_t next = _parents[vtable_idx];
+        _parents[vtable_idx] = root;
+        vtable_idx = next;
     }
 
+    return root;
+}
+
+
+// Unites the hierarchies of both vtables. Returns "true" if they were
+// in different hierarchies before.
+bool VTableHierarchies::unite(uint32_t vtable_1_idx, uint32_t vtable_2_idx) {
+    uint32_t root_1 = find_root(vtable_1_idx);
+    uint32_t root_2 = find_root(vtable_2_idx);
+    if(root_1 == root_2) {
+        return false;
+    }
+
+#if DEBUG_WRITE_HIERARCHY_STEPS
+    const auto debug_temp_1 = _vtable_file.get_vtable(vtable_1_idx);
+    const auto debug_temp_2 = _vtable_file.get_vtable(vtable_2_idx);
+    hierarchy_steps_file << "\nMerging hierarchy of "
+                         << debug_temp_1.module_name
+                         << " - 0x"
+                         << hex << debug_temp_1.addr
+                         << " with hierarchy of "
+                         << debug_temp_2.module_name
+                         << " - 0x"
+                         << hex << debug_temp_2.addr
+                         << "\n";
+#endif
+
+    // Union by rank.
+    if(_ranks[root_1] < _ranks[root_2]) {
+        swap(root_1, root_2);
+    }
+    _parents[root_2] = root_1;
+    if(_ranks[root_1] == _ranks[root_2]) {
+        _ranks[root_1]++;
+    }
+
+    _is_merged = false;
+    return true;
+}
+
+
+// Adds both vtables to the hierarchy. Returns "true" if it is added
+// to an existing hierarchy and "false" if it creates a new hierarchy.
+bool VTableHierarchies::add_to_hierarchy(uint32_t vtable_1_idx,
+                                         uint32_t vtable_2_idx) {
+
+    bool is_inserted = vtable_1_idx < _parents.size()
+                       && _parents[vtable_1_idx] != NO_HIERARCHY;
+    is_inserted |= vtable_2_idx < _parents.size()
+                   && _parents[vtable_2_idx] != NO_HIERARCHY;
+
+    add_vtable(vtable_1_idx);
+    add_vtable(vtable_2_idx);
+    unite(vtable_1_idx, vtable_2_idx);
+
     return is_inserted;
 }
 
 
-// Merges all sets that have at least one element in common until
-// there is no merging possible anymore.
+// Rebuilds the hierarchy sets from the disjoint-set forest.
 void VTableHierarchies::merge_hierarchies() {
     merge_hierarchies_priv();
 }
 
 
-// Merges all sets that have at least one element in common until
-// there is no merging possible anymore.
+// Rebuilds the hierarchy sets from the disjoint-set forest and publishes
+// them as new snapshot. Dependencies are already merged when they are added,
+// hence this is only needed for the set representation.
 void VTableHierarchies::merge_hierarchies_priv() {
 
-    for(auto hier_it = _hierarchies.begin(); hier_it != _hierarchies.end();) {
-
-        // Iterate over the _remaining_ sets in the vector.
-        bool is_merged = false;
-        for(auto search_it = hier_it+1;
-            search_it != _hierarchies.end();
-            ++search_it) {
-
-            // Check if element in source set is also in destination set
-            // => if it is then merge source set into destination set.
-            for(auto vtable_it : *hier_it) {
-                if(search_it->find(vtable_it) != search_it->end()) {
+    if(_is_merged) {
+        return;
+    }
 
-#if DEBUG_WRITE_HIERARCHY_STEPS
-                    hierarchy_steps_file << "\nMerging hierarchy:" << "\n";
-                    for(auto it : *hier_it) {
-                        const auto debug_temp = _vtable_file.get_vtable(it);
-                        hierarchy_steps_file << debug_temp.module_name
-                             << " - 0x"
-                             << hex << debug_temp.addr
-                             << "\n";
-                    }
-                    hierarchy_steps_file << "\nwith hierarchy: " << "\n";
-                    for(auto it : *search_it) {
-                        const auto debug_temp = _vtable_file.get_vtable(it);
-                        hierarchy_steps_file << debug_temp.module_name
-                             << " - 0x"
-                             << hex << debug_temp.addr
-                             << "\n";
-                    }
-#endif
+    MARX_TRACE1(hierarchy__merge__begin, _parents.size());
 
-                    is_merged = true;
-                    search_it->insert(hier_it->begin(), hier_it->end());
+    auto snapshot = make_shared<HierarchiesSnapshot>();
+    HierarchiesVTable &hierarchies = snapshot->hierarchies;
+    vector<uint32_t> &hierarchy_idxs = snapshot->hierarchy_idxs;
+    hierarchy_idxs.assign(_parents.size(), NO_HIERARCHY);
 
-#if DEBUG_WRITE_HIERARCHY_STEPS
-                    hierarchy_steps_file << "\nNew hierarchy: " << "\n";
-                    for(auto it : *search_it) {
-                        const auto debug_temp = _vtable_file.get_vtable(it);
-                        hierarchy_steps_file << debug_temp.module_name
-                             << " - 0x"
-                             << hex << debug_temp.addr
-                             << "\n";
-                    }
-                    hierarchy_steps_file << "\n###############################"
-                                         << "#################################"
-                                         << "\n";
-#endif
-                    break;
-                }
-            }
-            if(is_merged) {
-                break;
-            }
+    // Process vtables in index order which keeps the order of the
+    // hierarchies deterministic.
+    for(uint32_t idx = 0; idx < _parents.size(); idx++) {
+        if(_parents[idx] == NO_HIERARCHY) {
+            continue;
         }
 
-        // Remove source set if it was merged into destination set.
-        if(is_merged) {
-            hier_it = _hierarchies.erase(hier_it);
-        }
-        else {
-            ++hier_it;
+        uint32_t root = find_root(idx);
+        if(hierarchy_idxs[root] == NO_HIERARCHY) {
+            hierarchy_idxs[root] = hierarchies.size();
+            hierarchies.emplace_back();
         }
+        hierarchy_idxs[idx] = hierarchy_idxs[root];
+
+        // Indices are processed in ascending order which makes the
+        // insertion at the end of the set constant time.
+        DependentVTables &hierarchy = hierarchies[hierarchy_idxs[idx]];
+        hierarchy.insert(hierarchy.end(), idx);
     }
 
+    MARX_TRACE2(hierarchy__merge__end, _parents.size(), hierarchies.size());
+    atomic_store(&_snapshot, HierarchiesSnapshotPtr(move(snapshot)));
+    _is_merged = true;
+
 #if DEBUG_SEARCH_MERGING_REASON
     // Search the moment two vtables are put together into the same hierarchy.
-    for(const auto hier_it : _hierarchies) {
+    for(const auto hier_it : hierarchies) {
         bool first = false;
         bool second = false;
         for(const auto vtable_it : hier_it) {
@@ -330,7 +361,29 @@ bool VTableHierarchies::extract_vtable_dependencies(
 
 
 const HierarchiesVTable &VTableHierarchies::get_hierarchies() const {
-    return _hierarchies;
+    return get_snapshot()->hierarchies;
+}
+
+
+size_t VTableHierarchies::get_memory_footprint() const {
+    size_t bytes = footprint_vector(_parents) + footprint_vector(_ranks);
+
+    const HierarchiesSnapshotPtr snapshot = get_snapshot();
+    if(snapshot) {
+        bytes += sizeof(HierarchiesSnapshot)
+                 + footprint_vector(snapshot->hierarchies)
+                 + footprint_vector(snapshot->hierarchy_idxs);
+        for(const DependentVTables &hierarchy : snapshot->hierarchies) {
+            bytes += footprint_tree(hierarchy);
+        }
+    }
+    return bytes;
+}
+
+
+const DependentVTables *VTableHierarchies::get_hierarchy(
+                                                uint32_t vtable_idx) const {
+    return get_snapshot()->get_hierarchy(vtable_idx);
 }
 
 
@@ -340,9 +393,8 @@ void VTableHierarchies::update_hierarchy_priv(uint32_t vtable_1_idx,
                                               uint32_t vtable_2_idx,
                                               bool merge_hierarchy) {
 
-    // When vtables were added to an existing hierarchy, it can happen
-    // that two hierarchies can be merged to one.
-    if(add_to_hierarchy(vtable_1_idx, vtable_2_idx) && merge_hierarchy) {
+    add_to_hierarchy(vtable_1_idx, vtable_2_idx);
+    if(merge_hierarchy) {
         merge_hierarchies_priv();
     }
 }
@@ -362,8 +414,7 @@ void VTableHierarchies::update_hierarchy(
                                     const HierarchiesVTable& vtable_hierarchies,
                                     bool merge_hierarchy) {
     for(const DependentVTables& it : vtable_hierarchies) {
-        DependentVTables copy = it;
-        _hierarchies.push_back(copy);
+        add_hierarchy(it);
     }
     if(merge_hierarchy) {
         merge_hierarchies_priv();
@@ -371,6 +422,42 @@ void VTableHierarchies::update_hierarchy(
 }
 
 
+// Unites all vtables of each group and merges the hierarchies once.
+void VTableHierarchies::update_hierarchy_batch(
+                                           const VTableGroups &vtable_groups) {
+
+    // Grow the forest once for all groups.
+    uint32_t max_idx = 0;
+    bool is_empty = true;
+    for(const auto &group : vtable_groups) {
+        for(uint32_t vtable_idx : group) {
+            max_idx = max(max_idx, vtable_idx);
+            is_empty = false;
+        }
+    }
+    if(is_empty) {
+        return;
+    }
+    if(max_idx >= _parents.size()) {
+        _parents.resize(max_idx + 1, NO_HIERARCHY);
+        _ranks.resize(max_idx + 1, 0);
+    }
+
+    for(const auto &group : vtable_groups) {
+        if(group.empty()) {
+            continue;
+        }
+        uint32_t first_idx = group.front();
+        for(uint32_t vtable_idx : group) {
+            add_vtable(vtable_idx);
+            unite(first_idx, vtable_idx);
+        }
+    }
+
+    merge_hierarchies_priv();
+}
+
+
 // Updates the current hierarchy structure with the found vtable updates
 // and the information given by the module and function that was analyzed.
 void VTableHierarchies::update_hierarchy(const VTableUpdates &vtable_updates,
@@ -412,10 +499,7 @@ void VTableHierarchies::update_hierarchy(const VTableUpdates &vtable_updates,
             vtable_update.offset = 0;
             vtable_update.base = this_ptr;
 
-            const VTable &vtable = _vtable_file.get_vtable(
-                                        vtbl_kv.second->module_name,
-                                        vtbl_kv.first);
-            vtable_update.index = vtable.index;
+            vtable_update.index = vtbl_kv.second->index;
 
             // Divide vtable updates considering the position of the function
             // inside the vtable (consider vtables that have this function at
@@ -474,7 +558,8 @@ void VTableHierarchies::update_hierarchy(const VTableUpdates &vtable_updates,
 
 
 // Exports local hierarchy data structure to a file.
-void VTableHierarchies::export_hierarchy(const string &target_dir) {
+void VTableHierarchies::export_hierarchy(const string &target_dir,
+                                         bool use_companion) {
 
     stringstream temp_str;
     temp_str << target_dir << "/" << _module_name << ".hierarchy";
@@ -485,7 +570,8 @@ void VTableHierarchies::export_hierarchy(const string &target_dir) {
 
     hier_file << _module_name << "\n";
 
-    for(const auto &hier_it : _hierarchies) {
+    const HierarchiesSnapshotPtr snapshot = get_snapshot();
+    for(const auto &hier_it : snapshot->hierarchies) {
         for(const auto &vtable_idx : hier_it) {
             const auto &temp = _vtable_file.get_vtable(vtable_idx);
             hier_file << temp.module_name
@@ -496,11 +582,169 @@ void VTableHierarchies::export_hierarchy(const string &target_dir) {
         hier_file << "\n";
     }
     hier_file.close();
+
+    if(use_companion) {
+        const uint64_t source_hash = hash_file(target_file);
+        if(!source_hash
+           || !export_companion(target_file + ".marx_bin",
+                                source_hash,
+                                _module_name,
+                                snapshot->hierarchies)) {
+            cerr << "Not able to write companion file '"
+                 << target_file
+                 << ".marx_bin'."
+                 << "\n";
+        }
+    }
+}
+
+
+// Adds all vtables of the given hierarchy to one hierarchy.
+void VTableHierarchies::add_hierarchy(const DependentVTables &hierarchy) {
+    if(hierarchy.empty()) {
+        return;
+    }
+    uint32_t first_idx = *hierarchy.cbegin();
+    for(uint32_t vtable_idx : hierarchy) {
+        add_vtable(vtable_idx);
+        unite(first_idx, vtable_idx);
+    }
+}
+
+
+// Reads the hierarchies of a companion file.
+bool VTableHierarchies::import_companion(const string &companion_file,
+                                         uint64_t source_hash,
+                                         HierarchiesVTable &hierarchies) const {
+
+    CompanionFileReader reader(companion_file);
+    if(!reader.is_valid(CompanionFileHierarchy, source_hash)) {
+        return false;
+    }
+
+    string import_module_name;
+    uint64_t num_modules;
+    if(!reader.read_string(import_module_name)
+       || !reader.read(num_modules)) {
+        return false;
+    }
+
+    // Resolve the module names of the file once to module handles.
+    vector<VTableModuleId> module_ids(num_modules);
+    for(uint64_t i = 0; i < num_modules; i++) {
+        string module_name;
+        if(!reader.read_string(module_name)) {
+            return false;
+        }
+        module_ids[i] = _vtable_file.get_module_id(module_name);
+    }
+
+    uint64_t num_hierarchies;
+    if(!reader.read(num_hierarchies)) {
+        return false;
+    }
+    hierarchies.resize(num_hierarchies);
+    for(uint64_t i = 0; i < num_hierarchies; i++) {
+
+        // Each entry is stored as module id followed by vtable address.
+        const uint64_t *values;
+        uint64_t count;
+        if(!reader.read_array(values, count) || count % 2) {
+            return false;
+        }
+        for(uint64_t j = 0; j < count; j += 2) {
+            if(values[j] >= num_modules) {
+                return false;
+            }
+            const VTable &vtable = _vtable_file.get_vtable(
+                                                      module_ids[values[j]],
+                                                      values[j + 1]);
+            hierarchies[i].insert(vtable.index);
+        }
+    }
+
+    return true;
+}
+
+
+// Writes the given hierarchies into a companion file.
+bool VTableHierarchies::export_companion(
+                                const string &companion_file,
+                                uint64_t source_hash,
+                                const string &module_name,
+                                const HierarchiesVTable &hierarchies) const {
+
+    // Map the module handles of all vtables to ids local to the file.
+    vector<uint64_t> module_ids(_vtable_file.get_num_modules(), UINT64_MAX);
+    vector<const string*> module_names;
+    for(const DependentVTables &hierarchy : hierarchies) {
+        for(uint32_t vtable_idx : hierarchy) {
+            const VTable &vtable = _vtable_file.get_vtable(vtable_idx);
+            if(module_ids[vtable.module_id] == UINT64_MAX) {
+                module_ids[vtable.module_id] = module_names.size();
+                module_names.push_back(&vtable.module_name);
+            }
+        }
+    }
+
+    CompanionFileWriter writer(companion_file,
+                               CompanionFileHierarchy,
+                               source_hash);
+    writer.write_string(module_name);
+    writer.write(module_names.size());
+    for(const string *vtbl_module_name : module_names) {
+        writer.write_string(*vtbl_module_name);
+    }
+
+    writer.write(hierarchies.size());
+    vector<uint64_t> values;
+    for(const DependentVTables &hierarchy : hierarchies) {
+        values.clear();
+        for(uint32_t vtable_idx : hierarchy) {
+            const VTable &vtable = _vtable_file.get_vtable(vtable_idx);
+            values.push_back(module_ids[vtable.module_id]);
+            values.push_back(vtable.addr);
+        }
+        writer.write_array(values.data(), values.size());
+    }
+    return writer.finish();
 }
 
 
 // Imports hierarchy files and adds them to the local hierarchy data structure.
-void VTableHierarchies::import_hierarchy(const string &target_file) {
+void VTableHierarchies::import_hierarchy(const string &target_file,
+                                         bool use_companion) {
+
+    HierarchiesVTable hierarchies;
+    if(!read_hierarchy(target_file, use_companion, hierarchies)) {
+        return;
+    }
+
+    for(const DependentVTables &hierarchy : hierarchies) {
+        add_hierarchy(hierarchy);
+    }
+
+    // Optimize hierarchies in case they were not optimal before.
+    merge_hierarchies_priv();
+}
+
+
+// Reads the hierarchies of a hierarchy file.
+bool VTableHierarchies::read_hierarchy(const string &target_file,
+                                       bool use_companion,
+                                       HierarchiesVTable &hierarchies) const {
+
+    const string companion_file = target_file + ".hierarchy.marx_bin";
+    uint64_t source_hash = 0;
+    if(use_companion) {
+        source_hash = hash_file(target_file + ".hierarchy");
+        if(source_hash
+           && MappedFile::exists(companion_file)
+           && import_companion(companion_file, source_hash, hierarchies)) {
+            return true;
+        }
+        hierarchies.clear();
+    }
 
     ifstream file(target_file + ".hierarchy");
     if(!file) {
@@ -508,7 +752,7 @@ void VTableHierarchies::import_hierarchy(const string &target_file) {
              << target_file
              << ".hierarchy' does not exist. Skipping import."
              << "\n";
-        return;
+        return false;
     }
 
     string line;
@@ -559,11 +803,21 @@ void VTableHierarchies::import_hierarchy(const string &target_file) {
             new_hierarchy.insert(vtable.index);
         }
 
-        _hierarchies.push_back(new_hierarchy);
+        hierarchies.push_back(new_hierarchy);
     }
 
-    // Optimize hierarchies in case they were not optimal before.
-    merge_hierarchies_priv();
+    if(source_hash
+       && !export_companion(companion_file,
+                            source_hash,
+                            import_module_name,
+                            hierarchies)) {
+        cerr << "Not able to write companion file '"
+             << companion_file
+             << "'."
+             << "\n";
+    }
+
+    return true;
 }
 
 
@@ -590,55 +844,49 @@ void VTableHierarchies::entry_heuristic_inter() {
             }
 
             const ExternalFunction *ext_func =
-                    _external_funcs.get_external_function(plt_entry->func_name);
+               _external_funcs.get_external_function_by_id(plt_entry->name_id);
             if(ext_func == nullptr) {
                 continue;
             }
 
             // Check all vtables of the external module if they have the same
             // function at the same position.
-            const VTableMap& ext_vtables = _vtable_file.get_vtables(
-                                                ext_func->module_name);
-
-            for(const auto &ext_vtbl_kv : ext_vtables) {
-
-                const auto ext_pos_it = find(ext_vtbl_kv.second->entries.begin(),
-                                         ext_vtbl_kv.second->entries.end(),
-                                         ext_func->addr);
-                if(ext_pos_it != ext_vtbl_kv.second->entries.end()) {
-                    int pos_ext_func = distance(ext_vtbl_kv.second->entries.begin(),
-                                                ext_pos_it);
+            const VTableEntryPositions *ext_positions =
+                             _vtable_file.get_entry_positions(
+                                                      ext_func->module_name,
+                                                      ext_func->addr);
+            if(ext_positions != nullptr) {
+                for(const VTableEntryPosition &ext_pos : *ext_positions) {
 
 #if DEBUG_PRINT_DEPENDENCIES
+                    const VTable &ext_vtbl = _vtable_file.get_vtable(
+                                                             ext_pos.vtbl_idx);
                     cout << "VTable: "
                          << vtbl_kv.second->module_name
                          << ":"
                          << hex << vtbl_kv.second->addr
                          << "\n";
 
-                    cout << ext_vtbl_kv.second->module_name
+                    cout << ext_vtbl.module_name
                          << ":"
-                         << hex << ext_vtbl_kv.second->addr
+                         << hex << ext_vtbl.addr
                          << " - "
                          << ext_func->name
                          << " ("
                          << hex << ext_func->addr
                          << ") - pos: "
-                         << dec << pos_ext_func
+                         << dec << ext_pos.pos
                          << "\n";
 #endif
 
                     // If both entries are at the same position in the
                     // corresponding VTable, consider them as dependent.
-                    if(pos == pos_ext_func) {
+                    if(pos == static_cast<int>(ext_pos.pos)) {
                         update_hierarchy_priv(vtbl_kv.second->index,
-                                              ext_vtbl_kv.second->index,
-                                              true);
+                                              ext_pos.vtbl_idx,
+                                              false);
                     }
                 }
-                else {
-                    continue;
-                }
             }
             pos++;
         }
@@ -653,20 +901,15 @@ void VTableHierarchies::entry_heuristic_inter() {
 void VTableHierarchies::vcall_analysis(const VCalls &vcalls) {
 
     // Add all vtables as dependent that are used in the same vcall.
+    VTableGroups vtable_groups;
+    vtable_groups.reserve(vcalls.size());
     for(const auto &vcall : vcalls) {
-        bool first = true;
-        uint32_t ref_idx;
-        for(uint32_t idx : vcall.vtbl_idxs) {
-            if(first) {
-                first = false;
-                ref_idx = idx;
-                continue;
-            }
-            update_hierarchy_priv(ref_idx, idx, false);
+        if(vcall.vtbl_idxs.size() < 2) {
+            continue;
         }
+        vtable_groups.emplace_back(vcall.vtbl_idxs.cbegin(),
+                                   vcall.vtbl_idxs.cend());
     }
 
-    // Since we do not merge the hierachies after each update, we have to do
-    // it manually at the end.
-    merge_hierarchies_priv();
+    update_hierarchy_batch(vtable_groups);
 }
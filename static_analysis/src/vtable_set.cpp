@@ -0,0 +1,90 @@
+#include "vtable_set.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+
+VTableSetStore::VTableSetStore(const VTableFile &vtable_file,
+                               const VTableHierarchies &vtable_hierarchies) {
+
+    const size_t num_vtables = vtable_file.get_all_vtables().size();
+    _positions.assign(num_vtables, NO_HIERARCHY);
+    _vtable_idxs.reserve(num_vtables);
+
+    for(const DependentVTables &hierarchy :
+        vtable_hierarchies.get_hierarchies()) {
+        for(uint32_t vtable_idx : hierarchy) {
+            if(vtable_idx < num_vtables
+               && _positions[vtable_idx] == NO_HIERARCHY) {
+                _positions[vtable_idx] = _vtable_idxs.size();
+                _vtable_idxs.push_back(vtable_idx);
+            }
+        }
+    }
+    for(uint32_t vtable_idx = 0; vtable_idx < num_vtables; vtable_idx++) {
+        if(_positions[vtable_idx] == NO_HIERARCHY) {
+            _positions[vtable_idx] = _vtable_idxs.size();
+            _vtable_idxs.push_back(vtable_idx);
+        }
+    }
+}
+
+
+VTableSetId VTableSetStore::intern(const unordered_set<uint32_t> &vtable_idxs) {
+
+    vector<uint32_t> positions;
+    positions.reserve(vtable_idxs.size());
+    for(uint32_t vtable_idx : vtable_idxs) {
+        if(vtable_idx >= _positions.size()) {
+            throw runtime_error("Vtable index exceeds known vtables.");
+        }
+        positions.push_back(_positions[vtable_idx]);
+    }
+    sort(positions.begin(), positions.end());
+
+    VTableRanges ranges;
+    for(uint32_t pos : positions) {
+        if(!ranges.empty() && ranges.back().last + 1 == pos) {
+            ranges.back().last = pos;
+        }
+        else {
+            VTableRange range;
+            range.first = pos;
+            range.last = pos;
+            ranges.push_back(range);
+        }
+    }
+
+    const auto result = _set_ids.emplace(move(ranges), _sets.size());
+    if(result.second) {
+        _sets.push_back(&result.first->first);
+    }
+    return result.first->second;
+}
+
+
+const VTableRanges &VTableSetStore::get_ranges(VTableSetId set_id) const {
+    return *_sets.at(set_id);
+}
+
+
+bool VTableSetStore::contains(VTableSetId set_id, uint32_t vtable_idx) const {
+    if(vtable_idx >= _positions.size()) {
+        return false;
+    }
+    const uint32_t pos = _positions[vtable_idx];
+    const VTableRanges &ranges = get_ranges(set_id);
+
+    // First range starting behind the position.
+    VTableRange key;
+    key.first = pos;
+    key.last = UINT32_MAX;
+    auto it = upper_bound(ranges.cbegin(), ranges.cend(), key);
+    if(it == ranges.cbegin()) {
+        return false;
+    }
+    --it;
+    return pos <= it->last;
+}
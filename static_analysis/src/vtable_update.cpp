@@ -1,11 +1,16 @@
 
 #include "vtable_update.h"
+#include "serialization.h"
 
+#include <cstring>
 
 using namespace std;
 
 #define DEBUG_PRINT_UPDATES 0
 
+#define VTABLE_UPDATES_FILE_MAGIC "MARXVUPD"
+#define VTABLE_UPDATES_FILE_VERSION 1
+
 FctVTableUpdates::FctVTableUpdates(VTableFile &vtable_file,
                                    const string &module_name)
     : _vtable_file(vtable_file),
@@ -37,21 +42,28 @@ void FctVTableUpdates::export_vtable_updates(const string &target_dir) {
     string target_file = temp_str.str();
 
     ofstream update_file;
-    update_file.open(target_file);
-
-    update_file << _module_name << "\n";
+    update_file.open(target_file, ios::out|ios::binary);
+
+    // The file is given in the following form (all base expressions share
+    // one table of sub-expressions):
+    // <magic> <version> <module_name>
+    // (<fct_addr> <number> (<module_name> <vtable_addr> <base> <offset>)*)*
+    uint32_t version = VTABLE_UPDATES_FILE_VERSION;
+    update_file.write(VTABLE_UPDATES_FILE_MAGIC, 8);
+    update_file.write(reinterpret_cast<const char *>(&version),
+                      sizeof(version));
+    update_file.write(_module_name.c_str(), _module_name.length() + 1);
+    SharedExpressionWriter writer(update_file);
 
     for(const auto &it : _this_vtable_updates) {
         uint64_t fct_addr = it.first;
 
-        // Get all vtable updates that can be exported.
+        // Get all vtable updates that can be exported (only updates of
+        // System V argument registers are meaningful for the callers).
         VTableUpdates exportable_vtable_updates;
         for(const auto &vtable_update : it.second) {
-
-            // Convert base expression ptr to string for export.
-            ExpressionPtr base = vtable_update.base;
             string base_str;
-            if(!convert_expression_str(base, base_str)) {
+            if(!convert_expression_str(vtable_update.base, base_str)) {
                 continue;
             }
             exportable_vtable_updates.push_back(vtable_update);
@@ -62,44 +74,37 @@ void FctVTableUpdates::export_vtable_updates(const string &target_dir) {
             continue;
         }
 
-        update_file << hex << fct_addr
-                    << " ";
+        uint32_t number = exportable_vtable_updates.size();
+        update_file.write(reinterpret_cast<const char *>(&fct_addr),
+                          sizeof(fct_addr));
+        update_file.write(reinterpret_cast<const char *>(&number),
+                          sizeof(number));
 
         // Export all vtable updates for this function.
         for(const auto &vtable_update : exportable_vtable_updates) {
 
-            // Convert base expression ptr to string for export.
-            ExpressionPtr base = vtable_update.base;
-            string base_str;
-            if(!convert_expression_str(base, base_str)) {
-                throw runtime_error("Not able to convert vtable update base"\
-                                    "to string.");
-            }
-
             const VTable &vtable = _vtable_file.get_vtable(vtable_update.index);
             uint64_t vtable_addr = vtable.addr;
-            const string module_name = vtable.module_name;
-            size_t offset = vtable_update.offset;
-
-            update_file << module_name
-                        << ":"
-                        << hex << vtable_addr
-                        << ":"
-                        << base_str
-                        << ":"
-                        << dec << offset
-                        << " ";
+            uint64_t offset = vtable_update.offset;
+
+            // Length + 1 to have \0 at the end.
+            update_file.write(vtable.module_name.c_str(),
+                              vtable.module_name.length() + 1);
+            update_file.write(reinterpret_cast<const char *>(&vtable_addr),
+                              sizeof(vtable_addr));
+            writer.write(vtable_update.base);
+            update_file.write(reinterpret_cast<const char *>(&offset),
+                              sizeof(offset));
 
 #if DEBUG_PRINT_UPDATES
             cout << "Fct Addr: 0x" << hex << fct_addr << "\n";
-            cout << "Module Name: " << module_name << "\n";
+            cout << "Module Name: " << vtable.module_name << "\n";
             cout << "VTable Addr: 0x" << hex << vtable_addr << "\n";
-            cout << "Base: " << base_str << "\n";
+            cout << "Base: " << *vtable_update.base << "\n";
             cout << "Offset: 0x" << hex << offset << "\n";
 #endif
 
         }
-        update_file << "\n";
     }
     update_file.close();
 }
@@ -139,7 +144,7 @@ bool FctVTableUpdates::convert_expression_str(ExpressionPtr base,
 // Convert string to expression (only consider System V argument register
 // for now).
 bool FctVTableUpdates::convert_str_expression(const string &base_str,
-                                              ExpressionPtr &base) {
+                                              ExpressionPtr &base) const {
 
     if("RDI" == base_str) {
         base = _rdi;
@@ -198,14 +203,98 @@ const VTableUpdates* FctVTableUpdates::get_vtable_updates(
 
 
 void FctVTableUpdates::import_updates(const string &target_file) {
-    lock_guard<mutex> _(_mtx);
 
-    ifstream file(target_file + ".vtableupdates");
+    // The file is parsed without holding the lock, hence multiple modules
+    // can be imported concurrently.
+    ifstream file(target_file + ".vtableupdates", ios::in|ios::binary);
     if(!file) {
         throw runtime_error("Opening vtable update file failed.");
     }
 
     VTableUpdatesMap vtable_updates_map;
+    string import_module_name;
+
+    // Files without the magic are given in the text format of earlier
+    // versions.
+    char magic[8] = {0};
+    file.read(magic, sizeof(magic));
+    if(file && memcmp(magic, VTABLE_UPDATES_FILE_MAGIC, 8) == 0) {
+        read_updates(file, import_module_name, vtable_updates_map);
+    }
+    else {
+        file.clear();
+        file.seekg(0);
+        read_updates_text(file, import_module_name, vtable_updates_map);
+    }
+
+    lock_guard<mutex> _(_mtx);
+    _external_vtable_updates[import_module_name] = move(vtable_updates_map);
+}
+
+
+void FctVTableUpdates::read_updates(istream &file,
+                                    string &import_module_name,
+                                    VTableUpdatesMap &vtable_updates_map) const {
+
+    uint32_t version = 0;
+    file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    if(version != VTABLE_UPDATES_FILE_VERSION) {
+        throw runtime_error("Unsupported vtable update file version.");
+    }
+
+    // First entry of file is always the module name.
+    getline(file, import_module_name, '\0');
+    if(file.fail()) {
+        throw runtime_error("Parsing vtable update file failed.");
+    }
+
+    SharedExpressionReader reader(file);
+    while(true) {
+        uint64_t fct_addr;
+        uint32_t number;
+        file.read(reinterpret_cast<char *>(&fct_addr), sizeof(fct_addr));
+
+        // EOF is only present after first read instruction that does
+        // reach it.
+        if(file.eof()) {
+            break;
+        }
+        file.read(reinterpret_cast<char *>(&number), sizeof(number));
+
+        VTableUpdates &imported_updates = vtable_updates_map[fct_addr];
+        for(uint32_t i = 0; i < number; i++) {
+            string module_name;
+            uint64_t vtable_addr;
+            uint64_t offset;
+
+            getline(file, module_name, '\0');
+            file.read(reinterpret_cast<char *>(&vtable_addr),
+                      sizeof(vtable_addr));
+            ExpressionPtr base = reader.read();
+            file.read(reinterpret_cast<char *>(&offset), sizeof(offset));
+            if(file.fail()) {
+                throw runtime_error("Parsing vtable update file failed.");
+            }
+
+            // Convert read data into the local data structure.
+            const VTable &vtable = _vtable_file.get_vtable(module_name,
+                                                           vtable_addr);
+
+            VTableUpdate vtable_update;
+            vtable_update.index = vtable.index;
+            vtable_update.offset = offset;
+            vtable_update.base = base;
+            imported_updates.push_back(vtable_update);
+        }
+    }
+}
+
+
+void FctVTableUpdates::read_updates_text(
+                                 istream &file,
+                                 string &import_module_name,
+                                 VTableUpdatesMap &vtable_updates_map) const {
+
     string line;
 
     // Parse first line manually.
@@ -213,7 +302,6 @@ void FctVTableUpdates::import_updates(const string &target_file) {
     istringstream header_parser(line);
 
     // First entry of file is always the module name.
-    string import_module_name;
     header_parser >> import_module_name;
     if(header_parser.fail()) {
         throw runtime_error("Parsing vtable update file failed.");
@@ -284,6 +372,4 @@ void FctVTableUpdates::import_updates(const string &target_file) {
         }
         vtable_updates_map[fct_addr] = imported_updates;
     }
-
-    _external_vtable_updates[import_module_name] = vtable_updates_map;
 }
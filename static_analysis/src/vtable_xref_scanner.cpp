@@ -0,0 +1,365 @@
+#include "vtable_xref_scanner.h"
+#include "translator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+struct XrefHit {
+    uint64_t xref_addr;
+    uint32_t addr_idx;
+};
+
+/*!
+ * \brief The segment and the addresses to look for (shared by all chunks).
+ *
+ * A window is only decoded if the RIP-relative or the absolute target lies
+ * in `[low, low + span]` modulo 2^32 (which holds for all targets that
+ * are in `[addrs.front(), addrs.back()]`).
+ */
+struct XrefScanContext {
+    const uint8_t *code;
+    size_t size;
+    uint64_t base;
+    const vector<uint64_t> &addrs;
+
+    bool use_filter;
+    bool check_abs;
+    uint32_t rip_low; // Lowest target relative to `base`.
+    uint32_t abs_low;
+    uint32_t span;
+};
+
+static uint32_t read_window(const uint8_t *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static bool find_addr(const vector<uint64_t> &addrs,
+                      uint64_t addr,
+                      uint32_t &idx) {
+    const auto it = lower_bound(addrs.cbegin(), addrs.cend(), addr);
+    if(it == addrs.cend() || *it != addr) {
+        return false;
+    }
+    idx = static_cast<uint32_t>(it - addrs.cbegin());
+    return true;
+}
+
+// lea r, [rip+disp32] ([REX] 8D modrm) with the displacement at `pos`.
+static bool decode_rip_xref(const XrefScanContext &ctx,
+                            size_t pos,
+                            size_t &start) {
+    if(pos < 2
+       || ctx.code[pos - 2] != 0x8d
+       || (ctx.code[pos - 1] & 0xc7) != 0x05) {
+        return false;
+    }
+    start = pos - 2;
+    if(pos >= 3 && (ctx.code[pos - 3] & 0xf0) == 0x40) {
+        start = pos - 3;
+    }
+    return true;
+}
+
+// mov r/m64, imm32 (REX.W C7 /0 [sib] [disp]), mov r32, imm32 ([REX] B8+r)
+// and mov r64, imm64 (REX.W B8+r) with the immediate at `pos`. Whether the
+// B8 form has a REX prefix can not be told from the bytes, both starts are
+// candidates (\see `decode_abs_xref_rex`).
+static bool decode_abs_xref(const XrefScanContext &ctx,
+                            size_t pos,
+                            uint32_t value,
+                            size_t &start) {
+    static const size_t c7_offsets[] = {3, 4, 5, 7, 8};
+
+    // The imm32 of C7 is sign-extended.
+    for(size_t offset : c7_offsets) {
+        if(value >= 0x80000000 || pos < offset) {
+            break;
+        }
+        const uint8_t *instr = ctx.code + pos - offset;
+        if((instr[0] & 0xf8) != 0x48
+           || instr[1] != 0xc7
+           || (instr[2] & 0x38) != 0) {
+            continue;
+        }
+        const uint8_t mod = instr[2] >> 6;
+        const uint8_t rm = instr[2] & 7;
+        size_t length = 3;
+        if(mod != 3 && rm == 4) {
+            length++;
+            if(mod == 0 && (instr[3] & 7) == 5) {
+                length += 4;
+            }
+        }
+        if(mod == 1) {
+            length += 1;
+        }
+        else if(mod == 2 || (mod == 0 && rm == 5)) {
+            length += 4;
+        }
+        if(length == offset) {
+            start = pos - offset;
+            return true;
+        }
+    }
+
+    if(pos < 1 || (ctx.code[pos - 1] & 0xf8) != 0xb8) {
+        return false;
+    }
+    start = pos - 1;
+    return true;
+}
+
+// Start of the B8 form with the immediate at `pos` if the byte in front of
+// it is a REX prefix (the upper half of an imm64 has to be zero).
+static bool decode_abs_xref_rex(const XrefScanContext &ctx,
+                                size_t pos,
+                                size_t &start) {
+    if(pos < 2
+       || (ctx.code[pos - 1] & 0xf8) != 0xb8
+       || (ctx.code[pos - 2] & 0xf0) != 0x40) {
+        return false;
+    }
+    if((ctx.code[pos - 2] & 0x08)
+       && (pos + 8 > ctx.size || read_window(ctx.code + pos + 4) != 0)) {
+        return false;
+    }
+    start = pos - 2;
+    return true;
+}
+
+static void check_window(const XrefScanContext &ctx,
+                         size_t pos,
+                         vector<XrefHit> &hits) {
+    const uint32_t value = read_window(ctx.code + pos);
+    const uint64_t rip_target = ctx.base + pos + 4
+                                + static_cast<int64_t>(
+                                               static_cast<int32_t>(value));
+    uint32_t idx;
+    size_t start;
+    if(find_addr(ctx.addrs, rip_target, idx)
+       && decode_rip_xref(ctx, pos, start)) {
+        hits.push_back({ctx.base + start, idx});
+    }
+    if(!ctx.check_abs || !find_addr(ctx.addrs, value, idx)) {
+        return;
+    }
+    if(decode_abs_xref(ctx, pos, value, start)) {
+        hits.push_back({ctx.base + start, idx});
+    }
+    if(decode_abs_xref_rex(ctx, pos, start)) {
+        hits.push_back({ctx.base + start, idx});
+    }
+}
+
+static void scan_chunk(const XrefScanContext &ctx,
+                       size_t begin,
+                       size_t end,
+                       vector<XrefHit> &hits) {
+    size_t pos = begin;
+
+#ifdef __SSE2__
+    // Range check 16 windows at once: the lanes of the k-th load hold the
+    // windows at `pos + k`, `pos + k + 4`, `pos + k + 8` and `pos + k + 12`.
+    // Unsigned compares are done as signed ones with flipped sign bits.
+    if(ctx.use_filter) {
+        const __m128i sign = _mm_set1_epi32(static_cast<int32_t>(0x80000000));
+        const __m128i span = _mm_set1_epi32(
+                                static_cast<int32_t>(ctx.span ^ 0x80000000));
+        const __m128i rip_low = _mm_set1_epi32(
+                                           static_cast<int32_t>(ctx.rip_low));
+        const __m128i abs_low = _mm_set1_epi32(
+                                           static_cast<int32_t>(ctx.abs_low));
+        const __m128i lanes = _mm_set_epi32(16, 12, 8, 4);
+        for(; pos + 16 <= end && pos + 19 <= ctx.size; pos += 16) {
+            uint32_t mask = 0;
+            for(uint32_t k = 0; k < 4; k++) {
+                const __m128i values = _mm_loadu_si128(
+                      reinterpret_cast<const __m128i*>(ctx.code + pos + k));
+                const __m128i next_ips = _mm_add_epi32(
+                     _mm_set1_epi32(static_cast<int32_t>(pos + k)), lanes);
+                const __m128i rip = _mm_sub_epi32(
+                                   _mm_add_epi32(values, next_ips), rip_low);
+                __m128i outside = _mm_cmpgt_epi32(_mm_xor_si128(rip, sign),
+                                                  span);
+                if(ctx.check_abs) {
+                    const __m128i abs = _mm_sub_epi32(values, abs_low);
+                    outside = _mm_and_si128(
+                            outside,
+                            _mm_cmpgt_epi32(_mm_xor_si128(abs, sign), span));
+                }
+                const uint32_t inside = ~_mm_movemask_ps(
+                                         _mm_castsi128_ps(outside)) & 0xf;
+                mask |= inside << (4 * k);
+            }
+            while(mask) {
+                const uint32_t bit = __builtin_ctz(mask);
+                mask &= mask - 1;
+                check_window(ctx, pos + bit / 4 + 4 * (bit % 4), hits);
+            }
+        }
+    }
+#endif
+
+    for(; pos < end && pos + 4 <= ctx.size; pos++) {
+        if(ctx.use_filter) {
+            const uint32_t value = read_window(ctx.code + pos);
+            const uint32_t rip = value + static_cast<uint32_t>(pos + 4)
+                                 - ctx.rip_low;
+            if(rip > ctx.span
+               && (!ctx.check_abs || value - ctx.abs_low > ctx.span)) {
+                continue;
+            }
+        }
+        check_window(ctx, pos, hits);
+    }
+
+    sort(hits.begin(),
+         hits.end(),
+         [](const XrefHit &a, const XrefHit &b) {
+             return a.xref_addr < b.xref_addr;
+         });
+}
+
+vector<vector<uint64_t>> find_addr_xrefs(const Memory &memory,
+                                         const vector<uint64_t> &addrs,
+                                         uint32_t num_threads) {
+
+    vector<vector<uint64_t>> result(addrs.size());
+    const uintptr_t begin = memory.get_load_begin();
+    const uintptr_t end = memory.get_load_end();
+    const uint8_t *code = memory[begin];
+    if(addrs.empty() || code == nullptr || end < begin + 4) {
+        return result;
+    }
+
+    const uint64_t low = addrs.front();
+    const uint64_t span = addrs.back() - low;
+    XrefScanContext ctx = {code,
+                           end - begin,
+                           begin,
+                           addrs,
+                           span < 0xffffffff,
+                           low <= 0xffffffff,
+                           static_cast<uint32_t>(low - begin),
+                           static_cast<uint32_t>(low),
+                           static_cast<uint32_t>(span)};
+
+    const size_t num_chunks = (ctx.size + VTABLE_XREF_SCAN_CHUNK_SIZE - 1)
+                              / VTABLE_XREF_SCAN_CHUNK_SIZE;
+    vector<vector<XrefHit>> chunk_hits(num_chunks);
+    atomic<size_t> next_chunk(0);
+    auto worker = [&]() {
+        while(true) {
+            const size_t chunk_idx = next_chunk++;
+            if(chunk_idx >= num_chunks) {
+                break;
+            }
+            const size_t chunk_begin = chunk_idx * VTABLE_XREF_SCAN_CHUNK_SIZE;
+            scan_chunk(ctx,
+                       chunk_begin,
+                       min(ctx.size,
+                           chunk_begin + VTABLE_XREF_SCAN_CHUNK_SIZE),
+                       chunk_hits[chunk_idx]);
+        }
+    };
+
+    const uint32_t num_workers = min<size_t>(num_threads, num_chunks);
+    if(num_workers <= 1) {
+        worker();
+    }
+    else {
+        vector<thread> threads;
+        for(uint32_t i = 0; i < num_workers; i++) {
+            threads.emplace_back(worker);
+        }
+        for(thread &t : threads) {
+            t.join();
+        }
+    }
+
+    // Chunks are merged in order, hence the xrefs are ascending.
+    for(const vector<XrefHit> &hits : chunk_hits) {
+        for(const XrefHit &hit : hits) {
+            vector<uint64_t> &xrefs = result[hit.addr_idx];
+            if(xrefs.empty() || xrefs.back() != hit.xref_addr) {
+                xrefs.push_back(hit.xref_addr);
+            }
+        }
+    }
+    return result;
+}
+
+static bool is_instruction(const Translator &translator, uint64_t addr) {
+    try {
+        return translator.get_containing_function(addr).contains_address(addr);
+    }
+    catch(...) {
+        return false;
+    }
+}
+
+VTableXrefScanStats scan_vtable_xrefs(const Translator &translator,
+                                      NativeXrefsMode mode,
+                                      uint32_t num_threads,
+                                      VTableModule &module) {
+
+    // Only normal vtables are referenced directly by the code.
+    vector<uint64_t> addrs;
+    for(const VTable &vtable : module.vtables) {
+        if(vtable.type == VTableTypeNormal) {
+            addrs.push_back(vtable.addr);
+        }
+    }
+    sort(addrs.begin(), addrs.end());
+    addrs.erase(unique(addrs.begin(), addrs.end()), addrs.end());
+
+    const vector<vector<uint64_t>> addr_xrefs = find_addr_xrefs(
+                                                     translator.get_memory(),
+                                                     addrs,
+                                                     num_threads);
+
+    VTableXrefScanStats stats;
+    for(VTable &vtable : module.vtables) {
+        if(vtable.type != VTableTypeNormal) {
+            continue;
+        }
+        uint32_t idx = 0;
+        find_addr(addrs, vtable.addr, idx);
+        const vector<uint64_t> &xrefs = addr_xrefs[idx];
+
+        // Only candidates that start an instruction of a known function
+        // are xrefs.
+        unordered_set<uint64_t> found;
+        for(uint64_t xref_addr : xrefs) {
+            if(is_instruction(translator, xref_addr)) {
+                found.insert(xref_addr);
+            }
+        }
+        stats.num_xrefs += found.size();
+        for(uint64_t xref_addr : vtable.xrefs) {
+            if(found.find(xref_addr) == found.cend()) {
+                stats.num_missing++;
+            }
+        }
+        for(uint64_t xref_addr : found) {
+            if(vtable.xrefs.find(xref_addr) == vtable.xrefs.cend()) {
+                stats.num_additional++;
+            }
+        }
+
+        if(mode == NativeXrefsReplace) {
+            vtable.xrefs = move(found);
+        }
+    }
+    return stats;
+}
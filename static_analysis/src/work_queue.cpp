@@ -0,0 +1,115 @@
+#include "work_queue.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkQueue::WorkQueue(uint32_t num_workers)
+    : _size(0), _next_push(0) {
+    set_num_workers(num_workers);
+}
+
+void WorkQueue::set_num_workers(uint32_t num_workers) {
+    if(num_workers == 0) {
+        num_workers = 1;
+    }
+
+    vector<uint64_t> items;
+    for(auto &deque_ptr : _deques) {
+        items.insert(items.end(),
+                     deque_ptr->batch.begin() + deque_ptr->batch_pos,
+                     deque_ptr->batch.end());
+        items.insert(items.end(),
+                     deque_ptr->items.begin(),
+                     deque_ptr->items.end());
+    }
+
+    _deques.clear();
+    for(uint32_t i = 0; i < num_workers; i++) {
+        _deques.push_back(unique_ptr<WorkerDeque>(new WorkerDeque()));
+    }
+
+    // Hand out consecutive items to different workers.
+    _size = 0;
+    _next_push = 0;
+    for(uint64_t item : items) {
+        push(item);
+    }
+}
+
+void WorkQueue::push(uint64_t item) {
+    uint32_t idx = _next_push++ % _deques.size();
+    WorkerDeque &target = *_deques[idx];
+
+    target.mtx.lock();
+    target.items.push_back(item);
+    _size++;
+    target.mtx.unlock();
+}
+
+/*!
+ * \brief Moves half of the items of the first non-empty deque of another
+ * worker into the deque of the given worker.
+ *
+ * \return `false` if all other deques are empty.
+ */
+bool WorkQueue::steal(uint32_t worker) {
+    const uint32_t num_workers = _deques.size();
+    WorkerDeque &own = *_deques[worker];
+
+    for(uint32_t i = 1; i < num_workers; i++) {
+        WorkerDeque &victim = *_deques[(worker + i) % num_workers];
+
+        victim.mtx.lock();
+        size_t num_items = (victim.items.size() + 1) / 2;
+        if(num_items == 0) {
+            victim.mtx.unlock();
+            continue;
+        }
+        vector<uint64_t> stolen(victim.items.end() - num_items,
+                                victim.items.end());
+        victim.items.erase(victim.items.end() - num_items,
+                           victim.items.end());
+        victim.mtx.unlock();
+
+        own.mtx.lock();
+        own.items.insert(own.items.end(), stolen.begin(), stolen.end());
+        own.mtx.unlock();
+        return true;
+    }
+    return false;
+}
+
+bool WorkQueue::pop(uint32_t worker, uint64_t &item) {
+    WorkerDeque &own = *_deques[worker % _deques.size()];
+    lock_guard<mutex> _(own.batch_mtx);
+
+    while(true) {
+        if(own.batch_pos < own.batch.size()) {
+            item = own.batch[own.batch_pos++];
+            _size--;
+            return true;
+        }
+        own.batch.clear();
+        own.batch_pos = 0;
+
+        // Refill the batch from the front of the own deque.
+        own.mtx.lock();
+        size_t num_items = min<size_t>(WORK_QUEUE_POP_BATCH,
+                                       max<size_t>(1, own.items.size() / 2));
+        num_items = min(num_items, own.items.size());
+        if(num_items != 0) {
+            own.batch.assign(own.items.begin(),
+                             own.items.begin() + num_items);
+            own.items.erase(own.items.begin(),
+                            own.items.begin() + num_items);
+            own.mtx.unlock();
+            continue;
+        }
+        own.mtx.unlock();
+
+        if(!steal(worker % _deques.size())) {
+            return false;
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "vex.h"
+
+// Number of consecutive nop instructions, more than VEX translates into
+// one block.
+#define TEST_NUM_NOPS (MAX_INSTRUCTIONS + MAX_INSTRUCTIONS / 2)
+#define TEST_GUEST_ADDRESS 0x400000
+
+using namespace std;
+
+static uint32_t num_failures = 0;
+
+static size_t count_instructions(const IRSB *block) {
+    size_t num_instrs = 0;
+    for(int i = 0; i < block->stmts_used; i++) {
+        if(block->stmts[i]->tag == Ist_IMark) {
+            num_instrs++;
+        }
+    }
+    return num_instrs;
+}
+
+static void check(bool condition, const string &description) {
+    if(!condition) {
+        cerr << "FAILED: " << description << endl;
+        num_failures++;
+    }
+}
+
+int main() {
+    Vex &vex = Vex::get_instance();
+    const VexRegisterUpdates mode = VexRegUpdAllregsAtEachInsn;
+    vex.set_iropt_register_updates_default(mode);
+
+    vector<uint8_t> code(TEST_NUM_NOPS, 0x90);
+    code.push_back(0xc3);
+
+    vector<uintptr_t> addresses;
+    for(uintptr_t i = 0; i < TEST_NUM_NOPS; i++) {
+        addresses.push_back(TEST_GUEST_ADDRESS + i);
+    }
+
+    // A translation with a lower limit must not affect the following ones.
+    const IRSB *single = vex.translate_instruction(code.data(),
+                                                  TEST_GUEST_ADDRESS,
+                                                  mode);
+    check(count_instructions(single) == 1,
+          "single instruction is translated alone");
+
+    // Blocks of other register update modes are cached separately.
+    const IRSB *other_mode = vex.translate_instruction(code.data(),
+                                                      TEST_GUEST_ADDRESS,
+                                                      VexRegUpdSpAtMemAccess);
+    check(other_mode != single
+          && vex.translate_instruction(code.data(),
+                                       TEST_GUEST_ADDRESS,
+                                       mode) == single,
+          "single instructions are cached per register update mode");
+
+    const IRSB *block = vex.translate(code.data(), TEST_GUEST_ADDRESS);
+    check(count_instructions(block) == MAX_INSTRUCTIONS,
+          "block is translated up to the instruction limit");
+
+    block = vex.translate(code.data(), TEST_GUEST_ADDRESS, 3);
+    check(count_instructions(block) == 3,
+          "block is translated up to the given instruction count");
+
+    // The run is longer than one block and has to be split into two.
+    size_t pos = 0;
+    vector<size_t> run_lengths;
+    while(pos < addresses.size()) {
+        size_t num_instrs = 0;
+        const IRSB *run = vex.translate_instructions(code.data() + pos,
+                                                     &addresses[pos],
+                                                     addresses.size() - pos,
+                                                     mode,
+                                                     &num_instrs);
+        check(count_instructions(run) == num_instrs,
+              "run block consists of the reported instructions");
+        run_lengths.push_back(num_instrs);
+        pos += num_instrs;
+    }
+    check(run_lengths.size() == 2
+          && run_lengths[0] == MAX_INSTRUCTIONS
+          && run_lengths[1] == TEST_NUM_NOPS - MAX_INSTRUCTIONS,
+          "long run is split at the instruction limit");
+
+    // Addresses that are not consecutive instructions end the run.
+    vector<uintptr_t> gap_addresses = {TEST_GUEST_ADDRESS,
+                                       TEST_GUEST_ADDRESS + 1,
+                                       TEST_GUEST_ADDRESS + 3};
+    size_t num_instrs = 0;
+    block = vex.translate_instructions(code.data(),
+                                       gap_addresses.data(),
+                                       gap_addresses.size(),
+                                       mode,
+                                       &num_instrs);
+    check(num_instrs == 2 && count_instructions(block) == 2,
+          "run ends before a skipped instruction");
+
+    if(num_failures != 0) {
+        cerr << dec << num_failures << " checks failed." << endl;
+        return 1;
+    }
+    cout << "All checks passed." << endl;
+    return 0;
+}
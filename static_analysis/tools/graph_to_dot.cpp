@@ -0,0 +1,224 @@
+// Converts the data flow graphs captured by the static analysis (config
+// option GRAPHCAPTURE, file {MODULE}.marx_graphs) into .dot files.
+//
+// Usage: marx_graph_to_dot <capture_file> <output_dir>
+//
+// The files are written to <output_dir>/<analysis>/<start_addr>/ and named
+// like the former debug dumps, e.g.
+// 001_type_0_func_00401000_instr_00401020_op_rdi_augment_use.dot or
+// final.dot.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <boost/filesystem.hpp>
+
+#include "graph_capture.h"
+
+using namespace std;
+
+// Values of `DataFlowNodeType` and `DataFlowEdgeType` (backtrace_analysis.h).
+enum CapturedNodeType {
+    CapturedNodeTypeStart = 2,
+    CapturedNodeTypeVTVVerifyCall = 3,
+    CapturedNodeTypeVtable = 4,
+    CapturedNodeTypeNewOperator = 5,
+    CapturedNodeTypeVtableCall = 6,
+};
+
+enum CapturedEdgeType {
+    CapturedEdgeTypeRet = 2,
+    CapturedEdgeTypeCall = 3,
+    CapturedEdgeTypeJmp = 4,
+    CapturedEdgeTypeVtableCall = 5,
+};
+
+static const char *get_stage_suffix(uint32_t stage) {
+    switch(stage) {
+        case GraphCapturePreAugmentUse:
+            return "_pre_augment_use.dot";
+        case GraphCaptureAugmentUse:
+            return "_augment_use.dot";
+        case GraphCapturePostAugmentUse:
+            return "_post_augment_use.dot";
+        case GraphCaptureMerged:
+            return "_merged.dot";
+        default:
+            return ".dot";
+    }
+}
+
+// Same style as `FullDataFlowNodeWriter`.
+static void write_node(ostream &out, const GraphCaptureNode &node) {
+    out << "["
+        << "fontname=\"Ubuntu Mono\", "
+        << "shape=rect, ";
+    if(node.comment != "") {
+        out << "label=\"" << node.label
+            << " (comment: " << node.comment << ")\", "
+            << "fillcolor=\"#fff668\", "
+            << "style=filled";
+        out << "]";
+        return;
+    }
+
+    const char *fill_color = nullptr;
+    out << "label=\"" << node.label;
+    if(node.is_join) {
+        out << " (join)";
+    }
+    switch(node.type) {
+        case CapturedNodeTypeStart:
+            out << " (start_instr)";
+            fill_color = "#ffe4e1";
+            break;
+        case CapturedNodeTypeNewOperator:
+            out << " (new_operator)";
+            fill_color = "#d8f1c4";
+            break;
+        case CapturedNodeTypeVtable:
+            out << " (vtable)";
+            fill_color = "#c6e2ff";
+            break;
+        case CapturedNodeTypeVTVVerifyCall:
+            out << " (VTV_verify)";
+            fill_color = "#f1c4ed";
+            break;
+        case CapturedNodeTypeVtableCall:
+            fill_color = "#a6f2ff";
+            break;
+        default:
+            break;
+    }
+    out << "\"";
+    if(node.is_join) {
+        fill_color = "#7436f4";
+    }
+    if(fill_color != nullptr) {
+        out << ", "
+            << "fillcolor=\"" << fill_color << "\", "
+            << "style=filled";
+    }
+    out << "]";
+}
+
+// Same style as `FullDataFlowEdgeWriter`.
+static void write_edge(ostream &out, const GraphCaptureEdge &edge) {
+    out << "["
+        << "fontname=\"Ubuntu Mono\", "
+        << "label=\"" << edge.label;
+    if(edge.comment != "") {
+        out << " (comment: " << edge.comment << ")";
+    }
+    else {
+        switch(edge.type) {
+            case CapturedEdgeTypeCall:
+                out << " (call)";
+                break;
+            case CapturedEdgeTypeJmp:
+                out << " (jmp)";
+                break;
+            case CapturedEdgeTypeRet:
+                out << " (ret)";
+                break;
+            case CapturedEdgeTypeVtableCall:
+                out << " (vtable call)";
+                break;
+            default:
+                break;
+        }
+    }
+    out << "\"]";
+}
+
+static bool write_dot(const string &output_dir,
+                      const GraphCaptureRecord &record) {
+    stringstream dir;
+    dir << output_dir
+        << "/"
+        << record.analysis
+        << "/"
+        << setfill('0') << setw(8) << hex << record.start_addr;
+    try {
+        boost::filesystem::create_directories(dir.str().c_str());
+    }
+    catch(...) {
+        cerr << "Not able to create directory: " << dir.str() << "\n";
+        return false;
+    }
+
+    stringstream file_name;
+    file_name << dir.str() << "/";
+    if(record.stage == GraphCaptureFinal) {
+        file_name << "final.dot";
+    }
+    else {
+        file_name << setfill('0') << setw(3) << dec << record.round
+                  << "_type_"
+                  << dec << record.tracking_type
+                  << "_func_"
+                  << setfill('0') << setw(8) << hex << record.function_addr
+                  << "_instr_"
+                  << setfill('0') << setw(8) << hex << record.instr_addr
+                  << "_op_"
+                  << record.operand
+                  << get_stage_suffix(record.stage);
+    }
+
+    ofstream file(file_name.str());
+    file << "digraph G {\n";
+    for(size_t i = 0; i < record.nodes.size(); i++) {
+        file << dec << i;
+        write_node(file, record.nodes[i]);
+        file << ";\n";
+    }
+    for(const GraphCaptureEdge &edge : record.edges) {
+        file << dec << edge.src << "->" << edge.dst << " ";
+        write_edge(file, edge);
+        file << ";\n";
+    }
+    file << "}\n";
+    file.close();
+    if(file.fail()) {
+        cerr << "Not able to write file: " << file_name.str() << "\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc != 3) {
+        cerr << "Usage: "
+             << argv[0]
+             << " <capture_file> <output_dir>"
+             << "\n";
+        return 1;
+    }
+    const string capture_file = argv[1];
+    const string output_dir = argv[2];
+
+    uint64_t num_graphs = 0;
+    bool success = true;
+    bool valid = read_graph_capture(capture_file,
+        [&](const GraphCaptureRecord &record) {
+            success &= write_dot(output_dir, record);
+            num_graphs++;
+        });
+    if(!valid) {
+        cerr << "Not able to read graph capture file '"
+             << capture_file
+             << "' (wrote "
+             << dec << num_graphs
+             << " graphs before the error)."
+             << "\n";
+        return 1;
+    }
+
+    cout << "Converted "
+         << dec << num_graphs
+         << " graphs."
+         << "\n";
+    return success ? 0 : 1;
+}